@@ -0,0 +1,561 @@
+//-------------------------------------------------------------------
+//
+// bench.cpp
+// Program to measure the speed of the waveform library's sample
+// processing, filtering, and file conversion code.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+
+#include "waveform.h"
+#include "waveformload.h"
+#include "waveformsave.h"
+#include "threadpool.h"
+#include "dspkernels.h"
+#include "lowpass.h"
+#include "highpass.h"
+#include "bandpassfilter.h"
+#include "notchfilter.h"
+#include "segmentedfilter.h"
+#include "denormals.h"
+#include "cmdopt.h"
+#include "platform.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <wchar.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+struct ProgramSettings
+{
+    // Name of the file to write the results to, as JSON.
+    std::wstring m_outFilename = L"bench.json";
+
+    // The lengths (in sample frames) and channel counts of the
+    // synthetic waveforms to run each benchmark on.
+    std::vector<size_t> m_sizes = { 4096, 262144, 4194304 };
+    std::vector<size_t> m_channels = { 1, 2 };
+
+    // If not empty, only the benchmarks whose names contain this
+    // text are run.
+    std::string m_only;
+
+    // Each benchmark is repeated for at least this many seconds.
+    double m_minSeconds = 0.25;
+};
+
+// Print the program name prefix to stdout.
+const wchar_t *program_name = L"Bench";
+static void printname() { printf("%S:  ", program_name); }
+
+//
+// Every allocation made with operator new (which includes those of
+// the standard containers, and so of Waveform's sample buffer) is
+// counted, from any thread, so the benchmarks can report how many
+// allocations each run of an operation makes.
+//
+
+static std::atomic<size_t> g_allocations(0);
+static std::atomic<size_t> g_allocatedBytes(0);
+
+void *operator new(size_t size)
+{
+    ++g_allocations;
+    g_allocatedBytes += size;
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+// The results of one benchmark on one size of waveform.
+struct BenchResult
+{
+    std::string m_name;
+    size_t m_frames = 0;
+    size_t m_channels = 0;
+    size_t m_iterations = 0;
+    double m_nsPerSample = 0.0;     // Median time per interleaved sample.
+    double m_gbPerSecond = 0.0;     // Bytes read and written per second.
+    double m_allocations = 0.0;     // Per run of the operation.
+    double m_allocatedBytes = 0.0;  // Per run of the operation.
+    std::vector<double> m_samples;  // Time per sample of each run, sorted, for significance tests.
+};
+
+// Describes one benchmark:  'setup' runs before each timed run of
+// 'body' (to restore the waveform an operation changed, say), and
+// isn't counted.  'bytes' is how much data each run reads and writes.
+struct Benchmark
+{
+    std::string m_name;
+    size_t m_bytes;
+    std::function<void()> m_setup;
+    std::function<void()> m_body;
+    size_t m_maxIterations;
+};
+
+// The most times a benchmark is repeated.  Those that read and write
+// files are repeated fewer times, since each run is slow and the
+// library logs each file it reads or writes.
+static const size_t kMaxIterations = 1000;
+static const size_t kMaxFileIterations = 10;
+static const size_t kMinIterations = 3;
+
+// The most run times written to the results for each benchmark.  If
+// there were more runs, evenly spaced ones are picked from the sorted
+// times, which keeps the shape of their distribution.
+static const size_t kMaxRecordedSamples = 100;
+
+// Runs a benchmark until it has taken at least 'minSeconds', and
+// returns the median time of the runs along with their allocations.
+static BenchResult RunBenchmark(const Benchmark &bench, size_t frames, size_t channels, double minSeconds)
+{
+    std::vector<double> times;
+    size_t allocations = 0;
+    size_t allocatedBytes = 0;
+    double totalSeconds = 0.0;
+    while (times.size() < kMinIterations ||
+           (totalSeconds < minSeconds && times.size() < bench.m_maxIterations))
+    {
+        if (bench.m_setup)
+            bench.m_setup();
+
+        size_t allocationsBefore = g_allocations;
+        size_t bytesBefore = g_allocatedBytes;
+        auto start = std::chrono::steady_clock::now();
+        bench.m_body();
+        auto end = std::chrono::steady_clock::now();
+        allocations += g_allocations - allocationsBefore;
+        allocatedBytes += g_allocatedBytes - bytesBefore;
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        times.push_back(seconds);
+        totalSeconds += seconds;
+    }
+
+    std::sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+
+    BenchResult result;
+    result.m_name = bench.m_name;
+    result.m_frames = frames;
+    result.m_channels = channels;
+    result.m_iterations = times.size();
+    result.m_nsPerSample = median * 1e9 / (frames * channels);
+    result.m_gbPerSecond = (median > 0.0) ? bench.m_bytes / median / 1e9 : 0.0;
+    result.m_allocations = static_cast<double>(allocations) / times.size();
+    result.m_allocatedBytes = static_cast<double>(allocatedBytes) / times.size();
+
+    size_t recorded = times.size();
+    if (recorded > kMaxRecordedSamples)
+        recorded = kMaxRecordedSamples;
+    for (size_t index = 0; index < recorded; index++)
+        result.m_samples.push_back(times[index * times.size() / recorded] * 1e9 / (frames * channels));
+    return result;
+}
+
+// Fills a waveform with a tone plus some noise, the same every time.
+static void MakeTestWaveform(Waveform &wav, size_t frames, size_t channels)
+{
+    wav.Populate(frames, channels);
+    wav.SetRate(48000);
+    float *samples = wav.GetSamplesPtr();
+    uint32_t seed = 12345;
+    for (size_t index = 0; index < frames * channels; index++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        float noise = static_cast<float>(seed >> 8) / 16777216.0f - 0.5f;
+        samples[index] = 0.7f * sinf(static_cast<float>(index / channels) * 0.05f) + 0.2f * noise;
+    }
+}
+
+// Adds a benchmark of running one of the filter classes over the
+// samples, one sample at a time and then in parallel segments.
+template <class Filter>
+static void AddFilterBenchmarks(std::vector<Benchmark> &benchmarks, const char *name,
+                                const Filter &prototype, const Waveform &source, std::vector<float> &output)
+{
+    size_t count = source.GetNumSamples() * source.GetNumChannels();
+    size_t bytes = count * sizeof(float) * 2;
+    const float *in = source.GetSamplesPtr();
+    float *out = output.data();
+    std::shared_ptr<Filter> filter(new Filter(prototype));
+
+    benchmarks.push_back({ name, bytes, nullptr, [=]() {
+        for (size_t index = 0; index < count; index++)
+            out[index] = filter->FilterSample(in[index]);
+    }, kMaxIterations });
+    benchmarks.push_back({ std::string(name) + " segmented", bytes, nullptr, [=]() {
+        FilterSamplesInSegments(*filter, in, out, count);
+    }, kMaxIterations });
+}
+
+// Adds benchmarks of filtering a short burst of sound followed by
+// silence, as the filters' history decays toward zero:  once with
+// denormals off, as the library runs its filters, which should cost
+// the same per sample as filtering sound does, and once with them
+// left on, for comparison.
+template <class Filter>
+static void AddTailBenchmarks(std::vector<Benchmark> &benchmarks, const char *name,
+                              const Filter &prototype, const std::vector<float> &tail, std::vector<float> &output)
+{
+    size_t count = tail.size();
+    size_t bytes = count * sizeof(float) * 2;
+    const float *in = tail.data();
+    float *out = output.data();
+    std::shared_ptr<Filter> filter(new Filter(prototype));
+
+    // Each run starts over from the beginning of the burst.
+    auto reset = [=]() { *filter = prototype; };
+    benchmarks.push_back({ std::string(name) + " silent tail", bytes, reset, [=]() {
+        ScopedDenormalsOff denormals;
+        filter->FilterSamples(in, out, count);
+    }, kMaxIterations });
+    benchmarks.push_back({ std::string(name) + " silent tail, denormals on", bytes, reset, [=]() {
+        filter->FilterSamples(in, out, count);
+    }, kMaxIterations });
+}
+
+// Adds benchmarks of saving the waveform to a WAV file with the given
+// sample format, and of loading it back.
+static void AddFileBenchmarks(std::vector<Benchmark> &benchmarks, const char *name,
+                              bool useFloat, unsigned bytesPerSample, const Waveform &source, Waveform &work)
+{
+    static const wchar_t *filename = L"bench_temp.wav";
+    size_t count = source.GetNumSamples() * source.GetNumChannels();
+    size_t bytes = count * (sizeof(float) + bytesPerSample);
+    const Waveform *psource = &source;
+    Waveform *pwork = &work;
+
+    benchmarks.push_back({ std::string("WaveformSaveToFile ") + name, bytes, nullptr, [=]() {
+        WaveformSaveToFile(filename, *psource, nullptr, nullptr, useFloat, bytesPerSample);
+    }, kMaxFileIterations });
+    benchmarks.push_back({ std::string("WaveformLoadFromFile ") + name, bytes, nullptr, [=]() {
+        WaveformLoadFromFile(filename, *pwork);
+    }, kMaxFileIterations });
+}
+
+// Runs all of the benchmarks on one size of waveform, adding their
+// results to 'results'.
+static void RunBenchmarksForSize(const ProgramSettings &settings, size_t frames, size_t channels,
+                                 std::vector<BenchResult> &results)
+{
+    Waveform source, work;
+    MakeTestWaveform(source, frames, channels);
+    std::vector<float> output(frames * channels);
+    size_t count = frames * channels;
+    size_t inPlaceBytes = count * sizeof(float) * 2;
+    Waveform *pwork = &work;
+    const Waveform *psource = &source;
+    auto restore = [=]() { *pwork = *psource; };
+
+    std::vector<Benchmark> benchmarks;
+    benchmarks.push_back({ "Waveform::Multiply", inPlaceBytes, restore, [=]() { pwork->Multiply(1.5f); }, kMaxIterations });
+    benchmarks.push_back({ "Waveform::Clip", inPlaceBytes, restore, [=]() { pwork->Clip(-0.5f, 0.5f); }, kMaxIterations });
+    benchmarks.push_back({ "Waveform::Fit", inPlaceBytes, restore, [=]() { pwork->Fit(-0.5f, 0.5f); }, kMaxIterations });
+    benchmarks.push_back({ "Waveform::Normalize", inPlaceBytes, restore, [=]() { pwork->Normalize(-1.0f); }, kMaxIterations });
+    benchmarks.push_back({ "Waveform::Stretch", count * sizeof(float) * 5 / 2, restore,
+        [=]() { pwork->Stretch(frames * 3 / 2); }, kMaxIterations });
+    benchmarks.push_back({ "Waveform::Resample", count * sizeof(float) * 2, restore,
+        [=]() { pwork->Resample(44100); }, kMaxIterations });
+    if (channels > 1)
+    {
+        benchmarks.push_back({ "Waveform::ConvertToMono", count * sizeof(float) * (channels + 1) / channels, restore,
+            [=]() { pwork->ConvertToMono(); }, kMaxIterations });
+    }
+
+    AddFilterBenchmarks(benchmarks, "LowPassFilter", LowPassFilter(1000.0f, 48000.0f), source, output);
+    AddFilterBenchmarks(benchmarks, "HighPassFilter", HighPassFilter(100.0f, 48000.0f), source, output);
+    AddFilterBenchmarks(benchmarks, "BandpassFilter", BandpassFilter(48000.0f, 1000.0f, 2.0f), source, output);
+    AddFilterBenchmarks(benchmarks, "NotchFilter", NotchFilter(48000.0f, 1000.0f, 5.0f), source, output);
+
+    // The first sixteenth of the waveform, then silence.
+    std::vector<float> tail(count, 0.0f);
+    std::copy(source.GetSamplesPtr(), source.GetSamplesPtr() + count / 16, tail.begin());
+    AddTailBenchmarks(benchmarks, "LowPassFilter", LowPassFilter(1000.0f, 48000.0f), tail, output);
+    AddTailBenchmarks(benchmarks, "HighPassFilter", HighPassFilter(100.0f, 48000.0f), tail, output);
+    AddTailBenchmarks(benchmarks, "BandpassFilter", BandpassFilter(48000.0f, 1000.0f, 2.0f), tail, output);
+    AddTailBenchmarks(benchmarks, "NotchFilter", NotchFilter(48000.0f, 1000.0f, 5.0f), tail, output);
+
+    AddFileBenchmarks(benchmarks, "wav 16-bit", false, 2, source, work);
+    AddFileBenchmarks(benchmarks, "wav 24-bit", false, 3, source, work);
+    AddFileBenchmarks(benchmarks, "wav float", true, 4, source, work);
+
+    for (const Benchmark &bench : benchmarks)
+    {
+        if (!settings.m_only.empty() && bench.m_name.find(settings.m_only) == std::string::npos)
+            continue;
+
+        BenchResult result = RunBenchmark(bench, frames, channels, settings.m_minSeconds);
+        results.push_back(result);
+        printname();
+        printf("%-36s %8zu x %zu: %9.3f ns/sample %8.2f GB/s %8.1f allocs\n",
+            result.m_name.c_str(), frames, channels, result.m_nsPerSample,
+            result.m_gbPerSecond, result.m_allocations);
+        fflush(stdout);
+    }
+
+    _wremove(L"bench_temp.wav");
+}
+
+// Writes the results to a JSON file.  Returns true if successful.
+static bool WriteResults(const wchar_t *filename, const std::vector<BenchResult> &results)
+{
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"wt") != 0 || fp == nullptr)
+        return false;
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"schema\": 2,\n");
+#ifdef _DEBUG
+    fprintf(fp, "  \"build\": \"debug\",\n");
+#else
+    fprintf(fp, "  \"build\": \"release\",\n");
+#endif
+    fprintf(fp, "  \"threads\": %u,\n", ThreadPool::GetShared().GetConcurrency());
+    fprintf(fp, "  \"isa\": \"%s\",\n", DSPKernelsGet().m_name);
+    fprintf(fp, "  \"results\": [\n");
+    for (size_t index = 0; index < results.size(); index++)
+    {
+        const BenchResult &result = results[index];
+        fprintf(fp, "    { \"name\": \"%s\", \"frames\": %zu, \"channels\": %zu, \"iterations\": %zu, "
+            "\"ns_per_sample\": %.4f, \"gb_per_second\": %.4f, \"allocations\": %.2f, \"allocated_bytes\": %.0f,\n"
+            "      \"samples\": [",
+            result.m_name.c_str(), result.m_frames, result.m_channels, result.m_iterations,
+            result.m_nsPerSample, result.m_gbPerSecond, result.m_allocations, result.m_allocatedBytes);
+        for (size_t sample = 0; sample < result.m_samples.size(); sample++)
+            fprintf(fp, "%s%.4f", sample ? ", " : "", result.m_samples[sample]);
+        fprintf(fp, "] }%s\n", (index + 1 < results.size()) ? "," : "");
+    }
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+
+    bool ok = (ferror(fp) == 0);
+    fclose(fp);
+    return ok;
+}
+
+static void PrintUsage()
+{
+    printf(
+        "\n"
+        "Description:  Bench measures the speed of the waveform library's \n"
+        "  sample operations, filters, and WAV file conversions, on \n"
+        "  synthetic waveforms of several sizes, and writes the results \n"
+        "  to a JSON file so they can be compared between releases. \n"
+        "\n"
+        "Usage:  bench [options]\n"
+        "\n"
+        "Options:\n"
+        "  -Output=file : Writes the results to the given file instead \n"
+        "       of 'bench.json'. \n"
+        "\n"
+        "  -Sizes=x : The lengths of the waveforms to use, in sample \n"
+        "       frames, separated by commas.  The default is \n"
+        "       '4096,262144,4194304'. \n"
+        "\n"
+        "  -Channels=x : The channel counts of the waveforms to use, \n"
+        "       separated by commas.  The default is '1,2'. \n"
+        "\n"
+        "  -Only=x : Runs only the benchmarks whose names contain 'x' \n"
+        "       (for example 'Filter' or 'Waveform::Fit'). \n"
+        "\n"
+        "  -MinTime=x : Repeats each benchmark for at least 'x' seconds. \n"
+        "       The default is 0.25. \n"
+        "\n"
+        "  -ForceISA=x : Uses the given vector instructions for the sample \n"
+        "       loops:  'scalar' (none), 'sse2', 'avx2', 'avx512', or 'neon'. \n"
+        "       Normally the fastest ones the processor has are used. \n"
+        "\n"
+        "  -Help : Print this usage information to the console.\n"
+        );
+}
+
+// Parses a list of numbers separated by commas.  Returns false if
+// any of them isn't a positive number.
+static bool ParseNumberList(const wchar_t *text, std::vector<size_t> &numbers)
+{
+    numbers.clear();
+    while (*text != '\0')
+    {
+        wchar_t *end = nullptr;
+        unsigned long long value = wcstoull(text, &end, 10);
+        if (end == text || value == 0 || (*end != ',' && *end != '\0'))
+            return false;
+        numbers.push_back(static_cast<size_t>(value));
+        text = (*end == ',') ? end + 1 : end;
+    }
+    return !numbers.empty();
+}
+
+// Parses the program's command line arguments, placing the
+// selected options into the settings structure.  Returns
+// true if successful.
+static bool ParseCommandLineArguments(
+    int argc,
+    wchar_t **argv,
+    ProgramSettings &settings
+    )
+{
+    for (int iarg = 1; iarg < argc; iarg++)
+    {
+        if (!IsOption(argv[iarg]))
+        {
+            printname();
+            printf("Unexpected argument '%S'\n", argv[iarg]);
+            return false;
+        }
+
+        if (OptionNameIs(argv[iarg], L"Help") || OptionNameIs(argv[iarg], L"?"))
+        {
+            PrintUsage();
+            return false;
+        }
+        else if (OptionNameIs(argv[iarg], L"Output"))
+        {
+            settings.m_outFilename = OptionValue(argv[iarg]);
+        }
+        else if (OptionNameIs(argv[iarg], L"Sizes"))
+        {
+            if (!ParseNumberList(OptionValue(argv[iarg]), settings.m_sizes))
+            {
+                printname();
+                printf("Invalid sizes '%S'\n", argv[iarg]);
+                return false;
+            }
+        }
+        else if (OptionNameIs(argv[iarg], L"Channels"))
+        {
+            if (!ParseNumberList(OptionValue(argv[iarg]), settings.m_channels))
+            {
+                printname();
+                printf("Invalid channel counts '%S'\n", argv[iarg]);
+                return false;
+            }
+        }
+        else if (OptionNameIs(argv[iarg], L"Only"))
+        {
+            const wchar_t *value = OptionValue(argv[iarg]);
+            settings.m_only.clear();
+            for (size_t index = 0; value[index] != '\0'; index++)
+                settings.m_only += static_cast<char>(value[index]);
+        }
+        else if (OptionNameIs(argv[iarg], L"MinTime"))
+        {
+            settings.m_minSeconds = _wtof(OptionValue(argv[iarg]));
+            if (settings.m_minSeconds < 0.0 || settings.m_minSeconds > 3600.0)
+            {
+                printname();
+                printf("Invalid minimum time '%S'\n", argv[iarg]);
+                return false;
+            }
+        }
+        else if (OptionNameIs(argv[iarg], L"ForceISA"))
+        {
+            if (!DSPKernelsForceISA(OptionValue(argv[iarg])))
+            {
+                printname();
+                printf("Unsupported instruction set '%S'\n", OptionValue(argv[iarg]));
+                return false;
+            }
+        }
+        else
+        {
+            printname();
+            printf("Unrecognized option '%S'\n", argv[iarg]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Application entry point.
+int wmain(int argc, wchar_t **argv)
+{
+    ProgramSettings settings;
+    if (!ParseCommandLineArguments(argc, argv, settings))
+        return EXIT_FAILURE;
+
+    try
+    {
+        std::vector<BenchResult> results;
+        for (size_t channels : settings.m_channels)
+        {
+            for (size_t frames : settings.m_sizes)
+                RunBenchmarksForSize(settings, frames, channels, results);
+        }
+
+        if (!WriteResults(settings.m_outFilename.c_str(), results))
+        {
+            printname();
+            printf("Failed writing results to '%S'\n", settings.m_outFilename.c_str());
+            return EXIT_FAILURE;
+        }
+
+        printname();
+        printf("Wrote %zu results to '%S'\n", results.size(), settings.m_outFilename.c_str());
+    }
+    catch(...)
+    {
+        printname();
+        printf("Unexpected program exception!\n");
+        return EXIT_FAILURE;
+    }
+
+    printname();
+    printf("Completed OK.\n");
+    return EXIT_SUCCESS;
+}
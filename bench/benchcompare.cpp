@@ -0,0 +1,672 @@
+//-------------------------------------------------------------------
+//
+// benchcompare.cpp
+// Program to compare benchmark results against a baseline, and
+// report which benchmarks have become slower.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+
+#include "cmdopt.h"
+#include "platform.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <wchar.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+struct ProgramSettings
+{
+    // The result files to compare.  Each side may have several,
+    // from repeated runs, whose times are pooled together.
+    std::vector<std::wstring> m_baselineFilenames;
+    std::vector<std::wstring> m_currentFilenames;
+
+    // A benchmark has regressed if its median time grew by more than
+    // this percentage, and the growth is statistically significant
+    // at this level.
+    double m_thresholdPercent = 10.0;
+    double m_alpha = 0.01;
+};
+
+// Print the program name prefix to stdout.
+const wchar_t *program_name = L"BenchCompare";
+static void printname() { printf("%S:  ", program_name); }
+
+// The times measured for one benchmark, from one or more result files.
+// For Bench's results, the times are nanoseconds per sample; for
+// ToolBench's, they're seconds.
+struct BenchTimes
+{
+    std::vector<double> m_times;        // Every run time, from all of the files.
+    std::vector<double> m_runMedians;   // The median time from each file.
+};
+
+// With at least this many result files on each side, the benchmarks
+// are compared by the median time of each file rather than by all of
+// the times pooled together.  The times within one run of Bench tend
+// to be alike, since they share the state of the machine (its clock
+// speed, what else is running, how the memory is laid out), so they
+// understate how much the times vary from run to run; the medians of
+// separate runs don't.
+static const size_t kMinRunsForRunTest = 3;
+
+// Maps the name that identifies a benchmark (made from its name,
+// size, and so on) to its times.
+typedef std::map<std::string, BenchTimes> BenchTimesMap;
+
+static double Median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return (values.size() % 2) ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+//
+// Reads the results written by Bench and ToolBench.  This isn't a
+// general JSON parser; it handles what those programs write, which is
+// an object with a "results" array of flat objects, whose values are
+// strings, numbers, true or false, and arrays of numbers.
+//
+class ResultsReader
+{
+public:
+    explicit ResultsReader(const std::string &text) : m_text(text) {}
+
+    // Adds the times of each result to 'results'.  Returns false if
+    // the text can't be parsed.
+    bool Read(BenchTimesMap &results)
+    {
+        if (!Expect('{'))
+            return false;
+        if (Peek() == '}')
+            return true;
+        for (;;)
+        {
+            std::string name;
+            if (!ReadString(name) || !Expect(':'))
+                return false;
+            if (name == "results")
+            {
+                if (!ReadResultsArray(results))
+                    return false;
+            }
+            else if (!SkipValue())
+            {
+                return false;
+            }
+
+            if (Peek() == ',')
+                ++m_pos;
+            else
+                return Expect('}');
+        }
+    }
+
+private:
+    const std::string &m_text;
+    size_t m_pos = 0;
+
+    // Returns the next character that isn't white space, without
+    // moving past it, or '\0' at the end of the text.
+    char Peek()
+    {
+        while (m_pos < m_text.size() && isspace(static_cast<unsigned char>(m_text[m_pos])))
+            ++m_pos;
+        return (m_pos < m_text.size()) ? m_text[m_pos] : '\0';
+    }
+
+    bool Expect(char c)
+    {
+        if (Peek() != c)
+            return false;
+        ++m_pos;
+        return true;
+    }
+
+    bool ReadString(std::string &value)
+    {
+        if (!Expect('"'))
+            return false;
+        value.clear();
+        while (m_pos < m_text.size() && m_text[m_pos] != '"')
+        {
+            if (m_text[m_pos] == '\\' && m_pos + 1 < m_text.size())
+                ++m_pos;
+            value += m_text[m_pos++];
+        }
+        return Expect('"');
+    }
+
+    bool ReadNumber(double &value)
+    {
+        Peek();
+        const char *start = m_text.c_str() + m_pos;
+        char *end = nullptr;
+        value = strtod(start, &end);
+        if (end == start)
+            return false;
+        m_pos += end - start;
+        return true;
+    }
+
+    // Skips over a value of any kind.
+    bool SkipValue()
+    {
+        char c = Peek();
+        if (c == '"')
+        {
+            std::string ignored;
+            return ReadString(ignored);
+        }
+        if (c == '{' || c == '[')
+        {
+            char close = (c == '{') ? '}' : ']';
+            ++m_pos;
+            if (Peek() == close)
+                return Expect(close);
+            for (;;)
+            {
+                if (c == '{')
+                {
+                    std::string ignored;
+                    if (!ReadString(ignored) || !Expect(':'))
+                        return false;
+                }
+                if (!SkipValue())
+                    return false;
+                if (Peek() != ',')
+                    return Expect(close);
+                ++m_pos;
+            }
+        }
+        if (m_text.compare(m_pos, 4, "true") == 0 || m_text.compare(m_pos, 4, "null") == 0)
+        {
+            m_pos += 4;
+            return true;
+        }
+        if (m_text.compare(m_pos, 5, "false") == 0)
+        {
+            m_pos += 5;
+            return true;
+        }
+        double ignored;
+        return ReadNumber(ignored);
+    }
+
+    bool ReadResultsArray(BenchTimesMap &results)
+    {
+        if (!Expect('['))
+            return false;
+        if (Peek() == ']')
+            return Expect(']');
+        for (;;)
+        {
+            if (!ReadResult(results))
+                return false;
+            if (Peek() != ',')
+                return Expect(']');
+            ++m_pos;
+        }
+    }
+
+    // Reads one result, and adds its times to those of the benchmark
+    // it's for.  The times are the "samples" array if there is one,
+    // otherwise the single "ns_per_sample" or "wall_seconds" value.
+    bool ReadResult(BenchTimesMap &results)
+    {
+        std::map<std::string, std::string> fields;
+        std::vector<double> samples;
+        if (!Expect('{'))
+            return false;
+        while (Peek() != '}')
+        {
+            std::string name;
+            if (!ReadString(name) || !Expect(':'))
+                return false;
+
+            char c = Peek();
+            if (c == '"')
+            {
+                if (!ReadString(fields[name]))
+                    return false;
+            }
+            else if (c == '[' && name == "samples")
+            {
+                ++m_pos;
+                while (Peek() != ']')
+                {
+                    double value = 0.0;
+                    if (!ReadNumber(value))
+                        return false;
+                    samples.push_back(value);
+                    if (Peek() == ',')
+                        ++m_pos;
+                }
+                ++m_pos;
+            }
+            else if (c == '-' || isdigit(static_cast<unsigned char>(c)))
+            {
+                size_t start = m_pos;
+                double ignored;
+                if (!ReadNumber(ignored))
+                    return false;
+                fields[name] = m_text.substr(start, m_pos - start);
+            }
+            else if (!SkipValue())
+            {
+                return false;
+            }
+
+            if (Peek() == ',')
+                ++m_pos;
+        }
+        ++m_pos;
+
+        // Bench's results are told apart by name and size, and
+        // ToolBench's by tool and file.
+        std::string key;
+        if (!fields["name"].empty())
+            key = fields["name"] + " [" + fields["frames"] + "x" + fields["channels"] + "]";
+        else if (!fields["tool"].empty())
+            key = fields["tool"] + " " + fields["file"];
+        else
+            return true;
+
+        // A program that failed has no meaningful time.
+        if (!fields["exit_code"].empty() && fields["exit_code"] != "0")
+            return true;
+
+        if (samples.empty())
+        {
+            const std::string &value = !fields["ns_per_sample"].empty() ? fields["ns_per_sample"] : fields["wall_seconds"];
+            if (value.empty())
+                return true;
+            samples.push_back(strtod(value.c_str(), nullptr));
+        }
+
+        BenchTimes &times = results[key];
+        times.m_times.insert(times.m_times.end(), samples.begin(), samples.end());
+        times.m_runMedians.push_back(Median(samples));
+        return true;
+    }
+};
+
+// Reads a result file, adding its times to 'results'.  Returns false
+// after printing a message if it can't be read.
+static bool ReadResultsFile(const std::wstring &filename, BenchTimesMap &results)
+{
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename.c_str(), L"rb") != 0 || fp == nullptr)
+    {
+        printname();
+        printf("Failed opening '%S'\n", filename.c_str());
+        return false;
+    }
+
+    std::string text;
+    char buffer[65536];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        text.append(buffer, count);
+    fclose(fp);
+
+    ResultsReader reader(text);
+    if (!reader.Read(results))
+    {
+        printname();
+        printf("Failed parsing the results in '%S'\n", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+//
+// Returns the probability that times at least as much slower than the
+// baseline as 'current' is would come about by chance, if the two
+// were from the same distribution.  This is the one-sided Mann-Whitney
+// U test, using the normal approximation with the correction for
+// ties.  It doesn't assume the times are normally distributed, which
+// they seldom are, since a run can be slowed by other things going
+// on but never sped up by them.
+//
+static double SlowerProbability(const std::vector<double> &baseline, const std::vector<double> &current)
+{
+    // Rank all of the times together, giving tied times the average
+    // of their ranks.
+    std::vector<std::pair<double, bool>> all;
+    for (double time : baseline)
+        all.push_back(std::make_pair(time, false));
+    for (double time : current)
+        all.push_back(std::make_pair(time, true));
+    std::sort(all.begin(), all.end());
+
+    double n = static_cast<double>(all.size());
+    double currentRankSum = 0.0;
+    double tieSum = 0.0;
+    for (size_t first = 0; first < all.size(); )
+    {
+        size_t last = first;
+        while (last + 1 < all.size() && all[last + 1].first == all[first].first)
+            ++last;
+        double rank = (first + last) / 2.0 + 1.0;
+        for (size_t index = first; index <= last; index++)
+        {
+            if (all[index].second)
+                currentRankSum += rank;
+        }
+        double ties = static_cast<double>(last - first + 1);
+        tieSum += ties * ties * ties - ties;
+        first = last + 1;
+    }
+
+    double nb = static_cast<double>(baseline.size());
+    double nc = static_cast<double>(current.size());
+    double u = currentRankSum - nc * (nc + 1.0) / 2.0;
+    double mean = nb * nc / 2.0;
+    double variance = nb * nc / 12.0 * ((n + 1.0) - tieSum / (n * (n - 1.0)));
+    if (variance <= 0.0)
+        return 1.0;
+
+    double z = (u - mean - 0.5) / sqrt(variance);
+    return 0.5 * erfc(z / sqrt(2.0));
+}
+
+// Compares the times of each benchmark in the current results with
+// those in the baseline, printing a line for each.  Returns the
+// number of regressions found.
+static unsigned CompareResults(const ProgramSettings &settings, const BenchTimesMap &baseline, const BenchTimesMap &current)
+{
+    unsigned regressions = 0;
+    unsigned improvements = 0;
+    unsigned untested = 0;
+    unsigned pooled = 0;
+    unsigned missing = 0;
+
+    printf("%-52s %12s %12s %8s %8s\n", "Benchmark", "Baseline", "Current", "Change", "p");
+    for (const auto &entry : current)
+    {
+        auto base = baseline.find(entry.first);
+        if (base == baseline.end() || base->second.m_times.empty() || entry.second.m_times.empty())
+        {
+            printf("%-52s %12s %12.4f %8s %8s  (new)\n", entry.first.c_str(), "-", Median(entry.second.m_times), "", "");
+            continue;
+        }
+
+        // Use the median of each run if there are enough runs,
+        // otherwise all of the times.
+        bool byRun = (base->second.m_runMedians.size() >= kMinRunsForRunTest &&
+                      entry.second.m_runMedians.size() >= kMinRunsForRunTest);
+        const std::vector<double> &baseTimes = byRun ? base->second.m_runMedians : base->second.m_times;
+        const std::vector<double> &currentTimes = byRun ? entry.second.m_runMedians : entry.second.m_times;
+        double baseMedian = Median(baseTimes);
+        double currentMedian = Median(currentTimes);
+        double change = (baseMedian > 0.0) ? (currentMedian / baseMedian - 1.0) * 100.0 : 0.0;
+
+        // With fewer than three times on either side, no difference
+        // can be significant, so only the threshold is checked.
+        bool tested = (baseTimes.size() >= 3 && currentTimes.size() >= 3);
+        double slower = tested ? SlowerProbability(baseTimes, currentTimes) : 0.0;
+        double faster = tested ? SlowerProbability(currentTimes, baseTimes) : 0.0;
+
+        const char *verdict = "";
+        if (change > settings.m_thresholdPercent && slower < settings.m_alpha)
+        {
+            verdict = "  REGRESSION";
+            ++regressions;
+        }
+        else if (change < -settings.m_thresholdPercent && faster < settings.m_alpha)
+        {
+            verdict = "  (faster)";
+            ++improvements;
+        }
+        if (!tested)
+            ++untested;
+        else if (!byRun)
+            ++pooled;
+
+        char probability[16] = "-";
+        if (tested)
+            snprintf(probability, sizeof(probability), "%.4f", (change >= 0.0) ? slower : faster);
+        printf("%-52s %12.4f %12.4f %+7.1f%% %8s%s\n",
+            entry.first.c_str(), baseMedian, currentMedian, change, probability, verdict);
+    }
+
+    for (const auto &entry : baseline)
+    {
+        if (current.find(entry.first) == current.end())
+        {
+            printf("%-52s %12.4f %12s %8s %8s  (missing)\n", entry.first.c_str(), Median(entry.second.m_times), "-", "", "");
+            ++missing;
+        }
+    }
+    fflush(stdout);
+
+    printname();
+    printf("%zu benchmark(s) compared, %u regression(s), %u faster, %u missing from the current results\n",
+        current.size(), regressions, improvements, missing);
+    if (untested)
+    {
+        printname();
+        printf("%u benchmark(s) had fewer than 3 times on a side, so were checked against the threshold alone\n", untested);
+    }
+    if (pooled)
+    {
+        printname();
+        printf("%u benchmark(s) were tested on the times within single runs, which can make differences\n", pooled);
+        printname();
+        printf("  between runs look significant; compare several runs on each side to avoid that\n");
+    }
+    return regressions;
+}
+
+static void PrintUsage()
+{
+    printf(
+        "\n"
+        "Description:  BenchCompare compares the results of Bench or \n"
+        "  ToolBench with a baseline, such as results saved from the \n"
+        "  last release, and reports which benchmarks have become \n"
+        "  slower.  A benchmark has regressed if its median time has \n"
+        "  grown by more than a threshold, and a statistical test of \n"
+        "  the individual run times (the one-sided Mann-Whitney U test) \n"
+        "  shows the growth is unlikely to be due to chance.  The exit \n"
+        "  code is nonzero if any benchmark has regressed, so this can \n"
+        "  be used as a check before a change is committed. \n"
+        "\n"
+        "Usage:  benchcompare [options] baseline.json current.json\n"
+        "\n"
+        "Either file name may also be a list of names separated by \n"
+        "  commas, for the results of repeated runs.  With 3 or more \n"
+        "  runs on each side, the test compares the median times of \n"
+        "  the runs, which allows for the way times vary from one run \n"
+        "  to the next; at least 5 runs on each side are needed for a \n"
+        "  difference to be significant at the default level.  With \n"
+        "  fewer, the test compares the times of all of the runs \n"
+        "  pooled together. \n"
+        "\n"
+        "Options:\n"
+        "  -Threshold=x : The percentage by which a benchmark's median \n"
+        "       time has to grow to be a regression.  The default is 10. \n"
+        "\n"
+        "  -Alpha=x : The significance level of the test.  The default \n"
+        "       is 0.01. \n"
+        "\n"
+        "  -Help : Print this usage information to the console.\n"
+        );
+}
+
+// Splits a list of file names separated by commas.
+static std::vector<std::wstring> SplitFilenames(const wchar_t *text)
+{
+    std::vector<std::wstring> filenames(1, std::wstring());
+    for (const wchar_t *p = text; *p != '\0'; p++)
+    {
+        if (*p == ',')
+            filenames.push_back(std::wstring());
+        else
+            filenames.back() += *p;
+    }
+    filenames.erase(std::remove(filenames.begin(), filenames.end(), std::wstring()), filenames.end());
+    return filenames;
+}
+
+// Parses the program's command line arguments, placing the
+// selected options into the settings structure.  Returns
+// true if successful.
+static bool ParseCommandLineArguments(
+    int argc,
+    wchar_t **argv,
+    ProgramSettings &settings
+    )
+{
+    if (argc < 2)
+    {
+        PrintUsage();
+        return false;
+    }
+
+    for (int iarg = 1; iarg < argc; iarg++)
+    {
+        if (IsOption(argv[iarg]))
+        {
+            if (OptionNameIs(argv[iarg], L"Help") || OptionNameIs(argv[iarg], L"?"))
+            {
+                PrintUsage();
+                return false;
+            }
+            else if (OptionNameIs(argv[iarg], L"Threshold"))
+            {
+                settings.m_thresholdPercent = _wtof(OptionValue(argv[iarg]));
+                if (settings.m_thresholdPercent < 0.0 || settings.m_thresholdPercent > 1000.0)
+                {
+                    printname();
+                    printf("Invalid threshold '%S'\n", argv[iarg]);
+                    return false;
+                }
+            }
+            else if (OptionNameIs(argv[iarg], L"Alpha"))
+            {
+                settings.m_alpha = _wtof(OptionValue(argv[iarg]));
+                if (settings.m_alpha <= 0.0 || settings.m_alpha >= 1.0)
+                {
+                    printname();
+                    printf("Invalid significance level '%S'\n", argv[iarg]);
+                    return false;
+                }
+            }
+            else
+            {
+                printname();
+                printf("Unrecognized option '%S'\n", argv[iarg]);
+                return false;
+            }
+        }
+        else if (settings.m_baselineFilenames.empty())
+        {
+            settings.m_baselineFilenames = SplitFilenames(argv[iarg]);
+        }
+        else if (settings.m_currentFilenames.empty())
+        {
+            settings.m_currentFilenames = SplitFilenames(argv[iarg]);
+        }
+        else
+        {
+            printname();
+            printf("Too many arguments! (\"%S\")\n", argv[iarg]);
+            return false;
+        }
+    }
+
+    if (settings.m_baselineFilenames.empty() || settings.m_currentFilenames.empty())
+    {
+        printname();
+        printf("Not enough arguments!\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Application entry point.
+int wmain(int argc, wchar_t **argv)
+{
+    ProgramSettings settings;
+    if (!ParseCommandLineArguments(argc, argv, settings))
+        return EXIT_FAILURE;
+
+    unsigned regressions = 0;
+    try
+    {
+        BenchTimesMap baseline;
+        for (const std::wstring &filename : settings.m_baselineFilenames)
+        {
+            if (!ReadResultsFile(filename, baseline))
+                return EXIT_FAILURE;
+        }
+
+        BenchTimesMap current;
+        for (const std::wstring &filename : settings.m_currentFilenames)
+        {
+            if (!ReadResultsFile(filename, current))
+                return EXIT_FAILURE;
+        }
+
+        regressions = CompareResults(settings, baseline, current);
+    }
+    catch(...)
+    {
+        printname();
+        printf("Unexpected program exception!\n");
+        return EXIT_FAILURE;
+    }
+
+    if (regressions)
+    {
+        printname();
+        printf("Exiting with %u regression(s)!\n", regressions);
+        return EXIT_FAILURE;
+    }
+
+    printname();
+    printf("Completed OK.\n");
+    return EXIT_SUCCESS;
+}
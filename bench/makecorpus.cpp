@@ -0,0 +1,507 @@
+//-------------------------------------------------------------------
+//
+// makecorpus.cpp
+// Program to generate a set of synthetic audio files for measuring
+// the speed of the WaveTools programs.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+
+#include "waveform.h"
+#include "waveformload.h"
+#include "waveformsave.h"
+#include "cmdopt.h"
+#include "platform.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <wchar.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// The kinds of signal the corpus files can hold.
+enum class CorpusSignal
+{
+    Sweep,      // Repeating sine sweeps from 20 Hz to 20 kHz.
+    Noise,      // White noise.
+    Speech      // Bursts of voiced sound, like syllables, with pauses.
+};
+
+static const wchar_t *const kSignalNames[] = { L"sweep", L"noise", L"speech" };
+
+// A sample format of the corpus files:  its name, and how it's saved.
+struct CorpusFormat
+{
+    const wchar_t *m_name;
+    bool m_isFloat;
+    unsigned m_bytesPerSample;
+};
+
+static const CorpusFormat kFormats[] =
+{
+    { L"8",   false, 1 },
+    { L"16",  false, 2 },
+    { L"24",  false, 3 },
+    { L"32f", true,  4 },
+};
+
+struct ProgramSettings
+{
+    // Directory to write the corpus files to.
+    std::wstring m_directory;
+
+    // Which files to make.  Every combination of these is made.
+    std::vector<CorpusSignal> m_signals = { CorpusSignal::Sweep, CorpusSignal::Noise, CorpusSignal::Speech };
+    std::vector<size_t> m_channels = { 1, 2, 8 };
+    std::vector<const CorpusFormat *> m_formats = { &kFormats[0], &kFormats[1], &kFormats[2], &kFormats[3] };
+    std::vector<size_t> m_lengths = { 1, 10, 60 };     // In seconds.
+
+    unsigned m_rate = 48000;
+
+    // If true, files that already exist are made again; otherwise
+    // they're kept if they have the right format and length.
+    bool m_force = false;
+};
+
+// Print the program name prefix to stdout.
+const wchar_t *program_name = L"MakeCorpus";
+static void printname() { printf("%S:  ", program_name); }
+
+//
+// Generates the samples of a corpus file a block at a time.  Every
+// value comes from the position in the file and a simple random
+// number generator with a fixed seed, so the same file is made on
+// every machine and every run.
+//
+class SignalGenerator
+{
+public:
+    SignalGenerator(CorpusSignal signal, unsigned rate, size_t numChannels, size_t numSamples) :
+        m_signal(signal), m_rate(rate), m_numChannels(numChannels), m_numSamples(numSamples)
+    {
+    }
+
+    // Callback for WaveformSaveInBlocks.
+    static bool FillBlock(void *context, float *samples, size_t maxFrames, size_t &numFrames)
+    {
+        SignalGenerator *generator = reinterpret_cast<SignalGenerator *>(context);
+        numFrames = std::min(maxFrames, generator->m_numSamples - generator->m_position);
+        for (size_t frame = 0; frame < numFrames; frame++)
+            generator->NextFrame(samples + frame * generator->m_numChannels);
+        return true;
+    }
+
+private:
+    // Returns a random number from 0 up to (but not including) 1.
+    double Random()
+    {
+        m_seed = m_seed * 6364136223846793005ull + 1442695040888963407ull;
+        return static_cast<double>(m_seed >> 11) / 9007199254740992.0;
+    }
+
+    // Generates the samples of the next sample frame.
+    void NextFrame(float *frame)
+    {
+        double t = static_cast<double>(m_position) / m_rate;
+        for (size_t channel = 0; channel < m_numChannels; channel++)
+        {
+            double value = 0.0;
+            if (m_signal == CorpusSignal::Sweep)
+            {
+                // Each channel's sweep lags the one before by a tenth
+                // of a second, so the channels aren't all the same.
+                value = 0.5 * Sweep(t + 0.1 * channel);
+            }
+            else if (m_signal == CorpusSignal::Noise)
+            {
+                value = 0.6 * (Random() - 0.5);
+            }
+            else
+            {
+                // The same voice in each channel, at a different level,
+                // as if picked up by microphones at different distances.
+                if (channel == 0)
+                    m_speechValue = Speech();
+                value = m_speechValue / (1.0 + 0.25 * channel);
+            }
+            frame[channel] = static_cast<float>(value);
+        }
+        m_position++;
+    }
+
+    // Returns the value of a sine sweep from 20 Hz to 20 kHz that
+    // repeats every ten seconds, at time 't'.
+    static double Sweep(double t)
+    {
+        const double kPeriod = 10.0;
+        const double kLowFreq = 20.0;
+        const double kRatio = log(20000.0 / kLowFreq);
+        const double pi = 3.14159265358979;
+        t = fmod(t, kPeriod);
+        double phase = 2.0 * pi * kLowFreq * kPeriod / kRatio * (exp(t / kPeriod * kRatio) - 1.0);
+        return sin(phase);
+    }
+
+    // Returns the next sample of the speech-like signal:  syllables of
+    // 80 to 300 milliseconds, each with its own pitch, with a few
+    // harmonics shaped by a rising and falling envelope, separated by
+    // pauses of 30 to 400 milliseconds.
+    double Speech()
+    {
+        const double pi = 3.14159265358979;
+        if (m_burstRemaining == 0)
+        {
+            if (m_pauseRemaining > 0)
+            {
+                m_pauseRemaining--;
+                return 0.0;
+            }
+            m_burstLength = static_cast<size_t>((0.08 + 0.22 * Random()) * m_rate);
+            m_burstRemaining = m_burstLength;
+            m_pauseRemaining = static_cast<size_t>((0.03 + 0.37 * Random()) * m_rate);
+            m_pitch = 90.0 + 160.0 * Random();
+        }
+
+        double position = static_cast<double>(m_burstLength - m_burstRemaining) / m_burstLength;
+        double envelope = 0.5 - 0.5 * cos(2.0 * pi * position);
+        m_burstRemaining--;
+
+        m_phase += 2.0 * pi * m_pitch / m_rate;
+        if (m_phase > 2.0 * pi)
+            m_phase -= 2.0 * pi;
+
+        double value = 0.0;
+        for (int harmonic = 1; harmonic <= 6; harmonic++)
+            value += sin(m_phase * harmonic) / harmonic;
+        return 0.4 * envelope * value;
+    }
+
+    CorpusSignal m_signal;
+    unsigned m_rate;
+    size_t m_numChannels;
+    size_t m_numSamples;
+    size_t m_position = 0;
+    uint64_t m_seed = 0x5eed;
+
+    // State of the speech-like signal.
+    double m_speechValue = 0.0;
+    double m_pitch = 0.0;
+    double m_phase = 0.0;
+    size_t m_burstLength = 0;
+    size_t m_burstRemaining = 0;
+    size_t m_pauseRemaining = 0;
+};
+
+// Makes one corpus file, unless it already exists with the right
+// format and length.  Returns true if successful.
+static bool MakeCorpusFile(const ProgramSettings &settings, CorpusSignal signal,
+                           size_t numChannels, const CorpusFormat &format, size_t seconds)
+{
+    std::wstring filename = settings.m_directory;
+    if (!filename.empty() && filename.back() != '\\' && filename.back() != '/')
+        filename += kPathSeparator;
+    filename += std::wstring(kSignalNames[static_cast<int>(signal)]) + L"_" +
+        std::to_wstring(numChannels) + L"ch_" + format.m_name + L"_" +
+        std::to_wstring(seconds) + L"s.wav";
+
+    size_t numSamples = seconds * settings.m_rate;
+    WaveformFileInfo info;
+    if (!settings.m_force && WaveformReadFileInfo(filename.c_str(), info) &&
+        info.m_numSamples == numSamples && info.m_numChannels == numChannels &&
+        info.m_rate == settings.m_rate && info.m_bitsPerSample == format.m_bytesPerSample * 8)
+    {
+        printname();
+        printf("Keeping '%S'\n", filename.c_str());
+        return true;
+    }
+
+    printname();
+    printf("Making '%S'\n", filename.c_str());
+    fflush(stdout);
+
+    SignalGenerator generator(signal, settings.m_rate, numChannels, numSamples);
+    if (!WaveformSaveInBlocks(filename.c_str(), settings.m_rate, numChannels, numSamples,
+            SignalGenerator::FillBlock, &generator, nullptr, nullptr,
+            format.m_isFloat, format.m_bytesPerSample))
+    {
+        printname();
+        printf("Failed writing '%S'\n", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+static void PrintUsage()
+{
+    printf(
+        "\n"
+        "Description:  MakeCorpus writes a set of synthetic WAV files for \n"
+        "  measuring the speed of the WaveTools programs with ToolBench. \n"
+        "  A file is made for every combination of signal, channel \n"
+        "  count, sample format, and length, named like \n"
+        "  'speech_2ch_16_60s.wav'.  The files are the same every time \n"
+        "  they're made. \n"
+        "\n"
+        "Usage:  makecorpus [options] directory\n"
+        "\n"
+        "Options:\n"
+        "  -Signals=x : The signals to make files of, separated by \n"
+        "       commas:  'sweep' (sine sweeps), 'noise' (white noise), \n"
+        "       and/or 'speech' (bursts of speech-like sound).  The \n"
+        "       default is all three. \n"
+        "\n"
+        "  -Channels=x : The channel counts, separated by commas.  The \n"
+        "       default is '1,2,8'. \n"
+        "\n"
+        "  -Formats=x : The sample formats, separated by commas:  '8', \n"
+        "       '16', or '24' for integer samples of that many bits, or \n"
+        "       '32f' for floating-point samples.  The default is all \n"
+        "       four. \n"
+        "\n"
+        "  -Lengths=x : The lengths of the files in seconds, separated \n"
+        "       by commas.  The default is '1,10,60'.  For measuring \n"
+        "       how the programs scale, longer files can be made, up to \n"
+        "       '7200' (two hours); these take a lot of disk space. \n"
+        "\n"
+        "  -Rate=x : The sample rate in Hertz.  The default is 48000. \n"
+        "\n"
+        "  -Force : Makes every file again, even if it already exists. \n"
+        "\n"
+        "  -Help : Print this usage information to the console.\n"
+        );
+}
+
+// Parses a list of numbers separated by commas.  Returns false if
+// any of them isn't a positive number.
+static bool ParseNumberList(const wchar_t *text, std::vector<size_t> &numbers)
+{
+    numbers.clear();
+    while (*text != '\0')
+    {
+        wchar_t *end = nullptr;
+        unsigned long long value = wcstoull(text, &end, 10);
+        if (end == text || value == 0 || (*end != ',' && *end != '\0'))
+            return false;
+        numbers.push_back(static_cast<size_t>(value));
+        text = (*end == ',') ? end + 1 : end;
+    }
+    return !numbers.empty();
+}
+
+// Splits a list of names separated by commas.
+static std::vector<std::wstring> SplitList(const wchar_t *text)
+{
+    std::vector<std::wstring> names(1);
+    for (; *text != '\0'; text++)
+    {
+        if (*text == ',')
+            names.push_back(std::wstring());
+        else
+            names.back() += *text;
+    }
+    return names;
+}
+
+// Parses the program's command line arguments, placing the
+// selected options into the settings structure.  Returns
+// true if successful.
+static bool ParseCommandLineArguments(
+    int argc,
+    wchar_t **argv,
+    ProgramSettings &settings
+    )
+{
+    if (argc < 2)
+    {
+        PrintUsage();
+        return false;
+    }
+
+    for (int iarg = 1; iarg < argc; iarg++)
+    {
+        if (IsOption(argv[iarg]))
+        {
+            if (OptionNameIs(argv[iarg], L"Help") || OptionNameIs(argv[iarg], L"?"))
+            {
+                PrintUsage();
+                return false;
+            }
+            else if (OptionNameIs(argv[iarg], L"Signals"))
+            {
+                settings.m_signals.clear();
+                for (const std::wstring &name : SplitList(OptionValue(argv[iarg])))
+                {
+                    size_t index = 0;
+                    while (index < _countof(kSignalNames) && _wcsicmp(name.c_str(), kSignalNames[index]) != 0)
+                        index++;
+                    if (index == _countof(kSignalNames))
+                    {
+                        printname();
+                        printf("Unknown signal '%S'\n", name.c_str());
+                        return false;
+                    }
+                    settings.m_signals.push_back(static_cast<CorpusSignal>(index));
+                }
+            }
+            else if (OptionNameIs(argv[iarg], L"Channels"))
+            {
+                if (!ParseNumberList(OptionValue(argv[iarg]), settings.m_channels))
+                {
+                    printname();
+                    printf("Invalid channel counts '%S'\n", argv[iarg]);
+                    return false;
+                }
+            }
+            else if (OptionNameIs(argv[iarg], L"Formats"))
+            {
+                settings.m_formats.clear();
+                for (const std::wstring &name : SplitList(OptionValue(argv[iarg])))
+                {
+                    size_t index = 0;
+                    while (index < _countof(kFormats) && _wcsicmp(name.c_str(), kFormats[index].m_name) != 0)
+                        index++;
+                    if (index == _countof(kFormats))
+                    {
+                        printname();
+                        printf("Unknown sample format '%S'\n", name.c_str());
+                        return false;
+                    }
+                    settings.m_formats.push_back(&kFormats[index]);
+                }
+            }
+            else if (OptionNameIs(argv[iarg], L"Lengths"))
+            {
+                if (!ParseNumberList(OptionValue(argv[iarg]), settings.m_lengths))
+                {
+                    printname();
+                    printf("Invalid lengths '%S'\n", argv[iarg]);
+                    return false;
+                }
+            }
+            else if (OptionNameIs(argv[iarg], L"Rate"))
+            {
+                settings.m_rate = static_cast<unsigned>(_wtoi(OptionValue(argv[iarg])));
+                if (settings.m_rate < 1000 || settings.m_rate > 384000)
+                {
+                    printname();
+                    printf("Invalid sample rate '%S'\n", argv[iarg]);
+                    return false;
+                }
+            }
+            else if (OptionNameIs(argv[iarg], L"Force"))
+            {
+                settings.m_force = true;
+            }
+            else
+            {
+                printname();
+                printf("Unrecognized option '%S'\n", argv[iarg]);
+                return false;
+            }
+        }
+        else if (settings.m_directory.empty())
+        {
+            settings.m_directory = argv[iarg];
+        }
+        else
+        {
+            printname();
+            printf("Too many arguments! (\"%S\")\n", argv[iarg]);
+            return false;
+        }
+    }
+
+    if (settings.m_directory.empty())
+    {
+        printname();
+        printf("Not enough arguments!\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Application entry point.
+int wmain(int argc, wchar_t **argv)
+{
+    ProgramSettings settings;
+    if (!ParseCommandLineArguments(argc, argv, settings))
+        return EXIT_FAILURE;
+
+    // Say up front how much disk space the corpus needs.
+    unsigned long long totalBytes = 0;
+    for (size_t channels : settings.m_channels)
+        for (const CorpusFormat *format : settings.m_formats)
+            for (size_t seconds : settings.m_lengths)
+                totalBytes += static_cast<unsigned long long>(seconds) * settings.m_rate * channels * format->m_bytesPerSample;
+    totalBytes *= settings.m_signals.size();
+    printname();
+    printf("Corpus of %zu files takes %.1f MB in '%S'\n",
+        settings.m_signals.size() * settings.m_channels.size() * settings.m_formats.size() * settings.m_lengths.size(),
+        totalBytes / 1048576.0, settings.m_directory.c_str());
+    fflush(stdout);
+
+    unsigned error_count = 0;
+    try
+    {
+        for (CorpusSignal signal : settings.m_signals)
+            for (size_t channels : settings.m_channels)
+                for (const CorpusFormat *format : settings.m_formats)
+                    for (size_t seconds : settings.m_lengths)
+                        if (!MakeCorpusFile(settings, signal, channels, *format, seconds))
+                            ++error_count;
+    }
+    catch(...)
+    {
+        printname();
+        printf("Unexpected program exception!\n");
+        return EXIT_FAILURE;
+    }
+
+    if (error_count)
+    {
+        printname();
+        printf("Exiting with %u error(s)!\n", error_count);
+        return EXIT_FAILURE;
+    }
+
+    printname();
+    printf("Completed OK.\n");
+    return EXIT_SUCCESS;
+}
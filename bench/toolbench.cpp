@@ -0,0 +1,659 @@
+//-------------------------------------------------------------------
+//
+// toolbench.cpp
+// Program to measure the speed, memory use, and file I/O of each of
+// the WaveTools programs on a corpus of audio files.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+#include "waveform.h"
+#include "waveformload.h"
+#include "waveformbatch.h"
+#include "cmdopt.h"
+#include "platform.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <wchar.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+static const wchar_t *const kExeSuffix = L".exe";
+#else
+static const wchar_t *const kExeSuffix = L"";
+#endif
+
+// How each program is run.  In the arguments, "{in}" stands for the
+// corpus file and "{out}" for the output file.  The settings are
+// typical ones, chosen so every program does its full amount of work
+// on every file.
+struct ToolCommand
+{
+    const wchar_t *m_tool;
+    const wchar_t *m_args;
+};
+
+static const ToolCommand kToolCommands[] =
+{
+    { L"wavechain",     L"{in} {out} eq 3000 100 volume 0.8 fade 1 1" },
+    { L"wavecompare",   L"{in} {in}" },
+    { L"waveconvert",   L"-BytesPerSample=3 {in} {out}" },
+    { L"waveecho",      L"250 3 {in} {out}" },
+    { L"waveeq",        L"3000 100 -NotchFreq=1000 {in} {out}" },
+    { L"waveextend",    L"-UseTime 1 1 {in} {out}" },
+    { L"wavefade",      L"1 1 {in} {out}" },
+    { L"wavegate",      L"{in} {out}" },
+    { L"waveinfo",      L"-Stats {in}" },
+    { L"wavejoin",      L"{in} {in} {out}" },
+    { L"wavemix",       L"{out} {in},0.5 {in},0.5,0.5" },
+    { L"wavenormalize", L"-1 {in} {out}" },
+    { L"waveprint",     L"-UseTime -PerLine=1 {in}" },
+    { L"waverate",      L"44100 {in} {out}" },
+    { L"wavereverb",    L"0.5 {in} {out}" },
+    { L"wavestretch",   L"1.25 {in} {out}" },
+    { L"wavetremolo",   L"-UseTime 0.25 0.5 {in} {out}" },
+    { L"wavetrim",      L"-UseTime -Start=0.25 -Count=0.25 {in} {out}" },
+    { L"wavevibrato",   L"0.25 2 {in} {out}" },
+    { L"wavevolume",    L"0.8 {in} {out}" },
+};
+
+struct ProgramSettings
+{
+    // The corpus files, as given on the command line (files,
+    // directories, wildcards, or @lists).
+    std::vector<std::wstring> m_inputs;
+
+    // Where the programs are, and where their output files go.
+    std::wstring m_toolDirectory;
+    std::wstring m_workDirectory;
+
+    // Name of the file to write the results to, as JSON.
+    std::wstring m_outFilename = L"toolbench.json";
+
+    // If not empty, only these programs are run.
+    std::vector<std::wstring> m_tools;
+
+    // If not empty, only the corpus files whose names contain this
+    // text are used.
+    std::wstring m_only;
+};
+
+// Print the program name prefix to stdout.
+const wchar_t *program_name = L"ToolBench";
+static void printname() { printf("%S:  ", program_name); }
+
+// What was measured while running a program.
+struct ProcessStats
+{
+    int m_exitCode = -1;
+    double m_wallSeconds = 0.0;
+    uint64_t m_peakMemory = 0;      // Peak resident set (working set) size in bytes.
+    uint64_t m_bytesRead = 0;       // By all of the program's read calls, cached or not.
+    uint64_t m_bytesWritten = 0;
+};
+
+// The results of running one program on one corpus file.
+struct ToolResult
+{
+    std::wstring m_tool;
+    std::wstring m_file;            // Name of the corpus file, without its directory.
+    WaveformFileInfo m_info;
+    ProcessStats m_stats;
+};
+
+#ifdef _WIN32
+
+// Runs a program with the given arguments (the first being the
+// program's path), with its output thrown away, and waits for it to
+// finish.  Returns false if it couldn't be started.
+static bool RunProcess(const std::vector<std::wstring> &args, ProcessStats &stats)
+{
+    std::wstring commandLine;
+    for (const std::wstring &arg : args)
+    {
+        if (!commandLine.empty())
+            commandLine += L" ";
+        if (arg.empty() || arg.find_first_of(L" \t") != std::wstring::npos)
+            commandLine += L"\"" + arg + L"\"";
+        else
+            commandLine += arg;
+    }
+
+    SECURITY_ATTRIBUTES sa = { sizeof(sa), nullptr, TRUE };
+    HANDLE nul = CreateFileW(L"NUL", GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, &sa, OPEN_EXISTING, 0, nullptr);
+    if (nul == INVALID_HANDLE_VALUE)
+        return false;
+
+    STARTUPINFOW si = {};
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    si.hStdOutput = nul;
+    si.hStdError = nul;
+
+    PROCESS_INFORMATION pi = {};
+    auto start = std::chrono::steady_clock::now();
+    if (!CreateProcessW(args[0].c_str(), &commandLine[0], nullptr, nullptr, TRUE, 0, nullptr, nullptr, &si, &pi))
+    {
+        CloseHandle(nul);
+        return false;
+    }
+    WaitForSingleObject(pi.hProcess, INFINITE);
+    auto end = std::chrono::steady_clock::now();
+    stats.m_wallSeconds = std::chrono::duration<double>(end - start).count();
+
+    DWORD exitCode = 0;
+    if (GetExitCodeProcess(pi.hProcess, &exitCode))
+        stats.m_exitCode = static_cast<int>(exitCode);
+
+    PROCESS_MEMORY_COUNTERS memory = {};
+    if (GetProcessMemoryInfo(pi.hProcess, &memory, sizeof(memory)))
+        stats.m_peakMemory = memory.PeakWorkingSetSize;
+
+    IO_COUNTERS io = {};
+    if (GetProcessIoCounters(pi.hProcess, &io))
+    {
+        stats.m_bytesRead = io.ReadTransferCount;
+        stats.m_bytesWritten = io.WriteTransferCount;
+    }
+
+    CloseHandle(pi.hThread);
+    CloseHandle(pi.hProcess);
+    CloseHandle(nul);
+    return true;
+}
+
+#else
+
+// Converts a wide string to the multibyte form the system calls take.
+static std::string NarrowString(const std::wstring &text)
+{
+    std::string result(text.size() * MB_CUR_MAX + 1, '\0');
+    size_t length = wcstombs(&result[0], text.c_str(), result.size());
+    result.resize(length == static_cast<size_t>(-1) ? 0 : length);
+    return result;
+}
+
+// Runs a program with the given arguments (the first being the
+// program's path), with its output thrown away, and waits for it to
+// finish.  Returns false if it couldn't be started.  The I/O counts
+// come from /proc, so they're only filled in on Linux.
+static bool RunProcess(const std::vector<std::wstring> &args, ProcessStats &stats)
+{
+    std::vector<std::string> narrowArgs;
+    for (const std::wstring &arg : args)
+        narrowArgs.push_back(NarrowString(arg));
+    std::vector<char *> argv;
+    for (std::string &arg : narrowArgs)
+        argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0)
+        return false;
+    if (pid == 0)
+    {
+        int nul = open("/dev/null", O_WRONLY);
+        if (nul >= 0)
+        {
+            dup2(nul, 1);
+            dup2(nul, 2);
+        }
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    // Wait for the program to end, but leave it to be reaped until
+    // its I/O counts have been read.
+    siginfo_t info = {};
+    waitid(P_PID, static_cast<id_t>(pid), &info, WEXITED | WNOWAIT);
+    auto end = std::chrono::steady_clock::now();
+    stats.m_wallSeconds = std::chrono::duration<double>(end - start).count();
+
+    char ioPath[64];
+    snprintf(ioPath, sizeof(ioPath), "/proc/%d/io", static_cast<int>(pid));
+    FILE *fp = fopen(ioPath, "r");
+    if (fp != nullptr)
+    {
+        char line[128];
+        unsigned long long value = 0;
+        while (fgets(line, sizeof(line), fp) != nullptr)
+        {
+            if (sscanf(line, "rchar: %llu", &value) == 1)
+                stats.m_bytesRead = value;
+            else if (sscanf(line, "wchar: %llu", &value) == 1)
+                stats.m_bytesWritten = value;
+        }
+        fclose(fp);
+    }
+
+    int status = 0;
+    struct rusage usage = {};
+    if (wait4(pid, &status, 0, &usage) < 0)
+        return false;
+    stats.m_peakMemory = static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+    stats.m_exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    return stats.m_exitCode != 127;
+}
+
+#endif
+
+// Returns the part of a path after its directory.
+static std::wstring BaseName(const std::wstring &path)
+{
+    size_t slash = path.find_last_of(L"\\/");
+    return (slash == std::wstring::npos) ? path : path.substr(slash + 1);
+}
+
+// Returns the directory part of a path, with its separator, or an
+// empty string if there isn't one.
+static std::wstring DirectoryName(const std::wstring &path)
+{
+    size_t slash = path.find_last_of(L"\\/");
+    return (slash == std::wstring::npos) ? std::wstring() : path.substr(0, slash + 1);
+}
+
+// Makes the argument list for running a program on a corpus file.
+static std::vector<std::wstring> MakeToolArguments(const ProgramSettings &settings, const ToolCommand &command,
+                                                   const std::wstring &inFilename, const std::wstring &outFilename)
+{
+    std::vector<std::wstring> args(1, settings.m_toolDirectory + command.m_tool + kExeSuffix);
+    std::wstring arg;
+    for (const wchar_t *p = command.m_args; ; p++)
+    {
+        if (*p != ' ' && *p != '\0')
+        {
+            arg += *p;
+            continue;
+        }
+
+        for (size_t pos; (pos = arg.find(L"{in}")) != std::wstring::npos; )
+            arg.replace(pos, 4, inFilename);
+        for (size_t pos; (pos = arg.find(L"{out}")) != std::wstring::npos; )
+            arg.replace(pos, 5, outFilename);
+        args.push_back(arg);
+        arg.clear();
+        if (*p == '\0')
+            break;
+    }
+    return args;
+}
+
+// Returns true if the settings say to run the given program.
+static bool ToolSelected(const ProgramSettings &settings, const wchar_t *tool)
+{
+    if (settings.m_tools.empty())
+        return true;
+    for (const std::wstring &name : settings.m_tools)
+    {
+        if (_wcsicmp(name.c_str(), tool) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Returns the size in bytes of the given file, or zero if it isn't
+// there.
+static uint64_t GetFileSize(const std::wstring &filename)
+{
+    struct _stat64 st;
+    return (_wstat64(filename.c_str(), &st) == 0) ? static_cast<uint64_t>(st.st_size) : 0;
+}
+
+// Makes the directory the programs' output files go in, if it isn't
+// there already.  Returns true if successful.
+static bool MakeWorkDirectory(const std::wstring &directory)
+{
+    if (directory.empty())
+        return true;
+
+    // Windows won't stat a directory whose name has a trailing
+    // separator, unless it's the root.
+    std::wstring path(directory);
+    while (path.size() > 1 && (path.back() == '\\' || path.back() == '/') && path[path.size() - 2] != ':')
+        path.pop_back();
+
+    struct _stat64 st;
+    if (_wstat64(path.c_str(), &st) == 0)
+        return (st.st_mode & _S_IFMT) == _S_IFDIR;
+    return _wmkdir(path.c_str()) == 0;
+}
+
+// Runs each of the programs on each of the corpus files, adding the
+// results to 'results'.  A run fails if the program's exit code isn't
+// zero, or if it was meant to write a file and didn't, since not all
+// of them report that in their exit code.  Failed runs are left out
+// of the results, since their times don't mean anything.  Returns
+// the number of runs that failed.
+static unsigned RunToolBenchmarks(const ProgramSettings &settings, const std::vector<std::wstring> &filenames,
+                                  std::vector<ToolResult> &results)
+{
+    std::wstring outFilename = settings.m_workDirectory + L"toolbench_out.wav";
+    unsigned error_count = 0;
+    for (const std::wstring &filename : filenames)
+    {
+        if (!settings.m_only.empty() && BaseName(filename).find(settings.m_only) == std::wstring::npos)
+            continue;
+
+        ToolResult result;
+        result.m_file = BaseName(filename);
+        if (!WaveformReadFileInfo(filename.c_str(), result.m_info))
+        {
+            printname();
+            printf("Failed reading audio information from '%S'\n", filename.c_str());
+            ++error_count;
+            continue;
+        }
+
+        for (const ToolCommand &command : kToolCommands)
+        {
+            if (!ToolSelected(settings, command.m_tool))
+                continue;
+
+            result.m_tool = command.m_tool;
+            result.m_stats = ProcessStats();
+            std::vector<std::wstring> args = MakeToolArguments(settings, command, filename, outFilename);
+            _wremove(outFilename.c_str());
+            if (!RunProcess(args, result.m_stats))
+            {
+                printname();
+                printf("Failed running '%S'\n", args[0].c_str());
+                ++error_count;
+                continue;
+            }
+            bool wroteNothing = wcsstr(command.m_args, L"{out}") && GetFileSize(outFilename) == 0;
+            _wremove(outFilename.c_str());
+
+            const ProcessStats &stats = result.m_stats;
+            printname();
+            printf("%-14S %-28S %8.3f s %7.1f MB peak %9.1f MB in %9.1f MB out %8.1fx real time%s\n",
+                command.m_tool, result.m_file.c_str(), stats.m_wallSeconds,
+                stats.m_peakMemory / 1048576.0, stats.m_bytesRead / 1048576.0, stats.m_bytesWritten / 1048576.0,
+                result.m_info.GetDurationInSeconds() / stats.m_wallSeconds,
+                stats.m_exitCode != 0 ? "  FAILED" : wroteNothing ? "  FAILED (no output)" : "");
+            fflush(stdout);
+            if (stats.m_exitCode != 0 || wroteNothing)
+            {
+                ++error_count;
+                continue;
+            }
+
+            results.push_back(result);
+        }
+    }
+    return error_count;
+}
+
+// Writes the results to a JSON file.  Returns true if successful.
+static bool WriteResults(const wchar_t *filename, const std::vector<ToolResult> &results)
+{
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"wt") != 0 || fp == nullptr)
+        return false;
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"schema\": 1,\n");
+    fprintf(fp, "  \"results\": [\n");
+    for (size_t index = 0; index < results.size(); index++)
+    {
+        const ToolResult &result = results[index];
+        const ProcessStats &stats = result.m_stats;
+        double seconds = result.m_info.GetDurationInSeconds();
+        fprintf(fp, "    { \"tool\": \"%S\", \"file\": \"%S\", \"channels\": %zu, \"bits\": %u, \"float\": %s, "
+            "\"seconds\": %.3f, \"exit_code\": %d, \"wall_seconds\": %.4f, \"peak_memory_bytes\": %llu, "
+            "\"bytes_read\": %llu, \"bytes_written\": %llu, \"realtime_factor\": %.2f }%s\n",
+            result.m_tool.c_str(), result.m_file.c_str(), result.m_info.m_numChannels,
+            result.m_info.m_bitsPerSample, result.m_info.m_isFloat ? "true" : "false",
+            seconds, stats.m_exitCode, stats.m_wallSeconds,
+            static_cast<unsigned long long>(stats.m_peakMemory),
+            static_cast<unsigned long long>(stats.m_bytesRead),
+            static_cast<unsigned long long>(stats.m_bytesWritten),
+            (stats.m_wallSeconds > 0.0) ? seconds / stats.m_wallSeconds : 0.0,
+            (index + 1 < results.size()) ? "," : "");
+    }
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+
+    bool ok = (ferror(fp) == 0);
+    fclose(fp);
+    return ok;
+}
+
+static void PrintUsage()
+{
+    printf(
+        "\n"
+        "Description:  ToolBench runs each of the WaveTools programs on \n"
+        "  each file of a corpus (such as one made by MakeCorpus), and \n"
+        "  measures the time each run takes, how fast that is compared \n"
+        "  to the length of the audio, the peak memory the program used, \n"
+        "  and the bytes it read and wrote.  The results are written to \n"
+        "  a JSON file so they can be compared between releases. \n"
+        "\n"
+        "Usage:  toolbench [options] corpus [corpus ...]\n"
+        "\n"
+        "Where each corpus is a file, a directory (for the audio files \n"
+        "  in it), a wildcard such as 'corpus\\*_2ch_*.wav', or '@' and \n"
+        "  the name of a text file that lists files one per line. \n"
+        "\n"
+        "Options:\n"
+        "  -Output=file : Writes the results to the given file instead \n"
+        "       of 'toolbench.json'. \n"
+        "\n"
+        "  -Tools=x : Runs only the given programs, separated by commas \n"
+        "       (for example 'waveeq,wavevolume'). \n"
+        "\n"
+        "  -Only=x : Uses only the corpus files whose names contain 'x' \n"
+        "       (for example '_2ch_16_'). \n"
+        "\n"
+        "  -ToolDir=x : The directory the programs are in.  The default \n"
+        "       is the directory ToolBench is in. \n"
+        "\n"
+        "  -WorkDir=x : The directory to write the programs' output files \n"
+        "       to, which is made if it isn't there.  Each is deleted after \n"
+        "       its run.  The default is the current directory. \n"
+        "\n"
+        "  -Help : Print this usage information to the console.\n"
+        );
+}
+
+// Adds the directory separator to a directory name if it's missing.
+static std::wstring WithSeparator(const std::wstring &directory)
+{
+    if (directory.empty() || directory.back() == '\\' || directory.back() == '/')
+        return directory;
+    size_t found = directory.find_first_of(L"\\/");
+    return directory + ((found == std::wstring::npos) ? kPathSeparator : directory[found]);
+}
+
+// Parses the program's command line arguments, placing the
+// selected options into the settings structure.  Returns
+// true if successful.
+static bool ParseCommandLineArguments(
+    int argc,
+    wchar_t **argv,
+    ProgramSettings &settings
+    )
+{
+    if (argc < 2)
+    {
+        PrintUsage();
+        return false;
+    }
+
+    settings.m_toolDirectory = DirectoryName(argv[0]);
+    for (int iarg = 1; iarg < argc; iarg++)
+    {
+        if (IsOption(argv[iarg]))
+        {
+            if (OptionNameIs(argv[iarg], L"Help") || OptionNameIs(argv[iarg], L"?"))
+            {
+                PrintUsage();
+                return false;
+            }
+            else if (OptionNameIs(argv[iarg], L"Output"))
+            {
+                settings.m_outFilename = OptionValue(argv[iarg]);
+            }
+            else if (OptionNameIs(argv[iarg], L"Tools"))
+            {
+                settings.m_tools.assign(1, std::wstring());
+                for (const wchar_t *p = OptionValue(argv[iarg]); *p != '\0'; p++)
+                {
+                    if (*p == ',')
+                        settings.m_tools.push_back(std::wstring());
+                    else
+                        settings.m_tools.back() += *p;
+                }
+            }
+            else if (OptionNameIs(argv[iarg], L"Only"))
+            {
+                settings.m_only = OptionValue(argv[iarg]);
+            }
+            else if (OptionNameIs(argv[iarg], L"ToolDir"))
+            {
+                settings.m_toolDirectory = WithSeparator(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"WorkDir"))
+            {
+                settings.m_workDirectory = WithSeparator(OptionValue(argv[iarg]));
+            }
+            else
+            {
+                printname();
+                printf("Unrecognized option '%S'\n", argv[iarg]);
+                return false;
+            }
+        }
+        else
+        {
+            settings.m_inputs.push_back(argv[iarg]);
+        }
+    }
+
+    if (settings.m_inputs.empty())
+    {
+        printname();
+        printf("Not enough arguments!\n");
+        return false;
+    }
+
+    for (const std::wstring &tool : settings.m_tools)
+    {
+        bool known = false;
+        for (const ToolCommand &command : kToolCommands)
+            known = known || (_wcsicmp(tool.c_str(), command.m_tool) == 0);
+        if (!known)
+        {
+            printname();
+            printf("Unknown program '%S'\n", tool.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Application entry point.
+int wmain(int argc, wchar_t **argv)
+{
+    ProgramSettings settings;
+    if (!ParseCommandLineArguments(argc, argv, settings))
+        return EXIT_FAILURE;
+
+    if (!MakeWorkDirectory(settings.m_workDirectory))
+    {
+        printname();
+        printf("Failed making work directory '%S'\n", settings.m_workDirectory.c_str());
+        return EXIT_FAILURE;
+    }
+
+    unsigned error_count = 0;
+    try
+    {
+        std::vector<std::wstring> filenames;
+        if (!WaveformBatchExpandInputs(settings.m_inputs, filenames))
+            return EXIT_FAILURE;
+
+        std::vector<ToolResult> results;
+        error_count = RunToolBenchmarks(settings, filenames, results);
+
+        if (!WriteResults(settings.m_outFilename.c_str(), results))
+        {
+            printname();
+            printf("Failed writing results to '%S'\n", settings.m_outFilename.c_str());
+            return EXIT_FAILURE;
+        }
+
+        printname();
+        printf("Wrote %zu results to '%S'\n", results.size(), settings.m_outFilename.c_str());
+    }
+    catch(...)
+    {
+        printname();
+        printf("Unexpected program exception!\n");
+        return EXIT_FAILURE;
+    }
+
+    if (error_count)
+    {
+        printname();
+        printf("Exiting with %u error(s)!\n", error_count);
+        return EXIT_FAILURE;
+    }
+
+    printname();
+    printf("Completed OK.\n");
+    return EXIT_SUCCESS;
+}
@@ -46,8 +46,11 @@
 //--------------------------------------------------------------------
 
 #pragma once
+#include "waveformprofile.h"
 #include <vector>
 #include <cstdint>
+#include <atomic>
+#include <chrono>
 
 // Container class for a PCM audio waveform.
 // Internally we store the audio as an array of floating-point
@@ -80,6 +83,14 @@ public:
     // the samples would be played back.
     void SetRate(unsigned Hz) { m_rate = Hz; }
 
+    // Set the speaker positions of the channels, as a WAV file's
+    // channel mask (one bit per speaker, in channel order), or zero
+    // if they're unspecified.  Like the rate, this is just carried
+    // along with the samples, so a WAV file that's loaded and saved
+    // keeps it.  Populate, and changing the number of channels,
+    // reset it to zero.
+    void SetChannelMask(uint32_t mask) { m_channelMask = mask; }
+
     //--------------------------------------------------
     // Information
     //--------------------------------------------------
@@ -87,6 +98,10 @@ public:
     // Returns the waveform's sample rate in Hertz.
     unsigned GetRate() const { return m_rate; }
 
+    // Returns the speaker positions of the channels, or zero if
+    // they're unspecified.
+    uint32_t GetChannelMask() const { return m_channelMask; }
+
     // Returns the number of interleaved channels in the waveform.
     size_t GetNumChannels() const { return m_numChannels; }
 
@@ -157,7 +172,7 @@ public:
     // Stretches or shrinks the waveform to fit in the indicated
     // number of samples.  This alters the perceived pitch.
     // Returns true if successful.
-    bool Waveform::Stretch(size_t newNumSamples);
+    bool Stretch(size_t newNumSamples);
 
     // Resamples the waveform for playback at the specified sample
     // rate in Hertz.  The total number of samples may changes.
@@ -206,8 +221,53 @@ public:
     }
 
 private:
-    std::vector<float> m_data;  // Buffer of raw PCM audio data.
+    WaveformBuffer<float> m_data;   // Buffer of raw PCM audio data.
     unsigned m_rate = 48000;    // Sample rate in Hertz.
     size_t m_numChannels;       // 1=mono, 2=stereo.
+    uint32_t m_channelMask = 0; // Speaker positions, or zero if unspecified.
 };
 
+// Reports the progress of a long operation, such as loading or
+// saving a file, to a status callback like the one that
+// WaveformLoadFromFile and WaveformSaveToFile take.  Update is
+// meant to be called for every block of the loop that does the
+// work; it only checks the clock, and only calls the callback when
+// kIntervalMs milliseconds have passed since it last did, so the
+// caller sees steady progress and can cancel the operation within
+// a few milliseconds, without the loop slowing down.
+class WaveformProgress
+{
+public:
+    // Shortest time between calls to the callback from Update.
+    static const unsigned kIntervalMs = 5;
+
+    // The completion passed to the callback runs from 'start' to
+    // 'end' as the work goes, so that one step of a larger
+    // operation can report its part of the whole.  The callback
+    // may be null.
+    WaveformProgress(
+            void *status_callback_context,
+            bool (*status_callback_func)(void *context, float completion),
+            float start = 0.0f,
+            float end = 1.0f);
+
+    // Reports that 'done' of 'total' units of the work are done,
+    // calling the callback if it's time to.  Returns false if the
+    // callback has asked for the operation to stop, now or earlier.
+    // This should only be called by the thread that started the
+    // operation, so the callback is always called on that thread.
+    bool Update(uint64_t done, uint64_t total);
+
+    // Returns true if the callback has asked for the operation to
+    // stop.  Other threads helping with the work may call this to
+    // find out when to give up.
+    bool IsCancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+private:
+    void *m_context;
+    bool (*m_func)(void *context, float completion);
+    float m_start;
+    float m_end;
+    std::chrono::steady_clock::time_point m_lastCall;
+    std::atomic<bool> m_cancelled{false};
+};
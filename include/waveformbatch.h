@@ -0,0 +1,171 @@
+//-------------------------------------------------------------------
+//
+// waveformbatch.h
+// C++ functions for running the same operation over many audio
+// files at once:  expanding file lists, wildcards, and directories
+// into input file names, naming the output files, and spreading
+// the files across a work-stealing set of threads.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#pragma once
+#include <stddef.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+//
+// Expands the given input specifications into a list of audio file
+// names, which are appended to 'filenames'.  Each specification may
+// be:
+//   * The name of a file.
+//   * A name with the '*' or '?' wildcards in its last part, which
+//     gives the matching files, e.g. "music\*.wav".
+//   * The name of a directory, which gives the audio files in it
+//     (those with the .wav, .mp3, .flac, .raw, or .pcm extensions).
+//   * An '@' followed by the name of a text file that lists more
+//     specifications, one per line.  Blank lines, and lines that
+//     start with '#', are ignored.
+// The files from each wildcard or directory are sorted by name.
+// Returns false, after printing a message, if a specification names
+// nothing, or if it's '-' (standard input can't be batched).
+//
+bool WaveformBatchExpandInputs(
+        const std::vector<std::wstring> &specs,
+        std::vector<std::wstring> &filenames
+        );
+
+//
+// Returns the name of the output file for the given input file,
+// made from a naming template in which these are replaced:
+//   {dir}  = The input file's directory, with a trailing separator,
+//            or nothing if the input name has no directory.
+//   {name} = The input file's name without its directory or extension.
+//   {ext}  = The input file's extension, without the leading dot.
+// A template that contains none of these is taken as the name of
+// an output directory, and the output file gets the input file's
+// name and extension in that directory.  For example, with the input
+// "in\song.flac", the template "{dir}{name}_eq.wav" gives
+// "in\song_eq.wav", and the template "out" gives "out\song.flac".
+//
+std::wstring WaveformBatchOutputName(const wchar_t *nameTemplate, const wchar_t *inFilename);
+
+//
+// Runs an operation over a batch of input files, each with its own
+// output file, several files at a time.  The files are dealt out to
+// worker threads largest first, and a worker that runs out of files
+// takes the not-yet-started ones from the far end of another
+// worker's queue.  An error on one file is recorded and the rest of
+// the batch carries on.
+//
+// Output written to the console by the operation isn't serialized,
+// so messages about different files may be interleaved.
+//
+class WaveformBatch
+{
+public:
+    // The outcome of one file.
+    enum class Status
+    {
+        Pending,            // Not processed yet.
+        Succeeded,          // The operation returned true.
+        Failed,             // The operation returned false.
+        Exception,          // The operation threw an exception.
+        DuplicateOutput,    // Another input file has the same output file name.
+        SameAsInput,        // The output file name is the input file name.
+    };
+
+    // One file in the batch.
+    struct File
+    {
+        std::wstring m_inFilename;
+        std::wstring m_outFilename;
+        size_t m_memoryNeeded = 0;      // Estimated bytes of memory needed to process it.
+        Status m_status = Status::Pending;
+    };
+
+    // The operation run on each file.  It's called from several
+    // threads at once, so it must not change shared state without
+    // locking.  Returns true if successful.
+    typedef std::function<bool(const wchar_t *inFilename, const wchar_t *outFilename)> Operation;
+
+    WaveformBatch() = default;
+    WaveformBatch(const WaveformBatch &) = delete;
+    WaveformBatch &operator=(const WaveformBatch &) = delete;
+
+    // Sets the most files to process at once.  Zero, the default,
+    // means one per logical CPU.
+    void SetThreadCount(unsigned numThreads) { m_numThreads = numThreads; }
+
+    // Sets a limit on the estimated memory of the files being
+    // processed at once, in bytes.  A file waits to be started until
+    // it fits under the limit, although one file is always allowed
+    // to run, however large.  Zero, the default, means no limit.
+    void SetMemoryBudget(size_t numBytes) { m_memoryBudget = numBytes; }
+
+    // Adds an input file to the batch, with the name of its output
+    // file.  If 'outFilename' is null, the operation has no output
+    // file.  The file's memory estimate is made from its headers:
+    // enough to hold the audio in floating point twice over.
+    void AddFile(const wchar_t *inFilename, const wchar_t *outFilename);
+
+    // Adds each of the input files, naming their outputs with
+    // WaveformBatchOutputName, or with no outputs if 'nameTemplate'
+    // is null.
+    void AddFiles(const std::vector<std::wstring> &inFilenames, const wchar_t *nameTemplate);
+
+    // Runs the operation on every file, and returns when they've
+    // all finished.  Returns true if it succeeded on every file.
+    bool Run(const Operation &operation);
+
+    // Returns the files of the batch, in the order they were added.
+    const std::vector<File> &GetFiles() const { return m_files; }
+
+    // Returns the number of files whose status is anything other
+    // than Succeeded.
+    size_t GetErrorCount() const;
+
+    // Returns a short description of a status, e.g. "failed".
+    static const char *GetStatusText(Status status);
+
+private:
+    class Scheduler;
+
+    std::vector<File> m_files;
+    unsigned m_numThreads = 0;
+    size_t m_memoryBudget = 0;
+};
@@ -0,0 +1,407 @@
+//-------------------------------------------------------------------
+//
+// waveformgraph.h
+// C++ framework for processing audio a block at a time, by pulling
+// fixed-size blocks from sources through a graph of processors to
+// a sink, so that long audio files can be processed in a bounded
+// amount of memory.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "waveform.h"
+#include "waveformload.h"
+
+// Describes a stream of audio blocks:  its sample rate, number of
+// interleaved channels, and length.  The graph also notes how many
+// frames of latency the stream carries ahead of its audio; those are
+// over and above its length.
+struct WaveformFormat
+{
+    unsigned m_rate = 48000;        // Sample rate in Hertz.
+    size_t m_numChannels = 1;       // Number of interleaved channels.
+    size_t m_numSamples = 0;        // Length of the stream in samples (per channel).
+    uint32_t m_channelMask = 0;     // Speaker positions of the channels, or zero if unspecified.
+    size_t m_latency = 0;           // Latency in samples (per channel), set by the graph.
+
+    // Returns the duration of the stream in seconds.
+    float GetDurationInSeconds() const
+    {
+        return m_rate ? m_numSamples / static_cast<float>(m_rate) : 0.0f;
+    }
+
+    // Returns the sample index that corresponds to the specified
+    // time offset, computed the same way as Waveform::TimeToSampleIndex.
+    size_t TimeToSampleIndex(float seconds) const
+    {
+        if (seconds <= 0.0f || m_rate == 0 || m_numSamples == 0)
+            return 0;
+        return static_cast<size_t>(seconds / GetDurationInSeconds() * m_numSamples);
+    }
+};
+
+// A block of interleaved floating-point audio samples.  The sample
+// buffer is allocated once, aligned for SIMD loads and stores, and
+// reused for every block that passes through a graph node.
+class WaveformBlock
+{
+public:
+    // The default number of sample frames (one sample per channel)
+    // in a block, and the alignment of the sample buffer in bytes.
+    static const size_t kDefaultFrames = 4096;
+    static const size_t kAlignment = 64;
+
+    WaveformBlock() = default;
+    WaveformBlock(WaveformBlock &&) = default;
+    WaveformBlock &operator=(WaveformBlock &&) = default;
+    WaveformBlock(const WaveformBlock &) = delete;
+    WaveformBlock &operator=(const WaveformBlock &) = delete;
+
+    // Allocates room for 'maxFrames' sample frames of 'numChannels'
+    // channels, and empties the block.  Returns true if successful.
+    bool Allocate(size_t maxFrames, size_t numChannels);
+
+    // Returns the number of frames the block has room for, and the
+    // number of interleaved channels.
+    size_t GetMaxFrames() const { return m_maxFrames; }
+    size_t GetNumChannels() const { return m_numChannels; }
+
+    // Returns or sets the number of frames the block holds.  A
+    // block that holds no frames marks the end of a stream.
+    size_t GetNumFrames() const { return m_numFrames; }
+    void SetNumFrames(size_t numFrames) { m_numFrames = (numFrames < m_maxFrames) ? numFrames : m_maxFrames; }
+
+    // Access the buffer of interleaved samples.
+    const float *GetSamplesPtr() const { return m_samples; }
+    float       *GetSamplesPtr()       { return m_samples; }
+
+    // Sets all of the block's samples (up to GetMaxFrames) to zero.
+    void Silence();
+
+private:
+    WaveformBuffer<float> m_buffer; // Sample storage, with room to align m_samples.
+    float *m_samples = nullptr;     // Aligned start of the samples in m_buffer.
+    size_t m_maxFrames = 0;
+    size_t m_numChannels = 0;
+    size_t m_numFrames = 0;
+};
+
+// Produces a stream of audio blocks, for example by reading an
+// audio file.
+class WaveformSource
+{
+public:
+    virtual ~WaveformSource() = default;
+
+    // Prepares the source to be read, and describes the audio it
+    // will produce.  Called once, before the first Read.  Returns
+    // true if successful.
+    virtual bool Open(WaveformFormat &format) = 0;
+
+    // Fills the block with as many frames as it has room for, or
+    // fewer at the end of the stream; filling none means the stream
+    // has ended.  Returns true if successful.
+    virtual bool Read(WaveformBlock &block) = 0;
+};
+
+// Produces a stream of audio blocks from one or more input streams,
+// for example by applying an effect.  A processor is called once for
+// each block of its inputs, and must take in all of the frames of
+// each input block.  Like a source, it must fill every block it puts
+// out, except the last one before its stream ends, so that the
+// streams through a graph stay lined up with each other.  A
+// processor that needs to look ahead holds back its latency's worth
+// of frames, putting out that many frames of silence (or whatever it
+// likes) at the start, and the frames it held back once its inputs
+// have ended.
+class WaveformProcessor
+{
+public:
+    virtual ~WaveformProcessor() = default;
+
+    // Given the formats of the processor's inputs, prepares it to
+    // run and describes the audio it will produce.  Called once,
+    // before the first Process.  Returns false if the processor
+    // can't handle the inputs.
+    virtual bool Configure(
+            const WaveformFormat *inputFormats,
+            size_t numInputs,
+            WaveformFormat &outputFormat) = 0;
+
+    // Processes the next block of each input into the output block.
+    // An input block that holds no frames means that input has ended
+    // (inputs may end at different times).  After all of the inputs
+    // have ended, Process is called until it produces no frames.
+    // Returns true if successful.
+    virtual bool Process(
+            const WaveformBlock *const *inputs,
+            size_t numInputs,
+            WaveformBlock &output) = 0;
+
+    // Returns the number of frames by which the processor's output
+    // lags its input.  The latency of a whole path through a graph
+    // is the sum of the latencies along it.
+    virtual size_t GetLatency() const { return 0; }
+
+    // Returns a short name for the kind of processor, under which
+    // its time is reported when profiling (see waveformprofile.h).
+    virtual const char *GetName() const { return "process"; }
+};
+
+// Supplies a sink with the blocks of a stream, one after another,
+// as the sink asks for them.
+class WaveformPuller
+{
+public:
+    virtual ~WaveformPuller() = default;
+
+    // Returns the next block of the stream, which is valid until the
+    // next call, or nullptr if an error occurred.  A block that holds
+    // no frames means the stream has ended.
+    virtual const WaveformBlock *Pull() = 0;
+};
+
+// Consumes a stream of audio blocks, for example by writing them to
+// an audio file.  The sink drives the processing of a graph:  each
+// block it pulls is produced on demand by the nodes upstream of it.
+class WaveformSink
+{
+public:
+    virtual ~WaveformSink() = default;
+
+    // Pulls blocks of audio in the given format from 'input' until
+    // the stream ends, consuming each one.  Returns true if
+    // successful.
+    virtual bool Consume(const WaveformFormat &format, WaveformPuller &input) = 0;
+};
+
+// A graph of sources and processors, which runs by pulling blocks
+// of audio from one of its nodes into a sink.  A node's output may
+// be the input of any number of later nodes (fan-out); each block
+// is produced once, and shared by all of them.  A processor may
+// have any number of inputs (fan-in).  The graph doesn't own the
+// sources, processors, or sinks, which must outlive it.
+class WaveformGraph
+{
+public:
+    // Creates an empty graph whose blocks hold up to 'blockFrames'
+    // sample frames.
+    explicit WaveformGraph(size_t blockFrames = WaveformBlock::kDefaultFrames);
+
+    WaveformGraph(const WaveformGraph &) = delete;
+    WaveformGraph &operator=(const WaveformGraph &) = delete;
+
+    // Adds a source or processor to the graph, and returns its node
+    // index.  A processor's inputs are the indexes of nodes already
+    // in the graph, which keeps the graph free of cycles.
+    size_t AddSource(WaveformSource &source);
+    size_t AddProcessor(WaveformProcessor &processor, const std::vector<size_t> &inputs);
+    size_t AddProcessor(WaveformProcessor &processor, size_t input)
+    {
+        return AddProcessor(processor, std::vector<size_t>(1, input));
+    }
+
+    // Opens the sources, configures the processors, and allocates
+    // the blocks of every node.  Called once, after all of the nodes
+    // have been added.  Returns true if successful.
+    bool Prepare();
+
+    // Returns the format of the given node's output, once the graph
+    // has been prepared.
+    const WaveformFormat &GetFormat(size_t node) const { return m_nodes[node].m_format; }
+
+    // Returns the total latency in frames of the longest path from a
+    // source to the given node's output.
+    size_t GetLatency(size_t node) const;
+
+    // Runs the graph, pulling the output of the given node into the
+    // sink until it ends.  The node's latency is compensated for:
+    // that many frames are dropped from the start of its output, so
+    // the sink's stream lines up with the sources.  Prepares the
+    // graph if it hasn't been prepared.  Returns true if successful.
+    bool Run(size_t node, WaveformSink &sink);
+
+    // The number of blocks a pipelined graph queues up between its
+    // threads, unless told otherwise.
+    static const size_t kDefaultPipelineDepth = 16;
+
+    // Sets how many blocks may be queued up between the threads of
+    // a pipelined run.  If it's nonzero, Run reads each source ahead
+    // on a thread of its own, and runs the sink on another thread,
+    // while the processors run on the calling thread; so reading,
+    // processing, and writing overlap instead of taking turns.  The
+    // sources' Read and the sink's Consume must then be safe to call
+    // from another thread.  If it's zero (the default), everything
+    // runs on the calling thread.
+    void SetPipelineDepth(size_t numBlocks) { m_pipelineDepth = numBlocks; }
+
+private:
+    class Prefetcher;
+    struct Node
+    {
+        WaveformSource *m_source = nullptr;
+        WaveformProcessor *m_processor = nullptr;
+        std::vector<size_t> m_inputs;
+        std::vector<const WaveformBlock *> m_inputBlocks;
+        WaveformFormat m_format;
+        WaveformBlock m_block;
+        uint64_t m_tick = 0;        // Which pass produced m_block.
+        bool m_ended = false;       // True once the node has no more output.
+        Prefetcher *m_prefetcher = nullptr; // Reads ahead from the source in a pipelined run.
+    };
+    class Puller;
+
+    const WaveformBlock *PullNode(size_t node, uint64_t tick);
+    bool RunPipelined(size_t node, WaveformSink &sink);
+
+    std::vector<Node> m_nodes;
+    size_t m_blockFrames;
+    size_t m_pipelineDepth = 0;
+    uint64_t m_tick = 0;
+    bool m_prepared = false;
+};
+
+//
+// Ready-made sources and sinks.
+//
+
+// A source that reads the samples of a Waveform in memory.  The
+// Waveform must outlive the source.
+class WaveformMemorySource : public WaveformSource
+{
+public:
+    explicit WaveformMemorySource(const Waveform &wav) : m_wav(wav) {}
+    bool Open(WaveformFormat &format) override;
+    bool Read(WaveformBlock &block) override;
+
+private:
+    const Waveform &m_wav;
+    size_t m_position = 0;
+};
+
+// A sink that collects the stream into a Waveform in memory,
+// replacing whatever the Waveform held.  The Waveform is only
+// replaced once the whole stream has been collected, so it can also
+// be the one a WaveformMemorySource at the start of the graph reads.
+class WaveformMemorySink : public WaveformSink
+{
+public:
+    explicit WaveformMemorySink(Waveform &wav) : m_wav(wav) {}
+    bool Consume(const WaveformFormat &format, WaveformPuller &input) override;
+
+private:
+    Waveform &m_wav;
+};
+
+// A source that reads an audio file a chunk at a time (see
+// WaveformRangeReader), so only part of the file is ever in memory.
+// That includes standard input ("-"), which is read forward a chunk
+// at a time too, unless its length isn't known.
+class WaveformFileSource : public WaveformSource
+{
+public:
+    explicit WaveformFileSource(const wchar_t *filename) : m_filename(filename) {}
+    bool Open(WaveformFormat &format) override;
+    bool Read(WaveformBlock &block) override;
+
+    // The number of sample frames read from the file at a time.
+    static const size_t kChunkFrames = 1 << 20;
+
+private:
+    std::wstring m_filename;
+    WaveformRangeReader m_reader;   // Keeps the file's index between chunks.
+    WaveformFormat m_format;
+    Waveform m_chunk;
+    size_t m_chunkStart = 0;        // Frame index in the file of m_chunk's first frame.
+    size_t m_position = 0;          // Frame index in the file of the next frame to read.
+};
+
+// A source that starts another source's stream later, with silence
+// before it.  The silence lasts until 'startSeconds' into the other
+// source's audio (measured as Waveform::TimeToSampleIndex would).
+class WaveformOffsetSource : public WaveformSource
+{
+public:
+    WaveformOffsetSource(WaveformSource &source, float startSeconds) :
+        m_source(source), m_startSeconds(startSeconds) {}
+    bool Open(WaveformFormat &format) override;
+    bool Read(WaveformBlock &block) override;
+
+    // Returns the number of frames of silence before the other
+    // source's stream, once the source has been opened.
+    size_t GetOffset() const { return m_offset; }
+
+private:
+    WaveformSource &m_source;
+    float m_startSeconds;
+    size_t m_offset = 0;
+    size_t m_position = 0;          // Frames of silence produced so far.
+    WaveformBlock m_partial;        // The other source's part of the block where the silence ends.
+};
+
+// A sink that saves the stream to an audio file with
+// WaveformSaveInBlocks, so that WAV files (and standard output) are
+// written as the blocks arrive.  The other parameters are the same
+// as for WaveformSaveToFile.
+class WaveformFileSink : public WaveformSink
+{
+public:
+    WaveformFileSink(
+            const wchar_t *filename,
+            bool useFloat = false,
+            unsigned useBytesPerSample = 2,
+            void *status_callback_context = nullptr,
+            bool (*status_callback_func)(void *context, float completion) = nullptr) :
+        m_filename(filename),
+        m_useFloat(useFloat),
+        m_useBytesPerSample(useBytesPerSample),
+        m_statusContext(status_callback_context),
+        m_statusFunc(status_callback_func)
+    {
+    }
+    bool Consume(const WaveformFormat &format, WaveformPuller &input) override;
+
+private:
+    std::wstring m_filename;
+    bool m_useFloat;
+    unsigned m_useBytesPerSample;
+    void *m_statusContext;
+    bool (*m_statusFunc)(void *context, float completion);
+};
@@ -41,6 +41,7 @@
 
 #pragma once
 #include <vector>
+#include <memory>
 #include <cstdint>
 #include "waveform.h"
 
@@ -49,6 +50,12 @@
 // into the given Waveform object.  Returns true if
 // successful, false if error.
 //
+// If the filename is "-", WAV audio is read from standard input,
+// which needn't be able to seek; a WAV stream whose headers don't
+// give its length is read to the end.  Standard input can only be
+// loaded once, though WaveformReadFileInfo may be called on it
+// first.
+//
 // If a pointer to status callback function is provided,
 // it will be called periodically during the loading
 // procedure, with a completion parameter value ranging
@@ -57,6 +64,10 @@
 // returns false, the loading is immediately aborted.
 // The status callback mechanism is provided so that the
 // caller may update a status display if desired.
+// While the audio is being read, decoded, and converted,
+// it's called every few milliseconds (see
+// WaveformProgress), always on the calling thread, so
+// a caller that wants to cancel is heard from promptly.
 //
 bool WaveformLoadFromFile(
         const wchar_t *filename,
@@ -65,3 +76,184 @@ bool WaveformLoadFromFile(
         bool (*status_callback_func)(void *context, float completion) = nullptr
         );
 
+//
+// Loads part of the specified audio file into the given Waveform
+// object: 'count' sample frames (one sample per channel) starting
+// at sample frame 'startFrame'.  If 'count' is zero, or runs past
+// the end of the file, the rest of the file is loaded.  Returns
+// true if successful, false if error or if 'startFrame' is past
+// the end of the file.
+//
+// Only the part of the file holding the range is read.  For MP3
+// files the frame headers are scanned the first time a file is
+// loaded (after that, or with WaveformSetIndexCache, a cached index
+// is used), and decoding starts a few frames before the range so
+// the result is identical to the same samples from
+// WaveformLoadFromFile.  For FLAC files the SEEKTABLE is used to
+// find the frames holding the range.
+//
+// The status callback works the same as in WaveformLoadFromFile.
+//
+bool WaveformLoadRange(
+        const wchar_t *filename,
+        size_t startFrame,
+        size_t count,
+        Waveform &wav,
+        void *status_callback_context = nullptr,
+        bool (*status_callback_func)(void *context, float completion) = nullptr
+        );
+
+//
+// Loads an audio file a range at a time, with the same results as
+// calling WaveformLoadRange for each range, but works out where the
+// ranges are in the file only once, when it's opened:  the header
+// of a WAV file, the frame index of an MP3 file, the STREAMINFO and
+// SEEKTABLE of a FLAC file, or the sample format of a raw PCM file.
+// MP3 and FLAC streams whose layout can't be told that way are
+// loaded whole when opened instead.
+//
+// Standard input ("-") is read forward as the ranges are loaded, so
+// only one reader can have it, and each range must start where the
+// last one ended.  If it has already been read whole (by calling
+// WaveformReadFileInfo on it, say), or its headers don't give its
+// length, it's loaded whole when opened, like those streams.
+//
+class WaveformRangeReader
+{
+public:
+    WaveformRangeReader();
+    ~WaveformRangeReader();
+
+    // Opens the given file.  Returns true if successful.
+    bool Open(const wchar_t *filename);
+
+    // Return the format of the open file's audio.
+    unsigned GetRate() const;
+    size_t GetNumChannels() const;
+    size_t GetNumSamples() const;
+
+    // Returns the speaker positions of the file's channels, as
+    // Waveform::GetChannelMask does, or zero if they're unspecified.
+    uint32_t GetChannelMask() const;
+
+    // Loads 'count' sample frames starting at 'startFrame' from the
+    // open file, as WaveformLoadRange does, including its use of
+    // the status callback.
+    bool Load(
+            size_t startFrame,
+            size_t count,
+            Waveform &wav,
+            void *status_callback_context = nullptr,
+            bool (*status_callback_func)(void *context, float completion) = nullptr
+            );
+
+private:
+    WaveformRangeReader(const WaveformRangeReader &) = delete;
+    WaveformRangeReader &operator=(const WaveformRangeReader &) = delete;
+
+    struct State;
+    std::unique_ptr<State> m_state;
+};
+
+//
+// Turns on or off the caching of MP3 frame indexes.  When it's on,
+// the frame index that WaveformLoadRange and WaveformReadFileInfo
+// build for an MP3 file is saved in a sidecar file next to it (the
+// MP3 filename with ".idx" appended), and reused as long as the MP3
+// file's size and modification time haven't changed.  Off by default.
+//
+void WaveformSetIndexCache(bool enable);
+
+//
+// Changes how WaveformLoadFromFile decodes MP3 files, for testing
+// that the parallel decode gives the same samples as a serial one.
+// If 'serial' is true, the frames are decoded one after another on
+// the calling thread, as they are for streams the frame index can't
+// describe.  Otherwise, if 'segmentFrames' isn't zero, the parallel
+// decode splits the file into segments of about that many frames
+// rather than a few per thread.  WaveformSetMP3Decode(false, 0)
+// puts back the normal decode.
+//
+void WaveformSetMP3Decode(bool serial, size_t segmentFrames);
+
+//
+// Raw PCM files (".raw" or ".pcm") have no header of their own, so
+// their sample format comes from one of these places, in order:
+//
+// * The format set by WaveformSetRawFormat, if any.
+// * A ".hdr" text file next to the raw file (see rawpcmfile.h for
+//   its contents), which WaveformSaveToFile writes when it saves a
+//   raw PCM file.
+// * The format guessed from the file's contents, if auto-detection
+//   was turned on by WaveformSetRawAutoDetect.  The sample size,
+//   sample type, and channel count are guessed from the first 64 KB
+//   or so of sound, by which interpretation of the bytes gives the
+//   smoothest signal; the sample rate can't be guessed.
+// * The default format:  22500 Hz, two channels, 16-bit integer.
+//
+// WaveformSetRawFormat returns false if the format isn't supported.
+//
+bool WaveformSetRawFormat(unsigned rate, unsigned numChannels, unsigned bytesPerSample, bool isFloat);
+void WaveformSetRawAutoDetect(bool enable);
+
+//
+// Applies the value of a tool's -RawFormat option, which is either
+// "auto" to turn on auto-detection, or "rate,channels,bytes" with an
+// optional ",float" or ",int" to set the format of all raw PCM files
+// (for example, "44100,2,2" or "48000,1,4,float").  Returns false if
+// the value isn't valid.
+//
+bool WaveformSetRawFormatFromString(const wchar_t *text);
+
+
+// Describes the format and length of an audio file, as reported
+// by WaveformReadFileInfo.
+struct WaveformFileInfo
+{
+    const char *m_format = "";      // Name of the file format, e.g. "WAV" or "MP3".
+    unsigned m_rate = 0;            // Sample rate in Hertz.
+    size_t m_numChannels = 0;       // Number of interleaved channels.
+    size_t m_numSamples = 0;        // Number of samples (per channel).
+    unsigned m_bitsPerSample = 0;   // Bits per stored sample, or zero for lossy formats.
+    bool m_isFloat = false;         // True if the file stores floating-point samples.
+    unsigned m_bitrate = 0;         // Average bit rate in kbit/s, for compressed formats.
+    uint32_t m_channelMask = 0;     // Speaker positions of the channels, if the file gives them.
+
+    // These are only filled in if statistics were requested.
+    bool m_hasStats = false;
+    float m_highestSample = 0.0f;
+    float m_lowestSample = 0.0f;
+
+    // Returns the duration of the audio in seconds.
+    float GetDurationInSeconds() const
+    {
+        return m_rate ? static_cast<float>(static_cast<double>(m_numSamples) / m_rate) : 0.0f;
+    }
+
+    // Returns the sample index that corresponds to the specified
+    // time offset, computed the same way as Waveform::TimeToSampleIndex.
+    size_t TimeToSampleIndex(float seconds) const
+    {
+        if (seconds <= 0.0f || m_rate == 0 || m_numSamples == 0)
+            return 0;
+        return static_cast<size_t>(seconds / (m_numSamples / static_cast<float>(m_rate)) * m_numSamples);
+    }
+};
+
+//
+// Reads the format and length of the specified audio file without
+// loading its audio data into memory.  For WAV files only the
+// headers are read, for MP3 files only the frame headers are
+// examined, and for FLAC files only the metadata blocks are read;
+// nothing is decoded.  Returns true if successful.
+//
+// If 'computeStats' is true, the audio data is also read through
+// once to find the highest and lowest sample values.  This costs
+// about as much time as loading the file, but the samples are
+// examined a block at a time rather than held in memory.
+//
+bool WaveformReadFileInfo(
+        const wchar_t *filename,
+        WaveformFileInfo &info,
+        bool computeStats = false
+        );
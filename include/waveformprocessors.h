@@ -0,0 +1,219 @@
+//-------------------------------------------------------------------
+//
+// waveformprocessors.h
+// The effects of the waveform tools, as processors that can be
+// connected together in a WaveformGraph.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#pragma once
+#include <vector>
+#include <memory>
+#include "waveformgraph.h"
+
+class LowPassFilter;
+class HighPassFilter;
+class BandpassFilter;
+class NotchFilter;
+
+// Multiplies the samples by a volume level, clipping the result to
+// the range -1 to 1 (as WaveVolume does).
+class VolumeProcessor : public WaveformProcessor
+{
+public:
+    explicit VolumeProcessor(float volume) : m_volume(volume) {}
+    bool Configure(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat) override;
+    bool Process(const WaveformBlock *const *inputs, size_t numInputs, WaveformBlock &output) override;
+    const char *GetName() const override { return "volume"; }
+
+private:
+    float m_volume;
+};
+
+// Runs the samples through low-pass, high-pass, bandpass, and notch
+// filters, in that order, clipping the result to the range -1 to 1
+// (as WaveEQ does).  A filter whose frequency is zero isn't used.
+// Like WaveEQ, each filter runs over the interleaved samples of all
+// of the channels.
+class EQProcessor : public WaveformProcessor
+{
+public:
+    EQProcessor(float lowPassFreq, float highPassFreq,
+                float bandpassFreq = 0.0f, float bandpassQ = 2.0f,
+                float notchFreq = 0.0f, float notchQ = 5.0f);
+    ~EQProcessor();
+
+    // If 'parallel' is true, each filter runs over a block in
+    // segments on all of the threads of the pool, which gives very
+    // nearly the same result as running it serially (see the error
+    // bound in segmentedfilter.h).  The segments have to be long for
+    // this to pay off, so the graph's blocks should be about
+    // kParallelBlockFrames long; shorter blocks are filtered serially.
+    void SetParallel(bool parallel) { m_parallel = parallel; }
+    static const size_t kParallelBlockFrames = 1024 * 1024;
+
+    bool Configure(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat) override;
+    bool Process(const WaveformBlock *const *inputs, size_t numInputs, WaveformBlock &output) override;
+    const char *GetName() const override { return "eq"; }
+
+private:
+    float m_lowPassFreq;
+    float m_highPassFreq;
+    float m_bandpassFreq;
+    float m_bandpassQ;
+    float m_notchFreq;
+    float m_notchQ;
+    bool m_parallel = false;
+    std::unique_ptr<LowPassFilter> m_lowPass;
+    std::unique_ptr<HighPassFilter> m_highPass;
+    std::unique_ptr<BandpassFilter> m_bandpass;
+    std::unique_ptr<NotchFilter> m_notch;
+};
+
+// Fades the audio in from silence at the start and out to silence
+// at the end, over the given number of seconds, clipping the result
+// to the range -1 to 1 (as WaveFade does).  The length of the stream
+// has to be known up front to find where the fade-out starts.
+class FadeProcessor : public WaveformProcessor
+{
+public:
+    FadeProcessor(float fadeInSeconds, float fadeOutSeconds) :
+        m_fadeInSeconds(fadeInSeconds), m_fadeOutSeconds(fadeOutSeconds) {}
+    bool Configure(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat) override;
+    bool Process(const WaveformBlock *const *inputs, size_t numInputs, WaveformBlock &output) override;
+    const char *GetName() const override { return "fade"; }
+
+    // Returns the length of the fade-in and fade-out in samples (per
+    // channel), once the processor has been configured.
+    size_t GetFadeInSamples() const { return m_numFadeInSamples / m_numChannels; }
+    size_t GetFadeOutSamples() const { return m_numFadeOutSamples / m_numChannels; }
+
+private:
+    float m_fadeInSeconds;
+    float m_fadeOutSeconds;
+    size_t m_numChannels = 1;
+    size_t m_numFadeInSamples = 0;  // Interleaved samples, as are the rest.
+    size_t m_numFadeOutSamples = 0;
+    size_t m_fadeOutStart = 0;
+    size_t m_index = 0;
+};
+
+// Varies the volume in a repeating triangle wave, 'width' samples
+// (per channel) long, that dips down by up to 'depth' (as
+// WaveTremolo does).  If 'widthIsTime' is true, 'width' is in
+// seconds instead.
+class TremoloProcessor : public WaveformProcessor
+{
+public:
+    TremoloProcessor(double width, float depth, bool widthIsTime = false) :
+        m_widthParam(width), m_depth(depth), m_widthIsTime(widthIsTime) {}
+    bool Configure(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat) override;
+    bool Process(const WaveformBlock *const *inputs, size_t numInputs, WaveformBlock &output) override;
+    const char *GetName() const override { return "tremolo"; }
+
+    // Returns the width of the tremolo cycle in samples (per
+    // channel), once the processor has been configured.
+    size_t GetWidth() const { return m_width; }
+
+private:
+    double m_widthParam;
+    float m_depth;
+    bool m_widthIsTime;
+    size_t m_width = 0;
+    size_t m_position = 0;
+};
+
+// Adds 'repeat' echoes of the audio to itself, each 'delayMs'
+// milliseconds after the one before and quieter than the one before,
+// clipping the result to the range -1 to 1 (as WaveEcho does).  Like
+// WaveEcho, the echoes stop at the end of the original audio.  Only
+// the last delay * repeat worth of samples is kept.
+class EchoProcessor : public WaveformProcessor
+{
+public:
+    EchoProcessor(float delayMs, size_t repeat, float wetLevel = 0.5f, float dryLevel = 1.0f) :
+        m_delayMs(delayMs), m_repeat(repeat), m_wetLevel(wetLevel), m_dryLevel(dryLevel) {}
+    bool Configure(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat) override;
+    bool Process(const WaveformBlock *const *inputs, size_t numInputs, WaveformBlock &output) override;
+    const char *GetName() const override { return "echo"; }
+
+private:
+    float m_delayMs;
+    size_t m_repeat;
+    float m_wetLevel;
+    float m_dryLevel;
+    size_t m_delay = 0;             // Delay between echoes, in interleaved samples.
+    WaveformBuffer<float> m_history; // Ring buffer of the last m_delay * m_repeat input samples.
+    size_t m_index = 0;             // Interleaved index of the next input sample.
+};
+
+// Converts the audio to mono, by attenuating and mixing all of the
+// channels into one, or to stereo, by copying a mono channel into
+// both channels (as Waveform::ConvertToMono and ConvertToStereo do).
+class ChannelProcessor : public WaveformProcessor
+{
+public:
+    explicit ChannelProcessor(size_t numChannels) : m_numChannels(numChannels) {}
+    bool Configure(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat) override;
+    bool Process(const WaveformBlock *const *inputs, size_t numInputs, WaveformBlock &output) override;
+    const char *GetName() const override { return "channels"; }
+
+private:
+    size_t m_numChannels;
+};
+
+// Mixes any number of inputs together, each at its own volume level,
+// clipping the result to the range -1 to 1 (as WaveMix does).  The
+// mix has the sample rate of the first input; inputs at other rates
+// aren't resampled.  If the inputs don't all have the same number of
+// channels, the mix is in stereo and mono inputs are heard in both
+// channels.  The mix lasts as long as the longest input, in seconds.
+// To start an input later in the mix, use a WaveformOffsetSource.
+class MixProcessor : public WaveformProcessor
+{
+public:
+    explicit MixProcessor(const std::vector<float> &volumes) : m_volumes(volumes) {}
+    bool Configure(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat) override;
+    bool Process(const WaveformBlock *const *inputs, size_t numInputs, WaveformBlock &output) override;
+    const char *GetName() const override { return "mix"; }
+
+private:
+    std::vector<float> m_volumes;
+    size_t m_numSamples = 0;        // Length of the mix in samples (per channel).
+    size_t m_extraSamples = 0;      // Latency of the inputs, put out after that.
+    size_t m_position = 0;          // Number of samples (per channel) mixed so far.
+};
@@ -0,0 +1,217 @@
+//-------------------------------------------------------------------
+//
+// waveformprofile.h
+// Scoped timers and counters for finding where the time and memory
+// go while audio is loaded, converted, processed, and saved.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <vector>
+
+//
+// Profiling is off unless a program turns it on, typically for its
+// -Profile option.  While it's off, a WaveformProfileScope costs a
+// test of one flag.  While it's on, each thread adds up the times
+// and counts of its own scopes, without locks, and the totals of all
+// of the threads are reported when the program exits.
+//
+// Scopes may nest.  Each stage's "total" time includes the scopes
+// nested in it, on the same thread; its "self" time doesn't, so the
+// self times add up to the time spent in all of the stages.  Threads
+// that wait on each other (such as the reader, processing, and
+// writer threads of a pipelined WaveformGraph) count the time they
+// wait as a stage of its own, named "pipeline wait".
+//
+
+//
+// Turns profiling on.  When the program exits, a table of the
+// stages is printed to stdout; or, if 'jsonFilename' is given, the
+// stages are written to that file as JSON instead.
+//
+void WaveformProfileEnable(const wchar_t *jsonFilename = nullptr);
+
+// Prints or writes the report right away, instead of at exit.  The
+// totals are cleared, so it isn't printed again at exit unless more
+// stages run.  No other thread may be running scopes at the time.
+void WaveformProfileReport();
+
+//
+// Turns on recording of a timeline of the scopes that run on each
+// thread, including the thread pool's tasks and the time spent
+// waiting for them, which is written to 'filename' in the Chrome
+// trace event format when the program exits.  The trace can be
+// viewed in Perfetto (ui.perfetto.dev) or chrome://tracing, to see
+// where pipelined threads sit idle or parallel work is unbalanced.
+//
+void WaveformTraceEnable(const wchar_t *filename);
+
+// Writes the trace right away, instead of at exit, and clears it, so
+// it isn't written again at exit unless more scopes run.
+void WaveformTraceWrite();
+
+// Names the calling thread in the trace.  The name must be a string
+// that lasts as long as the program.
+void WaveformProfileNameThread(const char *name);
+
+// True while profiling, memory accounting, or tracing is on, so
+// scopes are being tracked.  Use WaveformProfileIsEnabled to test it.
+extern bool g_waveformProfileEnabled;
+
+inline bool WaveformProfileIsEnabled() { return g_waveformProfileEnabled; }
+
+//
+// Times the block of code it's declared in as one run of the named
+// stage, and counts the samples and bytes it handles.  The name must
+// be a string that lasts as long as the program (a string literal,
+// normally).  The counts may be given up front, or added with
+// AddCounts as they become known.
+//
+class WaveformProfileScope
+{
+public:
+    explicit WaveformProfileScope(const char *name, uint64_t samples = 0, uint64_t bytes = 0)
+    {
+        if (g_waveformProfileEnabled)
+            Begin(name, samples, bytes);
+    }
+
+    ~WaveformProfileScope()
+    {
+        if (m_name)
+            End();
+    }
+
+    WaveformProfileScope(const WaveformProfileScope &) = delete;
+    WaveformProfileScope &operator=(const WaveformProfileScope &) = delete;
+
+    void AddCounts(uint64_t samples, uint64_t bytes)
+    {
+        m_samples += samples;
+        m_bytes += bytes;
+    }
+
+    // Returns the stage name, or nullptr if profiling was off when
+    // the scope began.
+    const char *GetName() const { return m_name; }
+
+    // Notes what the scope is working on, such as a filename, to be
+    // shown with it in the trace.  The string must last until the
+    // scope ends.
+    void SetDetail(const wchar_t *detail) { m_detail = detail; }
+
+private:
+    void Begin(const char *name, uint64_t samples, uint64_t bytes);
+    void End();
+
+    const char *m_name = nullptr;           // Null if profiling was off.
+    WaveformProfileScope *m_parent = nullptr;
+    uint64_t m_start = 0;                   // In nanoseconds.
+    uint64_t m_childTime = 0;               // Of the scopes nested in this one.
+    uint64_t m_samples = 0;
+    uint64_t m_bytes = 0;
+    const wchar_t *m_detail = nullptr;
+};
+
+//
+// Memory accounting keeps track of the sample buffers of Waveform
+// objects and the I/O buffers used to load and save them, which are
+// allocated with WaveformBufferAllocator.  Each allocation is charged
+// to the innermost WaveformProfileScope on the thread that made it
+// (or to "other", outside of any scope), and the report shows, for
+// each stage, how many buffers it allocated, the most bytes its
+// buffers held at once, and how many of its bytes were still held
+// when the program as a whole held the most.
+//
+// Turns memory accounting on.  When the program exits, a table of
+// the stages is printed to stdout; or, if 'jsonFilename' is given,
+// the stages are written to that file as JSON instead.  Buffers
+// allocated before this is called aren't counted.
+//
+void WaveformMemStatsEnable(const wchar_t *jsonFilename = nullptr);
+
+// Prints or writes the memory report right away, instead of at exit.
+// Unlike the times, the memory totals are kept.
+void WaveformMemStatsReport();
+
+// Returns the bytes held in buffers now, and the most held at once,
+// since memory accounting was turned on.
+size_t WaveformMemStatsGetCurrentBytes();
+size_t WaveformMemStatsGetPeakBytes();
+
+// True while memory accounting is on.
+extern bool g_waveformMemStatsEnabled;
+
+// Allocates or frees a buffer of the given size, counting it if
+// memory accounting is on.  The stage it was charged to is kept with
+// the buffer, so it may be freed on any thread.
+void *WaveformBufferAlloc(size_t bytes);
+void WaveformBufferFree(void *p, size_t bytes);
+
+// An allocator for standard containers that counts their buffers.
+template <class T>
+class WaveformBufferAllocator
+{
+public:
+    typedef T value_type;
+
+    WaveformBufferAllocator() = default;
+    template <class U> WaveformBufferAllocator(const WaveformBufferAllocator<U> &) {}
+
+    T *allocate(size_t count)
+    {
+        if (count > static_cast<size_t>(-1) / sizeof(T))
+            throw std::bad_alloc();
+        return static_cast<T *>(WaveformBufferAlloc(count * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t count)
+    {
+        WaveformBufferFree(p, count * sizeof(T));
+    }
+
+    template <class U> bool operator==(const WaveformBufferAllocator<U> &) const { return true; }
+    template <class U> bool operator!=(const WaveformBufferAllocator<U> &) const { return false; }
+};
+
+// A vector whose storage is counted by memory accounting.
+template <class T>
+using WaveformBuffer = std::vector<T, WaveformBufferAllocator<T>>;
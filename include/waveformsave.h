@@ -49,6 +49,11 @@
 //
 // Returns true if successful, false if error.
 //
+// If the filename is "-", the audio is written to standard output
+// in WAV format, so it can be piped into another program.  The WAV
+// headers go out before the audio, with placeholder sizes that are
+// filled in at the end if standard output is redirected to a file.
+//
 // If a pointer to status callback function is provided,
 // it will be called periodically during the saving
 // procedure, with a completion parameter value ranging
@@ -57,6 +62,10 @@
 // returns false, the saving is immediately aborted.
 // The status callback mechanism is provided so that the
 // caller may update a status display if desired.
+// While the audio is being converted, encoded, and written,
+// it's called every few milliseconds (see
+// WaveformProgress), always on the calling thread, so
+// a caller that wants to cancel is heard from promptly.
 //
 bool WaveformSaveToFile(
         const wchar_t *filename,
@@ -74,3 +83,47 @@ bool WaveformSaveToFile(
         unsigned useBytesPerSample = 2
         );
 
+//
+// Writes audio to an audio file as it's produced, a block at a
+// time, so the whole waveform never has to be in memory at once.
+// The audio has the given sample rate and number of channels, and
+// is 'numSamples' samples (per channel) long.
+//
+// The block callback is called repeatedly to fill 'samples' with up
+// to 'maxFrames' sample frames of interleaved samples, setting
+// 'numFrames' to the number of frames it filled; filling none means
+// the audio has ended.  If the audio ends early, the rest is saved
+// as silence; running past 'numSamples' is an error.  If the block
+// callback returns false, the saving is stopped and this fails.
+//
+// WAV files, and standard output, are written as the blocks arrive.
+// Other formats are gathered into a Waveform and then saved as with
+// WaveformSaveToFile.  'channelMask' gives the speaker positions of
+// the channels, as Waveform::GetChannelMask does.  The other
+// parameters are the same as for WaveformSaveToFile.  Returns true
+// if successful.
+//
+bool WaveformSaveInBlocks(
+        const wchar_t *filename,
+        unsigned rate,
+        size_t numChannels,
+        size_t numSamples,
+        bool (*block_func)(void *context, float *samples, size_t maxFrames, size_t &numFrames),
+        void *block_context,
+        void *status_callback_context = nullptr,
+        bool (*status_callback_func)(void *context, float completion) = nullptr,
+        bool useFloat = false,
+        unsigned useBytesPerSample = 2,
+        uint32_t channelMask = 0
+        );
+
+//
+// Sets aside standard output for the audio that's saved to "-".
+// Since the tools print their progress messages to stdout, a
+// program that saves audio to "-" should call this before it
+// prints anything.  From then on, whatever the program prints to
+// stdout goes to stderr instead, and only the audio goes to the
+// real standard output.  WaveformSaveToFile calls this itself if
+// the program didn't.  Returns true if successful.
+//
+bool WaveformReserveStdout();
@@ -40,6 +40,14 @@
 //--------------------------------------------------------------------
 
 #include "waveform.h"
+#include "threadpool.h"
+#include "dspkernels.h"
+#include "waveformprofile.h"
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <mutex>
 
 //--------------------------------------------------
 // Initialize
@@ -61,6 +69,7 @@ bool Waveform::Populate(
         return false;
 
     m_numChannels = numChannels;
+    m_channelMask = 0;
     m_data.resize(numSamples * numChannels);
     size_t numBytes = numSamples * numChannels * sizeof(float);
     if (numBytes > 0)
@@ -90,7 +99,7 @@ size_t Waveform::GetNumSamples() const
 // Returns the total size of the sample buffer in bytes.
 size_t Waveform::GetTotalBytes() const
 {
-    return m_data.size();
+    return m_data.size() * sizeof(float);
 }
 
 // Returns the duration of the waveform in seconds.
@@ -144,12 +153,17 @@ float Waveform::GetHighestSample() const
         return 0.0f;
 
     float highest = -FLT_MAX;
-    size_t count = m_data.size();
-    for (size_t index = 0; index < count; index++)
-    {
-        if (m_data[index] > highest)
-            highest = m_data[index];
-    }
+    std::mutex mutex;
+    const float *data = m_data.data();
+    ThreadPool::GetShared().ParallelFor(m_data.size(), sizeof(float), [&](size_t first, size_t end) {
+        float lowestHere = FLT_MAX, highestHere = -FLT_MAX;
+        DSPKernelsGet().MinMax(data + first, end - first, lowestHere, highestHere);
+        const float local = highestHere;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (local > highest)
+            highest = local;
+    });
 
     return highest;
 }
@@ -162,12 +176,17 @@ float Waveform::GetLowestSample() const
         return 0.0f;
 
     float lowest = FLT_MAX;
-    size_t count = m_data.size();
-    for (size_t index = 0; index < count; index++)
-    {
-        if (m_data[index] < lowest)
-            lowest = m_data[index];
-    }
+    std::mutex mutex;
+    const float *data = m_data.data();
+    ThreadPool::GetShared().ParallelFor(m_data.size(), sizeof(float), [&](size_t first, size_t end) {
+        float lowestHere = FLT_MAX, highestHere = -FLT_MAX;
+        DSPKernelsGet().MinMax(data + first, end - first, lowestHere, highestHere);
+        const float local = lowestHere;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (local < lowest)
+            lowest = local;
+    });
 
     return lowest;
 }
@@ -180,20 +199,36 @@ size_t Waveform::FindHighestSample(size_t channel) const
     if (m_data.empty() || channel >= m_numChannels)
         return 0;
 
+    // Each range of samples finds its own highest sample, then the
+    // ranges' results are combined.  Of equal samples, the earliest
+    // is the one that's found, however the ranges finish.
     float high = -FLT_MAX;
-    size_t highIndex = 0;
-    size_t numSamples = GetNumSamples();
-    for (size_t index = 0; index < numSamples; index++)
-    {
-        float sample = m_data[index * m_numChannels + channel];
-        if (sample > high)
+    size_t highIndex = SIZE_MAX;
+    std::mutex mutex;
+    const float *data = m_data.data() + channel;
+    const size_t stride = m_numChannels;
+    ThreadPool::GetShared().ParallelFor(GetNumSamples(), stride * sizeof(float), [&](size_t first, size_t end) {
+        float localHigh = -FLT_MAX;
+        size_t localIndex = SIZE_MAX;
+        for (size_t index = first; index < end; index++)
         {
-            high = sample;
-            highIndex = index;
+            if (data[index * stride] > localHigh)
+            {
+                localHigh = data[index * stride];
+                localIndex = index;
+            }
         }
-    }
 
-    return highIndex;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (localIndex != SIZE_MAX &&
+            (localHigh > high || (localHigh == high && localIndex < highIndex)))
+        {
+            high = localHigh;
+            highIndex = localIndex;
+        }
+    });
+
+    return (highIndex == SIZE_MAX) ? 0 : highIndex;
 }
 
 // Scans the samples of the specified channel of the waveform
@@ -204,20 +239,35 @@ size_t Waveform::FindLowestSample(size_t channel) const
     if (m_data.empty() || channel >= m_numChannels)
         return 0;
 
+    // As in FindHighestSample, the earliest of equal samples is
+    // the one that's found.
     float low = FLT_MAX;
-    size_t lowIndex = 0;
-    size_t numSamples = GetNumSamples();
-    for (size_t index = 0; index < numSamples; index++)
-    {
-        float sample = m_data[index * m_numChannels + channel];
-        if (sample < low)
+    size_t lowIndex = SIZE_MAX;
+    std::mutex mutex;
+    const float *data = m_data.data() + channel;
+    const size_t stride = m_numChannels;
+    ThreadPool::GetShared().ParallelFor(GetNumSamples(), stride * sizeof(float), [&](size_t first, size_t end) {
+        float localLow = FLT_MAX;
+        size_t localIndex = SIZE_MAX;
+        for (size_t index = first; index < end; index++)
         {
-            low = sample;
-            lowIndex = index;
+            if (data[index * stride] < localLow)
+            {
+                localLow = data[index * stride];
+                localIndex = index;
+            }
         }
-    }
 
-    return lowIndex;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (localIndex != SIZE_MAX &&
+            (localLow < low || (localLow == low && localIndex < lowIndex)))
+        {
+            low = localLow;
+            lowIndex = localIndex;
+        }
+    });
+
+    return (lowIndex == SIZE_MAX) ? 0 : lowIndex;
 }
 
 //--------------------------------------------------
@@ -237,9 +287,11 @@ bool Waveform::SetSample(size_t sampleIndex, size_t channel, float value)
 
 bool Waveform::ConvertToMono()
 {
+    WaveformProfileScope profile("Waveform::ConvertToMono", m_data.size(), m_data.size() * sizeof(float) * 2);
     if (m_data.empty())
     {
         m_numChannels = 1;
+        m_channelMask = 0;
         return true; // No data to convert.
     }
 
@@ -250,28 +302,37 @@ bool Waveform::ConvertToMono()
         return false; // Invalid channel count!
 
     size_t numSamples = GetNumSamples();
-    std::vector<float> newData(numSamples);
+    WaveformBuffer<float> newData(numSamples);
 
-    for (size_t index = 0; index < numSamples; index++)
-    {
-        float val = 0.0;
+    const float *in = m_data.data();
+    float *out = newData.data();
+    const size_t numChannels = m_numChannels;
+    ThreadPool::GetShared().ParallelFor(numSamples, (numChannels + 1) * sizeof(float), [=](size_t first, size_t end) {
+        for (size_t index = first; index < end; index++)
+        {
+            float val = 0.0;
 
-        for (size_t channel = 0; channel < m_numChannels; channel++)
-            val += GetSample(index, channel) / m_numChannels;
+            const float *frame = in + index * numChannels;
+            for (size_t channel = 0; channel < numChannels; channel++)
+                val += frame[channel] / numChannels;
 
-        newData[index] = val;
-    }
+            out[index] = val;
+        }
+    });
 
-    m_data = newData;
+    m_data.swap(newData);
     m_numChannels = 1;
+    m_channelMask = 0;
     return true;
 }
 
 bool Waveform::ConvertToStereo()
 {
+    WaveformProfileScope profile("Waveform::ConvertToStereo", m_data.size(), m_data.size() * sizeof(float) * 2);
     if (m_data.empty())
     {
         m_numChannels = 2;
+        m_channelMask = 0;
         return true; // No data to convert.
     }
 
@@ -282,18 +343,21 @@ bool Waveform::ConvertToStereo()
         return true; // Already in the requested format.
 
     size_t numSamples = GetNumSamples();
-    std::vector<float> newData(numSamples * 2);
+    WaveformBuffer<float> newData(numSamples * 2);
 
-    for (size_t index = 0; index < numSamples; index++)
-    {
-        float val = GetSample(index, 0);
-
-        for (size_t channel = 0; channel < 2; channel++)
-            newData[index * 2 + channel] = val;
-    }
+    const float *in = m_data.data();
+    float *out = newData.data();
+    ThreadPool::GetShared().ParallelFor(numSamples, 3 * sizeof(float), [=](size_t first, size_t end) {
+        for (size_t index = first; index < end; index++)
+        {
+            out[index * 2] = in[index];
+            out[index * 2 + 1] = in[index];
+        }
+    });
 
-    m_data = newData;
+    m_data.swap(newData);
     m_numChannels = 2;
+    m_channelMask = 0;
     return true;
 }
 
@@ -387,6 +451,7 @@ bool Waveform::Insert(size_t start, size_t count)
 // Returns true if successful.
 bool Waveform::Stretch(size_t newNumSamples)
 {
+    WaveformProfileScope profile("Waveform::Stretch", m_data.size(), m_data.size() * sizeof(float) * 2);
     if (newNumSamples < 1)
         return false;
 
@@ -424,6 +489,7 @@ bool Waveform::Stretch(size_t newNumSamples)
 // Returns true if successful.
 bool Waveform::Resample(unsigned Hz)
 {
+    WaveformProfileScope profile("Waveform::Resample", m_data.size(), m_data.size() * sizeof(float) * 2);
     if (Hz < 1)
         return false;
 
@@ -453,17 +519,14 @@ bool Waveform::Resample(unsigned Hz)
 // Multiplies all samples in the waveform by the given value.
 bool Waveform::Multiply(float value)
 {
+    WaveformProfileScope profile("Waveform::Multiply", m_data.size(), m_data.size() * sizeof(float) * 2);
     if (m_data.empty())
         return false;
 
-    size_t numSamples = GetNumSamples();
-    for (size_t index = 0; index < numSamples; index++)
-    {
-        for (size_t channel = 0; channel < m_numChannels; channel++)
-        {
-            m_data[index * m_numChannels + channel] *= value;
-        }
-    }
+    float *data = m_data.data();
+    ThreadPool::GetShared().ParallelFor(m_data.size(), sizeof(float), [=](size_t first, size_t end) {
+        DSPKernelsGet().Gain(data + first, data + first, end - first, value);
+    });
 
     return true;
 }
@@ -471,17 +534,15 @@ bool Waveform::Multiply(float value)
 // Adds the given value to all samples in the waveform.
 bool Waveform::Add(float value)
 {
+    WaveformProfileScope profile("Waveform::Add", m_data.size(), m_data.size() * sizeof(float) * 2);
     if (m_data.empty())
         return false;
 
-    size_t numSamples = GetNumSamples();
-    for (size_t index = 0; index < numSamples; index++)
-    {
-        for (size_t channel = 0; channel < m_numChannels; channel++)
-        {
-            m_data[index * m_numChannels + channel] += value;
-        }
-    }
+    float *data = m_data.data();
+    ThreadPool::GetShared().ParallelFor(m_data.size(), sizeof(float), [=](size_t first, size_t end) {
+        for (size_t index = first; index < end; index++)
+            data[index] += value;
+    });
 
     return true;
 }
@@ -489,24 +550,14 @@ bool Waveform::Add(float value)
 // Clips all samples to the given range.
 bool Waveform::Clip(float lowest, float highest)
 {
+    WaveformProfileScope profile("Waveform::Clip", m_data.size(), m_data.size() * sizeof(float) * 2);
     if (m_data.empty())
         return true;
 
-    size_t numSamples = GetNumSamples();
-    for (size_t index = 0; index < numSamples; index++)
-    {
-        for (size_t channel = 0; channel < m_numChannels; channel++)
-        {
-            float sample = m_data[index * m_numChannels + channel];
-
-            if (sample < lowest)
-                sample = lowest;
-            if (sample > highest)
-                sample = highest;
-
-            m_data[index * m_numChannels + channel] = sample;
-        }
-    }
+    float *data = m_data.data();
+    ThreadPool::GetShared().ParallelFor(m_data.size(), sizeof(float), [=](size_t first, size_t end) {
+        DSPKernelsGet().GainClip(data + first, data + first, end - first, 1.0f, lowest, highest);
+    });
 
     return true;
 }
@@ -515,6 +566,7 @@ bool Waveform::Clip(float lowest, float highest)
 // it fits within the given range of sample values.
 bool Waveform::Fit(float lowest, float highest)
 {
+    WaveformProfileScope profile("Waveform::Fit", m_data.size(), m_data.size() * sizeof(float) * 2);
     if (m_data.empty())
         return true;
     if (lowest >= highest)
@@ -531,20 +583,19 @@ bool Waveform::Fit(float lowest, float highest)
     if (delta < tiny_value || dataDelta < tiny_value)
         return false;
 
-    size_t numSamples = GetNumSamples();
-    for (size_t index = 0; index < numSamples; index++)
-    {
-        for (size_t channel = 0; channel < m_numChannels; channel++)
+    float *data = m_data.data();
+    ThreadPool::GetShared().ParallelFor(m_data.size(), sizeof(float), [=](size_t first, size_t end) {
+        for (size_t index = first; index < end; index++)
         {
-            float sample = m_data[index * m_numChannels + channel];
+            float sample = data[index];
 
             sample -= dataLowest;
             sample = sample * delta / dataDelta;
             sample += lowest;
 
-            m_data[index * m_numChannels + channel] = sample;
+            data[index] = sample;
         }
-    }
+    });
 
     return true;
 }
@@ -562,6 +613,7 @@ static float dbToLinear(float db)
 // and -100dB is quietest.
 void Waveform::Normalize(float dbLevel)
 {
+    WaveformProfileScope profile("Waveform::Normalize", m_data.size(), m_data.size() * sizeof(float) * 2);
     if (dbLevel > 0.0f)
         dbLevel = 0.0f;
     if (dbLevel < -100.0f)
@@ -580,23 +632,39 @@ void Waveform::Normalize(float dbLevel)
     //
     // So it behaves kind of like an analog microphone compressor.
     //
+    // Only working out the gains has to be done in order.  The
+    // peaks of the chunks are found, and the gains applied to the
+    // chunks, on all of the threads of the pool.
+    //
 
     const float maxVol = dbToLinear(dbLevel);
     const unsigned samplesPerChunk = static_cast<unsigned>(m_rate * 0.01f * m_numChannels);
     const unsigned numChunks = static_cast<unsigned>(m_data.size() / samplesPerChunk);
     float gain = 1.0f;
 
-    for (unsigned chunk = 0; chunk < numChunks; chunk++)
-    {
-        // Determine the peak volume of the samples in this chunk.
-        unsigned isample = static_cast<unsigned>(chunk * samplesPerChunk);
-        float local_peak = 0.0f;
-        for (unsigned subsample = 0; subsample < samplesPerChunk; subsample++)
+    // Determine the peak volume of the samples in each chunk.
+    std::vector<float> peaks(numChunks);
+    float *data = m_data.data();
+    ThreadPool &pool = ThreadPool::GetShared();
+    pool.ParallelFor(numChunks, samplesPerChunk * sizeof(float), [&](size_t first, size_t end) {
+        for (size_t chunk = first; chunk < end; chunk++)
         {
-            float vol = fabsf(m_data[isample + subsample]);
-            if (vol > local_peak)
-                local_peak = vol;
+            const float *chunkData = data + chunk * samplesPerChunk;
+            float local_peak = 0.0f;
+            for (unsigned subsample = 0; subsample < samplesPerChunk; subsample++)
+            {
+                float vol = fabsf(chunkData[subsample]);
+                if (vol > local_peak)
+                    local_peak = vol;
+            }
+            peaks[chunk] = local_peak;
         }
+    });
+
+    std::vector<float> gains(numChunks);
+    for (unsigned chunk = 0; chunk < numChunks; chunk++)
+    {
+        float local_peak = peaks[chunk];
 
         // If this chunks's peak volume is less than the target max,
         // gradually increase the gain.
@@ -613,15 +681,65 @@ void Waveform::Normalize(float dbLevel)
                 gain = maxVol / local_peak;
         }
 
-        // Apply the gain multiplier to the samples in this chunk.
-        // If this is the last full chunk, also apply the gain to
-        // any remaining partial chunk at the very end of the
-        // waveform.
-        size_t count = samplesPerChunk;
-        if (chunk == numChunks - 1)
-            count = m_data.size() - isample;
-        for (size_t subsample = 0; subsample < count; subsample++)
-            m_data[isample + subsample] *= gain;
+        gains[chunk] = gain;
     }
+
+    // Apply each chunk's gain multiplier to the samples in the
+    // chunk.  The last full chunk's gain also applies to any
+    // remaining partial chunk at the very end of the waveform.
+    const size_t totalSamples = m_data.size();
+    pool.ParallelFor(numChunks, samplesPerChunk * sizeof(float), [&](size_t first, size_t end) {
+        for (size_t chunk = first; chunk < end; chunk++)
+        {
+            size_t isample = chunk * samplesPerChunk;
+            size_t count = samplesPerChunk;
+            if (chunk == numChunks - 1)
+                count = totalSamples - isample;
+            for (size_t subsample = 0; subsample < count; subsample++)
+                data[isample + subsample] *= gains[chunk];
+        }
+    });
 }
 
+//--------------------------------------------------
+// Progress
+//--------------------------------------------------
+
+WaveformProgress::WaveformProgress(
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion),
+        float start,
+        float end)
+    : m_context(status_callback_context),
+      m_func(status_callback_func),
+      m_start(start),
+      m_end(end),
+      m_lastCall(std::chrono::steady_clock::now())
+{
+}
+
+// Reports that 'done' of 'total' units of the work are done, calling
+// the status callback if at least kIntervalMs milliseconds have
+// passed since it was last called.  Returns false if the operation
+// has been cancelled.
+bool WaveformProgress::Update(uint64_t done, uint64_t total)
+{
+    if (IsCancelled())
+        return false;
+    if (!m_func)
+        return true;
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_lastCall < std::chrono::milliseconds(static_cast<int64_t>(kIntervalMs)))
+        return true;
+    m_lastCall = now;
+
+    float fraction = (total > 0) ? static_cast<float>(static_cast<double>(done) / static_cast<double>(total)) : 1.0f;
+    if (!m_func(m_context, m_start + (m_end - m_start) * fraction))
+    {
+        m_cancelled.store(true, std::memory_order_relaxed);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,557 @@
+//-------------------------------------------------------------------
+//
+// waveformbatch.cpp
+// C++ functions for running the same operation over many audio
+// files at once.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+
+#include "waveformbatch.h"
+#include "waveformload.h"
+#include "waveformprofile.h"
+#include "platform.h"
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+//#define TRACE
+
+//--------------------------------------------------
+// Input and output file names
+//--------------------------------------------------
+
+// Returns the index of the first character of the last part of a
+// path, just past its directory.
+static size_t FindNameStart(const std::wstring &path)
+{
+    size_t found = path.find_last_of(L"\\/:");
+    return (found == std::wstring::npos) ? 0 : found + 1;
+}
+
+// Returns the separator to use when adding a name to the given
+// directory:  the one the directory already uses, if any.
+static wchar_t GetSeparator(const std::wstring &dir)
+{
+    size_t found = dir.find_last_of(L"\\/");
+    return (found == std::wstring::npos) ? kPathSeparator : dir[found];
+}
+
+// Returns true if the name ends with one of the extensions that
+// WaveformLoadFromFile recognizes.
+static bool IsAudioFilename(const wchar_t *filename)
+{
+    static const wchar_t *const extensions[] = { L".wav", L".mp3", L".flac", L".raw", L".pcm" };
+
+    const wchar_t *extension = wcsrchr(filename, '.');
+    if (!extension)
+        return false;
+
+    for (const wchar_t *audioExtension : extensions)
+    {
+        if (_wcsicmp(extension, audioExtension) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Returns true if the path names an existing directory.
+static bool IsDirectory(std::wstring path)
+{
+    // Windows won't stat a directory whose name has a trailing
+    // separator, unless it's the root.
+    while (path.size() > 1 && (path.back() == '\\' || path.back() == '/') && path[path.size() - 2] != ':')
+        path.pop_back();
+
+    struct _stat64 st;
+    return _wstat64(path.c_str(), &st) == 0 && (st.st_mode & _S_IFMT) == _S_IFDIR;
+}
+
+// Appends the names of the files that match 'pattern', which may
+// have wildcards in its last part, to 'filenames', sorted by name.
+// If 'audioOnly' is true, only audio files are listed.  Returns the
+// number of files added.
+static size_t ListFiles(const std::wstring &pattern, bool audioOnly, std::vector<std::wstring> &filenames)
+{
+    std::wstring dir = pattern.substr(0, FindNameStart(pattern));
+    std::vector<std::wstring> found;
+
+    struct _wfinddata64_t data;
+    intptr_t handle = _wfindfirst64(pattern.c_str(), &data);
+    if (handle == -1)
+        return 0;
+    do
+    {
+        if ((data.attrib & _A_SUBDIR) != 0)
+            continue;
+        if (audioOnly && !IsAudioFilename(data.name))
+            continue;
+        found.push_back(dir + data.name);
+    } while (_wfindnext64(handle, &data) == 0);
+    _findclose(handle);
+
+    std::sort(found.begin(), found.end());
+    filenames.insert(filenames.end(), found.begin(), found.end());
+    return found.size();
+}
+
+// Appends the files named by one input specification.  If
+// 'allowList' is false, the specification can't be an '@' list.
+static bool ExpandInput(const std::wstring &spec, bool allowList, std::vector<std::wstring> &filenames)
+{
+    if (spec.empty())
+        return true;
+
+    if (spec == L"-")
+    {
+        printf("Standard input can't be used in a batch.\n");
+        return false;
+    }
+
+    if (spec[0] == '@')
+    {
+        if (!allowList)
+        {
+            printf("File list '%S' can't be named in another file list.\n", spec.c_str() + 1);
+            return false;
+        }
+
+        FILE *fp = nullptr;
+        if (_wfopen_s(&fp, spec.c_str() + 1, L"rt") != 0 || !fp)
+        {
+            printf("Failed opening file list '%S'.\n", spec.c_str() + 1);
+            return false;
+        }
+
+        bool ok = true;
+        wchar_t line[1024];
+        while (ok && fgetws(line, _countof(line), fp))
+        {
+            // Trim the white space from both ends of the line.
+            wchar_t *start = line;
+            while (iswspace(*start))
+                start++;
+            size_t length = wcslen(start);
+            while (length > 0 && iswspace(start[length - 1]))
+                start[--length] = '\0';
+
+            if (*start != '\0' && *start != '#')
+                ok = ExpandInput(start, false, filenames);
+        }
+        fclose(fp);
+        return ok;
+    }
+
+    if (spec.find_first_of(L"*?", FindNameStart(spec)) != std::wstring::npos)
+    {
+        if (ListFiles(spec, false, filenames) == 0)
+        {
+            printf("No files match '%S'.\n", spec.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    if (IsDirectory(spec))
+    {
+        std::wstring pattern = spec;
+        if (pattern.back() != '\\' && pattern.back() != '/' && pattern.back() != ':')
+            pattern += GetSeparator(pattern);
+        pattern += L"*";
+        if (ListFiles(pattern, true, filenames) == 0)
+        {
+            printf("No audio files in directory '%S'.\n", spec.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Anything else is taken as a file name.  If the file doesn't
+    // exist, that's reported when it's processed.
+    filenames.push_back(spec);
+    return true;
+}
+
+//
+// Expands the given input specifications into a list of audio file
+// names, which are appended to 'filenames'.
+//
+bool WaveformBatchExpandInputs(
+        const std::vector<std::wstring> &specs,
+        std::vector<std::wstring> &filenames
+        )
+{
+    for (const std::wstring &spec : specs)
+    {
+        if (!ExpandInput(spec, true, filenames))
+            return false;
+    }
+    return true;
+}
+
+//
+// Returns the name of the output file for the given input file,
+// made from a naming template.
+//
+std::wstring WaveformBatchOutputName(const wchar_t *nameTemplate, const wchar_t *inFilename)
+{
+    std::wstring input(inFilename);
+    size_t nameStart = FindNameStart(input);
+    size_t dot = input.rfind('.');
+    if (dot == std::wstring::npos || dot < nameStart)
+        dot = input.size();
+
+    std::wstring dir = input.substr(0, nameStart);
+    std::wstring name = input.substr(nameStart, dot - nameStart);
+    std::wstring ext = (dot < input.size()) ? input.substr(dot + 1) : std::wstring();
+
+    std::wstring output(nameTemplate);
+    bool replaced = false;
+    static const wchar_t *const fields[] = { L"{dir}", L"{name}", L"{ext}" };
+    const std::wstring *values[] = { &dir, &name, &ext };
+    for (size_t ifield = 0; ifield < _countof(fields); ifield++)
+    {
+        size_t fieldLength = wcslen(fields[ifield]);
+        for (size_t pos = output.find(fields[ifield]); pos != std::wstring::npos;
+             pos = output.find(fields[ifield], pos + values[ifield]->size()))
+        {
+            output.replace(pos, fieldLength, *values[ifield]);
+            replaced = true;
+        }
+    }
+
+    // A template with no fields names an output directory.
+    if (!replaced)
+    {
+        if (!output.empty() && output.back() != '\\' && output.back() != '/' && output.back() != ':')
+            output += GetSeparator(output);
+        output += input.substr(nameStart);
+    }
+
+    return output;
+}
+
+//--------------------------------------------------
+// WaveformBatch
+//--------------------------------------------------
+
+// Hands out the files of a batch to the worker threads.  Each worker
+// has its own queue of files, which it takes from the front of.  A
+// worker whose queue is empty steals from the back of the others'
+// queues, so the small files dealt out last are the ones that move,
+// and the workers don't often contend for the same end of a queue.
+class WaveformBatch::Scheduler
+{
+public:
+    Scheduler(std::vector<File> &files, unsigned numWorkers, size_t memoryBudget)
+        : m_files(files), m_memoryBudget(memoryBudget)
+    {
+        for (unsigned i = 0; i < numWorkers; i++)
+            m_queues.emplace_back(new WorkQueue);
+    }
+
+    // Deals out the given files to the workers, in turn.
+    void Deal(const std::vector<size_t> &indexes)
+    {
+        for (size_t i = 0; i < indexes.size(); i++)
+            m_queues[i % m_queues.size()]->m_files.push_back(indexes[i]);
+    }
+
+    // Processes files on behalf of the given worker until there are
+    // none left.
+    void WorkerMain(unsigned worker, const Operation &operation)
+    {
+        // The calling thread is worker 0, and keeps its own name.
+        if (worker != 0)
+            WaveformProfileNameThread("batch worker");
+        size_t index;
+        while (TakeFile(worker, index))
+        {
+            File &file = m_files[index];
+            WaveformProfileScope profile("file");
+            profile.SetDetail(file.m_inFilename.c_str());
+            {
+                WaveformProfileScope wait("memory wait");
+                Admit(file.m_memoryNeeded);
+            }
+
+#ifdef TRACE
+            printf("WaveformBatch worker %u starting '%S'\n", worker, file.m_inFilename.c_str());
+#endif
+
+            try
+            {
+                bool ok = operation(file.m_inFilename.c_str(),
+                    file.m_outFilename.empty() ? nullptr : file.m_outFilename.c_str());
+                file.m_status = ok ? Status::Succeeded : Status::Failed;
+            }
+            catch(...)
+            {
+                file.m_status = Status::Exception;
+            }
+
+            Release(file.m_memoryNeeded);
+        }
+    }
+
+private:
+    struct WorkQueue
+    {
+        std::mutex m_mutex;
+        std::deque<size_t> m_files;
+    };
+
+    // Takes the next file for a worker, from its own queue if it
+    // can, otherwise from the back of another worker's queue.
+    // Returns false if every queue is empty.
+    bool TakeFile(unsigned worker, size_t &index)
+    {
+        {
+            WorkQueue &own = *m_queues[worker];
+            std::lock_guard<std::mutex> lock(own.m_mutex);
+            if (!own.m_files.empty())
+            {
+                index = own.m_files.front();
+                own.m_files.pop_front();
+                return true;
+            }
+        }
+
+        for (size_t i = 1; i < m_queues.size(); i++)
+        {
+            WorkQueue &other = *m_queues[(worker + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(other.m_mutex);
+            if (!other.m_files.empty())
+            {
+                index = other.m_files.back();
+                other.m_files.pop_back();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Waits until a file needing the given amount of memory fits in
+    // the budget, then counts it as in use.  A file is let through
+    // if nothing else is running, so one too large for the budget
+    // still gets processed.
+    void Admit(size_t numBytes)
+    {
+        std::unique_lock<std::mutex> lock(m_memoryMutex);
+        if (m_memoryBudget)
+        {
+            m_memoryFreed.wait(lock, [&] {
+                return m_numRunning == 0 || m_memoryInUse + numBytes <= m_memoryBudget;
+            });
+        }
+        m_memoryInUse += numBytes;
+        m_numRunning++;
+    }
+
+    // Returns a finished file's memory to the budget.
+    void Release(size_t numBytes)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_memoryMutex);
+            m_memoryInUse -= numBytes;
+            m_numRunning--;
+        }
+        m_memoryFreed.notify_all();
+    }
+
+    std::vector<File> &m_files;
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+
+    size_t m_memoryBudget;
+    size_t m_memoryInUse = 0;
+    unsigned m_numRunning = 0;
+    std::mutex m_memoryMutex;
+    std::condition_variable m_memoryFreed;
+};
+
+// Adds an input file to the batch, with the name of its output file.
+void WaveformBatch::AddFile(const wchar_t *inFilename, const wchar_t *outFilename)
+{
+    File file;
+    file.m_inFilename = inFilename;
+    if (outFilename)
+        file.m_outFilename = outFilename;
+
+    // Loading the file takes its samples in floating point, and most
+    // operations make another waveform of about the same size.
+    WaveformFileInfo info;
+    if (WaveformReadFileInfo(inFilename, info))
+        file.m_memoryNeeded = info.m_numSamples * info.m_numChannels * sizeof(float) * 2;
+
+    m_files.push_back(file);
+}
+
+// Adds each of the input files, naming their outputs from a template.
+void WaveformBatch::AddFiles(const std::vector<std::wstring> &inFilenames, const wchar_t *nameTemplate)
+{
+    for (const std::wstring &inFilename : inFilenames)
+    {
+        if (nameTemplate)
+            AddFile(inFilename.c_str(), WaveformBatchOutputName(nameTemplate, inFilename.c_str()).c_str());
+        else
+            AddFile(inFilename.c_str(), nullptr);
+    }
+}
+
+// Runs the operation on every file.  Returns true if it succeeded
+// on every file.
+bool WaveformBatch::Run(const Operation &operation)
+{
+    //
+    // Check that no output would overwrite an input, or another
+    // output of the batch.  File names are compared without regard
+    // to case, as Windows does.
+    //
+
+    std::map<std::wstring, size_t> outputs;
+    std::vector<size_t> pending;
+    for (size_t index = 0; index < m_files.size(); index++)
+    {
+        File &file = m_files[index];
+        if (file.m_status != Status::Pending)
+            continue;
+
+        if (!file.m_outFilename.empty())
+        {
+            if (_wcsicmp(file.m_outFilename.c_str(), file.m_inFilename.c_str()) == 0)
+            {
+                file.m_status = Status::SameAsInput;
+                continue;
+            }
+
+            std::wstring key(file.m_outFilename);
+            for (wchar_t &c : key)
+                c = static_cast<wchar_t>(towlower(c));
+            if (!outputs.insert(std::make_pair(key, index)).second)
+            {
+                file.m_status = Status::DuplicateOutput;
+                continue;
+            }
+        }
+
+        pending.push_back(index);
+    }
+
+    if (pending.empty())
+        return GetErrorCount() == 0;
+
+    //
+    // Deal out the largest files first, so the small ones are left
+    // at the end to even out the workers' loads.
+    //
+
+    std::stable_sort(pending.begin(), pending.end(), [&](size_t a, size_t b) {
+        return m_files[a].m_memoryNeeded > m_files[b].m_memoryNeeded;
+    });
+
+    unsigned numWorkers = m_numThreads ? m_numThreads : std::thread::hardware_concurrency();
+    if (numWorkers == 0)
+        numWorkers = 1;
+    if (numWorkers > pending.size())
+        numWorkers = static_cast<unsigned>(pending.size());
+
+    // There's no use having more workers than the number of the
+    // smallest files that fit in the memory budget together.
+    if (m_memoryBudget)
+    {
+        size_t total = 0;
+        unsigned fit = 0;
+        for (auto it = pending.rbegin(); it != pending.rend() && fit < numWorkers; ++it, fit++)
+        {
+            total += m_files[*it].m_memoryNeeded;
+            if (total > m_memoryBudget)
+                break;
+        }
+        numWorkers = (fit > 1) ? fit : 1;
+    }
+
+#ifdef TRACE
+    printf("WaveformBatch running %zu file(s) on %u worker(s)\n", pending.size(), numWorkers);
+#endif
+
+    Scheduler scheduler(m_files, numWorkers, m_memoryBudget);
+    scheduler.Deal(pending);
+
+    // The calling thread is one of the workers.
+    std::vector<std::thread> threads;
+    for (unsigned worker = 1; worker < numWorkers; worker++)
+        threads.emplace_back(&Scheduler::WorkerMain, &scheduler, worker, std::cref(operation));
+    scheduler.WorkerMain(0, operation);
+    for (auto &thread : threads)
+        thread.join();
+
+    return GetErrorCount() == 0;
+}
+
+// Returns the number of files that haven't succeeded.
+size_t WaveformBatch::GetErrorCount() const
+{
+    size_t count = 0;
+    for (const File &file : m_files)
+    {
+        if (file.m_status != Status::Succeeded)
+            count++;
+    }
+    return count;
+}
+
+// Returns a short description of a status.
+const char *WaveformBatch::GetStatusText(Status status)
+{
+    switch (status)
+    {
+        case Status::Pending:           return "not processed";
+        case Status::Succeeded:         return "succeeded";
+        case Status::Failed:            return "failed";
+        case Status::Exception:         return "unexpected exception";
+        case Status::DuplicateOutput:   return "output file name used by another input";
+        case Status::SameAsInput:       return "output file name same as input";
+    }
+    return "unknown";
+}
@@ -0,0 +1,795 @@
+//-------------------------------------------------------------------
+//
+// waveformgraph.cpp
+// C++ framework for processing audio a block at a time, by pulling
+// fixed-size blocks from sources through a graph of processors to
+// a sink.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#include "waveformgraph.h"
+#include "waveformload.h"
+#include "waveformsave.h"
+#include "waveformprofile.h"
+#include "spscqueue.h"
+#include "denormals.h"
+#include <string.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+//#define TRACE
+
+//--------------------------------------------------
+// WaveformBlock
+//--------------------------------------------------
+
+// Allocates room for the given number of frames and channels, with
+// the samples aligned to kAlignment bytes.
+bool WaveformBlock::Allocate(size_t maxFrames, size_t numChannels)
+{
+    if (numChannels < 1 || maxFrames < 1)
+        return false;
+
+    WaveformProfileScope profile("graph blocks");
+    const size_t alignFloats = kAlignment / sizeof(float);
+    m_buffer.assign(maxFrames * numChannels + alignFloats, 0.0f);
+    size_t misalignment = reinterpret_cast<uintptr_t>(m_buffer.data()) % kAlignment;
+    m_samples = m_buffer.data() + (misalignment ? (kAlignment - misalignment) / sizeof(float) : 0);
+    m_maxFrames = maxFrames;
+    m_numChannels = numChannels;
+    m_numFrames = 0;
+    return true;
+}
+
+// Sets all of the block's samples to zero.
+void WaveformBlock::Silence()
+{
+    if (m_samples)
+        memset(m_samples, 0, m_maxFrames * m_numChannels * sizeof(float));
+}
+
+//--------------------------------------------------
+// Pipelining
+//--------------------------------------------------
+
+// Waits a little while for another thread to catch up:  by giving
+// up the rest of the time slice at first, then by sleeping.
+static void Backoff(unsigned &attempts)
+{
+    if (++attempts < 64)
+        std::this_thread::yield();
+    else
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+// A fixed set of blocks that pass from a producer thread to a
+// consumer thread and back again, through a pair of lock-free
+// queues:  one of filled blocks on their way to the consumer, and
+// one of empty blocks on their way back to be filled.  Waits for a
+// block give up once 'stop' is set.
+class BlockPipe
+{
+public:
+    BlockPipe(size_t numBlocks, const std::atomic<bool> &stop) :
+        m_filled(numBlocks + 1), m_empty(numBlocks + 1), m_numBlocks(numBlocks), m_stop(stop)
+    {
+    }
+
+    // Creates the blocks.  Returns true if successful.
+    bool Allocate(size_t maxFrames, size_t numChannels)
+    {
+        for (size_t iblock = 0; iblock < m_numBlocks; iblock++)
+        {
+            WaveformBlock block;
+            if (!block.Allocate(maxFrames, numChannels) || !m_empty.TryPush(block))
+                return false;
+        }
+        return true;
+    }
+
+    // Producer:  waits for an empty block to fill, or for the pipe
+    // to be stopped.  Returns false if it was stopped.
+    bool TakeEmpty(WaveformBlock &block)
+    {
+        if (m_empty.TryPop(block))
+            return true;
+
+        WaveformProfileScope profile("pipeline wait");
+        unsigned attempts = 0;
+        while (!m_empty.TryPop(block))
+        {
+            if (m_stop)
+                return false;
+            Backoff(attempts);
+        }
+        return true;
+    }
+
+    // Producer:  sends a filled block to the consumer.  A block with
+    // no frames ends the stream; if the stream failed, call Fail
+    // first.  There's always room, since the queues can hold every
+    // block at once.
+    void SendFilled(WaveformBlock &block) { m_filled.TryPush(block); }
+    void Fail() { m_failed = true; }
+
+    // Consumer:  waits for the next filled block, or for the pipe to
+    // be stopped.  Returns false if it was stopped, or the stream
+    // failed.
+    bool TakeFilled(WaveformBlock &block)
+    {
+        if (m_filled.TryPop(block))
+            return block.GetNumFrames() > 0 || !m_failed;
+
+        WaveformProfileScope profile("pipeline wait");
+        unsigned attempts = 0;
+        while (!m_filled.TryPop(block))
+        {
+            if (m_stop)
+                return false;
+            Backoff(attempts);
+        }
+        return block.GetNumFrames() > 0 || !m_failed;
+    }
+
+    // Consumer:  hands a block back to the producer to fill again.
+    void ReturnEmpty(WaveformBlock &block) { m_empty.TryPush(block); }
+
+private:
+    SpscQueue<WaveformBlock> m_filled;
+    SpscQueue<WaveformBlock> m_empty;
+    size_t m_numBlocks;
+    const std::atomic<bool> &m_stop;
+    std::atomic<bool> m_failed{false};
+};
+
+// Pulls the blocks that come through a pipe, for a sink running on
+// the consumer's thread.
+class PipePuller : public WaveformPuller
+{
+public:
+    explicit PipePuller(BlockPipe &pipe) : m_pipe(pipe) {}
+
+    const WaveformBlock *Pull() override
+    {
+        if (m_holding)
+            m_pipe.ReturnEmpty(m_block);
+        m_holding = m_pipe.TakeFilled(m_block);
+        return m_holding ? &m_block : nullptr;
+    }
+
+private:
+    BlockPipe &m_pipe;
+    WaveformBlock m_block;
+    bool m_holding = false;
+};
+
+//--------------------------------------------------
+// WaveformGraph
+//--------------------------------------------------
+
+// Pulls the blocks of one node's output for a sink, dropping the
+// first few frames to make up for the node's latency.
+class WaveformGraph::Puller : public WaveformPuller
+{
+public:
+    Puller(WaveformGraph &graph, size_t node, size_t skipFrames) :
+        m_graph(graph), m_node(node), m_skipFrames(skipFrames)
+    {
+    }
+
+    const WaveformBlock *Pull() override
+    {
+        for (;;)
+        {
+            const WaveformBlock *block = m_graph.PullNode(m_node, ++m_graph.m_tick);
+            if (!block || m_skipFrames == 0 || block->GetNumFrames() == 0)
+                return block;
+
+            // Drop the frames that are still owed to the latency,
+            // passing on the rest of the block (if any) in a copy.
+            size_t numFrames = block->GetNumFrames();
+            if (numFrames <= m_skipFrames)
+            {
+                m_skipFrames -= numFrames;
+                continue;
+            }
+
+            size_t numChannels = block->GetNumChannels();
+            if (m_remainder.GetMaxFrames() < numFrames && !m_remainder.Allocate(numFrames, numChannels))
+                return nullptr;
+            memcpy(m_remainder.GetSamplesPtr(), block->GetSamplesPtr() + m_skipFrames * numChannels,
+                (numFrames - m_skipFrames) * numChannels * sizeof(float));
+            m_remainder.SetNumFrames(numFrames - m_skipFrames);
+            m_skipFrames = 0;
+            return &m_remainder;
+        }
+    }
+
+private:
+    WaveformGraph &m_graph;
+    size_t m_node;
+    size_t m_skipFrames;
+    WaveformBlock m_remainder;
+};
+
+// Reads a source ahead on a thread of its own, into the blocks of a
+// pipe, for a pipelined run.  The graph's thread takes the blocks
+// in turn, trading its node's block for each one.
+class WaveformGraph::Prefetcher
+{
+public:
+    Prefetcher(WaveformSource &source, size_t numBlocks, const std::atomic<bool> &stop) :
+        m_source(source), m_pipe(numBlocks, stop)
+    {
+    }
+
+    // Waits for the thread to finish; the run's stop flag must be
+    // set first if the source hasn't been read to the end.
+    ~Prefetcher()
+    {
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    // Creates the blocks and starts the thread.  Returns true if
+    // successful.
+    bool Start(size_t maxFrames, size_t numChannels)
+    {
+        if (!m_pipe.Allocate(maxFrames, numChannels))
+            return false;
+        m_thread = std::thread(&Prefetcher::ThreadMain, this);
+        return true;
+    }
+
+    // Trades the block for the next one the thread has read.
+    // Returns false if the source failed.
+    bool Read(WaveformBlock &block)
+    {
+        WaveformBlock next;
+        if (!m_pipe.TakeFilled(next))
+            return false;
+        std::swap(block, next);
+        m_pipe.ReturnEmpty(next);
+        return true;
+    }
+
+private:
+    void ThreadMain()
+    {
+        WaveformProfileNameThread("graph reader");
+        for (;;)
+        {
+            WaveformBlock block;
+            if (!m_pipe.TakeEmpty(block))
+                return;
+
+            block.SetNumFrames(0);
+            bool ok = false;
+            try
+            {
+                ok = m_source.Read(block);
+            }
+            catch (...)
+            {
+            }
+            if (!ok)
+            {
+                block.SetNumFrames(0);
+                m_pipe.Fail();
+            }
+
+            bool ended = (block.GetNumFrames() == 0);
+            m_pipe.SendFilled(block);
+            if (ended)
+                return;
+        }
+    }
+
+    WaveformSource &m_source;
+    BlockPipe m_pipe;
+    std::thread m_thread;
+};
+
+// Creates an empty graph.
+WaveformGraph::WaveformGraph(size_t blockFrames) :
+    m_blockFrames(blockFrames ? blockFrames : WaveformBlock::kDefaultFrames)
+{
+}
+
+// Adds a source to the graph.
+size_t WaveformGraph::AddSource(WaveformSource &source)
+{
+    m_nodes.emplace_back();
+    m_nodes.back().m_source = &source;
+    m_prepared = false;
+    return m_nodes.size() - 1;
+}
+
+// Adds a processor to the graph, fed by the given nodes.
+size_t WaveformGraph::AddProcessor(WaveformProcessor &processor, const std::vector<size_t> &inputs)
+{
+    m_nodes.emplace_back();
+    m_nodes.back().m_processor = &processor;
+    m_nodes.back().m_inputs = inputs;
+    m_prepared = false;
+    return m_nodes.size() - 1;
+}
+
+// Opens the sources, configures the processors, and allocates the
+// blocks, in the order the nodes were added (so each node's inputs
+// are ready before it).
+bool WaveformGraph::Prepare()
+{
+    std::vector<WaveformFormat> inputFormats;
+    for (size_t index = 0; index < m_nodes.size(); index++)
+    {
+        Node &node = m_nodes[index];
+        node.m_tick = 0;
+        node.m_ended = false;
+        if (node.m_source)
+        {
+            if (!node.m_source->Open(node.m_format))
+                return false;
+        }
+        else
+        {
+            if (node.m_inputs.empty())
+                return false;
+
+            inputFormats.clear();
+            for (size_t input : node.m_inputs)
+            {
+                if (input >= index)
+                    return false;
+                inputFormats.push_back(m_nodes[input].m_format);
+            }
+            if (!node.m_processor->Configure(inputFormats.data(), inputFormats.size(), node.m_format))
+                return false;
+            node.m_inputBlocks.resize(node.m_inputs.size());
+        }
+        node.m_format.m_latency = GetLatency(index);
+
+#ifdef TRACE
+        printf("WaveformGraph node %zu:  %u Hz, %zu channel(s), %zu samples, latency %zu\n",
+            index, node.m_format.m_rate, node.m_format.m_numChannels,
+            node.m_format.m_numSamples, GetLatency(index));
+#endif
+
+        if (!node.m_block.Allocate(m_blockFrames, node.m_format.m_numChannels))
+            return false;
+    }
+
+    m_tick = 0;
+    m_prepared = true;
+    return true;
+}
+
+// Returns the latency of the longest path to the node's output.
+size_t WaveformGraph::GetLatency(size_t node) const
+{
+    const Node &n = m_nodes[node];
+    if (!n.m_processor)
+        return 0;
+
+    size_t inputLatency = 0;
+    for (size_t input : n.m_inputs)
+    {
+        size_t latency = GetLatency(input);
+        if (latency > inputLatency)
+            inputLatency = latency;
+    }
+    return inputLatency + n.m_processor->GetLatency();
+}
+
+// Produces the given node's block for the given pass through the
+// graph, first pulling the blocks of its inputs.  A node that more
+// than one node reads from is only run once per pass.
+const WaveformBlock *WaveformGraph::PullNode(size_t index, uint64_t tick)
+{
+    Node &node = m_nodes[index];
+    if (node.m_tick == tick)
+        return &node.m_block;
+    node.m_tick = tick;
+
+    if (node.m_ended)
+    {
+        node.m_block.SetNumFrames(0);
+        return &node.m_block;
+    }
+
+    node.m_block.SetNumFrames(0);
+    if (node.m_source)
+    {
+        bool ok = node.m_prefetcher ?
+            node.m_prefetcher->Read(node.m_block) : node.m_source->Read(node.m_block);
+        if (!ok)
+            return nullptr;
+        node.m_ended = (node.m_block.GetNumFrames() == 0);
+        return &node.m_block;
+    }
+
+    bool inputsEnded = true;
+    for (size_t iinput = 0; iinput < node.m_inputs.size(); iinput++)
+    {
+        const WaveformBlock *block = PullNode(node.m_inputs[iinput], tick);
+        if (!block)
+            return nullptr;
+        if (block->GetNumFrames() > 0)
+            inputsEnded = false;
+        node.m_inputBlocks[iinput] = block;
+    }
+
+    WaveformProfileScope profile(node.m_processor->GetName());
+    ScopedDenormalsOff denormals;
+    if (!node.m_processor->Process(node.m_inputBlocks.data(), node.m_inputBlocks.size(), node.m_block))
+        return nullptr;
+    if (WaveformProfileIsEnabled())
+    {
+        size_t numSamples = node.m_block.GetNumFrames() * node.m_block.GetNumChannels();
+        profile.AddCounts(numSamples, numSamples * sizeof(float) * 2);
+    }
+    node.m_ended = inputsEnded && node.m_block.GetNumFrames() == 0;
+    return &node.m_block;
+}
+
+// Runs the graph, pulling the node's output into the sink.
+bool WaveformGraph::Run(size_t node, WaveformSink &sink)
+{
+    if (node >= m_nodes.size())
+        return false;
+    if (!m_prepared && !Prepare())
+        return false;
+
+    bool result;
+    if (m_pipelineDepth)
+    {
+        result = RunPipelined(node, sink);
+    }
+    else
+    {
+        Puller puller(*this, node, GetLatency(node));
+        result = sink.Consume(m_nodes[node].m_format, puller);
+    }
+
+    // The nodes can't be run again without preparing them again.
+    m_prepared = false;
+    return result;
+}
+
+// Runs the graph with each source read ahead on its own thread, and
+// the sink on another thread, while the processors run on this one.
+// Blocks pass between the threads through lock-free pipes, so none
+// of them waits on the others unless a pipe runs dry or fills up.
+bool WaveformGraph::RunPipelined(size_t node, WaveformSink &sink)
+{
+    std::atomic<bool> stop(false);
+    bool result = true;
+
+    // Start reading ahead from the sources.
+    std::vector<std::unique_ptr<Prefetcher>> prefetchers;
+    for (Node &n : m_nodes)
+    {
+        if (!n.m_source)
+            continue;
+        prefetchers.emplace_back(new Prefetcher(*n.m_source, m_pipelineDepth, stop));
+        if (!prefetchers.back()->Start(m_blockFrames, n.m_format.m_numChannels))
+        {
+            result = false;
+            break;
+        }
+        n.m_prefetcher = prefetchers.back().get();
+    }
+
+    if (result)
+    {
+        // Start the sink, which stops everything once it's done.
+        const WaveformFormat &format = m_nodes[node].m_format;
+        BlockPipe output(m_pipelineDepth, stop);
+        bool consumed = false;
+        std::thread writer;
+        if (output.Allocate(m_blockFrames, format.m_numChannels))
+        {
+            writer = std::thread([&]()
+            {
+                WaveformProfileNameThread("graph writer");
+                PipePuller pipePuller(output);
+                try
+                {
+                    consumed = sink.Consume(format, pipePuller);
+                }
+                catch (...)
+                {
+                }
+                stop = true;
+            });
+        }
+        else
+        {
+            result = false;
+        }
+
+        // Run the processors, sending each block of the node's
+        // output to the sink, through the end of the stream.
+        Puller puller(*this, node, GetLatency(node));
+        WaveformBlock block;
+        while (result && output.TakeEmpty(block))
+        {
+            const WaveformBlock *pulled = nullptr;
+            try
+            {
+                pulled = puller.Pull();
+            }
+            catch (...)
+            {
+            }
+
+            size_t numFrames = pulled ? pulled->GetNumFrames() : 0;
+            if (pulled)
+                memcpy(block.GetSamplesPtr(), pulled->GetSamplesPtr(), numFrames * format.m_numChannels * sizeof(float));
+            else
+                output.Fail();
+            block.SetNumFrames(numFrames);
+            output.SendFilled(block);
+            if (numFrames == 0)
+                break;
+        }
+
+        if (writer.joinable())
+            writer.join();
+        result = result && consumed;
+    }
+
+    // Stop reading ahead.
+    stop = true;
+    for (Node &n : m_nodes)
+        n.m_prefetcher = nullptr;
+    prefetchers.clear();
+    return result;
+}
+
+//--------------------------------------------------
+// WaveformMemorySource and WaveformMemorySink
+//--------------------------------------------------
+
+// Describes the Waveform's audio.
+bool WaveformMemorySource::Open(WaveformFormat &format)
+{
+    format.m_rate = m_wav.GetRate();
+    format.m_numChannels = m_wav.GetNumChannels();
+    format.m_numSamples = m_wav.GetNumSamples();
+    format.m_channelMask = m_wav.GetChannelMask();
+    m_position = 0;
+    return format.m_numChannels > 0;
+}
+
+// Copies the next block of samples from the Waveform.
+bool WaveformMemorySource::Read(WaveformBlock &block)
+{
+    size_t numChannels = m_wav.GetNumChannels();
+    size_t numFrames = m_wav.GetNumSamples() - m_position;
+    if (numFrames > block.GetMaxFrames())
+        numFrames = block.GetMaxFrames();
+
+    memcpy(block.GetSamplesPtr(), m_wav.GetSamplesPtr() + m_position * numChannels,
+        numFrames * numChannels * sizeof(float));
+    block.SetNumFrames(numFrames);
+    m_position += numFrames;
+    return true;
+}
+
+// Collects the blocks of the stream into the Waveform.
+bool WaveformMemorySink::Consume(const WaveformFormat &format, WaveformPuller &input)
+{
+    WaveformBuffer<float> samples;
+    samples.reserve(format.m_numSamples * format.m_numChannels);
+    for (;;)
+    {
+        const WaveformBlock *block = input.Pull();
+        if (!block)
+            return false;
+        if (block->GetNumFrames() == 0)
+            break;
+
+        const float *blockSamples = block->GetSamplesPtr();
+        samples.insert(samples.end(), blockSamples, blockSamples + block->GetNumFrames() * format.m_numChannels);
+    }
+
+    m_wav = Waveform();
+    m_wav.SetRate(format.m_rate);
+    if (!m_wav.Populate(samples.size() / format.m_numChannels, format.m_numChannels, samples.data()))
+        return false;
+    m_wav.SetChannelMask(format.m_channelMask);
+    return true;
+}
+
+//--------------------------------------------------
+// WaveformFileSource and WaveformFileSink
+//--------------------------------------------------
+
+// Reads the format of the audio file.
+bool WaveformFileSource::Open(WaveformFormat &format)
+{
+    m_chunk = Waveform();
+    m_chunkStart = 0;
+    m_position = 0;
+
+    // The file's header and index are read once, here, rather than
+    // for every chunk.
+    if (!m_reader.Open(m_filename.c_str()))
+        return false;
+    m_format.m_rate = m_reader.GetRate();
+    m_format.m_numChannels = m_reader.GetNumChannels();
+    m_format.m_numSamples = m_reader.GetNumSamples();
+    m_format.m_channelMask = m_reader.GetChannelMask();
+
+    format = m_format;
+    return m_format.m_numChannels > 0;
+}
+
+// Copies the next block of samples from the file, reading the next
+// chunk of the file whenever the current one runs out.
+bool WaveformFileSource::Read(WaveformBlock &block)
+{
+    size_t numChannels = m_format.m_numChannels;
+    size_t numFrames = 0;
+    while (numFrames < block.GetMaxFrames())
+    {
+        if (m_position >= m_chunkStart + m_chunk.GetNumSamples())
+        {
+            if (m_position >= m_format.m_numSamples)
+                break;
+
+            if (!m_reader.Load(m_position, kChunkFrames, m_chunk) ||
+                m_chunk.GetNumChannels() != numChannels)
+            {
+                return false;
+            }
+            m_chunkStart = m_position;
+
+            // A stream that ends before its headers said it would
+            // just ends here; the graph treats it as the end.
+            if (m_chunk.GetNumSamples() == 0)
+                break;
+        }
+
+        size_t offset = m_position - m_chunkStart;
+        size_t count = m_chunk.GetNumSamples() - offset;
+        if (count > block.GetMaxFrames() - numFrames)
+            count = block.GetMaxFrames() - numFrames;
+
+        memcpy(block.GetSamplesPtr() + numFrames * numChannels,
+            m_chunk.GetSamplesPtr() + offset * numChannels,
+            count * numChannels * sizeof(float));
+        numFrames += count;
+        m_position += count;
+    }
+
+    block.SetNumFrames(numFrames);
+    return true;
+}
+
+// State passed to the block callback while a file sink saves.
+struct FileSinkContext
+{
+    WaveformPuller *m_input = nullptr;
+    const WaveformBlock *m_block = nullptr;     // The block being saved.
+    size_t m_offset = 0;                        // Frames of m_block already saved.
+};
+
+// Block callback for WaveformSaveInBlocks that copies frames from
+// the blocks pulled from the graph, pulling more as needed.
+static bool FillFileSinkBlock(void *context, float *samples, size_t maxFrames, size_t &numFrames)
+{
+    FileSinkContext *ctx = reinterpret_cast<FileSinkContext *>(context);
+    if (!ctx->m_block || ctx->m_offset >= ctx->m_block->GetNumFrames())
+    {
+        ctx->m_block = ctx->m_input->Pull();
+        ctx->m_offset = 0;
+        if (!ctx->m_block)
+            return false;
+    }
+
+    size_t numChannels = ctx->m_block->GetNumChannels();
+    numFrames = ctx->m_block->GetNumFrames() - ctx->m_offset;
+    if (numFrames > maxFrames)
+        numFrames = maxFrames;
+    memcpy(samples, ctx->m_block->GetSamplesPtr() + ctx->m_offset * numChannels,
+        numFrames * numChannels * sizeof(float));
+    ctx->m_offset += numFrames;
+    return true;
+}
+
+// Saves the stream to the audio file.
+bool WaveformFileSink::Consume(const WaveformFormat &format, WaveformPuller &input)
+{
+    FileSinkContext ctx;
+    ctx.m_input = &input;
+    return WaveformSaveInBlocks(m_filename.c_str(), format.m_rate, format.m_numChannels, format.m_numSamples,
+                FillFileSinkBlock, &ctx, m_statusContext, m_statusFunc,
+                m_useFloat, m_useBytesPerSample, format.m_channelMask);
+}
+
+//--------------------------------------------------
+// WaveformOffsetSource
+//--------------------------------------------------
+
+// Opens the other source, and works out how much silence goes
+// before it.
+bool WaveformOffsetSource::Open(WaveformFormat &format)
+{
+    if (!m_source.Open(format))
+        return false;
+
+    m_offset = format.TimeToSampleIndex(m_startSeconds);
+    m_position = 0;
+    format.m_numSamples += m_offset;
+    return true;
+}
+
+// Fills the block with silence until the offset, and then with the
+// other source's audio.
+bool WaveformOffsetSource::Read(WaveformBlock &block)
+{
+    if (m_position >= m_offset)
+        return m_source.Read(block);
+
+    size_t numChannels = block.GetNumChannels();
+    size_t silentFrames = m_offset - m_position;
+    block.Silence();
+    if (silentFrames >= block.GetMaxFrames())
+    {
+        block.SetNumFrames(block.GetMaxFrames());
+        m_position += block.GetMaxFrames();
+        return true;
+    }
+
+    // The silence ends partway through this block, so the rest of
+    // it is read from the other source.
+    if (!m_partial.Allocate(block.GetMaxFrames() - silentFrames, numChannels) ||
+        !m_source.Read(m_partial))
+    {
+        return false;
+    }
+    memcpy(block.GetSamplesPtr() + silentFrames * numChannels, m_partial.GetSamplesPtr(),
+        m_partial.GetNumFrames() * numChannels * sizeof(float));
+    block.SetNumFrames(silentFrames + m_partial.GetNumFrames());
+    m_position = m_offset;
+    return true;
+}
@@ -42,14 +42,74 @@
 #include "waveformload.h"
 #include "wavfile.h"
 #include "rawpcmfile.h"
+#include "mp3file.h"
+#include "flacfile.h"
+#include "threadpool.h"
+#include "dspkernels.h"
+#include "waveformprofile.h"
+#include "platform.h"
+#include <float.h>
+#include <math.h>
+#include <string>
+#include <utility>
+#include <atomic>
+#include <thread>
 #define MINIMP3_IMPLEMENTATION
+#define MINIMP3_FLOAT_OUTPUT
+#ifdef _MSC_VER
 #pragma warning(push)
 #pragma warning(disable:4244)
+#endif
 #include "../dependencies/minimp3/minimp3.h"
+#ifdef _MSC_VER
 #pragma warning(pop)
+#endif
 
 //#define TRACE
 
+// Sample format assumed for raw PCM files that don't have a .hdr
+// file, or for all raw PCM files if g_rawFormatOverride is set.
+static RawPCMFormat g_rawFormat;
+static bool g_rawFormatOverride = false;
+
+// True if the sample format of raw PCM files without a .hdr file
+// should be guessed from their contents.
+static bool g_rawAutoDetect = false;
+
+// True if MP3 frame indexes should be cached in sidecar files.
+static bool g_useIndexCache = false;
+
+// How MP3 files are decoded (see WaveformSetMP3Decode).
+static bool g_mp3DecodeSerially = false;
+static size_t g_mp3SegmentFrames = 0;
+
+// Standard input can only be read once, so the audio read from it
+// is kept here until it's loaded.  This lets WaveformReadFileInfo
+// be called on it before WaveformLoadFromFile or WaveformLoadRange.
+// A WaveformRangeReader that gets to it first reads it forward a
+// block at a time instead, and g_stdinRemaining counts the bytes of
+// samples that haven't been read yet.
+static Waveform g_stdinWaveform;
+static WAVInfo g_stdinHeader;
+static uint64_t g_stdinRemaining = 0;
+static bool g_stdinRead = false;
+static bool g_stdinTaken = false;
+
+// Returns true if the filename is "-", which means standard input.
+static bool IsStandardStream(const wchar_t *filename)
+{
+    return filename[0] == '-' && filename[1] == '\0';
+}
+
+// Returns the value of a packed 24-bit little-endian signed integer.
+static int32_t Read24BitSample(const uint8_t *psample)
+{
+    uint32_t raw = static_cast<uint32_t>(psample[0]) << 8 |
+        static_cast<uint32_t>(psample[1]) << 16 |
+        static_cast<uint32_t>(psample[2]) << 24;
+    return static_cast<int32_t>(raw) >> 8;
+}
+
 // Converts one raw audio sample from a WAV file into our internal
 // floating-point format.
 static float ConvertWAVSampleToFloat(const WAVInfo &hdr, const void *psample)
@@ -74,6 +134,11 @@ static float ConvertWAVSampleToFloat(const WAVInfo &hdr, const void *psample)
             int16_t rawsample = *reinterpret_cast<const int16_t *>(psample);
             return static_cast<float>(rawsample) / static_cast<float>(0x7FFF);
         }
+        else if (hdr.m_bits == 24)
+        {
+            int32_t rawsample = Read24BitSample(reinterpret_cast<const uint8_t *>(psample));
+            return static_cast<float>(rawsample) / static_cast<float>(0x7FFFFF);
+        }
         else if (hdr.m_bits == 32)
         {
             int32_t rawsample = *reinterpret_cast<const int32_t *>(psample);
@@ -109,6 +174,11 @@ static float ConvertRawSampleToFloat(bool isFloat, unsigned bytesPerSample, cons
             int16_t rawsample = *reinterpret_cast<const int16_t *>(psample);
             return static_cast<float>(rawsample) / static_cast<float>(0x7FFF);
         }
+        else if (bytesPerSample == 3)
+        {
+            int32_t rawsample = Read24BitSample(reinterpret_cast<const uint8_t *>(psample));
+            return static_cast<float>(rawsample) / static_cast<float>(0x7FFFFF);
+        }
         else if (bytesPerSample == 4)
         {
             int32_t rawsample = *reinterpret_cast<const int32_t *>(psample);
@@ -120,6 +190,125 @@ static float ConvertRawSampleToFloat(bool isFloat, unsigned bytesPerSample, cons
     return 0.0f;
 }
 
+// Converts a range of raw audio samples from a WAV file into our
+// internal floating-point format.  Same as ConvertWAVSampleToFloat,
+// but the format is only examined once per range.
+static void ConvertWAVSampleRangeToFloat(const WAVInfo &hdr, const void *pinsamples, float *poutsamples, size_t count)
+{
+    if (hdr.m_is_float && hdr.m_bits == 32)
+    {
+        memcpy(poutsamples, pinsamples, count * sizeof(float));
+    }
+    else if (!hdr.m_is_float && hdr.m_bits == 24)
+    {
+        DSPKernelsGet().Convert24BitToFloat(reinterpret_cast<const uint8_t *>(pinsamples), poutsamples, count);
+    }
+    else if (!hdr.m_is_float && hdr.m_bits == 16)
+    {
+        DSPKernelsGet().ConvertInt16ToFloat(reinterpret_cast<const int16_t *>(pinsamples), poutsamples, count);
+    }
+    else
+    {
+        const uint8_t *pin = reinterpret_cast<const uint8_t *>(pinsamples);
+        for (size_t i = 0; i < count; i++)
+        {
+            poutsamples[i] = ConvertWAVSampleToFloat(hdr, pin);
+            pin += hdr.m_bits / 8;
+        }
+    }
+}
+
+// Converts a block of raw audio samples from a WAV file into our
+// internal floating-point format.  The samples are independent of
+// each other, so a large block is split into ranges that are
+// converted on all of the threads of the shared pool.
+static void ConvertWAVSamplesToFloat(const WAVInfo &hdr, const void *pinsamples, float *poutsamples, size_t count)
+{
+    const size_t bytesPerSample = hdr.m_bits / 8;
+    WaveformProfileScope profile("convert to float", count, count * (bytesPerSample + sizeof(float)));
+    const uint8_t *pin = reinterpret_cast<const uint8_t *>(pinsamples);
+    ThreadPool::GetShared().ParallelFor(count, bytesPerSample + sizeof(float), [&](size_t first, size_t end) {
+        ConvertWAVSampleRangeToFloat(hdr, pin + first * bytesPerSample, poutsamples + first, end - first);
+    });
+}
+
+// Converts a block of raw PCM samples into our internal floating-
+// point format, on all of the threads of the shared pool.
+static void ConvertRawSamplesToFloat(bool isFloat, unsigned bytesPerSample,
+    const uint8_t *pinsamples, float *poutsamples, size_t count)
+{
+    WaveformProfileScope profile("convert to float", count, count * (bytesPerSample + sizeof(float)));
+    ThreadPool::GetShared().ParallelFor(count, bytesPerSample + sizeof(float), [=](size_t first, size_t end) {
+        const uint8_t *pinsample = pinsamples + first * bytesPerSample;
+        if (!isFloat && bytesPerSample == 2)
+        {
+            DSPKernelsGet().ConvertInt16ToFloat(reinterpret_cast<const int16_t *>(pinsample), poutsamples + first, end - first);
+            return;
+        }
+        if (!isFloat && bytesPerSample == 3)
+        {
+            DSPKernelsGet().Convert24BitToFloat(pinsample, poutsamples + first, end - first);
+            return;
+        }
+
+        for (size_t i = first; i < end; i++)
+        {
+            poutsamples[i] = ConvertRawSampleToFloat(isFloat, bytesPerSample, pinsample);
+            pinsample += bytesPerSample;
+        }
+    });
+}
+
+// State passed to the block callback while loading a WAV file.
+struct WAVLoadContext
+{
+    WAVInfo m_hdr;
+    float *m_output = nullptr;
+    uint64_t m_bytesDone = 0;
+    uint64_t m_totalBytes = 0;
+    WaveformProgress *m_progress = nullptr;
+};
+
+// Block callback for WAVFileReadSamplesInBlocks that converts a
+// block of samples into the Waveform being loaded, and reports the
+// progress to the status callback.
+static bool ConvertWAVLoadBlock(void *context, const void *samples, size_t bytes)
+{
+    WAVLoadContext *ctx = reinterpret_cast<WAVLoadContext *>(context);
+    size_t count = bytes / (ctx->m_hdr.m_bits / 8);
+    ConvertWAVSamplesToFloat(ctx->m_hdr, samples, ctx->m_output, count);
+    ctx->m_output += count;
+    ctx->m_bytesDone += bytes;
+
+    return ctx->m_progress->Update(ctx->m_bytesDone, ctx->m_totalBytes);
+}
+
+// State passed to the block callback while loading a raw PCM file.
+struct RawLoadContext
+{
+    bool m_isFloat = false;
+    unsigned m_bytesPerSample = 0;
+    float *m_output = nullptr;
+    uint64_t m_bytesDone = 0;
+    uint64_t m_totalBytes = 0;
+    WaveformProgress *m_progress = nullptr;
+};
+
+// Block callback for RawPCMFileReadInBlocks that converts a block
+// of samples into the Waveform being loaded, and reports the
+// progress to the status callback.
+static bool ConvertRawLoadBlock(void *context, const void *samples, size_t bytes)
+{
+    RawLoadContext *ctx = reinterpret_cast<RawLoadContext *>(context);
+    size_t count = bytes / ctx->m_bytesPerSample;
+    ConvertRawSamplesToFloat(ctx->m_isFloat, ctx->m_bytesPerSample,
+        reinterpret_cast<const uint8_t *>(samples), ctx->m_output, count);
+    ctx->m_output += count;
+    ctx->m_bytesDone += bytes;
+
+    return ctx->m_progress->Update(ctx->m_bytesDone, ctx->m_totalBytes);
+}
+
 //
 // Loads the audio data from a Microsoft WAV audio file, placing
 // the audio data into the given Waveform object.  Returns true
@@ -146,44 +335,163 @@ static bool WaveformLoadFromWAV(
         return false;
 
 #ifdef TRACE
-    printf("  rate=%u channels=%u bits=%u isfloat=%c sample_count=%u\n",
+    printf("  rate=%u channels=%u bits=%u isfloat=%c sample_count=%llu\n",
         hdr.m_rate, hdr.m_channels, hdr.m_bits,
-        hdr.m_is_float ? 'Y' : 'N', hdr.m_sample_count);
+        hdr.m_is_float ? 'Y' : 'N', static_cast<unsigned long long>(hdr.m_sample_count));
 #endif
 
     wav.SetRate(hdr.m_rate);
 
+    // Allocate space for the converted PCM data.
+    if (!wav.Populate(static_cast<size_t>(hdr.m_sample_count), hdr.m_channels))
+        return false;
+    wav.SetChannelMask(hdr.m_channel_mask);
+
     if (status_callback_func && !status_callback_func(status_callback_context, 0.1f))
+    {
+        wav = Waveform();
+        return false;
+    }
+
+    // Read the raw PCM data about 64K sample frames at a time,
+    // converting each block to our internal floating-point format
+    // as it arrives, so the raw data is never all in memory.
+    WaveformProgress progress(status_callback_context, status_callback_func, 0.1f, 1.0f);
+    WAVLoadContext ctx;
+    ctx.m_hdr = hdr;
+    ctx.m_output = wav.GetSamplesPtr();
+    ctx.m_totalBytes = hdr.CalculateBufferSize();
+    ctx.m_progress = &progress;
+    size_t blockSize = static_cast<size_t>(hdr.m_channels) * (hdr.m_bits / 8) * 65536;
+    if (hdr.m_sample_count > 0 && !WAVFileReadSamplesInBlocks(filename, blockSize, ConvertWAVLoadBlock, &ctx))
+    {
+        wav = Waveform();
         return false;
+    }
 
-    // Read the raw PCM data.
-    std::vector<uint8_t> data(hdr.m_channels * hdr.m_sample_count * hdr.m_bits / 8);
-    if (!WAVFileReadSamples(filename, data.data(), data.size()))
+    if (status_callback_func && !status_callback_func(status_callback_context, 1.0f))
+    {
+        wav = Waveform();
         return false;
+    }
 
-    if (status_callback_func && !status_callback_func(status_callback_context, 0.3f))
+    return true;
+}
+
+// State passed to the block callback while reading a WAV file
+// from standard input.
+struct WAVStreamContext
+{
+    const WAVInfo *m_hdr = nullptr;
+    Waveform *m_wav = nullptr;
+};
+
+// Converts a block of samples read from standard input and appends
+// them to the Waveform being loaded, which grows as the stream goes
+// since its length isn't known.
+static bool AppendWAVStreamBlock(void *context, const void *samples, size_t bytes)
+{
+    WAVStreamContext *ctx = reinterpret_cast<WAVStreamContext *>(context);
+    Waveform &wav = *ctx->m_wav;
+    if (wav.GetNumSamples() == 0 && !wav.Populate(0, ctx->m_hdr->m_channels))
+    {
         return false;
+    }
 
-    // Allocate space for the converted PCM data.
-    if (!wav.Populate(hdr.m_sample_count, hdr.m_channels))
+    size_t count = bytes / (ctx->m_hdr->m_bits / 8);
+    size_t start = wav.GetNumSamples();
+    if (!wav.Insert(start, count / ctx->m_hdr->m_channels))
         return false;
+    ConvertWAVSamplesToFloat(*ctx->m_hdr, samples, wav.GetSamplesPtr() + start * ctx->m_hdr->m_channels, count);
+    return true;
+}
 
-    if (status_callback_func && !status_callback_func(status_callback_context, 0.4f))
+//
+// Reads the headers of the WAV audio on standard input into
+// g_stdinHeader, leaving its samples to be read, unless standard
+// input has already been read.  Returns true if successful.
+//
+static bool ReadStandardInputHeader()
+{
+    if (g_stdinRead)
         return false;
 
-    // Convert the data to our internal floating-point format.
-    // TODO:  Call the status update function occasionally during this.
-    const uint8_t *pinsample = data.data();
-    float *poutsample = wav.GetSamplesPtr();
-    for (unsigned isample = 0; isample < hdr.m_sample_count; isample++)
+    g_stdinRead = true;
+    _setmode(_fileno(stdin), _O_BINARY);
+
+    if (!WAVFileReadStreamHeader(stdin, g_stdinHeader, g_stdinRemaining))
     {
-        for (unsigned i = 0; i < hdr.m_channels; i++)
-        {
-            *poutsample++ = ConvertWAVSampleToFloat(hdr, pinsample);
-            pinsample += hdr.m_bits / 8;
-        }
+        g_stdinTaken = true;
+        return false;
+    }
+    return true;
+}
+
+//
+// Reads the rest of the samples on standard input, after its
+// headers, into g_stdinWaveform.  Returns true if successful.
+//
+static bool ReadStandardInputSamples()
+{
+    WAVStreamContext ctx;
+    ctx.m_hdr = &g_stdinHeader;
+    ctx.m_wav = &g_stdinWaveform;
+    std::vector<uint8_t> block(1024 * 1024);
+    size_t bytes;
+    bool ok = true;
+    while (ok && (bytes = WAVFileReadStreamSamples(stdin, g_stdinHeader, g_stdinRemaining, block.data(), block.size())) > 0)
+        ok = AppendWAVStreamBlock(&ctx, block.data(), bytes);
+    if (!ok || ferror(stdin) || g_stdinWaveform.GetNumSamples() == 0)
+    {
+        g_stdinWaveform = Waveform();
+        g_stdinTaken = true;
+        return false;
     }
 
+    g_stdinHeader.m_sample_count = g_stdinWaveform.GetNumSamples();
+    g_stdinWaveform.SetRate(g_stdinHeader.m_rate);
+    g_stdinWaveform.SetChannelMask(g_stdinHeader.m_channel_mask);
+
+#ifdef TRACE
+    printf("ReadStandardInputSamples rate=%u channels=%u samples=%zu\n",
+        g_stdinWaveform.GetRate(), g_stdinWaveform.GetNumChannels(), g_stdinWaveform.GetNumSamples());
+#endif
+    return true;
+}
+
+//
+// Reads the WAV audio from standard input into g_stdinWaveform,
+// unless it has already been read.  Returns true if successful.
+//
+static bool ReadStandardInput()
+{
+    if (g_stdinRead)
+        return !g_stdinTaken;
+
+    return ReadStandardInputHeader() && ReadStandardInputSamples();
+}
+
+//
+// Loads WAV audio from standard input, placing the audio data into
+// the given Waveform object.  This only works once, since the data
+// can't be read again.  Returns true if successful, false if error.
+//
+static bool WaveformLoadFromStdin(
+        Waveform &wav,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion)
+        )
+{
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.0f))
+        return false;
+
+    if (!ReadStandardInput())
+        return false;
+
+    wav = std::move(g_stdinWaveform);
+    g_stdinWaveform = Waveform();
+    g_stdinTaken = true;
+
     if (status_callback_func && !status_callback_func(status_callback_context, 1.0f))
     {
         wav = Waveform();
@@ -228,45 +536,207 @@ static bool WaveformLoadFromRawPCM(
     if (numSamples < 1)
         return false;
 
+    // Allocate space for the converted PCM data.
+    if (!wav.Populate(numSamples, numChannels))
+        return false;
+
     if (status_callback_func && !status_callback_func(status_callback_context, 0.1f))
+    {
+        wav = Waveform();
         return false;
+    }
 
-    // Read the raw PCM data.
-    std::vector<uint8_t> data(numChannels * numSamples * bytesPerSample);
-    if (!RawPCMFileRead(filename, numSamples, numChannels, bytesPerSample, data.data(), data.size()))
+    // Read the raw PCM data about 64K sample frames at a time,
+    // converting each block to our internal floating-point format
+    // as it arrives, so the raw data is never all in memory.
+    WaveformProgress progress(status_callback_context, status_callback_func, 0.1f, 1.0f);
+    RawLoadContext ctx;
+    ctx.m_isFloat = isFloat;
+    ctx.m_bytesPerSample = bytesPerSample;
+    ctx.m_output = wav.GetSamplesPtr();
+    ctx.m_totalBytes = static_cast<uint64_t>(numSamples) * numChannels * bytesPerSample;
+    ctx.m_progress = &progress;
+    size_t blockSize = static_cast<size_t>(numChannels) * bytesPerSample * 65536;
+    if (!RawPCMFileReadInBlocks(filename, 0, numSamples, numChannels, bytesPerSample, blockSize, ConvertRawLoadBlock, &ctx))
+    {
+        wav = Waveform();
         return false;
+    }
 
-    if (status_callback_func && !status_callback_func(status_callback_context, 0.3f))
+    if (status_callback_func && !status_callback_func(status_callback_context, 1.0f))
+    {
+        wav = Waveform();
         return false;
+    }
 
-    // Allocate space for the converted PCM data.
-    if (!wav.Populate(numSamples, numChannels))
+    wav.SetRate(rate);
+
+    return true;
+}
+
+//
+// Scores how plausible it is that a block of bytes from a raw PCM
+// file holds audio in the given sample format, by how smooth the
+// signal in each channel is: the mean squared second difference
+// between adjacent samples, relative to the channel's variance,
+// averaged over the channels.  Real audio has most of its energy at
+// low frequencies, so it scores far below 1, while bytes read in the
+// wrong format look like noise and score several times higher.
+// (Second differences rather than first differences keep two
+// similar channels read as one from looking smooth.)  A channel that
+// doesn't change at all scores 1.  Lower is better.  Returns a
+// negative score if the format doesn't fit the data at all.
+//
+static double ScoreRawPCMFormat(const uint8_t *data, size_t bytes, const RawPCMFormat &format)
+{
+    size_t numChannels = format.m_numChannels;
+    size_t numFrames = bytes / (numChannels * format.m_bytesPerSample);
+    if (numFrames < 64)
+        return -1.0;
+
+    std::vector<float> samples(numFrames * numChannels);
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        float value = ConvertRawSampleToFloat(format.m_isFloat, format.m_bytesPerSample, data + i * format.m_bytesPerSample);
+        if (!(fabsf(value) <= 16.0f))
+            return -1.0; // Not a plausible floating-point sample.
+        samples[i] = value;
+    }
+
+    double total = 0.0;
+    for (size_t channel = 0; channel < numChannels; channel++)
+    {
+        double sum = 0.0, sumSquares = 0.0, diffEnergy = 0.0;
+        for (size_t frame = 0; frame < numFrames; frame++)
+        {
+            double value = samples[frame * numChannels + channel];
+            sum += value;
+            sumSquares += value * value;
+            if (frame >= 2)
+            {
+                double diff = value - 2.0 * samples[(frame - 1) * numChannels + channel] +
+                    samples[(frame - 2) * numChannels + channel];
+                diffEnergy += diff * diff;
+            }
+        }
+
+        double mean = sum / static_cast<double>(numFrames);
+        double variance = sumSquares / static_cast<double>(numFrames) - mean * mean;
+        if (variance > 0.0)
+            total += (diffEnergy / static_cast<double>(numFrames - 2)) / variance;
+        else
+            total += 1.0;
+    }
+
+    return total / static_cast<double>(numChannels);
+}
+
+//
+// Guesses the sample size, sample type, and channel count of a raw
+// PCM file from a small part of its contents, starting where any
+// leading silence ends, by scoring each likely format with
+// ScoreRawPCMFormat.  Leaves the sample rate alone, since it can't
+// be told from the samples.  Returns false (leaving 'format' alone)
+// if no format fits.
+//
+static bool DetectRawPCMFormat(const wchar_t *filename, RawPCMFormat &format)
+{
+    // Read up to 1 MB from the start of the file, and find where the
+    // leading silence (if any) ends.
+    const size_t kMaxSearchBytes = 1024 * 1024;
+    const size_t kPrefixBytes = 64 * 1024;
+    uint64_t fileBytes = RawPCMFileGetSizeInBytes(filename);
+    size_t readBytes = static_cast<size_t>(fileBytes < kMaxSearchBytes ? fileBytes : kMaxSearchBytes);
+    WaveformBuffer<uint8_t> data(readBytes);
+    if (readBytes == 0 || !RawPCMFileRead(filename, readBytes, 1, 1, data.data(), data.size()))
         return false;
+    size_t firstSound = 0;
+    while (firstSound < readBytes && data[firstSound] == 0)
+        firstSound++;
 
-    if (status_callback_func && !status_callback_func(status_callback_context, 0.4f))
+    static const unsigned kChannelCounts[] = { 1, 2, 4, 6, 8 };
+    static const struct { unsigned m_bytesPerSample; bool m_isFloat; } kSampleTypes[] =
+    {
+        { 1, false }, { 2, false }, { 3, false }, { 4, false }, { 4, true }, { 8, true }
+    };
+
+    std::vector<std::pair<RawPCMFormat, double>> scores;
+    double bestScore = -1.0;
+    for (const auto &type : kSampleTypes)
+    {
+        for (unsigned numChannels : kChannelCounts)
+        {
+            RawPCMFormat candidate = format;
+            candidate.m_bytesPerSample = type.m_bytesPerSample;
+            candidate.m_isFloat = type.m_isFloat;
+            candidate.m_numChannels = numChannels;
+
+            size_t frameBytes = static_cast<size_t>(numChannels) * type.m_bytesPerSample;
+            size_t start = firstSound - firstSound % frameBytes;
+            size_t bytes = readBytes - start < kPrefixBytes ? readBytes - start : kPrefixBytes;
+            double score = ScoreRawPCMFormat(data.data() + start, bytes, candidate);
+#ifdef TRACE
+            printf("  DetectRawPCMFormat: %u bytes %s x %u channels: score %.5f\n",
+                type.m_bytesPerSample, type.m_isFloat ? "float" : "int", numChannels, score);
+#endif
+            if (score < 0.0)
+                continue;
+            scores.push_back(std::make_pair(candidate, score));
+            if (bestScore < 0.0 || score < bestScore)
+                bestScore = score;
+        }
+    }
+    if (scores.empty())
         return false;
 
-    // Convert the data to our internal floating-point format.
-    // TODO:  Call the status update function occasionally during this.
-    const uint8_t *pinsample = data.data();
-    float *poutsample = wav.GetSamplesPtr();
-    for (size_t isample = 0; isample < numSamples; isample++)
+    // Two 16-bit channels read as one 32-bit channel look about as
+    // smooth as the channel in the high half, so among the formats
+    // that score nearly as well as the best, choose the one with the
+    // smallest samples, then the one with the best score.
+    const double kTolerance = 2.0;
+    const std::pair<RawPCMFormat, double> *choice = nullptr;
+    for (const auto &entry : scores)
     {
-        for (unsigned channel = 0; channel < numChannels; channel++)
+        if (entry.second > bestScore * kTolerance)
+            continue;
+        if (!choice ||
+            entry.first.m_bytesPerSample < choice->first.m_bytesPerSample ||
+            (entry.first.m_bytesPerSample == choice->first.m_bytesPerSample && entry.second < choice->second))
         {
-            *poutsample++ = ConvertRawSampleToFloat(isFloat, bytesPerSample, pinsample);
-            pinsample += bytesPerSample;
+            choice = &entry;
         }
     }
 
-    if (status_callback_func && !status_callback_func(status_callback_context, 1.0f))
+    format = choice->first;
+    return true;
+}
+
+//
+// Works out the sample format of a raw PCM file: the format set by
+// WaveformSetRawFormat if there is one, else the file's .hdr file,
+// else the detected format if auto-detection is on, else the default
+// format.  Returns false if the .hdr file is invalid.
+//
+static bool GetRawPCMFormat(const wchar_t *filename, RawPCMFormat &format)
+{
+    format = g_rawFormat;
+    if (g_rawFormatOverride)
+        return true;
+
+    bool found = false;
+    if (!RawPCMFileReadHeader(filename, format, found))
     {
-        wav = Waveform();
+        printf("Invalid raw PCM format file for '%S'\n", filename);
         return false;
     }
+    if (!found && g_rawAutoDetect)
+        DetectRawPCMFormat(filename, format);
 
-    wav.SetRate(rate);
-
+#ifdef TRACE
+    printf("GetRawPCMFormat '%S': %s, rate=%u channels=%u bytes=%u float=%c\n", filename,
+        found ? ".hdr" : (g_rawAutoDetect ? "detected" : "default"),
+        format.m_rate, format.m_numChannels, format.m_bytesPerSample, format.m_isFloat ? 'Y' : 'N');
+#endif
     return true;
 }
 
@@ -274,13 +744,13 @@ static bool WaveformLoadFromRawPCM(
 // Reads the raw data from the given file, and returns
 // it as a vector of bytes.
 //
-static std::vector<uint8_t> ReadFile(const wchar_t *filename)
+static WaveformBuffer<uint8_t> ReadFile(const wchar_t *filename)
 {
 #ifdef TRACE
     printf("ReadFile '%S'\n", filename);
 #endif
 
-    std::vector<uint8_t> data;
+    WaveformBuffer<uint8_t> data;
 
     FILE *fp = nullptr;
     if (_wfopen_s(&fp, filename, L"rb") || !fp)
@@ -294,7 +764,7 @@ static std::vector<uint8_t> ReadFile(const wchar_t *filename)
 
     int64_t file_size = _ftelli64_nolock(fp);
 #ifdef TRACE
-    printf("  File size = %I64d\n", file_size);
+    printf("  File size = %lld\n", static_cast<long long>(file_size));
 #endif
     if (file_size < 1)
     {
@@ -315,116 +785,224 @@ static std::vector<uint8_t> ReadFile(const wchar_t *filename)
     return data;
 }
 
-//
-// Loads the audio data from an MP3 audio file, placing the
-// audio data into the given Waveform object.  Returns true
-// if successful, false if error.
-//
-static bool WaveformLoadFromMP3(
-        const wchar_t *filename,
-        Waveform &wav,
-        void *status_callback_context,
-        bool (*status_callback_func)(void *context, float completion)
-        )
+// Number of frames decoded before each segment of a parallel MP3
+// decode, so that the bit reservoir and the filter bank state have
+// caught up by the time the segment's first frame is reached.  The
+// reservoir can reach back up to 511 bytes of main data, which may
+// span several frames at low bit rates, so the warm-up is chosen
+// by byte count with a minimum number of frames.
+static size_t GetMP3WarmupFrames(const std::vector<uint64_t> &frameOffsets, size_t firstFrame)
 {
-#ifdef TRACE
-    printf("WaveformLoadFromMP3 '%S'\n", filename);
-    fflush(stdout);
-#endif
+    const uint64_t warmupBytes = 2 * 511;
+    const size_t minWarmupFrames = 2;
 
-    if (status_callback_func && !status_callback_func(status_callback_context, 0.0f))
-        return false;
+    size_t warmup = 0;
+    while (warmup < firstFrame &&
+           (warmup < minWarmupFrames ||
+            frameOffsets[firstFrame] - frameOffsets[firstFrame - warmup] < warmupBytes))
+    {
+        warmup++;
+    }
 
-    // Load the bytes from the MP3 into memory.
-    std::vector<uint8_t> filedata = ReadFile(filename);
-    if (filedata.empty())
-        return false;
+    return warmup;
+}
 
-#ifdef TRACE
-    printf("  ReadFile got %zu bytes.\n", filedata.size());
-    fflush(stdout);
-#endif
+// Progress shared by the segments of a parallel MP3 decode.  Each
+// segment adds to the count of frames decoded every few frames.
+// Only the thread that started the decode reports the progress to
+// the status callback; the others just check whether it has been
+// cancelled, so every segment stops soon after it is.
+struct MP3DecodeProgress
+{
+    WaveformProgress *m_progress = nullptr;
+    std::thread::id m_reporter = std::this_thread::get_id();
+    std::atomic<size_t> m_framesDone{0};
+    size_t m_totalFrames = 0;
+
+    // Counts 'frames' more frames as decoded.  Returns false if the
+    // decode has been cancelled.
+    bool Add(size_t frames)
+    {
+        size_t done = m_framesDone.fetch_add(frames, std::memory_order_relaxed) + frames;
+        if (std::this_thread::get_id() == m_reporter)
+            return m_progress->Update(done, m_totalFrames);
+        return !m_progress->IsCancelled();
+    }
+};
 
-    // Initialize decoder object.
+//
+// Decodes frames 'firstFrame' through 'endFrame - 1' of an MP3 file,
+// writing the samples to 'output', which receives the first sample
+// of 'firstFrame'.  'data' holds the bytes of the file starting at
+// file offset 'dataOffset', which must cover the warm-up frames and
+// a few frames past 'endFrame' (or reach the end of the file) so the
+// decoder can confirm its frame sync.  Decoding starts a few frames
+// early (see GetMP3WarmupFrames) so the output matches a serial
+// decode of the whole file.  Returns false if the frames don't
+// decode the way the frame index says they should, or if the
+// decode is cancelled through 'progress' (which may be null).
+//
+static bool DecodeMP3Frames(
+        const uint8_t *data,
+        size_t size,
+        uint64_t dataOffset,
+        const std::vector<uint64_t> &frameOffsets,
+        const MP3Info &mp3info,
+        size_t firstFrame,
+        size_t endFrame,
+        float *output,
+        MP3DecodeProgress *progress = nullptr)
+{
+    WaveformProfileScope profile("decode mp3");
     mp3dec_t mp3d = {0};
     mp3dec_init(&mp3d);
 
-    // These will be filled in with the format info found in
-    // the MP3 frames.
-    int rate_found = 0;
-    int channels_found = 0;
-
-#ifdef TRACE
-    printf("Decoding MP3 frames.\n");
-    fflush(stdout);
-#endif
-
-    // Decode all frames from the MP3 data into raw PCM data.
-    std::vector<uint8_t> pcmdata;
     mp3dec_frame_info_t info;
-    int16_t pcm_frame[MINIMP3_MAX_SAMPLES_PER_FRAME] = {0};
-    int frame_samples = 0;
-    int frame_offset = 0;
-    while ((frame_samples = mp3dec_decode_frame(&mp3d,
-                                &filedata[frame_offset], (int)filedata.size() - frame_offset,
-                                pcm_frame, &info)) > 0)
-    {
-        rate_found = info.hz;
-        channels_found = info.channels;
+    float scratch[MINIMP3_MAX_SAMPLES_PER_FRAME];
+    const size_t samplesPerFrame = static_cast<size_t>(mp3info.m_frame_samples) * mp3info.m_channels;
+    const size_t warmupFrame = firstFrame - GetMP3WarmupFrames(frameOffsets, firstFrame);
+    profile.AddCounts((endFrame - firstFrame) * samplesPerFrame, 0);
 
-        // Append the new samples to the end of the pcmdata buffer.
-        size_t offset = pcmdata.size();
-        size_t newBytes = frame_samples * sizeof(int16_t) * info.channels;
-        pcmdata.resize(pcmdata.size() + newBytes);
-        memcpy(&pcmdata[offset], pcm_frame, newBytes);
+    for (size_t iframe = warmupFrame; iframe < endFrame; iframe++)
+    {
+        if (frameOffsets[iframe] < dataOffset || frameOffsets[iframe] - dataOffset + 4 > size)
+            return false;
+        size_t offset = static_cast<size_t>(frameOffsets[iframe] - dataOffset);
+        float *pcm = (iframe < firstFrame) ? scratch : output + (iframe - firstFrame) * samplesPerFrame;
 
-        frame_offset += info.frame_bytes;
-    }
+        // Start the decoder out in sync with the stream, the same as
+        // it would be after decoding the frames before this one.
+        // Otherwise it would insist on finding several more frames
+        // ahead before accepting the first one, which fails near the
+        // end of a file that has a tag after its last frame.
+        if (iframe == warmupFrame)
+            memcpy(mp3d.header, data + offset, sizeof(mp3d.header));
 
-#ifdef TRACE
-    printf("  rate_found=%d channels_found=%d pcmdata.size=%zu\n", rate_found, channels_found, pcmdata.size());
-    fflush(stdout);
-#endif
+        // A frame that can't be decoded (such as one whose bit
+        // reservoir data is missing) produces no samples, which
+        // leaves silence in the output.
+        info.frame_offset = -1;
+        int samples = mp3dec_decode_frame(&mp3d, data + offset, static_cast<int>(size - offset), pcm, &info);
+        if (info.frame_offset != 0 || info.channels != static_cast<int>(mp3info.m_channels))
+            return false;
+        if (samples != 0 && samples != static_cast<int>(mp3info.m_frame_samples))
+            return false;
 
-    // Convert the PCM file data we just read into our internal format.
-    size_t numNewSamples = pcmdata.size() / sizeof(int16_t) / channels_found;
-    wav.SetRate(rate_found);
-    wav.Populate(numNewSamples, channels_found);
-    const int16_t *pinsample = reinterpret_cast<int16_t *>(pcmdata.data());
-    float *poutsample = wav.GetSamplesPtr();
-    for (size_t isample = 0; isample < numNewSamples; isample++)
-    {
-        for (size_t ichannel = 0; ichannel < channels_found; ichannel++)
+        // Every few frames, count the progress and find out whether
+        // to stop.
+        const size_t progressFrames = 16;
+        if (progress && iframe >= firstFrame && (iframe + 1 - firstFrame) % progressFrames == 0 &&
+            !progress->Add(progressFrames))
         {
-            float sample = static_cast<float>(*pinsample++) / static_cast<float>(0x7FFF);
-            *poutsample++ = sample;
+            return false;
         }
     }
 
-    if (status_callback_func && !status_callback_func(status_callback_context, 1.0f))
-    {
-        wav = Waveform();
-        return false;
-    }
-
     return true;
 }
 
 //
-// Loads the specified audio file, placing the audio data
-// into the given Waveform object.  Returns true if
-// successful, false if error.
+// Reads 'bytes' bytes from the given file starting at 'offset', or
+// as many as there are before the end of the file.  Returns true
+// if successful.
 //
-// If a pointer to status callback function is provided,
-// it will be called periodically during the loading
-// procedure, with a completion parameter value ranging
-// from 0.0 to 1.0 to indicate the relative completeness
-// of the loading operation.  If the status function
-// returns false, the loading is immediately aborted.
-// The status callback mechanism is provided so that the
-// caller may update a status display if desired.
+static bool ReadFileRange(const wchar_t *filename, uint64_t offset, uint64_t bytes, WaveformBuffer<uint8_t> &data)
+{
+#ifdef TRACE
+    printf("ReadFileRange '%S' offset=%llu bytes=%llu\n", filename,
+        static_cast<unsigned long long>(offset), static_cast<unsigned long long>(bytes));
+#endif
+
+    data.clear();
+
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"rb") || !fp)
+        return false;
+
+    if (_fseeki64(fp, 0, SEEK_END))
+    {
+        fclose(fp);
+        return false;
+    }
+
+    int64_t file_size = _ftelli64(fp);
+    if (file_size < 0 || offset >= static_cast<uint64_t>(file_size))
+    {
+        fclose(fp);
+        return false;
+    }
+    if (bytes > static_cast<uint64_t>(file_size) - offset)
+        bytes = static_cast<uint64_t>(file_size) - offset;
+
+    data.resize(static_cast<size_t>(bytes));
+    _fseeki64(fp, static_cast<int64_t>(offset), SEEK_SET);
+    if (fread(data.data(), 1, data.size(), fp) != data.size())
+    {
+        fclose(fp);
+        data.clear();
+        return false;
+    }
+
+    fclose(fp);
+    return true;
+}
+
 //
-bool WaveformLoadFromFile(
+// Decodes an MP3 file that's in memory by stepping through its
+// frames one at a time, appending the samples to 'pcmdata'.  This
+// is used for streams that the frame index can't describe.  The
+// progress is reported by how much of the file has been decoded.
+// Returns false if the decode is cancelled.
+//
+static bool DecodeMP3Serially(
+        const WaveformBuffer<uint8_t> &filedata,
+        WaveformBuffer<float> &pcmdata,
+        int &rate_found,
+        int &channels_found,
+        WaveformProgress &progress)
+{
+    WaveformProfileScope profile("decode mp3", 0, filedata.size());
+    mp3dec_t mp3d = {0};
+    mp3dec_init(&mp3d);
+
+    // Most MP3s compress about 10:1, so reserve for that to avoid
+    // growing the buffer too many times.
+    pcmdata.clear();
+    pcmdata.reserve(filedata.size() * 10 / sizeof(int16_t));
+
+    mp3dec_frame_info_t info;
+    float pcm_frame[MINIMP3_MAX_SAMPLES_PER_FRAME] = {0};
+    int frame_samples = 0;
+    int frame_offset = 0;
+    while ((frame_samples = mp3dec_decode_frame(&mp3d,
+                                &filedata[frame_offset], (int)filedata.size() - frame_offset,
+                                pcm_frame, &info)) > 0)
+    {
+        rate_found = info.hz;
+        channels_found = info.channels;
+
+        // Append the new samples to the end of the pcmdata buffer.
+        pcmdata.insert(pcmdata.end(), pcm_frame, pcm_frame + frame_samples * info.channels);
+
+        frame_offset += info.frame_bytes;
+        if (!progress.Update(static_cast<uint64_t>(frame_offset), filedata.size()))
+            return false;
+    }
+
+    return true;
+}
+
+//
+// Loads the audio data from an MP3 audio file, placing the
+// audio data into the given Waveform object.  Returns true
+// if successful, false if error.
+//
+// The frame headers are scanned first to build an index of where
+// each frame starts.  The index is then split into segments that
+// are decoded in parallel on the shared thread pool, straight into
+// the Waveform's sample buffer.
+//
+static bool WaveformLoadFromMP3(
         const wchar_t *filename,
         Waveform &wav,
         void *status_callback_context,
@@ -432,10 +1010,205 @@ bool WaveformLoadFromFile(
         )
 {
 #ifdef TRACE
-    printf("WaveformLoadFromFile '%S'\n", filename);
+    printf("WaveformLoadFromMP3 '%S'\n", filename);
+    fflush(stdout);
+#endif
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.0f))
+        return false;
+
+    // Load the bytes from the MP3 into memory.
+    WaveformBuffer<uint8_t> filedata = ReadFile(filename);
+    if (filedata.empty())
+        return false;
+
+#ifdef TRACE
+    printf("  ReadFile got %zu bytes.\n", filedata.size());
+    fflush(stdout);
+#endif
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.1f))
+        return false;
+
+    // Find where each frame starts.
+    MP3Info mp3info;
+    std::vector<uint64_t> frameOffsets;
+    bool indexed = !g_mp3DecodeSerially &&
+                   MP3ScanFrames(filedata.data(), filedata.size(), mp3info, &frameOffsets) &&
+                   !frameOffsets.empty() &&
+                   mp3info.m_sample_count == frameOffsets.size() * mp3info.m_frame_samples;
+
+#ifdef TRACE
+    printf("  indexed=%c frames=%zu rate=%u channels=%u\n", indexed ? 'Y' : 'N',
+        frameOffsets.size(), mp3info.m_rate, mp3info.m_channels);
+    fflush(stdout);
+#endif
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.2f))
+        return false;
+
+    WaveformProgress progress(status_callback_context, status_callback_func, 0.2f, 1.0f);
+    if (indexed)
+    {
+        // Allocate the whole waveform up front.
+        const size_t numFrames = frameOffsets.size();
+        wav.SetRate(mp3info.m_rate);
+        if (!wav.Populate(static_cast<size_t>(mp3info.m_sample_count), mp3info.m_channels))
+            return false;
+
+        // Split the frames into a few segments per thread, but not
+        // so many that the warm-up frames become a significant cost.
+        const size_t minFramesPerSegment = 128;
+        ThreadPool &pool = ThreadPool::GetShared();
+        size_t numSegments = pool.GetConcurrency() * 4;
+        if (numSegments > numFrames / minFramesPerSegment)
+            numSegments = numFrames / minFramesPerSegment;
+        if (g_mp3SegmentFrames)
+            numSegments = (numFrames + g_mp3SegmentFrames - 1) / g_mp3SegmentFrames;
+        if (numSegments < 1)
+            numSegments = 1;
+
+        std::vector<char> segmentOK(numSegments, 0);
+        const size_t samplesPerFrame = static_cast<size_t>(mp3info.m_frame_samples) * mp3info.m_channels;
+        float *output = wav.GetSamplesPtr();
+        MP3DecodeProgress decodeProgress;
+        decodeProgress.m_progress = &progress;
+        decodeProgress.m_totalFrames = numFrames;
+        pool.RunTasks(numSegments, [&](size_t segment) {
+            size_t first = numFrames * segment / numSegments;
+            size_t end = numFrames * (segment + 1) / numSegments;
+            segmentOK[segment] = DecodeMP3Frames(filedata.data(), filedata.size(), 0, frameOffsets,
+                                    mp3info, first, end, output + first * samplesPerFrame, &decodeProgress);
+        });
+
+        if (progress.IsCancelled())
+        {
+            wav = Waveform();
+            return false;
+        }
+
+        for (size_t segment = 0; segment < numSegments; segment++)
+        {
+            if (!segmentOK[segment])
+            {
+                // The stream changes format partway through, or
+                // otherwise doesn't match the index.
+                indexed = false;
+                break;
+            }
+        }
+    }
+
+    if (!indexed)
+    {
+        // Decode all frames from the MP3 data one at a time.
+        WaveformBuffer<float> pcmdata;
+        int rate_found = 0;
+        int channels_found = 0;
+        if (!DecodeMP3Serially(filedata, pcmdata, rate_found, channels_found, progress) ||
+            channels_found < 1)
+        {
+            wav = Waveform();
+            return false;
+        }
+
+#ifdef TRACE
+        printf("  rate_found=%d channels_found=%d pcmdata.size=%zu\n", rate_found, channels_found, pcmdata.size());
+        fflush(stdout);
+#endif
+
+        wav.SetRate(rate_found);
+        if (!wav.Populate(pcmdata.size() / channels_found, channels_found, pcmdata.data()))
+            return false;
+    }
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 1.0f))
+    {
+        wav = Waveform();
+        return false;
+    }
+
+    return true;
+}
+
+// Converts the integer samples decoded from a FLAC file into our
+// internal floating-point format, scaled the same way as samples
+// from WAV files.
+static void ConvertFLACSamplesToFloat(const std::vector<int32_t> &samples, unsigned bits, float *poutsamples)
+{
+    WaveformProfileScope profile("convert to float", samples.size(), samples.size() * (sizeof(int32_t) + sizeof(float)));
+    const float scale = static_cast<float>((static_cast<uint64_t>(1) << (bits - 1)) - 1);
+    const int32_t *pinsamples = samples.data();
+    ThreadPool::GetShared().ParallelFor(samples.size(), sizeof(int32_t) + sizeof(float), [=](size_t first, size_t end) {
+        for (size_t i = first; i < end; i++)
+            poutsamples[i] = static_cast<float>(pinsamples[i]) / scale;
+    });
+}
+
+//
+// Loads part or all of a FLAC audio file into the given Waveform
+// object.  A count of zero means the rest of the file.  If the
+// file's metadata has already been read, it can be given as
+// 'knownInfo' so it isn't read again.  Returns true if successful,
+// false if error.
+//
+static bool WaveformLoadFLACSamples(
+        const wchar_t *filename,
+        const FLACInfo *knownInfo,
+        size_t startFrame,
+        size_t count,
+        Waveform &wav,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion)
+        )
+{
+#ifdef TRACE
+    printf("WaveformLoadFLACSamples '%S' startFrame=%zu count=%zu\n", filename, startFrame, count);
     fflush(stdout);
 #endif
 
+    FLACInfo flacinfo;
+    std::vector<int32_t> samples;
+    {
+        WaveformProfileScope profile("decode flac");
+        if (knownInfo)
+        {
+            flacinfo = *knownInfo;
+            if (!FLACFileReadSampleRange(filename, flacinfo, startFrame, count, samples,
+                                         status_callback_context, status_callback_func))
+            {
+                return false;
+            }
+        }
+        else if (!FLACFileReadSamples(filename, startFrame, count, flacinfo, samples,
+                                      status_callback_context, status_callback_func))
+        {
+            return false;
+        }
+        profile.AddCounts(samples.size(), samples.size() * sizeof(int32_t));
+    }
+
+    wav.SetRate(flacinfo.m_rate);
+    if (!wav.Populate(samples.size() / flacinfo.m_channels, flacinfo.m_channels))
+        return false;
+    ConvertFLACSamplesToFloat(samples, flacinfo.m_bits, wav.GetSamplesPtr());
+    return true;
+}
+
+//
+// Loads the specified audio file with the loader for its type,
+// which is told by its filename extension.
+//
+static bool LoadFromFileByType(
+        const wchar_t *filename,
+        Waveform &wav,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion)
+        )
+{
+    if (IsStandardStream(filename))
+        return WaveformLoadFromStdin(wav, status_callback_context, status_callback_func);
+
     const wchar_t *extension = wcsrchr(filename, '.');
     if (_wcsicmp(extension, L".wav") == 0)
     {
@@ -445,17 +1218,18 @@ bool WaveformLoadFromFile(
     {
         return WaveformLoadFromMP3(filename, wav, status_callback_context, status_callback_func);
     }
+    else if (_wcsicmp(extension, L".flac") == 0)
+    {
+        return WaveformLoadFLACSamples(filename, nullptr, 0, 0, wav, status_callback_context, status_callback_func);
+    }
     else if (_wcsicmp(extension, L".raw") == 0 ||
              _wcsicmp(extension, L".pcm") == 0)
     {
-        // TODO: Need a way to specify the sample format externally.
-        unsigned rate = 22500;
-        unsigned bytesPerSample = 2;
-        unsigned numChannels = 2;
-        bool isFloat = false;
-
+        RawPCMFormat format;
+        if (!GetRawPCMFormat(filename, format))
+            return false;
         return WaveformLoadFromRawPCM(filename, wav,
-                    rate, bytesPerSample, numChannels, isFloat,
+                    format.m_rate, format.m_bytesPerSample, format.m_numChannels, format.m_isFloat,
                     status_callback_context, status_callback_func);
     }
 
@@ -466,3 +1240,1020 @@ bool WaveformLoadFromFile(
     return false;
 }
 
+//
+// Loads the specified audio file, placing the audio data
+// into the given Waveform object.  Returns true if
+// successful, false if error.
+//
+// If a pointer to status callback function is provided,
+// it will be called periodically during the loading
+// procedure, with a completion parameter value ranging
+// from 0.0 to 1.0 to indicate the relative completeness
+// of the loading operation.  If the status function
+// returns false, the loading is immediately aborted.
+// The status callback mechanism is provided so that the
+// caller may update a status display if desired.
+//
+bool WaveformLoadFromFile(
+        const wchar_t *filename,
+        Waveform &wav,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion)
+        )
+{
+#ifdef TRACE
+    printf("WaveformLoadFromFile '%S'\n", filename);
+    fflush(stdout);
+#endif
+
+    WaveformProfileScope profile("load");
+    profile.SetDetail(filename);
+    bool ok = LoadFromFileByType(filename, wav, status_callback_context, status_callback_func);
+    if (ok)
+        profile.AddCounts(wav.GetNumSamples() * wav.GetNumChannels(), wav.GetTotalBytes());
+    return ok;
+}
+
+
+//
+// Turns on or off the caching of MP3 frame indexes in sidecar
+// files.  See the header for details.
+//
+void WaveformSetIndexCache(bool enable)
+{
+    g_useIndexCache = enable;
+}
+
+//
+// Changes how MP3 files are decoded, for testing.  See the header
+// for details.
+//
+void WaveformSetMP3Decode(bool serial, size_t segmentFrames)
+{
+    g_mp3DecodeSerially = serial;
+    g_mp3SegmentFrames = segmentFrames;
+}
+
+//
+// Sets the sample format to use for all raw PCM files, overriding
+// their .hdr files.  See the header for details.
+//
+bool WaveformSetRawFormat(unsigned rate, unsigned numChannels, unsigned bytesPerSample, bool isFloat)
+{
+    RawPCMFormat format;
+    format.m_rate = rate;
+    format.m_numChannels = numChannels;
+    format.m_bytesPerSample = bytesPerSample;
+    format.m_isFloat = isFloat;
+    if (!format.IsValid())
+        return false;
+
+    g_rawFormat = format;
+    g_rawFormatOverride = true;
+    return true;
+}
+
+//
+// Turns on or off guessing the sample format of raw PCM files that
+// don't have .hdr files.  See the header for details.
+//
+void WaveformSetRawAutoDetect(bool enable)
+{
+    g_rawAutoDetect = enable;
+}
+
+//
+// Applies the value of a -RawFormat command line option.  See the
+// header for details.
+//
+bool WaveformSetRawFormatFromString(const wchar_t *text)
+{
+    if (!text || !*text)
+        return false;
+
+    if (_wcsicmp(text, L"auto") == 0)
+    {
+        WaveformSetRawAutoDetect(true);
+        return true;
+    }
+
+    // Otherwise it's "rate,channels,bytesPerSample[,float|int]".
+    unsigned rate = 0, numChannels = 0, bytesPerSample = 0;
+    wchar_t type[16] = {0};
+    int fields = swscanf_s(text, L"%u,%u,%u,%15ls", &rate, &numChannels, &bytesPerSample, type, static_cast<unsigned>(_countof(type)));
+    if (fields < 3)
+        return false;
+
+    bool isFloat = false;
+    if (fields == 4)
+    {
+        if (_wcsicmp(type, L"float") == 0)
+            isFloat = true;
+        else if (_wcsicmp(type, L"int") != 0)
+            return false;
+    }
+
+    return WaveformSetRawFormat(rate, numChannels, bytesPerSample, isFloat);
+}
+
+//
+// Trims a range request against the length of the file.  A count
+// of zero means everything from 'startFrame' to the end.  Returns
+// false if the range starts past the end of the file.
+//
+static bool ClipLoadRange(size_t totalFrames, size_t startFrame, size_t &count)
+{
+    if (startFrame >= totalFrames)
+        return false;
+
+    if (count == 0 || count > totalFrames - startFrame)
+        count = totalFrames - startFrame;
+
+    return true;
+}
+
+//
+// Loads part of a file by loading all of it and deleting the
+// samples outside the range.  This is used for files whose layout
+// doesn't allow reading only the requested part.
+//
+static bool WaveformLoadRangeByTrimming(
+        const wchar_t *filename,
+        size_t startFrame,
+        size_t count,
+        Waveform &wav,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion)
+        )
+{
+    if (!WaveformLoadFromFile(filename, wav, status_callback_context, status_callback_func))
+        return false;
+
+    if (!ClipLoadRange(wav.GetNumSamples(), startFrame, count))
+    {
+        wav = Waveform();
+        return false;
+    }
+
+    size_t endFrame = startFrame + count;
+    if ((endFrame < wav.GetNumSamples() && !wav.Delete(endFrame, wav.GetNumSamples() - endFrame)) ||
+        (startFrame > 0 && !wav.Delete(0, startFrame)))
+    {
+        wav = Waveform();
+        return false;
+    }
+
+    return true;
+}
+
+//
+// Loads part of a Microsoft WAV audio file into the given Waveform
+// object, reading only the requested samples from the file.
+// Returns true if successful, false if error.
+//
+static bool WaveformLoadRangeFromWAV(
+        const wchar_t *filename,
+        size_t startFrame,
+        size_t count,
+        Waveform &wav,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion)
+        )
+{
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.0f))
+        return false;
+
+    WAVInfo hdr;
+    if (!WAVFileReadHeader(filename, hdr))
+        return false;
+    if (!ClipLoadRange(static_cast<size_t>(hdr.m_sample_count), startFrame, count))
+        return false;
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.1f))
+        return false;
+
+    // Read just the requested part of the sample data.
+    WaveformBuffer<uint8_t> data(count * hdr.m_channels * (hdr.m_bits / 8));
+    if (!WAVFileReadSampleRange(filename, startFrame, count, data.data(), data.size()))
+        return false;
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.5f))
+        return false;
+
+    // Convert it to our internal floating-point format.
+    wav.SetRate(hdr.m_rate);
+    if (!wav.Populate(count, hdr.m_channels))
+        return false;
+    wav.SetChannelMask(hdr.m_channel_mask);
+    ConvertWAVSamplesToFloat(hdr, data.data(), wav.GetSamplesPtr(), count * hdr.m_channels);
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 1.0f))
+    {
+        wav = Waveform();
+        return false;
+    }
+
+    return true;
+}
+
+//
+// Loads the next part of the WAV audio on standard input, which a
+// WaveformRangeReader is reading forward a block at a time, into
+// the given Waveform object.  Standard input can't go back or skip
+// ahead, so 'startFrame' must be 'position', where the last part
+// ended; 'position' is moved past the frames loaded.  If the stream
+// ends early, fewer frames (perhaps none) are loaded.
+// Returns true if successful, false if error.
+//
+static bool WaveformLoadRangeFromStdin(
+        size_t &position,
+        size_t startFrame,
+        size_t count,
+        Waveform &wav,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion)
+        )
+{
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.0f))
+        return false;
+
+    const WAVInfo &hdr = g_stdinHeader;
+    if (startFrame != position ||
+        !ClipLoadRange(static_cast<size_t>(hdr.m_sample_count), startFrame, count))
+    {
+        return false;
+    }
+
+    // Read the next part of the sample data.
+    size_t frameBytes = static_cast<size_t>(hdr.m_channels) * (hdr.m_bits / 8);
+    WaveformBuffer<uint8_t> data(count * frameBytes);
+    size_t bytes = WAVFileReadStreamSamples(stdin, hdr, g_stdinRemaining, data.data(), data.size());
+    if (ferror(stdin))
+        return false;
+    count = bytes / frameBytes;
+    position += count;
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.5f))
+        return false;
+
+    // Convert it to our internal floating-point format.
+    wav.SetRate(hdr.m_rate);
+    if (!wav.Populate(count, hdr.m_channels))
+        return false;
+    wav.SetChannelMask(hdr.m_channel_mask);
+    ConvertWAVSamplesToFloat(hdr, data.data(), wav.GetSamplesPtr(), count * hdr.m_channels);
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 1.0f))
+    {
+        wav = Waveform();
+        return false;
+    }
+
+    return true;
+}
+
+//
+// Loads part of a raw PCM audio file into the given Waveform
+// object, reading only the requested samples from the file.
+// Returns true if successful, false if error.
+//
+static bool WaveformLoadRangeFromRawPCM(
+        const wchar_t *filename,
+        size_t startFrame,
+        size_t count,
+        Waveform &wav,
+        unsigned rate,
+        unsigned bytesPerSample,
+        unsigned numChannels,
+        bool isFloat,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion)
+        )
+{
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.0f))
+        return false;
+
+    uint64_t fileBytes = RawPCMFileGetSizeInBytes(filename);
+    size_t numSamples = static_cast<size_t>(fileBytes / (numChannels * bytesPerSample));
+    if (!ClipLoadRange(numSamples, startFrame, count))
+        return false;
+
+    // Read just the requested part of the sample data, converting
+    // it to our internal floating-point format a block at a time
+    // the same way as WaveformLoadFromRawPCM does.
+    wav.SetRate(rate);
+    if (!wav.Populate(count, numChannels))
+        return false;
+    WaveformProgress progress(status_callback_context, status_callback_func);
+    RawLoadContext ctx;
+    ctx.m_isFloat = isFloat;
+    ctx.m_bytesPerSample = bytesPerSample;
+    ctx.m_output = wav.GetSamplesPtr();
+    ctx.m_totalBytes = static_cast<uint64_t>(count) * numChannels * bytesPerSample;
+    ctx.m_progress = &progress;
+    size_t blockSize = static_cast<size_t>(numChannels) * bytesPerSample * 65536;
+    if (!RawPCMFileReadInBlocks(filename, startFrame, count, numChannels, bytesPerSample, blockSize, ConvertRawLoadBlock, &ctx))
+    {
+        wav = Waveform();
+        return false;
+    }
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 1.0f))
+    {
+        wav = Waveform();
+        return false;
+    }
+
+    return true;
+}
+
+//
+// Loads part of an MP3 audio file into the given Waveform object,
+// given the file's frame index (see MP3FileReadIndex).  The index
+// is used to find the frames that hold the range, and only those
+// frames (plus a few before them to warm up the decoder) are read
+// and decoded.  Returns true if successful, false if error.
+//
+static bool WaveformLoadRangeFromMP3Index(
+        const wchar_t *filename,
+        const MP3Info &mp3info,
+        const std::vector<uint64_t> &frameOffsets,
+        size_t startFrame,
+        size_t count,
+        Waveform &wav,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion)
+        )
+{
+    if (frameOffsets.empty() || mp3info.m_sample_count != frameOffsets.size() * mp3info.m_frame_samples)
+    {
+        // The index can't describe this stream, so decode all of it.
+        return WaveformLoadRangeByTrimming(filename, startFrame, count, wav,
+                    status_callback_context, status_callback_func);
+    }
+
+    if (!ClipLoadRange(static_cast<size_t>(mp3info.m_sample_count), startFrame, count))
+        return false;
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.2f))
+        return false;
+
+    // Find the MP3 frames that hold the range, and the bytes of the
+    // file that the decoder needs to see to decode them.  Besides
+    // the warm-up frames before the range, the decoder looks ahead
+    // a few frames to confirm it has found the frame sync.
+    const size_t numFrames = frameOffsets.size();
+    const size_t frameSamples = mp3info.m_frame_samples;
+    const size_t syncFrames = 10;
+    size_t firstFrame = startFrame / frameSamples;
+    size_t endFrame = (startFrame + count + frameSamples - 1) / frameSamples;
+    uint64_t readStart = frameOffsets[firstFrame - GetMP3WarmupFrames(frameOffsets, firstFrame)];
+    uint64_t readEnd = (endFrame + syncFrames < numFrames) ? frameOffsets[endFrame + syncFrames] : UINT64_MAX;
+
+    WaveformBuffer<uint8_t> filedata;
+    if (!ReadFileRange(filename, readStart, readEnd - readStart, filedata))
+        return false;
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.4f))
+        return false;
+
+    // Decode the frames, then keep just the requested samples.
+    WaveformProgress progress(status_callback_context, status_callback_func, 0.4f, 1.0f);
+    MP3DecodeProgress decodeProgress;
+    decodeProgress.m_progress = &progress;
+    decodeProgress.m_totalFrames = endFrame - firstFrame;
+    WaveformBuffer<float> pcmdata((endFrame - firstFrame) * frameSamples * mp3info.m_channels);
+    if (!DecodeMP3Frames(filedata.data(), filedata.size(), readStart, frameOffsets, mp3info,
+                         firstFrame, endFrame, pcmdata.data(), &decodeProgress))
+    {
+        if (progress.IsCancelled())
+            return false;
+        return WaveformLoadRangeByTrimming(filename, startFrame, count, wav,
+                    status_callback_context, status_callback_func);
+    }
+
+    wav.SetRate(mp3info.m_rate);
+    size_t skip = (startFrame - firstFrame * frameSamples) * mp3info.m_channels;
+    if (!wav.Populate(count, mp3info.m_channels, pcmdata.data() + skip))
+        return false;
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 1.0f))
+    {
+        wav = Waveform();
+        return false;
+    }
+
+    return true;
+}
+
+//
+// Loads part of an MP3 audio file into the given Waveform object,
+// reading the file's frame index first.  Returns true if
+// successful, false if error.
+//
+static bool WaveformLoadRangeFromMP3(
+        const wchar_t *filename,
+        size_t startFrame,
+        size_t count,
+        Waveform &wav,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion)
+        )
+{
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.0f))
+        return false;
+
+    MP3Info mp3info;
+    std::vector<uint64_t> frameOffsets;
+    if (!MP3FileReadIndex(filename, mp3info, frameOffsets, g_useIndexCache))
+        return false;
+
+    return WaveformLoadRangeFromMP3Index(filename, mp3info, frameOffsets, startFrame, count, wav,
+                status_callback_context, status_callback_func);
+}
+
+//
+// Loads part of the specified audio file with the loader for its
+// type, which is told by its filename extension.
+//
+static bool LoadRangeByType(
+        const wchar_t *filename,
+        size_t startFrame,
+        size_t count,
+        Waveform &wav,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion)
+        )
+{
+    // Standard input can't skip ahead, so it's all read.
+    if (IsStandardStream(filename))
+    {
+        return WaveformLoadRangeByTrimming(filename, startFrame, count, wav,
+                    status_callback_context, status_callback_func);
+    }
+
+    const wchar_t *extension = wcsrchr(filename, '.');
+    if (!extension)
+        return false;
+
+    if (_wcsicmp(extension, L".wav") == 0)
+    {
+        return WaveformLoadRangeFromWAV(filename, startFrame, count, wav,
+                    status_callback_context, status_callback_func);
+    }
+    else if (_wcsicmp(extension, L".mp3") == 0)
+    {
+        return WaveformLoadRangeFromMP3(filename, startFrame, count, wav,
+                    status_callback_context, status_callback_func);
+    }
+    else if (_wcsicmp(extension, L".flac") == 0)
+    {
+        return WaveformLoadFLACSamples(filename, nullptr, startFrame, count, wav,
+                    status_callback_context, status_callback_func);
+    }
+    else if (_wcsicmp(extension, L".raw") == 0 ||
+             _wcsicmp(extension, L".pcm") == 0)
+    {
+        RawPCMFormat format;
+        if (!GetRawPCMFormat(filename, format))
+            return false;
+        return WaveformLoadRangeFromRawPCM(filename, startFrame, count, wav,
+                    format.m_rate, format.m_bytesPerSample, format.m_numChannels, format.m_isFloat,
+                    status_callback_context, status_callback_func);
+    }
+
+    // Unrecognized filename extension!
+#ifdef TRACE
+    printf("Unrecognized filename extension on '%S'\n", filename);
+#endif
+    return false;
+}
+
+//
+// Loads part of the specified audio file into the given Waveform
+// object, starting at sample frame 'startFrame' and continuing for
+// 'count' sample frames.  See the header for details.
+//
+bool WaveformLoadRange(
+        const wchar_t *filename,
+        size_t startFrame,
+        size_t count,
+        Waveform &wav,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion)
+        )
+{
+#ifdef TRACE
+    printf("WaveformLoadRange '%S' startFrame=%zu count=%zu\n", filename, startFrame, count);
+    fflush(stdout);
+#endif
+
+    WaveformProfileScope profile("load");
+    profile.SetDetail(filename);
+    bool ok = LoadRangeByType(filename, startFrame, count, wav, status_callback_context, status_callback_func);
+    if (ok)
+        profile.AddCounts(wav.GetNumSamples() * wav.GetNumChannels(), wav.GetTotalBytes());
+    return ok;
+}
+
+// What a WaveformRangeReader learns about its file when it's
+// opened, so it doesn't have to be worked out for each range.
+struct WaveformRangeReader::State
+{
+    enum class Type { Whole, Stdin, WAV, MP3, FLAC, RawPCM };
+
+    std::wstring m_filename;
+    Type m_type = Type::Whole;
+    unsigned m_rate = 0;
+    size_t m_numChannels = 0;
+    size_t m_numSamples = 0;
+    uint32_t m_channelMask = 0;
+
+    Waveform m_whole;                       // All of the audio, for Type::Whole.
+    size_t m_position = 0;                  // The next frame to be read, for Type::Stdin.
+    MP3Info m_mp3;                          // The frame index, for Type::MP3.
+    std::vector<uint64_t> m_frameOffsets;
+    FLACInfo m_flac;                        // STREAMINFO and SEEKTABLE, for Type::FLAC.
+    RawPCMFormat m_raw;                     // The sample format, for Type::RawPCM.
+};
+
+WaveformRangeReader::WaveformRangeReader() : m_state(new State)
+{
+}
+
+WaveformRangeReader::~WaveformRangeReader()
+{
+}
+
+//
+// Opens the given file for loading a range at a time, reading its
+// header, frame index, or seek table.  Returns true if successful.
+//
+bool WaveformRangeReader::Open(const wchar_t *filename)
+{
+#ifdef TRACE
+    printf("WaveformRangeReader::Open '%S'\n", filename);
+    fflush(stdout);
+#endif
+
+    m_state.reset(new State);
+    State &state = *m_state;
+    state.m_filename = filename;
+
+    const wchar_t *extension = wcsrchr(filename, '.');
+    if (IsStandardStream(filename))
+    {
+        // Standard input can't skip ahead, but unless it has already
+        // been read whole (for WaveformReadFileInfo, say), it can be
+        // read forward a range at a time.  If its headers don't give
+        // its length, it's all read now.
+        if (!g_stdinRead)
+        {
+            if (!ReadStandardInputHeader())
+                return false;
+            if (g_stdinHeader.m_sample_count > 0)
+            {
+                g_stdinTaken = true;
+                state.m_type = State::Type::Stdin;
+                state.m_rate = g_stdinHeader.m_rate;
+                state.m_numChannels = g_stdinHeader.m_channels;
+                state.m_numSamples = static_cast<size_t>(g_stdinHeader.m_sample_count);
+                state.m_channelMask = g_stdinHeader.m_channel_mask;
+            }
+            else if (!ReadStandardInputSamples())
+            {
+                return false;
+            }
+        }
+    }
+    else if (!extension)
+    {
+        // Without an extension, the format is worked out when it's
+        // loaded whole.
+    }
+    else if (_wcsicmp(extension, L".wav") == 0)
+    {
+        WAVInfo hdr;
+        if (!WAVFileReadHeader(filename, hdr))
+            return false;
+        state.m_type = State::Type::WAV;
+        state.m_rate = hdr.m_rate;
+        state.m_numChannels = hdr.m_channels;
+        state.m_numSamples = static_cast<size_t>(hdr.m_sample_count);
+        state.m_channelMask = hdr.m_channel_mask;
+    }
+    else if (_wcsicmp(extension, L".mp3") == 0)
+    {
+        if (!MP3FileReadIndex(filename, state.m_mp3, state.m_frameOffsets, g_useIndexCache))
+            return false;
+
+        // If the index can't describe the stream, it's decoded now.
+        if (!state.m_frameOffsets.empty() &&
+            state.m_mp3.m_sample_count == state.m_frameOffsets.size() * state.m_mp3.m_frame_samples)
+        {
+            state.m_type = State::Type::MP3;
+            state.m_rate = state.m_mp3.m_rate;
+            state.m_numChannels = state.m_mp3.m_channels;
+            state.m_numSamples = static_cast<size_t>(state.m_mp3.m_sample_count);
+        }
+    }
+    else if (_wcsicmp(extension, L".flac") == 0)
+    {
+        if (!FLACFileReadInfo(filename, state.m_flac))
+            return false;
+
+        // If the stream's length isn't known, it's decoded now.
+        if (state.m_flac.m_sample_count > 0)
+        {
+            state.m_type = State::Type::FLAC;
+            state.m_rate = state.m_flac.m_rate;
+            state.m_numChannels = state.m_flac.m_channels;
+            state.m_numSamples = static_cast<size_t>(state.m_flac.m_sample_count);
+        }
+    }
+    else if (_wcsicmp(extension, L".raw") == 0 ||
+             _wcsicmp(extension, L".pcm") == 0)
+    {
+        if (!GetRawPCMFormat(filename, state.m_raw))
+            return false;
+        state.m_type = State::Type::RawPCM;
+        state.m_rate = state.m_raw.m_rate;
+        state.m_numChannels = state.m_raw.m_numChannels;
+        state.m_numSamples = static_cast<size_t>(RawPCMFileGetSizeInBytes(filename) /
+            (state.m_raw.m_numChannels * state.m_raw.m_bytesPerSample));
+    }
+
+    if (state.m_type == State::Type::Whole)
+    {
+        if (!WaveformLoadFromFile(filename, state.m_whole))
+            return false;
+        state.m_rate = state.m_whole.GetRate();
+        state.m_numChannels = state.m_whole.GetNumChannels();
+        state.m_numSamples = state.m_whole.GetNumSamples();
+        state.m_channelMask = state.m_whole.GetChannelMask();
+    }
+
+    return state.m_numChannels > 0;
+}
+
+unsigned WaveformRangeReader::GetRate() const
+{
+    return m_state->m_rate;
+}
+
+size_t WaveformRangeReader::GetNumChannels() const
+{
+    return m_state->m_numChannels;
+}
+
+size_t WaveformRangeReader::GetNumSamples() const
+{
+    return m_state->m_numSamples;
+}
+
+uint32_t WaveformRangeReader::GetChannelMask() const
+{
+    return m_state->m_channelMask;
+}
+
+//
+// Loads part of the open file into the given Waveform object, the
+// same way as WaveformLoadRange.  Returns true if successful.
+//
+bool WaveformRangeReader::Load(
+        size_t startFrame,
+        size_t count,
+        Waveform &wav,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion)
+        )
+{
+    State &state = *m_state;
+    const wchar_t *filename = state.m_filename.c_str();
+    WaveformProfileScope profile("load");
+    profile.SetDetail(filename);
+
+    bool ok = false;
+    switch (state.m_type)
+    {
+    case State::Type::Whole:
+        ok = ClipLoadRange(state.m_numSamples, startFrame, count);
+        if (ok)
+        {
+            wav.SetRate(state.m_rate);
+            ok = wav.Populate(count, state.m_numChannels,
+                    state.m_whole.GetSamplesPtr() + startFrame * state.m_numChannels);
+            wav.SetChannelMask(state.m_channelMask);
+        }
+        if (ok && status_callback_func && !status_callback_func(status_callback_context, 1.0f))
+        {
+            wav = Waveform();
+            ok = false;
+        }
+        break;
+    case State::Type::Stdin:
+        ok = WaveformLoadRangeFromStdin(state.m_position, startFrame, count, wav,
+                status_callback_context, status_callback_func);
+        break;
+    case State::Type::WAV:
+        ok = WaveformLoadRangeFromWAV(filename, startFrame, count, wav,
+                status_callback_context, status_callback_func);
+        break;
+    case State::Type::MP3:
+        ok = WaveformLoadRangeFromMP3Index(filename, state.m_mp3, state.m_frameOffsets, startFrame, count, wav,
+                status_callback_context, status_callback_func);
+        break;
+    case State::Type::FLAC:
+        ok = WaveformLoadFLACSamples(filename, &state.m_flac, startFrame, count, wav,
+                status_callback_context, status_callback_func);
+        break;
+    case State::Type::RawPCM:
+        ok = WaveformLoadRangeFromRawPCM(filename, startFrame, count, wav,
+                state.m_raw.m_rate, state.m_raw.m_bytesPerSample, state.m_raw.m_numChannels, state.m_raw.m_isFloat,
+                status_callback_context, status_callback_func);
+        break;
+    }
+
+    if (ok)
+        profile.AddCounts(wav.GetNumSamples() * wav.GetNumChannels(), wav.GetTotalBytes());
+    return ok;
+}
+
+
+// State passed to the block callback while scanning a WAV file
+// for statistics.
+struct WAVStatsContext
+{
+    WAVInfo m_hdr;
+    WaveformBuffer<float> m_floats;
+    float m_lowest = FLT_MAX;
+    float m_highest = -FLT_MAX;
+};
+
+// Block callback for WAVFileReadSamplesInBlocks that updates the
+// running sample statistics in a WAVStatsContext.
+static bool AccumulateWAVStatsBlock(void *context, const void *samples, size_t bytes)
+{
+    WAVStatsContext *ctx = reinterpret_cast<WAVStatsContext *>(context);
+    size_t count = bytes / (ctx->m_hdr.m_bits / 8);
+    if (ctx->m_floats.size() < count)
+        ctx->m_floats.resize(count);
+
+    ConvertWAVSamplesToFloat(ctx->m_hdr, samples, ctx->m_floats.data(), count);
+    DSPKernelsGet().MinMax(ctx->m_floats.data(), count, ctx->m_lowest, ctx->m_highest);
+    return true;
+}
+
+// State passed to the block callback while scanning a raw PCM file
+// for statistics.
+struct RawStatsContext
+{
+    bool m_isFloat = false;
+    unsigned m_bytesPerSample = 0;
+    WaveformBuffer<float> m_floats;
+    float m_lowest = FLT_MAX;
+    float m_highest = -FLT_MAX;
+};
+
+// Block callback for RawPCMFileReadInBlocks that updates the
+// running sample statistics in a RawStatsContext.
+static bool AccumulateRawStatsBlock(void *context, const void *samples, size_t bytes)
+{
+    RawStatsContext *ctx = reinterpret_cast<RawStatsContext *>(context);
+    size_t count = bytes / ctx->m_bytesPerSample;
+    if (ctx->m_floats.size() < count)
+        ctx->m_floats.resize(count);
+
+    ConvertRawSamplesToFloat(ctx->m_isFloat, ctx->m_bytesPerSample,
+        reinterpret_cast<const uint8_t *>(samples), ctx->m_floats.data(), count);
+    DSPKernelsGet().MinMax(ctx->m_floats.data(), count, ctx->m_lowest, ctx->m_highest);
+    return true;
+}
+
+//
+// Finds the highest and lowest sample values in an MP3 file by
+// decoding it one frame at a time, without keeping the decoded
+// audio.  Returns true if successful.
+//
+static bool ScanMP3SampleRange(const wchar_t *filename, float &lowest, float &highest)
+{
+    WaveformBuffer<uint8_t> filedata = ReadFile(filename);
+    if (filedata.empty())
+        return false;
+
+    mp3dec_t mp3d = {0};
+    mp3dec_init(&mp3d);
+
+    mp3dec_frame_info_t info;
+    float pcm_frame[MINIMP3_MAX_SAMPLES_PER_FRAME] = {0};
+    int frame_samples = 0;
+    int frame_offset = 0;
+    while ((frame_samples = mp3dec_decode_frame(&mp3d,
+                                &filedata[frame_offset], (int)filedata.size() - frame_offset,
+                                pcm_frame, &info)) > 0)
+    {
+        DSPKernelsGet().MinMax(pcm_frame, static_cast<size_t>(frame_samples) * info.channels, lowest, highest);
+
+        frame_offset += info.frame_bytes;
+    }
+
+    return true;
+}
+
+//
+// Reads the format and length of the specified audio file without
+// loading its audio data into memory.  For WAV files only the
+// headers are read, for MP3 files only the frame headers are
+// examined, and for FLAC files only the metadata blocks are read;
+// nothing is decoded.  Returns true if successful.
+//
+// If 'computeStats' is true, the audio data is also read through
+// once to find the highest and lowest sample values.  This costs
+// about as much time as loading the file, but the samples are
+// examined a block at a time rather than held in memory.
+//
+bool WaveformReadFileInfo(
+        const wchar_t *filename,
+        WaveformFileInfo &info,
+        bool computeStats
+        )
+{
+#ifdef TRACE
+    printf("WaveformReadFileInfo '%S'\n", filename);
+    fflush(stdout);
+#endif
+
+    info = WaveformFileInfo();
+
+    if (IsStandardStream(filename))
+    {
+        // The audio has to be read to learn its length, so it's
+        // kept for loading later.
+        if (!ReadStandardInput())
+            return false;
+
+        info.m_format        = "WAV";
+        info.m_rate          = g_stdinWaveform.GetRate();
+        info.m_numChannels   = g_stdinWaveform.GetNumChannels();
+        info.m_numSamples    = g_stdinWaveform.GetNumSamples();
+        info.m_bitsPerSample = g_stdinHeader.m_valid_bits ? g_stdinHeader.m_valid_bits : g_stdinHeader.m_bits;
+        info.m_isFloat       = g_stdinHeader.m_is_float;
+        info.m_channelMask   = g_stdinHeader.m_channel_mask;
+
+        if (computeStats)
+        {
+            info.m_hasStats = true;
+            info.m_highestSample = g_stdinWaveform.GetHighestSample();
+            info.m_lowestSample = g_stdinWaveform.GetLowestSample();
+        }
+
+        return true;
+    }
+
+    const wchar_t *extension = wcsrchr(filename, '.');
+    if (!extension)
+        return false;
+
+    if (_wcsicmp(extension, L".wav") == 0)
+    {
+        WAVInfo hdr;
+        if (!WAVFileReadHeader(filename, hdr))
+            return false;
+
+        info.m_format        = hdr.m_is_rf64 ? "RF64 WAV" : "WAV";
+        info.m_rate          = hdr.m_rate;
+        info.m_numChannels   = hdr.m_channels;
+        info.m_numSamples    = static_cast<size_t>(hdr.m_sample_count);
+        info.m_bitsPerSample = hdr.m_valid_bits ? hdr.m_valid_bits : hdr.m_bits;
+        info.m_isFloat       = hdr.m_is_float;
+        info.m_channelMask   = hdr.m_channel_mask;
+
+        if (computeStats)
+        {
+            // Read about 64K sample frames at a time.
+            WAVStatsContext ctx;
+            ctx.m_hdr = hdr;
+            size_t blockSize = static_cast<size_t>(hdr.m_channels) * (hdr.m_bits / 8) * 65536;
+            if (!WAVFileReadSamplesInBlocks(filename, blockSize, AccumulateWAVStatsBlock, &ctx))
+                return false;
+
+            info.m_hasStats = true;
+            if (hdr.m_sample_count > 0)
+            {
+                info.m_highestSample = ctx.m_highest;
+                info.m_lowestSample = ctx.m_lowest;
+            }
+        }
+
+        return true;
+    }
+    else if (_wcsicmp(extension, L".mp3") == 0)
+    {
+        // A cached frame index is the quickest way to get exact
+        // counts when it's available.
+        MP3Info mp3;
+        std::vector<uint64_t> frameOffsets;
+        if (g_useIndexCache ? !MP3FileReadIndex(filename, mp3, frameOffsets, true) : !MP3FileReadInfo(filename, mp3))
+            return false;
+
+        info.m_format      = "MP3";
+        info.m_rate        = mp3.m_rate;
+        info.m_numChannels = mp3.m_channels;
+        info.m_numSamples  = static_cast<size_t>(mp3.m_sample_count);
+        info.m_bitrate     = mp3.m_bitrate;
+
+        if (computeStats)
+        {
+            float lowest = FLT_MAX;
+            float highest = -FLT_MAX;
+            if (!ScanMP3SampleRange(filename, lowest, highest))
+                return false;
+
+            info.m_hasStats = true;
+            if (lowest <= highest)
+            {
+                info.m_highestSample = highest;
+                info.m_lowestSample = lowest;
+            }
+        }
+
+        return true;
+    }
+    else if (_wcsicmp(extension, L".flac") == 0)
+    {
+        FLACInfo flac;
+        if (!FLACFileReadInfo(filename, flac))
+            return false;
+
+        info.m_format        = "FLAC";
+        info.m_rate          = flac.m_rate;
+        info.m_numChannels   = flac.m_channels;
+        info.m_numSamples    = static_cast<size_t>(flac.m_sample_count);
+        info.m_bitsPerSample = flac.m_bits;
+        if (flac.m_sample_count > 0)
+        {
+            info.m_bitrate = static_cast<unsigned>(
+                flac.m_data_bytes * 8 * flac.m_rate / flac.m_sample_count / 1000);
+        }
+
+        if (computeStats)
+        {
+            // FLAC files aren't read in blocks, so just load it.
+            Waveform wav;
+            if (!WaveformLoadFromFile(filename, wav))
+                return false;
+
+            info.m_hasStats = true;
+            info.m_highestSample = wav.GetHighestSample();
+            info.m_lowestSample = wav.GetLowestSample();
+        }
+
+        return true;
+    }
+    else if (_wcsicmp(extension, L".raw") == 0 ||
+             _wcsicmp(extension, L".pcm") == 0)
+    {
+        uint64_t fileBytes = RawPCMFileGetSizeInBytes(filename);
+        if (fileBytes < 1)
+            return false;
+        RawPCMFormat format;
+        if (!GetRawPCMFormat(filename, format))
+            return false;
+
+        info.m_format        = "Raw PCM";
+        info.m_rate          = format.m_rate;
+        info.m_numChannels   = format.m_numChannels;
+        info.m_numSamples    = static_cast<size_t>(fileBytes / (format.m_numChannels * format.m_bytesPerSample));
+        info.m_bitsPerSample = format.m_bytesPerSample * 8;
+        info.m_isFloat       = format.m_isFloat;
+
+        if (computeStats)
+        {
+            // Read about 64K sample frames at a time.
+            RawStatsContext ctx;
+            ctx.m_isFloat = format.m_isFloat;
+            ctx.m_bytesPerSample = format.m_bytesPerSample;
+            size_t blockSize = static_cast<size_t>(format.m_numChannels) * format.m_bytesPerSample * 65536;
+            if (!RawPCMFileReadInBlocks(filename, 0, info.m_numSamples, format.m_numChannels, format.m_bytesPerSample,
+                                        blockSize, AccumulateRawStatsBlock, &ctx))
+            {
+                return false;
+            }
+
+            info.m_hasStats = true;
+            if (info.m_numSamples > 0)
+            {
+                info.m_highestSample = ctx.m_highest;
+                info.m_lowestSample = ctx.m_lowest;
+            }
+        }
+
+        return true;
+    }
+
+    // Unrecognized filename extension!
+#ifdef TRACE
+    printf("Unrecognized filename extension on '%S'\n", filename);
+#endif
+    return false;
+}
@@ -0,0 +1,472 @@
+//-------------------------------------------------------------------
+//
+// waveformprocessors.cpp
+// The effects of the waveform tools, as processors that can be
+// connected together in a WaveformGraph.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#include "waveformprocessors.h"
+#include "lowpass.h"
+#include "highpass.h"
+#include "bandpassfilter.h"
+#include "notchfilter.h"
+#include "segmentedfilter.h"
+#include "threadpool.h"
+#include "dspkernels.h"
+#include <string.h>
+#include <algorithm>
+
+// Checks that a processor has one input, and gives its output the
+// same format.  Returns false if it doesn't have one input.
+static bool ConfigureOneInput(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat)
+{
+    if (numInputs != 1)
+        return false;
+
+    outputFormat = inputFormats[0];
+    return true;
+}
+
+//--------------------------------------------------
+// VolumeProcessor
+//--------------------------------------------------
+
+bool VolumeProcessor::Configure(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat)
+{
+    return ConfigureOneInput(inputFormats, numInputs, outputFormat);
+}
+
+bool VolumeProcessor::Process(const WaveformBlock *const *inputs, size_t, WaveformBlock &output)
+{
+    const float *in = inputs[0]->GetSamplesPtr();
+    float *out = output.GetSamplesPtr();
+    size_t count = inputs[0]->GetNumFrames() * inputs[0]->GetNumChannels();
+    const float volume = m_volume;
+    ThreadPool::GetShared().ParallelFor(count, 2 * sizeof(float), [=](size_t first, size_t end) {
+        DSPKernelsGet().GainClip(in + first, out + first, end - first, volume, -1.0f, 1.0f);
+    });
+
+    output.SetNumFrames(inputs[0]->GetNumFrames());
+    return true;
+}
+
+//--------------------------------------------------
+// EQProcessor
+//--------------------------------------------------
+
+EQProcessor::EQProcessor(float lowPassFreq, float highPassFreq,
+                         float bandpassFreq, float bandpassQ,
+                         float notchFreq, float notchQ) :
+    m_lowPassFreq(lowPassFreq),
+    m_highPassFreq(highPassFreq),
+    m_bandpassFreq(bandpassFreq),
+    m_bandpassQ(bandpassQ),
+    m_notchFreq(notchFreq),
+    m_notchQ(notchQ)
+{
+}
+
+// Defined here, where the filter classes are complete.
+EQProcessor::~EQProcessor() = default;
+
+// Creates the filters for the stream's sample rate.
+bool EQProcessor::Configure(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat)
+{
+    if (!ConfigureOneInput(inputFormats, numInputs, outputFormat))
+        return false;
+
+    float rate = static_cast<float>(outputFormat.m_rate);
+    m_lowPass.reset(m_lowPassFreq > 0.0f ? new LowPassFilter(m_lowPassFreq, rate) : nullptr);
+    m_highPass.reset(m_highPassFreq > 0.0f ? new HighPassFilter(m_highPassFreq, rate) : nullptr);
+    m_bandpass.reset(m_bandpassFreq > 0.0f ? new BandpassFilter(rate, m_bandpassFreq, m_bandpassQ) : nullptr);
+    m_notch.reset(m_notchFreq > 0.0f ? new NotchFilter(rate, m_notchFreq, m_notchQ) : nullptr);
+    return true;
+}
+
+// In parallel mode, the filters run over the whole block one after
+// another instead of each sample going through all of them in turn.
+// Since each filter only sees its own series of samples either way,
+// that alone doesn't change the result.
+bool EQProcessor::Process(const WaveformBlock *const *inputs, size_t, WaveformBlock &output)
+{
+    const float *in = inputs[0]->GetSamplesPtr();
+    float *out = output.GetSamplesPtr();
+    size_t count = inputs[0]->GetNumFrames() * inputs[0]->GetNumChannels();
+    if (m_parallel)
+    {
+        memcpy(out, in, count * sizeof(float));
+        if (m_lowPass)
+            FilterSamplesInSegments(*m_lowPass, out, out, count);
+        if (m_highPass)
+            FilterSamplesInSegments(*m_highPass, out, out, count);
+        if (m_bandpass)
+            FilterSamplesInSegments(*m_bandpass, out, out, count);
+        if (m_notch)
+            FilterSamplesInSegments(*m_notch, out, out, count);
+
+        ThreadPool::GetShared().ParallelFor(count, sizeof(float), [&](size_t first, size_t end) {
+            DSPKernelsGet().GainClip(out + first, out + first, end - first, 1.0f, -1.0f, 1.0f);
+        });
+
+        output.SetNumFrames(inputs[0]->GetNumFrames());
+        return true;
+    }
+
+    for (size_t index = 0; index < count; index++)
+    {
+        float value = in[index];
+
+        if (m_lowPass)
+            value = m_lowPass->FilterSample(value);
+        if (m_highPass)
+            value = m_highPass->FilterSample(value);
+        if (m_bandpass)
+            value = m_bandpass->FilterSample(value);
+        if (m_notch)
+            value = m_notch->FilterSample(value);
+
+        out[index] = Waveform::ClipValue(value, -1, 1);
+    }
+
+    output.SetNumFrames(inputs[0]->GetNumFrames());
+    return true;
+}
+
+//--------------------------------------------------
+// FadeProcessor
+//--------------------------------------------------
+
+// Works out where the fades start and end, from the stream's length.
+bool FadeProcessor::Configure(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat)
+{
+    if (!ConfigureOneInput(inputFormats, numInputs, outputFormat))
+        return false;
+
+    float fadeInSeconds = m_fadeInSeconds;
+    float fadeOutSeconds = m_fadeOutSeconds;
+    if (fadeInSeconds > outputFormat.GetDurationInSeconds())
+        fadeInSeconds = outputFormat.GetDurationInSeconds();
+    if (fadeOutSeconds > outputFormat.GetDurationInSeconds())
+        fadeOutSeconds = outputFormat.GetDurationInSeconds();
+
+    m_numChannels = outputFormat.m_numChannels;
+    m_numFadeInSamples = outputFormat.TimeToSampleIndex(fadeInSeconds) * m_numChannels;
+    m_numFadeOutSamples = outputFormat.TimeToSampleIndex(fadeOutSeconds) * m_numChannels;
+    m_fadeOutStart = outputFormat.m_numSamples * m_numChannels - m_numFadeOutSamples;
+    m_index = 0;
+    return true;
+}
+
+// The fade multipliers divide by the number of interleaved samples
+// in the fade times the number of channels, so (just as WaveFade has
+// always done) the fade-in only rises to 1 / channels and the
+// fade-out starts from 1 - 1 / channels.  Each sample's multiplier
+// depends only on its position in the stream, so a large block is
+// split into ranges that are faded on all of the threads of the pool.
+bool FadeProcessor::Process(const WaveformBlock *const *inputs, size_t, WaveformBlock &output)
+{
+    const float *in = inputs[0]->GetSamplesPtr();
+    float *out = output.GetSamplesPtr();
+    size_t count = inputs[0]->GetNumFrames() * inputs[0]->GetNumChannels();
+    ThreadPool::GetShared().ParallelFor(count, 2 * sizeof(float), [&](size_t first, size_t end) {
+        for (size_t i = first; i < end; i++)
+        {
+            size_t index = m_index + i;
+            float value = in[i];
+
+            if (index < m_numFadeInSamples)
+                value *= static_cast<float>(index) / (m_numFadeInSamples * m_numChannels);
+            if (index >= m_fadeOutStart)
+                value *= 1.0f - (static_cast<float>(index - m_fadeOutStart) / (m_numFadeOutSamples * m_numChannels));
+
+            out[i] = Waveform::ClipValue(value, -1, 1);
+        }
+    });
+    m_index += count;
+
+    output.SetNumFrames(inputs[0]->GetNumFrames());
+    return true;
+}
+
+//--------------------------------------------------
+// TremoloProcessor
+//--------------------------------------------------
+
+// Works out the width of the tremolo cycle in samples.
+bool TremoloProcessor::Configure(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat)
+{
+    if (!ConfigureOneInput(inputFormats, numInputs, outputFormat))
+        return false;
+
+    m_width = m_widthIsTime ?
+        outputFormat.TimeToSampleIndex(static_cast<float>(m_widthParam)) :
+        static_cast<size_t>(m_widthParam);
+    m_position = 0;
+    return m_width >= 2;
+}
+
+bool TremoloProcessor::Process(const WaveformBlock *const *inputs, size_t, WaveformBlock &output)
+{
+    const float *in = inputs[0]->GetSamplesPtr();
+    float *out = output.GetSamplesPtr();
+    size_t numFrames = inputs[0]->GetNumFrames();
+    size_t numChannels = inputs[0]->GetNumChannels();
+
+    // Each frame's amplitude depends only on its position in the
+    // stream, so a large block is split into ranges that are
+    // processed on all of the threads of the pool.
+    ThreadPool::GetShared().ParallelFor(numFrames, 2 * numChannels * sizeof(float), [&](size_t first, size_t end) {
+        for (size_t iframe = first; iframe < end; iframe++)
+        {
+            size_t trempos = (m_position + iframe) % m_width;
+            float tremAmplitude = 0.0f;
+            if (trempos < m_width / 2)
+            {
+                tremAmplitude = m_depth * trempos / (m_width / 2);
+            }
+            else
+            {
+                trempos -= m_width / 2;
+                tremAmplitude = m_depth * ((m_width / 2) - 1 - trempos) / (m_width / 2);
+            }
+
+            const float *pin = in + iframe * numChannels;
+            float *pout = out + iframe * numChannels;
+            for (size_t ichannel = 0; ichannel < numChannels; ichannel++)
+                *pout++ = *pin++ * (1.0f - tremAmplitude);
+        }
+    });
+    m_position += numFrames;
+
+    output.SetNumFrames(numFrames);
+    return true;
+}
+
+//--------------------------------------------------
+// EchoProcessor
+//--------------------------------------------------
+
+// Works out the delay in samples, and sets up the history of input
+// samples that the echoes are taken from.
+bool EchoProcessor::Configure(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat)
+{
+    if (!ConfigureOneInput(inputFormats, numInputs, outputFormat))
+        return false;
+
+    m_delay = outputFormat.TimeToSampleIndex(m_delayMs / 1000.0f) * outputFormat.m_numChannels;
+    m_history.assign(m_delay * m_repeat, 0.0f);
+    m_index = 0;
+    return true;
+}
+
+// Each output sample is the input sample plus the input samples one
+// delay ago, two delays ago, and so on, where there were any.  The
+// input samples are kept in a ring buffer just long enough to hold
+// the oldest echo.
+bool EchoProcessor::Process(const WaveformBlock *const *inputs, size_t, WaveformBlock &output)
+{
+    const float *in = inputs[0]->GetSamplesPtr();
+    float *out = output.GetSamplesPtr();
+    size_t count = inputs[0]->GetNumFrames() * inputs[0]->GetNumChannels();
+    size_t historySize = m_history.size();
+    for (size_t i = 0; i < count; i++, m_index++)
+    {
+        float value = 0.0f;
+        if (m_dryLevel > 0)
+            value = in[i] * m_dryLevel;
+
+        for (size_t iecho = 0; iecho < m_repeat; iecho++)
+        {
+            size_t lag = m_delay * (iecho + 1);
+            if (lag == 0)
+                value += in[i] * m_wetLevel / (iecho + 1);
+            else if (lag <= m_index)
+                value += m_history[(m_index - lag) % historySize] * m_wetLevel / (iecho + 1);
+        }
+
+        if (historySize)
+            m_history[m_index % historySize] = in[i];
+        out[i] = Waveform::ClipValue(value, -1, 1);
+    }
+
+    output.SetNumFrames(inputs[0]->GetNumFrames());
+    return true;
+}
+
+//--------------------------------------------------
+// ChannelProcessor
+//--------------------------------------------------
+
+bool ChannelProcessor::Configure(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat)
+{
+    if (!ConfigureOneInput(inputFormats, numInputs, outputFormat))
+        return false;
+
+    // Only mono can be converted to stereo.
+    if (m_numChannels == 2 && outputFormat.m_numChannels > 2)
+        return false;
+
+    if (outputFormat.m_numChannels != m_numChannels)
+        outputFormat.m_channelMask = 0;
+    outputFormat.m_numChannels = m_numChannels;
+    return m_numChannels == 1 || m_numChannels == 2;
+}
+
+bool ChannelProcessor::Process(const WaveformBlock *const *inputs, size_t, WaveformBlock &output)
+{
+    const float *in = inputs[0]->GetSamplesPtr();
+    float *out = output.GetSamplesPtr();
+    size_t numFrames = inputs[0]->GetNumFrames();
+    size_t inChannels = inputs[0]->GetNumChannels();
+    if (inChannels == m_numChannels)
+    {
+        memcpy(out, in, numFrames * inChannels * sizeof(float));
+    }
+    else if (m_numChannels == 1)
+    {
+        for (size_t iframe = 0; iframe < numFrames; iframe++)
+        {
+            float val = 0.0;
+            for (size_t channel = 0; channel < inChannels; channel++)
+                val += *in++ / inChannels;
+            *out++ = val;
+        }
+    }
+    else
+    {
+        for (size_t iframe = 0; iframe < numFrames; iframe++)
+        {
+            *out++ = *in;
+            *out++ = *in++;
+        }
+    }
+
+    output.SetNumFrames(numFrames);
+    return true;
+}
+
+//--------------------------------------------------
+// MixProcessor
+//--------------------------------------------------
+
+// Works out the format of the mix.
+bool MixProcessor::Configure(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat)
+{
+    if (numInputs < 1 || numInputs != m_volumes.size())
+        return false;
+
+    outputFormat = inputFormats[0];
+    for (size_t iinput = 1; iinput < numInputs; iinput++)
+    {
+        const WaveformFormat &format = inputFormats[iinput];
+        if (format.m_numChannels != outputFormat.m_numChannels)
+            outputFormat.m_numChannels = 2;
+        if (format.m_numChannels != outputFormat.m_numChannels ||
+            format.m_channelMask != outputFormat.m_channelMask)
+        {
+            outputFormat.m_channelMask = 0;
+        }
+
+        // An input at another rate takes up as long in the mix as it
+        // would at its own rate, though it isn't resampled.
+        size_t numSamples = format.m_numSamples;
+        if (format.m_rate != outputFormat.m_rate)
+            numSamples = static_cast<size_t>(format.GetDurationInSeconds() * outputFormat.m_rate);
+        if (numSamples > outputFormat.m_numSamples)
+            outputFormat.m_numSamples = numSamples;
+    }
+
+    // Inputs that have latency run on past the end of the mix.
+    m_numSamples = outputFormat.m_numSamples;
+    m_extraSamples = 0;
+    for (size_t iinput = 0; iinput < numInputs; iinput++)
+        m_extraSamples = std::max(m_extraSamples, inputFormats[iinput].m_latency);
+    m_position = 0;
+
+    // Inputs that need converting to stereo have to be mono.
+    for (size_t iinput = 0; iinput < numInputs; iinput++)
+    {
+        if (inputFormats[iinput].m_numChannels != outputFormat.m_numChannels &&
+            inputFormats[iinput].m_numChannels != 1)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Adds each input into the mix in turn, then clips the mix.
+bool MixProcessor::Process(const WaveformBlock *const *inputs, size_t numInputs, WaveformBlock &output)
+{
+    // The mix runs to its full length, even past the ends of inputs
+    // at other rates, and no further.
+    size_t numFrames = m_numSamples + m_extraSamples - m_position;
+    if (numFrames > output.GetMaxFrames())
+        numFrames = output.GetMaxFrames();
+    m_position += numFrames;
+
+    size_t numChannels = output.GetNumChannels();
+    float *out = output.GetSamplesPtr();
+    const DSPKernels &kernels = DSPKernelsGet();
+    memset(out, 0, numFrames * numChannels * sizeof(float));
+    for (size_t iinput = 0; iinput < numInputs; iinput++)
+    {
+        const WaveformBlock &input = *inputs[iinput];
+        const float *in = input.GetSamplesPtr();
+        float volume = m_volumes[iinput];
+        if (input.GetNumChannels() == numChannels)
+        {
+            size_t count = std::min(input.GetNumFrames(), numFrames) * numChannels;
+            kernels.MixAdd(in, out, count, volume);
+        }
+        else
+        {
+            // A mono input, heard in every channel.
+            for (size_t iframe = 0; iframe < std::min(input.GetNumFrames(), numFrames); iframe++)
+            {
+                for (size_t channel = 0; channel < numChannels; channel++)
+                    out[iframe * numChannels + channel] += in[iframe] * volume;
+            }
+        }
+    }
+
+    kernels.GainClip(out, out, numFrames * numChannels, 1.0f, -1.0f, 1.0f);
+
+    output.SetNumFrames(numFrames);
+    return true;
+}
@@ -0,0 +1,789 @@
+//-------------------------------------------------------------------
+//
+// waveformprofile.cpp
+// C++ functions for timing and counting the stages of loading,
+// converting, processing, and saving audio, and for counting the
+// memory that each stage's buffers hold.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#include "waveformprofile.h"
+#include "threadpool.h"
+#include "platform.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+bool g_waveformProfileEnabled = false;
+
+// The most stages one thread keeps totals for.  Stages past this are
+// left out of the report.
+static const size_t kMaxStagesPerThread = 64;
+
+// The totals of one stage on one thread.  Only the thread that owns
+// them writes them, so they're atomic only so the report can read
+// them safely while that thread may still be running.
+struct StageTotals
+{
+    std::atomic<const char *> m_name;
+    std::atomic<uint64_t> m_calls;
+    std::atomic<uint64_t> m_totalTime;
+    std::atomic<uint64_t> m_selfTime;
+    std::atomic<uint64_t> m_samples;
+    std::atomic<uint64_t> m_bytes;
+};
+
+// One run of a scope, for the trace.
+struct TraceEvent
+{
+    const char *m_name;
+    uint64_t m_start;       // In nanoseconds.
+    uint64_t m_duration;    // In nanoseconds.
+    uint64_t m_samples;
+    uint64_t m_bytes;
+    std::wstring m_detail;
+};
+
+// The most events one thread keeps for the trace.  Events past this
+// are left out, so a long run can't use up all of the memory.
+static const size_t kMaxTraceEventsPerThread = 1024 * 1024;
+
+// The totals of every stage that ran on one thread, and its trace.
+struct ThreadProfile
+{
+    std::atomic<size_t> m_numStages;
+    StageTotals m_stages[kMaxStagesPerThread];
+
+    // Only the thread adds events, so the lock is only ever waited
+    // for while the trace is being written.
+    std::mutex m_traceLock;
+    std::vector<TraceEvent> m_events;
+    uint64_t m_droppedEvents = 0;
+    const char *m_threadName = nullptr;
+    unsigned m_threadId = 0;
+};
+
+// Every thread's profile, from the first time it runs a scope.  The
+// profiles, and the list itself, are never freed, so a thread that's
+// still running when the program exits can't be left writing to
+// freed memory.  Being reachable from a static reference, they're
+// not reported as leaks either.
+static std::mutex g_profilesLock;
+static std::vector<ThreadProfile *> &g_profiles = *new std::vector<ThreadProfile *>;
+
+static thread_local ThreadProfile *t_profile = nullptr;
+static thread_local WaveformProfileScope *t_currentScope = nullptr;
+
+static bool g_reportTimes = false;
+static std::wstring g_timesFilename;
+static uint64_t g_enableTime = 0;
+
+static bool g_traceEnabled = false;
+static std::wstring g_traceFilename;
+
+static uint64_t Now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Adds to a total that only this thread writes.  A load and a store
+// are cheaper than an atomic add, and enough with only one writer.
+static void AddTo(std::atomic<uint64_t> &total, uint64_t value)
+{
+    total.store(total.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// Returns the calling thread's profile, creating it the first time.
+static ThreadProfile *GetThreadProfile()
+{
+    if (!t_profile)
+    {
+        t_profile = new ThreadProfile();
+        std::lock_guard<std::mutex> lock(g_profilesLock);
+        g_profiles.push_back(t_profile);
+        t_profile->m_threadId = static_cast<unsigned>(g_profiles.size());
+    }
+    return t_profile;
+}
+
+// Returns the calling thread's totals for the named stage, or nullptr
+// if the thread has run out of room for stages.
+static StageTotals *FindStage(const char *name)
+{
+    GetThreadProfile();
+
+    // The same name may be at different addresses in different
+    // source files, so the names are compared if the pointers differ.
+    size_t numStages = t_profile->m_numStages.load(std::memory_order_relaxed);
+    for (size_t index = 0; index < numStages; index++)
+    {
+        const char *stageName = t_profile->m_stages[index].m_name.load(std::memory_order_relaxed);
+        if (stageName == name || strcmp(stageName, name) == 0)
+            return &t_profile->m_stages[index];
+    }
+
+    if (numStages >= kMaxStagesPerThread)
+        return nullptr;
+    StageTotals &stage = t_profile->m_stages[numStages];
+    stage.m_name.store(name, std::memory_order_relaxed);
+    t_profile->m_numStages.store(numStages + 1, std::memory_order_release);
+    return &stage;
+}
+
+void WaveformProfileScope::Begin(const char *name, uint64_t samples, uint64_t bytes)
+{
+    m_name = name;
+    m_samples = samples;
+    m_bytes = bytes;
+    m_parent = t_currentScope;
+    t_currentScope = this;
+    m_start = Now();
+}
+
+void WaveformProfileScope::End()
+{
+    uint64_t elapsed = Now() - m_start;
+    t_currentScope = m_parent;
+    if (m_parent)
+        m_parent->m_childTime += elapsed;
+
+    StageTotals *stage = FindStage(m_name);
+    if (stage)
+    {
+        AddTo(stage->m_calls, 1);
+        AddTo(stage->m_totalTime, elapsed);
+        AddTo(stage->m_selfTime, (elapsed > m_childTime) ? elapsed - m_childTime : 0);
+        AddTo(stage->m_samples, m_samples);
+        AddTo(stage->m_bytes, m_bytes);
+    }
+
+    if (g_traceEnabled)
+    {
+        std::lock_guard<std::mutex> lock(t_profile->m_traceLock);
+        if (t_profile->m_events.size() < kMaxTraceEventsPerThread)
+        {
+            TraceEvent event = { m_name, m_start, elapsed, m_samples, m_bytes, m_detail ? m_detail : L"" };
+            t_profile->m_events.push_back(std::move(event));
+        }
+        else
+        {
+            t_profile->m_droppedEvents++;
+        }
+    }
+}
+
+// The totals of one stage across all of the threads.
+struct StageReport
+{
+    std::string m_name;
+    uint64_t m_calls = 0;
+    uint64_t m_totalTime = 0;
+    uint64_t m_selfTime = 0;
+    uint64_t m_samples = 0;
+    uint64_t m_bytes = 0;
+    unsigned m_threads = 0;
+};
+
+// Adds up each stage's totals across the threads, most self time first.
+static std::vector<StageReport> GatherStages()
+{
+    std::vector<StageReport> stages;
+    std::lock_guard<std::mutex> lock(g_profilesLock);
+    for (ThreadProfile *profile : g_profiles)
+    {
+        size_t numStages = profile->m_numStages.load(std::memory_order_acquire);
+        for (size_t index = 0; index < numStages; index++)
+        {
+            StageTotals &totals = profile->m_stages[index];
+            uint64_t calls = totals.m_calls.exchange(0, std::memory_order_relaxed);
+            if (calls == 0)
+                continue;
+
+            const char *name = totals.m_name.load(std::memory_order_relaxed);
+            auto found = std::find_if(stages.begin(), stages.end(),
+                [name](const StageReport &stage) { return stage.m_name == name; });
+            if (found == stages.end())
+            {
+                stages.emplace_back();
+                found = stages.end() - 1;
+                found->m_name = name;
+            }
+
+            found->m_calls += calls;
+            found->m_totalTime += totals.m_totalTime.exchange(0, std::memory_order_relaxed);
+            found->m_selfTime += totals.m_selfTime.exchange(0, std::memory_order_relaxed);
+            found->m_samples += totals.m_samples.exchange(0, std::memory_order_relaxed);
+            found->m_bytes += totals.m_bytes.exchange(0, std::memory_order_relaxed);
+            found->m_threads++;
+        }
+    }
+
+    std::sort(stages.begin(), stages.end(),
+        [](const StageReport &a, const StageReport &b) { return a.m_selfTime > b.m_selfTime; });
+    return stages;
+}
+
+// Returns 'count' per second of 'time', which is in nanoseconds.
+static double PerSecond(uint64_t count, uint64_t time)
+{
+    return time ? count * 1e9 / time : 0.0;
+}
+
+static void PrintReport(const std::vector<StageReport> &stages, uint64_t wallTime)
+{
+    uint64_t selfSum = 0;
+    for (const StageReport &stage : stages)
+        selfSum += stage.m_selfTime;
+
+    printf("Profile (%.3f seconds since profiling began):\n", wallTime / 1e9);
+    printf("  %-24s %8s %7s %11s %11s %6s %11s %10s %9s\n",
+        "Stage", "Calls", "Threads", "Total ms", "Self ms", "Self%", "Msamples/s", "MB", "MB/s");
+    for (const StageReport &stage : stages)
+    {
+        printf("  %-24s %8llu %7u %11.2f %11.2f %5.1f%% %11.2f %10.2f %9.1f\n",
+            stage.m_name.c_str(), static_cast<unsigned long long>(stage.m_calls), stage.m_threads,
+            stage.m_totalTime / 1e6, stage.m_selfTime / 1e6,
+            selfSum ? stage.m_selfTime * 100.0 / selfSum : 0.0,
+            PerSecond(stage.m_samples, stage.m_totalTime) / 1e6,
+            stage.m_bytes / 1048576.0, PerSecond(stage.m_bytes, stage.m_totalTime) / 1048576.0);
+    }
+    fflush(stdout);
+}
+
+static bool WriteReport(const wchar_t *filename, const std::vector<StageReport> &stages, uint64_t wallTime)
+{
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"wt") != 0 || fp == nullptr)
+        return false;
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"schema\": 1,\n");
+    fprintf(fp, "  \"wall_seconds\": %.6f,\n", wallTime / 1e9);
+    fprintf(fp, "  \"stages\": [\n");
+    for (size_t index = 0; index < stages.size(); index++)
+    {
+        const StageReport &stage = stages[index];
+        fprintf(fp, "    { \"name\": \"%s\", \"calls\": %llu, \"threads\": %u, \"total_seconds\": %.6f, "
+            "\"self_seconds\": %.6f, \"samples\": %llu, \"bytes\": %llu, \"samples_per_second\": %.1f, "
+            "\"bytes_per_second\": %.1f }%s\n",
+            stage.m_name.c_str(), static_cast<unsigned long long>(stage.m_calls), stage.m_threads,
+            stage.m_totalTime / 1e9, stage.m_selfTime / 1e9,
+            static_cast<unsigned long long>(stage.m_samples), static_cast<unsigned long long>(stage.m_bytes),
+            PerSecond(stage.m_samples, stage.m_totalTime), PerSecond(stage.m_bytes, stage.m_totalTime),
+            (index + 1 < stages.size()) ? "," : "");
+    }
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+
+    bool ok = (ferror(fp) == 0);
+    fclose(fp);
+    return ok;
+}
+
+void WaveformProfileReport()
+{
+    if (!g_reportTimes)
+        return;
+
+    std::vector<StageReport> stages = GatherStages();
+    if (stages.empty())
+        return;
+
+    uint64_t wallTime = Now() - g_enableTime;
+    if (g_timesFilename.empty())
+    {
+        PrintReport(stages, wallTime);
+    }
+    else if (!WriteReport(g_timesFilename.c_str(), stages, wallTime))
+    {
+        printf("Failed writing the profile to '%S'\n", g_timesFilename.c_str());
+        fflush(stdout);
+    }
+}
+
+static void ReportAtExit()
+{
+    WaveformProfileReport();
+    WaveformMemStatsReport();
+    WaveformTraceWrite();
+}
+
+// Starts tracking scopes, for either the times or the memory report.
+static void EnableScopes()
+{
+    if (g_waveformProfileEnabled)
+        return;
+
+    g_enableTime = Now();
+    g_waveformProfileEnabled = true;
+    atexit(ReportAtExit);
+}
+
+void WaveformProfileEnable(const wchar_t *jsonFilename)
+{
+    g_timesFilename = jsonFilename ? jsonFilename : L"";
+    g_reportTimes = true;
+    EnableScopes();
+}
+
+//--------------------------------------------------
+// Memory accounting
+//--------------------------------------------------
+
+bool g_waveformMemStatsEnabled = false;
+
+// The most stages that memory is counted for separately.  Buffers of
+// stages past this are charged to "other".
+static const size_t kMaxMemStages = 64;
+
+// The memory totals of one stage.  Buffers are allocated far less
+// often than scopes run, so these are shared by all of the threads.
+struct MemStage
+{
+    std::atomic<const char *> m_name;
+    std::atomic<uint64_t> m_buffers;
+    std::atomic<uint64_t> m_allocatedBytes;
+    std::atomic<size_t> m_currentBytes;
+    std::atomic<size_t> m_peakBytes;
+    size_t m_bytesAtPeak;   // Held when the total peaked; guarded by g_memPeakLock.
+};
+
+// The first stage is always "other".
+static MemStage g_memStages[kMaxMemStages];
+static std::atomic<size_t> g_numMemStages(0);
+static std::mutex g_memStagesLock;
+
+static std::atomic<size_t> g_memCurrentBytes(0);
+static std::atomic<size_t> g_memPeakBytes(0);
+static std::mutex g_memPeakLock;
+
+static bool g_reportMemory = false;
+static std::wstring g_memFilename;
+
+// Room in front of each buffer for the stage it's charged to, enough
+// to leave the buffer as well aligned as operator new left the block.
+static const size_t kBufferHeaderBytes = 16;
+
+// Raises 'peak' to 'value' if it's higher.  Returns true if it was.
+static bool RaisePeak(std::atomic<size_t> &peak, size_t value)
+{
+    size_t old = peak.load(std::memory_order_relaxed);
+    while (value > old)
+    {
+        if (peak.compare_exchange_weak(old, value, std::memory_order_relaxed))
+            return true;
+    }
+    return false;
+}
+
+// Returns the totals for the named stage, adding it if it's new.
+static MemStage *FindMemStage(const char *name)
+{
+    if (!name)
+        return &g_memStages[0];
+
+    size_t numStages = g_numMemStages.load(std::memory_order_acquire);
+    for (size_t index = 1; index < numStages; index++)
+    {
+        const char *stageName = g_memStages[index].m_name.load(std::memory_order_relaxed);
+        if (stageName == name || strcmp(stageName, name) == 0)
+            return &g_memStages[index];
+    }
+
+    std::lock_guard<std::mutex> lock(g_memStagesLock);
+    numStages = g_numMemStages.load(std::memory_order_relaxed);
+    for (size_t index = 1; index < numStages; index++)
+    {
+        if (strcmp(g_memStages[index].m_name.load(std::memory_order_relaxed), name) == 0)
+            return &g_memStages[index];
+    }
+
+    if (numStages >= kMaxMemStages)
+        return &g_memStages[0];
+    g_memStages[numStages].m_name.store(name, std::memory_order_relaxed);
+    g_numMemStages.store(numStages + 1, std::memory_order_release);
+    return &g_memStages[numStages];
+}
+
+// Charges a new buffer to the stage of the calling thread's innermost
+// scope, and notes what each stage held if the total is at a new peak.
+static MemStage *ChargeBuffer(size_t bytes)
+{
+    MemStage *stage = FindMemStage(t_currentScope ? t_currentScope->GetName() : nullptr);
+    stage->m_buffers.fetch_add(1, std::memory_order_relaxed);
+    stage->m_allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    RaisePeak(stage->m_peakBytes, stage->m_currentBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+
+    size_t total = g_memCurrentBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (RaisePeak(g_memPeakBytes, total))
+    {
+        // Another thread may have raised the peak again since, in
+        // which case its snapshot is the one to keep.
+        std::lock_guard<std::mutex> lock(g_memPeakLock);
+        if (g_memPeakBytes.load(std::memory_order_relaxed) == total)
+        {
+            size_t numStages = g_numMemStages.load(std::memory_order_acquire);
+            for (size_t index = 0; index < numStages; index++)
+                g_memStages[index].m_bytesAtPeak = g_memStages[index].m_currentBytes.load(std::memory_order_relaxed);
+        }
+    }
+
+    return stage;
+}
+
+void *WaveformBufferAlloc(size_t bytes)
+{
+    if (bytes > static_cast<size_t>(-1) - kBufferHeaderBytes)
+        throw std::bad_alloc();
+
+    char *block = static_cast<char *>(::operator new(bytes + kBufferHeaderBytes));
+    MemStage *stage = g_waveformMemStatsEnabled ? ChargeBuffer(bytes) : nullptr;
+    memcpy(block, &stage, sizeof(stage));
+    return block + kBufferHeaderBytes;
+}
+
+void WaveformBufferFree(void *p, size_t bytes)
+{
+    if (!p)
+        return;
+
+    char *block = static_cast<char *>(p) - kBufferHeaderBytes;
+    MemStage *stage = nullptr;
+    memcpy(&stage, block, sizeof(stage));
+    if (stage)
+    {
+        stage->m_currentBytes.fetch_sub(bytes, std::memory_order_relaxed);
+        g_memCurrentBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+    ::operator delete(block);
+}
+
+size_t WaveformMemStatsGetCurrentBytes()
+{
+    return g_memCurrentBytes.load(std::memory_order_relaxed);
+}
+
+size_t WaveformMemStatsGetPeakBytes()
+{
+    return g_memPeakBytes.load(std::memory_order_relaxed);
+}
+
+// The memory totals of one stage, as of the report.
+struct MemStageReport
+{
+    const char *m_name = nullptr;
+    uint64_t m_buffers = 0;
+    uint64_t m_allocatedBytes = 0;
+    size_t m_peakBytes = 0;
+    size_t m_bytesAtPeak = 0;
+    size_t m_currentBytes = 0;
+};
+
+// Copies the stages that allocated anything, most held at the peak
+// first.
+static std::vector<MemStageReport> GatherMemStages()
+{
+    std::vector<MemStageReport> stages;
+    std::lock_guard<std::mutex> lock(g_memPeakLock);
+    size_t numStages = g_numMemStages.load(std::memory_order_acquire);
+    for (size_t index = 0; index < numStages; index++)
+    {
+        const MemStage &totals = g_memStages[index];
+        MemStageReport stage;
+        stage.m_name = totals.m_name.load(std::memory_order_relaxed);
+        stage.m_buffers = totals.m_buffers.load(std::memory_order_relaxed);
+        stage.m_allocatedBytes = totals.m_allocatedBytes.load(std::memory_order_relaxed);
+        stage.m_peakBytes = totals.m_peakBytes.load(std::memory_order_relaxed);
+        stage.m_bytesAtPeak = totals.m_bytesAtPeak;
+        stage.m_currentBytes = totals.m_currentBytes.load(std::memory_order_relaxed);
+        if (stage.m_buffers)
+            stages.push_back(stage);
+    }
+
+    std::sort(stages.begin(), stages.end(), [](const MemStageReport &a, const MemStageReport &b) {
+        return (a.m_bytesAtPeak != b.m_bytesAtPeak) ? a.m_bytesAtPeak > b.m_bytesAtPeak : a.m_peakBytes > b.m_peakBytes;
+    });
+    return stages;
+}
+
+static void PrintMemReport(const std::vector<MemStageReport> &stages)
+{
+    printf("Memory (%.2f MB held at the peak, %.2f MB still held):\n",
+        WaveformMemStatsGetPeakBytes() / 1048576.0, WaveformMemStatsGetCurrentBytes() / 1048576.0);
+    printf("  %-24s %8s %12s %10s %10s %10s\n",
+        "Stage", "Buffers", "Allocated MB", "Peak MB", "At peak MB", "Held MB");
+    for (const MemStageReport &stage : stages)
+    {
+        printf("  %-24s %8llu %12.2f %10.2f %10.2f %10.2f\n",
+            stage.m_name, static_cast<unsigned long long>(stage.m_buffers),
+            stage.m_allocatedBytes / 1048576.0, stage.m_peakBytes / 1048576.0,
+            stage.m_bytesAtPeak / 1048576.0, stage.m_currentBytes / 1048576.0);
+    }
+    fflush(stdout);
+}
+
+static bool WriteMemReport(const wchar_t *filename, const std::vector<MemStageReport> &stages)
+{
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"wt") != 0 || fp == nullptr)
+        return false;
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"schema\": 1,\n");
+    fprintf(fp, "  \"peak_bytes\": %zu,\n", WaveformMemStatsGetPeakBytes());
+    fprintf(fp, "  \"current_bytes\": %zu,\n", WaveformMemStatsGetCurrentBytes());
+    fprintf(fp, "  \"stages\": [\n");
+    for (size_t index = 0; index < stages.size(); index++)
+    {
+        const MemStageReport &stage = stages[index];
+        fprintf(fp, "    { \"name\": \"%s\", \"buffers\": %llu, \"allocated_bytes\": %llu, "
+            "\"peak_bytes\": %zu, \"bytes_at_peak\": %zu, \"current_bytes\": %zu }%s\n",
+            stage.m_name, static_cast<unsigned long long>(stage.m_buffers),
+            static_cast<unsigned long long>(stage.m_allocatedBytes),
+            stage.m_peakBytes, stage.m_bytesAtPeak, stage.m_currentBytes,
+            (index + 1 < stages.size()) ? "," : "");
+    }
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+
+    bool ok = (ferror(fp) == 0);
+    fclose(fp);
+    return ok;
+}
+
+void WaveformMemStatsReport()
+{
+    if (!g_reportMemory)
+        return;
+
+    std::vector<MemStageReport> stages = GatherMemStages();
+    if (g_memFilename.empty())
+    {
+        PrintMemReport(stages);
+    }
+    else if (!WriteMemReport(g_memFilename.c_str(), stages))
+    {
+        printf("Failed writing the memory report to '%S'\n", g_memFilename.c_str());
+        fflush(stdout);
+    }
+}
+
+void WaveformMemStatsEnable(const wchar_t *jsonFilename)
+{
+    g_memFilename = jsonFilename ? jsonFilename : L"";
+    g_reportMemory = true;
+    if (!g_waveformMemStatsEnabled)
+    {
+        g_memStages[0].m_name.store("other", std::memory_order_relaxed);
+        g_numMemStages.store(1, std::memory_order_release);
+        g_waveformMemStatsEnabled = true;
+    }
+    EnableScopes();
+}
+
+//--------------------------------------------------
+// Trace
+//--------------------------------------------------
+
+// Hooks for the thread pool, which time each task and each wait for
+// tasks with a scope of its own.
+static void *BeginPoolScope(const char *name)
+{
+    ThreadProfile *profile = GetThreadProfile();
+    if (!profile->m_threadName)
+    {
+        std::lock_guard<std::mutex> lock(profile->m_traceLock);
+        profile->m_threadName = "pool worker";
+    }
+    return new WaveformProfileScope(name);
+}
+
+static void EndPoolScope(void *scope)
+{
+    delete static_cast<WaveformProfileScope *>(scope);
+}
+
+void WaveformProfileNameThread(const char *name)
+{
+    if (!g_waveformProfileEnabled)
+        return;
+
+    ThreadProfile *profile = GetThreadProfile();
+    std::lock_guard<std::mutex> lock(profile->m_traceLock);
+    profile->m_threadName = name;
+}
+
+// Writes text to a JSON file as a quoted string, in UTF-8.
+static void WriteJSONString(FILE *fp, const std::wstring &text)
+{
+    fputc('"', fp);
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        uint32_t c = static_cast<uint32_t>(text[i]);
+        if (c >= 0xD800 && c < 0xDC00 && i + 1 < text.size())
+        {
+            // Combine a UTF-16 surrogate pair.
+            uint32_t low = static_cast<uint32_t>(text[i + 1]);
+            if (low >= 0xDC00 && low < 0xE000)
+            {
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            }
+        }
+
+        if (c == '"' || c == '\\')
+            fprintf(fp, "\\%c", static_cast<char>(c));
+        else if (c < 0x20)
+            fprintf(fp, "\\u%04x", c);
+        else if (c < 0x80)
+            fputc(static_cast<int>(c), fp);
+        else if (c < 0x800)
+            fprintf(fp, "%c%c", 0xC0 | (c >> 6), 0x80 | (c & 0x3F));
+        else if (c < 0x10000)
+            fprintf(fp, "%c%c%c", 0xE0 | (c >> 12), 0x80 | ((c >> 6) & 0x3F), 0x80 | (c & 0x3F));
+        else
+            fprintf(fp, "%c%c%c%c", 0xF0 | (c >> 18), 0x80 | ((c >> 12) & 0x3F), 0x80 | ((c >> 6) & 0x3F), 0x80 | (c & 0x3F));
+    }
+    fputc('"', fp);
+}
+
+// Writes the events of every thread in the Chrome trace event format,
+// with the times in microseconds since profiling began, and clears
+// them.  'droppedEvents' receives the number of events that were
+// left out for lack of room.  Returns true if successful.
+static bool WriteTrace(const wchar_t *filename, uint64_t &droppedEvents)
+{
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"wt") != 0 || fp == nullptr)
+        return false;
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"displayTimeUnit\": \"ms\",\n");
+    fprintf(fp, "  \"traceEvents\": [\n");
+    fprintf(fp, "    { \"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": { \"name\": \"WaveTools\" } }");
+
+    droppedEvents = 0;
+    std::lock_guard<std::mutex> lock(g_profilesLock);
+    for (ThreadProfile *profile : g_profiles)
+    {
+        std::lock_guard<std::mutex> traceLock(profile->m_traceLock);
+        if (profile->m_threadName)
+        {
+            fprintf(fp, ",\n    { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, "
+                "\"args\": { \"name\": \"%s\" } }", profile->m_threadId, profile->m_threadName);
+        }
+        else
+        {
+            fprintf(fp, ",\n    { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, "
+                "\"args\": { \"name\": \"thread %u\" } }", profile->m_threadId, profile->m_threadId);
+        }
+
+        for (const TraceEvent &event : profile->m_events)
+        {
+            fprintf(fp, ",\n    { \"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, "
+                "\"ts\": %.3f, \"dur\": %.3f, \"args\": { \"samples\": %llu, \"bytes\": %llu",
+                event.m_name, profile->m_threadId,
+                (event.m_start - g_enableTime) / 1e3, event.m_duration / 1e3,
+                static_cast<unsigned long long>(event.m_samples), static_cast<unsigned long long>(event.m_bytes));
+            if (!event.m_detail.empty())
+            {
+                fprintf(fp, ", \"detail\": ");
+                WriteJSONString(fp, event.m_detail);
+            }
+            fprintf(fp, " } }");
+        }
+
+        droppedEvents += profile->m_droppedEvents;
+        profile->m_droppedEvents = 0;
+        profile->m_events.clear();
+    }
+
+    fprintf(fp, "\n  ]\n");
+    fprintf(fp, "}\n");
+
+    bool ok = (ferror(fp) == 0);
+    fclose(fp);
+    return ok;
+}
+
+// Returns true if any thread has events that haven't been written.
+static bool HaveTraceEvents()
+{
+    std::lock_guard<std::mutex> lock(g_profilesLock);
+    for (ThreadProfile *profile : g_profiles)
+    {
+        std::lock_guard<std::mutex> traceLock(profile->m_traceLock);
+        if (!profile->m_events.empty() || profile->m_droppedEvents)
+            return true;
+    }
+    return false;
+}
+
+void WaveformTraceWrite()
+{
+    if (!g_traceEnabled || !HaveTraceEvents())
+        return;
+
+    uint64_t droppedEvents = 0;
+    if (!WriteTrace(g_traceFilename.c_str(), droppedEvents))
+    {
+        printf("Failed writing the trace to '%S'\n", g_traceFilename.c_str());
+        fflush(stdout);
+    }
+    else if (droppedEvents)
+    {
+        printf("The trace was too long; %llu events were left out of it.\n",
+            static_cast<unsigned long long>(droppedEvents));
+        fflush(stdout);
+    }
+}
+
+void WaveformTraceEnable(const wchar_t *filename)
+{
+    g_traceFilename = filename;
+    g_traceEnabled = true;
+    EnableScopes();
+    WaveformProfileNameThread("main");
+    ThreadPool::SetHooks(BeginPoolScope, EndPoolScope);
+}
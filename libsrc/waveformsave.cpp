@@ -42,14 +42,35 @@
 #include "waveformsave.h"
 #include "wavfile.h"
 #include "rawpcmfile.h"
-#include <string>
-#include <process.h>
-#include <io.h>
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
+#include "mp3encoder.h"
+#include "flacfile.h"
+#include "threadpool.h"
+#include "dspkernels.h"
+#include "waveformprofile.h"
+#include "platform.h"
+#include <math.h>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
 
 //#define TRACE
 
+// Bit rate for saved MP3 files, in kilobits per second per channel.
+static const unsigned kMP3BitRatePerChannel = 96;
+
+// The real standard output, once WaveformReserveStdout has moved
+// the program's own output to stderr.
+static FILE *g_audioStdout = nullptr;
+
+// Returns true if the filename is "-", which means standard output.
+static bool IsStandardStream(const wchar_t *filename)
+{
+    return filename[0] == '-' && filename[1] == '\0';
+}
+
 //
 // Converts a sample value from our internal floating-point
 // format to one of the supported output formats.
@@ -92,6 +113,20 @@ static bool ConvertFloatSample(const float *insample, void *outsample,
             *reinterpret_cast<uint16_t *>(outsample) = static_cast<uint16_t>(sample);
             return true;
         }
+        else if (bytesPerSample == 3)
+        {
+            float sample = (*insample) * static_cast<float>(0x7FFFFF);
+            if (sample < static_cast<float>(-0x7FFFFF))
+                sample = static_cast<float>(-0x7FFFFF);
+            if (sample > static_cast<float>(0x7FFFFF))
+                sample = static_cast<float>(0x7FFFFF);
+            uint32_t raw = static_cast<uint32_t>(lrintf(sample));
+            uint8_t *pout = reinterpret_cast<uint8_t *>(outsample);
+            pout[0] = static_cast<uint8_t>(raw);
+            pout[1] = static_cast<uint8_t>(raw >> 8);
+            pout[2] = static_cast<uint8_t>(raw >> 16);
+            return true;
+        }
         else if (bytesPerSample == 4)
         {
             float sample = (*insample) * static_cast<float>(0x7FFFFFFF);
@@ -108,8 +143,190 @@ static bool ConvertFloatSample(const float *insample, void *outsample,
     return false;
 }
 
+// State of the noise generator that dithers 24-bit samples: one
+// xorshift generator per SIMD lane.
+struct DitherState
+{
+    uint32_t m_seeds[4] = { 0x9E3779B9, 0x7F4A7C15, 0x85EBCA6B, 0xC2B2AE35 };
+};
+
+// Returns the next value from a scalar xorshift generator.
+static uint32_t NextDitherValue(uint32_t &seed)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+// Writes four 24-bit values to 12 bytes of packed little-endian
+// samples.
+static void Pack24BitSamples(const int32_t *values, uint8_t *poutsamples)
+{
+    uint32_t words[3];
+    words[0] = (static_cast<uint32_t>(values[0]) & 0xFFFFFF) | (static_cast<uint32_t>(values[1]) << 24);
+    words[1] = ((static_cast<uint32_t>(values[1]) >> 8) & 0xFFFF) | (static_cast<uint32_t>(values[2]) << 16);
+    words[2] = ((static_cast<uint32_t>(values[2]) >> 16) & 0xFF) | (static_cast<uint32_t>(values[3]) << 8);
+    memcpy(poutsamples, words, sizeof(words));
+}
+
+//
+// Converts a block of samples from our internal floating-point
+// format to packed 24-bit little-endian integers.  Samples that fall
+// between two 24-bit values get triangular (TPDF) dither of up to
+// one step either way before they're rounded, so the quantization
+// error is noise rather than distortion.  Samples that are already
+// exact 24-bit values (such as those loaded from a 24-bit file) are
+// written as they are, so unchanged audio round-trips bit for bit.
+// This is the usual format of studio deliverables, so it gets a
+// vectorized path to make it as quick to save as 16-bit audio.
+//
+static void ConvertFloatSamplesTo24Bit(const float *pinsamples, uint8_t *poutsamples, size_t count, DitherState &dither)
+{
+    const float scale = static_cast<float>(0x7FFFFF);
+    const float noiseScale = 1.0f / 65536.0f;
+    size_t i = 0;
+#ifdef USE_SSE2
+    const __m128 vscale = _mm_set1_ps(scale);
+    const __m128 vnoiseScale = _mm_set1_ps(noiseScale);
+    const __m128 vhighest = _mm_set1_ps(scale);
+    const __m128 vlowest = _mm_set1_ps(-scale);
+    const __m128i lowMask = _mm_set1_epi32(0xFFFF);
+    __m128i seeds = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dither.m_seeds));
+    for (; i + 4 <= count; i += 4)
+    {
+        seeds = _mm_xor_si128(seeds, _mm_slli_epi32(seeds, 13));
+        seeds = _mm_xor_si128(seeds, _mm_srli_epi32(seeds, 17));
+        seeds = _mm_xor_si128(seeds, _mm_slli_epi32(seeds, 5));
+
+        // The difference of the two 16-bit halves of each random
+        // value has a triangular distribution over (-1, 1).
+        __m128i noiseInt = _mm_sub_epi32(_mm_and_si128(seeds, lowMask), _mm_srli_epi32(seeds, 16));
+        __m128 noise = _mm_mul_ps(_mm_cvtepi32_ps(noiseInt), vnoiseScale);
+
+        __m128 sample = _mm_mul_ps(_mm_loadu_ps(pinsamples + i), vscale);
+        __m128i rounded = _mm_cvtps_epi32(sample);
+        __m128 exact = _mm_cmpeq_ps(sample, _mm_cvtepi32_ps(rounded));
+        sample = _mm_add_ps(sample, _mm_andnot_ps(exact, noise));
+        sample = _mm_min_ps(_mm_max_ps(sample, vlowest), vhighest);
+
+        int32_t values[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(values), _mm_cvtps_epi32(sample));
+        Pack24BitSamples(values, poutsamples + 3 * i);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dither.m_seeds), seeds);
+#endif
+
+    for (; i < count; i++)
+    {
+        float sample = pinsamples[i] * scale;
+        if (sample != static_cast<float>(lrintf(sample)))
+        {
+            uint32_t random = NextDitherValue(dither.m_seeds[0]);
+            sample += static_cast<float>(static_cast<int32_t>(random & 0xFFFF) - static_cast<int32_t>(random >> 16)) * noiseScale;
+        }
+        if (sample < -scale)
+            sample = -scale;
+        if (sample > scale)
+            sample = scale;
+        uint32_t raw = static_cast<uint32_t>(lrintf(sample));
+        poutsamples[3 * i] = static_cast<uint8_t>(raw);
+        poutsamples[3 * i + 1] = static_cast<uint8_t>(raw >> 8);
+        poutsamples[3 * i + 2] = static_cast<uint8_t>(raw >> 16);
+    }
+}
+
 //
-// Saves the Waveform's audio data to a Microsoft WAV audio file.
+// Converts a block of samples from our internal floating-point
+// format to one of the supported output formats.  Same as
+// ConvertFloatSample, except 24-bit integer samples are dithered.
+// Other than the dithered ones, whose noise comes from one running
+// generator, the samples are independent of each other, so a large
+// block is split into ranges that are converted on all of the
+// threads of the shared pool.
+//
+static bool ConvertFloatSamples(const float *pinsamples, uint8_t *poutsamples, size_t count,
+    bool isFloat, unsigned bytesPerSample, DitherState &dither)
+{
+    WaveformProfileScope profile("convert from float", count, count * (sizeof(float) + bytesPerSample));
+    if (!isFloat && bytesPerSample == 3)
+    {
+        ConvertFloatSamplesTo24Bit(pinsamples, poutsamples, count, dither);
+        return true;
+    }
+
+    // Every sample has the same format, so if the first converts,
+    // they all do.
+    if (count == 0)
+        return true;
+    if (!ConvertFloatSample(pinsamples, poutsamples, isFloat, bytesPerSample))
+        return false;
+
+    ThreadPool::GetShared().ParallelFor(count, sizeof(float) + bytesPerSample, [=](size_t first, size_t end) {
+        uint8_t *poutsample = poutsamples + first * bytesPerSample;
+        if (!isFloat && bytesPerSample == 2)
+        {
+            DSPKernelsGet().ConvertFloatToInt16(pinsamples + first, reinterpret_cast<int16_t *>(poutsample), end - first);
+            return;
+        }
+
+        for (size_t i = first; i < end; i++)
+        {
+            ConvertFloatSample(pinsamples + i, poutsample, isFloat, bytesPerSample);
+            poutsample += bytesPerSample;
+        }
+    });
+    return true;
+}
+
+// State passed to the block callback while saving a WAV file (or
+// a raw PCM file, whose samples are converted the same way).
+struct WAVSaveContext
+{
+    const float *m_input = nullptr;
+    bool m_isFloat = false;
+    unsigned m_bytesPerSample = 0;
+    DitherState m_dither;
+    size_t m_samplesDone = 0;
+    size_t m_totalSamples = 0;
+    WaveformProgress *m_progress = nullptr;
+};
+
+// Block callback for WAVFileWriteInBlocks (and
+// RawPCMFileWriteInBlocks) that fills a block with the next
+// samples of the Waveform being saved, converted to the
+// output format, and reports the progress to the status callback.
+static bool ConvertWAVSaveBlock(void *context, void *samples, size_t bytes)
+{
+    WAVSaveContext *ctx = reinterpret_cast<WAVSaveContext *>(context);
+    size_t count = bytes / ctx->m_bytesPerSample;
+    if (!ConvertFloatSamples(ctx->m_input, reinterpret_cast<uint8_t *>(samples), count,
+            ctx->m_isFloat, ctx->m_bytesPerSample, ctx->m_dither))
+    {
+        return false;
+    }
+    ctx->m_input += count;
+    ctx->m_samplesDone += count;
+
+    return ctx->m_progress->Update(ctx->m_samplesDone, ctx->m_totalSamples);
+}
+
+// Block callback for WAVFileWriteStream that fills as much of a
+// block as there are samples left to save.
+static bool ConvertWAVStreamBlock(void *context, void *samples, size_t bytes, size_t &filled)
+{
+    WAVSaveContext *ctx = reinterpret_cast<WAVSaveContext *>(context);
+    size_t count = bytes / ctx->m_bytesPerSample;
+    if (count > ctx->m_totalSamples - ctx->m_samplesDone)
+        count = ctx->m_totalSamples - ctx->m_samplesDone;
+
+    filled = count * ctx->m_bytesPerSample;
+    return count == 0 || ConvertWAVSaveBlock(context, samples, filled);
+}
+
+//
+// Saves the Waveform's audio data to a Microsoft WAV audio file,
+// or to standard output if the filename is "-".
 // Returns true if successful, false if error.
 //
 static bool WaveformSaveToWAV(
@@ -135,36 +352,36 @@ static bool WaveformSaveToWAV(
         useBytesPerSample = 4;
     }
 
-    // Convert the internal floating-point data to the data
-    // format the caller requested for the saved file.
+    // Write the WAV file about 64K sample frames at a time,
+    // converting the internal floating-point data to the data
+    // format the caller requested as each block is written, so
+    // the converted data is never all in memory.
     size_t numChannels = wav.GetNumChannels();
-    size_t numSamples = wav.GetNumSamples();
-    std::vector<uint8_t> data(numSamples * wav.GetNumChannels() * useBytesPerSample);
-    const float *insample = wav.GetSamplesPtr();
-    uint8_t *outsample = data.data();
-    for (size_t isample = 0; isample < numSamples; isample++)
-    {
-        for (size_t channel = 0; channel < numChannels; channel++)
-        {
-            if (!ConvertFloatSample(insample, outsample,
-                                    useFloat, useBytesPerSample))
-            {
-                return false;
-            }
-
-            insample++;
-            outsample += useBytesPerSample;
-        }
-    }
-
-    // Write the converted data to WAV file.
     WAVInfo info;
     info.m_rate = wav.GetRate();
     info.m_channels = static_cast<unsigned>(numChannels);
     info.m_bits = useBytesPerSample * 8;
     info.m_is_float = useFloat;
-    info.m_sample_count = static_cast<unsigned>(wav.GetNumSamples());
-    if (!WAVFileWrite(filename, info, data.data()))
+    info.m_sample_count = wav.GetNumSamples();
+    info.m_channel_mask = wav.GetChannelMask();
+
+    WaveformProgress progress(status_callback_context, status_callback_func);
+    WAVSaveContext ctx;
+    ctx.m_input = wav.GetSamplesPtr();
+    ctx.m_isFloat = useFloat;
+    ctx.m_bytesPerSample = useBytesPerSample;
+    ctx.m_totalSamples = wav.GetNumSamples() * numChannels;
+    ctx.m_progress = &progress;
+    size_t blockSize = numChannels * useBytesPerSample * 65536;
+    if (IsStandardStream(filename))
+    {
+        if (!WaveformReserveStdout() ||
+            !WAVFileWriteStream(g_audioStdout, info, blockSize, ConvertWAVStreamBlock, &ctx))
+        {
+            return false;
+        }
+    }
+    else if (!WAVFileWriteInBlocks(filename, info, blockSize, ConvertWAVSaveBlock, &ctx))
     {
         return false;
     }
@@ -199,37 +416,40 @@ static bool WaveformSaveToRawPCM(
     if (status_callback_func && !status_callback_func(status_callback_context, 0.0f))
         return false;
 
-    // Convert the internal floating-point data to the data
-    // format the caller requested for the saved file.
+    // Write the raw PCM file about 64K sample frames at a time,
+    // converting the internal floating-point data to the data
+    // format the caller requested as each block is written, the
+    // same way as for a WAV file.
     size_t numChannels = wav.GetNumChannels();
-    size_t numSamples = wav.GetNumSamples();
-    std::vector<uint8_t> data(numSamples * numChannels * useBytesPerSample);
-    const float *insample = wav.GetSamplesPtr();
-    uint8_t *outsample = data.data();
-    for (size_t isample = 0; isample < numSamples; isample++)
+    WaveformProgress progress(status_callback_context, status_callback_func);
+    WAVSaveContext ctx;
+    ctx.m_input = wav.GetSamplesPtr();
+    ctx.m_isFloat = useFloat;
+    ctx.m_bytesPerSample = useBytesPerSample;
+    ctx.m_totalSamples = wav.GetNumSamples() * numChannels;
+    ctx.m_progress = &progress;
+    size_t blockSize = numChannels * useBytesPerSample * 65536;
+    if (!RawPCMFileWriteInBlocks(filename, wav.GetNumSamples(),
+            static_cast<unsigned>(numChannels), useBytesPerSample,
+            blockSize, ConvertWAVSaveBlock, &ctx))
     {
-        for (size_t channel = 0; channel < numChannels; channel++)
-        {
-            if (!ConvertFloatSample(insample, outsample,
-                                    useFloat, useBytesPerSample))
-            {
 #ifdef TRACE
-                printf("ConvertFloatSample failed.\n");
+        printf("RawPCMFileWriteInBlocks failed.\n");
 #endif
-                return false;
-            }
-
-            insample++;
-            outsample += useBytesPerSample;
-        }
+        return false;
     }
 
-    if (!RawPCMFileWrite(filename, wav.GetNumSamples(),
-            static_cast<unsigned>(numChannels), useBytesPerSample,
-            data.data()))
+    // Describe the sample format in a .hdr file, so the raw file
+    // can be read back correctly.
+    RawPCMFormat format;
+    format.m_rate = wav.GetRate();
+    format.m_numChannels = static_cast<unsigned>(numChannels);
+    format.m_bytesPerSample = useBytesPerSample;
+    format.m_isFloat = useFloat;
+    if (!RawPCMFileWriteHeader(filename, format))
     {
 #ifdef TRACE
-        printf("RawPCMFileWrite failed.\n");
+        printf("RawPCMFileWriteHeader failed.\n");
 #endif
         return false;
     }
@@ -240,33 +460,6 @@ static bool WaveformSaveToRawPCM(
     return true;
 }
 
-// Checks if the ffmpeg.exe program exists in the directory
-// where our .exe lives.  Returns the full path if successful.
-// Returns an empty string otherwise.
-static std::wstring GetFfmpegPath()
-{
-    wchar_t exePath[MAX_PATH] = {0};
-    GetModuleFileNameW(nullptr, exePath, MAX_PATH);
-
-    wchar_t *slash = wcsrchr(exePath, '\\');
-    if (!slash)
-        slash = &exePath[0];
-    else
-        slash++;
-    *slash = '\0';
-
-    wcscat_s(exePath, MAX_PATH, L"ffmpeg.exe");
-
-    // Check if the file exists.
-    DWORD attrib = GetFileAttributesW(exePath);
-    if (attrib == INVALID_FILE_ATTRIBUTES)
-        return L"";
-    if (attrib & FILE_ATTRIBUTE_DIRECTORY)
-        return L"";
-
-    return exePath;
-}
-
 //
 // Saves the Waveform's audio data to an MP3 audio file.
 // Returns true if successful, false if error.
@@ -286,96 +479,67 @@ static bool WaveformSaveToMP3(
     if (status_callback_func && !status_callback_func(status_callback_context, 0.0f))
         return false;
 
-    //
-    // We can't save directly to MP3 format.
-    // We have to save to WAV format and then use an external
-    // program (ffmpeg) to convert the WAV file to an MP3 file.
-    //
-
-    // See if ffmpeg is here.
-    std::wstring exePath = GetFfmpegPath();
-    if (exePath.empty())
+    // MPEG-1 Layer III only allows a few sample rates and up to
+    // two channels, so anything else is converted on a copy first.
+    const Waveform *source = &wav;
+    Waveform converted;
+    unsigned rate = MP3EncoderRate(wav.GetRate());
+    if (rate != wav.GetRate() || wav.GetNumChannels() > 2)
     {
-#ifdef TRACE
-        printf("Ffmpeg.exe was not found with wavetool binaries.\n");
-        printf("Unable to save to MP3 file format!\n");
-#endif
-        return false;
+        converted = wav;
+        if (converted.GetNumChannels() > 2 && !converted.ConvertToMono())
+            return false;
+        if (rate != converted.GetRate() && !converted.Resample(rate))
+            return false;
+        source = &converted;
     }
 
-    // Save the waveform to a temporary WAV file.
-    std::wstring tmpFilename = filename;
-    tmpFilename += L".wav";
-    if (!WaveformSaveToWAV(tmpFilename.c_str(), wav,
-            status_callback_context, status_callback_func,
-            false, 2))
+    WaveformProfileScope profile("encode mp3", source->GetNumSamples() * source->GetNumChannels(), source->GetTotalBytes());
+    unsigned channels = static_cast<unsigned>(source->GetNumChannels());
+    if (!MP3FileWrite(filename, source->GetSamplesPtr(), source->GetNumSamples(),
+            channels, rate, kMP3BitRatePerChannel * channels,
+            status_callback_context, status_callback_func))
     {
 #ifdef TRACE
-        printf("Failed saving temporary file '%S'\n", tmpFilename.c_str());
-        fflush(stdout);
+        printf("MP3FileWrite failed.\n");
 #endif
         return false;
     }
 
-    if (status_callback_func && !status_callback_func(status_callback_context, 0.3f))
-        return false;
+    return true;
+}
 
-    // Build an argument list for running ffmpeg to convert the
-    // temporary WAV file to an MP3 file.
-    std::vector<const wchar_t *> args;
-    const wchar_t *arg_dash_i = L"-i";
-    const wchar_t *arg_acodec = L"-acodec";
-    const wchar_t *arg_mp3    = L"mp3";
-    args.push_back(exePath.c_str());
-    args.push_back(arg_dash_i);
-    args.push_back(tmpFilename.c_str());
-    args.push_back(arg_acodec);
-    args.push_back(arg_mp3);
-    args.push_back(filename);
-    args.push_back(nullptr);
-
-	// Temporarily redirect stdout and stderr, so ffmpeg's console
-    // output doesn't spew all over the terminal.
-	FILE *tmp_stream1 = nullptr;
-	FILE *tmp_stream2 = nullptr;
-	int stream1 = _dup(_fileno(stdout));
-	_wfreopen_s(&tmp_stream1, L"NUL:", L"a+", stdout);
-	int stream2 = _dup(_fileno(stderr));
-	_wfreopen_s(&tmp_stream2, L"NUL:", L"a+", stderr);
-
-    // Run the external ffmpeg program.
-    intptr_t result = _wspawnvp(_P_WAIT, args[0], &args[0]);
+//
+// Saves the Waveform's audio data to a FLAC audio file, with
+// 'useBytesPerSample' bytes per sample.  FLAC only stores
+// integers, so floating-point audio is saved as 24-bit.
+// Returns true if successful, false if error.
+//
+static bool WaveformSaveToFLAC(
+        const wchar_t *filename,
+        const Waveform &wav,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion),
+        bool useFloat,
+        unsigned useBytesPerSample
+        )
+{
 #ifdef TRACE
-    int temp_errno = errno;
+    printf("WaveformSaveToFLAC '%S'\n", filename);
+    fflush(stdout);
 #endif
 
-	// Restore the normal behavior of stdout and stderr.
-	_dup2(stream2, _fileno(stderr));
-	_close(stream2);
-	_dup2(stream1, _fileno(stdout));
-	_close(stream1);
-
-    _wunlink(tmpFilename.c_str());
-
-    if (result == -1)
+    WaveformProfileScope profile("encode flac", wav.GetNumSamples() * wav.GetNumChannels(), wav.GetTotalBytes());
+    unsigned bits = useFloat ? 24 : useBytesPerSample * 8;
+    if (!FLACFileWrite(filename, wav.GetSamplesPtr(), wav.GetNumSamples(),
+            static_cast<unsigned>(wav.GetNumChannels()), wav.GetRate(), bits,
+            status_callback_context, status_callback_func))
     {
-        // Failed to launch ffmpeg.
 #ifdef TRACE
-        printf("Failed spawning ffmpeg.  [errno:%d]\n", temp_errno);
+        printf("FLACFileWrite failed.\n");
 #endif
         return false;
     }
-    else if (result != 0)
-    {
-        // Ffmpeg reported an error.
-#ifdef TRACE
-        printf("External ffmpeg process reported error.  [exit:%Id]\n", result);
-#endif
-        return false;
-    }
-
-    if (status_callback_func && !status_callback_func(status_callback_context, 1.0f))
-        return false;
 
     return true;
 }
@@ -417,8 +581,12 @@ bool WaveformSaveToFile(
     fflush(stdout);
 #endif
 
+    WaveformProfileScope profile("save", wav.GetNumSamples() * wav.GetNumChannels(), wav.GetTotalBytes());
+    profile.SetDetail(filename);
+
+    // Standard output is always written in WAV format.
     const wchar_t *extension = wcsrchr(filename, '.');
-    if (_wcsicmp(extension, L".wav") == 0)
+    if (IsStandardStream(filename) || _wcsicmp(extension, L".wav") == 0)
     {
         return WaveformSaveToWAV(filename, wav,
                     status_callback_context, status_callback_func,
@@ -429,6 +597,12 @@ bool WaveformSaveToFile(
         return WaveformSaveToMP3(filename, wav,
                     status_callback_context, status_callback_func);
     }
+    else if (_wcsicmp(extension, L".flac") == 0)
+    {
+        return WaveformSaveToFLAC(filename, wav,
+                    status_callback_context, status_callback_func,
+                    useFloat, useBytesPerSample);
+    }
     else if (_wcsicmp(extension, L".raw") == 0 ||
              _wcsicmp(extension, L".pcm") == 0)
     {
@@ -444,3 +618,216 @@ bool WaveformSaveToFile(
     return false;
 }
 
+// State passed to the block callbacks while saving audio that's
+// produced a block at a time.
+struct BlockSaveContext
+{
+    bool (*m_blockFunc)(void *context, float *samples, size_t maxFrames, size_t &numFrames) = nullptr;
+    void *m_blockContext = nullptr;
+    size_t m_numChannels = 0;
+    size_t m_framesLeft = 0;        // Frames the audio is still expected to have.
+    bool m_ended = false;           // True once the block callback has run out of audio.
+    WaveformBuffer<float> m_floats; // Samples gathered for one block of the file.
+    WAVSaveContext m_save;
+};
+
+// Fills 'samples' with up to 'maxFrames' frames from the block
+// callback, calling it as many times as it takes.  'numFrames' is
+// set to the number of frames filled, which is less than 'maxFrames'
+// only at the end of the audio.  Returns false if the callback
+// fails, or produces more audio than expected.
+static bool GatherSaveBlocks(BlockSaveContext *ctx, float *samples, size_t maxFrames, size_t &numFrames)
+{
+    numFrames = 0;
+    while (numFrames < maxFrames && !ctx->m_ended)
+    {
+        size_t filled = 0;
+        if (!ctx->m_blockFunc(ctx->m_blockContext, samples + numFrames * ctx->m_numChannels,
+                maxFrames - numFrames, filled))
+        {
+            return false;
+        }
+        if (filled == 0)
+            ctx->m_ended = true;
+        numFrames += filled;
+    }
+
+    if (numFrames > ctx->m_framesLeft)
+        return false;
+    ctx->m_framesLeft -= numFrames;
+    return true;
+}
+
+// Block callback for WAVFileWriteInBlocks that gathers the next
+// block of audio from the caller's block callback, pads it with
+// silence if the audio has ended, and converts it to the output
+// format.
+static bool ConvertGatheredSaveBlock(void *context, void *samples, size_t bytes)
+{
+    BlockSaveContext *ctx = reinterpret_cast<BlockSaveContext *>(context);
+    size_t count = bytes / ctx->m_save.m_bytesPerSample;
+    size_t numFrames = 0;
+    if (!GatherSaveBlocks(ctx, ctx->m_floats.data(), count / ctx->m_numChannels, numFrames))
+        return false;
+    std::fill(ctx->m_floats.begin() + numFrames * ctx->m_numChannels, ctx->m_floats.begin() + count, 0.0f);
+
+    ctx->m_save.m_input = ctx->m_floats.data();
+    return ConvertWAVSaveBlock(&ctx->m_save, samples, bytes);
+}
+
+// Block callback for WAVFileWriteStream that gathers and converts as
+// much of a block as the caller's block callback has audio for.
+static bool ConvertGatheredStreamBlock(void *context, void *samples, size_t bytes, size_t &filled)
+{
+    BlockSaveContext *ctx = reinterpret_cast<BlockSaveContext *>(context);
+    size_t count = bytes / ctx->m_save.m_bytesPerSample;
+    size_t numFrames = 0;
+    if (!GatherSaveBlocks(ctx, ctx->m_floats.data(), count / ctx->m_numChannels, numFrames))
+        return false;
+
+    filled = numFrames * ctx->m_numChannels * ctx->m_save.m_bytesPerSample;
+    ctx->m_save.m_input = ctx->m_floats.data();
+    return filled == 0 || ConvertWAVSaveBlock(&ctx->m_save, samples, filled);
+}
+
+//
+// Writes audio that's produced a block at a time to an audio file.
+// See the header for details.
+//
+bool WaveformSaveInBlocks(
+        const wchar_t *filename,
+        unsigned rate,
+        size_t numChannels,
+        size_t numSamples,
+        bool (*block_func)(void *context, float *samples, size_t maxFrames, size_t &numFrames),
+        void *block_context,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion),
+        bool useFloat,
+        unsigned useBytesPerSample,
+        uint32_t channelMask
+        )
+{
+#ifdef TRACE
+    printf("WaveformSaveInBlocks '%S', %u Hz, %zu samples\n", filename, rate, numSamples);
+    fflush(stdout);
+#endif
+
+    if (numChannels < 1 || !block_func)
+        return false;
+
+    WaveformProfileScope profile("save", numSamples * numChannels, numSamples * numChannels * sizeof(float));
+    profile.SetDetail(filename);
+    BlockSaveContext ctx;
+    ctx.m_blockFunc = block_func;
+    ctx.m_blockContext = block_context;
+    ctx.m_numChannels = numChannels;
+    ctx.m_framesLeft = numSamples;
+
+    // Anything but WAV is gathered into a Waveform and saved whole.
+    const wchar_t *extension = wcsrchr(filename, '.');
+    if (!IsStandardStream(filename) && (!extension || _wcsicmp(extension, L".wav") != 0))
+    {
+        Waveform wav;
+        wav.SetRate(rate);
+        size_t numFrames = 0;
+        if (!wav.Populate(numSamples, numChannels) ||
+            !GatherSaveBlocks(&ctx, wav.GetSamplesPtr(), numSamples, numFrames))
+        {
+            return false;
+        }
+        wav.SetChannelMask(channelMask);
+
+        // Make sure the audio doesn't run past the expected length.
+        std::vector<float> extra(numChannels);
+        if (!GatherSaveBlocks(&ctx, extra.data(), 1, numFrames))
+            return false;
+
+        return WaveformSaveToFile(filename, wav,
+                    status_callback_context, status_callback_func,
+                    useFloat, useBytesPerSample);
+    }
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.0f))
+        return false;
+
+    if (useFloat && useBytesPerSample == 8)
+    {
+        // WAV doesn't support doubles, so we'll write floats instead.
+        useBytesPerSample = 4;
+    }
+
+    // Write the WAV file the same way as WaveformSaveToWAV does,
+    // gathering each block of samples from the block callback.
+    WAVInfo info;
+    info.m_rate = rate;
+    info.m_channels = static_cast<unsigned>(numChannels);
+    info.m_bits = useBytesPerSample * 8;
+    info.m_is_float = useFloat;
+    info.m_sample_count = numSamples;
+    info.m_channel_mask = channelMask;
+
+    ctx.m_save.m_isFloat = useFloat;
+    ctx.m_save.m_bytesPerSample = useBytesPerSample;
+    ctx.m_save.m_totalSamples = numSamples * numChannels;
+    WaveformProgress progress(status_callback_context, status_callback_func);
+    ctx.m_save.m_progress = &progress;
+    ctx.m_floats.resize(numChannels * 65536);
+    size_t blockSize = numChannels * useBytesPerSample * 65536;
+    if (IsStandardStream(filename))
+    {
+        if (!WaveformReserveStdout() ||
+            !WAVFileWriteStream(g_audioStdout, info, blockSize, ConvertGatheredStreamBlock, &ctx))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        // Make sure the audio doesn't run past the expected length.
+        size_t numFrames = 0;
+        if (!WAVFileWriteInBlocks(filename, info, blockSize, ConvertGatheredSaveBlock, &ctx) ||
+            !GatherSaveBlocks(&ctx, ctx.m_floats.data(), 65536, numFrames))
+        {
+            return false;
+        }
+    }
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 1.0f))
+        return false;
+
+    return true;
+}
+
+//
+// Sets aside standard output for audio saved to "-", sending
+// anything the program prints to stdout to stderr instead.  See
+// the header for details.
+//
+bool WaveformReserveStdout()
+{
+    if (g_audioStdout)
+        return true;
+
+    // Keep a handle to the real standard output, then point the
+    // stdout handle at stderr.
+    fflush(stdout);
+    int fd = _dup(_fileno(stdout));
+    if (fd < 0)
+        return false;
+    _setmode(fd, _O_BINARY);
+    g_audioStdout = _fdopen(fd, "wb");
+    if (!g_audioStdout)
+    {
+        _close(fd);
+        return false;
+    }
+    if (_dup2(_fileno(stderr), _fileno(stdout)) < 0)
+    {
+        fclose(g_audioStdout);
+        g_audioStdout = nullptr;
+        return false;
+    }
+
+    return true;
+}
@@ -43,6 +43,8 @@
 #pragma once
 #include <vector>
 #include <cmath>
+#include "segmentedfilter.h"
+#include "denormals.h"
 
 // Class to help apply bandpass filtering to an audio waveform.
 // Uses a simple biquad algorithm.
@@ -56,13 +58,13 @@ public:
     {
         // Calculate coefficients for bandpass.
         float omega = 2.0f * pi * centerFreq / sampleRate;
-        float alpha = std::sinf(omega) / (2.0f * Q);
+        float alpha = std::sin(omega) / (2.0f * Q);
 
         m_b0 = alpha;
         m_b1 = 0.0f;
         m_b2 = -alpha;
         m_a0 = 1.0f + alpha;
-        m_a1 = -2.0f * std::cosf(omega);
+        m_a1 = -2.0f * std::cos(omega);
         m_a2 = 1.0f - alpha;
 
         // Normalize coefficients.
@@ -82,13 +84,39 @@ public:
                        m_a2 * m_z2;
 
         m_z2 = m_z1;
-        m_z1 = output;
+        m_z1 = FlushDenormal(output);
 
         return output;
     }
 
+    // Applies the filter to 'count' samples from 'in', writing them
+    // to 'out', which may be the same as 'in'.  The history holds
+    // outputs, which feed back into the next sample, so this isn't a
+    // job for the biquad kernel.
+    void FilterSamples(const float *in, float *out, size_t count)
+    {
+        for (size_t index = 0; index < count; index++)
+            out[index] = FilterSample(in[index]);
+    }
+
+    // Clears the filter's history, as if no samples had been filtered.
+    void Reset()
+    {
+        m_z1 = 0.0f;
+        m_z2 = 0.0f;
+    }
+
+    // Returns the number of samples it takes for a change in the
+    // filter's history to die away to within 'tolerance'.  Since
+    // the history holds previous outputs only, both the 'a' and 'b'
+    // coefficients apply to it.
+    size_t GetSettlingSamples(float tolerance) const
+    {
+        return BiquadSettlingSamples(m_a1 - m_b1, m_a2 - m_b2, tolerance);
+    }
+
 private:
-    const float pi = 3.1415927f;
+    static constexpr float pi = 3.1415927f;
     float  m_a0, m_a1, m_a2, m_b0, m_b1, m_b2; // Filter coefficients.
     float  m_z1, m_z2;                         // Previous outputs.
 };
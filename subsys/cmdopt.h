@@ -87,6 +87,26 @@ bool OptionNameIs(const T *szArg, const T *szName)
    return true;
 }
 
+//--------------------------------------------------------------------
+// IsOption:
+// Checks if the given command line argument is an option switch,
+// that is, a '-' followed by a letter or a '?'.  A lone "-" (which
+// stands for standard input or output) isn't one, and neither is a
+// negative number.
+//
+// The template is intended to work for both "char" and "wchar_t"
+// character types.
+//--------------------------------------------------------------------
+template<class T>
+bool IsOption(const T *szArg)
+{
+   if (szArg == nullptr || szArg[0] != '-')
+      return false;
+
+   T c = szArg[1];
+   return isalpha(c) || c == '?';
+}
+
 //--------------------------------------------------------------------
 // OptionValue:
 // Retrieves a pointer to the value portion of the given command
@@ -103,7 +123,7 @@ bool OptionNameIs(const T *szArg, const T *szName)
 template<class T>
 const T * OptionValue(const T *szArg)
 {
-   static T *p = L"";
+   static const T p[1] = { 0 };
 
    if (szArg == nullptr)
       return p;
@@ -0,0 +1,127 @@
+//-------------------------------------------------------------------
+//
+// denormals.h
+//
+// C++ helpers that keep filters and effect tails from slowing down
+// on denormal (very tiny) floating-point numbers.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#pragma once
+#include <stdint.h>
+
+//
+// When a filter's input goes silent, its history decays toward zero
+// and, after a while, into the denormal range below about 1e-38.
+// Most processors handle denormals in microcode, as much as a
+// hundred times slower than other numbers, so a long silent tail
+// can take far longer to filter than the music before it.  Values
+// that small are far below anything audible, so they can just as
+// well be zero.
+//
+// x86 (with SSE2) and ARM64 processors can be told to flush
+// denormal results to zero, and on x86 to treat denormal inputs as
+// zero, which ScopedDenormalsOff does for the thread it's created
+// on.  Elsewhere the filters run their history through
+// FlushDenormal instead.
+//
+#if defined(_M_X64) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define DENORMALS_FLUSHED_BY_HARDWARE 1
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define DENORMALS_FLUSHED_BY_HARDWARE 1
+#else
+#define DENORMALS_FLUSHED_BY_HARDWARE 0
+#endif
+
+// Turns denormals off for the calling thread while it exists, and
+// puts back the thread's previous setting when it's destroyed.
+// Every loop that processes samples creates one; the cost is a
+// couple of instructions, so one per block of samples is plenty.
+class ScopedDenormalsOff
+{
+public:
+#if defined(_M_X64) || defined(__SSE2__)
+    // The MXCSR flush-to-zero (bit 15) and denormals-are-zero (bit 6)
+    // flags.
+    ScopedDenormalsOff() : m_saved(_mm_getcsr()) { _mm_setcsr(m_saved | 0x8040); }
+    ~ScopedDenormalsOff() { _mm_setcsr(m_saved); }
+#elif DENORMALS_FLUSHED_BY_HARDWARE
+    // The FPCR flush-to-zero flag (bit 24).
+    ScopedDenormalsOff() : m_saved(GetFPCR()) { SetFPCR(m_saved | (1ull << 24)); }
+    ~ScopedDenormalsOff() { SetFPCR(m_saved); }
+#else
+    ScopedDenormalsOff() {}
+    ~ScopedDenormalsOff() {}
+#endif
+
+    ScopedDenormalsOff(const ScopedDenormalsOff &) = delete;
+    ScopedDenormalsOff &operator=(const ScopedDenormalsOff &) = delete;
+
+private:
+#if defined(_M_X64) || defined(__SSE2__)
+    unsigned int m_saved;
+#elif DENORMALS_FLUSHED_BY_HARDWARE
+    static uint64_t GetFPCR()
+    {
+        uint64_t fpcr;
+        __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+        return fpcr;
+    }
+    static void SetFPCR(uint64_t fpcr)
+    {
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr));
+    }
+
+    uint64_t m_saved;
+#endif
+};
+
+// Returns the given value from a filter's history, or zero if it's
+// tiny enough to become denormal soon, on processors where
+// ScopedDenormalsOff can't do it.  Adding and taking away a small
+// offset rounds anything under about 1e-25 to zero, and changes
+// larger values by no more than that.
+inline float FlushDenormal(float value)
+{
+#if DENORMALS_FLUSHED_BY_HARDWARE
+    return value;
+#else
+    const float offset = 1e-18f;
+    return (value + offset) - offset;
+#endif
+}
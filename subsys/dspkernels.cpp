@@ -0,0 +1,1034 @@
+//-------------------------------------------------------------------
+//
+// dspkernels.cpp
+//
+// C++ module providing the inner loops that process blocks of
+// samples, in a version for each set of vector instructions a
+// processor may have.
+//
+// See dspkernels.h for additional comments.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#include "dspkernels.h"
+#include "denormals.h"
+#include "platform.h"
+#include <string.h>
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define DSP_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// The AVX kernels are only run on processors that have AVX, so
+// there's no need for the whole program to be built for it.
+#pragma warning(disable:4752)
+#endif
+#endif
+
+#if defined(_M_ARM64) || defined(__aarch64__)
+#define DSP_NEON
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang only let a function use instructions beyond the ones
+// the whole program was built for if it's marked with them.  (MSVC
+// lets any function use any of them.)  FMA is deliberately left out,
+// since fusing a multiply and add would change the rounding.
+#if defined(DSP_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+// The number of samples a biquad filter works on at a time.
+static const size_t kBiquadChunk = 256;
+
+//--------------------------------------------------
+// Scalar kernels.  The vector kernels use the same
+// helpers for the samples left over at the end of a
+// block, so the results match exactly.
+//--------------------------------------------------
+
+static inline float Int16ToFloat(int16_t sample)
+{
+    return static_cast<float>(sample) / static_cast<float>(0x7FFF);
+}
+
+static inline float Int24ToFloat(const uint8_t *psample)
+{
+    uint32_t raw = static_cast<uint32_t>(psample[0]) << 8 |
+        static_cast<uint32_t>(psample[1]) << 16 |
+        static_cast<uint32_t>(psample[2]) << 24;
+    return static_cast<float>(static_cast<int32_t>(raw) >> 8) / static_cast<float>(0x7FFFFF);
+}
+
+static inline int16_t FloatToInt16(float sample)
+{
+    float scaled = sample * 32767.0f;
+    if (scaled < -32767.0f)
+        scaled = -32767.0f;
+    if (scaled > 32767.0f)
+        scaled = 32767.0f;
+    return static_cast<int16_t>(scaled);
+}
+
+static inline float ClipSample(float sample, float lowest, float highest)
+{
+    if (sample < lowest)
+        return lowest;
+    if (sample > highest)
+        return highest;
+    return sample;
+}
+
+static inline float FIRSample(const float *in, size_t i, const float *taps, size_t numTaps)
+{
+    const float *x = in + i;
+    float sum = taps[0] * x[0];
+    for (size_t k = 1; k < numTaps; k++)
+        sum += taps[k] * *(x - k);
+    return sum;
+}
+
+static void ScalarConvertInt16ToFloat(const int16_t *in, float *out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = Int16ToFloat(in[i]);
+}
+
+static void ScalarConvert24BitToFloat(const uint8_t *in, float *out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = Int24ToFloat(in + 3 * i);
+}
+
+static void ScalarConvertFloatToInt16(const float *in, int16_t *out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = FloatToInt16(in[i]);
+}
+
+static void ScalarGain(const float *in, float *out, size_t count, float gain)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = in[i] * gain;
+}
+
+static void ScalarGainClip(const float *in, float *out, size_t count, float gain, float lowest, float highest)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = ClipSample(in[i] * gain, lowest, highest);
+}
+
+static void ScalarMinMax(const float *in, size_t count, float &lowest, float &highest)
+{
+    float lo = lowest, hi = highest;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (in[i] < lo)
+            lo = in[i];
+        if (in[i] > hi)
+            hi = in[i];
+    }
+    lowest = lo;
+    highest = hi;
+}
+
+// Widens the range 'lowest' to 'highest' to include the lanes of a
+// vector kernel's running minimums and maximums.  A lane that only
+// saw NaN still holds the range it started with, so the minimums
+// mustn't be counted as maximums or the other way around.
+static void ReduceMinMax(const float *lo, const float *hi, size_t lanes, float &lowest, float &highest)
+{
+    for (size_t k = 0; k < lanes; k++)
+    {
+        if (lo[k] < lowest)
+            lowest = lo[k];
+        if (hi[k] > highest)
+            highest = hi[k];
+    }
+}
+
+static void ScalarMixAdd(const float *in, float *out, size_t count, float gain)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] += in[i] * gain;
+}
+
+static void ScalarFIR(const float *in, float *out, size_t count, const float *taps, size_t numTaps)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = FIRSample(in, i, taps, numTaps);
+}
+
+static void ScalarBiquad(BiquadState &state, const float *in, float *out, size_t count)
+{
+    float x1 = state.m_x1, x2 = state.m_x2;
+    float y1 = state.m_y1, y2 = state.m_y2;
+    for (size_t i = 0; i < count; i++)
+    {
+        float x = in[i];
+        float y = state.m_b0 * x + state.m_b1 * x1 + state.m_b2 * x2 - state.m_a1 * y1 - state.m_a2 * y2;
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = FlushDenormal(y);
+        out[i] = y;
+    }
+    state.m_x1 = x1;
+    state.m_x2 = x2;
+    state.m_y1 = y1;
+    state.m_y2 = y2;
+}
+
+// Runs a biquad filter using the given FIR kernel for the half of
+// it that only depends on the input, leaving just the feedback from
+// the previous outputs to be done one sample at a time.  The sums
+// are done in the same order as ScalarBiquad.
+template <void (*FIRKernel)(const float *, float *, size_t, const float *, size_t)>
+static void BiquadUsingFIR(BiquadState &state, const float *in, float *out, size_t count)
+{
+    const float taps[3] = { state.m_b0, state.m_b1, state.m_b2 };
+    float forward[kBiquadChunk];
+    while (count > 0)
+    {
+        const size_t n = (count < kBiquadChunk) ? count : kBiquadChunk;
+
+        // The first two samples need the inputs from before this
+        // chunk, which come from the history.
+        forward[0] = state.m_b0 * in[0] + state.m_b1 * state.m_x1 + state.m_b2 * state.m_x2;
+        if (n > 1)
+            forward[1] = state.m_b0 * in[1] + state.m_b1 * in[0] + state.m_b2 * state.m_x1;
+        if (n > 2)
+            FIRKernel(in + 2, forward + 2, n - 2, taps, 3);
+
+        // Save the input history before writing the output, which may
+        // be the same buffer.
+        state.m_x2 = (n > 1) ? in[n - 2] : state.m_x1;
+        state.m_x1 = in[n - 1];
+
+        float y1 = state.m_y1, y2 = state.m_y2;
+        for (size_t i = 0; i < n; i++)
+        {
+            float y = forward[i] - state.m_a1 * y1 - state.m_a2 * y2;
+            y2 = y1;
+            y1 = FlushDenormal(y);
+            out[i] = y;
+        }
+        state.m_y1 = y1;
+        state.m_y2 = y2;
+
+        in += n;
+        out += n;
+        count -= n;
+    }
+}
+
+static const DSPKernels kScalarKernels =
+{
+    DSPInstructionSet::Scalar, "scalar",
+    ScalarConvertInt16ToFloat,
+    ScalarConvert24BitToFloat,
+    ScalarConvertFloatToInt16,
+    ScalarGain,
+    ScalarGainClip,
+    ScalarMinMax,
+    ScalarMixAdd,
+    ScalarFIR,
+    ScalarBiquad
+};
+
+#ifdef DSP_X86
+
+//--------------------------------------------------
+// SSE2 kernels.  The min and max instructions
+// return their second operand when either is NaN,
+// so the operands are ordered to do the same as the
+// comparisons in the scalar kernels.
+//--------------------------------------------------
+
+static TARGET_SSE2 void SSE2ConvertInt16ToFloat(const int16_t *in, float *out, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(static_cast<float>(0x7FFF));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        // Unpacking a sample with itself puts a copy in the high half
+        // of each 32 bits, and the shift brings it down with its sign.
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(out + i, _mm_div_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_div_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    for (; i < count; i++)
+        out[i] = Int16ToFloat(in[i]);
+}
+
+static TARGET_SSE2 void SSE2Convert24BitToFloat(const uint8_t *in, float *out, size_t count)
+{
+    // Load each sample as the 32 bits starting at its first byte,
+    // then shift it up and back down to drop the following sample's
+    // low byte and extend the sign.  The last sample is left to the
+    // scalar loop so we never read past the end of the block.
+    const __m128 scale = _mm_set1_ps(static_cast<float>(0x7FFFFF));
+    size_t i = 0;
+    for (; i + 5 <= count; i += 4)
+    {
+        uint32_t raw[4];
+        memcpy(&raw[0], in + 3 * i, 4);
+        memcpy(&raw[1], in + 3 * i + 3, 4);
+        memcpy(&raw[2], in + 3 * i + 6, 4);
+        memcpy(&raw[3], in + 3 * i + 9, 4);
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(raw));
+        v = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+        _mm_storeu_ps(out + i, _mm_div_ps(_mm_cvtepi32_ps(v), scale));
+    }
+    for (; i < count; i++)
+        out[i] = Int24ToFloat(in + 3 * i);
+}
+
+static TARGET_SSE2 void SSE2ConvertFloatToInt16(const float *in, int16_t *out, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(32767.0f);
+    const __m128 lowest = _mm_set1_ps(-32767.0f);
+    const __m128 highest = _mm_set1_ps(32767.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(in + i), scale);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(in + i + 4), scale);
+        a = _mm_min_ps(highest, _mm_max_ps(lowest, a));
+        b = _mm_min_ps(highest, _mm_max_ps(lowest, b));
+        __m128i packed = _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), packed);
+    }
+    for (; i < count; i++)
+        out[i] = FloatToInt16(in[i]);
+}
+
+static TARGET_SSE2 void SSE2Gain(const float *in, float *out, size_t count, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(in + i), g));
+    for (; i < count; i++)
+        out[i] = in[i] * gain;
+}
+
+static TARGET_SSE2 void SSE2GainClip(const float *in, float *out, size_t count, float gain, float lowest, float highest)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 lo = _mm_set1_ps(lowest);
+    const __m128 hi = _mm_set1_ps(highest);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(in + i), g);
+        _mm_storeu_ps(out + i, _mm_min_ps(hi, _mm_max_ps(lo, v)));
+    }
+    for (; i < count; i++)
+        out[i] = ClipSample(in[i] * gain, lowest, highest);
+}
+
+static TARGET_SSE2 void SSE2MinMax(const float *in, size_t count, float &lowest, float &highest)
+{
+    size_t i = 0;
+    if (count >= 8)
+    {
+        // Keep two sets of running min/max vectors to hide the
+        // latency of the min/max instructions.
+        __m128 lo0 = _mm_set1_ps(lowest), lo1 = lo0;
+        __m128 hi0 = _mm_set1_ps(highest), hi1 = hi0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128 a = _mm_loadu_ps(in + i);
+            __m128 b = _mm_loadu_ps(in + i + 4);
+            lo0 = _mm_min_ps(a, lo0);
+            lo1 = _mm_min_ps(b, lo1);
+            hi0 = _mm_max_ps(a, hi0);
+            hi1 = _mm_max_ps(b, hi1);
+        }
+
+        float lo[8], hi[8];
+        _mm_storeu_ps(lo, lo0);
+        _mm_storeu_ps(lo + 4, lo1);
+        _mm_storeu_ps(hi, hi0);
+        _mm_storeu_ps(hi + 4, hi1);
+        ReduceMinMax(lo, hi, 8, lowest, highest);
+    }
+    ScalarMinMax(in + i, count - i, lowest, highest);
+}
+
+static TARGET_SSE2 void SSE2MixAdd(const float *in, float *out, size_t count, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 v = _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), g));
+        _mm_storeu_ps(out + i, v);
+    }
+    for (; i < count; i++)
+        out[i] += in[i] * gain;
+}
+
+static TARGET_SSE2 void SSE2FIR(const float *in, float *out, size_t count, const float *taps, size_t numTaps)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const float *x = in + i;
+        __m128 sum = _mm_mul_ps(_mm_set1_ps(taps[0]), _mm_loadu_ps(x));
+        for (size_t k = 1; k < numTaps; k++)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(taps[k]), _mm_loadu_ps(x - k)));
+        _mm_storeu_ps(out + i, sum);
+    }
+    for (; i < count; i++)
+        out[i] = FIRSample(in, i, taps, numTaps);
+}
+
+static const DSPKernels kSSE2Kernels =
+{
+    DSPInstructionSet::SSE2, "sse2",
+    SSE2ConvertInt16ToFloat,
+    SSE2Convert24BitToFloat,
+    SSE2ConvertFloatToInt16,
+    SSE2Gain,
+    SSE2GainClip,
+    SSE2MinMax,
+    SSE2MixAdd,
+    SSE2FIR,
+    BiquadUsingFIR<SSE2FIR>
+};
+
+//--------------------------------------------------
+// AVX2 kernels.
+//--------------------------------------------------
+
+static TARGET_AVX2 void AVX2ConvertInt16ToFloat(const int16_t *in, float *out, size_t count)
+{
+    const __m256 scale = _mm256_set1_ps(static_cast<float>(0x7FFF));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i a = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)));
+        __m256i b = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 8)));
+        _mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_cvtepi32_ps(a), scale));
+        _mm256_storeu_ps(out + i + 8, _mm256_div_ps(_mm256_cvtepi32_ps(b), scale));
+    }
+    for (; i < count; i++)
+        out[i] = Int16ToFloat(in[i]);
+}
+
+static TARGET_AVX2 void AVX2Convert24BitToFloat(const uint8_t *in, float *out, size_t count)
+{
+    // Each half gets the 12 bytes of four samples (loaded 16 at a
+    // time), and the shuffle moves each sample to the top three bytes
+    // of its 32 bits, so shifting it back down extends the sign.  The
+    // second load reads 4 bytes past the eighth sample, so the loop
+    // stops while at least two more samples remain.
+    const __m256i shuffle = _mm256_setr_epi8(
+        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    const __m256 scale = _mm256_set1_ps(static_cast<float>(0x7FFFFF));
+    size_t i = 0;
+    for (; i + 10 <= count; i += 8)
+    {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 3 * i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 3 * i + 12));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        v = _mm256_srai_epi32(_mm256_shuffle_epi8(v, shuffle), 8);
+        _mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    for (; i < count; i++)
+        out[i] = Int24ToFloat(in + 3 * i);
+}
+
+static TARGET_AVX2 void AVX2ConvertFloatToInt16(const float *in, int16_t *out, size_t count)
+{
+    const __m256 scale = _mm256_set1_ps(32767.0f);
+    const __m256 lowest = _mm256_set1_ps(-32767.0f);
+    const __m256 highest = _mm256_set1_ps(32767.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 v = _mm256_mul_ps(_mm256_loadu_ps(in + i), scale);
+        v = _mm256_min_ps(highest, _mm256_max_ps(lowest, v));
+        __m256i w = _mm256_cvttps_epi32(v);
+        __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(w), _mm256_extracti128_si256(w, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), packed);
+    }
+    for (; i < count; i++)
+        out[i] = FloatToInt16(in[i]);
+}
+
+static TARGET_AVX2 void AVX2Gain(const float *in, float *out, size_t count, float gain)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(in + i), g));
+    for (; i < count; i++)
+        out[i] = in[i] * gain;
+}
+
+static TARGET_AVX2 void AVX2GainClip(const float *in, float *out, size_t count, float gain, float lowest, float highest)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    const __m256 lo = _mm256_set1_ps(lowest);
+    const __m256 hi = _mm256_set1_ps(highest);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 v = _mm256_mul_ps(_mm256_loadu_ps(in + i), g);
+        _mm256_storeu_ps(out + i, _mm256_min_ps(hi, _mm256_max_ps(lo, v)));
+    }
+    for (; i < count; i++)
+        out[i] = ClipSample(in[i] * gain, lowest, highest);
+}
+
+static TARGET_AVX2 void AVX2MinMax(const float *in, size_t count, float &lowest, float &highest)
+{
+    size_t i = 0;
+    if (count >= 16)
+    {
+        __m256 lo0 = _mm256_set1_ps(lowest), lo1 = lo0;
+        __m256 hi0 = _mm256_set1_ps(highest), hi1 = hi0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m256 a = _mm256_loadu_ps(in + i);
+            __m256 b = _mm256_loadu_ps(in + i + 8);
+            lo0 = _mm256_min_ps(a, lo0);
+            lo1 = _mm256_min_ps(b, lo1);
+            hi0 = _mm256_max_ps(a, hi0);
+            hi1 = _mm256_max_ps(b, hi1);
+        }
+
+        float lo[16], hi[16];
+        _mm256_storeu_ps(lo, lo0);
+        _mm256_storeu_ps(lo + 8, lo1);
+        _mm256_storeu_ps(hi, hi0);
+        _mm256_storeu_ps(hi + 8, hi1);
+        ReduceMinMax(lo, hi, 16, lowest, highest);
+    }
+    ScalarMinMax(in + i, count - i, lowest, highest);
+}
+
+static TARGET_AVX2 void AVX2MixAdd(const float *in, float *out, size_t count, float gain)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 v = _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(_mm256_loadu_ps(in + i), g));
+        _mm256_storeu_ps(out + i, v);
+    }
+    for (; i < count; i++)
+        out[i] += in[i] * gain;
+}
+
+static TARGET_AVX2 void AVX2FIR(const float *in, float *out, size_t count, const float *taps, size_t numTaps)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const float *x = in + i;
+        __m256 sum = _mm256_mul_ps(_mm256_set1_ps(taps[0]), _mm256_loadu_ps(x));
+        for (size_t k = 1; k < numTaps; k++)
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(taps[k]), _mm256_loadu_ps(x - k)));
+        _mm256_storeu_ps(out + i, sum);
+    }
+    for (; i < count; i++)
+        out[i] = FIRSample(in, i, taps, numTaps);
+}
+
+static const DSPKernels kAVX2Kernels =
+{
+    DSPInstructionSet::AVX2, "avx2",
+    AVX2ConvertInt16ToFloat,
+    AVX2Convert24BitToFloat,
+    AVX2ConvertFloatToInt16,
+    AVX2Gain,
+    AVX2GainClip,
+    AVX2MinMax,
+    AVX2MixAdd,
+    AVX2FIR,
+    BiquadUsingFIR<AVX2FIR>
+};
+
+//--------------------------------------------------
+// AVX-512 kernels.  The 24-bit conversion has no
+// 512-bit byte shuffle in AVX-512 Foundation, so it
+// uses the AVX2 kernel.
+//--------------------------------------------------
+
+// GCC's own AVX-512 header makes it warn about an "uninitialized"
+// value in the intrinsics when they're used in a function marked
+// for AVX-512.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+static TARGET_AVX512 void AVX512ConvertInt16ToFloat(const int16_t *in, float *out, size_t count)
+{
+    const __m512 scale = _mm512_set1_ps(static_cast<float>(0x7FFF));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512i v = _mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i)));
+        _mm512_storeu_ps(out + i, _mm512_div_ps(_mm512_cvtepi32_ps(v), scale));
+    }
+    for (; i < count; i++)
+        out[i] = Int16ToFloat(in[i]);
+}
+
+static TARGET_AVX512 void AVX512ConvertFloatToInt16(const float *in, int16_t *out, size_t count)
+{
+    const __m512 scale = _mm512_set1_ps(32767.0f);
+    const __m512 lowest = _mm512_set1_ps(-32767.0f);
+    const __m512 highest = _mm512_set1_ps(32767.0f);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512 v = _mm512_mul_ps(_mm512_loadu_ps(in + i), scale);
+        v = _mm512_min_ps(highest, _mm512_max_ps(lowest, v));
+        __m256i packed = _mm512_cvtsepi32_epi16(_mm512_cvttps_epi32(v));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), packed);
+    }
+    for (; i < count; i++)
+        out[i] = FloatToInt16(in[i]);
+}
+
+static TARGET_AVX512 void AVX512Gain(const float *in, float *out, size_t count, float gain)
+{
+    const __m512 g = _mm512_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+        _mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_loadu_ps(in + i), g));
+    for (; i < count; i++)
+        out[i] = in[i] * gain;
+}
+
+static TARGET_AVX512 void AVX512GainClip(const float *in, float *out, size_t count, float gain, float lowest, float highest)
+{
+    const __m512 g = _mm512_set1_ps(gain);
+    const __m512 lo = _mm512_set1_ps(lowest);
+    const __m512 hi = _mm512_set1_ps(highest);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512 v = _mm512_mul_ps(_mm512_loadu_ps(in + i), g);
+        _mm512_storeu_ps(out + i, _mm512_min_ps(hi, _mm512_max_ps(lo, v)));
+    }
+    for (; i < count; i++)
+        out[i] = ClipSample(in[i] * gain, lowest, highest);
+}
+
+static TARGET_AVX512 void AVX512MinMax(const float *in, size_t count, float &lowest, float &highest)
+{
+    size_t i = 0;
+    if (count >= 32)
+    {
+        __m512 lo0 = _mm512_set1_ps(lowest), lo1 = lo0;
+        __m512 hi0 = _mm512_set1_ps(highest), hi1 = hi0;
+        for (; i + 32 <= count; i += 32)
+        {
+            __m512 a = _mm512_loadu_ps(in + i);
+            __m512 b = _mm512_loadu_ps(in + i + 16);
+            lo0 = _mm512_min_ps(a, lo0);
+            lo1 = _mm512_min_ps(b, lo1);
+            hi0 = _mm512_max_ps(a, hi0);
+            hi1 = _mm512_max_ps(b, hi1);
+        }
+
+        float lo[32], hi[32];
+        _mm512_storeu_ps(lo, lo0);
+        _mm512_storeu_ps(lo + 16, lo1);
+        _mm512_storeu_ps(hi, hi0);
+        _mm512_storeu_ps(hi + 16, hi1);
+        ReduceMinMax(lo, hi, 32, lowest, highest);
+    }
+    ScalarMinMax(in + i, count - i, lowest, highest);
+}
+
+static TARGET_AVX512 void AVX512MixAdd(const float *in, float *out, size_t count, float gain)
+{
+    const __m512 g = _mm512_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512 v = _mm512_add_ps(_mm512_loadu_ps(out + i), _mm512_mul_ps(_mm512_loadu_ps(in + i), g));
+        _mm512_storeu_ps(out + i, v);
+    }
+    for (; i < count; i++)
+        out[i] += in[i] * gain;
+}
+
+static TARGET_AVX512 void AVX512FIR(const float *in, float *out, size_t count, const float *taps, size_t numTaps)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const float *x = in + i;
+        __m512 sum = _mm512_mul_ps(_mm512_set1_ps(taps[0]), _mm512_loadu_ps(x));
+        for (size_t k = 1; k < numTaps; k++)
+            sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_set1_ps(taps[k]), _mm512_loadu_ps(x - k)));
+        _mm512_storeu_ps(out + i, sum);
+    }
+    for (; i < count; i++)
+        out[i] = FIRSample(in, i, taps, numTaps);
+}
+
+static const DSPKernels kAVX512Kernels =
+{
+    DSPInstructionSet::AVX512, "avx512",
+    AVX512ConvertInt16ToFloat,
+    AVX2Convert24BitToFloat,
+    AVX512ConvertFloatToInt16,
+    AVX512Gain,
+    AVX512GainClip,
+    AVX512MinMax,
+    AVX512MixAdd,
+    AVX512FIR,
+    BiquadUsingFIR<AVX512FIR>
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// The x86 instruction sets this processor and operating system
+// support.
+struct X86Features
+{
+    bool m_sse2 = false;
+    bool m_avx2 = false;
+    bool m_avx512 = false;
+};
+
+static X86Features DetectX86Features()
+{
+    X86Features features;
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+    __cpuid(info, 1);
+    features.m_sse2 = (info[3] & (1 << 26)) != 0;
+
+    // The wider registers also have to be saved by the operating
+    // system when switching threads.
+    unsigned long long xcr0 = 0;
+    if ((info[2] & (1 << 27)) != 0)
+        xcr0 = _xgetbv(0);
+    const bool avxState = (xcr0 & 0x6) == 0x6;
+    const bool avx512State = (xcr0 & 0xE6) == 0xE6;
+    if (maxLeaf >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        features.m_avx2 = avxState && (info[1] & (1 << 5)) != 0;
+        features.m_avx512 = avx512State && (info[1] & (1 << 16)) != 0;
+    }
+#else
+    // These also check that the operating system saves the wider
+    // registers.
+    __builtin_cpu_init();
+    features.m_sse2 = __builtin_cpu_supports("sse2") != 0;
+    features.m_avx2 = __builtin_cpu_supports("avx2") != 0;
+    features.m_avx512 = __builtin_cpu_supports("avx512f") != 0;
+#endif
+    return features;
+}
+
+static const X86Features &GetX86Features()
+{
+    static const X86Features features = DetectX86Features();
+    return features;
+}
+
+#endif // DSP_X86
+
+#ifdef DSP_NEON
+
+//--------------------------------------------------
+// NEON kernels.  The NEON min and max instructions
+// return NaN if either operand is NaN, so the
+// clipping uses comparisons and selects to match
+// the scalar kernels instead.
+//--------------------------------------------------
+
+static void NEONConvertInt16ToFloat(const int16_t *in, float *out, size_t count)
+{
+    const float32x4_t scale = vdupq_n_f32(static_cast<float>(0x7FFF));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        int16x8_t v = vld1q_s16(in + i);
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        vst1q_f32(out + i, vdivq_f32(lo, scale));
+        vst1q_f32(out + i + 4, vdivq_f32(hi, scale));
+    }
+    for (; i < count; i++)
+        out[i] = Int16ToFloat(in[i]);
+}
+
+static void NEONConvert24BitToFloat(const uint8_t *in, float *out, size_t count)
+{
+    // Split eight samples into their low, middle, and high bytes, and
+    // put them back together as 32-bit integers.
+    const float32x4_t scale = vdupq_n_f32(static_cast<float>(0x7FFFFF));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        uint8x8x3_t bytes = vld3_u8(in + 3 * i);
+        uint16x8_t low16 = vorrq_u16(vmovl_u8(bytes.val[0]), vshlq_n_u16(vmovl_u8(bytes.val[1]), 8));
+        int16x8_t high = vmovl_s8(vreinterpret_s8_u8(bytes.val[2]));
+        int32x4_t lo = vorrq_s32(vshlq_n_s32(vmovl_s16(vget_low_s16(high)), 16),
+            vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(low16))));
+        int32x4_t hi = vorrq_s32(vshlq_n_s32(vmovl_s16(vget_high_s16(high)), 16),
+            vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(low16))));
+        vst1q_f32(out + i, vdivq_f32(vcvtq_f32_s32(lo), scale));
+        vst1q_f32(out + i + 4, vdivq_f32(vcvtq_f32_s32(hi), scale));
+    }
+    for (; i < count; i++)
+        out[i] = Int24ToFloat(in + 3 * i);
+}
+
+static inline float32x4_t NEONClip(float32x4_t v, float32x4_t lowest, float32x4_t highest)
+{
+    v = vbslq_f32(vcltq_f32(v, lowest), lowest, v);
+    return vbslq_f32(vcgtq_f32(v, highest), highest, v);
+}
+
+static void NEONConvertFloatToInt16(const float *in, int16_t *out, size_t count)
+{
+    const float32x4_t scale = vdupq_n_f32(32767.0f);
+    const float32x4_t lowest = vdupq_n_f32(-32767.0f);
+    const float32x4_t highest = vdupq_n_f32(32767.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        float32x4_t a = NEONClip(vmulq_f32(vld1q_f32(in + i), scale), lowest, highest);
+        float32x4_t b = NEONClip(vmulq_f32(vld1q_f32(in + i + 4), scale), lowest, highest);
+        int16x8_t packed = vcombine_s16(vmovn_s32(vcvtq_s32_f32(a)), vmovn_s32(vcvtq_s32_f32(b)));
+        vst1q_s16(out + i, packed);
+    }
+    for (; i < count; i++)
+        out[i] = FloatToInt16(in[i]);
+}
+
+static void NEONGain(const float *in, float *out, size_t count, float gain)
+{
+    const float32x4_t g = vdupq_n_f32(gain);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(out + i, vmulq_f32(vld1q_f32(in + i), g));
+    for (; i < count; i++)
+        out[i] = in[i] * gain;
+}
+
+static void NEONGainClip(const float *in, float *out, size_t count, float gain, float lowest, float highest)
+{
+    const float32x4_t g = vdupq_n_f32(gain);
+    const float32x4_t lo = vdupq_n_f32(lowest);
+    const float32x4_t hi = vdupq_n_f32(highest);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(out + i, NEONClip(vmulq_f32(vld1q_f32(in + i), g), lo, hi));
+    for (; i < count; i++)
+        out[i] = ClipSample(in[i] * gain, lowest, highest);
+}
+
+static void NEONMinMax(const float *in, size_t count, float &lowest, float &highest)
+{
+    size_t i = 0;
+    if (count >= 8)
+    {
+        float32x4_t lo0 = vdupq_n_f32(lowest), lo1 = lo0;
+        float32x4_t hi0 = vdupq_n_f32(highest), hi1 = hi0;
+        for (; i + 8 <= count; i += 8)
+        {
+            float32x4_t a = vld1q_f32(in + i);
+            float32x4_t b = vld1q_f32(in + i + 4);
+            lo0 = vbslq_f32(vcltq_f32(a, lo0), a, lo0);
+            lo1 = vbslq_f32(vcltq_f32(b, lo1), b, lo1);
+            hi0 = vbslq_f32(vcgtq_f32(a, hi0), a, hi0);
+            hi1 = vbslq_f32(vcgtq_f32(b, hi1), b, hi1);
+        }
+
+        float lo[8], hi[8];
+        vst1q_f32(lo, lo0);
+        vst1q_f32(lo + 4, lo1);
+        vst1q_f32(hi, hi0);
+        vst1q_f32(hi + 4, hi1);
+        ReduceMinMax(lo, hi, 8, lowest, highest);
+    }
+    ScalarMinMax(in + i, count - i, lowest, highest);
+}
+
+static void NEONMixAdd(const float *in, float *out, size_t count, float gain)
+{
+    // A separate multiply and add, rather than vmlaq, which may be
+    // fused and rounded differently.
+    const float32x4_t g = vdupq_n_f32(gain);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), vmulq_f32(vld1q_f32(in + i), g)));
+    for (; i < count; i++)
+        out[i] += in[i] * gain;
+}
+
+static void NEONFIR(const float *in, float *out, size_t count, const float *taps, size_t numTaps)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const float *x = in + i;
+        float32x4_t sum = vmulq_f32(vdupq_n_f32(taps[0]), vld1q_f32(x));
+        for (size_t k = 1; k < numTaps; k++)
+            sum = vaddq_f32(sum, vmulq_f32(vdupq_n_f32(taps[k]), vld1q_f32(x - k)));
+        vst1q_f32(out + i, sum);
+    }
+    for (; i < count; i++)
+        out[i] = FIRSample(in, i, taps, numTaps);
+}
+
+static const DSPKernels kNEONKernels =
+{
+    DSPInstructionSet::NEON, "neon",
+    NEONConvertInt16ToFloat,
+    NEONConvert24BitToFloat,
+    NEONConvertFloatToInt16,
+    NEONGain,
+    NEONGainClip,
+    NEONMinMax,
+    NEONMixAdd,
+    NEONFIR,
+    BiquadUsingFIR<NEONFIR>
+};
+
+#endif // DSP_NEON
+
+//--------------------------------------------------
+// Choosing the kernels.
+//--------------------------------------------------
+
+const DSPKernels *DSPKernelsGetFor(DSPInstructionSet isa)
+{
+    switch (isa)
+    {
+    case DSPInstructionSet::Scalar:
+        return &kScalarKernels;
+#ifdef DSP_X86
+    case DSPInstructionSet::SSE2:
+        return GetX86Features().m_sse2 ? &kSSE2Kernels : nullptr;
+    case DSPInstructionSet::AVX2:
+        return GetX86Features().m_avx2 ? &kAVX2Kernels : nullptr;
+    case DSPInstructionSet::AVX512:
+        return GetX86Features().m_avx512 ? &kAVX512Kernels : nullptr;
+#endif
+#ifdef DSP_NEON
+    case DSPInstructionSet::NEON:
+        // Every ARM64 processor has NEON.
+        return &kNEONKernels;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+// Returns the kernels for the best instruction set the processor
+// supports.
+static const DSPKernels *DetectBestKernels()
+{
+    static const DSPInstructionSet preferred[] =
+    {
+        DSPInstructionSet::AVX512,
+        DSPInstructionSet::AVX2,
+        DSPInstructionSet::SSE2,
+        DSPInstructionSet::NEON
+    };
+    for (DSPInstructionSet isa : preferred)
+    {
+        const DSPKernels *kernels = DSPKernelsGetFor(isa);
+        if (kernels)
+            return kernels;
+    }
+    return &kScalarKernels;
+}
+
+// The kernels in use, chosen the first time they're needed.
+static std::atomic<const DSPKernels *> &ActiveKernels()
+{
+    static std::atomic<const DSPKernels *> active(DetectBestKernels());
+    return active;
+}
+
+const DSPKernels &DSPKernelsGet()
+{
+    return *ActiveKernels().load(std::memory_order_acquire);
+}
+
+bool DSPKernelsForceISA(const wchar_t *name)
+{
+    static const wchar_t *const names[] = { L"scalar", L"sse2", L"avx2", L"avx512", L"neon" };
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(DSPInstructionSet::Count),
+        "Every instruction set needs a name");
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (_wcsicmp(name, names[i]) != 0)
+            continue;
+
+        const DSPKernels *kernels = DSPKernelsGetFor(static_cast<DSPInstructionSet>(i));
+        if (!kernels)
+            return false;
+        ActiveKernels().store(kernels, std::memory_order_release);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,135 @@
+//-------------------------------------------------------------------
+//
+// dspkernels.h
+//
+// C++ module providing the inner loops that process blocks of
+// samples (converting, scaling, mixing, and filtering them), in a
+// version for each set of vector instructions a processor may have.
+// The fastest version this processor supports is chosen the first
+// time the kernels are needed.
+//
+//-------------------------------------------------------------------
+//
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// The sets of vector instructions the kernels are written for.
+enum class DSPInstructionSet
+{
+    Scalar,         // Plain C++, for any processor.
+    SSE2,           // x86 and x64.
+    AVX2,           // x64 processors from about 2013 on.
+    AVX512,         // AVX-512 Foundation, on some x64 processors.
+    NEON,           // ARM64.
+    Count
+};
+
+// The coefficients and history of a biquad filter in direct form I:
+//   y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+// where the coefficients have been divided by a0.
+struct BiquadState
+{
+    float m_b0, m_b1, m_b2, m_a1, m_a2;
+    float m_x1, m_x2;       // The previous two inputs.
+    float m_y1, m_y2;       // The previous two outputs.
+};
+
+//
+// The kernels for one instruction set.  Every version of a kernel
+// gives the same results as the scalar one, bit for bit, except for
+// NaN inputs, so the output of a tool doesn't depend on the
+// processor it ran on.  The gain, mix, and biquad kernels may be
+// given the same buffer for 'in' and 'out'.
+//
+struct DSPKernels
+{
+    DSPInstructionSet m_isa;
+    const char *m_name;         // As given to -ForceISA.
+
+    // Converts 16-bit integer samples to floating-point, where
+    // 32767 becomes 1.0.
+    void (*ConvertInt16ToFloat)(const int16_t *in, float *out, size_t count);
+
+    // Converts packed 24-bit little-endian integer samples to
+    // floating-point, where 8388607 becomes 1.0.
+    void (*Convert24BitToFloat)(const uint8_t *in, float *out, size_t count);
+
+    // Converts floating-point samples to 16-bit integers, scaling
+    // by 32767, limiting to -32767 to 32767, and rounding toward
+    // zero.
+    void (*ConvertFloatToInt16)(const float *in, int16_t *out, size_t count);
+
+    // Sets out[i] = in[i] * gain.
+    void (*Gain)(const float *in, float *out, size_t count, float gain);
+
+    // Sets out[i] = in[i] * gain, limited to 'lowest' to 'highest'.
+    void (*GainClip)(const float *in, float *out, size_t count, float gain, float lowest, float highest);
+
+    // Widens the range 'lowest' to 'highest' to include every
+    // sample.  NaN samples are skipped.
+    void (*MinMax)(const float *in, size_t count, float &lowest, float &highest);
+
+    // Sets out[i] += in[i] * gain.
+    void (*MixAdd)(const float *in, float *out, size_t count, float gain);
+
+    // Sets out[i] = sum of taps[k] * in[i - k], for k from 0 to
+    // numTaps - 1, summed in that order.  The numTaps - 1 samples
+    // before in[0] must be readable.  'in' and 'out' must not
+    // overlap.
+    void (*FIR)(const float *in, float *out, size_t count, const float *taps, size_t numTaps);
+
+    // Runs the samples through a biquad filter, updating its history.
+    void (*Biquad)(BiquadState &state, const float *in, float *out, size_t count);
+};
+
+// Returns the kernels in use:  those for the best instruction set
+// the processor supports, unless another was chosen with
+// DSPKernelsForceISA.
+const DSPKernels &DSPKernelsGet();
+
+// Returns the kernels for the given instruction set, or nullptr if
+// the processor (or the compiler this was built with) doesn't
+// support it.
+const DSPKernels *DSPKernelsGetFor(DSPInstructionSet isa);
+
+// Uses the kernels for the named instruction set ('scalar', 'sse2',
+// 'avx2', 'avx512', or 'neon') from now on, for testing or for
+// comparing their speed.  Returns false, changing nothing, if the
+// name isn't known or the processor doesn't support it.
+bool DSPKernelsForceISA(const wchar_t *name);
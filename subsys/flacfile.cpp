@@ -0,0 +1,1686 @@
+//-------------------------------------------------------------------
+//
+// flacfile.cpp
+//
+// C++ module for reading and writing FLAC (Free Lossless Audio
+// Codec) files.
+//
+// The encoder works like the reference encoder's middle settings:
+// each block is predicted with the best of the fixed polynomial
+// predictors and a quantized LPC predictor found by the Levinson-
+// Durbin recursion, and the prediction residual is Rice-coded in
+// partitions.  The decoder handles any valid stream.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#include "flacfile.h"
+#include "threadpool.h"
+#include "platform.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//#define TRACE // Define TRACE to enable debug printfs in this module.
+
+// Handy class to auto-close a stdio FILE when it goes out of scope.
+class ScopedFile
+{
+public:
+    explicit ScopedFile(FILE *file) : m_file(file) { }
+    ~ScopedFile() { Close(); }
+    void Close() { if (m_file) fclose(m_file); m_file = nullptr; }
+
+private:
+    FILE *m_file;
+};
+
+static const unsigned kBlockSize = 4096;        // Samples per channel in each frame the encoder writes.
+static const unsigned kMaxLPCOrder = 12;        // Highest LPC order the encoder tries.
+static const unsigned kMaxPartitionOrder = 8;   // Highest Rice partition order the encoder tries.
+static const unsigned kFramesPerBatch = 256;    // Frames encoded at once by the thread pool.
+static const unsigned kSeekPointSeconds = 2;    // Spacing of the encoder's seek points.
+static const unsigned kStreamInfoBytes = 34;    // Size of the STREAMINFO metadata block.
+static const unsigned kSeekPointBytes = 18;     // Size of each point in a SEEKTABLE.
+static const size_t kReadPadding = 8;           // Zero bytes after the data so the bit reader can read ahead.
+
+// Subframe types as the encoder plans them.
+enum FLACSubframeType
+{
+    kSubframeConstant,
+    kSubframeVerbatim,
+    kSubframeFixed,
+    kSubframeLPC,
+};
+
+// Channel assignments from the frame header.  Values 0 to 7 mean
+// that many channels plus one, coded independently.
+static const unsigned kLeftSide = 8;
+static const unsigned kSideRight = 9;
+static const unsigned kMidSide = 10;
+
+// The CRC-8 (polynomial 0x07) that protects each frame header, and
+// the CRC-16 (polynomial 0x8005) that protects each whole frame.
+struct FLACCRCTables
+{
+    FLACCRCTables()
+    {
+        for (unsigned i = 0; i < 256; i++)
+        {
+            unsigned crc8 = i;
+            unsigned crc16 = i << 8;
+            for (unsigned bit = 0; bit < 8; bit++)
+            {
+                crc8 = (crc8 & 0x80) ? ((crc8 << 1) ^ 0x07) : (crc8 << 1);
+                crc16 = (crc16 & 0x8000) ? ((crc16 << 1) ^ 0x8005) : (crc16 << 1);
+            }
+            m_crc8[i] = static_cast<uint8_t>(crc8);
+            m_crc16[i] = static_cast<uint16_t>(crc16);
+        }
+    }
+
+    uint8_t m_crc8[256];
+    uint16_t m_crc16[256];
+};
+
+static const FLACCRCTables g_crc;
+
+static uint8_t ComputeCRC8(const uint8_t *data, size_t count)
+{
+    unsigned crc = 0;
+    for (size_t i = 0; i < count; i++)
+        crc = g_crc.m_crc8[crc ^ data[i]];
+    return static_cast<uint8_t>(crc);
+}
+
+static uint16_t ComputeCRC16(const uint8_t *data, size_t count)
+{
+    unsigned crc = 0;
+    for (size_t i = 0; i < count; i++)
+        crc = ((crc << 8) ^ g_crc.m_crc16[(crc >> 8) ^ data[i]]) & 0xFFFF;
+    return static_cast<uint16_t>(crc);
+}
+
+// Reads a big-endian 64-bit value.
+static uint64_t ReadBE64(const uint8_t *p)
+{
+    uint64_t value = 0;
+    for (unsigned i = 0; i < 8; i++)
+        value = (value << 8) | p[i];
+    return value;
+}
+
+// Returns the number of zero bits above the highest one bit in a
+// nonzero value.
+static unsigned CountLeadingZeros(uint64_t value)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return 63 - index;
+#elif defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_clzll(value));
+#else
+    unsigned count = 0;
+    while (!(value & 0x8000000000000000ull))
+    {
+        value <<= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+// Reads bit fields, most significant bit first, from a buffer that
+// has at least kReadPadding readable bytes past its end.  Reading
+// past the end yields zeros and sets the overrun flag rather than
+// touching memory outside the buffer.
+class FLACBitReader
+{
+public:
+    FLACBitReader(const uint8_t *data, size_t size) : m_data(data), m_size(size) { }
+
+    void Seek(size_t byte_offset) { m_bit_pos = static_cast<uint64_t>(byte_offset) * 8; }
+    size_t GetByteOffset() const { return static_cast<size_t>((m_bit_pos + 7) / 8); }
+    bool Overrun() const { return m_bit_pos > static_cast<uint64_t>(m_size) * 8; }
+    void AlignToByte() { m_bit_pos = (m_bit_pos + 7) & ~static_cast<uint64_t>(7); }
+
+    // Reads an unsigned field of up to 56 bits.
+    uint64_t ReadBits(unsigned bits)
+    {
+        if (bits == 0)
+            return 0;
+        size_t byte = static_cast<size_t>(m_bit_pos >> 3);
+        if (byte >= m_size)
+        {
+            m_bit_pos = static_cast<uint64_t>(m_size) * 8 + 1;
+            return 0;
+        }
+        uint64_t window = ReadBE64(m_data + byte) << (m_bit_pos & 7);
+        m_bit_pos += bits;
+        return window >> (64 - bits);
+    }
+
+    // Reads a two's complement field of 1 to 56 bits.
+    int64_t ReadSigned(unsigned bits)
+    {
+        uint64_t value = ReadBits(bits);
+        return static_cast<int64_t>(value << (64 - bits)) >> (64 - bits);
+    }
+
+    // Reads a unary value: the number of zero bits before a one.
+    uint64_t ReadUnary()
+    {
+        uint64_t count = 0;
+        for (;;)
+        {
+            size_t byte = static_cast<size_t>(m_bit_pos >> 3);
+            if (byte >= m_size)
+            {
+                m_bit_pos = static_cast<uint64_t>(m_size) * 8 + 1;
+                return count;
+            }
+            unsigned skip = static_cast<unsigned>(m_bit_pos & 7);
+            uint64_t window = ReadBE64(m_data + byte) << skip;
+            if (window)
+            {
+                unsigned zeros = CountLeadingZeros(window);
+                m_bit_pos += zeros + 1;
+                return count + zeros;
+            }
+            count += 64 - skip;
+            m_bit_pos += 64 - skip;
+        }
+    }
+
+private:
+    const uint8_t *m_data;
+    size_t m_size;
+    uint64_t m_bit_pos = 0;
+};
+
+// Appends bit fields, most significant bit first, to a byte vector.
+class FLACBitWriter
+{
+public:
+    explicit FLACBitWriter(std::vector<uint8_t> &out) : m_out(out) { }
+
+    // Appends the low 'bits' bits (up to 32) of 'value'.
+    void Put(uint64_t value, unsigned bits)
+    {
+        m_acc = (m_acc << bits) | (value & ((static_cast<uint64_t>(1) << bits) - 1));
+        m_bits += bits;
+        while (m_bits >= 8)
+        {
+            m_bits -= 8;
+            m_out.push_back(static_cast<uint8_t>(m_acc >> m_bits));
+        }
+    }
+
+    void PutZeros(uint64_t count)
+    {
+        for (; count >= 32; count -= 32)
+            Put(0, 32);
+        Put(0, static_cast<unsigned>(count));
+    }
+
+    void AlignToByte()
+    {
+        if (m_bits)
+            Put(0, 8 - m_bits);
+    }
+
+private:
+    std::vector<uint8_t> &m_out;
+    uint64_t m_acc = 0;
+    unsigned m_bits = 0;
+};
+
+//-------------------------------------------------------------------
+// Reading
+//-------------------------------------------------------------------
+
+// The fields of a frame header that the decoder needs.
+struct FLACFrameHeader
+{
+    uint64_t m_first_sample = 0;    // Number of the frame's first sample (per channel).
+    unsigned m_block = 0;           // Samples per channel in the frame.
+    unsigned m_assignment = 0;      // Channel assignment code.
+    unsigned m_channels = 0;
+    unsigned m_bits = 0;
+};
+
+// Returns true if the bytes at 'p' start with a frame sync code.
+static bool IsFrameSync(const uint8_t *p)
+{
+    return p[0] == 0xFF && (p[1] & 0xFE) == 0xF8;
+}
+
+// Reads the UTF-8 style coded frame or sample number from a frame
+// header.  Returns false if it's malformed.
+static bool ReadCodedNumber(FLACBitReader &br, uint64_t &value)
+{
+    unsigned lead = static_cast<unsigned>(br.ReadBits(8));
+    unsigned extra = 0;
+    if (!(lead & 0x80))
+    {
+        value = lead;
+    }
+    else
+    {
+        while (extra < 7 && (lead & (0x40 >> extra)))
+            extra++;
+        if (extra < 1 || extra > 6)
+            return false;
+        value = lead & (0x3F >> extra);
+    }
+
+    for (unsigned i = 0; i < extra; i++)
+    {
+        unsigned next = static_cast<unsigned>(br.ReadBits(8));
+        if ((next & 0xC0) != 0x80)
+            return false;
+        value = (value << 6) | (next & 0x3F);
+    }
+    return true;
+}
+
+// Reads and checks a frame header at the reader's position, which
+// must be at a byte boundary.
+static bool ReadFrameHeader(FLACBitReader &br, const uint8_t *data, const FLACInfo &info, FLACFrameHeader &hdr)
+{
+    static const unsigned kRates[12] = { 0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000 };
+    static const unsigned kBits[8] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+
+    size_t start = br.GetByteOffset();
+    if (br.ReadBits(15) != 0x7FFC)
+        return false;
+    bool variable = br.ReadBits(1) != 0;
+    unsigned block_code = static_cast<unsigned>(br.ReadBits(4));
+    unsigned rate_code = static_cast<unsigned>(br.ReadBits(4));
+    hdr.m_assignment = static_cast<unsigned>(br.ReadBits(4));
+    unsigned bits_code = static_cast<unsigned>(br.ReadBits(3));
+    if (br.ReadBits(1) != 0 || block_code == 0 || rate_code == 15 ||
+        hdr.m_assignment > kMidSide || bits_code == 3)
+    {
+        return false;
+    }
+
+    uint64_t number = 0;
+    if (!ReadCodedNumber(br, number))
+        return false;
+
+    if (block_code == 1)
+        hdr.m_block = 192;
+    else if (block_code <= 5)
+        hdr.m_block = 576 << (block_code - 2);
+    else if (block_code == 6)
+        hdr.m_block = static_cast<unsigned>(br.ReadBits(8)) + 1;
+    else if (block_code == 7)
+        hdr.m_block = static_cast<unsigned>(br.ReadBits(16)) + 1;
+    else
+        hdr.m_block = 256 << (block_code - 8);
+
+    // The frame's sample rate isn't needed, but any extra bytes
+    // holding it are part of the header.
+    if (rate_code == 12)
+        br.ReadBits(8);
+    else if (rate_code >= 13)
+        br.ReadBits(16);
+    else if (rate_code != 0 && kRates[rate_code] != info.m_rate)
+        return false;
+
+    unsigned crc = ComputeCRC8(data + start, br.GetByteOffset() - start);
+    if (br.ReadBits(8) != crc || br.Overrun())
+        return false;
+
+    hdr.m_channels = hdr.m_assignment < kLeftSide ? hdr.m_assignment + 1 : 2;
+    hdr.m_bits = bits_code ? kBits[bits_code] : info.m_bits;
+    if (hdr.m_channels != info.m_channels || hdr.m_bits != info.m_bits)
+        return false;
+
+    hdr.m_first_sample = variable ? number : number * info.m_max_block;
+    return true;
+}
+
+// Reads a residual section, placing the residuals for the samples
+// after the predictor's warm-up samples in 'out'.
+static bool ReadResidual(FLACBitReader &br, unsigned block, unsigned order, int64_t *out)
+{
+    unsigned method = static_cast<unsigned>(br.ReadBits(2));
+    if (method > 1)
+        return false;
+    const unsigned param_bits = method ? 5 : 4;
+    const unsigned escape = (1u << param_bits) - 1;
+
+    unsigned partition_order = static_cast<unsigned>(br.ReadBits(4));
+    unsigned partition_samples = block >> partition_order;
+    if ((partition_samples << partition_order) != block || partition_samples < order)
+        return false;
+
+    int64_t *p = out + order;
+    for (unsigned partition = 0; partition < (1u << partition_order); partition++)
+    {
+        unsigned count = partition ? partition_samples : partition_samples - order;
+        unsigned param = static_cast<unsigned>(br.ReadBits(param_bits));
+        if (param == escape)
+        {
+            unsigned raw_bits = static_cast<unsigned>(br.ReadBits(5));
+            for (unsigned i = 0; i < count; i++)
+                *p++ = raw_bits ? br.ReadSigned(raw_bits) : 0;
+        }
+        else
+        {
+            for (unsigned i = 0; i < count; i++)
+            {
+                uint64_t value = (br.ReadUnary() << param) | br.ReadBits(param);
+                *p++ = static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+            }
+        }
+        if (br.Overrun())
+            return false;
+    }
+    return true;
+}
+
+// Reads one subframe of 'block' samples of 'bits' bits each.
+static bool ReadSubframe(FLACBitReader &br, unsigned block, unsigned bits, int64_t *out)
+{
+    if (br.ReadBits(1) != 0)
+        return false;
+    unsigned type = static_cast<unsigned>(br.ReadBits(6));
+
+    unsigned wasted = 0;
+    if (br.ReadBits(1))
+    {
+        wasted = static_cast<unsigned>(br.ReadUnary()) + 1;
+        if (wasted >= bits)
+            return false;
+        bits -= wasted;
+    }
+
+    if (type == 0)
+    {
+        int64_t value = br.ReadSigned(bits);
+        for (unsigned i = 0; i < block; i++)
+            out[i] = value;
+    }
+    else if (type == 1)
+    {
+        for (unsigned i = 0; i < block; i++)
+            out[i] = br.ReadSigned(bits);
+    }
+    else if (type >= 8 && type <= 12)
+    {
+        unsigned order = type - 8;
+        if (order > block)
+            return false;
+        for (unsigned i = 0; i < order; i++)
+            out[i] = br.ReadSigned(bits);
+        if (!ReadResidual(br, block, order, out))
+            return false;
+
+        switch (order)
+        {
+        case 1:
+            for (unsigned i = 1; i < block; i++)
+                out[i] += out[i - 1];
+            break;
+        case 2:
+            for (unsigned i = 2; i < block; i++)
+                out[i] += 2 * out[i - 1] - out[i - 2];
+            break;
+        case 3:
+            for (unsigned i = 3; i < block; i++)
+                out[i] += 3 * out[i - 1] - 3 * out[i - 2] + out[i - 3];
+            break;
+        case 4:
+            for (unsigned i = 4; i < block; i++)
+                out[i] += 4 * out[i - 1] - 6 * out[i - 2] + 4 * out[i - 3] - out[i - 4];
+            break;
+        }
+    }
+    else if (type >= 32)
+    {
+        unsigned order = type - 31;
+        if (order > block)
+            return false;
+        for (unsigned i = 0; i < order; i++)
+            out[i] = br.ReadSigned(bits);
+
+        unsigned precision = static_cast<unsigned>(br.ReadBits(4)) + 1;
+        int shift = static_cast<int>(br.ReadSigned(5));
+        if (precision == 16 || shift < 0)
+            return false;
+        int64_t coefs[32];
+        for (unsigned i = 0; i < order; i++)
+            coefs[i] = br.ReadSigned(precision);
+        if (!ReadResidual(br, block, order, out))
+            return false;
+
+        for (unsigned i = order; i < block; i++)
+        {
+            int64_t sum = 0;
+            for (unsigned j = 0; j < order; j++)
+                sum += coefs[j] * out[i - 1 - j];
+            out[i] += sum >> shift;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    if (wasted)
+    {
+        for (unsigned i = 0; i < block; i++)
+            out[i] = static_cast<int64_t>(static_cast<uint64_t>(out[i]) << wasted);
+    }
+    return !br.Overrun();
+}
+
+// Decodes the frame at the reader's position into 'channel_data',
+// which receives each channel's samples one channel after another.
+static bool DecodeFrame(FLACBitReader &br, const uint8_t *data, const FLACInfo &info,
+                        FLACFrameHeader &hdr, std::vector<int64_t> &channel_data)
+{
+    size_t start = br.GetByteOffset();
+    if (!ReadFrameHeader(br, data, info, hdr))
+        return false;
+
+    const unsigned block = hdr.m_block;
+    if (channel_data.size() < static_cast<size_t>(block) * hdr.m_channels)
+        channel_data.resize(static_cast<size_t>(block) * hdr.m_channels);
+
+    for (unsigned ch = 0; ch < hdr.m_channels; ch++)
+    {
+        // The side channel needs an extra bit.
+        bool side = (hdr.m_assignment == kLeftSide && ch == 1) ||
+                    (hdr.m_assignment == kSideRight && ch == 0) ||
+                    (hdr.m_assignment == kMidSide && ch == 1);
+        if (!ReadSubframe(br, block, hdr.m_bits + (side ? 1 : 0), &channel_data[ch * block]))
+            return false;
+    }
+
+    br.AlignToByte();
+    size_t end = br.GetByteOffset();
+    if (br.ReadBits(16) != ComputeCRC16(data + start, end - start) || br.Overrun())
+        return false;
+
+    int64_t *ch0 = channel_data.data();
+    int64_t *ch1 = ch0 + block;
+    if (hdr.m_assignment == kLeftSide)
+    {
+        for (unsigned i = 0; i < block; i++)
+            ch1[i] = ch0[i] - ch1[i];
+    }
+    else if (hdr.m_assignment == kSideRight)
+    {
+        for (unsigned i = 0; i < block; i++)
+            ch0[i] += ch1[i];
+    }
+    else if (hdr.m_assignment == kMidSide)
+    {
+        for (unsigned i = 0; i < block; i++)
+        {
+            int64_t mid = static_cast<int64_t>(static_cast<uint64_t>(ch0[i]) << 1) | (ch1[i] & 1);
+            int64_t side = ch1[i];
+            ch0[i] = (mid + side) >> 1;
+            ch1[i] = (mid - side) >> 1;
+        }
+    }
+    return true;
+}
+
+// Decodes the frames from byte offset 'begin' up to 'end' and
+// passes each one to emit(header, channel_data).  Stops early if
+// emit returns false.  Bytes that don't start with a frame sync
+// code are taken as the end of the audio (such as a trailing tag).
+template <typename Emit>
+static bool DecodeFrames(const uint8_t *data, size_t size, size_t begin, size_t end,
+                         const FLACInfo &info, Emit &&emit)
+{
+    FLACBitReader br(data, size);
+    std::vector<int64_t> channel_data(static_cast<size_t>(info.m_max_block) * info.m_channels);
+    size_t offset = begin;
+    while (offset < end && offset + 2 <= size && IsFrameSync(data + offset))
+    {
+        br.Seek(offset);
+        FLACFrameHeader hdr;
+        if (!DecodeFrame(br, data, info, hdr, channel_data))
+        {
+#ifdef TRACE
+            printf("FLAC frame at data offset %zu is bad\n", offset);
+#endif
+            return false;
+        }
+        if (!emit(hdr, channel_data))
+            break;
+        offset = br.GetByteOffset();
+    }
+    return true;
+}
+
+// Copies the part of a decoded frame that overlaps the sample range
+// starting at 'first_sample' into interleaved 'out', which holds
+// 'sample_count' samples per channel.
+static void CopyFrameSamples(const FLACFrameHeader &hdr, const std::vector<int64_t> &channel_data,
+                             uint64_t first_sample, uint64_t sample_count, int32_t *out)
+{
+    uint64_t begin = std::max(hdr.m_first_sample, first_sample);
+    uint64_t end = std::min(hdr.m_first_sample + hdr.m_block, first_sample + sample_count);
+    const unsigned channels = hdr.m_channels;
+    for (uint64_t s = begin; s < end; s++)
+    {
+        size_t in = static_cast<size_t>(s - hdr.m_first_sample);
+        int32_t *dst = out + static_cast<size_t>(s - first_sample) * channels;
+        for (unsigned ch = 0; ch < channels; ch++)
+            dst[ch] = static_cast<int32_t>(channel_data[ch * hdr.m_block + in]);
+    }
+}
+
+// Reads the metadata blocks from an open FLAC file, leaving the
+// file positioned at the first frame.
+static bool ReadMetadata(FILE *fp, FLACInfo &info)
+{
+    info = FLACInfo();
+
+    // Skip any ID3v2 tag in front of the stream marker.
+    uint8_t marker[10];
+    if (fread(marker, 1, 4, fp) != 4)
+        return false;
+    if (memcmp(marker, "ID3", 3) == 0)
+    {
+        if (fread(marker + 4, 1, 6, fp) != 6 || ((marker[6] | marker[7] | marker[8] | marker[9]) & 0x80))
+            return false;
+        int64_t size = 10 + ((marker[6] << 21) | (marker[7] << 14) | (marker[8] << 7) | marker[9]);
+        if (marker[5] & 0x10)
+            size += 10;
+        if (_fseeki64(fp, size, SEEK_SET) || fread(marker, 1, 4, fp) != 4)
+            return false;
+    }
+    if (memcmp(marker, "fLaC", 4) != 0)
+        return false;
+
+    bool have_stream_info = false;
+    bool last = false;
+    while (!last)
+    {
+        uint8_t header[4];
+        if (fread(header, 1, 4, fp) != 4)
+            return false;
+        last = (header[0] & 0x80) != 0;
+        unsigned type = header[0] & 0x7F;
+        unsigned length = (header[1] << 16) | (header[2] << 8) | header[3];
+
+        if (type == 0 || type == 3)
+        {
+            std::vector<uint8_t> block(length);
+            if (length && fread(block.data(), 1, length, fp) != length)
+                return false;
+
+            if (type == 0)
+            {
+                if (length != kStreamInfoBytes)
+                    return false;
+                const uint8_t *p = block.data();
+                info.m_min_block    = (p[0] << 8) | p[1];
+                info.m_max_block    = (p[2] << 8) | p[3];
+                info.m_rate         = (p[10] << 12) | (p[11] << 4) | (p[12] >> 4);
+                info.m_channels     = ((p[12] >> 1) & 7) + 1;
+                info.m_bits         = (((p[12] & 1) << 4) | (p[13] >> 4)) + 1;
+                info.m_sample_count = ReadBE64(p + 10) & 0xFFFFFFFFFull;
+                have_stream_info = true;
+            }
+            else
+            {
+                // Placeholder points have all ones for the sample
+                // number, and come after the real ones.
+                for (unsigned i = 0; i + kSeekPointBytes <= length; i += kSeekPointBytes)
+                {
+                    FLACSeekPoint point;
+                    point.m_sample = ReadBE64(&block[i]);
+                    point.m_offset = ReadBE64(&block[i + 8]);
+                    if (point.m_sample == UINT64_MAX)
+                        break;
+                    if (!info.m_seek_points.empty() &&
+                        (point.m_sample <= info.m_seek_points.back().m_sample ||
+                         point.m_offset <= info.m_seek_points.back().m_offset))
+                    {
+                        // Out of order, so it can't be trusted.
+                        info.m_seek_points.clear();
+                        break;
+                    }
+                    info.m_seek_points.push_back(point);
+                }
+            }
+        }
+        else if (type == 127 || _fseeki64(fp, length, SEEK_CUR))
+        {
+            return false;
+        }
+    }
+
+    if (!have_stream_info || info.m_rate == 0 || info.m_bits < 4 || info.m_max_block < 16)
+        return false;
+
+    int64_t data_offset = _ftelli64(fp);
+    if (data_offset < 0 || _fseeki64(fp, 0, SEEK_END))
+        return false;
+    int64_t file_size = _ftelli64(fp);
+    if (file_size < data_offset)
+        return false;
+    info.m_data_offset = static_cast<uint64_t>(data_offset);
+    info.m_data_bytes = static_cast<uint64_t>(file_size - data_offset);
+
+    // A seek point past the end of the file means it's truncated,
+    // or the table is wrong.
+    while (!info.m_seek_points.empty() && info.m_seek_points.back().m_offset >= info.m_data_bytes)
+        info.m_seek_points.pop_back();
+
+#ifdef TRACE
+    printf("FLAC %u Hz, %u channels, %u bits, %llu samples, blocks %u-%u, %zu seek points\n",
+        info.m_rate, info.m_channels, info.m_bits, static_cast<unsigned long long>(info.m_sample_count),
+        info.m_min_block, info.m_max_block, info.m_seek_points.size());
+#endif
+    return true;
+}
+
+// Reads the metadata blocks at the start of a FLAC file.
+bool FLACFileReadInfo(const wchar_t *filename, FLACInfo &info)
+{
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"rb") != 0 || fp == nullptr)
+        return false;
+    ScopedFile sfp(fp);
+    return ReadMetadata(fp, info);
+}
+
+// Decodes a range of samples from an open FLAC file, whose
+// metadata has been read into 'info', and closes the file.
+static bool ReadSampleRange(
+        ScopedFile &sfp,
+        FILE *fp,
+        const FLACInfo &info,
+        uint64_t first_sample,
+        uint64_t sample_count,
+        std::vector<int32_t> &samples,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion))
+{
+    // Trim the range to the length of the stream, if it's known.
+    const bool known_length = info.m_sample_count > 0;
+    if (known_length)
+    {
+        if (first_sample >= info.m_sample_count)
+            return false;
+        if (sample_count == 0 || sample_count > info.m_sample_count - first_sample)
+            sample_count = info.m_sample_count - first_sample;
+    }
+
+    // Only read the bytes from the last seek point at or before the
+    // range to the first one after it.
+    uint64_t read_begin = 0;
+    uint64_t read_end = info.m_data_bytes;
+    for (const FLACSeekPoint &point : info.m_seek_points)
+    {
+        if (point.m_sample <= first_sample)
+            read_begin = point.m_offset;
+        else if (known_length && point.m_sample >= first_sample + sample_count)
+        {
+            read_end = point.m_offset;
+            break;
+        }
+    }
+
+    const size_t size = static_cast<size_t>(read_end - read_begin);
+    std::vector<uint8_t> data(size + kReadPadding);
+    if (_fseeki64(fp, static_cast<int64_t>(info.m_data_offset + read_begin), SEEK_SET) ||
+        fread(data.data(), 1, size, fp) != size)
+    {
+        return false;
+    }
+    sfp.Close();
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.1f))
+        return false;
+
+    const unsigned channels = info.m_channels;
+    if (!known_length)
+    {
+        // Without a length to allocate up front, decode the frames
+        // in order and append each one.
+        bool decoded = DecodeFrames(data.data(), size, 0, size, info,
+            [&](const FLACFrameHeader &hdr, const std::vector<int64_t> &channel_data)
+            {
+                uint64_t begin = std::max(hdr.m_first_sample, first_sample);
+                uint64_t end = hdr.m_first_sample + hdr.m_block;
+                if (sample_count)
+                    end = std::min(end, first_sample + sample_count);
+                if (begin < end)
+                {
+                    size_t old_size = samples.size();
+                    samples.resize(old_size + static_cast<size_t>(end - begin) * channels);
+                    CopyFrameSamples(hdr, channel_data, begin, end - begin, &samples[old_size]);
+                }
+                return sample_count == 0 || end < first_sample + sample_count;
+            });
+        if (!decoded || samples.empty())
+            return false;
+    }
+    else
+    {
+        // Each stretch between seek points can be decoded on its
+        // own, so hand them to the thread pool a batch at a time.
+        std::vector<size_t> segments(1, 0);
+        for (const FLACSeekPoint &point : info.m_seek_points)
+        {
+            if (point.m_offset > read_begin && point.m_offset < read_end)
+                segments.push_back(static_cast<size_t>(point.m_offset - read_begin));
+        }
+        segments.push_back(size);
+
+        samples.resize(static_cast<size_t>(sample_count) * channels);
+        const uint64_t range_end = first_sample + sample_count;
+        const size_t num_segments = segments.size() - 1;
+        std::vector<char> segment_ok(num_segments, 0);
+        std::vector<uint64_t> segment_end(num_segments, 0);
+
+        ThreadPool &pool = ThreadPool::GetShared();
+        const size_t batch = static_cast<size_t>(pool.GetConcurrency()) * 4;
+        for (size_t first = 0; first < num_segments; first += batch)
+        {
+            size_t count = std::min(batch, num_segments - first);
+            pool.RunTasks(count, [&](size_t index)
+            {
+                size_t segment = first + index;
+                segment_ok[segment] = DecodeFrames(data.data(), size, segments[segment], segments[segment + 1], info,
+                    [&](const FLACFrameHeader &hdr, const std::vector<int64_t> &channel_data)
+                    {
+                        if (hdr.m_first_sample >= range_end)
+                            return false;
+                        CopyFrameSamples(hdr, channel_data, first_sample, sample_count, samples.data());
+                        segment_end[segment] = hdr.m_first_sample + hdr.m_block;
+                        return true;
+                    });
+            });
+
+            for (size_t segment = first; segment < first + count; segment++)
+            {
+                if (!segment_ok[segment])
+                    return false;
+            }
+
+            if (status_callback_func &&
+                !status_callback_func(status_callback_context,
+                    0.1f + 0.9f * static_cast<float>(first + count) / static_cast<float>(num_segments)))
+            {
+                return false;
+            }
+        }
+
+        // A stream that ends before STREAMINFO says it should has
+        // been truncated.
+        if (*std::max_element(segment_end.begin(), segment_end.end()) < range_end)
+            return false;
+    }
+
+    if (status_callback_func && !status_callback_func(status_callback_context, 1.0f))
+    {
+        samples.clear();
+        return false;
+    }
+
+    return true;
+}
+
+// Decodes a range of samples from a FLAC file.
+bool FLACFileReadSamples(
+        const wchar_t *filename,
+        uint64_t first_sample,
+        uint64_t sample_count,
+        FLACInfo &info,
+        std::vector<int32_t> &samples,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion))
+{
+#ifdef TRACE
+    printf("FLACFileReadSamples '%S' first=%llu count=%llu\n", filename,
+        static_cast<unsigned long long>(first_sample), static_cast<unsigned long long>(sample_count));
+#endif
+
+    samples.clear();
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.0f))
+        return false;
+
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"rb") != 0 || fp == nullptr)
+        return false;
+    ScopedFile sfp(fp);
+    if (!ReadMetadata(fp, info))
+        return false;
+
+    return ReadSampleRange(sfp, fp, info, first_sample, sample_count, samples,
+                           status_callback_context, status_callback_func);
+}
+
+// Decodes a range of samples from a FLAC file whose metadata has
+// already been read.
+bool FLACFileReadSampleRange(
+        const wchar_t *filename,
+        const FLACInfo &info,
+        uint64_t first_sample,
+        uint64_t sample_count,
+        std::vector<int32_t> &samples,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion))
+{
+#ifdef TRACE
+    printf("FLACFileReadSampleRange '%S' first=%llu count=%llu\n", filename,
+        static_cast<unsigned long long>(first_sample), static_cast<unsigned long long>(sample_count));
+#endif
+
+    samples.clear();
+    if (status_callback_func && !status_callback_func(status_callback_context, 0.0f))
+        return false;
+
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"rb") != 0 || fp == nullptr)
+        return false;
+    ScopedFile sfp(fp);
+
+    return ReadSampleRange(sfp, fp, info, first_sample, sample_count, samples,
+                           status_callback_context, status_callback_func);
+}
+
+//-------------------------------------------------------------------
+// Writing
+//-------------------------------------------------------------------
+
+// How a residual is split into Rice-coded partitions.
+struct FLACRicePlan
+{
+    unsigned m_order = 0;                           // Partition order.
+    unsigned m_params[1 << kMaxPartitionOrder];     // Rice parameter for each partition.
+    bool m_wide = false;                            // Uses 5-bit parameters.
+    uint64_t m_bits = 0;                            // Estimated size in bits.
+};
+
+// How a subframe is to be coded.
+struct FLACSubframePlan
+{
+    FLACSubframeType m_type = kSubframeVerbatim;
+    unsigned m_order = 0;
+    unsigned m_precision = 0;                       // LPC coefficient precision.
+    int m_shift = 0;                                // LPC quantization shift.
+    int32_t m_coefs[kMaxLPCOrder] = {};             // LPC coefficients.
+    std::vector<int64_t> m_residual;                // For the samples after the warm-up.
+    FLACRicePlan m_rice;
+    uint64_t m_bits = UINT64_MAX;                   // Estimated size in bits.
+};
+
+// Returns the estimated number of bits to Rice-code 'count' values
+// with parameter 'param', given the sum of their zigzag codes.
+static uint64_t RiceBits(uint64_t count, uint64_t sum, unsigned param)
+{
+    return count * (param + 1) + (sum >> param);
+}
+
+// Chooses the partition order and Rice parameters for a residual.
+// The sums for each finer partition order are added pairwise to
+// get those of the next coarser one.
+static void PlanRice(const int64_t *residual, unsigned block, unsigned order, FLACRicePlan &plan)
+{
+    unsigned max_order = 0;
+    while (max_order < kMaxPartitionOrder &&
+           (block % (2u << max_order)) == 0 && (block >> (max_order + 1)) > order)
+    {
+        max_order++;
+    }
+
+    std::vector<uint64_t> sums(static_cast<size_t>(1) << max_order);
+    const unsigned finest_samples = block >> max_order;
+    size_t i = 0;
+    for (size_t partition = 0; partition < sums.size(); partition++)
+    {
+        size_t end = (partition + 1) * finest_samples - order;
+        uint64_t sum = 0;
+        for (; i < end; i++)
+        {
+            int64_t r = residual[i];
+            sum += (static_cast<uint64_t>(r) << 1) ^ static_cast<uint64_t>(r >> 63);
+        }
+        sums[partition] = sum;
+    }
+
+    plan.m_bits = UINT64_MAX;
+    for (unsigned partition_order = max_order + 1; partition_order-- > 0;)
+    {
+        if (partition_order < max_order)
+        {
+            for (size_t p = 0; p < (static_cast<size_t>(1) << partition_order); p++)
+                sums[p] = sums[2 * p] + sums[2 * p + 1];
+        }
+
+        unsigned params[1 << kMaxPartitionOrder];
+        uint64_t bits = 6;
+        bool wide = false;
+        const unsigned partition_samples = block >> partition_order;
+        for (unsigned p = 0; p < (1u << partition_order); p++)
+        {
+            uint64_t count = p ? partition_samples : partition_samples - order;
+            unsigned best = 0;
+            uint64_t best_bits = RiceBits(count, sums[p], 0);
+            for (unsigned param = 1; param <= 30; param++)
+            {
+                uint64_t param_bits = RiceBits(count, sums[p], param);
+                if (param_bits >= best_bits)
+                    break;
+                best = param;
+                best_bits = param_bits;
+            }
+            params[p] = best;
+            bits += best_bits;
+            wide = wide || best > 14;
+        }
+        bits += (static_cast<uint64_t>(wide ? 5 : 4)) << partition_order;
+
+        if (bits < plan.m_bits)
+        {
+            plan.m_order = partition_order;
+            plan.m_wide = wide;
+            plan.m_bits = bits;
+            memcpy(plan.m_params, params, sizeof(unsigned) << partition_order);
+        }
+    }
+}
+
+// Returns the fixed predictor order whose residual has the smallest
+// sum of magnitudes, and that sum.
+static unsigned ChooseFixedOrder(const int32_t *x, unsigned block, uint64_t &best_sum)
+{
+    uint64_t sums[5] = {};
+    for (unsigned i = 4; i < block; i++)
+    {
+        int64_t e0 = x[i];
+        int64_t e1 = e0 - x[i - 1];
+        int64_t e2 = e1 - (static_cast<int64_t>(x[i - 1]) - x[i - 2]);
+        int64_t e3 = e2 - (static_cast<int64_t>(x[i - 1]) - 2 * static_cast<int64_t>(x[i - 2]) + x[i - 3]);
+        int64_t e4 = e3 - (static_cast<int64_t>(x[i - 1]) - 3 * static_cast<int64_t>(x[i - 2]) +
+                           3 * static_cast<int64_t>(x[i - 3]) - x[i - 4]);
+        sums[0] += static_cast<uint64_t>(e0 < 0 ? -e0 : e0);
+        sums[1] += static_cast<uint64_t>(e1 < 0 ? -e1 : e1);
+        sums[2] += static_cast<uint64_t>(e2 < 0 ? -e2 : e2);
+        sums[3] += static_cast<uint64_t>(e3 < 0 ? -e3 : e3);
+        sums[4] += static_cast<uint64_t>(e4 < 0 ? -e4 : e4);
+    }
+
+    unsigned best = 0;
+    for (unsigned order = 1; order <= 4 && order < block; order++)
+    {
+        if (sums[order] < sums[best])
+            best = order;
+    }
+    best_sum = sums[best];
+    return best;
+}
+
+// Computes the residual of a fixed predictor.
+static void ComputeFixedResidual(const int32_t *x, unsigned block, unsigned order, int64_t *residual)
+{
+    for (unsigned i = order; i < block; i++)
+    {
+        int64_t s1 = order >= 1 ? x[i - 1] : 0;
+        int64_t s2 = order >= 2 ? x[i - 2] : 0;
+        int64_t s3 = order >= 3 ? x[i - 3] : 0;
+        int64_t s4 = order >= 4 ? x[i - 4] : 0;
+        int64_t prediction = 0;
+        switch (order)
+        {
+        case 1: prediction = s1; break;
+        case 2: prediction = 2 * s1 - s2; break;
+        case 3: prediction = 3 * s1 - 3 * s2 + s3; break;
+        case 4: prediction = 4 * s1 - 6 * s2 + 4 * s3 - s4; break;
+        }
+        residual[i - order] = x[i] - prediction;
+    }
+}
+
+// Returns the Tukey (cosine-tapered, with half the window tapered)
+// window that the encoder applies before the autocorrelation.  The
+// one for the usual block size is only computed once.
+static std::vector<double> MakeTukeyWindow(unsigned block)
+{
+    const double pi = 3.14159265358979323846;
+    std::vector<double> window(block, 1.0);
+    unsigned taper = block / 4;
+    for (unsigned i = 0; i < taper; i++)
+    {
+        double w = 0.5 - 0.5 * cos(pi * i / taper);
+        window[i] = w;
+        window[block - 1 - i] = w;
+    }
+    return window;
+}
+
+// Finds the LPC coefficients of each order from 1 to 'max_order'
+// with the Levinson-Durbin recursion.  Returns the number of orders
+// found, which is less than 'max_order' if the signal is perfectly
+// predicted by a lower one.
+static unsigned ComputeLPC(const double *autoc, unsigned max_order,
+                           double coefs[kMaxLPCOrder][kMaxLPCOrder], double *errors)
+{
+    double lpc[kMaxLPCOrder];
+    double error = autoc[0];
+    for (unsigned i = 0; i < max_order; i++)
+    {
+        double r = -autoc[i + 1];
+        for (unsigned j = 0; j < i; j++)
+            r -= lpc[j] * autoc[i - j];
+        r /= error;
+
+        lpc[i] = r;
+        unsigned j = 0;
+        for (; j < i / 2; j++)
+        {
+            double tmp = lpc[j];
+            lpc[j] += r * lpc[i - 1 - j];
+            lpc[i - 1 - j] += r * tmp;
+        }
+        if (i & 1)
+            lpc[j] += lpc[j] * r;
+
+        error *= 1.0 - r * r;
+        for (j = 0; j <= i; j++)
+            coefs[i][j] = -lpc[j];
+        errors[i] = error;
+        if (error <= 0.0)
+            return i + 1;
+    }
+    return max_order;
+}
+
+// Quantizes LPC coefficients to 'precision' bits, carrying each
+// one's rounding error into the next.  Returns false if they can't
+// be represented.
+static bool QuantizeLPC(const double *coefs, unsigned order, unsigned precision, int32_t *quantized, int &shift)
+{
+    double cmax = 0.0;
+    for (unsigned i = 0; i < order; i++)
+        cmax = std::max(cmax, fabs(coefs[i]));
+    if (cmax <= 0.0)
+        return false;
+
+    int log2cmax = 0;
+    frexp(cmax, &log2cmax);
+    shift = static_cast<int>(precision) - log2cmax - 1;
+    if (shift < 0)
+        return false;
+    shift = std::min(shift, 15);
+
+    const int32_t qmax = (1 << (precision - 1)) - 1;
+    const int32_t qmin = -qmax - 1;
+    double error = 0.0;
+    for (unsigned i = 0; i < order; i++)
+    {
+        error += coefs[i] * (1 << shift);
+        int32_t q = static_cast<int32_t>(floor(error + 0.5));
+        q = std::max(qmin, std::min(qmax, q));
+        error -= q;
+        quantized[i] = q;
+    }
+    return true;
+}
+
+// Computes the residual of a quantized LPC predictor.  Returns
+// false if any residual doesn't fit in 32 bits, which decoders
+// aren't required to handle.
+static bool ComputeLPCResidual(const int32_t *x, unsigned block, const int32_t *coefs,
+                               unsigned order, int shift, int64_t *residual)
+{
+    for (unsigned i = order; i < block; i++)
+    {
+        int64_t sum = 0;
+        for (unsigned j = 0; j < order; j++)
+            sum += static_cast<int64_t>(coefs[j]) * x[i - 1 - j];
+        int64_t r = x[i] - (sum >> shift);
+        if (r > INT32_MAX || r < INT32_MIN)
+            return false;
+        residual[i - order] = r;
+    }
+    return true;
+}
+
+// Returns the number of bits that a subframe header and the warm-up
+// samples and coefficients of a plan take.
+static uint64_t SubframeOverheadBits(const FLACSubframePlan &plan, unsigned bits)
+{
+    uint64_t overhead = 8 + static_cast<uint64_t>(plan.m_order) * bits;
+    if (plan.m_type == kSubframeLPC)
+        overhead += 4 + 5 + static_cast<uint64_t>(plan.m_order) * plan.m_precision;
+    return overhead;
+}
+
+// Works out the smallest way to code one channel of a block.
+static void PlanSubframe(const int32_t *x, unsigned block, unsigned bits, FLACSubframePlan &plan)
+{
+    plan.m_type = kSubframeVerbatim;
+    plan.m_order = 0;
+    plan.m_bits = 8 + static_cast<uint64_t>(block) * bits;
+
+    bool constant = true;
+    for (unsigned i = 1; i < block && constant; i++)
+        constant = x[i] == x[0];
+    if (constant)
+    {
+        plan.m_type = kSubframeConstant;
+        plan.m_bits = 8 + bits;
+        return;
+    }
+
+    FLACSubframePlan candidate;
+    candidate.m_residual.resize(block);
+
+    // The best fixed predictor.
+    uint64_t fixed_sum = 0;
+    candidate.m_type = kSubframeFixed;
+    candidate.m_order = ChooseFixedOrder(x, block, fixed_sum);
+    ComputeFixedResidual(x, block, candidate.m_order, candidate.m_residual.data());
+    PlanRice(candidate.m_residual.data(), block, candidate.m_order, candidate.m_rice);
+    candidate.m_bits = SubframeOverheadBits(candidate, bits) + candidate.m_rice.m_bits;
+    if (candidate.m_bits < plan.m_bits)
+        std::swap(plan, candidate);
+
+    // The LPC predictors of the two orders that the prediction error
+    // suggests will be smallest.
+    const unsigned max_order = std::min(kMaxLPCOrder, block / 2);
+    if (max_order < 1)
+        return;
+
+    static const std::vector<double> standard_window = MakeTukeyWindow(kBlockSize);
+    std::vector<double> window = block == kBlockSize ? std::vector<double>() : MakeTukeyWindow(block);
+    const double *w = block == kBlockSize ? standard_window.data() : window.data();
+    std::vector<double> windowed(block);
+    for (unsigned i = 0; i < block; i++)
+        windowed[i] = x[i] * w[i];
+
+    double autoc[kMaxLPCOrder + 1];
+    for (unsigned lag = 0; lag <= max_order; lag++)
+    {
+        double sum = 0.0;
+        for (unsigned i = lag; i < block; i++)
+            sum += windowed[i] * windowed[i - lag];
+        autoc[lag] = sum;
+    }
+    if (autoc[0] <= 0.0)
+        return;
+
+    double coefs[kMaxLPCOrder][kMaxLPCOrder];
+    double errors[kMaxLPCOrder];
+    unsigned orders = ComputeLPC(autoc, max_order, coefs, errors);
+
+    unsigned precision = 12;
+    if (bits < 16)
+        precision = std::max(5u, 2 + bits / 2);
+    else if (block <= 1152)
+        precision = 10;
+
+    double estimates[kMaxLPCOrder];
+    for (unsigned i = 0; i < orders; i++)
+    {
+        double per_sample = errors[i] > 0.0 ? 0.5 * log2(0.5 * errors[i] / block) : 0.0;
+        estimates[i] = std::max(0.0, per_sample) * (block - i - 1) + (i + 1) * (bits + precision);
+    }
+
+    for (unsigned attempt = 0; attempt < 2 && attempt < orders; attempt++)
+    {
+        unsigned best = 0;
+        for (unsigned i = 1; i < orders; i++)
+        {
+            if (estimates[i] < estimates[best])
+                best = i;
+        }
+        estimates[best] = HUGE_VAL;
+
+        candidate.m_type = kSubframeLPC;
+        candidate.m_order = best + 1;
+        candidate.m_precision = precision;
+        candidate.m_residual.resize(block);
+        if (!QuantizeLPC(coefs[best], candidate.m_order, precision, candidate.m_coefs, candidate.m_shift) ||
+            !ComputeLPCResidual(x, block, candidate.m_coefs, candidate.m_order, candidate.m_shift,
+                                candidate.m_residual.data()))
+        {
+            continue;
+        }
+        PlanRice(candidate.m_residual.data(), block, candidate.m_order, candidate.m_rice);
+        candidate.m_bits = SubframeOverheadBits(candidate, bits) + candidate.m_rice.m_bits;
+        if (candidate.m_bits < plan.m_bits)
+            std::swap(plan, candidate);
+    }
+}
+
+// Writes a residual with the partitions and parameters of a plan.
+static void WriteResidual(FLACBitWriter &bw, const int64_t *residual, unsigned block,
+                          unsigned order, const FLACRicePlan &rice)
+{
+    bw.Put(rice.m_wide ? 1 : 0, 2);
+    bw.Put(rice.m_order, 4);
+    const unsigned partition_samples = block >> rice.m_order;
+    for (unsigned p = 0; p < (1u << rice.m_order); p++)
+    {
+        const unsigned param = rice.m_params[p];
+        bw.Put(param, rice.m_wide ? 5 : 4);
+        unsigned count = p ? partition_samples : partition_samples - order;
+        for (unsigned i = 0; i < count; i++)
+        {
+            int64_t r = *residual++;
+            uint64_t value = (static_cast<uint64_t>(r) << 1) ^ static_cast<uint64_t>(r >> 63);
+            uint64_t high = value >> param;
+            if (high + 1 + param <= 32)
+            {
+                // The unary zeros, the stop bit, and the low bits
+                // all fit in one field.
+                bw.Put((static_cast<uint64_t>(1) << param) | (value & ((static_cast<uint64_t>(1) << param) - 1)),
+                       static_cast<unsigned>(high) + 1 + param);
+            }
+            else
+            {
+                bw.PutZeros(high);
+                bw.Put(1, 1);
+                bw.Put(value, param);
+            }
+        }
+    }
+}
+
+// Writes one channel of a block as a subframe.
+static void WriteSubframe(FLACBitWriter &bw, const int32_t *x, unsigned block, unsigned bits)
+{
+    // Drop any low bits that are zero in every sample.
+    uint32_t all_bits = 0;
+    for (unsigned i = 0; i < block; i++)
+        all_bits |= static_cast<uint32_t>(x[i]);
+    unsigned wasted = 0;
+    while (all_bits && !(all_bits & (1u << wasted)) && wasted + 1 < bits)
+        wasted++;
+
+    std::vector<int32_t> shifted;
+    if (wasted)
+    {
+        shifted.resize(block);
+        for (unsigned i = 0; i < block; i++)
+            shifted[i] = x[i] >> wasted;
+        x = shifted.data();
+        bits -= wasted;
+    }
+
+    FLACSubframePlan plan;
+    PlanSubframe(x, block, bits, plan);
+
+    unsigned type = 1;
+    if (plan.m_type == kSubframeConstant)
+        type = 0;
+    else if (plan.m_type == kSubframeFixed)
+        type = 8 + plan.m_order;
+    else if (plan.m_type == kSubframeLPC)
+        type = 31 + plan.m_order;
+    bw.Put(type, 7);
+    if (wasted)
+    {
+        bw.Put(1, 1);
+        bw.PutZeros(wasted - 1);
+        bw.Put(1, 1);
+    }
+    else
+    {
+        bw.Put(0, 1);
+    }
+
+    switch (plan.m_type)
+    {
+    case kSubframeConstant:
+        bw.Put(static_cast<uint32_t>(x[0]), bits);
+        break;
+    case kSubframeVerbatim:
+        for (unsigned i = 0; i < block; i++)
+            bw.Put(static_cast<uint32_t>(x[i]), bits);
+        break;
+    case kSubframeFixed:
+    case kSubframeLPC:
+        for (unsigned i = 0; i < plan.m_order; i++)
+            bw.Put(static_cast<uint32_t>(x[i]), bits);
+        if (plan.m_type == kSubframeLPC)
+        {
+            bw.Put(plan.m_precision - 1, 4);
+            bw.Put(static_cast<unsigned>(plan.m_shift), 5);
+            for (unsigned i = 0; i < plan.m_order; i++)
+                bw.Put(static_cast<uint32_t>(plan.m_coefs[i]), plan.m_precision);
+        }
+        WriteResidual(bw, plan.m_residual.data(), block, plan.m_order, plan.m_rice);
+        break;
+    }
+}
+
+// Returns a rough estimate of the bits needed to code a channel,
+// based on the residual of its best fixed predictor, but no more
+// than storing it verbatim.
+static double EstimateChannelBits(const int32_t *x, unsigned block, unsigned bits)
+{
+    uint64_t sum = 0;
+    ChooseFixedOrder(x, block, sum);
+    double mean = 2.0 * static_cast<double>(sum) / block; // Of the zigzag codes.
+    double param = mean > 1.0 ? floor(log2(mean)) : 0.0;
+    return block * std::min<double>(bits, param + 1.0 + mean / pow(2.0, param));
+}
+
+// Settings shared by all the frames of a file being written.
+struct FLACEncoderSetup
+{
+    const float *m_samples = nullptr;
+    uint64_t m_sample_count = 0;
+    unsigned m_channels = 0;
+    unsigned m_bits = 0;
+    unsigned m_rate_code = 0;
+    unsigned m_bits_code = 0;
+};
+
+// Encodes frame number 'frame' into 'out'.
+static void EncodeFrame(const FLACEncoderSetup &setup, uint64_t frame, std::vector<uint8_t> &out)
+{
+    const uint64_t first = frame * kBlockSize;
+    const unsigned block = static_cast<unsigned>(std::min<uint64_t>(kBlockSize, setup.m_sample_count - first));
+    const unsigned channels = setup.m_channels;
+
+    // Scale, round, and clip the samples, one channel after another.
+    const double scale = static_cast<double>((static_cast<uint64_t>(1) << (setup.m_bits - 1)) - 1);
+    std::vector<int32_t> data(static_cast<size_t>(block) * channels);
+    const float *in = setup.m_samples + first * channels;
+    for (unsigned i = 0; i < block; i++)
+    {
+        for (unsigned ch = 0; ch < channels; ch++)
+        {
+            double value = floor(*in++ * scale + 0.5);
+            value = std::max(-scale - 1.0, std::min(scale, value));
+            data[ch * block + i] = static_cast<int32_t>(value);
+        }
+    }
+
+    // Try coding a stereo pair as its difference and either side of
+    // it, or as the average and difference, using whichever looks
+    // smallest.  The side channel needs an extra bit, so this is only
+    // done while that still fits in 32 bits.
+    unsigned assignment = channels - 1;
+    if (channels == 2 && setup.m_bits < 31 && block > 4)
+    {
+        std::vector<int32_t> mid_side(2 * static_cast<size_t>(block));
+        int32_t *left = data.data();
+        int32_t *right = left + block;
+        int32_t *mid = mid_side.data();
+        int32_t *side = mid + block;
+        for (unsigned i = 0; i < block; i++)
+        {
+            mid[i] = static_cast<int32_t>((static_cast<int64_t>(left[i]) + right[i]) >> 1);
+            side[i] = left[i] - right[i];
+        }
+
+        double left_bits = EstimateChannelBits(left, block, setup.m_bits);
+        double right_bits = EstimateChannelBits(right, block, setup.m_bits);
+        double mid_bits = EstimateChannelBits(mid, block, setup.m_bits);
+        double side_bits = EstimateChannelBits(side, block, setup.m_bits + 1);
+        double best = left_bits + right_bits;
+        if (left_bits + side_bits < best)
+        {
+            best = left_bits + side_bits;
+            assignment = kLeftSide;
+        }
+        if (side_bits + right_bits < best)
+        {
+            best = side_bits + right_bits;
+            assignment = kSideRight;
+        }
+        if (mid_bits + side_bits < best)
+            assignment = kMidSide;
+
+        if (assignment == kLeftSide)
+            memcpy(right, side, block * sizeof(int32_t));
+        else if (assignment == kSideRight)
+            memcpy(left, side, block * sizeof(int32_t));
+        else if (assignment == kMidSide)
+            data.swap(mid_side);
+    }
+
+    out.clear();
+    out.reserve(static_cast<size_t>(block) * channels * setup.m_bits / 8 + 64);
+    FLACBitWriter bw(out);
+
+    // The frame header, numbered by frame since the blocks are all
+    // the same size except the last.
+    unsigned block_code = 7;
+    if (block == kBlockSize)
+        block_code = 12;
+    else if (block <= 256)
+        block_code = 6;
+    bw.Put(0xFFF8, 16);
+    bw.Put(block_code, 4);
+    bw.Put(setup.m_rate_code, 4);
+    bw.Put(assignment, 4);
+    bw.Put(setup.m_bits_code, 3);
+    bw.Put(0, 1);
+
+    if (frame < 0x80)
+    {
+        bw.Put(frame, 8);
+    }
+    else
+    {
+        unsigned extra = 1;
+        while (extra < 6 && (frame >> (6 * extra)) >= (static_cast<uint64_t>(1) << (6 - extra)))
+            extra++;
+        bw.Put((0xFF00u >> (extra + 1)) | (frame >> (6 * extra)), 8);
+        while (extra-- > 0)
+            bw.Put(0x80 | ((frame >> (6 * extra)) & 0x3F), 8);
+    }
+
+    if (block_code == 6)
+        bw.Put(block - 1, 8);
+    else if (block_code == 7)
+        bw.Put(block - 1, 16);
+    bw.Put(ComputeCRC8(out.data(), out.size()), 8);
+
+    for (unsigned ch = 0; ch < channels; ch++)
+    {
+        bool side = (assignment == kLeftSide && ch == 1) ||
+                    (assignment == kSideRight && ch == 0) ||
+                    (assignment == kMidSide && ch == 1);
+        WriteSubframe(bw, &data[ch * block], block, setup.m_bits + (side ? 1 : 0));
+    }
+
+    bw.AlignToByte();
+    bw.Put(ComputeCRC16(out.data(), out.size()), 16);
+}
+
+// Builds the metadata blocks that follow the stream marker.
+static std::vector<uint8_t> BuildMetadata(const FLACEncoderSetup &setup, unsigned rate,
+                                          unsigned min_frame, unsigned max_frame,
+                                          const std::vector<FLACSeekPoint> &seek_points)
+{
+    std::vector<uint8_t> out;
+    FLACBitWriter bw(out);
+
+    bw.Put(seek_points.empty() ? 0x80 : 0x00, 8);
+    bw.Put(kStreamInfoBytes, 24);
+    bw.Put(kBlockSize, 16);
+    bw.Put(kBlockSize, 16);
+    bw.Put(min_frame, 24);
+    bw.Put(max_frame, 24);
+    bw.Put(rate, 20);
+    bw.Put(setup.m_channels - 1, 3);
+    bw.Put(setup.m_bits - 1, 5);
+    bw.Put(setup.m_sample_count >> 32, 4);
+    bw.Put(setup.m_sample_count, 32);
+    bw.PutZeros(128); // The MD5 signature isn't computed.
+
+    if (!seek_points.empty())
+    {
+        bw.Put(0x83, 8);
+        bw.Put(seek_points.size() * kSeekPointBytes, 24);
+        for (const FLACSeekPoint &point : seek_points)
+        {
+            bw.Put(point.m_sample >> 32, 32);
+            bw.Put(point.m_sample, 32);
+            bw.Put(point.m_offset >> 32, 32);
+            bw.Put(point.m_offset, 32);
+            bw.Put(std::min<uint64_t>(kBlockSize, setup.m_sample_count - point.m_sample), 16);
+        }
+    }
+    return out;
+}
+
+// Encodes a buffer of interleaved floating-point audio samples
+// and writes them to a FLAC file.
+bool FLACFileWrite(
+        const wchar_t *filename,
+        const float *samples,
+        size_t sample_count,
+        unsigned channels,
+        unsigned rate,
+        unsigned bits,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion))
+{
+#ifdef TRACE
+    printf("FLACFileWrite '%S', %u Hz, %u channels, %u bits\n", filename, rate, channels, bits);
+#endif
+
+    if (channels < 1 || channels > 8 || bits < 8 || bits > 32 || rate < 1 || rate > 655350 ||
+        static_cast<uint64_t>(sample_count) >= (static_cast<uint64_t>(1) << 36) ||
+        (samples == nullptr && sample_count > 0))
+    {
+        return false;
+    }
+
+    static const unsigned kRates[11] = { 8000, 16000, 22050, 24000, 32000, 44100, 48000, 88200, 96000, 176400, 192000 };
+    static const unsigned kRateCodes[11] = { 4, 5, 6, 7, 8, 9, 10, 1, 11, 2, 3 };
+    static const unsigned kBitsCodes[33] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 4,
+                                             0, 0, 0, 5, 0, 0, 0, 6, 0, 0, 0, 0, 0, 0, 0, 7 };
+
+    FLACEncoderSetup setup;
+    setup.m_samples = samples;
+    setup.m_sample_count = sample_count;
+    setup.m_channels = channels;
+    setup.m_bits = bits;
+    setup.m_bits_code = kBitsCodes[bits];
+    for (unsigned i = 0; i < 11; i++)
+    {
+        if (rate == kRates[i])
+            setup.m_rate_code = kRateCodes[i];
+    }
+
+    // Place a seek point at the first frame of every couple of
+    // seconds.  Their offsets are filled in as the frames are
+    // written.
+    const uint64_t frame_count = (setup.m_sample_count + kBlockSize - 1) / kBlockSize;
+    const uint64_t seek_stride = std::max<uint64_t>(1, (static_cast<uint64_t>(rate) * kSeekPointSeconds + kBlockSize / 2) / kBlockSize);
+    std::vector<FLACSeekPoint> seek_points(static_cast<size_t>((frame_count + seek_stride - 1) / seek_stride));
+    for (size_t i = 0; i < seek_points.size(); i++)
+        seek_points[i].m_sample = i * seek_stride * kBlockSize;
+
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"wb") != 0 || fp == nullptr)
+        return false;
+    ScopedFile sfp(fp);
+
+    std::vector<uint8_t> metadata = BuildMetadata(setup, rate, 0, 0, seek_points);
+    if (fwrite("fLaC", 1, 4, fp) != 4 || fwrite(metadata.data(), 1, metadata.size(), fp) != metadata.size())
+        return false;
+
+    uint64_t offset = 0;
+    unsigned min_frame = UINT32_MAX;
+    unsigned max_frame = 0;
+    std::vector<std::vector<uint8_t>> frames(static_cast<size_t>(std::min<uint64_t>(frame_count, kFramesPerBatch)));
+    ThreadPool &pool = ThreadPool::GetShared();
+    for (uint64_t first = 0; first < frame_count; first += frames.size())
+    {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(frames.size(), frame_count - first));
+        pool.RunTasks(count, [&](size_t index)
+        {
+            EncodeFrame(setup, first + index, frames[index]);
+        });
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint64_t frame = first + i;
+            if (frame % seek_stride == 0)
+                seek_points[static_cast<size_t>(frame / seek_stride)].m_offset = offset;
+
+            const unsigned size = static_cast<unsigned>(frames[i].size());
+            min_frame = std::min(min_frame, size);
+            max_frame = std::max(max_frame, size);
+            offset += size;
+            if (fwrite(frames[i].data(), 1, size, fp) != size)
+            {
+#ifdef TRACE
+                printf("FLACFileWrite failed writing frame %llu\n", static_cast<unsigned long long>(frame));
+#endif
+                return false;
+            }
+        }
+
+        if (status_callback_func &&
+            !status_callback_func(status_callback_context,
+                static_cast<float>(first + count) / static_cast<float>(frame_count)))
+        {
+            return false;
+        }
+    }
+
+    // Go back and fill in the frame sizes and seek point offsets.
+    if (frame_count == 0)
+        min_frame = 0;
+    metadata = BuildMetadata(setup, rate, min_frame, max_frame, seek_points);
+    if (_fseeki64(fp, 4, SEEK_SET) || fwrite(metadata.data(), 1, metadata.size(), fp) != metadata.size())
+        return false;
+
+    sfp.Close();
+    return true;
+}
@@ -0,0 +1,147 @@
+//-------------------------------------------------------------------
+//
+// flacfile.h
+//
+// C++ module for reading and writing FLAC (Free Lossless Audio
+// Codec) files.
+//
+// Note this module intentionally doesn't use any definitions from
+// windows.h so we can avoid including it here.
+//
+// Limitations:
+//
+// * The MD5 signature of the audio data isn't computed when writing
+//   or checked when reading.
+// * Metadata other than STREAMINFO and SEEKTABLE is skipped when
+//   reading and not written.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// One point of a FLAC file's SEEKTABLE.
+struct FLACSeekPoint
+{
+    uint64_t m_sample = 0;          // Number of the first sample (per channel) in the frame.
+    uint64_t m_offset = 0;          // Offset of the frame from the first frame, in bytes.
+};
+
+// Describes the audio stream in a FLAC file.
+struct FLACInfo
+{
+    unsigned m_rate = 0;            // Sample rate in Hertz.
+    unsigned m_channels = 0;        // Channel count, 1 to 8.
+    unsigned m_bits = 0;            // Bits per sample, 4 to 32.
+    uint64_t m_sample_count = 0;    // Number of samples (per channel), or 0 if unknown.
+    unsigned m_min_block = 0;       // Smallest block size in samples.
+    unsigned m_max_block = 0;       // Largest block size in samples.
+    uint64_t m_data_offset = 0;     // File offset of the first audio frame.
+    uint64_t m_data_bytes = 0;      // Number of bytes from the first frame to the end of the file.
+    std::vector<FLACSeekPoint> m_seek_points;   // From the SEEKTABLE, if there is one.
+};
+
+// Reads the metadata blocks at the start of a FLAC file, without
+// decoding any audio.
+//
+// Returns true if successful.
+bool FLACFileReadInfo(const wchar_t *filename, FLACInfo &info);
+
+// Decodes 'sample_count' samples per channel starting at sample
+// 'first_sample' from a FLAC file, into interleaved 32-bit integers
+// holding the values as stored (for example, -32768 to 32767 for
+// 16-bit audio).  A count of zero means the rest of the file.
+//
+// Decoding starts at the last seek point at or before the range,
+// so only the part of the file holding the range is read.  When
+// decoding from the start of a file with a SEEKTABLE, the stretches
+// between seek points are decoded in parallel on the shared thread
+// pool.  The frame CRCs are checked.
+//
+// If a pointer to a status callback function is provided, it's
+// called as decoding progresses with the completion from 0.0 to 1.0.
+// If it returns false, decoding stops and this returns false.
+//
+// Returns true if successful.
+bool FLACFileReadSamples(
+        const wchar_t *filename,
+        uint64_t first_sample,
+        uint64_t sample_count,
+        FLACInfo &info,
+        std::vector<int32_t> &samples,
+        void *status_callback_context = nullptr,
+        bool (*status_callback_func)(void *context, float completion) = nullptr);
+
+// Same as FLACFileReadSamples, but for a file whose metadata has
+// already been read with FLACFileReadInfo, so it isn't read again.
+// This is for reading a file a range at a time.
+//
+// Returns true if successful.
+bool FLACFileReadSampleRange(
+        const wchar_t *filename,
+        const FLACInfo &info,
+        uint64_t first_sample,
+        uint64_t sample_count,
+        std::vector<int32_t> &samples,
+        void *status_callback_context = nullptr,
+        bool (*status_callback_func)(void *context, float completion) = nullptr);
+
+// Encodes a buffer of interleaved floating-point audio samples,
+// nominally ranging from -1.0 to 1.0, and writes them to a FLAC
+// file with 'bits' (8 to 32) bits per sample.  Each sample is
+// scaled by 2^(bits - 1) - 1, rounded, and clipped.
+//
+// Each block of samples is coded with whichever of the fixed and
+// LPC predictors, stereo decorrelation modes, and Rice partitions
+// makes it smallest.  Blocks are encoded in parallel batches on the
+// shared thread pool and written in order, followed by a SEEKTABLE
+// with a point about every two seconds.
+//
+// The status callback works the same as in FLACFileReadSamples.
+//
+// Returns true if successful.
+bool FLACFileWrite(
+        const wchar_t *filename,
+        const float *samples,
+        size_t sample_count,
+        unsigned channels,
+        unsigned rate,
+        unsigned bits,
+        void *status_callback_context = nullptr,
+        bool (*status_callback_func)(void *context, float completion) = nullptr);
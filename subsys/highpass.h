@@ -44,6 +44,8 @@
 #include <vector>
 #include <numeric>
 #include <cmath>
+#include "segmentedfilter.h"
+#include "denormals.h"
 #pragma once
 
 // Class to help apply a high-pass filter to a series of audio samples.
@@ -68,12 +70,34 @@ public:
     {
         float outputSample = m_alpha * (m_prevOutput + inputSample - m_prevInput);
         m_prevInput = inputSample;
-        m_prevOutput = outputSample;
+        m_prevOutput = FlushDenormal(outputSample);
         return outputSample;
     }
 
+    // Applies the filter to 'count' samples from 'in', writing them
+    // to 'out', which may be the same as 'in'.
+    void FilterSamples(const float *in, float *out, size_t count)
+    {
+        for (size_t index = 0; index < count; index++)
+            out[index] = FilterSample(in[index]);
+    }
+
+    // Clears the filter's history, as if no samples had been filtered.
+    void Reset()
+    {
+        m_prevInput = 0.0f;
+        m_prevOutput = 0.0f;
+    }
+
+    // Returns the number of samples it takes for a change in the
+    // filter's history to die away to within 'tolerance'.
+    size_t GetSettlingSamples(float tolerance) const
+    {
+        return FilterSettlingSamples(m_alpha, 1.0, tolerance);
+    }
+
 private:
-    const float pi = 3.1415927f;
+    static constexpr float pi = 3.1415927f;
     float m_cutoffFrequency = 0.0f;
     float m_sampleRate = 0.0f;
     float m_alpha = 0.0f;
@@ -44,6 +44,8 @@
 #include <vector>
 #include <numeric>
 #include <cmath>
+#include "segmentedfilter.h"
+#include "denormals.h"
 #pragma once
 
 // Class to help apply a low-pass filter to a series of audio samples.
@@ -72,12 +74,30 @@ public:
     float FilterSample(float input_sample)
     {
         float output_sample = m_alpha * input_sample + (1.0f - m_alpha) * m_previous_output;
-        m_previous_output = output_sample;
+        m_previous_output = FlushDenormal(output_sample);
         return output_sample;
     }
 
+    // Applies the filter to 'count' samples from 'in', writing them
+    // to 'out', which may be the same as 'in'.
+    void FilterSamples(const float *in, float *out, size_t count)
+    {
+        for (size_t index = 0; index < count; index++)
+            out[index] = FilterSample(in[index]);
+    }
+
+    // Clears the filter's history, as if no samples had been filtered.
+    void Reset() { m_previous_output = 0.0f; }
+
+    // Returns the number of samples it takes for a change in the
+    // filter's history to die away to within 'tolerance'.
+    size_t GetSettlingSamples(float tolerance) const
+    {
+        return FilterSettlingSamples(1.0 - m_alpha, 1.0, tolerance);
+    }
+
 private:
-    const float pi = 3.1415927f;
+    static constexpr float pi = 3.1415927f;
     float m_alpha = 0.0;
     float m_previous_output = 0.0;
 };
@@ -0,0 +1,1359 @@
+//-------------------------------------------------------------------
+//
+// mp3encoder.cpp
+//
+// C++ module for encoding audio samples as an MPEG-1 Layer III
+// (MP3) file.
+//
+// The encoder follows the reference model in ISO 11172-3 Annex C:
+// a polyphase analysis filterbank, an 18-point MDCT per subband
+// with the aliasing butterflies, and Huffman coding of the
+// quantized lines.  Each granule's step size is the finest one
+// whose Huffman coding fits the frame.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#include "mp3encoder.h"
+#include "threadpool.h"
+#include "platform.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
+//#define TRACE // Define TRACE to enable debug printfs in this module.
+
+// Handy class to auto-close a stdio FILE when it goes out of scope.
+class ScopedFile
+{
+public:
+    explicit ScopedFile(FILE *file) : m_file(file) { }
+    ~ScopedFile() { Close(); }
+    void Close() { if (m_file) fclose(m_file); m_file = nullptr; }
+
+private:
+    FILE *m_file;
+};
+
+static const unsigned kFrameSamples = 1152;      // Samples per channel in a frame.
+static const unsigned kGranuleLines = 576;       // Frequency lines in a granule.
+static const unsigned kMaxQuantized = 15 + 8191; // Largest value the Huffman tables can code.
+static const unsigned kMaxPart23Bits = 4095;     // Largest part2_3_length in the side info.
+
+// The filterbank and MDCT delay the decoded audio by 1057 samples.
+// The encoder reads its input this many samples late to round the
+// delay up to one whole frame.  That also means the first granule
+// the decoder overlaps with, which is never sent, is silent.
+static const int kInputDelay = static_cast<int>(kFrameSamples) - 1057;
+
+// The number of frames encoded in parallel between file writes.
+static const size_t kFramesPerBatch = 1024;
+
+// Layer III bit rates in kilobits per second, by bit rate index.
+static const unsigned g_bitrates[15] =
+{
+    0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320
+};
+
+// MPEG-1 sample rates in Hertz, by sample rate index.
+static const unsigned g_rates[3] = { 44100, 48000, 32000 };
+
+// Starting lines of the long block scale factor bands, by sample
+// rate index.
+static const uint16_t g_sfb_long[3][23] =
+{
+    { 0, 4, 8, 12, 16, 20, 24, 30, 36, 44, 52, 62, 74, 90, 110, 134, 162, 196, 238, 288, 342, 418, 576 },
+    { 0, 4, 8, 12, 16, 20, 24, 30, 36, 42, 50, 60, 72, 88, 106, 128, 156, 190, 230, 276, 330, 384, 576 },
+    { 0, 4, 8, 12, 16, 20, 24, 30, 36, 44, 54, 66, 82, 102, 126, 156, 194, 240, 296, 364, 448, 550, 576 }
+};
+
+// Aliasing butterfly coefficients, cs[i] and ca[i] from ISO
+// 11172-3 Table B.9.
+static const float g_aa_cs[8] =
+{
+    0.85749293f, 0.88174200f, 0.94962865f, 0.98331459f,
+    0.99551782f, 0.99916056f, 0.99989920f, 0.99999316f
+};
+static const float g_aa_ca[8] =
+{
+    0.51449576f, 0.47173197f, 0.31337745f, 0.18191320f,
+    0.09457419f, 0.04096558f, 0.01419856f, 0.00369997f
+};
+
+// The ISO 11172-3 synthesis window D[i] scaled by 65536.  The
+// analysis window is C[i] = D[i] / 32.
+static const int32_t g_window[512] =
+{
+    0, -1, -1, -1, -1, -1, -1, -2, -2, -2, -2, -3,
+    -3, -4, -4, -5, -6, -6, -7, -7, -8, -9, -10, -11,
+    -13, -14, -16, -17, -19, -21, -24, -26, -29, -31, -35, -38,
+    -41, -45, -49, -53, -58, -63, -68, -73, -79, -85, -91, -97,
+    -104, -111, -117, -125, -132, -139, -147, -154, -161, -169, -176, -183,
+    -190, -196, -202, -208, 213, 218, 222, 225, 227, 228, 228, 227,
+    224, 221, 215, 208, 200, 189, 177, 163, 146, 127, 106, 83,
+    57, 29, -2, -36, -72, -111, -153, -197, -244, -294, -347, -401,
+    -459, -519, -581, -645, -711, -779, -848, -919, -991, -1064, -1137, -1210,
+    -1283, -1356, -1428, -1498, -1567, -1634, -1698, -1759, -1817, -1870, -1919, -1962,
+    -2001, -2032, -2057, -2075, -2085, -2087, -2080, -2063, 2037, 2000, 1952, 1893,
+    1822, 1739, 1644, 1535, 1414, 1280, 1131, 970, 794, 605, 402, 185,
+    -45, -288, -545, -814, -1095, -1388, -1692, -2006, -2330, -2663, -3004, -3351,
+    -3705, -4063, -4425, -4788, -5153, -5517, -5879, -6237, -6589, -6935, -7271, -7597,
+    -7910, -8209, -8491, -8755, -8998, -9219, -9416, -9585, -9726, -9838, -9916, -9959,
+    -9966, -9935, -9863, -9750, -9592, -9389, -9139, -8840, -8492, -8092, -7640, -7134,
+    6574, 5959, 5288, 4561, 3776, 2935, 2037, 1082, 70, -998, -2122, -3300,
+    -4533, -5818, -7154, -8540, -9974, -11455, -12980, -14548, -16155, -17799, -19478, -21189,
+    -22929, -24694, -26482, -28289, -30112, -31947, -33791, -35640, -37489, -39336, -41176, -43006,
+    -44821, -46617, -48390, -50137, -51853, -53534, -55178, -56778, -58333, -59838, -61289, -62684,
+    -64019, -65290, -66494, -67629, -68692, -69679, -70590, -71420, -72169, -72835, -73415, -73908,
+    -74313, -74630, -74856, -74992, 75038, 74992, 74856, 74630, 74313, 73908, 73415, 72835,
+    72169, 71420, 70590, 69679, 68692, 67629, 66494, 65290, 64019, 62684, 61289, 59838,
+    58333, 56778, 55178, 53534, 51853, 50137, 48390, 46617, 44821, 43006, 41176, 39336,
+    37489, 35640, 33791, 31947, 30112, 28289, 26482, 24694, 22929, 21189, 19478, 17799,
+    16155, 14548, 12980, 11455, 9974, 8540, 7154, 5818, 4533, 3300, 2122, 998,
+    -70, -1082, -2037, -2935, -3776, -4561, -5288, -5959, 6574, 7134, 7640, 8092,
+    8492, 8840, 9139, 9389, 9592, 9750, 9863, 9935, 9966, 9959, 9916, 9838,
+    9726, 9585, 9416, 9219, 8998, 8755, 8491, 8209, 7910, 7597, 7271, 6935,
+    6589, 6237, 5879, 5517, 5153, 4788, 4425, 4063, 3705, 3351, 3004, 2663,
+    2330, 2006, 1692, 1388, 1095, 814, 545, 288, 45, -185, -402, -605,
+    -794, -970, -1131, -1280, -1414, -1535, -1644, -1739, -1822, -1893, -1952, -2000,
+    2037, 2063, 2080, 2087, 2085, 2075, 2057, 2032, 2001, 1962, 1919, 1870,
+    1817, 1759, 1698, 1634, 1567, 1498, 1428, 1356, 1283, 1210, 1137, 1064,
+    991, 919, 848, 779, 711, 645, 581, 519, 459, 401, 347, 294,
+    244, 197, 153, 111, 72, 36, 2, -29, -57, -83, -106, -127,
+    -146, -163, -177, -189, -200, -208, -215, -221, -224, -227, -228, -228,
+    -227, -225, -222, -218, 213, 208, 202, 196, 190, 183, 176, 169,
+    161, 154, 147, 139, 132, 125, 117, 111, 104, 97, 91, 85,
+    79, 73, 68, 63, 58, 53, 49, 45, 41, 38, 35, 31,
+    29, 26, 24, 21, 19, 17, 16, 14, 13, 11, 10, 9,
+    8, 7, 7, 6, 6, 5, 4, 4, 3, 3, 2, 2,
+    2, 2, 1, 1, 1, 1, 1, 1,
+};
+
+static const uint32_t g_huff_codes_1[4] =
+{
+    0x1, 0x1, 0x1, 0x0,
+};
+static const uint8_t g_huff_lens_1[4] =
+{
+    1, 3, 2, 3,
+};
+
+static const uint32_t g_huff_codes_2[9] =
+{
+    0x1, 0x2, 0x1, 0x3, 0x1, 0x1, 0x3, 0x2,
+    0x0,
+};
+static const uint8_t g_huff_lens_2[9] =
+{
+    1, 3, 6, 3, 3, 5, 5, 5, 6,
+};
+
+static const uint32_t g_huff_codes_3[9] =
+{
+    0x3, 0x2, 0x1, 0x1, 0x1, 0x1, 0x3, 0x2,
+    0x0,
+};
+static const uint8_t g_huff_lens_3[9] =
+{
+    2, 2, 6, 3, 2, 5, 5, 5, 6,
+};
+
+static const uint32_t g_huff_codes_5[16] =
+{
+    0x1, 0x2, 0x6, 0x5, 0x3, 0x1, 0x4, 0x4,
+    0x7, 0x5, 0x7, 0x1, 0x6, 0x1, 0x1, 0x0,
+};
+static const uint8_t g_huff_lens_5[16] =
+{
+    1, 3, 6, 7, 3, 3, 6, 7, 6, 6, 7, 8, 7, 6, 7, 8,
+};
+
+static const uint32_t g_huff_codes_6[16] =
+{
+    0x7, 0x3, 0x5, 0x1, 0x6, 0x2, 0x3, 0x2,
+    0x5, 0x4, 0x4, 0x1, 0x3, 0x3, 0x2, 0x0,
+};
+static const uint8_t g_huff_lens_6[16] =
+{
+    3, 3, 5, 7, 3, 2, 4, 5, 4, 4, 5, 6, 6, 5, 6, 7,
+};
+
+static const uint32_t g_huff_codes_7[36] =
+{
+    0x1, 0x2, 0xa, 0x13, 0x10, 0xa, 0x3, 0x3,
+    0x7, 0xa, 0x5, 0x3, 0xb, 0x4, 0xd, 0x11,
+    0x8, 0x4, 0xc, 0xb, 0x12, 0xf, 0xb, 0x2,
+    0x7, 0x6, 0x9, 0xe, 0x3, 0x1, 0x6, 0x4,
+    0x5, 0x3, 0x2, 0x0,
+};
+static const uint8_t g_huff_lens_7[36] =
+{
+    1, 3, 6, 8, 8, 9, 3, 4, 6, 7, 7, 8, 6, 5, 7, 8,
+    8, 9, 7, 7, 8, 9, 9, 9, 7, 7, 8, 9, 9, 10, 8, 8,
+    9, 10, 10, 10,
+};
+
+static const uint32_t g_huff_codes_8[36] =
+{
+    0x3, 0x4, 0x6, 0x12, 0xc, 0x5, 0x5, 0x1,
+    0x2, 0x10, 0x9, 0x3, 0x7, 0x3, 0x5, 0xe,
+    0x7, 0x3, 0x13, 0x11, 0xf, 0xd, 0xa, 0x4,
+    0xd, 0x5, 0x8, 0xb, 0x5, 0x1, 0xc, 0x4,
+    0x4, 0x1, 0x1, 0x0,
+};
+static const uint8_t g_huff_lens_8[36] =
+{
+    2, 3, 6, 8, 8, 9, 3, 2, 4, 8, 8, 8, 6, 4, 6, 8,
+    8, 9, 8, 8, 8, 9, 9, 10, 8, 7, 8, 9, 10, 10, 9, 8,
+    9, 9, 11, 11,
+};
+
+static const uint32_t g_huff_codes_9[36] =
+{
+    0x7, 0x5, 0x9, 0xe, 0xf, 0x7, 0x6, 0x4,
+    0x5, 0x5, 0x6, 0x7, 0x7, 0x6, 0x8, 0x8,
+    0x8, 0x5, 0xf, 0x6, 0x9, 0xa, 0x5, 0x1,
+    0xb, 0x7, 0x9, 0x6, 0x4, 0x1, 0xe, 0x4,
+    0x6, 0x2, 0x6, 0x0,
+};
+static const uint8_t g_huff_lens_9[36] =
+{
+    3, 3, 5, 6, 8, 9, 3, 3, 4, 5, 6, 8, 4, 4, 5, 6,
+    7, 8, 6, 5, 6, 7, 7, 8, 7, 6, 7, 7, 8, 9, 8, 7,
+    8, 8, 9, 9,
+};
+
+static const uint32_t g_huff_codes_10[64] =
+{
+    0x1, 0x2, 0xa, 0x17, 0x23, 0x1e, 0xc, 0x11,
+    0x3, 0x3, 0x8, 0xc, 0x12, 0x15, 0xc, 0x7,
+    0xb, 0x9, 0xf, 0x15, 0x20, 0x28, 0x13, 0x6,
+    0xe, 0xd, 0x16, 0x22, 0x2e, 0x17, 0x12, 0x7,
+    0x14, 0x13, 0x21, 0x2f, 0x1b, 0x16, 0x9, 0x3,
+    0x1f, 0x16, 0x29, 0x1a, 0x15, 0x14, 0x5, 0x3,
+    0xe, 0xd, 0xa, 0xb, 0x10, 0x6, 0x5, 0x1,
+    0x9, 0x8, 0x7, 0x8, 0x4, 0x4, 0x2, 0x0,
+};
+static const uint8_t g_huff_lens_10[64] =
+{
+    1, 3, 6, 8, 9, 9, 9, 10, 3, 4, 6, 7, 8, 9, 8, 8,
+    6, 6, 7, 8, 9, 10, 9, 9, 7, 7, 8, 9, 10, 10, 9, 10,
+    8, 8, 9, 10, 10, 10, 10, 10, 9, 9, 10, 10, 11, 11, 10, 11,
+    8, 8, 9, 10, 10, 10, 11, 11, 9, 8, 9, 10, 10, 11, 11, 11,
+};
+
+static const uint32_t g_huff_codes_11[64] =
+{
+    0x3, 0x4, 0xa, 0x18, 0x22, 0x21, 0x15, 0xf,
+    0x5, 0x3, 0x4, 0xa, 0x20, 0x11, 0xb, 0xa,
+    0xb, 0x7, 0xd, 0x12, 0x1e, 0x1f, 0x14, 0x5,
+    0x19, 0xb, 0x13, 0x3b, 0x1b, 0x12, 0xc, 0x5,
+    0x23, 0x21, 0x1f, 0x3a, 0x1e, 0x10, 0x7, 0x5,
+    0x1c, 0x1a, 0x20, 0x13, 0x11, 0xf, 0x8, 0xe,
+    0xe, 0xc, 0x9, 0xd, 0xe, 0x9, 0x4, 0x1,
+    0xb, 0x4, 0x6, 0x6, 0x6, 0x3, 0x2, 0x0,
+};
+static const uint8_t g_huff_lens_11[64] =
+{
+    2, 3, 5, 7, 8, 9, 8, 9, 3, 3, 4, 6, 8, 8, 7, 8,
+    5, 5, 6, 7, 8, 9, 8, 8, 7, 6, 7, 9, 8, 10, 8, 9,
+    8, 8, 8, 9, 9, 10, 9, 10, 8, 8, 9, 10, 10, 11, 10, 11,
+    8, 7, 7, 8, 9, 10, 10, 10, 8, 7, 8, 9, 10, 10, 10, 10,
+};
+
+static const uint32_t g_huff_codes_12[64] =
+{
+    0x9, 0x6, 0x10, 0x21, 0x29, 0x27, 0x26, 0x1a,
+    0x7, 0x5, 0x6, 0x9, 0x17, 0x10, 0x1a, 0xb,
+    0x11, 0x7, 0xb, 0xe, 0x15, 0x1e, 0xa, 0x7,
+    0x11, 0xa, 0xf, 0xc, 0x12, 0x1c, 0xe, 0x5,
+    0x20, 0xd, 0x16, 0x13, 0x12, 0x10, 0x9, 0x5,
+    0x28, 0x11, 0x1f, 0x1d, 0x11, 0xd, 0x4, 0x2,
+    0x1b, 0xc, 0xb, 0xf, 0xa, 0x7, 0x4, 0x1,
+    0x1b, 0xc, 0x8, 0xc, 0x6, 0x3, 0x1, 0x0,
+};
+static const uint8_t g_huff_lens_12[64] =
+{
+    4, 3, 5, 7, 8, 9, 9, 9, 3, 3, 4, 5, 7, 7, 8, 8,
+    5, 4, 5, 6, 7, 8, 7, 8, 6, 5, 6, 6, 7, 8, 8, 8,
+    7, 6, 7, 7, 8, 8, 8, 9, 8, 7, 8, 8, 8, 9, 8, 9,
+    8, 7, 7, 8, 8, 9, 9, 10, 9, 8, 8, 9, 9, 9, 9, 10,
+};
+
+static const uint32_t g_huff_codes_13[256] =
+{
+    0x1, 0x5, 0xe, 0x15, 0x22, 0x33, 0x2e, 0x47,
+    0x2a, 0x34, 0x44, 0x34, 0x43, 0x2c, 0x2b, 0x13,
+    0x3, 0x4, 0xc, 0x13, 0x1f, 0x1a, 0x2c, 0x21,
+    0x1f, 0x18, 0x20, 0x18, 0x1f, 0x23, 0x16, 0xe,
+    0xf, 0xd, 0x17, 0x24, 0x3b, 0x31, 0x4d, 0x41,
+    0x1d, 0x28, 0x1e, 0x28, 0x1b, 0x21, 0x2a, 0x10,
+    0x16, 0x14, 0x25, 0x3d, 0x38, 0x4f, 0x49, 0x40,
+    0x2b, 0x4c, 0x38, 0x25, 0x1a, 0x1f, 0x19, 0xe,
+    0x23, 0x10, 0x3c, 0x39, 0x61, 0x4b, 0x72, 0x5b,
+    0x36, 0x49, 0x37, 0x29, 0x30, 0x35, 0x17, 0x18,
+    0x3a, 0x1b, 0x32, 0x60, 0x4c, 0x46, 0x5d, 0x54,
+    0x4d, 0x3a, 0x4f, 0x1d, 0x4a, 0x31, 0x29, 0x11,
+    0x2f, 0x2d, 0x4e, 0x4a, 0x73, 0x5e, 0x5a, 0x4f,
+    0x45, 0x53, 0x47, 0x32, 0x3b, 0x26, 0x24, 0xf,
+    0x48, 0x22, 0x38, 0x5f, 0x5c, 0x55, 0x5b, 0x5a,
+    0x56, 0x49, 0x4d, 0x41, 0x33, 0x2c, 0x2b, 0x2a,
+    0x2b, 0x14, 0x1e, 0x2c, 0x37, 0x4e, 0x48, 0x57,
+    0x4e, 0x3d, 0x2e, 0x36, 0x25, 0x1e, 0x14, 0x10,
+    0x35, 0x19, 0x29, 0x25, 0x2c, 0x3b, 0x36, 0x51,
+    0x42, 0x4c, 0x39, 0x36, 0x25, 0x12, 0x27, 0xb,
+    0x23, 0x21, 0x1f, 0x39, 0x2a, 0x52, 0x48, 0x50,
+    0x2f, 0x3a, 0x37, 0x15, 0x16, 0x1a, 0x26, 0x16,
+    0x35, 0x19, 0x17, 0x26, 0x46, 0x3c, 0x33, 0x24,
+    0x37, 0x1a, 0x22, 0x17, 0x1b, 0xe, 0x9, 0x7,
+    0x22, 0x20, 0x1c, 0x27, 0x31, 0x4b, 0x1e, 0x34,
+    0x30, 0x28, 0x34, 0x1c, 0x12, 0x11, 0x9, 0x5,
+    0x2d, 0x15, 0x22, 0x40, 0x38, 0x32, 0x31, 0x2d,
+    0x1f, 0x13, 0xc, 0xf, 0xa, 0x7, 0x6, 0x3,
+    0x30, 0x17, 0x14, 0x27, 0x24, 0x23, 0x35, 0x15,
+    0x10, 0x17, 0xd, 0xa, 0x6, 0x1, 0x4, 0x2,
+    0x10, 0xf, 0x11, 0x1b, 0x19, 0x14, 0x1d, 0xb,
+    0x11, 0xc, 0x10, 0x8, 0x1, 0x1, 0x0, 0x1,
+};
+static const uint8_t g_huff_lens_13[256] =
+{
+    1, 4, 6, 7, 8, 9, 9, 10, 9, 10, 11, 11, 12, 12, 13, 13,
+    3, 4, 6, 7, 8, 8, 9, 9, 9, 9, 10, 10, 11, 12, 12, 12,
+    6, 6, 7, 8, 9, 9, 10, 10, 9, 10, 10, 11, 11, 12, 13, 13,
+    7, 7, 8, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11, 12, 13, 13,
+    8, 7, 9, 9, 10, 10, 11, 11, 10, 11, 11, 12, 12, 13, 13, 14,
+    9, 8, 9, 10, 10, 10, 11, 11, 11, 11, 12, 11, 13, 13, 14, 14,
+    9, 9, 10, 10, 11, 11, 11, 11, 11, 12, 12, 12, 13, 13, 14, 14,
+    10, 9, 10, 11, 11, 11, 12, 12, 12, 12, 13, 13, 13, 14, 16, 16,
+    9, 8, 9, 10, 10, 11, 11, 12, 12, 12, 12, 13, 13, 14, 15, 15,
+    10, 9, 10, 10, 11, 11, 11, 13, 12, 13, 13, 14, 14, 14, 16, 15,
+    10, 10, 10, 11, 11, 12, 12, 13, 12, 13, 14, 13, 14, 15, 16, 17,
+    11, 10, 10, 11, 12, 12, 12, 12, 13, 13, 13, 14, 15, 15, 15, 16,
+    11, 11, 11, 12, 12, 13, 12, 13, 14, 14, 15, 15, 15, 16, 16, 16,
+    12, 11, 12, 13, 13, 13, 14, 14, 14, 14, 14, 15, 16, 15, 16, 16,
+    13, 12, 12, 13, 13, 13, 15, 14, 14, 17, 15, 15, 15, 17, 16, 16,
+    12, 12, 13, 14, 14, 14, 15, 14, 15, 15, 16, 16, 19, 18, 19, 16,
+};
+
+static const uint32_t g_huff_codes_15[256] =
+{
+    0x7, 0xc, 0x12, 0x35, 0x2f, 0x4c, 0x7c, 0x6c,
+    0x59, 0x7b, 0x6c, 0x77, 0x6b, 0x51, 0x7a, 0x3f,
+    0xd, 0x5, 0x10, 0x1b, 0x2e, 0x24, 0x3d, 0x33,
+    0x2a, 0x46, 0x34, 0x53, 0x41, 0x29, 0x3b, 0x24,
+    0x13, 0x11, 0xf, 0x18, 0x29, 0x22, 0x3b, 0x30,
+    0x28, 0x40, 0x32, 0x4e, 0x3e, 0x50, 0x38, 0x21,
+    0x1d, 0x1c, 0x19, 0x2b, 0x27, 0x3f, 0x37, 0x5d,
+    0x4c, 0x3b, 0x5d, 0x48, 0x36, 0x4b, 0x32, 0x1d,
+    0x34, 0x16, 0x2a, 0x28, 0x43, 0x39, 0x5f, 0x4f,
+    0x48, 0x39, 0x59, 0x45, 0x31, 0x42, 0x2e, 0x1b,
+    0x4d, 0x25, 0x23, 0x42, 0x3a, 0x34, 0x5b, 0x4a,
+    0x3e, 0x30, 0x4f, 0x3f, 0x5a, 0x3e, 0x28, 0x26,
+    0x7d, 0x20, 0x3c, 0x38, 0x32, 0x5c, 0x4e, 0x41,
+    0x37, 0x57, 0x47, 0x33, 0x49, 0x33, 0x46, 0x1e,
+    0x6d, 0x35, 0x31, 0x5e, 0x58, 0x4b, 0x42, 0x7a,
+    0x5b, 0x49, 0x38, 0x2a, 0x40, 0x2c, 0x15, 0x19,
+    0x5a, 0x2b, 0x29, 0x4d, 0x49, 0x3f, 0x38, 0x5c,
+    0x4d, 0x42, 0x2f, 0x43, 0x30, 0x35, 0x24, 0x14,
+    0x47, 0x22, 0x43, 0x3c, 0x3a, 0x31, 0x58, 0x4c,
+    0x43, 0x6a, 0x47, 0x36, 0x26, 0x27, 0x17, 0xf,
+    0x6d, 0x35, 0x33, 0x2f, 0x5a, 0x52, 0x3a, 0x39,
+    0x30, 0x48, 0x39, 0x29, 0x17, 0x1b, 0x3e, 0x9,
+    0x56, 0x2a, 0x28, 0x25, 0x46, 0x40, 0x34, 0x2b,
+    0x46, 0x37, 0x2a, 0x19, 0x1d, 0x12, 0xb, 0xb,
+    0x76, 0x44, 0x1e, 0x37, 0x32, 0x2e, 0x4a, 0x41,
+    0x31, 0x27, 0x18, 0x10, 0x16, 0xd, 0xe, 0x7,
+    0x5b, 0x2c, 0x27, 0x26, 0x22, 0x3f, 0x34, 0x2d,
+    0x1f, 0x34, 0x1c, 0x13, 0xe, 0x8, 0x9, 0x3,
+    0x7b, 0x3c, 0x3a, 0x35, 0x2f, 0x2b, 0x20, 0x16,
+    0x25, 0x18, 0x11, 0xc, 0xf, 0xa, 0x2, 0x1,
+    0x47, 0x25, 0x22, 0x1e, 0x1c, 0x14, 0x11, 0x1a,
+    0x15, 0x10, 0xa, 0x6, 0x8, 0x6, 0x2, 0x0,
+};
+static const uint8_t g_huff_lens_15[256] =
+{
+    3, 4, 5, 7, 7, 8, 9, 9, 9, 10, 10, 11, 11, 11, 12, 13,
+    4, 3, 5, 6, 7, 7, 8, 8, 8, 9, 9, 10, 10, 10, 11, 11,
+    5, 5, 5, 6, 7, 7, 8, 8, 8, 9, 9, 10, 10, 11, 11, 11,
+    6, 6, 6, 7, 7, 8, 8, 9, 9, 9, 10, 10, 10, 11, 11, 11,
+    7, 6, 7, 7, 8, 8, 9, 9, 9, 9, 10, 10, 10, 11, 11, 11,
+    8, 7, 7, 8, 8, 8, 9, 9, 9, 9, 10, 10, 11, 11, 11, 12,
+    9, 7, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 11, 11, 12, 12,
+    9, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 10, 11, 11, 11, 12,
+    9, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 12, 12, 12,
+    9, 8, 9, 9, 9, 9, 10, 10, 10, 11, 11, 11, 11, 12, 12, 12,
+    10, 9, 9, 9, 10, 10, 10, 10, 10, 11, 11, 11, 11, 12, 13, 12,
+    10, 9, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11, 12, 12, 12, 13,
+    11, 10, 9, 10, 10, 10, 11, 11, 11, 11, 11, 11, 12, 12, 13, 13,
+    11, 10, 10, 10, 10, 11, 11, 11, 11, 12, 12, 12, 12, 12, 13, 13,
+    12, 11, 11, 11, 11, 11, 11, 11, 12, 12, 12, 12, 13, 13, 12, 13,
+    12, 11, 11, 11, 11, 11, 11, 12, 12, 12, 12, 12, 13, 13, 13, 13,
+};
+
+static const uint32_t g_huff_codes_16[256] =
+{
+    0x1, 0x5, 0xe, 0x2c, 0x4a, 0x3f, 0x6e, 0x5d,
+    0xac, 0x95, 0x8a, 0xf2, 0xe1, 0xc3, 0x178, 0x11,
+    0x3, 0x4, 0xc, 0x14, 0x23, 0x3e, 0x35, 0x2f,
+    0x53, 0x4b, 0x44, 0x77, 0xc9, 0x6b, 0xcf, 0x9,
+    0xf, 0xd, 0x17, 0x26, 0x43, 0x3a, 0x67, 0x5a,
+    0xa1, 0x48, 0x7f, 0x75, 0x6e, 0xd1, 0xce, 0x10,
+    0x2d, 0x15, 0x27, 0x45, 0x40, 0x72, 0x63, 0x57,
+    0x9e, 0x8c, 0xfc, 0xd4, 0xc7, 0x183, 0x16d, 0x1a,
+    0x4b, 0x24, 0x44, 0x41, 0x73, 0x65, 0xb3, 0xa4,
+    0x9b, 0x108, 0xf6, 0xe2, 0x18b, 0x17e, 0x16a, 0x9,
+    0x42, 0x1e, 0x3b, 0x38, 0x66, 0xb9, 0xad, 0x109,
+    0x8e, 0xfd, 0xe8, 0x190, 0x184, 0x17a, 0x1bd, 0x10,
+    0x6f, 0x36, 0x34, 0x64, 0xb8, 0xb2, 0xa0, 0x85,
+    0x101, 0xf4, 0xe4, 0xd9, 0x181, 0x16e, 0x2cb, 0xa,
+    0x62, 0x30, 0x5b, 0x58, 0xa5, 0x9d, 0x94, 0x105,
+    0xf8, 0x197, 0x18d, 0x174, 0x17c, 0x379, 0x374, 0x8,
+    0x55, 0x54, 0x51, 0x9f, 0x9c, 0x8f, 0x104, 0xf9,
+    0x1ab, 0x191, 0x188, 0x17f, 0x2d7, 0x2c9, 0x2c4, 0x7,
+    0x9a, 0x4c, 0x49, 0x8d, 0x83, 0x100, 0xf5, 0x1aa,
+    0x196, 0x18a, 0x180, 0x2df, 0x167, 0x2c6, 0x160, 0xb,
+    0x8b, 0x81, 0x43, 0x7d, 0xf7, 0xe9, 0xe5, 0xdb,
+    0x189, 0x2e7, 0x2e1, 0x2d0, 0x375, 0x372, 0x1b7, 0x4,
+    0xf3, 0x78, 0x76, 0x73, 0xe3, 0xdf, 0x18c, 0x2ea,
+    0x2e6, 0x2e0, 0x2d1, 0x2c8, 0x2c2, 0xdf, 0x1b4, 0x6,
+    0xca, 0xe0, 0xde, 0xda, 0xd8, 0x185, 0x182, 0x17d,
+    0x16c, 0x378, 0x1bb, 0x2c3, 0x1b8, 0x1b5, 0x6c0, 0x4,
+    0x2eb, 0xd3, 0xd2, 0xd0, 0x172, 0x17b, 0x2de, 0x2d3,
+    0x2ca, 0x6c7, 0x373, 0x36d, 0x36c, 0xd83, 0x361, 0x2,
+    0x179, 0x171, 0x66, 0xbb, 0x2d6, 0x2d2, 0x166, 0x2c7,
+    0x2c5, 0x362, 0x6c6, 0x367, 0xd82, 0x366, 0x1b2, 0x0,
+    0xc, 0xa, 0x7, 0xb, 0xa, 0x11, 0xb, 0x9,
+    0xd, 0xc, 0xa, 0x7, 0x5, 0x3, 0x1, 0x3,
+};
+static const uint8_t g_huff_lens_16[256] =
+{
+    1, 4, 6, 8, 9, 9, 10, 10, 11, 11, 11, 12, 12, 12, 13, 9,
+    3, 4, 6, 7, 8, 9, 9, 9, 10, 10, 10, 11, 12, 11, 12, 8,
+    6, 6, 7, 8, 9, 9, 10, 10, 11, 10, 11, 11, 11, 12, 12, 9,
+    8, 7, 8, 9, 9, 10, 10, 10, 11, 11, 12, 12, 12, 13, 13, 10,
+    9, 8, 9, 9, 10, 10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 9,
+    9, 8, 9, 9, 10, 11, 11, 12, 11, 12, 12, 13, 13, 13, 14, 10,
+    10, 9, 9, 10, 11, 11, 11, 11, 12, 12, 12, 12, 13, 13, 14, 10,
+    10, 9, 10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 13, 15, 15, 10,
+    10, 10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 13, 14, 14, 14, 10,
+    11, 10, 10, 11, 11, 12, 12, 13, 13, 13, 13, 14, 13, 14, 13, 11,
+    11, 11, 10, 11, 12, 12, 12, 12, 13, 14, 14, 14, 15, 15, 14, 10,
+    12, 11, 11, 11, 12, 12, 13, 14, 14, 14, 14, 14, 14, 13, 14, 11,
+    12, 12, 12, 12, 12, 13, 13, 13, 13, 15, 14, 14, 14, 14, 16, 11,
+    14, 12, 12, 12, 13, 13, 14, 14, 14, 16, 15, 15, 15, 17, 15, 11,
+    13, 13, 11, 12, 14, 14, 13, 14, 14, 15, 16, 15, 17, 15, 14, 11,
+    9, 8, 8, 9, 9, 10, 10, 10, 11, 11, 11, 11, 11, 11, 11, 8,
+};
+
+static const uint32_t g_huff_codes_24[256] =
+{
+    0xf, 0xd, 0x2e, 0x50, 0x92, 0x106, 0xf8, 0x1b2,
+    0x1aa, 0x29d, 0x28d, 0x289, 0x26d, 0x205, 0x408, 0x58,
+    0xe, 0xc, 0x15, 0x26, 0x47, 0x82, 0x7a, 0xd8,
+    0xd1, 0xc6, 0x147, 0x159, 0x13f, 0x129, 0x117, 0x2a,
+    0x2f, 0x16, 0x29, 0x4a, 0x44, 0x80, 0x78, 0xdd,
+    0xcf, 0xc2, 0xb6, 0x154, 0x13b, 0x127, 0x21d, 0x12,
+    0x51, 0x27, 0x4b, 0x46, 0x86, 0x7d, 0x74, 0xdc,
+    0xcc, 0xbe, 0xb2, 0x145, 0x137, 0x125, 0x10f, 0x10,
+    0x93, 0x48, 0x45, 0x87, 0x7f, 0x76, 0x70, 0xd2,
+    0xc8, 0xbc, 0x160, 0x143, 0x132, 0x11d, 0x21c, 0xe,
+    0x107, 0x42, 0x81, 0x7e, 0x77, 0x72, 0xd6, 0xca,
+    0xc0, 0xb4, 0x155, 0x13d, 0x12d, 0x119, 0x106, 0xc,
+    0xf9, 0x7b, 0x79, 0x75, 0x71, 0xd7, 0xce, 0xc3,
+    0xb9, 0x15b, 0x14a, 0x134, 0x123, 0x110, 0x208, 0xa,
+    0x1b3, 0x73, 0x6f, 0x6d, 0xd3, 0xcb, 0xc4, 0xbb,
+    0x161, 0x14c, 0x139, 0x12a, 0x11b, 0x213, 0x17d, 0x11,
+    0x1ab, 0xd4, 0xd0, 0xcd, 0xc9, 0xc1, 0xba, 0xb1,
+    0xa9, 0x140, 0x12f, 0x11e, 0x10c, 0x202, 0x179, 0x10,
+    0x14f, 0xc7, 0xc5, 0xbf, 0xbd, 0xb5, 0xae, 0x14d,
+    0x141, 0x131, 0x121, 0x113, 0x209, 0x17b, 0x173, 0xb,
+    0x29c, 0xb8, 0xb7, 0xb3, 0xaf, 0x158, 0x14b, 0x13a,
+    0x130, 0x122, 0x115, 0x212, 0x17f, 0x175, 0x16e, 0xa,
+    0x28c, 0x15a, 0xab, 0xa8, 0xa4, 0x13e, 0x135, 0x12b,
+    0x11f, 0x114, 0x107, 0x201, 0x177, 0x170, 0x16a, 0x6,
+    0x288, 0x142, 0x13c, 0x138, 0x133, 0x12e, 0x124, 0x11c,
+    0x10d, 0x105, 0x200, 0x178, 0x172, 0x16c, 0x167, 0x4,
+    0x26c, 0x12c, 0x128, 0x126, 0x120, 0x11a, 0x111, 0x10a,
+    0x203, 0x17c, 0x176, 0x171, 0x16d, 0x169, 0x165, 0x2,
+    0x409, 0x118, 0x116, 0x112, 0x10b, 0x108, 0x103, 0x17e,
+    0x17a, 0x174, 0x16f, 0x16b, 0x168, 0x166, 0x164, 0x0,
+    0x2b, 0x14, 0x13, 0x11, 0xf, 0xd, 0xb, 0x9,
+    0x7, 0x6, 0x4, 0x7, 0x5, 0x3, 0x1, 0x3,
+};
+static const uint8_t g_huff_lens_24[256] =
+{
+    4, 4, 6, 7, 8, 9, 9, 10, 10, 11, 11, 11, 11, 11, 12, 9,
+    4, 4, 5, 6, 7, 8, 8, 9, 9, 9, 10, 10, 10, 10, 10, 8,
+    6, 5, 6, 7, 7, 8, 8, 9, 9, 9, 9, 10, 10, 10, 11, 7,
+    7, 6, 7, 7, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 7,
+    8, 7, 7, 8, 8, 8, 8, 9, 9, 9, 10, 10, 10, 10, 11, 7,
+    9, 7, 8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 10, 7,
+    9, 8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 10, 11, 7,
+    10, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 10, 11, 11, 8,
+    10, 9, 9, 9, 9, 9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 8,
+    10, 9, 9, 9, 9, 9, 9, 10, 10, 10, 10, 10, 11, 11, 11, 8,
+    11, 9, 9, 9, 9, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 8,
+    11, 10, 9, 9, 9, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 8,
+    11, 10, 10, 10, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 11, 8,
+    11, 10, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 11, 11, 11, 8,
+    12, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 11, 11, 11, 11, 8,
+    8, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 8, 8, 8, 8, 4,
+};
+
+// One of the big value Huffman code tables.  The code for the pair
+// (x, y) is at index x * m_size + y.  Tables 16 to 31 code values
+// of 15 and up as 15 followed by 'm_linbits' bits of the excess.
+struct HuffTable
+{
+    unsigned m_size;
+    unsigned m_linbits;
+    const uint32_t *m_codes;
+    const uint8_t *m_lens;
+};
+
+static const HuffTable g_huff_tables[32] =
+{
+    {  0,  0, nullptr,          nullptr },
+    {  2,  0, g_huff_codes_1,  g_huff_lens_1 },
+    {  3,  0, g_huff_codes_2,  g_huff_lens_2 },
+    {  3,  0, g_huff_codes_3,  g_huff_lens_3 },
+    {  0,  0, nullptr,          nullptr },
+    {  4,  0, g_huff_codes_5,  g_huff_lens_5 },
+    {  4,  0, g_huff_codes_6,  g_huff_lens_6 },
+    {  6,  0, g_huff_codes_7,  g_huff_lens_7 },
+    {  6,  0, g_huff_codes_8,  g_huff_lens_8 },
+    {  6,  0, g_huff_codes_9,  g_huff_lens_9 },
+    {  8,  0, g_huff_codes_10, g_huff_lens_10 },
+    {  8,  0, g_huff_codes_11, g_huff_lens_11 },
+    {  8,  0, g_huff_codes_12, g_huff_lens_12 },
+    { 16,  0, g_huff_codes_13, g_huff_lens_13 },
+    {  0,  0, nullptr,          nullptr },
+    { 16,  0, g_huff_codes_15, g_huff_lens_15 },
+    { 16,  1, g_huff_codes_16, g_huff_lens_16 },
+    { 16,  2, g_huff_codes_16, g_huff_lens_16 },
+    { 16,  3, g_huff_codes_16, g_huff_lens_16 },
+    { 16,  4, g_huff_codes_16, g_huff_lens_16 },
+    { 16,  6, g_huff_codes_16, g_huff_lens_16 },
+    { 16,  8, g_huff_codes_16, g_huff_lens_16 },
+    { 16, 10, g_huff_codes_16, g_huff_lens_16 },
+    { 16, 13, g_huff_codes_16, g_huff_lens_16 },
+    { 16,  4, g_huff_codes_24, g_huff_lens_24 },
+    { 16,  5, g_huff_codes_24, g_huff_lens_24 },
+    { 16,  6, g_huff_codes_24, g_huff_lens_24 },
+    { 16,  7, g_huff_codes_24, g_huff_lens_24 },
+    { 16,  8, g_huff_codes_24, g_huff_lens_24 },
+    { 16,  9, g_huff_codes_24, g_huff_lens_24 },
+    { 16, 11, g_huff_codes_24, g_huff_lens_24 },
+    { 16, 13, g_huff_codes_24, g_huff_lens_24 }
+};
+
+// The tables tried for each region of big values.  The last two
+// stand for the families of escape tables that share their codes.
+static const unsigned g_candidate_tables[] = { 1, 2, 3, 5, 6, 7, 8, 9, 10, 11, 12, 13, 15, 16, 24 };
+static const unsigned kNumCandidates = sizeof(g_candidate_tables) / sizeof(g_candidate_tables[0]);
+
+// Count1 table A codes and lengths for the quadruple (v, w, x, y),
+// by v * 8 + w * 4 + x * 2 + y.  Table B's code is just 15 minus
+// that index, in four bits.
+static const uint8_t g_count1_codes[16] = { 1, 5, 4, 5, 6, 5, 4, 4, 7, 3, 6, 0, 7, 2, 3, 1 };
+static const uint8_t g_count1_lens[16]  = { 1, 4, 4, 5, 4, 6, 5, 6, 4, 5, 5, 6, 5, 6, 6, 6 };
+
+// Floating-point versions of the tables that the filterbank and
+// MDCT use, computed the first time they're needed.
+struct FilterTables
+{
+    FilterTables()
+    {
+        const double pi = 3.14159265358979323846;
+
+        // The window is stored back to front, so that it can be
+        // applied to the input in memory order.
+        for (int i = 0; i < 512; i++)
+            m_window[511 - i] = static_cast<float>(g_window[i] / (65536.0 * 32.0));
+
+        // Matrixing coefficients cos((2k + 1)(i - 16)pi / 64), with i
+        // also back to front to match the folded window output.
+        for (int k = 0; k < 32; k++)
+        {
+            for (int m = 0; m < 64; m++)
+            {
+                int i = 63 - m;
+                m_matrix[k][m] = static_cast<float>(cos((2 * k + 1) * (i - 16) * pi / 64.0));
+            }
+        }
+
+        // MDCT coefficients with the sine window for long blocks
+        // folded in, scaled to match the decoder's IMDCT.
+        for (int k = 0; k < 18; k++)
+        {
+            for (int i = 0; i < 36; i++)
+            {
+                double window = sin(pi / 36.0 * (i + 0.5));
+                m_mdct[k][i] = static_cast<float>(window / 9.0 *
+                    cos(pi / 72.0 * (2 * i + 1 + 18) * (2 * k + 1)));
+            }
+        }
+    }
+
+    float m_window[512];
+    float m_matrix[32][64];
+    float m_mdct[18][36];
+};
+
+static const FilterTables &GetFilterTables()
+{
+    static const FilterTables tables;
+    return tables;
+}
+
+// Returns the sum of a[i] * b[i] for 'count' elements, which
+// must be a multiple of four.
+static inline float DotProduct(const float *a, const float *b, size_t count)
+{
+#ifdef USE_SSE2
+    __m128 sum = _mm_setzero_ps();
+    for (size_t i = 0; i < count; i += 4)
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+#else
+    float sum = 0.0f;
+    for (size_t i = 0; i < count; i++)
+        sum += a[i] * b[i];
+    return sum;
+#endif
+}
+
+// Runs the polyphase analysis filterbank for one time slot.
+// 'input' points at the 512 most recent samples, oldest first,
+// and 'subbands' receives one sample for each of the 32 subbands.
+static void AnalyzeSlot(const FilterTables &tables, const float *input, float *subbands)
+{
+    // Window the input and fold it down to 64 values.
+    alignas(16) float folded[64];
+#ifdef USE_SSE2
+    for (int m = 0; m < 64; m += 4)
+    {
+        __m128 sum = _mm_setzero_ps();
+        for (int j = 0; j < 512; j += 64)
+        {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&tables.m_window[m + j]),
+                                             _mm_loadu_ps(&input[m + j])));
+        }
+        _mm_store_ps(&folded[m], sum);
+    }
+#else
+    for (int m = 0; m < 64; m++)
+    {
+        float sum = 0.0f;
+        for (int j = 0; j < 512; j += 64)
+            sum += tables.m_window[m + j] * input[m + j];
+        folded[m] = sum;
+    }
+#endif
+
+    // Matrix the folded values into the subbands.
+    for (int k = 0; k < 32; k++)
+        subbands[k] = DotProduct(tables.m_matrix[k], folded, 64);
+}
+
+// Writes bits most significant first into a zero-filled buffer.
+class BitWriter
+{
+public:
+    explicit BitWriter(uint8_t *data) : m_data(data) { }
+
+    void Put(uint32_t value, unsigned bits)
+    {
+        while (bits > 0)
+        {
+            unsigned room = 8 - (m_pos & 7);
+            unsigned take = (bits < room) ? bits : room;
+            uint32_t chunk = (value >> (bits - take)) & ((1u << take) - 1);
+            m_data[m_pos >> 3] |= static_cast<uint8_t>(chunk << (room - take));
+            m_pos += take;
+            bits -= take;
+        }
+    }
+
+    size_t GetPosition() const { return m_pos; }
+
+private:
+    uint8_t *m_data;
+    size_t m_pos = 0;
+};
+
+// The quantized lines and side info for one channel of a granule.
+struct GranuleChannel
+{
+    int m_ix[kGranuleLines];            // Quantized magnitudes.
+    unsigned m_part23_length = 0;       // Bits of main data.
+    unsigned m_big_values = 0;          // Pairs coded with the big value tables.
+    unsigned m_count1 = 0;              // Quadruples coded with a count1 table.
+    unsigned m_table_select[3] = {};    // Big value table for each region.
+    unsigned m_region0_count = 0;       // Scale factor bands in region 0, minus 1.
+    unsigned m_region1_count = 0;       // Scale factor bands in region 1, minus 1.
+    unsigned m_count1_table = 0;        // 0 for count1 table A, 1 for table B.
+};
+
+// Per-scale factor band bit costs for the candidate tables, used
+// to split the big values into regions and pick their tables.
+struct BandCosts
+{
+    unsigned m_bands = 0;                       // Bands holding big values.
+    unsigned m_max[22] = {};                    // Largest value in each band.
+    unsigned m_bits[kNumCandidates][23] = {};   // Running bit totals per candidate.
+    unsigned m_escapes[2][23] = {};             // Running escape counts for 16 and 24.
+};
+
+// Adds up the Huffman bits each candidate table would spend on
+// the big values in each scale factor band.
+static void CountBandBits(const int *ix, unsigned big_lines, const uint16_t *sfb, BandCosts &costs)
+{
+    costs.m_bands = 0;
+    while (costs.m_bands < 22 && sfb[costs.m_bands] < big_lines)
+        costs.m_bands++;
+
+    for (unsigned band = 0; band < costs.m_bands; band++)
+    {
+        unsigned start = sfb[band];
+        unsigned end = std::min<unsigned>(sfb[band + 1], big_lines);
+
+        unsigned max = 0;
+        unsigned signs = 0;
+        unsigned escapes = 0;
+        for (unsigned i = start; i < end; i++)
+        {
+            unsigned value = static_cast<unsigned>(ix[i]);
+            max = std::max(max, value);
+            signs += (value != 0);
+            escapes += (value >= 15);
+        }
+        costs.m_max[band] = max;
+        costs.m_escapes[0][band + 1] = costs.m_escapes[0][band] + escapes;
+        costs.m_escapes[1][band + 1] = costs.m_escapes[1][band] + escapes;
+
+        for (unsigned c = 0; c < kNumCandidates; c++)
+        {
+            const HuffTable &table = g_huff_tables[g_candidate_tables[c]];
+            unsigned bits = signs;
+            if (table.m_linbits > 0 || max < table.m_size)
+            {
+                for (unsigned i = start; i < end; i += 2)
+                {
+                    unsigned x = std::min(static_cast<unsigned>(ix[i]), 15u);
+                    unsigned y = std::min(static_cast<unsigned>(ix[i + 1]), 15u);
+                    bits += table.m_lens[x * table.m_size + y];
+                }
+            }
+            costs.m_bits[c][band + 1] = costs.m_bits[c][band] + bits;
+        }
+    }
+}
+
+// Picks the cheapest table for the big values in bands 'first'
+// up to 'last', and returns its bit cost.
+static unsigned ChooseTable(const BandCosts &costs, unsigned first, unsigned last, unsigned &table_select)
+{
+    table_select = 0;
+    unsigned max = 0;
+    for (unsigned band = first; band < last; band++)
+        max = std::max(max, costs.m_max[band]);
+    if (max == 0)
+        return 0;
+
+    unsigned best = UINT32_MAX;
+    for (unsigned c = 0; c < kNumCandidates; c++)
+    {
+        unsigned table = g_candidate_tables[c];
+        unsigned bits = costs.m_bits[c][last] - costs.m_bits[c][first];
+        if (g_huff_tables[table].m_linbits > 0)
+        {
+            // Use the first table in the family with enough linbits.
+            unsigned family = (table == 16) ? 0 : 1;
+            while (max > 15 && max - 15 >= (1u << g_huff_tables[table].m_linbits))
+                table++;
+            bits += (costs.m_escapes[family][last] - costs.m_escapes[family][first]) *
+                    g_huff_tables[table].m_linbits;
+        }
+        else if (max >= g_huff_tables[table].m_size)
+        {
+            continue;
+        }
+
+        if (bits < best)
+        {
+            best = bits;
+            table_select = table;
+        }
+    }
+    return best;
+}
+
+// Quantizes the lines of one channel of a granule with the step
+// size given by 'global_gain', then works out how to Huffman code
+// them.  If 'best_regions' is false, the big values are split into
+// regions by a rule of thumb, which is quicker; otherwise every
+// split is tried and the cheapest is kept.  Returns false if some
+// line is too big to code at this step size.
+static bool QuantizeAndCount(const float *xr34, unsigned global_gain,
+                             const uint16_t *sfb, bool best_regions,
+                             GranuleChannel &gc)
+{
+    const float scale = powf(2.0f, -0.1875f * (static_cast<int>(global_gain) - 210));
+    for (unsigned i = 0; i < kGranuleLines; i++)
+    {
+        float value = xr34[i] * scale;
+        if (value >= static_cast<float>(kMaxQuantized))
+            return false;
+        gc.m_ix[i] = static_cast<int>(value + 0.4054f);
+    }
+
+    // Trailing pairs of zeroes aren't coded at all.  Before those,
+    // a run of quadruples of zeroes and ones goes in count1.
+    const int *ix = gc.m_ix;
+    unsigned end = kGranuleLines;
+    while (end >= 2 && ix[end - 1] == 0 && ix[end - 2] == 0)
+        end -= 2;
+    unsigned big_lines = end;
+    while (big_lines >= 4 && ix[big_lines - 1] <= 1 && ix[big_lines - 2] <= 1 &&
+           ix[big_lines - 3] <= 1 && ix[big_lines - 4] <= 1)
+    {
+        big_lines -= 4;
+    }
+    gc.m_big_values = big_lines / 2;
+    gc.m_count1 = (end - big_lines) / 4;
+
+    unsigned bits_a = 0;
+    unsigned bits_b = 0;
+    for (unsigned i = big_lines; i < end; i += 4)
+    {
+        unsigned quad = (ix[i] << 3) | (ix[i + 1] << 2) | (ix[i + 2] << 1) | ix[i + 3];
+        unsigned signs = ix[i] + ix[i + 1] + ix[i + 2] + ix[i + 3];
+        bits_a += g_count1_lens[quad] + signs;
+        bits_b += 4 + signs;
+    }
+    gc.m_count1_table = (bits_b < bits_a) ? 1 : 0;
+    unsigned bits = std::min(bits_a, bits_b);
+
+    BandCosts costs;
+    CountBandBits(ix, big_lines, sfb, costs);
+    unsigned best = UINT32_MAX;
+    if (!best_regions)
+    {
+        // Give region 0 about a third of the bands, and region 1
+        // about half of the rest.
+        unsigned r0 = std::min((costs.m_bands + 2) / 3, 16u) - (costs.m_bands > 0 ? 1 : 0);
+        unsigned rest = costs.m_bands - std::min(r0 + 1, costs.m_bands);
+        unsigned r1 = std::min(std::max((rest + 1) / 2, 1u), 8u) - 1;
+        unsigned end0 = std::min(r0 + 1, costs.m_bands);
+        unsigned end1 = std::min(r0 + r1 + 2, costs.m_bands);
+        gc.m_region0_count = r0;
+        gc.m_region1_count = r1;
+        best = ChooseTable(costs, 0, end0, gc.m_table_select[0]) +
+               ChooseTable(costs, end0, end1, gc.m_table_select[1]) +
+               ChooseTable(costs, end1, costs.m_bands, gc.m_table_select[2]);
+        gc.m_part23_length = bits + best;
+        return true;
+    }
+
+    // Try every split of the big values into three regions.
+    for (unsigned r0 = 0; r0 < 16; r0++)
+    {
+        unsigned end0 = std::min(r0 + 1, costs.m_bands);
+        for (unsigned r1 = 0; r1 < 8 && r0 + r1 + 2 <= 22; r1++)
+        {
+            unsigned end1 = std::min(r0 + r1 + 2, costs.m_bands);
+            unsigned tables[3] = {};
+            unsigned total = ChooseTable(costs, 0, end0, tables[0]) +
+                             ChooseTable(costs, end0, end1, tables[1]) +
+                             ChooseTable(costs, end1, costs.m_bands, tables[2]);
+            if (total < best)
+            {
+                best = total;
+                gc.m_region0_count = r0;
+                gc.m_region1_count = r1;
+                memcpy(gc.m_table_select, tables, sizeof(tables));
+            }
+            if (end1 == costs.m_bands)
+                break;
+        }
+        if (end0 == costs.m_bands)
+            break;
+    }
+
+    gc.m_part23_length = bits + best;
+    return true;
+}
+
+// Writes the Huffman coded lines of one channel of a granule.
+static void WriteMainData(BitWriter &bits, const float *xr, const uint16_t *sfb,
+                          const GranuleChannel &gc)
+{
+    const int *ix = gc.m_ix;
+    unsigned big_lines = gc.m_big_values * 2;
+    unsigned region1_start = sfb[std::min(gc.m_region0_count + 1, 22u)];
+    unsigned region2_start = sfb[std::min(gc.m_region0_count + gc.m_region1_count + 2, 22u)];
+
+    for (unsigned i = 0; i < big_lines; i += 2)
+    {
+        unsigned region = (i < region1_start) ? 0 : (i < region2_start) ? 1 : 2;
+        const HuffTable &table = g_huff_tables[gc.m_table_select[region]];
+        if (table.m_size == 0)
+            continue;
+
+        unsigned x = static_cast<unsigned>(ix[i]);
+        unsigned y = static_cast<unsigned>(ix[i + 1]);
+        unsigned xcode = std::min(x, 15u);
+        unsigned ycode = std::min(y, 15u);
+        unsigned index = xcode * table.m_size + ycode;
+        bits.Put(table.m_codes[index], table.m_lens[index]);
+        if (table.m_linbits > 0 && xcode == 15)
+            bits.Put(x - 15, table.m_linbits);
+        if (x != 0)
+            bits.Put(xr[i] < 0.0f, 1);
+        if (table.m_linbits > 0 && ycode == 15)
+            bits.Put(y - 15, table.m_linbits);
+        if (y != 0)
+            bits.Put(xr[i + 1] < 0.0f, 1);
+    }
+
+    unsigned end = big_lines + gc.m_count1 * 4;
+    for (unsigned i = big_lines; i < end; i += 4)
+    {
+        unsigned quad = (ix[i] << 3) | (ix[i + 1] << 2) | (ix[i + 2] << 1) | ix[i + 3];
+        if (gc.m_count1_table)
+            bits.Put(15 - quad, 4);
+        else
+            bits.Put(g_count1_codes[quad], g_count1_lens[quad]);
+        for (unsigned j = i; j < i + 4; j++)
+        {
+            if (ix[j] != 0)
+                bits.Put(xr[j] < 0.0f, 1);
+        }
+    }
+}
+
+// Everything EncodeFrame needs to know about the stream.
+struct EncoderSetup
+{
+    const float *m_samples = nullptr;
+    size_t m_sample_count = 0;
+    unsigned m_channels = 0;
+    unsigned m_rate_index = 0;
+    unsigned m_bitrate_index = 0;
+    unsigned m_lowpass_lines = kGranuleLines;   // Lines above this are dropped.
+};
+
+// Returns the size in bytes of frame number 'frame', which has
+// the padding byte if the frames before it have fallen behind
+// the bit rate.
+static size_t GetFrameBytes(const EncoderSetup &setup, uint64_t frame)
+{
+    uint64_t numerator = 144000ull * g_bitrates[setup.m_bitrate_index];
+    uint64_t rate = g_rates[setup.m_rate_index];
+    return static_cast<size_t>((frame + 1) * numerator / rate - frame * numerator / rate);
+}
+
+// Encodes one MP3 frame.  Each frame is encoded from the input
+// samples alone, without state carried over from the previous
+// frame, so frames may be encoded in any order.
+static void EncodeFrame(const EncoderSetup &setup, uint64_t frame, std::vector<uint8_t> &output)
+{
+    const FilterTables &tables = GetFilterTables();
+    const unsigned channels = setup.m_channels;
+    const uint16_t *sfb = g_sfb_long[setup.m_rate_index];
+
+    // Gather the samples the filterbank needs for the 54 time slots
+    // from the granule before this frame through the end of it.
+    // The MDCT of each granule overlaps the one before it.
+    static const int kSlots = 54;
+    static const int kInputSamples = (kSlots - 1) * 32 + 512;
+    std::vector<float> input(static_cast<size_t>(kInputSamples) * channels);
+    int64_t first = static_cast<int64_t>(frame * kFrameSamples) - kInputDelay - 576 - 480;
+    for (unsigned ch = 0; ch < channels; ch++)
+    {
+        float *dest = &input[static_cast<size_t>(ch) * kInputSamples];
+        for (int i = 0; i < kInputSamples; i++)
+        {
+            int64_t index = first + i;
+            if (index >= 0 && static_cast<uint64_t>(index) < setup.m_sample_count)
+                dest[i] = setup.m_samples[static_cast<size_t>(index) * channels + ch];
+            else
+                dest[i] = 0.0f;
+        }
+    }
+
+    // Run the filterbank, then the MDCT of each subband, and cancel
+    // the aliasing between neighboring subbands.
+    float xr[2][2][kGranuleLines];
+    alignas(16) float subbands[kSlots][32];
+    for (unsigned ch = 0; ch < channels; ch++)
+    {
+        const float *chinput = &input[static_cast<size_t>(ch) * kInputSamples];
+        for (int slot = 0; slot < kSlots; slot++)
+            AnalyzeSlot(tables, chinput + slot * 32, subbands[slot]);
+
+        // The decoder inverts every other sample in the odd subbands.
+        for (int slot = 1; slot < kSlots; slot += 2)
+        {
+            for (int k = 1; k < 32; k += 2)
+                subbands[slot][k] = -subbands[slot][k];
+        }
+
+        for (int gr = 0; gr < 2; gr++)
+        {
+            float *lines = xr[gr][ch];
+            for (int k = 0; k < 32; k++)
+            {
+                alignas(16) float block[36];
+                for (int i = 0; i < 36; i++)
+                    block[i] = subbands[gr * 18 + i][k];
+                for (int j = 0; j < 18; j++)
+                    lines[k * 18 + j] = DotProduct(tables.m_mdct[j], block, 36);
+            }
+
+            for (int k = 1; k < 32; k++)
+            {
+                for (int i = 0; i < 8; i++)
+                {
+                    float upper = lines[k * 18 + i];
+                    float lower = lines[k * 18 - 1 - i];
+                    lines[k * 18 + i] = upper * g_aa_cs[i] + lower * g_aa_ca[i];
+                    lines[k * 18 - 1 - i] = lower * g_aa_cs[i] - upper * g_aa_ca[i];
+                }
+            }
+
+            for (unsigned i = setup.m_lowpass_lines; i < kGranuleLines; i++)
+                lines[i] = 0.0f;
+        }
+    }
+
+    // Code the channels as mid and side if the quantized lines
+    // would come out smaller that way.
+    bool mid_side = false;
+    if (channels == 2)
+    {
+        float left_right = 0.0f;
+        float mid_side_sum = 0.0f;
+        for (int gr = 0; gr < 2; gr++)
+        {
+            for (unsigned i = 0; i < setup.m_lowpass_lines; i++)
+            {
+                float left = fabsf(xr[gr][0][i]);
+                float right = fabsf(xr[gr][1][i]);
+                float mid = fabsf(xr[gr][0][i] + xr[gr][1][i]) * 0.70710678f;
+                float side = fabsf(xr[gr][0][i] - xr[gr][1][i]) * 0.70710678f;
+                left_right += sqrtf(left * sqrtf(left)) + sqrtf(right * sqrtf(right));
+                mid_side_sum += sqrtf(mid * sqrtf(mid)) + sqrtf(side * sqrtf(side));
+            }
+        }
+        mid_side = mid_side_sum < left_right;
+
+        if (mid_side)
+        {
+            for (int gr = 0; gr < 2; gr++)
+            {
+                for (unsigned i = 0; i < kGranuleLines; i++)
+                {
+                    float left = xr[gr][0][i];
+                    float right = xr[gr][1][i];
+                    xr[gr][0][i] = (left + right) * 0.70710678f;
+                    xr[gr][1][i] = (left - right) * 0.70710678f;
+                }
+            }
+        }
+    }
+
+    // The quantizer works on |xr| to the 3/4 power.
+    float xr34[2][2][kGranuleLines];
+    for (int gr = 0; gr < 2; gr++)
+    {
+        for (unsigned ch = 0; ch < channels; ch++)
+        {
+            for (unsigned i = 0; i < kGranuleLines; i++)
+            {
+                float value = fabsf(xr[gr][ch][i]);
+                xr34[gr][ch][i] = sqrtf(value * sqrtf(value));
+            }
+        }
+    }
+
+    // Find the finest step size for each granule whose lines fit
+    // in the frame.  Granule 1 gets whatever granule 0 left over.
+    const size_t frame_bytes = GetFrameBytes(setup, frame);
+    const unsigned side_bytes = (channels == 1) ? 17 : 32;
+    const unsigned available = static_cast<unsigned>(frame_bytes - 4 - side_bytes) * 8;
+    GranuleChannel gc[2][2];
+    unsigned global_gain[2] = {};
+    unsigned used = 0;
+    for (int gr = 0; gr < 2; gr++)
+    {
+        const unsigned budget = (gr == 0) ? available / 2 : available - used;
+        unsigned total = 0;
+        auto fits = [&](unsigned gain) -> bool
+        {
+            total = 0;
+            for (unsigned ch = 0; ch < channels; ch++)
+            {
+                if (!QuantizeAndCount(xr34[gr][ch], gain, sfb, false, gc[gr][ch]) ||
+                    gc[gr][ch].m_part23_length > kMaxPart23Bits)
+                {
+                    return false;
+                }
+                total += gc[gr][ch].m_part23_length;
+            }
+            return total <= budget;
+        };
+
+        // The bit count falls as the step size grows, though not
+        // always strictly, so the search result is checked after.
+        unsigned low = 0;
+        unsigned high = 255;
+        while (low < high)
+        {
+            unsigned mid = (low + high) / 2;
+            if (fits(mid))
+                high = mid;
+            else
+                low = mid + 1;
+        }
+        while (!fits(low))
+        {
+            if (low == 255)
+            {
+                // Even the coarsest step size doesn't fit, which
+                // only happens with wildly out of range samples.
+                for (unsigned ch = 0; ch < channels; ch++)
+                {
+                    gc[gr][ch] = GranuleChannel();
+                    memset(gc[gr][ch].m_ix, 0, sizeof(gc[gr][ch].m_ix));
+                }
+                total = 0;
+                break;
+            }
+            low++;
+        }
+        // Now that the step size is settled, find the best regions,
+        // which can only make the coding smaller.
+        if (total > 0)
+        {
+            total = 0;
+            for (unsigned ch = 0; ch < channels; ch++)
+            {
+                QuantizeAndCount(xr34[gr][ch], low, sfb, true, gc[gr][ch]);
+                total += gc[gr][ch].m_part23_length;
+            }
+        }
+        global_gain[gr] = low;
+        used += total;
+    }
+
+    // Write the frame header.
+    output.assign(frame_bytes, 0);
+    BitWriter bits(output.data());
+    bits.Put(0xFFF, 12);                            // Sync word.
+    bits.Put(1, 1);                                 // MPEG-1.
+    bits.Put(1, 2);                                 // Layer III.
+    bits.Put(1, 1);                                 // No CRC.
+    bits.Put(setup.m_bitrate_index, 4);
+    bits.Put(setup.m_rate_index, 2);
+    bits.Put(frame_bytes > GetFrameBytes(setup, 0) ? 1 : 0, 1);
+    bits.Put(0, 1);                                 // Private bit.
+    bits.Put(channels == 1 ? 3 : 1, 2);             // Mono or joint stereo.
+    bits.Put(mid_side ? 2 : 0, 2);                  // Mode extension.
+    bits.Put(0, 1);                                 // Not copyrighted.
+    bits.Put(1, 1);                                 // Original.
+    bits.Put(0, 2);                                 // No emphasis.
+
+    // Write the side info.  The main data always starts in this
+    // frame and there are no scale factors.
+    bits.Put(0, 9);                                 // main_data_begin
+    bits.Put(0, channels == 1 ? 5 : 3);             // Private bits.
+    bits.Put(0, 4 * channels);                      // scfsi
+    for (int gr = 0; gr < 2; gr++)
+    {
+        for (unsigned ch = 0; ch < channels; ch++)
+        {
+            const GranuleChannel &info = gc[gr][ch];
+            bits.Put(info.m_part23_length, 12);
+            bits.Put(info.m_big_values, 9);
+            bits.Put(global_gain[gr], 8);
+            bits.Put(0, 4);                         // scalefac_compress
+            bits.Put(0, 1);                         // window_switching_flag
+            for (int region = 0; region < 3; region++)
+                bits.Put(info.m_table_select[region], 5);
+            bits.Put(info.m_region0_count, 4);
+            bits.Put(info.m_region1_count, 3);
+            bits.Put(0, 1);                         // preflag
+            bits.Put(0, 1);                         // scalefac_scale
+            bits.Put(info.m_count1_table, 1);
+        }
+    }
+
+    for (int gr = 0; gr < 2; gr++)
+    {
+        for (unsigned ch = 0; ch < channels; ch++)
+            WriteMainData(bits, xr[gr][ch], sfb, gc[gr][ch]);
+    }
+
+#ifdef TRACE
+    if (bits.GetPosition() != (4 + side_bytes) * 8 + used)
+    {
+        printf("EncodeFrame %llu wrote %zu bits, expected %u\n",
+            static_cast<unsigned long long>(frame), bits.GetPosition(),
+            (4 + side_bytes) * 8 + used);
+    }
+#endif
+}
+
+// Returns the sample rate that audio at 'rate' Hz should be
+// resampled to before encoding it with MP3FileWrite.
+unsigned MP3EncoderRate(unsigned rate)
+{
+    for (unsigned i = 0; i < 3; i++)
+    {
+        if (rate == g_rates[i])
+            return rate;
+    }
+
+    // Prefer a rate that's a whole multiple or fraction of the
+    // original.
+    if (rate % 11025 == 0)
+        return 44100;
+    if (rate > 0 && rate < 32000 && 32000 % rate == 0)
+        return 32000;
+    return 48000;
+}
+
+// Encodes a buffer of interleaved floating-point audio samples
+// and writes them to an MP3 file.
+bool MP3FileWrite(
+        const wchar_t *filename,
+        const float *samples,
+        size_t sample_count,
+        unsigned channels,
+        unsigned rate,
+        unsigned bitrate,
+        void *status_callback_context,
+        bool (*status_callback_func)(void *context, float completion))
+{
+#ifdef TRACE
+    printf("MP3FileWrite '%S', %u Hz, %u channels, %u kbps\n", filename, rate, channels, bitrate);
+#endif
+
+    if (channels < 1 || channels > 2 || (samples == nullptr && sample_count > 0))
+        return false;
+
+    EncoderSetup setup;
+    setup.m_samples = samples;
+    setup.m_sample_count = sample_count;
+    setup.m_channels = channels;
+
+    setup.m_rate_index = 3;
+    for (unsigned i = 0; i < 3; i++)
+    {
+        if (rate == g_rates[i])
+            setup.m_rate_index = i;
+    }
+    if (setup.m_rate_index == 3)
+        return false;
+
+    setup.m_bitrate_index = 1;
+    for (unsigned i = 2; i < 15; i++)
+    {
+        if (abs(static_cast<int>(g_bitrates[i]) - static_cast<int>(bitrate)) <
+            abs(static_cast<int>(g_bitrates[setup.m_bitrate_index]) - static_cast<int>(bitrate)))
+        {
+            setup.m_bitrate_index = i;
+        }
+    }
+
+    // Spend the bits on the lower frequencies at low bit rates.
+    unsigned channel_kbps = g_bitrates[setup.m_bitrate_index] / channels;
+    unsigned lowpass_hz = 10000 + 75 * channel_kbps;
+    setup.m_lowpass_lines = std::min<unsigned>(kGranuleLines,
+        static_cast<unsigned>(static_cast<uint64_t>(lowpass_hz) * 2 * kGranuleLines / rate));
+
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"wb") != 0 || fp == nullptr)
+        return false;
+    ScopedFile sfp(fp);
+
+    // The extra frame makes up for the encoder's delay.
+    uint64_t frame_count = (sample_count + kFrameSamples - 1) / kFrameSamples + 1;
+    std::vector<std::vector<uint8_t>> frames(static_cast<size_t>(std::min<uint64_t>(frame_count, kFramesPerBatch)));
+    ThreadPool &pool = ThreadPool::GetShared();
+    for (uint64_t first = 0; first < frame_count; first += frames.size())
+    {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(frames.size(), frame_count - first));
+        pool.RunTasks(count, [&](size_t index)
+        {
+            EncodeFrame(setup, first + index, frames[index]);
+        });
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (fwrite(frames[i].data(), 1, frames[i].size(), fp) != frames[i].size())
+            {
+#ifdef TRACE
+                printf("MP3FileWrite failed writing frame %llu\n",
+                    static_cast<unsigned long long>(first + i));
+#endif
+                return false;
+            }
+        }
+
+        if (status_callback_func &&
+            !status_callback_func(status_callback_context,
+                static_cast<float>(first + count) / static_cast<float>(frame_count)))
+        {
+            return false;
+        }
+    }
+
+    sfp.Close();
+    return true;
+}
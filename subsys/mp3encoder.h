@@ -0,0 +1,89 @@
+//-------------------------------------------------------------------
+//
+// mp3encoder.h
+//
+// C++ module for encoding audio samples as an MPEG-1 Layer III
+// (MP3) file.
+//
+// Note this module intentionally doesn't use any definitions from
+// windows.h so we can avoid including it here.
+//
+// Limitations:
+//
+// * Only MPEG-1 sample rates (32000, 44100, and 48000 Hz) and
+//   one or two channels are supported.  Use MP3EncoderRate to
+//   choose a rate to resample other audio to.
+// * Constant bit rate only.  There's no psychoacoustic model or
+//   bit reservoir, so every frame can be encoded on its own.
+// * Long blocks only, without scale factors.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Returns the sample rate that audio at 'rate' Hz should be
+// resampled to before encoding it with MP3FileWrite.  This is
+// 'rate' itself if MPEG-1 supports it.
+unsigned MP3EncoderRate(unsigned rate);
+
+// Encodes a buffer of interleaved floating-point audio samples,
+// nominally ranging from -1.0 to 1.0, and writes them to an MP3
+// file.  'sample_count' is the number of samples per channel, and
+// 'bitrate' is the bit rate in kilobits per second, which is
+// rounded to the nearest one MPEG-1 Layer III allows.
+//
+// The frames are encoded in parallel batches on the shared thread
+// pool and written as each batch completes.  The decoded audio is
+// the original delayed by exactly one frame (1152 samples), padded
+// with silence to a whole number of frames.
+//
+// If a pointer to a status callback function is provided, it's
+// called after each batch with the completion from 0.0 to 1.0.  If
+// it returns false, encoding stops and this returns false.
+//
+// Returns true if successful.
+bool MP3FileWrite(
+        const wchar_t *filename,
+        const float *samples,
+        size_t sample_count,
+        unsigned channels,
+        unsigned rate,
+        unsigned bitrate,
+        void *status_callback_context = nullptr,
+        bool (*status_callback_func)(void *context, float completion) = nullptr);
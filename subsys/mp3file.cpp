@@ -0,0 +1,754 @@
+//-------------------------------------------------------------------
+//
+// mp3file.cpp
+//
+// C++ module to examine the frame structure of MPEG audio (MP3)
+// files without decoding the audio data.
+//
+// See mp3file.h for additional comments.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+//#define TRACE // Define TRACE to enable debug printfs in this module.
+#include "mp3file.h"
+#include "platform.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+// Handy class to auto-close a stdio FILE when it goes out of scope.
+class ScopedFile
+{
+public:
+    explicit ScopedFile(FILE *file) : m_file(file) { }
+    ~ScopedFile() { Close(); }
+    void Close() { if (m_file) fclose(m_file); m_file = nullptr; }
+
+private:
+    FILE *m_file;
+};
+
+// Reads an open file through a memory buffer, so that hopping from
+// one frame header to the next only touches the disk when the hop
+// leaves the buffered region.  Can also be pointed at a file that's
+// already entirely in memory.
+class MP3FileReader
+{
+public:
+    explicit MP3FileReader(FILE *fp) : m_fp(fp), m_buffer(64 * 1024)
+    {
+        if (_fseeki64(m_fp, 0, SEEK_END) == 0)
+        {
+            int64_t bytes = _ftelli64(m_fp);
+            if (bytes > 0)
+                m_file_size = static_cast<uint64_t>(bytes);
+        }
+    }
+
+    MP3FileReader(const uint8_t *data, size_t size) : m_data(data), m_file_size(size) { }
+
+    uint64_t GetFileSize() const { return m_file_size; }
+
+    // Returns a pointer to 'count' bytes of the file starting at
+    // 'offset', or nullptr if those bytes can't be read.  The
+    // pointer is valid until the next call.
+    const uint8_t *Peek(uint64_t offset, size_t count)
+    {
+        if (offset + count > m_file_size)
+            return nullptr;
+        if (m_data)
+            return m_data + offset;
+        if (count > m_buffer.size())
+            return nullptr;
+
+        if (offset < m_buffer_offset || offset + count > m_buffer_offset + m_buffer_bytes)
+        {
+            m_buffer_offset = offset;
+            m_buffer_bytes = 0;
+            if (_fseeki64(m_fp, static_cast<int64_t>(offset), SEEK_SET))
+                return nullptr;
+            m_buffer_bytes = fread(m_buffer.data(), 1, m_buffer.size(), m_fp);
+            if (m_buffer_bytes < count)
+                return nullptr;
+        }
+
+        return &m_buffer[static_cast<size_t>(offset - m_buffer_offset)];
+    }
+
+private:
+    FILE *m_fp = nullptr;
+    const uint8_t *m_data = nullptr;
+    std::vector<uint8_t> m_buffer;
+    uint64_t m_buffer_offset = 0;
+    size_t m_buffer_bytes = 0;
+    uint64_t m_file_size = 0;
+};
+
+// Reads a big-endian 32-bit value.
+static uint32_t read_be32(const uint8_t *p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8)  |  static_cast<uint32_t>(p[3]);
+}
+
+// Returns true if 'h2' is a valid frame header for the same stream
+// as 'h1' (same version, layer, and sample rate).  This is the same
+// test the minimp3 decoder uses to decide it's still in sync.
+static bool frame_headers_match(const uint8_t *h1, const uint8_t *h2)
+{
+    MP3FrameHeader hdr;
+    return MP3ParseFrameHeader(h2, hdr) &&
+        ((h1[1] ^ h2[1]) & 0xFE) == 0 &&
+        ((h1[2] ^ h2[2]) & 0x0C) == 0;
+}
+
+// Returns the size of the ID3v2 tag at the start of the file, if
+// there is one, so the search for the first frame can skip it.
+static uint64_t get_id3v2_size(MP3FileReader &reader)
+{
+    const uint8_t *p = reader.Peek(0, 10);
+    if (!p || memcmp(p, "ID3", 3) != 0)
+        return 0;
+    if ((p[6] | p[7] | p[8] | p[9]) & 0x80)
+        return 0; // Not a valid synchsafe size.
+
+    uint64_t size = 10 + ((p[6] << 21) | (p[7] << 14) | (p[8] << 7) | p[9]);
+    if (p[5] & 0x10)
+        size += 10; // Tag has a footer.
+    return size;
+}
+
+// Checks that the frame at 'offset' is followed by several more
+// frames of the same stream, so a stray sync pattern in tag data
+// isn't mistaken for audio.  Mirrors mp3d_match_frame in minimp3.
+static bool confirm_frame_sequence(MP3FileReader &reader, uint64_t offset, const MP3FrameHeader &first)
+{
+    const int max_matches = 10;
+    const uint8_t *p = reader.Peek(offset, 4);
+    if (!p)
+        return false;
+    uint8_t ref[4];
+    memcpy(ref, p, sizeof(ref));
+
+    uint64_t next = offset + first.m_frame_bytes;
+    for (int nmatch = 0; nmatch < max_matches; nmatch++)
+    {
+        if (next + 4 > reader.GetFileSize())
+            return nmatch > 0;
+
+        p = reader.Peek(next, 4);
+        MP3FrameHeader hdr;
+        if (!p || !frame_headers_match(ref, p) || !MP3ParseFrameHeader(p, hdr))
+            return false;
+        next += hdr.m_frame_bytes;
+    }
+
+    return true;
+}
+
+// Searches forward from 'offset' for the start of a run of valid
+// frames.  Returns true and updates 'offset' if one is found.
+static bool find_frame(MP3FileReader &reader, uint64_t &offset, MP3FrameHeader &hdr)
+{
+    for (; offset + 4 <= reader.GetFileSize(); offset++)
+    {
+        const uint8_t *p = reader.Peek(offset, 4);
+        if (!p)
+            return false;
+        if (p[0] != 0xFF || !MP3ParseFrameHeader(p, hdr))
+            continue;
+        if (offset + hdr.m_frame_bytes <= reader.GetFileSize() &&
+            confirm_frame_sequence(reader, offset, hdr))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Parses the four byte MPEG audio frame header at 'h'.
+//
+// Returns true if the bytes form a valid frame header.
+bool MP3ParseFrameHeader(const uint8_t *h, MP3FrameHeader &header)
+{
+    static const uint16_t bitrates[2][3][15] =
+    {
+        { // MPEG 2 and 2.5, layers 1, 2, 3.
+            { 0,32,48,56,64,80,96,112,128,144,160,176,192,224,256 },
+            { 0,8,16,24,32,40,48,56,64,80,96,112,128,144,160 },
+            { 0,8,16,24,32,40,48,56,64,80,96,112,128,144,160 },
+        },
+        { // MPEG 1, layers 1, 2, 3.
+            { 0,32,64,96,128,160,192,224,256,288,320,352,384,416,448 },
+            { 0,32,48,56,64,80,96,112,128,160,192,224,256,320,384 },
+            { 0,32,40,48,56,64,80,96,112,128,160,192,224,256,320 },
+        },
+    };
+    static const unsigned rates[3] = { 44100, 48000, 32000 };
+
+    // Check the sync bits.  MPEG 2.5 is only recognized for layer 3,
+    // which matches what the decoder accepts.
+    if (h[0] != 0xFF)
+        return false;
+    if ((h[1] & 0xF0) != 0xF0 && (h[1] & 0xFE) != 0xE2)
+        return false;
+
+    unsigned version_bits = (h[1] >> 3) & 3;
+    unsigned layer_bits   = (h[1] >> 1) & 3;
+    unsigned bitrate_bits = h[2] >> 4;
+    unsigned rate_bits    = (h[2] >> 2) & 3;
+    if (layer_bits == 0 || bitrate_bits == 15 || rate_bits == 3)
+        return false;
+    if (bitrate_bits == 0)
+        return false; // Free-format streams aren't supported.
+
+    bool mpeg1 = (version_bits == 3);
+    header.m_version  = mpeg1 ? 1 : ((version_bits == 2) ? 2 : 25);
+    header.m_layer    = 4 - layer_bits;
+    header.m_bitrate  = bitrates[mpeg1 ? 1 : 0][header.m_layer - 1][bitrate_bits];
+    header.m_rate     = rates[rate_bits] >> (mpeg1 ? 0 : 1) >> ((version_bits == 0) ? 1 : 0);
+    header.m_channels = ((h[3] >> 6) == 3) ? 1 : 2;
+
+    bool padding = ((h[2] >> 1) & 1) != 0;
+    if (header.m_layer == 1)
+    {
+        header.m_frame_samples = 384;
+        header.m_frame_bytes = (header.m_frame_samples * header.m_bitrate * 125 / header.m_rate) & ~3u;
+        header.m_frame_bytes += padding ? 4 : 0;
+    }
+    else
+    {
+        header.m_frame_samples = (header.m_layer == 3 && !mpeg1) ? 576 : 1152;
+        header.m_frame_bytes = header.m_frame_samples * header.m_bitrate * 125 / header.m_rate;
+        header.m_frame_bytes += padding ? 1 : 0;
+    }
+
+    return true;
+}
+
+// Looks for a Xing/Info or VBRI tag in the given first frame of a
+// stream.  Returns true and sets 'frame_count' to the number of
+// audio frames that follow the tag frame if one is found.
+static bool read_vbr_tag(const uint8_t *frame, const MP3FrameHeader &hdr, uint32_t &frame_count)
+{
+    if (hdr.m_layer != 3)
+        return false;
+
+    // The Xing tag sits just after the side information.
+    size_t side_info_bytes = (hdr.m_version == 1) ?
+        ((hdr.m_channels == 1) ? 17 : 32) :
+        ((hdr.m_channels == 1) ? 9 : 17);
+    size_t offset = 4 + side_info_bytes + (((frame[1] & 1) == 0) ? 2 : 0);
+    if (offset + 12 <= hdr.m_frame_bytes &&
+        (memcmp(frame + offset, "Xing", 4) == 0 || memcmp(frame + offset, "Info", 4) == 0))
+    {
+        uint32_t flags = read_be32(frame + offset + 4);
+        if (!(flags & 1))
+            return false; // No frame count in this tag.
+        frame_count = read_be32(frame + offset + 8);
+        return true;
+    }
+
+    // The VBRI tag is always 32 bytes after the frame header.
+    offset = 4 + 32;
+    if (offset + 18 <= hdr.m_frame_bytes && memcmp(frame + offset, "VBRI", 4) == 0)
+    {
+        frame_count = read_be32(frame + offset + 14);
+        return true;
+    }
+
+    return false;
+}
+
+// Fills in the format fields of 'info' from the stream's first frame.
+static void set_stream_format(MP3Info &info, const MP3FrameHeader &hdr, uint64_t offset)
+{
+    info.m_version       = hdr.m_version;
+    info.m_layer         = hdr.m_layer;
+    info.m_rate          = hdr.m_rate;
+    info.m_channels      = hdr.m_channels;
+    info.m_frame_samples = hdr.m_frame_samples;
+    info.m_data_offset   = offset;
+}
+
+// Calculates the average bit rate from the byte and sample counts.
+static void set_average_bitrate(MP3Info &info)
+{
+    info.m_bitrate = 0;
+    if (info.m_sample_count > 0 && info.m_rate > 0)
+    {
+        info.m_bitrate = static_cast<unsigned>(
+            info.m_data_bytes * 8 * info.m_rate / info.m_sample_count / 1000);
+    }
+}
+
+// Reads the format and length of the audio stream in an MP3 file
+// without decoding it.  If the first frame carries a Xing/Info or
+// VBRI tag with a frame count, only the start of the file is read;
+// otherwise this falls back to MP3FileScanFrames.
+//
+// Returns true if successful.
+bool MP3FileReadInfo(const wchar_t *filename, MP3Info &info)
+{
+#ifdef TRACE
+    printf("MP3FileReadInfo file='%S'\n", filename);
+#endif
+
+    info = MP3Info();
+    if (!filename || !*filename)
+        return false;
+
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"rb") || !fp)
+        return false;
+    ScopedFile sfp(fp);
+    MP3FileReader reader(fp);
+
+    uint64_t offset = get_id3v2_size(reader);
+    MP3FrameHeader hdr;
+    if (!find_frame(reader, offset, hdr))
+        return false;
+
+    const uint8_t *frame = reader.Peek(offset, hdr.m_frame_bytes);
+    uint32_t frame_count = 0;
+    if (frame && read_vbr_tag(frame, hdr, frame_count) && frame_count > 0)
+    {
+        // The decoder also emits the tag frame itself (as silence),
+        // so it's included in the count to match a full decode.
+        set_stream_format(info, hdr, offset);
+        info.m_frame_count  = static_cast<uint64_t>(frame_count) + 1;
+        info.m_sample_count = info.m_frame_count * hdr.m_frame_samples;
+        info.m_data_bytes   = reader.GetFileSize() - offset;
+        info.m_from_tag     = true;
+        set_average_bitrate(info);
+#ifdef TRACE
+        printf("MP3FileReadInfo frames=%llu from VBR tag\n", info.m_frame_count);
+#endif
+        return true;
+    }
+
+    sfp.Close();
+    return MP3FileScanFrames(filename, info);
+}
+
+// Walks every frame header reachable through the given reader.
+// See MP3FileScanFrames.
+static bool scan_frames(MP3FileReader &reader, MP3Info &info, std::vector<uint64_t> *frame_offsets)
+{
+    info = MP3Info();
+    if (frame_offsets)
+        frame_offsets->clear();
+
+    uint64_t file_size = reader.GetFileSize();
+    uint64_t offset = get_id3v2_size(reader);
+    uint64_t end_offset = 0;
+    uint8_t ref[4] = {0};
+    bool synced = false;
+
+    for (;;)
+    {
+        MP3FrameHeader hdr;
+        const uint8_t *p = nullptr;
+
+        if (!synced)
+        {
+            // Find the start of the stream, or re-sync after junk.
+            if (!find_frame(reader, offset, hdr))
+                break;
+            p = reader.Peek(offset, 4);
+            if (info.m_frame_count == 0)
+                set_stream_format(info, hdr, offset);
+            synced = true;
+        }
+        else
+        {
+            // The decoder stays in sync as long as each frame is
+            // followed by a matching header or by the end of file.
+            p = reader.Peek(offset, 4);
+            if (!p || !frame_headers_match(ref, p) || !MP3ParseFrameHeader(p, hdr))
+            {
+                synced = false;
+                continue;
+            }
+            uint64_t next = offset + hdr.m_frame_bytes;
+            if (next != file_size)
+            {
+                uint8_t cur[4];
+                memcpy(cur, p, sizeof(cur));
+                const uint8_t *pnext = reader.Peek(next, 4);
+                if (!pnext || !frame_headers_match(cur, pnext))
+                {
+                    synced = false;
+                    continue;
+                }
+                p = reader.Peek(offset, 4);
+            }
+        }
+
+        memcpy(ref, p, sizeof(ref));
+        if (frame_offsets)
+            frame_offsets->push_back(offset);
+        info.m_frame_count++;
+        info.m_sample_count += hdr.m_frame_samples;
+        offset += hdr.m_frame_bytes;
+        end_offset = offset;
+    }
+
+    if (info.m_frame_count == 0)
+        return false;
+
+    info.m_data_bytes = end_offset - info.m_data_offset;
+    set_average_bitrate(info);
+
+#ifdef TRACE
+    printf("scan_frames frames=%llu samples=%llu\n",
+        info.m_frame_count, info.m_sample_count);
+#endif
+    return true;
+}
+
+// The number of times MP3FileScanFrames has walked a file, as
+// returned by MP3FileGetScanCount.
+static std::atomic<uint64_t> g_scan_count(0);
+
+// Reads the format and length of the audio stream in an MP3 file
+// by walking every frame header in the file.  The frames are
+// counted the same way the decoder in waveformload.cpp will find
+// them, so the sample count matches a full decode.  If a vector
+// is given for 'frame_offsets', it receives the file offset of
+// every frame.
+//
+// Returns true if successful.
+bool MP3FileScanFrames(const wchar_t *filename, MP3Info &info, std::vector<uint64_t> *frame_offsets)
+{
+#ifdef TRACE
+    printf("MP3FileScanFrames file='%S'\n", filename);
+#endif
+    ++g_scan_count;
+
+    info = MP3Info();
+    if (!filename || !*filename)
+        return false;
+
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"rb") || !fp)
+        return false;
+    ScopedFile sfp(fp);
+    MP3FileReader reader(fp);
+
+    return scan_frames(reader, info, frame_offsets);
+}
+
+// Same as MP3FileScanFrames, but for an MP3 file that has already
+// been read into memory.
+//
+// Returns true if successful.
+bool MP3ScanFrames(const uint8_t *data, size_t size, MP3Info &info, std::vector<uint64_t> *frame_offsets)
+{
+    info = MP3Info();
+    if (!data || !size)
+        return false;
+
+    MP3FileReader reader(data, size);
+    return scan_frames(reader, info, frame_offsets);
+}
+
+#pragma pack(1)
+
+// The header at the start of an MP3 index sidecar file.  It's
+// followed by 'frame_count' 64-bit frame offsets.
+typedef struct
+{
+    char     signature[8];      // "MP3INDEX"
+    uint32_t version;           // Layout version, currently 1.
+    uint64_t file_size;         // Size of the MP3 file that was indexed.
+    int64_t  file_time;         // Modification time of the MP3 file.
+    uint32_t mpeg_version;
+    uint32_t layer;
+    uint32_t rate;
+    uint32_t channels;
+    uint32_t bitrate;
+    uint32_t frame_samples;
+    uint64_t frame_count;
+    uint64_t sample_count;
+    uint64_t data_offset;
+    uint64_t data_bytes;
+} MP3IDXHDR;
+
+#pragma pack()
+
+static const char g_index_signature[8] = { 'M', 'P', '3', 'I', 'N', 'D', 'E', 'X' };
+static const uint32_t g_index_version = 1;
+
+// Gets the size and modification time of a file, which identify
+// the version of the MP3 file that an index sidecar was made from.
+// Returns true if successful.
+static bool get_file_stamp(const wchar_t *filename, uint64_t &size, int64_t &time)
+{
+    struct _stat64 st;
+    if (_wstat64(filename, &st) != 0)
+        return false;
+
+    size = static_cast<uint64_t>(st.st_size);
+    time = static_cast<int64_t>(st.st_mtime);
+    return true;
+}
+
+// Reads an index sidecar file, if there is one and it matches the
+// given file stamp.  Returns true if successful.
+static bool read_index_sidecar(
+        const wchar_t *idx_filename,
+        uint64_t file_size,
+        int64_t file_time,
+        MP3Info &info,
+        std::vector<uint64_t> &frame_offsets)
+{
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, idx_filename, L"rb") || !fp)
+        return false; // No sidecar yet.
+    ScopedFile sfp(fp);
+
+    MP3IDXHDR hdr = {0};
+    if (fread(&hdr, 1, sizeof(hdr), fp) != sizeof(hdr))
+        return false;
+    if (memcmp(hdr.signature, g_index_signature, sizeof(hdr.signature)) != 0 ||
+        hdr.version != g_index_version)
+        return false; // Not an index file we understand.
+    if (hdr.file_size != file_size || hdr.file_time != file_time)
+        return false; // The MP3 file has changed since it was indexed.
+    if (hdr.frame_count == 0 || hdr.frame_count > file_size)
+        return false; // Corrupt.
+
+    frame_offsets.resize(static_cast<size_t>(hdr.frame_count));
+    size_t bytes = frame_offsets.size() * sizeof(uint64_t);
+    if (fread(frame_offsets.data(), 1, bytes, fp) != bytes)
+    {
+        frame_offsets.clear();
+        return false;
+    }
+
+    info = MP3Info();
+    info.m_version       = hdr.mpeg_version;
+    info.m_layer         = hdr.layer;
+    info.m_rate          = hdr.rate;
+    info.m_channels      = hdr.channels;
+    info.m_bitrate       = hdr.bitrate;
+    info.m_frame_samples = hdr.frame_samples;
+    info.m_frame_count   = hdr.frame_count;
+    info.m_sample_count  = hdr.sample_count;
+    info.m_data_offset   = hdr.data_offset;
+    info.m_data_bytes    = hdr.data_bytes;
+    return true;
+}
+
+// Writes an index sidecar file.  Returns true if successful.
+static bool write_index_sidecar(
+        const wchar_t *idx_filename,
+        uint64_t file_size,
+        int64_t file_time,
+        const MP3Info &info,
+        const std::vector<uint64_t> &frame_offsets)
+{
+    MP3IDXHDR hdr = {0};
+    memcpy(hdr.signature, g_index_signature, sizeof(hdr.signature));
+    hdr.version       = g_index_version;
+    hdr.file_size     = file_size;
+    hdr.file_time     = file_time;
+    hdr.mpeg_version  = info.m_version;
+    hdr.layer         = info.m_layer;
+    hdr.rate          = info.m_rate;
+    hdr.channels      = info.m_channels;
+    hdr.bitrate       = info.m_bitrate;
+    hdr.frame_samples = info.m_frame_samples;
+    hdr.frame_count   = frame_offsets.size();
+    hdr.sample_count  = info.m_sample_count;
+    hdr.data_offset   = info.m_data_offset;
+    hdr.data_bytes    = info.m_data_bytes;
+
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, idx_filename, L"wb") || !fp)
+        return false;
+    ScopedFile sfp(fp);
+
+    size_t bytes = frame_offsets.size() * sizeof(uint64_t);
+    if (fwrite(&hdr, 1, sizeof(hdr), fp) != sizeof(hdr) ||
+        fwrite(frame_offsets.data(), 1, bytes, fp) != bytes)
+    {
+        sfp.Close();
+        _wremove(idx_filename);
+        return false;
+    }
+
+    return true;
+}
+
+// Returns the number of times MP3FileScanFrames has walked a file.
+uint64_t MP3FileGetScanCount()
+{
+    return g_scan_count;
+}
+
+// An MP3 file's index, kept in memory by MP3FileReadIndex.
+struct MP3IndexMemo
+{
+    std::wstring m_filename;
+    uint64_t m_file_size = 0;
+    int64_t m_file_time = 0;
+    MP3Info m_info;
+    std::vector<uint64_t> m_frame_offsets;
+};
+
+// The indexes of the files most recently read by MP3FileReadIndex,
+// most recent first.  A few are kept so that loading several files
+// a range at a time, as a batch or a mix does, doesn't scan them
+// over and over.
+static const size_t kIndexMemoSize = 4;
+static std::mutex g_index_memo_mutex;
+static std::vector<MP3IndexMemo> g_index_memo;
+
+// Copies a file's index from memory, if it's there and the file's
+// size and modification time haven't changed.  Returns true if
+// successful.
+static bool read_index_memo(
+        const wchar_t *filename,
+        uint64_t file_size,
+        int64_t file_time,
+        MP3Info &info,
+        std::vector<uint64_t> &frame_offsets)
+{
+    std::lock_guard<std::mutex> lock(g_index_memo_mutex);
+    for (const MP3IndexMemo &memo : g_index_memo)
+    {
+        if (memo.m_filename == filename && memo.m_file_size == file_size && memo.m_file_time == file_time)
+        {
+            info = memo.m_info;
+            frame_offsets = memo.m_frame_offsets;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Keeps a file's index in memory, in place of any older one for
+// the same file, and forgets the least recent one if there are too
+// many.
+static void write_index_memo(
+        const wchar_t *filename,
+        uint64_t file_size,
+        int64_t file_time,
+        const MP3Info &info,
+        const std::vector<uint64_t> &frame_offsets)
+{
+    MP3IndexMemo memo;
+    memo.m_filename = filename;
+    memo.m_file_size = file_size;
+    memo.m_file_time = file_time;
+    memo.m_info = info;
+    memo.m_frame_offsets = frame_offsets;
+
+    std::lock_guard<std::mutex> lock(g_index_memo_mutex);
+    for (size_t i = 0; i < g_index_memo.size(); i++)
+    {
+        if (g_index_memo[i].m_filename == filename)
+        {
+            g_index_memo.erase(g_index_memo.begin() + i);
+            break;
+        }
+    }
+    g_index_memo.insert(g_index_memo.begin(), std::move(memo));
+    if (g_index_memo.size() > kIndexMemoSize)
+        g_index_memo.pop_back();
+}
+
+// Reads the frame index of an MP3 file: the format and length of
+// its audio stream plus the file offset of every frame.  See the
+// header for how the sidecar cache and the in-memory copies are
+// used.
+//
+// Returns true if successful.
+bool MP3FileReadIndex(
+        const wchar_t *filename,
+        MP3Info &info,
+        std::vector<uint64_t> &frame_offsets,
+        bool use_cache)
+{
+#ifdef TRACE
+    printf("MP3FileReadIndex file='%S' use_cache=%c\n", filename, use_cache ? 'Y' : 'N');
+#endif
+
+    info = MP3Info();
+    frame_offsets.clear();
+    if (!filename || !*filename)
+        return false;
+
+    uint64_t file_size = 0;
+    int64_t file_time = 0;
+    std::wstring idx_filename = std::wstring(filename) + L".idx";
+    bool have_stamp = get_file_stamp(filename, file_size, file_time);
+    if (!have_stamp)
+        use_cache = false;
+
+    if (use_cache && read_index_sidecar(idx_filename.c_str(), file_size, file_time, info, frame_offsets))
+    {
+#ifdef TRACE
+        printf("MP3FileReadIndex read %zu frames from sidecar\n", frame_offsets.size());
+#endif
+        return true;
+    }
+
+    if (have_stamp && read_index_memo(filename, file_size, file_time, info, frame_offsets))
+    {
+        if (use_cache)
+            write_index_sidecar(idx_filename.c_str(), file_size, file_time, info, frame_offsets);
+        return true;
+    }
+
+    if (!MP3FileScanFrames(filename, info, &frame_offsets))
+        return false;
+
+    if (have_stamp)
+        write_index_memo(filename, file_size, file_time, info, frame_offsets);
+    if (use_cache)
+        write_index_sidecar(idx_filename.c_str(), file_size, file_time, info, frame_offsets);
+
+    return true;
+}
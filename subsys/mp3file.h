@@ -0,0 +1,145 @@
+//-------------------------------------------------------------------
+//
+// mp3file.h
+//
+// C++ module to examine the frame structure of MPEG audio (MP3)
+// files without decoding the audio data.
+//
+// Note this module intentionally doesn't use any definitions from
+// windows.h or minimp3.h so we can avoid including them here.
+//
+// Limitations:
+//
+// * Free-format streams (bit rate index zero) aren't supported.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Describes one MPEG audio frame header.
+struct MP3FrameHeader
+{
+    unsigned m_version = 1;         // MPEG version: 1, 2, or 25 (for MPEG 2.5).
+    unsigned m_layer = 3;           // MPEG audio layer: 1, 2, or 3.
+    unsigned m_bitrate = 0;         // Bit rate in kilobits per second.
+    unsigned m_rate = 0;            // Sample rate in Hertz.
+    unsigned m_channels = 0;        // Channel count: 1=mono, 2=stereo.
+    unsigned m_frame_bytes = 0;     // Size of the frame in bytes, including padding.
+    unsigned m_frame_samples = 0;   // Number of audio samples (per channel) in the frame.
+};
+
+// Describes the audio stream in an MP3 file.
+struct MP3Info
+{
+    unsigned m_version = 1;         // MPEG version: 1, 2, or 25 (for MPEG 2.5).
+    unsigned m_layer = 3;           // MPEG audio layer: 1, 2, or 3.
+    unsigned m_rate = 0;            // Sample rate in Hertz.
+    unsigned m_channels = 0;        // Channel count: 1=mono, 2=stereo.
+    unsigned m_bitrate = 0;         // Average bit rate in kilobits per second.
+    unsigned m_frame_samples = 0;   // Number of audio samples (per channel) per frame.
+    uint64_t m_frame_count = 0;     // Number of audio frames in the file.
+    uint64_t m_sample_count = 0;    // Number of audio samples (per channel) in the file.
+    uint64_t m_data_offset = 0;     // File offset of the first audio frame.
+    uint64_t m_data_bytes = 0;      // Number of bytes from the first frame to the end of the last.
+    bool m_from_tag = false;        // True if the counts came from a Xing/Info/VBRI tag.
+};
+
+// Parses the four byte MPEG audio frame header at 'h'.
+//
+// Returns true if the bytes form a valid frame header.
+bool MP3ParseFrameHeader(const uint8_t *h, MP3FrameHeader &header);
+
+// Reads the format and length of the audio stream in an MP3 file
+// without decoding it.  If the first frame carries a Xing/Info or
+// VBRI tag with a frame count, only the start of the file is read;
+// otherwise this falls back to MP3FileScanFrames.
+//
+// Returns true if successful.
+bool MP3FileReadInfo(const wchar_t *filename, MP3Info &info);
+
+// Reads the format and length of the audio stream in an MP3 file
+// by walking every frame header in the file.  The frames are
+// counted the same way the decoder in waveformload.cpp will find
+// them, so the sample count matches a full decode.  If a vector
+// is given for 'frame_offsets', it receives the file offset of
+// every frame.
+//
+// Returns true if successful.
+bool MP3FileScanFrames(
+        const wchar_t *filename,
+        MP3Info &info,
+        std::vector<uint64_t> *frame_offsets = nullptr);
+
+// Same as MP3FileScanFrames, but for an MP3 file that has already
+// been read into memory.
+//
+// Returns true if successful.
+bool MP3ScanFrames(
+        const uint8_t *data,
+        size_t size,
+        MP3Info &info,
+        std::vector<uint64_t> *frame_offsets = nullptr);
+
+// Reads the frame index of an MP3 file: the format and length of
+// its audio stream plus the file offset of every frame, which is
+// what a decoder needs to start part way into the file.  Frame 'i'
+// begins at 'frame_offsets[i]' and holds the samples starting at
+// i * m_frame_samples.
+//
+// If 'use_cache' is true, the index is read from a sidecar file
+// (the MP3 filename with ".idx" appended) when there is one and it
+// was made from a file of the same size and modification time.
+// Failing that, the indexes of the last few files are kept in
+// memory, with their size and modification time, so reading a file
+// a range at a time only scans it once.  Otherwise the frame headers
+// are scanned with MP3FileScanFrames, and if 'use_cache' is true the
+// sidecar is written for next time.  Failing to write the sidecar is
+// not an error.
+//
+// Returns true if successful.
+bool MP3FileReadIndex(
+        const wchar_t *filename,
+        MP3Info &info,
+        std::vector<uint64_t> &frame_offsets,
+        bool use_cache);
+
+// Returns the number of times MP3FileScanFrames has walked the frame
+// headers of a file, so tests can check that indexes are reused.
+uint64_t MP3FileGetScanCount();
@@ -43,6 +43,9 @@
 #pragma once
 #include <vector>
 #include <cmath>
+#include "segmentedfilter.h"
+#include "dspkernels.h"
+#include "denormals.h"
 
 // Class to help apply a notch filter to a series of audio
 // samples using a second order infinite impulse response (IIR)
@@ -88,13 +91,43 @@ public:
         m_x_prev2 = m_x_prev1;
         m_x_prev1 = inputSample;
         m_y_prev2 = m_y_prev1;
-        m_y_prev1 = outputSample;
+        m_y_prev1 = FlushDenormal(outputSample);
 
         return outputSample;
     }
 
+    // Applies the notch filter to 'count' samples from 'in', writing
+    // them to 'out', which may be the same as 'in'.  Gives the same
+    // result as calling FilterSample on each sample in turn.
+    void FilterSamples(const float *in, float *out, size_t count)
+    {
+        BiquadState state = { m_b0, m_b1, m_b2, m_a1, m_a2, m_x_prev1, m_x_prev2, m_y_prev1, m_y_prev2 };
+        DSPKernelsGet().Biquad(state, in, out, count);
+        m_x_prev1 = state.m_x1;
+        m_x_prev2 = state.m_x2;
+        m_y_prev1 = state.m_y1;
+        m_y_prev2 = state.m_y2;
+    }
+
+    // Clears the filter's history, as if no samples had been filtered.
+    void Reset()
+    {
+        m_x_prev1 = 0.0;
+        m_x_prev2 = 0.0;
+        m_y_prev1 = 0.0;
+        m_y_prev2 = 0.0;
+    }
+
+    // Returns the number of samples it takes for a change in the
+    // filter's output history to die away to within 'tolerance'.
+    // The input history is right again after two samples.
+    size_t GetSettlingSamples(float tolerance) const
+    {
+        return BiquadSettlingSamples(m_a1, m_a2, tolerance);
+    }
+
 private:
-    const float pi = 3.1415927f;
+    static constexpr float pi = 3.1415927f;
     float m_sampleRate;
     float m_centerFrequency;
     float m_qFactor;
@@ -108,10 +141,10 @@ private:
         float alpha = std::sin(omega0) / (2.0f * m_qFactor);
 
         m_b0 = 1.0f;
-        m_b1 = -2.0f * std::cosf(omega0);
+        m_b1 = -2.0f * std::cos(omega0);
         m_b2 = 1.0f;
         m_a0 = 1.0f + alpha; // Note a0 is often 1 in standard IIR forms, but useful for clarity.
-        m_a1 = -2.0f * std::cosf(omega0);
+        m_a1 = -2.0f * std::cos(omega0);
         m_a2 = 1.0f - alpha;
 
         // Normalize coefficients by a0.
@@ -0,0 +1,292 @@
+//-------------------------------------------------------------------
+//
+// platform.cpp
+//
+// The parts of the platform layer (see platform.h) that aren't
+// inline:  the UTF-8 conversions, opening files, searching
+// directories, and the main() that calls wmain().  There's nothing
+// here for Windows, where the C runtime has all of these already.
+//
+//-------------------------------------------------------------------
+//
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#include "platform.h"
+
+#ifndef _WIN32
+
+#include <dirent.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <locale.h>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------
+// UTF-8
+//--------------------------------------------------
+
+std::string PlatformWideToUTF8(const wchar_t *text)
+{
+    std::string result;
+    for (; *text; ++text)
+    {
+        uint32_t c = static_cast<uint32_t>(*text);
+
+        // Join any UTF-16 surrogate pair into one code point.
+        if (sizeof(wchar_t) == 2 && c >= 0xD800 && c < 0xDC00 &&
+            text[1] >= 0xDC00 && text[1] < 0xE000)
+        {
+            c = 0x10000 + ((c - 0xD800) << 10) + (static_cast<uint32_t>(text[1]) - 0xDC00);
+            ++text;
+        }
+
+        if (c < 0x80)
+        {
+            result += static_cast<char>(c);
+        }
+        else if (c < 0x800)
+        {
+            result += static_cast<char>(0xC0 | (c >> 6));
+            result += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000)
+        {
+            if (c >= 0xD800 && c < 0xE000)
+            {
+                result += '?';
+                continue;
+            }
+            result += static_cast<char>(0xE0 | (c >> 12));
+            result += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x110000)
+        {
+            result += static_cast<char>(0xF0 | (c >> 18));
+            result += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            result += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            result += '?';
+        }
+    }
+    return result;
+}
+
+std::wstring PlatformUTF8ToWide(const char *text)
+{
+    std::wstring result;
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(text);
+    while (*p)
+    {
+        // Work out how many bytes the character has from its
+        // first byte, then check that the rest are all there.
+        uint32_t c = *p;
+        size_t count = 0;
+        uint32_t lowest = 0;
+        if (c < 0x80)
+            count = 0;
+        else if ((c & 0xE0) == 0xC0)
+            count = 1, c &= 0x1F, lowest = 0x80;
+        else if ((c & 0xF0) == 0xE0)
+            count = 2, c &= 0x0F, lowest = 0x800;
+        else if ((c & 0xF8) == 0xF0)
+            count = 3, c &= 0x07, lowest = 0x10000;
+        else
+            count = SIZE_MAX;
+
+        size_t i = 1;
+        for (; count != SIZE_MAX && i <= count; ++i)
+        {
+            if ((p[i] & 0xC0) != 0x80)
+                break;
+            c = (c << 6) | (p[i] & 0x3F);
+        }
+
+        if (count == SIZE_MAX || i <= count || c < lowest || c >= 0x110000 ||
+            (c >= 0xD800 && c < 0xE000))
+        {
+            // Skip just the bad byte, in case the next is good.
+            result += L'?';
+            ++p;
+            continue;
+        }
+        p += count + 1;
+
+        if (sizeof(wchar_t) == 2 && c >= 0x10000)
+        {
+            result += static_cast<wchar_t>(0xD800 + ((c - 0x10000) >> 10));
+            result += static_cast<wchar_t>(0xDC00 + ((c - 0x10000) & 0x3FF));
+        }
+        else
+        {
+            result += static_cast<wchar_t>(c);
+        }
+    }
+    return result;
+}
+
+//--------------------------------------------------
+// Files
+//--------------------------------------------------
+
+int _wfopen_s(FILE **fp, const wchar_t *filename, const wchar_t *mode)
+{
+    if (fp == nullptr || filename == nullptr || mode == nullptr)
+        return EINVAL;
+
+    *fp = fopen(PlatformWideToUTF8(filename).c_str(), PlatformWideToUTF8(mode).c_str());
+    return (*fp == nullptr) ? errno : 0;
+}
+
+//--------------------------------------------------
+// Directory searches
+//--------------------------------------------------
+
+namespace
+{
+
+// The state of one search by _wfindfirst64.
+struct FindState
+{
+    DIR *m_dir = nullptr;
+    std::string m_dirName;      // With a trailing '/', or empty.
+    std::string m_pattern;      // The name part of the pattern.
+};
+
+// Reads directory entries until one matches the search, and fills
+// in 'data' for it.  Returns false if there are no more.
+bool FindNext(FindState &state, struct _wfinddata64_t *data)
+{
+    while (struct dirent *entry = readdir(state.m_dir))
+    {
+        if (fnmatch(state.m_pattern.c_str(), entry->d_name, FNM_PERIOD) != 0)
+            continue;
+
+        struct stat st;
+        std::string path = state.m_dirName + entry->d_name;
+        if (stat(path.c_str(), &st) != 0)
+            continue;
+
+        std::wstring name = PlatformUTF8ToWide(entry->d_name);
+        if (name.size() >= _countof(data->name))
+            continue;
+
+        data->attrib = S_ISDIR(st.st_mode) ? _A_SUBDIR : 0;
+        data->size = static_cast<int64_t>(st.st_size);
+        wcscpy(data->name, name.c_str());
+        return true;
+    }
+    return false;
+}
+
+}
+
+intptr_t _wfindfirst64(const wchar_t *pattern, struct _wfinddata64_t *data)
+{
+    std::string text = PlatformWideToUTF8(pattern);
+    size_t slash = text.find_last_of('/');
+
+    FindState *state = new FindState;
+    state->m_dirName = (slash == std::string::npos) ? std::string() : text.substr(0, slash + 1);
+    state->m_pattern = (slash == std::string::npos) ? text : text.substr(slash + 1);
+    state->m_dir = opendir(state->m_dirName.empty() ? "." : state->m_dirName.c_str());
+    if (state->m_dir == nullptr || !FindNext(*state, data))
+    {
+        _findclose(reinterpret_cast<intptr_t>(state));
+        errno = ENOENT;
+        return -1;
+    }
+    return reinterpret_cast<intptr_t>(state);
+}
+
+int _wfindnext64(intptr_t handle, struct _wfinddata64_t *data)
+{
+    if (handle == -1 || !FindNext(*reinterpret_cast<FindState *>(handle), data))
+    {
+        errno = ENOENT;
+        return -1;
+    }
+    return 0;
+}
+
+int _findclose(intptr_t handle)
+{
+    if (handle == -1)
+        return -1;
+
+    FindState *state = reinterpret_cast<FindState *>(handle);
+    if (state->m_dir != nullptr)
+        closedir(state->m_dir);
+    delete state;
+    return 0;
+}
+
+//--------------------------------------------------
+// Entry point
+//--------------------------------------------------
+
+//
+// Calls the program's wmain() with the command line arguments
+// converted to wide strings.  The character type is taken from the
+// environment, so that wide strings print in the terminal's
+// encoding (or in UTF-8, the same as file names, if none is set),
+// but the numeric format is left alone so numbers are always
+// printed and parsed with a '.' as in the files we write.
+//
+int main(int argc, char **argv)
+{
+    const char *locale = setlocale(LC_CTYPE, "");
+    if (locale == nullptr || strcmp(locale, "C") == 0 || strcmp(locale, "POSIX") == 0)
+        setlocale(LC_CTYPE, "C.UTF-8");
+
+    std::vector<std::wstring> args;
+    args.reserve(static_cast<size_t>(argc));
+    for (int iarg = 0; iarg < argc; iarg++)
+        args.push_back(PlatformUTF8ToWide(argv[iarg]));
+
+    std::vector<wchar_t *> wargv;
+    for (std::wstring &arg : args)
+        wargv.push_back(&arg[0]);
+    wargv.push_back(nullptr);
+
+    return wmain(argc, wargv.data());
+}
+
+#endif
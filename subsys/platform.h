@@ -0,0 +1,166 @@
+//-------------------------------------------------------------------
+//
+// platform.h
+//
+// Thin layer that lets the code, which is written against the
+// Microsoft C runtime, also build with GCC or Clang on Linux and
+// other POSIX systems.  On Windows it just includes the runtime
+// headers the code needs.  Elsewhere it supplies the same names:
+// the wide-character file functions (which pass file names to the
+// system as UTF-8), 64-bit file offsets, the low-level I/O and
+// string functions, and directory searches.  It also supplies a
+// main() that calls the program's wmain() with its arguments
+// converted from UTF-8.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <wchar.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+
+#include <io.h>
+#include <fcntl.h>
+
+// Separator put between a directory and the name of a file in it.
+const wchar_t kPathSeparator = L'\\';
+
+#else
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string>
+
+// Separator put between a directory and the name of a file in it.
+const wchar_t kPathSeparator = L'/';
+
+// Converts a wide string to UTF-8, the encoding of file names and
+// command line arguments, and back.  Invalid characters become '?'.
+std::string PlatformWideToUTF8(const wchar_t *text);
+std::wstring PlatformUTF8ToWide(const char *text);
+
+// The program's entry point, which main() calls.
+int wmain(int argc, wchar_t **argv);
+
+//--------------------------------------------------
+// Files
+//--------------------------------------------------
+
+// Opens a file the same way as fopen.  Returns zero if successful,
+// or the error number.
+int _wfopen_s(FILE **fp, const wchar_t *filename, const wchar_t *mode);
+
+inline int _wremove(const wchar_t *filename) { return remove(PlatformWideToUTF8(filename).c_str()); }
+inline int _wunlink(const wchar_t *filename) { return unlink(PlatformWideToUTF8(filename).c_str()); }
+
+#define _stat64 stat
+#define _fstat64 fstat
+#define _S_IFMT S_IFMT
+#define _S_IFREG S_IFREG
+#define _S_IFDIR S_IFDIR
+inline int _wstat64(const wchar_t *filename, struct stat *st) { return stat(PlatformWideToUTF8(filename).c_str(), st); }
+inline int _wmkdir(const wchar_t *dirname) { return mkdir(PlatformWideToUTF8(dirname).c_str(), 0777); }
+
+inline int _fseeki64(FILE *fp, int64_t offset, int origin) { return fseeko(fp, static_cast<off_t>(offset), origin); }
+inline int64_t _ftelli64(FILE *fp) { return static_cast<int64_t>(ftello(fp)); }
+inline int64_t _ftelli64_nolock(FILE *fp) { return static_cast<int64_t>(ftello(fp)); }
+
+// Files are always binary here, so there's no text mode to set.
+#define _O_BINARY 0
+#define _O_TEXT 0
+inline int _setmode(int, int) { return _O_BINARY; }
+
+inline int _fileno(FILE *fp) { return fileno(fp); }
+inline int _dup(int fd) { return dup(fd); }
+inline int _dup2(int fd, int fd2) { return dup2(fd, fd2); }
+inline int _close(int fd) { return close(fd); }
+inline FILE *_fdopen(int fd, const char *mode) { return fdopen(fd, mode); }
+
+//--------------------------------------------------
+// Directory searches
+//--------------------------------------------------
+
+#define _A_SUBDIR 0x10
+
+// Describes one file found by _wfindfirst64 or _wfindnext64.
+struct _wfinddata64_t
+{
+    unsigned attrib;        // _A_SUBDIR for a directory.
+    int64_t size;
+    wchar_t name[1024];     // Without the directory.
+};
+
+// Finds the files that match a pattern, which may have the '*' and
+// '?' wildcards in its last part.  Returns a handle for finding the
+// rest, or -1 if there are none.
+intptr_t _wfindfirst64(const wchar_t *pattern, struct _wfinddata64_t *data);
+
+// Finds the next matching file.  Returns -1 when there are no more.
+int _wfindnext64(intptr_t handle, struct _wfinddata64_t *data);
+
+// Ends a search.
+int _findclose(intptr_t handle);
+
+//--------------------------------------------------
+// Strings
+//--------------------------------------------------
+
+inline int _wcsicmp(const wchar_t *a, const wchar_t *b) { return wcscasecmp(a, b); }
+inline int _wcsnicmp(const wchar_t *a, const wchar_t *b, size_t n) { return wcsncasecmp(a, b, n); }
+inline int _stricmp(const char *a, const char *b) { return strcasecmp(a, b); }
+inline int _wtoi(const wchar_t *text) { return static_cast<int>(wcstol(text, nullptr, 10)); }
+inline int64_t _wtoi64(const wchar_t *text) { return static_cast<int64_t>(wcstoll(text, nullptr, 10)); }
+inline double _wtof(const wchar_t *text) { return wcstod(text, nullptr); }
+
+// The string arguments to swscanf_s are followed by their sizes,
+// which swscanf ignores, so they should also be limited by the
+// width in the format.
+#define swscanf_s swscanf
+
+#ifndef _countof
+#define _countof(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+#endif
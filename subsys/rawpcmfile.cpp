@@ -41,9 +41,14 @@
 //--------------------------------------------------------------------
 
 #include "rawpcmfile.h"
+#include "platform.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <stdint.h>
+#include <string>
+#include <vector>
 
 #define TRACE
 
@@ -81,7 +86,7 @@ uint64_t RawPCMFileGetSizeInBytes(const wchar_t *filename)
         return 0; // Error or empty file.
 
 #ifdef TRACE
-    printf("  bytes = %I64d\n", bytes);
+    printf("  bytes = %lld\n", static_cast<long long>(bytes));
 #endif
     return static_cast<uint64_t>(bytes);
 }
@@ -119,6 +124,95 @@ bool RawPCMFileRead(
     return true;
 }
 
+// Reads audio samples from a raw PCM file into a caller provided
+// buffer in memory, starting at sample 'firstSample' (per channel)
+// rather than at the beginning of the file.  Returns true if
+// successful.
+bool RawPCMFileReadRange(
+    const wchar_t * filename,
+    size_t          firstSample,
+    size_t          numSamples,
+    unsigned        numChannels,
+    unsigned        bytesPerSample,
+    void *          buffer,
+    size_t          bufferSize
+    )
+{
+#ifdef TRACE
+    printf("RawPCMFileReadRange '%S', bufferSize=%zu\n", filename, bufferSize);
+    printf("  firstSample=%zu  numSamples=%zu  numChannels=%u  bytesPerSample=%u\n",
+        firstSample, numSamples, numChannels, bytesPerSample);
+#endif
+
+    // Open the file for reading.
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"rb") || !fp)
+        return false; // Can't open the file.
+    ScopedFile sfp(fp);
+
+    size_t bytesToRead = numSamples * numChannels * bytesPerSample;
+    if (bytesToRead > bufferSize)
+        return false;
+
+    int64_t offset = static_cast<int64_t>(firstSample) * numChannels * bytesPerSample;
+    if (_fseeki64(fp, offset, SEEK_SET))
+        return false; // Seek failed.
+
+    if (fread(buffer, 1, bytesToRead, fp) != bytesToRead)
+        return false;
+
+    return true;
+}
+
+// Reads a range of audio samples from a raw PCM file a block at a
+// time, passing each block to the callback.  Returns true if
+// successful.
+bool RawPCMFileReadInBlocks(
+    const wchar_t * filename,
+    size_t          firstSample,
+    size_t          numSamples,
+    unsigned        numChannels,
+    unsigned        bytesPerSample,
+    size_t          blockSize,
+    bool         (* blockFunc)(void *context, const void *samples, size_t bytes),
+    void *          context
+    )
+{
+#ifdef TRACE
+    printf("RawPCMFileReadInBlocks '%S', blockSize=%zu\n", filename, blockSize);
+    printf("  firstSample=%zu  numSamples=%zu  numChannels=%u  bytesPerSample=%u\n",
+        firstSample, numSamples, numChannels, bytesPerSample);
+#endif
+
+    if (!blockSize || !blockFunc)
+        return false; // Bad parameter.
+
+    // Open the file for reading.
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"rb") || !fp)
+        return false; // Can't open the file.
+    ScopedFile sfp(fp);
+
+    int64_t offset = static_cast<int64_t>(firstSample) * numChannels * bytesPerSample;
+    if (_fseeki64(fp, offset, SEEK_SET))
+        return false; // Seek failed.
+
+    // Pass the sample data to the callback one block at a time.
+    std::vector<uint8_t> block(blockSize);
+    uint64_t remaining = static_cast<uint64_t>(numSamples) * numChannels * bytesPerSample;
+    while (remaining > 0)
+    {
+        size_t bytes = (remaining < blockSize) ? static_cast<size_t>(remaining) : blockSize;
+        if (fread(block.data(), 1, bytes, fp) != bytes)
+            return false;
+        if (!blockFunc(context, block.data(), bytes))
+            return false;
+        remaining -= bytes;
+    }
+
+    return true;
+}
+
 // Writes the audio samples from a memory buffer to a raw PCM
 // file.  Returns true if successful.
 bool RawPCMFileWrite(
@@ -161,3 +255,170 @@ bool RawPCMFileWrite(
     return true;
 }
 
+// Writes a raw PCM file whose audio samples are filled in by the
+// callback a block at a time.  Returns true if successful.
+bool RawPCMFileWriteInBlocks(
+    const wchar_t * filename,
+    size_t          numSamples,
+    unsigned        numChannels,
+    unsigned        bytesPerSample,
+    size_t          blockSize,
+    bool         (* blockFunc)(void *context, void *samples, size_t bytes),
+    void *          context
+    )
+{
+#ifdef TRACE
+    printf("RawPCMFileWriteInBlocks '%S', blockSize=%zu\n", filename, blockSize);
+    printf("  numSamples=%zu  numChannels=%u  bytesPerSample=%u\n",
+        numSamples, numChannels, bytesPerSample);
+#endif
+
+    if (!blockSize || !blockFunc)
+        return false; // Bad parameter.
+
+    // Open the file for writing.
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"w+b") || !fp)
+    {
+#ifdef TRACE
+        printf("Failed opening '%S'\n", filename);
+#endif
+
+        return false; // Can't open the file.
+    }
+    ScopedFile sfp(fp);
+
+    // Have the callback fill each block, then write it.
+    std::vector<uint8_t> block(blockSize);
+    uint64_t remaining = static_cast<uint64_t>(numSamples) * numChannels * bytesPerSample;
+    while (remaining > 0)
+    {
+        size_t bytes = (remaining < blockSize) ? static_cast<size_t>(remaining) : blockSize;
+        if (!blockFunc(context, block.data(), bytes))
+            return false;
+        if (fwrite(block.data(), 1, bytes, fp) != bytes)
+        {
+#ifdef TRACE
+            printf("Failed writing %zu bytes.\n", bytes);
+#endif
+            return false;
+        }
+        remaining -= bytes;
+    }
+
+    return true;
+}
+
+// Removes leading and trailing white space from a string in place,
+// returning a pointer to the first character that's kept.
+static char *TrimSpace(char *text)
+{
+    while (isspace(static_cast<unsigned char>(*text)))
+        text++;
+    size_t length = strlen(text);
+    while (length > 0 && isspace(static_cast<unsigned char>(text[length - 1])))
+        text[--length] = '\0';
+    return text;
+}
+
+// Parses one "name=value" line of a .hdr file into 'format'.
+// Returns false if the line isn't a setting we understand.
+static bool ParseHeaderSetting(char *line, RawPCMFormat &format)
+{
+    char *equals = strchr(line, '=');
+    if (!equals)
+        return false;
+    *equals = '\0';
+    const char *name = TrimSpace(line);
+    const char *value = TrimSpace(equals + 1);
+    if (!*value)
+        return false;
+
+    if (_stricmp(name, "Rate") == 0)
+        format.m_rate = static_cast<unsigned>(atoi(value));
+    else if (_stricmp(name, "Channels") == 0)
+        format.m_numChannels = static_cast<unsigned>(atoi(value));
+    else if (_stricmp(name, "BytesPerSample") == 0)
+        format.m_bytesPerSample = static_cast<unsigned>(atoi(value));
+    else if (_stricmp(name, "Bits") == 0)
+        format.m_bytesPerSample = static_cast<unsigned>(atoi(value)) / 8;
+    else if (_stricmp(name, "Float") == 0)
+    {
+        char first = static_cast<char>(tolower(static_cast<unsigned char>(value[0])));
+        format.m_isFloat = (first == 'y' || first == 't' || first == '1');
+    }
+    else
+        return false;
+
+    return true;
+}
+
+// Reads the .hdr file that describes the sample format of the given
+// raw PCM file, if there is one.  See the header for details.
+bool RawPCMFileReadHeader(const wchar_t *filename, RawPCMFormat &format, bool &found)
+{
+    found = false;
+    if (!filename || !*filename)
+        return false;
+
+    // Look for "name.raw.hdr" first, then "name.hdr".
+    std::wstring hdrname = std::wstring(filename) + L".hdr";
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, hdrname.c_str(), L"rt") || !fp)
+    {
+        const wchar_t *extension = wcsrchr(filename, '.');
+        if (!extension || wcschr(extension, '/') || wcschr(extension, '\\'))
+            return true;
+        hdrname = std::wstring(filename, extension) + L".hdr";
+        if (_wfopen_s(&fp, hdrname.c_str(), L"rt") || !fp)
+            return true;
+    }
+    ScopedFile sfp(fp);
+    found = true;
+
+#ifdef TRACE
+    printf("RawPCMFileReadHeader '%S'\n", hdrname.c_str());
+#endif
+
+    RawPCMFormat newFormat = format;
+    char line[256];
+    while (fgets(line, sizeof(line), fp))
+    {
+        char *text = TrimSpace(line);
+        if (!*text || *text == '#')
+            continue;
+        if (!ParseHeaderSetting(text, newFormat))
+        {
+#ifdef TRACE
+            printf("  Bad setting '%s'\n", text);
+#endif
+            return false;
+        }
+    }
+    if (ferror(fp) || !newFormat.IsValid())
+        return false;
+
+    format = newFormat;
+    return true;
+}
+
+// Writes a .hdr file describing the sample format of the given raw
+// PCM file.  Returns true if successful.
+bool RawPCMFileWriteHeader(const wchar_t *filename, const RawPCMFormat &format)
+{
+    if (!filename || !*filename || !format.IsValid())
+        return false;
+
+    std::wstring hdrname = std::wstring(filename) + L".hdr";
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, hdrname.c_str(), L"wt") || !fp)
+        return false; // Can't open the file.
+    ScopedFile sfp(fp);
+
+    fprintf(fp, "# Sample format of a raw PCM audio file.\n");
+    fprintf(fp, "Rate=%u\n", format.m_rate);
+    fprintf(fp, "Channels=%u\n", format.m_numChannels);
+    fprintf(fp, "BytesPerSample=%u\n", format.m_bytesPerSample);
+    fprintf(fp, "Float=%s\n", format.m_isFloat ? "yes" : "no");
+    return fflush(fp) == 0 && !ferror(fp);
+}
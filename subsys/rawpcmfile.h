@@ -4,6 +4,21 @@
 //
 // C++ module to read and write raw PCM audio files.
 //
+// Raw PCM files have no header of their own, so their sample format
+// may be described by a small text file next to them, named after
+// the audio file with ".hdr" appended (e.g. "capture.raw.hdr") or
+// in place of its extension (e.g. "capture.hdr").  Each line holds
+// one "name=value" setting; blank lines and lines starting with '#'
+// are ignored.  The settings are:
+//
+//   Rate=44100           Sample rate in Hertz.
+//   Channels=2           Number of interleaved channels.
+//   BytesPerSample=2     Size of each sample (or Bits=16).
+//   Float=no             Whether the samples are floating-point.
+//
+// Samples are little-endian.  Settings a .hdr file doesn't give
+// keep their previous values.
+//
 //-------------------------------------------------------------------
 //
 // (C) Copyright 1994-2025 Ammon R. Campbell.
@@ -44,6 +59,25 @@
 #include <stddef.h>
 #include <stdint.h>
 
+// Describes the sample format of a raw PCM audio file.
+struct RawPCMFormat
+{
+    unsigned m_rate = 22500;        // Sample rate in Hertz.
+    unsigned m_numChannels = 2;     // Number of interleaved channels.
+    unsigned m_bytesPerSample = 2;  // Bytes per sample: 1 to 4, or 8.
+    bool m_isFloat = false;         // True if samples are floating-point.
+
+    // Returns true if the format is one we can read and write.
+    bool IsValid() const
+    {
+        if (m_rate < 1 || m_numChannels < 1 || m_numChannels > 0xFFFF)
+            return false;
+        if (m_isFloat)
+            return m_bytesPerSample == 4 || m_bytesPerSample == 8;
+        return m_bytesPerSample >= 1 && m_bytesPerSample <= 4;
+    }
+};
+
 // Retrieves the size of the given file in bytes.
 // Returns zero if file couldn't be accessed.
 uint64_t RawPCMFileGetSizeInBytes(const wchar_t *filename);
@@ -52,7 +86,42 @@ uint64_t RawPCMFileGetSizeInBytes(const wchar_t *filename);
 // provided buffer in memory.  Returns true if successful.
 bool RawPCMFileRead(const wchar_t *filename, size_t numSamples, unsigned numChannels, unsigned bytesPerSample, void *buffer, size_t bufferSize);
 
+// Reads audio samples from a raw PCM file into a caller provided
+// buffer in memory, starting at sample 'firstSample' (per channel)
+// rather than at the beginning of the file.  Returns true if
+// successful.
+bool RawPCMFileReadRange(const wchar_t *filename, size_t firstSample, size_t numSamples, unsigned numChannels, unsigned bytesPerSample, void *buffer, size_t bufferSize);
+
+// Reads 'numSamples' samples (per channel) from a raw PCM file,
+// starting at sample 'firstSample', a block at a time, so the whole
+// range never has to be held in memory.  Each block holds at most
+// 'blockSize' bytes, which should be a multiple of the size of one
+// sample times the channel count.  The callback is called once per
+// block; if it returns false, reading stops and this function
+// fails.  Returns true if successful.
+bool RawPCMFileReadInBlocks(const wchar_t *filename, size_t firstSample, size_t numSamples, unsigned numChannels, unsigned bytesPerSample, size_t blockSize, bool (*blockFunc)(void *context, const void *samples, size_t bytes), void *context);
+
 // Writes the audio samples from a memory buffer to a raw PCM
 // file.  Returns true if successful.
 bool RawPCMFileWrite(const wchar_t *filename, size_t numSamples, unsigned numChannels, unsigned bytesPerSample, void *buffer);
 
+// Writes a raw PCM file whose audio samples are supplied a block at
+// a time, so the whole file never has to be held in memory.  The
+// callback is called once per block to fill 'bytes' bytes of
+// samples (at most 'blockSize', which should be a multiple of the
+// size of one sample times the channel count); if it returns false,
+// writing stops and this function fails.  Returns true if
+// successful.
+bool RawPCMFileWriteInBlocks(const wchar_t *filename, size_t numSamples, unsigned numChannels, unsigned bytesPerSample, size_t blockSize, bool (*blockFunc)(void *context, void *samples, size_t bytes), void *context);
+
+// Reads the .hdr file that describes the sample format of the given
+// raw PCM file, if there is one, updating 'format' with the settings
+// it gives and setting 'found' to true.  If there's no .hdr file,
+// leaves 'format' alone, sets 'found' to false, and returns true.
+// Returns false if the .hdr file can't be read or is invalid.
+bool RawPCMFileReadHeader(const wchar_t *filename, RawPCMFormat &format, bool &found);
+
+// Writes a .hdr file describing the sample format of the given raw
+// PCM file, named after it with ".hdr" appended.  Returns true if
+// successful.
+bool RawPCMFileWriteHeader(const wchar_t *filename, const RawPCMFormat &format);
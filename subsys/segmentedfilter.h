@@ -0,0 +1,174 @@
+//-------------------------------------------------------------------
+//
+// segmentedfilter.h
+//
+// C++ helpers for running an IIR audio filter over a long series of
+// samples in segments, on all of the processor's cores.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include "threadpool.h"
+
+//
+// An IIR filter's output depends on every sample before it, but the
+// effect of the samples long before dies away:  once the filter has
+// run for a while, its state is the same whatever state it started
+// in.  So a long series of samples can be split into segments, each
+// filtered on its own thread by a copy of the filter that starts out
+// cleared and first runs over the samples just before its segment
+// (the warm-up) to settle into the state the serial filter would
+// have had there.
+//
+// Error bound:  the warm-up is made long enough that whatever was
+// left of the difference in starting state has decayed to no more
+// than kSegmentTolerance (about -130 dB) of its size, which for
+// audio in the range -1 to 1 is about the peak level of the
+// filter's output.  On top of that, a segment's samples are rounded
+// differently than the serial filter's were, and a filter amplifies
+// its own rounding noise just as it amplifies its input; so the
+// result differs from the serial one by about as much as the serial
+// result already differs from exact arithmetic.  For the one-pole
+// filters and wide biquads that's around 1e-7, well under one step
+// of a 16-bit sample.  A narrow (high Q) bandpass or notch filter,
+// or one tuned below a few hundred Hz, has its poles so close to the
+// unit circle that it can reach 5e-4 (-66 dB), for serial filtering
+// as much as segmented.
+//
+
+// How far a segment's starting state error is allowed to remain.
+static const float kSegmentTolerance = 3e-7f;
+
+// Each segment is at least this many times as long as its warm-up,
+// so the warm-ups add no more than an eighth to the work.
+static const size_t kSegmentsPerWarmUp = 8;
+
+// Segments shorter than this aren't worth handing to another thread.
+static const size_t kMinSegmentSamples = 16384;
+
+// Returns the number of samples it takes a filter whose response
+// decays as 'pole' to the power of the sample count (times 'scale')
+// to settle to within 'tolerance', or SIZE_MAX if it never does.
+inline size_t FilterSettlingSamples(double pole, double scale, double tolerance)
+{
+    pole = std::fabs(pole);
+    if (pole >= 1.0)
+        return SIZE_MAX;
+    if (pole <= 0.0 || scale <= tolerance)
+        return 1;
+    return static_cast<size_t>(std::ceil(std::log(tolerance / scale) / std::log(pole)));
+}
+
+// Returns FilterSettlingSamples for a second order filter whose
+// output history follows y[n] = -p1 * y[n-1] - p2 * y[n-2] when
+// there's no input.  Poles that are close together (or, for a
+// resonant filter, close to the real axis) ring longer than their
+// radius alone would suggest, so the distance between them scales
+// the response.
+inline size_t BiquadSettlingSamples(double p1, double p2, double tolerance)
+{
+    double d = p1 * p1 - 4.0 * p2;
+    double pole = (d < 0.0) ? std::sqrt(p2) :
+        std::max(std::fabs(-p1 + std::sqrt(d)), std::fabs(-p1 - std::sqrt(d))) / 2.0;
+    double spread = std::max(std::sqrt(std::fabs(d)), 1.0 - pole);
+    return FilterSettlingSamples(pole, 2.0 / spread, tolerance);
+}
+
+//
+// Runs 'count' samples from 'in' through the filter into 'out',
+// which may be the same as 'in', giving nearly the same result as
+// calling filter.FilterSamples on all of them at once (see the error
+// bound above).  The samples are split into as many as 'numSegments'
+// segments (or, if zero, one per thread of the shared pool), as long
+// as each is long enough to make its warm-up worthwhile; if there
+// would only be one segment, the samples are just filtered serially.
+// Afterwards the filter is left in the state it had after the last
+// sample, so it can carry on with the samples that follow.
+//
+// The filter class needs FilterSamples(in, out, count) to filter a
+// series of samples (as FilterSample would each in turn), Reset to
+// clear its state, GetSettlingSamples(tolerance) to give the warm-up
+// length, and has to be copyable.
+//
+template <class Filter>
+void FilterSamplesInSegments(Filter &filter, const float *in, float *out, size_t count, size_t numSegments = 0)
+{
+    size_t warmUp = filter.GetSettlingSamples(kSegmentTolerance);
+    if (numSegments == 0)
+        numSegments = ThreadPool::GetShared().GetConcurrency();
+    if (warmUp != SIZE_MAX)
+    {
+        size_t minLength = std::max(warmUp * kSegmentsPerWarmUp, kMinSegmentSamples);
+        numSegments = std::min(numSegments, count / minLength);
+    }
+
+    if (warmUp == SIZE_MAX || numSegments < 2)
+    {
+        filter.FilterSamples(in, out, count);
+        return;
+    }
+
+    // Take copies of the samples each segment warms up on before any
+    // of them are overwritten, in case the filtering is in place.
+    std::vector<size_t> starts(numSegments + 1);
+    std::vector<std::vector<float>> warmUps(numSegments);
+    for (size_t segment = 0; segment <= numSegments; segment++)
+    {
+        starts[segment] = count / numSegments * segment;
+        if (segment > 0 && segment < numSegments)
+            warmUps[segment].assign(in + starts[segment] - warmUp, in + starts[segment]);
+    }
+    starts[numSegments] = count;
+
+    // The first segment carries on from the filter's own state.
+    std::vector<Filter> filters(numSegments - 1, filter);
+    ThreadPool::GetShared().RunTasks(numSegments, [&](size_t segment) {
+        Filter &segmentFilter = (segment == 0) ? filter : filters[segment - 1];
+        if (segment > 0)
+        {
+            segmentFilter.Reset();
+            segmentFilter.FilterSamples(warmUps[segment].data(), warmUps[segment].data(), warmUp);
+        }
+        segmentFilter.FilterSamples(in + starts[segment], out + starts[segment], starts[segment + 1] - starts[segment]);
+    });
+    filter = filters.back();
+}
@@ -0,0 +1,112 @@
+//-------------------------------------------------------------------
+//
+// spscqueue.h
+//
+// C++ template for a lock-free queue that passes items from one
+// producer thread to one consumer thread.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#pragma once
+#include <stddef.h>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+// A fixed-size ring of items, passed from one thread that pushes
+// them to one other thread that pops them.  Neither side ever
+// blocks or takes a lock:  a push into a full queue, or a pop from
+// an empty one, just fails, and the caller decides how to wait.
+// Items are moved in and out, so they can own buffers that are
+// handed back and forth without being copied.
+template <typename T>
+class SpscQueue
+{
+public:
+    // Creates a queue with room for at least 'capacity' items.
+    explicit SpscQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        m_slots.resize(size);
+        m_mask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // Moves the item onto the back of the queue.  Only the producer
+    // thread may call this.  Returns false if the queue is full.
+    bool TryPush(T &item)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) > m_mask)
+            return false;
+
+        m_slots[tail & m_mask] = std::move(item);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Moves the item at the front of the queue into 'item'.  Only
+    // the consumer thread may call this.  Returns false if the
+    // queue is empty.
+    bool TryPop(T &item)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+
+        item = std::move(m_slots[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // The producer and consumer each write one of the counters, so
+    // they're kept on separate cache lines.
+    static const size_t kCacheLine = 64;
+
+    std::vector<T> m_slots;
+    size_t m_mask = 0;
+    char m_pad1[kCacheLine];
+    std::atomic<size_t> m_head{0};  // Count of items popped so far.
+    char m_pad2[kCacheLine - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> m_tail{0};  // Count of items pushed so far.
+    char m_pad3[kCacheLine - sizeof(std::atomic<size_t>)];
+};
@@ -0,0 +1,265 @@
+//-------------------------------------------------------------------
+//
+// threadpool.cpp
+//
+// C++ module providing a simple pool of worker threads, used to
+// spread CPU-heavy work such as decoding across the processor's
+// cores.
+//
+// See threadpool.h for additional comments.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#include "threadpool.h"
+#include "denormals.h"
+#include <atomic>
+#include <exception>
+#include <memory>
+
+// The profiler's hooks, if any.
+static std::atomic<ThreadPool::BeginHook> g_beginHook(nullptr);
+static std::atomic<ThreadPool::EndHook> g_endHook(nullptr);
+
+// Tells the profiler (if any) about the span of code it's declared
+// in.
+class HookedSpan
+{
+public:
+    explicit HookedSpan(const char *name)
+    {
+        ThreadPool::BeginHook begin = g_beginHook.load(std::memory_order_relaxed);
+        m_end = g_endHook.load(std::memory_order_relaxed);
+        if (begin && m_end)
+            m_token = begin(name);
+    }
+
+    ~HookedSpan()
+    {
+        if (m_token)
+            m_end(m_token);
+    }
+
+    HookedSpan(const HookedSpan &) = delete;
+    HookedSpan &operator=(const HookedSpan &) = delete;
+
+private:
+    ThreadPool::EndHook m_end = nullptr;
+    void *m_token = nullptr;
+};
+
+// Shared state for one call to ThreadPool::RunTasks.  It's held by
+// shared_ptr since helper tasks may still be queued after the last
+// index has been handed out.
+struct TaskBatch
+{
+    TaskBatch(size_t count, const std::function<void(size_t)> &task)
+        : m_count(count), m_task(task) { }
+
+    const size_t m_count;
+    const std::function<void(size_t)> m_task;
+    std::atomic<size_t> m_next{0};
+
+    std::mutex m_mutex;
+    std::condition_variable m_done;
+    size_t m_completed = 0;
+    std::exception_ptr m_error;
+};
+
+// Claims and runs indexes from the batch until there are none left.
+// The tasks are mostly loops over samples, so denormals are off
+// while they run.
+static void RunBatchTasks(TaskBatch &batch)
+{
+    ScopedDenormalsOff denormals;
+    for (;;)
+    {
+        size_t index = batch.m_next++;
+        if (index >= batch.m_count)
+            return;
+
+        std::exception_ptr error;
+        try
+        {
+            HookedSpan span("pool task");
+            batch.m_task(index);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(batch.m_mutex);
+        if (error && !batch.m_error)
+            batch.m_error = error;
+        if (++batch.m_completed == batch.m_count)
+            batch.m_done.notify_all();
+    }
+}
+
+// Creates a pool with the given number of worker threads.  If
+// 'numThreads' is zero, enough workers are created that, along
+// with the calling thread, there's one thread per logical CPU.
+ThreadPool::ThreadPool(unsigned numThreads)
+{
+    if (numThreads == 0)
+    {
+        unsigned cores = std::thread::hardware_concurrency();
+        numThreads = (cores > 1) ? cores - 1 : 0;
+    }
+
+    for (unsigned i = 0; i < numThreads; i++)
+        m_threads.emplace_back(&ThreadPool::WorkerMain, this);
+}
+
+// Waits for the queued tasks to finish, then stops the threads.
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for (auto &thread : m_threads)
+        thread.join();
+}
+
+// Queues a task to be run on one of the worker threads.
+void ThreadPool::Submit(std::function<void()> task)
+{
+    if (m_threads.empty())
+    {
+        // No workers, so just run it now.
+        task();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(task));
+    }
+    m_wake.notify_one();
+}
+
+// Calls task(index) once for every index from 0 to count - 1,
+// spreading the calls across the worker threads and the calling
+// thread, and returns when all of the calls have completed.
+void ThreadPool::RunTasks(size_t count, const std::function<void(size_t index)> &task)
+{
+    if (count == 0)
+        return;
+
+    auto batch = std::make_shared<TaskBatch>(count, task);
+
+    // Each helper claims indexes until they run out, so there's no
+    // point in queueing more helpers than there are indexes.
+    size_t helpers = count - 1;
+    if (helpers > m_threads.size())
+        helpers = m_threads.size();
+    for (size_t i = 0; i < helpers; i++)
+        Submit([batch]() { RunBatchTasks(*batch); });
+
+    // Help out, then wait for any calls still running elsewhere.
+    RunBatchTasks(*batch);
+
+    HookedSpan span("pool wait");
+    std::unique_lock<std::mutex> lock(batch->m_mutex);
+    batch->m_done.wait(lock, [&batch]() { return batch->m_completed == batch->m_count; });
+    if (batch->m_error)
+        std::rethrow_exception(batch->m_error);
+}
+
+// Calls body(first, end) for consecutive ranges of the indexes from
+// 0 to count - 1, each covering about kGrainBytes of data.
+void ThreadPool::ParallelFor(size_t count, size_t bytesPerIndex,
+                             const std::function<void(size_t first, size_t end)> &body)
+{
+    if (count == 0)
+        return;
+
+    size_t grain = kGrainBytes / (bytesPerIndex ? bytesPerIndex : 1);
+    if (grain < 1)
+        grain = 1;
+    size_t numRanges = (count + grain - 1) / grain;
+    if (numRanges == 1 || m_threads.empty())
+    {
+        ScopedDenormalsOff denormals;
+        body(0, count);
+        return;
+    }
+
+    RunTasks(numRanges, [&](size_t range) {
+        size_t first = range * grain;
+        size_t end = (count - first < grain) ? count : first + grain;
+        body(first, end);
+    });
+}
+
+// Returns the pool that's shared by the library functions.  It's
+// created the first time it's needed.
+ThreadPool &ThreadPool::GetShared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+// Sets the functions that are told when tasks run and when RunTasks
+// waits for them.
+void ThreadPool::SetHooks(BeginHook begin, EndHook end)
+{
+    g_beginHook = begin;
+    g_endHook = end;
+}
+
+// Main loop of each worker thread.
+void ThreadPool::WorkerMain()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+            if (m_queue.empty())
+                return; // Stopping and nothing left to do.
+            task = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        task();
+    }
+}
@@ -0,0 +1,121 @@
+//-------------------------------------------------------------------
+//
+// threadpool.h
+//
+// C++ module providing a simple pool of worker threads, used to
+// spread CPU-heavy work such as decoding across the processor's
+// cores.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#pragma once
+#include <stddef.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that run queued tasks.
+class ThreadPool
+{
+public:
+    // Creates a pool with the given number of worker threads.  If
+    // 'numThreads' is zero, enough workers are created that, along
+    // with the calling thread, there's one thread per logical CPU.
+    explicit ThreadPool(unsigned numThreads = 0);
+
+    // Waits for the queued tasks to finish, then stops the threads.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Returns the number of threads that RunTasks can use at once,
+    // which is the number of workers plus the calling thread.
+    unsigned GetConcurrency() const { return static_cast<unsigned>(m_threads.size()) + 1; }
+
+    // Queues a task to be run on one of the worker threads.  The
+    // task must not throw exceptions.
+    void Submit(std::function<void()> task);
+
+    // Calls task(index) once for every index from 0 to count - 1,
+    // spreading the calls across the worker threads and the calling
+    // thread, and returns when all of the calls have completed.
+    // Since the calling thread helps out, this may safely be called
+    // from inside another task.  If any call throws an exception,
+    // the first one is rethrown here after the others complete.
+    void RunTasks(size_t count, const std::function<void(size_t index)> &task);
+
+    // The amount of data each call from ParallelFor should cover:
+    // small enough that a call's data stays in a core's L2 cache,
+    // and large enough that handing out the calls costs little next
+    // to the work.
+    static const size_t kGrainBytes = 128 * 1024;
+
+    // Calls body(first, end) for consecutive ranges of the indexes
+    // from 0 to count - 1, spreading the calls out like RunTasks.
+    // Each range covers about kGrainBytes, given that each index
+    // covers 'bytesPerIndex' bytes of input and output.  If there's
+    // only one range, the body is just called on the calling thread.
+    void ParallelFor(size_t count, size_t bytesPerIndex,
+                     const std::function<void(size_t first, size_t end)> &body);
+
+    // Returns the pool that's shared by the library functions.  It's
+    // created the first time it's needed.
+    static ThreadPool &GetShared();
+
+    // Functions a profiler may set to be told when each task run by
+    // RunTasks starts and ends ("pool task"), and when RunTasks
+    // starts and stops waiting for tasks on other threads ("pool
+    // wait").  The value 'begin' returns is passed to 'end'.  Either
+    // may be null to remove the hooks.
+    typedef void *(*BeginHook)(const char *name);
+    typedef void (*EndHook)(void *token);
+    static void SetHooks(BeginHook begin, EndHook end);
+
+private:
+    void WorkerMain();
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping = false;
+};
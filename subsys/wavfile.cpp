@@ -46,9 +46,11 @@
 
 //#define TRACE // Define TRACE to enable debug printfs in this module.
 #include "wavfile.h"
+#include "platform.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
+#include <vector>
 
 // Handy class to auto-close a stdio FILE when it goes out of scope.
 class ScopedFile
@@ -67,17 +69,18 @@ private:
 // The file format header found within a WAV file.
 typedef struct
 {
-    // Encoding: 1 = integer PCM data; 3 = floating-point PCM data.
+    // Encoding: 1 = integer PCM data; 3 = floating-point PCM data;
+    // 0xFFFE = extensible, where the encoding is in the SubFormat.
     unsigned short int    wFmtTag;
 
     // Number of channels: 1 = mono; 2 = stereo.
     unsigned short int    nChannels;
 
     // Audio sampling rate in Hertz.
-    unsigned long int    Rate;
+    uint32_t             Rate;
 
     // Average bytes per second needed to output to play this sample.
-    unsigned long int    BPS;
+    uint32_t             BPS;
 
     // Number of bytes to output per sample.
     // For an 8-bit mono sample, this will be 1.
@@ -86,91 +89,91 @@ typedef struct
     // For a 16-bit stereo sample, this will be 4.
     unsigned short int    nAlign;
 
-    // Bits per sample (8 or 16 for integer PCM, 32 for floating-point).
+    // Bits per sample (8 to 32 for integer PCM, 32 or 64 for
+    // floating-point).
     unsigned short int    nBits;
 } WAVFHDR;
 
+// The extension that follows the format header when its wFmtTag
+// is WAVE_FORMAT_EXTENSIBLE.
+typedef struct
+{
+    // Size of the rest of this extension, in bytes (22).
+    uint16_t    cbSize;
+
+    // Number of significant bits in each sample, which are
+    // left-justified in a container of nBits bits.
+    uint16_t    wValidBits;
+
+    // Bit mask of the speaker positions the channels map to, in
+    // order (1 = front left, 2 = front right, 4 = front center,
+    // etc.), or zero if unspecified.
+    uint32_t    dwChannelMask;
+
+    // GUID of the encoding.  The first two bytes hold the wFmtTag
+    // value the encoding would have in a plain format header.
+    uint8_t     SubFormat[16];
+} WAVFEXT;
+
 #pragma pack()
 
-// Reads and verifies the signature at the beginning of a WAV file.
-// Returns false if can't read from file or if file isn't a WAV file.
-// Note that this function leaves the file pointer at the end of the
-// 16-byte signature data in the open file.
-static bool read_and_confirm_wav_signature(FILE *fp)
+// Size of the 'ds64' chunk the writer produces: the 64-bit RIFF
+// size, data size, and sample count, plus an empty table length.
+static const uint32_t kDS64Size = 28;
+
+// A 32-bit chunk size of all ones means the real size is in the
+// 'ds64' chunk of an RF64/BW64 file.
+static const uint32_t kRF64SizeMarker = 0xFFFFFFFF;
+
+// Data size that readers take to mean "until the end of the file",
+// for the streams written by WAVFileWriteStream.
+static const uint64_t kStreamingSize = UINT64_MAX;
+
+// Format tags.
+static const unsigned short kFormatPCM = 1;
+static const unsigned short kFormatFloat = 3;
+static const unsigned short kFormatExtensible = 0xFFFE;
+
+// The SubFormat GUIDs of WAVE_FORMAT_EXTENSIBLE headers are all the
+// same apart from their first two bytes, which hold the format tag.
+static const uint8_t kSubFormatGUID[16] =
 {
-    // Read the 16-byte signature from the beginning of the file.
-    char signature[16] = {0};
-    if (fread(signature, 1, sizeof(signature), fp) != sizeof(signature))
-    {
-#ifdef TRACE
-        printf("read_and_confirm_wav_signature: Can't read signature bytes!\n");
-#endif
-        return false; // Can't read signature bytes.
-    }
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+    0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+};
 
-    // Check that the signature is good.
-    if (strncmp(signature, "RIFF", 4) != 0)
-    {
-#ifdef TRACE
-        printf("read_and_confirm_wav_signature: Expected 'RIFF', got '%c%c%c%c'\n",
-            signature[0], signature[1], signature[2], signature[3]);
-#endif
-        return false; // Doesn't appear to be a valid WAV file.
-    }
-    if (strncmp(&signature[8], "WAVE", 4) != 0)
-    {
-#ifdef TRACE
-        printf("read_and_confirm_wav_signature: Expected 'WAVE', got '%c%c%c%c'\n",
-            signature[8], signature[9], signature[10], signature[11]);
-#endif
-        return false; // Doesn't appear to be a valid WAV file.
-    }
-    if (strncmp(&signature[12], "JUNK", 4) == 0)
-    {
-        // There's a 'JUNK' block before the 'fmt ' block.  Skip it.
-#ifdef TRACE
-        printf("read_and_confirm_wav_signature: Skipping 'JUNK' block.\n");
-#endif
-        uint32_t offset = 0;
-        fread(&offset, 1, 4, fp);
-#ifdef TRACE
-        printf("read_and_confirm_wav_signature: offset=%u\n", offset);
-#endif
-        fseek(fp, offset, SEEK_CUR);
-#ifdef TRACE
-        printf("read_and_confirm_wav_signature: ftell=%u\n", ftell(fp));
-#endif
-        fread(&signature[12], 1, 4, fp);
-#ifdef TRACE
-        printf("read_and_confirm_wav_signature: Next block '%c%c%c%c'.\n",
-            signature[12], signature[13], signature[14], signature[15]);
-#endif
-    }
-    if (strncmp(&signature[12], "fmt ", 4) != 0)
+// Skips 'count' bytes of an open file.  A stream that can't seek,
+// such as a pipe, is read through instead.
+static bool skip_bytes(FILE *fp, uint64_t count, bool seekable)
+{
+    if (seekable)
+        return _fseeki64(fp, static_cast<int64_t>(count), SEEK_CUR) == 0;
+
+    char buffer[4096];
+    while (count > 0)
     {
-#ifdef TRACE
-        printf("read_and_confirm_wav_signature: Expected 'fmt ', got '%c%c%c%c'\n",
-            signature[12], signature[13], signature[14], signature[15]);
-#endif
-        return false; // Doesn't appear to be a valid WAV file.
+        size_t bytes = (count < sizeof(buffer)) ? static_cast<size_t>(count) : sizeof(buffer);
+        if (fread(buffer, 1, bytes, fp) != bytes)
+            return false;
+        count -= bytes;
     }
-
-#ifdef TRACE
-    printf("read_and_confirm_wav_signature: Header appears OK.  ftell=%u\n", ftell(fp));
-#endif
     return true;
 }
 
 // Reads and verifies the format header from a WAV file.  Assumes
-// the file pointer is at the start of the header.  Returns true
-// if successful.  Note this function leaves the file pointer at
-// beginning of the next section of the open file if successful.
-static bool read_and_confirm_format_header(FILE *fp, WAVFHDR &hdr)
+// the file pointer is just past the chunk's 'fmt ' name and size.
+// Returns true if successful.  Note this function leaves the file
+// pointer at beginning of the next chunk of the open file if
+// successful.
+//
+// An extensible header is read into 'ext', and its encoding is
+// copied into hdr.wFmtTag, so the caller only ever sees a tag of 1
+// or 3.  If the samples have fewer significant bits than their
+// containers (as with 20-bit samples stored in three bytes),
+// hdr.nBits is set to the container size and ext.wValidBits to the
+// number of significant bits.
+static bool read_and_confirm_format_header(FILE *fp, uint32_t hdr_size, WAVFHDR &hdr, WAVFEXT &ext, bool seekable)
 {
-    // Read the size of the format header.
-    uint32_t hdr_size = 0;
-    if (fread(&hdr_size, 1, sizeof(hdr_size), fp) != sizeof(hdr_size))
-        return false; // Read error.
     if (hdr_size < sizeof(WAVFHDR))
         return false; // Invalid header size.
 #ifdef TRACE
@@ -179,95 +182,196 @@ static bool read_and_confirm_format_header(FILE *fp, WAVFHDR &hdr)
 
     // Read the format header.
     hdr = {0};
+    ext = {0};
     if (fread(&hdr, 1, sizeof(hdr), fp) != sizeof(hdr))
         return false; // Read error.
+    uint32_t bytes_read = sizeof(hdr);
+
+    // Read the extension, if there is one, and take the encoding
+    // from its SubFormat.
+    if (hdr.wFmtTag == kFormatExtensible)
+    {
+        if (hdr_size < sizeof(hdr) + sizeof(ext))
+            return false; // Invalid header size.
+        if (fread(&ext, 1, sizeof(ext), fp) != sizeof(ext))
+            return false; // Read error.
+        bytes_read += sizeof(ext);
+        if (ext.cbSize < sizeof(ext) - sizeof(ext.cbSize))
+            return false; // Invalid extension size.
+        if (memcmp(&ext.SubFormat[2], &kSubFormatGUID[2], sizeof(kSubFormatGUID) - 2) != 0)
+            return false; // Unsupported format.
+        hdr.wFmtTag = static_cast<unsigned short>(ext.SubFormat[0] | (ext.SubFormat[1] << 8));
+#ifdef TRACE
+        printf("read_and_confirm_format_header: extensible tag=%u valid_bits=%u mask=0x%x\n",
+            hdr.wFmtTag, ext.wValidBits, ext.dwChannelMask);
+#endif
+    }
 
-    // Check that the contents of the header are acceptable.
-    if (hdr.nBits != 8 && hdr.nBits != 16 && hdr.nBits != 32)
+    // Check that the contents of the header are acceptable.  Each
+    // sample is stored in a whole number of bytes, or in a larger
+    // container if the block alignment says so.
+    if (hdr.wFmtTag != kFormatPCM && hdr.wFmtTag != kFormatFloat)
         return false; // Unsupported format.
-    if (hdr.wFmtTag != 1 && hdr.wFmtTag != 3)
+    if (hdr.nChannels < 1 || hdr.nBits < 1)
         return false; // Unsupported format.
-    if (hdr.nChannels < 1 || hdr.nChannels > 5)
+    unsigned container_bits = (hdr.nBits + 7) / 8 * 8;
+    if (hdr.nAlign % hdr.nChannels == 0 && hdr.nAlign / hdr.nChannels * 8u > container_bits)
+        container_bits = hdr.nAlign / hdr.nChannels * 8u;
+    if (ext.wValidBits == 0 || ext.wValidBits > container_bits)
+        ext.wValidBits = hdr.nBits;
+    hdr.nBits = static_cast<unsigned short>(container_bits);
+    if (hdr.wFmtTag == kFormatPCM &&
+        hdr.nBits != 8 && hdr.nBits != 16 && hdr.nBits != 24 && hdr.nBits != 32)
+        return false; // Unsupported format.
+    if (hdr.wFmtTag == kFormatFloat && hdr.nBits != 32 && hdr.nBits != 64)
         return false; // Unsupported format.
 
-#ifdef TRACE
-    printf("read_and_confirm_format_header: before seek ftell=%u\n", ftell(fp));
-#endif
-
-    // Seek past the header to the next chunk.
-    if (fseek(fp, hdr_size - sizeof(hdr), SEEK_CUR))
+    // Seek past the rest of the header (and its pad byte, if the
+    // size is odd) to the next chunk.
+    if (!skip_bytes(fp, hdr_size - bytes_read + (hdr_size & 1), seekable))
         return false; // Seek failed.
 
 #ifdef TRACE
-    printf("read_and_confirm_format_header ok.  ftell=%u\n", ftell(fp));
+    printf("read_and_confirm_format_header ok.  ftell=%lld\n", _ftelli64(fp));
 #endif
     return true;
 }
 
-// Reads and verifies the "data" signature that appears at the
-// beginning of the sample data chunk of the WAV file.  Assumes
-// that the file pointer is already at the beginning of the next
-// chunk in the WAV file when called.  If successful, populates
-// 'datasize' with the number of bytes of data that follow the
-// data header, and returns true, leaving the file pointer at
-// the first byte of sample data.
-static bool read_and_confirm_data_header(FILE *fp, uint32_t &datasize)
+// Reads and verifies the headers at the beginning of a WAV file,
+// which may be a plain RIFF file or an RF64/BW64 file whose sizes
+// are in a 'ds64' chunk.  Chunks other than 'ds64' and 'fmt ' that
+// come before the 'data' chunk (such as 'JUNK') are skipped.  If
+// successful, populates 'hdr' and 'ext' with the format header
+// (see read_and_confirm_format_header), 'data_size' with the number
+// of bytes of sample data, and 'is_rf64' with whether the file is
+// RF64/BW64, and returns true, leaving the file pointer at the first
+// byte of sample data.
+//
+// A data size that runs past the end of the file (as left by a
+// recorder that didn't finish, or a writer that doesn't know about
+// RF64) is trimmed to what's actually there, and then to a whole
+// number of sample frames.
+//
+// If 'seekable' is false, the file is only ever read forward, so it
+// can be a pipe.  The data size can't be checked against the end of
+// the file then, so a placeholder size (zero, or all ones) is
+// returned as kStreamingSize, meaning the data runs to the end.
+static bool read_wav_headers(FILE *fp, WAVFHDR &hdr, WAVFEXT &ext, uint64_t &data_size, bool &is_rf64,
+                             bool seekable = true)
 {
+    // Read the 12-byte signature from the beginning of the file.
+    char signature[12] = {0};
+    if (fread(signature, 1, sizeof(signature), fp) != sizeof(signature))
+    {
 #ifdef TRACE
-    printf("read_and_confirm_data_header: ftell=%u\n", ftell(fp));
+        printf("read_wav_headers: Can't read signature bytes!\n");
 #endif
+        return false; // Can't read signature bytes.
+    }
 
-    char datasig[4] = {0};
-
-    // Keep reading chunks until we find the one that contains the
-    // audio sample data.
-    while (fread(datasig, 1, sizeof(datasig), fp) == sizeof(datasig))
+    // Check that the signature is good.
+    is_rf64 = strncmp(signature, "RF64", 4) == 0 || strncmp(signature, "BW64", 4) == 0;
+    if ((!is_rf64 && strncmp(signature, "RIFF", 4) != 0) || strncmp(&signature[8], "WAVE", 4) != 0)
     {
 #ifdef TRACE
-        printf("read_and_confirm_data_header: datasig='%c%c%c%c'\n",
-            datasig[0], datasig[1], datasig[2], datasig[3]);
+        printf("read_wav_headers: Expected 'RIFF....WAVE', got '%.12s'\n", signature);
 #endif
+        return false; // Doesn't appear to be a valid WAV file.
+    }
+
+    bool have_format = false;
+    uint64_t ds64_data_size = 0;
+    char chunk_name[4] = {0};
+    uint32_t chunk_size = 0;
+    data_size = 0;
 
-        // Read the size of this chunk of the WAV file.
-        datasize = 0;
-        if (fread(&datasize, 1, sizeof(datasize), fp) != sizeof(datasize))
+    // Keep reading chunks until we find the one that contains the
+    // audio sample data.
+    while (fread(chunk_name, 1, sizeof(chunk_name), fp) == sizeof(chunk_name))
+    {
+        if (fread(&chunk_size, 1, sizeof(chunk_size), fp) != sizeof(chunk_size))
         {
 #ifdef TRACE
-            printf("read_and_confirm_data_header: Failed getting chunk size!\n");
+            printf("read_wav_headers: Failed getting chunk size!\n");
 #endif
             return false;
         }
 #ifdef TRACE
-        printf("read_and_confirm_data_header: datasize=%u\n", datasize);
+        printf("read_wav_headers: chunk='%.4s' size=%u\n", chunk_name, chunk_size);
 #endif
 
-        // If the chunk's name is "data", we found what we're looking for.
-        if (memcmp(datasig, "data", sizeof(datasig)) == 0)
+        if (memcmp(chunk_name, "ds64", 4) == 0 && is_rf64)
+        {
+            // The 64-bit RIFF size comes first, then the data size.
+            uint64_t sizes[2] = {0};
+            if (chunk_size < sizeof(sizes) || fread(sizes, 1, sizeof(sizes), fp) != sizeof(sizes))
+                return false;
+            ds64_data_size = sizes[1];
+            if (!skip_bytes(fp, chunk_size - sizeof(sizes) + (chunk_size & 1), seekable))
+                return false; // Seek failed.
+        }
+        else if (memcmp(chunk_name, "fmt ", 4) == 0)
         {
+            if (!read_and_confirm_format_header(fp, chunk_size, hdr, ext, seekable))
+                return false; // Unsupported format.
+            have_format = true;
+        }
+        else if (memcmp(chunk_name, "data", 4) == 0)
+        {
+            // If the chunk's name is "data", we found what we're
+            // looking for.
+            if (!have_format)
+                return false; // No format header before the data.
+
+            data_size = (is_rf64 && chunk_size == kRF64SizeMarker) ? ds64_data_size : chunk_size;
+
+            if (!seekable)
+            {
+                if (data_size == 0 || data_size == kRF64SizeMarker)
+                    data_size = kStreamingSize;
+                return true;
+            }
+
+            int64_t data_offset = _ftelli64(fp);
+            if (data_offset < 0 || _fseeki64(fp, 0, SEEK_END))
+                return false;
+            int64_t file_size = _ftelli64(fp);
+            if (file_size < data_offset || _fseeki64(fp, data_offset, SEEK_SET))
+                return false;
+            if (data_size > static_cast<uint64_t>(file_size - data_offset))
+            {
 #ifdef TRACE
-            printf("read_and_confirm_data_header: Found the 'data' chunk.\n");
+                printf("read_wav_headers: Trimming data size %llu to the end of the file.\n",
+                    static_cast<unsigned long long>(data_size));
 #endif
+                data_size = static_cast<uint64_t>(file_size - data_offset);
+            }
+
+            // A partial sample frame at the end is dropped, so every
+            // reader sees the same whole frames m_sample_count counts.
+            uint64_t frame_bytes = static_cast<uint64_t>(hdr.nChannels) * (hdr.nBits / 8);
+            data_size -= data_size % frame_bytes;
             return true;
         }
-
-        // Seek past this chunk's data bytes to the next chunk's header.
-        if (fseek(fp, datasize, SEEK_CUR))
+        else
         {
+            // Seek past this chunk's data bytes to the next chunk's
+            // header.
+            if (!skip_bytes(fp, static_cast<uint64_t>(chunk_size) + (chunk_size & 1), seekable))
+            {
 #ifdef TRACE
-            printf("read_and_confirm_data_header: Seek failed!\n");
+                printf("read_wav_headers: Seek failed!\n");
 #endif
-            return false; // Seek failed.
+                return false; // Seek failed.
+            }
         }
     }
 
     // Didn't find any "data" chunks in the rest of the WAV file.
-    datasize = 0;
-
 #ifdef TRACE
-    printf("read_and_confirm_data_header: No 'data' chunk found!\n");
+    printf("read_wav_headers: No 'data' chunk found!\n");
 #endif
-
-    return true;
+    return have_format;
 }
 
 // Reads the header portion of a WAV file.  Among other things, the
@@ -294,7 +398,7 @@ bool WAVFileReadHeader(const wchar_t *filename, WAVInfo &header)
 
     // Open the WAV file for reading.
     FILE *fp = nullptr;
-    if (_wfopen_s(&fp, filename, L"r+b") || !fp)
+    if (_wfopen_s(&fp, filename, L"rb") || !fp)
     {
 #ifdef TRACE
         printf("WAVFileReadHeader failed opening file '%S'\n", filename);
@@ -305,40 +409,32 @@ bool WAVFileReadHeader(const wchar_t *filename, WAVInfo &header)
 
     // Read and check the various headers in the WAV file.
     WAVFHDR hdr = {0};
-    uint32_t datasize = 0;
-    if (!read_and_confirm_wav_signature(fp))
+    WAVFEXT ext = {0};
+    uint64_t datasize = 0;
+    bool is_rf64 = false;
+    if (!read_wav_headers(fp, hdr, ext, datasize, is_rf64))
     {
 #ifdef TRACE
-        printf("WAVFileReadHeader bad file signature, not a WAV file!\n");
+        printf("WAVFileReadHeader not a WAV file, or unsupported audio format!\n");
 #endif
-        return false; // Unrecognized file signature, not a WAV.
-    }
-    if (!read_and_confirm_format_header(fp, hdr))
-    {
-#ifdef TRACE
-        printf("WAVFileReadHeader unsupported audio format!\n");
-#endif
-        return false; // Unsupported audio format or read error.
-    }
-    if (!read_and_confirm_data_header(fp, datasize))
-    {
-#ifdef TRACE
-        printf("WAVFileReadHeader data chunk not found or unreadable!\n");
-#endif
-        return false; // Data chunk not found or unreadable.
+        return false; // Not a WAV, unsupported format, or read error.
     }
 
     // Save a few pieces of info we'll need about the audio format.
     header.m_rate         = hdr.Rate;
     header.m_channels     = hdr.nChannels;
     header.m_bits         = hdr.nBits;
-    header.m_is_float     = (hdr.wFmtTag == 3);
+    header.m_valid_bits   = (ext.wValidBits < hdr.nBits) ? ext.wValidBits : 0;
+    header.m_channel_mask = ext.dwChannelMask;
+    header.m_is_float     = (hdr.wFmtTag == kFormatFloat);
+    header.m_is_rf64      = is_rf64;
     header.m_sample_count = datasize / hdr.nChannels / (hdr.nBits / 8);
 
 #ifdef TRACE
-    printf("WAVFileReadHeader rate=%u nChannels=%u bits=%u float=%s samples=%u\n",
-        header.m_rate, header.m_channels, header.m_bits,
-        header.m_is_float ? "float" : "int", header.m_sample_count);
+    printf("WAVFileReadHeader rate=%u nChannels=%u bits=%u valid_bits=%u mask=0x%x float=%s rf64=%s samples=%llu\n",
+        header.m_rate, header.m_channels, header.m_bits, header.m_valid_bits, header.m_channel_mask,
+        header.m_is_float ? "float" : "int", is_rf64 ? "yes" : "no",
+        static_cast<unsigned long long>(header.m_sample_count));
 #endif
     return true;
 }
@@ -359,86 +455,513 @@ bool WAVFileReadSamples(const wchar_t *filename, void *sample_buffer, size_t buf
 
     // Open the WAV file for reading.
     FILE *fp = nullptr;
-    if (_wfopen_s(&fp, filename, L"r+b") || !fp)
+    if (_wfopen_s(&fp, filename, L"rb") || !fp)
         return false;
     ScopedFile sfp(fp);
 
     // Read and check the various headers in the WAV file.
     WAVFHDR hdr = {0};
-    uint32_t data_size = 0;
-    if (!read_and_confirm_wav_signature(fp))
-        return false; // Unrecognized file signature, not a WAV.
-    if (!read_and_confirm_format_header(fp, hdr))
-        return false; // Unsupported audio format or read error.
-    if (!read_and_confirm_data_header(fp, data_size))
-        return false; // Data chunk not found or unreadable.
+    WAVFEXT ext = {0};
+    uint64_t data_size = 0;
+    bool is_rf64 = false;
+    if (!read_wav_headers(fp, hdr, ext, data_size, is_rf64))
+        return false; // Not a WAV, unsupported format, or read error.
 
     // Read the sample data into the caller's buffer.
     if (buffer_size < data_size)
         return false; // Buffer is too small.
-    if (fread(sample_buffer, 1, data_size, fp) != data_size)
+    if (fread(sample_buffer, 1, static_cast<size_t>(data_size), fp) != data_size)
         return false;
 
     return true;
 }
 
-// Writes a buffer of audio samples to a WAV file.
-// The given header specifies the format of the data in the buffer.
+// Reads 'sample_count' audio samples (per channel) from a WAV file,
+// starting at sample 'first_sample', into the provided buffer.  Only
+// the requested part of the file is read.  The buffer_size parameter
+// should indicate the size limit of the buffer in bytes.  The range
+// must lie within the file's sample data.
 //
 // Returns true if successful.
-bool WAVFileWrite(const wchar_t *filename, const WAVInfo &header, const void *samples)
+bool WAVFileReadSampleRange(
+        const wchar_t *filename,
+        uint64_t first_sample,
+        uint64_t sample_count,
+        void *sample_buffer,
+        size_t buffer_size)
 {
-    if (!filename || !*filename || !samples || !header.m_sample_count)
+#ifdef TRACE
+    printf("WAVFileReadSampleRange file='%S' first=%llu count=%llu\n", filename,
+        static_cast<unsigned long long>(first_sample), static_cast<unsigned long long>(sample_count));
+#endif
+
+    if (!filename || !*filename || !sample_buffer || !buffer_size)
         return false; // Bad parameter.
-    if (header.m_bits != 8 && header.m_bits != 16 && header.m_bits != 32)
+
+    // Open the WAV file for reading.
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"rb") || !fp)
+        return false;
+    ScopedFile sfp(fp);
+
+    // Read and check the various headers in the WAV file.
+    WAVFHDR hdr = {0};
+    WAVFEXT ext = {0};
+    uint64_t data_size = 0;
+    bool is_rf64 = false;
+    if (!read_wav_headers(fp, hdr, ext, data_size, is_rf64))
+        return false; // Not a WAV, unsupported format, or read error.
+
+    // Check that the range is within the sample data.
+    uint64_t frame_bytes = static_cast<uint64_t>(hdr.nChannels) * (hdr.nBits / 8);
+    uint64_t first_byte = first_sample * frame_bytes;
+    uint64_t bytes = sample_count * frame_bytes;
+    if (first_byte + bytes > data_size)
+        return false; // Range is out of bounds.
+    if (buffer_size < bytes)
+        return false; // Buffer is too small.
+
+    // Skip to the first requested sample and read from there.
+    if (_fseeki64(fp, static_cast<int64_t>(first_byte), SEEK_CUR))
+        return false; // Seek failed.
+    if (fread(sample_buffer, 1, static_cast<size_t>(bytes), fp) != bytes)
         return false;
 
+    return true;
+}
+
+// Reads the audio samples from a WAV file a block at a time, so the
+// whole file never has to be held in memory.  Each block holds at
+// most 'block_size' bytes, which should be a multiple of the size
+// of one sample times the channel count.  The callback is called
+// once per block; if it returns false, reading stops and this
+// function fails.
+//
+// Returns true if successful.
+bool WAVFileReadSamplesInBlocks(
+        const wchar_t *filename,
+        size_t block_size,
+        bool (*block_func)(void *context, const void *samples, size_t bytes),
+        void *context)
+{
 #ifdef TRACE
-    printf("WAVFileWrite file='%S'\n", filename);
+    printf("WAVFileReadSamplesInBlocks file='%S' block_size=%zu\n", filename, block_size);
 #endif
 
-    // Open the WAV file for writing.
+    if (!filename || !*filename || !block_size || !block_func)
+        return false; // Bad parameter.
+
+    // Open the WAV file for reading.
     FILE *fp = nullptr;
-    if (_wfopen_s(&fp, filename, L"w+b") || !fp)
+    if (_wfopen_s(&fp, filename, L"rb") || !fp)
         return false;
     ScopedFile sfp(fp);
 
+    // Read and check the various headers in the WAV file.
+    WAVFHDR hdr = {0};
+    WAVFEXT ext = {0};
+    uint64_t data_size = 0;
+    bool is_rf64 = false;
+    if (!read_wav_headers(fp, hdr, ext, data_size, is_rf64))
+        return false; // Not a WAV, unsupported format, or read error.
+
+    // Pass the sample data to the callback one block at a time.
+    std::vector<uint8_t> block(block_size);
+    uint64_t remaining = data_size;
+    while (remaining > 0)
+    {
+        size_t bytes = (remaining < block_size) ? static_cast<size_t>(remaining) : block_size;
+        if (fread(block.data(), 1, bytes, fp) != bytes)
+            return false;
+        if (!block_func(context, block.data(), bytes))
+            return false;
+        remaining -= bytes;
+    }
+
+    return true;
+}
+
+// Writes the headers at the beginning of a WAV file whose sample
+// data will be 'data_size' bytes long, leaving the file pointer
+// where the sample data goes.  Writes an RF64 file (with the sizes
+// in a 'ds64' chunk) if the sizes don't fit in the 32-bit fields of
+// a plain RIFF file, or if the header asks for one.  Writes an
+// extensible format header if a plain one would be ambiguous.
+//
+// If 'reserve_ds64' is true, a plain RIFF file gets a 'JUNK' chunk
+// the size of a 'ds64' chunk, so the headers can later be rewritten
+// as RF64 without moving the sample data.  A data size of
+// kStreamingSize writes placeholder sizes (all ones) for a stream
+// whose length isn't known yet.
+static bool write_wav_headers(FILE *fp, const WAVInfo &header, uint64_t data_size, bool reserve_ds64 = false)
+{
+    bool extensible = header.m_channels > 2 ||
+        (!header.m_is_float && header.m_bits > 16) ||
+        header.m_channel_mask != 0 ||
+        (header.m_valid_bits != 0 && header.m_valid_bits != header.m_bits);
+    uint32_t hdr_size = static_cast<uint32_t>(sizeof(WAVFHDR) + (extensible ? sizeof(WAVFEXT) : 0));
+
+    // The RIFF size counts everything after the size field itself,
+    // including the pad byte after an odd-sized data chunk.
+    bool streaming = (data_size == kStreamingSize);
+    uint64_t riff_size = 4 + (8 + hdr_size) + (8 + data_size + (data_size & 1));
+    bool rf64 = !streaming && (header.m_is_rf64 || riff_size + 8 + kDS64Size > kRF64SizeMarker);
+    if (rf64 || reserve_ds64)
+        riff_size += 8 + kDS64Size;
+
+#ifdef TRACE
+    printf("write_wav_headers data_size=%llu rf64=%s extensible=%s\n",
+        static_cast<unsigned long long>(data_size), rf64 ? "yes" : "no", extensible ? "yes" : "no");
+#endif
+
     // Write the file signature.
-    uint32_t offset = (uint32_t)(16 + sizeof(WAVFHDR) + header.CalculateBufferSize());
-    if (fwrite("RIFF", 1, 4, fp) != 4)
+    uint32_t riff_size32 = (rf64 || streaming) ? kRF64SizeMarker : static_cast<uint32_t>(riff_size);
+    if (fwrite(rf64 ? "RF64" : "RIFF", 1, 4, fp) != 4)
         return false;
-    if (fwrite(&offset, 1, sizeof(offset), fp) != sizeof(offset))
+    if (fwrite(&riff_size32, 1, sizeof(riff_size32), fp) != sizeof(riff_size32))
         return false;
-    if (fwrite("WAVEfmt ", 1, 8, fp) != 8)
+    if (fwrite("WAVE", 1, 4, fp) != 4)
         return false;
 
+    // Write the 64-bit sizes.
+    if (rf64)
+    {
+        uint64_t sizes[3] = { riff_size, data_size, header.m_sample_count };
+        uint32_t ds64_size = kDS64Size;
+        uint32_t table_length = 0;
+        if (fwrite("ds64", 1, 4, fp) != 4 ||
+            fwrite(&ds64_size, 1, sizeof(ds64_size), fp) != sizeof(ds64_size) ||
+            fwrite(sizes, 1, sizeof(sizes), fp) != sizeof(sizes) ||
+            fwrite(&table_length, 1, sizeof(table_length), fp) != sizeof(table_length))
+        {
+            return false;
+        }
+    }
+    else if (reserve_ds64)
+    {
+        uint8_t junk[kDS64Size] = {0};
+        uint32_t junk_size = kDS64Size;
+        if (fwrite("JUNK", 1, 4, fp) != 4 ||
+            fwrite(&junk_size, 1, sizeof(junk_size), fp) != sizeof(junk_size) ||
+            fwrite(junk, 1, sizeof(junk), fp) != sizeof(junk))
+        {
+            return false;
+        }
+    }
+
     // Write the size of the format header.
-    uint32_t hdr_size = static_cast<uint32_t>(sizeof(WAVFHDR));
+    if (fwrite("fmt ", 1, 4, fp) != 4)
+        return false;
     if (fwrite(&hdr_size, 1, sizeof(hdr_size), fp) != sizeof(hdr_size))
         return false;
 
     // Write the format header.
+    unsigned short format = header.m_is_float ? kFormatFloat : kFormatPCM;
     WAVFHDR wfhdr = {0};
-    wfhdr.wFmtTag   = (header.m_is_float ? 3 : 1);
+    wfhdr.wFmtTag   = extensible ? kFormatExtensible : format;
     wfhdr.nChannels = static_cast<unsigned short>(header.m_channels);
     wfhdr.Rate      = header.m_rate;
-    wfhdr.BPS       = header.m_rate * (header.m_bits / 8);
     wfhdr.nAlign    = static_cast<unsigned short>(header.m_bits / 8 * header.m_channels);
+    wfhdr.BPS       = header.m_rate * wfhdr.nAlign;
     wfhdr.nBits     = static_cast<unsigned short>(header.m_bits);
     if (fwrite(&wfhdr, 1, sizeof(wfhdr), fp) != sizeof(wfhdr))
         return false;
 
+    // Write the extension, if we need one.
+    if (extensible)
+    {
+        WAVFEXT ext = {0};
+        ext.cbSize        = static_cast<uint16_t>(sizeof(WAVFEXT) - sizeof(ext.cbSize));
+        ext.wValidBits    = static_cast<uint16_t>(header.m_valid_bits ? header.m_valid_bits : header.m_bits);
+        ext.dwChannelMask = header.m_channel_mask;
+        memcpy(ext.SubFormat, kSubFormatGUID, sizeof(ext.SubFormat));
+        ext.SubFormat[0]  = static_cast<uint8_t>(format);
+        if (fwrite(&ext, 1, sizeof(ext), fp) != sizeof(ext))
+            return false;
+    }
+
     // Write the header for the "data" chunk.
-    uint32_t data_size = header.CalculateBufferSize();
+    uint32_t data_size32 = (rf64 || streaming) ? kRF64SizeMarker : static_cast<uint32_t>(data_size);
     if (fwrite("data", 1, 4, fp) != 4)
         return false;
-    if (fwrite(&data_size, 1, sizeof(data_size), fp) != sizeof(data_size))
+    if (fwrite(&data_size32, 1, sizeof(data_size32), fp) != sizeof(data_size32))
+        return false;
+
+    return true;
+}
+
+// Checks the format in a header that's about to be written.
+static bool is_writable_format(const WAVInfo &header)
+{
+    if (header.m_bits != 8 && header.m_bits != 16 && header.m_bits != 24 && header.m_bits != 32)
+        return false;
+    if (header.m_is_float && header.m_bits != 32)
+        return false;
+    if (header.m_valid_bits > header.m_bits)
         return false;
+    if (header.m_channels < 1 || header.m_channels > 0xFFFF)
+        return false;
+    return true;
+}
 
-    // Write the raw sample data.
-    if (fwrite(samples, 1, data_size, fp) != data_size)
+// Writes a buffer of audio samples to a WAV file.
+// The given header specifies the format of the data in the buffer.
+//
+// Returns true if successful.
+bool WAVFileWrite(const wchar_t *filename, const WAVInfo &header, const void *samples)
+{
+    if (!filename || !*filename || !samples || !header.m_sample_count)
+        return false; // Bad parameter.
+    if (!is_writable_format(header))
+        return false;
+
+#ifdef TRACE
+    printf("WAVFileWrite file='%S'\n", filename);
+#endif
+
+    // Open the WAV file for writing.
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"w+b") || !fp)
+        return false;
+    ScopedFile sfp(fp);
+
+    uint64_t data_size = header.CalculateBufferSize();
+    if (!write_wav_headers(fp, header, data_size))
+        return false;
+
+    // Write the raw sample data, and the pad byte that keeps chunks
+    // at even offsets.
+    if (fwrite(samples, 1, static_cast<size_t>(data_size), fp) != data_size)
+        return false;
+    if ((data_size & 1) && fputc(0, fp) == EOF)
         return false;
 
     return true;
 }
 
+// Writes a WAV file whose audio samples are supplied a block at a
+// time by a callback, so the whole file never has to be held in
+// memory.  See the header for details.
+//
+// Returns true if successful.
+bool WAVFileWriteInBlocks(
+        const wchar_t *filename,
+        const WAVInfo &header,
+        size_t block_size,
+        bool (*block_func)(void *context, void *samples, size_t bytes),
+        void *context)
+{
+    if (!filename || !*filename || !block_size || !block_func || !header.m_sample_count)
+        return false; // Bad parameter.
+    if (!is_writable_format(header))
+        return false;
+
+#ifdef TRACE
+    printf("WAVFileWriteInBlocks file='%S' block_size=%zu\n", filename, block_size);
+#endif
+
+    // Open the WAV file for writing.
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"w+b") || !fp)
+        return false;
+    ScopedFile sfp(fp);
+
+    uint64_t data_size = header.CalculateBufferSize();
+    if (!write_wav_headers(fp, header, data_size))
+        return false;
+
+    // Have the callback fill each block, then write it.
+    std::vector<uint8_t> block(block_size);
+    uint64_t remaining = data_size;
+    while (remaining > 0)
+    {
+        size_t bytes = (remaining < block_size) ? static_cast<size_t>(remaining) : block_size;
+        if (!block_func(context, block.data(), bytes))
+            return false;
+        if (fwrite(block.data(), 1, bytes, fp) != bytes)
+            return false;
+        remaining -= bytes;
+    }
+    if ((data_size & 1) && fputc(0, fp) == EOF)
+        return false;
+
+    return true;
+}
+// Reads a WAV file from an open stream, such as standard input,
+// that may not be able to seek.  See the header for details.
+//
+// Returns true if successful.
+bool WAVFileReadStream(
+        FILE *fp,
+        WAVInfo &header,
+        size_t block_size,
+        bool (*block_func)(void *context, const void *samples, size_t bytes),
+        void *context)
+{
+#ifdef TRACE
+    printf("WAVFileReadStream block_size=%zu\n", block_size);
+#endif
+
+    header = WAVInfo();
+
+    if (!fp || !block_size || !block_func)
+        return false; // Bad parameter.
+
+    uint64_t remaining = 0;
+    if (!WAVFileReadStreamHeader(fp, header, remaining))
+        return false;
+
+    // Pass the sample data to the callback one block at a time, in
+    // whole sample frames, until the data chunk or the stream ends.
+    size_t frame_bytes = static_cast<size_t>(header.m_channels) * (header.m_bits / 8);
+    if (block_size < frame_bytes)
+        block_size = frame_bytes;
+    block_size -= block_size % frame_bytes;
+    std::vector<uint8_t> block(block_size);
+    uint64_t frames_read = 0;
+    size_t got;
+    while ((got = WAVFileReadStreamSamples(fp, header, remaining, block.data(), block_size)) > 0)
+    {
+        if (!block_func(context, block.data(), got))
+            return false;
+        frames_read += got / frame_bytes;
+    }
+    if (ferror(fp))
+        return false;
+
+    header.m_sample_count = frames_read;
+    return true;
+}
+
+// Reads the headers of a WAV file from an open stream, leaving the
+// samples to be read.  See the header for details.
+//
+// Returns true if successful.
+bool WAVFileReadStreamHeader(
+        FILE *fp,
+        WAVInfo &header,
+        uint64_t &remaining)
+{
+    header = WAVInfo();
+    remaining = 0;
+
+    if (!fp)
+        return false; // Bad parameter.
+
+    // Read and check the various headers, reading forward only.
+    WAVFHDR hdr = {0};
+    WAVFEXT ext = {0};
+    uint64_t data_size = 0;
+    bool is_rf64 = false;
+    if (!read_wav_headers(fp, hdr, ext, data_size, is_rf64, false))
+        return false; // Not a WAV, unsupported format, or read error.
+
+    uint64_t frame_bytes = static_cast<uint64_t>(hdr.nChannels) * (hdr.nBits / 8);
+    header.m_rate         = hdr.Rate;
+    header.m_channels     = hdr.nChannels;
+    header.m_bits         = hdr.nBits;
+    header.m_valid_bits   = (ext.wValidBits < hdr.nBits) ? ext.wValidBits : 0;
+    header.m_channel_mask = ext.dwChannelMask;
+    header.m_is_float     = (hdr.wFmtTag == kFormatFloat);
+    header.m_is_rf64      = is_rf64;
+    header.m_sample_count = (data_size == kStreamingSize) ? 0 : data_size / frame_bytes;
+
+#ifdef TRACE
+    printf("WAVFileReadStreamHeader rate=%u channels=%u bits=%u float=%s data_size=%llu\n",
+        header.m_rate, header.m_channels, header.m_bits, header.m_is_float ? "float" : "int",
+        static_cast<unsigned long long>(data_size));
+#endif
+
+    remaining = (data_size == kStreamingSize) ? kStreamingSize : data_size - data_size % frame_bytes;
+    return true;
+}
+
+// Reads the next block of samples from a stream whose headers have
+// been read.  See the header for details.
+//
+// Returns the number of bytes read.
+size_t WAVFileReadStreamSamples(
+        FILE *fp,
+        const WAVInfo &header,
+        uint64_t &remaining,
+        void *samples,
+        size_t bytes)
+{
+    size_t frame_bytes = static_cast<size_t>(header.m_channels) * (header.m_bits / 8);
+    if (!fp || !samples || frame_bytes == 0)
+        return 0; // Bad parameter.
+
+    bytes -= bytes % frame_bytes;
+    if (remaining < bytes)
+        bytes = static_cast<size_t>(remaining);
+    size_t got = fread(samples, 1, bytes, fp);
+    got -= got % frame_bytes;
+    remaining = (got < bytes) ? 0 : remaining - got;
+    return got;
+}
+
+// Writes a WAV file to an open stream, such as standard output,
+// that may not be able to seek, with the sizes patched in at the
+// end if it can.  See the header for details.
+//
+// Returns true if successful.
+bool WAVFileWriteStream(
+        FILE *fp,
+        const WAVInfo &header,
+        size_t block_size,
+        bool (*block_func)(void *context, void *samples, size_t bytes, size_t &filled),
+        void *context)
+{
+    if (!fp || !block_size || !block_func)
+        return false; // Bad parameter.
+    if (!is_writable_format(header))
+        return false;
+
+#ifdef TRACE
+    printf("WAVFileWriteStream block_size=%zu\n", block_size);
+#endif
+
+    // Note where the file starts, if the stream is a regular file
+    // that can seek.  (Seeking a pipe doesn't reliably fail.)
+    struct _stat64 st;
+    bool seekable = _fstat64(_fileno(fp), &st) == 0 && (st.st_mode & _S_IFMT) == _S_IFREG;
+    int64_t start = seekable ? _ftelli64(fp) : -1;
+
+    if (!write_wav_headers(fp, header, kStreamingSize, true))
+        return false;
+
+    // Have the callback fill each block, then write it, until the
+    // callback runs out of samples.
+    std::vector<uint8_t> block(block_size);
+    uint64_t data_size = 0;
+    for (;;)
+    {
+        size_t filled = 0;
+        if (!block_func(context, block.data(), block_size, filled))
+            return false;
+        if (filled == 0)
+            break;
+        if (fwrite(block.data(), 1, filled, fp) != filled)
+            return false;
+        data_size += filled;
+    }
+    if ((data_size & 1) && fputc(0, fp) == EOF)
+        return false;
+    if (fflush(fp))
+        return false;
+
+    // If the stream can seek, go back and write the real sizes into
+    // the headers, switching to RF64 if the data grew too large.
+    // Otherwise the placeholder sizes stay.
+    if (start >= 0 && _fseeki64(fp, start, SEEK_SET) == 0)
+    {
+        WAVInfo final_header = header;
+        final_header.m_sample_count = data_size / (static_cast<uint64_t>(header.m_channels) * (header.m_bits / 8));
+        if (!write_wav_headers(fp, final_header, data_size, true))
+            return false;
+        if (_fseeki64(fp, 0, SEEK_END) || fflush(fp))
+            return false;
+    }
+
+    return true;
+}
@@ -9,16 +9,24 @@
 // Note this module intentionally doesn't use any definitions from
 // windows.h so we can avoid including it here.
 //
+// Files over 4 GB are supported in the RF64 format (EBU Tech 3306)
+// and its BW64 variant (ITU-R BS.2088), where the 32-bit sizes of
+// a RIFF file are set to all ones and the real sizes are kept in a
+// 'ds64' chunk.
+//
+// The WAVE_FORMAT_EXTENSIBLE form of the format header is also
+// supported.  It's read for any number of channels and sample
+// sizes, and written whenever a plain header would be ambiguous:
+// for more than two channels, integer samples over 16 bits, or a
+// channel mask or valid bit count the plain header can't express.
+//
 // Limitations:
 //
 // * Only supports raw PCM audio formats, including 8-bit
-//   unsigned integer samples, 16-bit signed integer samples,
-//   and 32-bit floating-point samples.  Doesn't currently
-//   support compressed or adaptive formats.
-//
-// * When reading WAV files, assumes there are no extra RIFF
-//   chunks or padding byte between the file header, the format
-//   header, and the audio data.
+//   unsigned integer samples, 16-, 24-, and 32-bit signed integer
+//   samples, and 32-bit floating-point samples (64-bit ones can
+//   be read, but not written).  Doesn't currently support
+//   compressed or adaptive formats.
 //
 //-------------------------------------------------------------------
 //
@@ -58,18 +66,23 @@
 
 #pragma once
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 // Describes the format of the audio data from a Microsoft WAV file.
 struct WAVInfo
 {
     unsigned m_rate = 48000;        // Sample rate in Hertz.
-    unsigned m_channels = 1;        // Channel count: 1=mono, 2=stereo.
-    unsigned m_bits = 16;           // Bits per sample: 8, 16, or 32.
+    unsigned m_channels = 1;        // Channel count: 1=mono, 2=stereo, etc.
+    unsigned m_bits = 16;           // Bits per stored sample: 8, 16, 24, 32, or 64.
+    unsigned m_valid_bits = 0;      // Significant bits per sample if fewer than m_bits, else zero.
+    uint32_t m_channel_mask = 0;    // Speaker positions of the channels, or zero if unspecified.
     bool m_is_float = false;        // True if sample data is floating-point.
-    unsigned m_sample_count = 0;    // Number of audio samples in file.
+    bool m_is_rf64 = false;         // True if the file is (or should be written as) RF64.
+    uint64_t m_sample_count = 0;    // Number of audio samples (per channel) in file.
 
     // Returns the number of bytes needed to hold the waveform's sample data.
-    unsigned CalculateBufferSize() const { return m_channels * m_bits / 8 * m_sample_count; }
+    uint64_t CalculateBufferSize() const { return static_cast<uint64_t>(m_channels) * (m_bits / 8) * m_sample_count; }
 };
 
 // Reads the header portion of a WAV file.  Among other things, the
@@ -87,9 +100,125 @@ bool WAVFileReadHeader(const wchar_t *filename, WAVInfo &header);
 // Returns true if successful.
 bool WAVFileReadSamples(const wchar_t *filename, void *sample_buffer, size_t buffer_size);
 
+// Reads 'sample_count' audio samples (per channel) from a WAV file,
+// starting at sample 'first_sample', into the provided buffer.  Only
+// the requested part of the file is read.  The buffer_size parameter
+// should indicate the size limit of the buffer in bytes.  The range
+// must lie within the file's sample data.
+//
+// Returns true if successful.
+bool WAVFileReadSampleRange(
+        const wchar_t *filename,
+        uint64_t first_sample,
+        uint64_t sample_count,
+        void *sample_buffer,
+        size_t buffer_size);
+
+// Reads the audio samples from a WAV file a block at a time, so the
+// whole file never has to be held in memory.  Each block holds at
+// most 'block_size' bytes, which should be a multiple of the size
+// of one sample times the channel count.  The callback is called
+// once per block; if it returns false, reading stops and this
+// function fails.
+//
+// Returns true if successful.
+bool WAVFileReadSamplesInBlocks(
+        const wchar_t *filename,
+        size_t block_size,
+        bool (*block_func)(void *context, const void *samples, size_t bytes),
+        void *context);
+
 // Writes a buffer of audio samples to a WAV file.
 // The given header specifies the format of the data in the buffer.
+// The file is written as RF64 if it would be over 4 GB, or if the
+// header's m_is_rf64 is set.  If m_valid_bits is set, the samples
+// should be left-justified in their m_bits-sized containers.
 //
 // Returns true if successful.
 bool WAVFileWrite(const wchar_t *filename, const WAVInfo &header, const void *samples);
 
+// Writes a WAV file whose audio samples are supplied a block at a
+// time, so the whole file never has to be held in memory.  The
+// header gives the format and the total sample count.  The callback
+// is called once per block to fill 'bytes' bytes of samples (at
+// most 'block_size', which should be a multiple of the size of one
+// sample times the channel count); if it returns false, writing
+// stops and this function fails.  The file is written as RF64 the
+// same way as in WAVFileWrite.
+//
+// Returns true if successful.
+bool WAVFileWriteInBlocks(
+        const wchar_t *filename,
+        const WAVInfo &header,
+        size_t block_size,
+        bool (*block_func)(void *context, void *samples, size_t bytes),
+        void *context);
+
+// Reads a WAV file from an open stream, such as standard input, that
+// may not be able to seek; the stream is only ever read forward.
+// Once the headers have been read into 'header', the samples are
+// passed to the callback one block at a time, as in
+// WAVFileReadSamplesInBlocks ('block_size' is rounded down to a whole
+// number of sample frames).  A streaming WAV file, whose data size is
+// a placeholder (zero, or all ones) because its writer didn't know
+// the length, is read to the end of the stream.  When it's done,
+// header.m_sample_count holds the number of samples actually read.
+//
+// Returns true if successful.
+bool WAVFileReadStream(
+        FILE *fp,
+        WAVInfo &header,
+        size_t block_size,
+        bool (*block_func)(void *context, const void *samples, size_t bytes),
+        void *context);
+
+// Does the first half of WAVFileReadStream's job:  reads the headers
+// of a WAV file from an open stream into 'header', leaving the stream
+// at the start of the samples, for a caller that wants to pull them
+// a block at a time with WAVFileReadStreamSamples.  'remaining' gets
+// the number of bytes of samples in the data chunk (a whole number
+// of sample frames); for a streaming WAV file it's UINT64_MAX, and
+// header.m_sample_count is zero, since the length isn't known.
+//
+// Returns true if successful.
+bool WAVFileReadStreamHeader(
+        FILE *fp,
+        WAVInfo &header,
+        uint64_t &remaining);
+
+// Reads up to 'bytes' bytes of samples (rounded down to a whole
+// number of sample frames) from a stream whose headers have been
+// read by WAVFileReadStreamHeader, and takes them off 'remaining'.
+// Returns the number of bytes read, which is less than asked for
+// only at the end of the data or of the stream; a partial frame at
+// the end of the stream is dropped.  Check ferror to tell a read
+// error from the end.
+size_t WAVFileReadStreamSamples(
+        FILE *fp,
+        const WAVInfo &header,
+        uint64_t &remaining,
+        void *samples,
+        size_t bytes);
+
+// Writes a WAV file to an open stream, such as standard output,
+// whose length doesn't need to be known in advance.  The headers are
+// written first with placeholder sizes (all ones, which most readers
+// take to mean the data runs to the end of the file), and header's
+// m_sample_count is ignored.  The callback is called repeatedly to
+// fill up to 'bytes' bytes of samples (a whole number of sample
+// frames), setting 'filled' to the number it filled; the stream ends
+// when it fills none.  If it returns false, writing stops and this
+// function fails.
+//
+// If the stream can seek (as when standard output is redirected to
+// a file), the real sizes are written into the headers at the end,
+// as an RF64 file if the data grew past 4 GB; room for the 'ds64'
+// chunk is reserved with a 'JUNK' chunk.  The stream is left open.
+//
+// Returns true if successful.
+bool WAVFileWriteStream(
+        FILE *fp,
+        const WAVInfo &header,
+        size_t block_size,
+        bool (*block_func)(void *context, void *samples, size_t bytes, size_t &filled),
+        void *context);
@@ -1,5 +1,6 @@
 call CleanTests.bat
 call RunUnitTests.bat
+call RunWaveChainTests.bat
 call RunWaveCompareTests.bat
 call RunWaveConvertTests.bat
 call RunWaveEchoTests.bat
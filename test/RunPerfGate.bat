@@ -0,0 +1,78 @@
+@echo off
+
+    set TLOG=perfgate.out
+    if exist %TLOG% del %TLOG%
+    set TEXE=..\x64\Release\bench.exe
+    if not exist %TEXE% goto exe_missing
+    set TCMP=..\x64\Release\benchcompare.exe
+    if not exist %TCMP% goto cmp_missing
+    set TBASE=perf_baseline1.json,perf_baseline2.json,perf_baseline3.json,perf_baseline4.json,perf_baseline5.json
+    set TCUR=testout_bench1.json,testout_bench2.json,testout_bench3.json,testout_bench4.json,testout_bench5.json
+
+    echo Running benchmarks with "%TEXE%" 5 times.  This takes a while...
+    echo ===================================    >> %TLOG%
+    %TEXE% -Output=testout_bench1.json          >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================    >> %TLOG%
+    %TEXE% -Output=testout_bench2.json          >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================    >> %TLOG%
+    %TEXE% -Output=testout_bench3.json          >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================    >> %TLOG%
+    %TEXE% -Output=testout_bench4.json          >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================    >> %TLOG%
+    %TEXE% -Output=testout_bench5.json          >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================    >> %TLOG%
+
+    if exist perf_baseline1.json goto compare
+    copy testout_bench1.json perf_baseline1.json > nul
+    copy testout_bench2.json perf_baseline2.json > nul
+    copy testout_bench3.json perf_baseline3.json > nul
+    copy testout_bench4.json perf_baseline4.json > nul
+    copy testout_bench5.json perf_baseline5.json > nul
+    echo Saved the results as the baseline in perf_baseline*.json. >> %TLOG%
+    echo Saved the results as the baseline in perf_baseline*.json.
+    goto done
+
+:compare
+    %TCMP% %TBASE% %TCUR%                       >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================    >> %TLOG%
+
+
+:done
+    echo Done running benchmarks. >> %TLOG%
+    echo Done running benchmarks.  See %TLOG% for the comparison.
+    set TEXE=
+    set TCMP=
+    set TBASE=
+    set TCUR=
+    set TLOG=
+    exit /b 0
+
+
+:test_failed
+    echo ERROR:  Performance regression or benchmark failure. >> %TLOG%
+    echo ERROR:  Performance regression or benchmark failure.  See %TLOG% for details.
+    set TEXE=
+    set TCMP=
+    set TBASE=
+    set TCUR=
+    set TLOG=
+    exit /b 1
+
+
+:cmp_missing
+    set TEXE=%TCMP%
+:exe_missing
+    echo ERROR:  Program "%TEXE%" doesn't exist.  Has it been compiled yet?
+    echo ERROR:  Program "%TEXE%" doesn't exist.  Has it been compiled yet?  >> %TLOG%
+    set TEXE=
+    set TCMP=
+    set TBASE=
+    set TCUR=
+    set TLOG=
+    exit /b 1
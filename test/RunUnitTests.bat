@@ -23,6 +23,16 @@
     %TEXE% ..\testdata\strum.mp3                >> %TLOG%
     if errorlevel 1 goto test_failed
     echo ===================================    >> %TLOG%
+    %TEXE% ..\testdata\chug.mp3                 >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================    >> %TLOG%
+
+    %TEXE% -ForceISA=scalar ..\testdata\airhost.wav >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================    >> %TLOG%
+    %TEXE% -ForceISA=sse2 ..\testdata\airhost.wav   >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================    >> %TLOG%
 
 
     echo Done running tests. >> %TLOG%
@@ -0,0 +1,52 @@
+@echo off
+
+    set TLOG=wavechaintest.out
+    if exist %TLOG% del %TLOG%
+    set TEXE=..\x64\Release\wavechain.exe
+    if not exist %TEXE% goto exe_missing
+
+    echo Running tests with "%TEXE%".  One moment...
+    echo ===================================                              >> %TLOG%
+
+    %TEXE% ..\testdata\airhost.wav testout_airhost_chain1.wav volume 0.5 normalize -1         >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================                              >> %TLOG%
+    %TEXE% ..\testdata\airhost.wav testout_airhost_chain2.wav eq 0 4000 -NotchFreq=60 gate -TrimEnd fade 1 2         >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================                              >> %TLOG%
+    %TEXE% ..\testdata\airhost.wav testout_airhost_chain3.wav echo 200 2 -WetLevel=0.3 tremolo 0.1 0.5 -UseTime extend 0.5 0.5 -UseTime         >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================                              >> %TLOG%
+
+    %TEXE% ..\testdata\testing123.wav testout_testing123_chain1.wav mono rate 22050 stretch 1.1         >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================                              >> %TLOG%
+
+    %TEXE% -Float=yes -BytesPerSample=4 ..\testdata\blue.mp3 testout_blue_chain1.wav stereo volume 2.0 normalize -3    >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================                               >> %TLOG%
+
+
+:skip
+    echo Done running tests. >> %TLOG%
+    echo Done running tests.  See %TLOG% for test results.
+    set TEXE=
+    set TLOG=
+    exit /b 0
+
+
+:test_failed
+    echo ERROR:  Test failed. >> %TLOG%
+    echo ERROR:  Test failed.  See %TLOG% for test results.
+    set TEXE=
+    set TLOG=
+    exit /b 1
+
+
+:exe_missing
+    echo ERROR:  Program "%TEXE%" doesn't exist.  Has it been compiled yet? >> %TLOG%
+    echo ERROR:  Program "%TEXE%" doesn't exist.  Has it been compiled yet?
+    set TEXE=
+    set TLOG=
+    exit /b 1
+
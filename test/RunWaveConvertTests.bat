@@ -70,6 +70,10 @@
     if errorlevel 1 goto test_failed
     echo ===================================                  >> %TLOG%
 
+    %TEXE% ..\testdata\airhost.wav - 2>> %TLOG% | %TEXE% - testout_airhost_piped.wav  >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================                  >> %TLOG%
+
 
 :skip
     echo Done running tests. >> %TLOG%
@@ -24,6 +24,13 @@
     if errorlevel 1 goto test_failed
     echo ===================================    >> %TLOG%
 
+    %TEXE% -Stats ..\testdata\airhost.wav ..\testdata\counting.wav  >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================    >> %TLOG%
+    %TEXE% -Stats ..\testdata\blue.mp3 ..\testdata\chug.mp3         >> %TLOG%
+    if errorlevel 1 goto test_failed
+    echo ===================================    >> %TLOG%
+
 
     echo Done running tests. >> %TLOG%
     echo Done running tests.  See %TLOG% for test results.
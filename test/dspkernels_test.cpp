@@ -0,0 +1,305 @@
+//-------------------------------------------------------------------
+//
+// dspkernels_test.cpp
+// Unit tests for the vectorized sample processing kernels.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#include "dspkernels.h"
+#include "denormals.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Block lengths to try:  every length up to a few vectors long, so
+// the leftover samples at the end are handled every way, and some
+// longer ones, including several biquad chunks.
+static const size_t kTestLengths[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 47, 63, 64, 65, 100, 255, 256, 257, 1000, 4099 };
+
+// Returns a random sample from about -1.5 to 1.5, so some need
+// clipping.
+static float random_sample()
+{
+    return static_cast<float>(rand() % 30001 - 15000) / 10000.0f;
+}
+
+// Returns true if the two blocks hold the same bits.
+static bool same_floats(const std::vector<float> &a, const std::vector<float> &b)
+{
+    return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0);
+}
+
+// Checks each kernel against a plain loop with the same arithmetic,
+// for blocks of every test length starting at an odd offset (so the
+// vector loads aren't aligned).  Returns the number of errors.
+static int test_kernels(const DSPKernels &k)
+{
+    int error_count = 0;
+    for (size_t count : kTestLengths)
+    {
+        const size_t offset = 3;
+        std::vector<float> input(count + offset);
+        for (float &value : input)
+            value = random_sample();
+        const float *in = input.data() + offset;
+        std::vector<float> expected(count), actual(count);
+
+        // 16-bit conversions, including both extremes.
+        std::vector<int16_t> pcm16(count + 1);
+        for (size_t i = 0; i < count; i++)
+            pcm16[i + 1] = static_cast<int16_t>(rand() % 65536 - 32768);
+        if (count > 1)
+        {
+            pcm16[1] = -32768;
+            pcm16[count] = 32767;
+        }
+        for (size_t i = 0; i < count; i++)
+            expected[i] = static_cast<float>(pcm16[i + 1]) / 32767.0f;
+        k.ConvertInt16ToFloat(pcm16.data() + 1, actual.data(), count);
+        if (!same_floats(expected, actual))
+        {
+            printf("ERROR:  %s 16-bit to float conversion of %zu samples is wrong\n", k.m_name, count);
+            error_count++;
+        }
+
+        std::vector<int16_t> expected16(count), actual16(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            float scaled = in[i] * 32767.0f;
+            scaled = (scaled < -32767.0f) ? -32767.0f : ((scaled > 32767.0f) ? 32767.0f : scaled);
+            expected16[i] = static_cast<int16_t>(scaled);
+        }
+        k.ConvertFloatToInt16(in, actual16.data(), count);
+        if (expected16 != actual16)
+        {
+            printf("ERROR:  %s float to 16-bit conversion of %zu samples is wrong\n", k.m_name, count);
+            error_count++;
+        }
+
+        // 24-bit conversion, from a buffer with nothing after the
+        // last sample, so reading past it would be caught by tools
+        // that check memory.
+        std::vector<uint8_t> pcm24(count * 3);
+        for (uint8_t &byte : pcm24)
+            byte = static_cast<uint8_t>(rand());
+        for (size_t i = 0; i < count; i++)
+        {
+            int32_t raw = static_cast<int32_t>(static_cast<uint32_t>(pcm24[3 * i]) << 8 |
+                static_cast<uint32_t>(pcm24[3 * i + 1]) << 16 | static_cast<uint32_t>(pcm24[3 * i + 2]) << 24) >> 8;
+            expected[i] = static_cast<float>(raw) / 8388607.0f;
+        }
+        k.Convert24BitToFloat(pcm24.data(), actual.data(), count);
+        if (!same_floats(expected, actual))
+        {
+            printf("ERROR:  %s 24-bit to float conversion of %zu samples is wrong\n", k.m_name, count);
+            error_count++;
+        }
+
+        // Gain, out of place and in place.
+        for (size_t i = 0; i < count; i++)
+            expected[i] = in[i] * 0.7f;
+        k.Gain(in, actual.data(), count, 0.7f);
+        std::vector<float> inPlace(in, in + count);
+        k.Gain(inPlace.data(), inPlace.data(), count, 0.7f);
+        if (!same_floats(expected, actual) || !same_floats(expected, inPlace))
+        {
+            printf("ERROR:  %s gain of %zu samples is wrong\n", k.m_name, count);
+            error_count++;
+        }
+
+        // Gain with clipping, which should pass NaN through.
+        std::vector<float> withNaN(in, in + count);
+        if (count > 5)
+            withNaN[5] = NAN;
+        for (size_t i = 0; i < count; i++)
+        {
+            float value = withNaN[i] * 1.2f;
+            expected[i] = (value < -1.0f) ? -1.0f : ((value > 1.0f) ? 1.0f : value);
+        }
+        k.GainClip(withNaN.data(), actual.data(), count, 1.2f, -1.0f, 1.0f);
+        bool clipOK = true;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (isnan(expected[i]) ? !isnan(actual[i]) : (memcmp(&expected[i], &actual[i], sizeof(float)) != 0))
+                clipOK = false;
+        }
+        inPlace.assign(in, in + count);
+        k.GainClip(inPlace.data(), inPlace.data(), count, 1.2f, -1.0f, 1.0f);
+        k.GainClip(in, actual.data(), count, 1.2f, -1.0f, 1.0f);
+        if (!clipOK || !same_floats(inPlace, actual))
+        {
+            printf("ERROR:  %s gain with clipping of %zu samples is wrong\n", k.m_name, count);
+            error_count++;
+        }
+
+        // Minimum and maximum, skipping NaN, with the extremes put in
+        // at each end in turn.
+        for (int pass = 0; pass < 2; pass++)
+        {
+            std::vector<float> values(withNaN);
+            if (count > 0)
+            {
+                values[pass ? count - 1 : 0] = -2.5f;
+                values[pass ? 0 : count - 1] = 2.5f;
+            }
+            float lowest = FLT_MAX, highest = -FLT_MAX;
+            k.MinMax(values.data(), count, lowest, highest);
+            float expectedLowest = count ? -2.5f : FLT_MAX;
+            float expectedHighest = count ? 2.5f : -FLT_MAX;
+            if (count == 1)
+                expectedLowest = expectedHighest = values[0];
+            if (lowest != expectedLowest || highest != expectedHighest)
+            {
+                printf("ERROR:  %s min/max of %zu samples gave %g to %g\n", k.m_name, count, lowest, highest);
+                error_count++;
+            }
+        }
+
+        // Mixing into existing samples.
+        std::vector<float> mix(count);
+        for (float &value : mix)
+            value = random_sample();
+        for (size_t i = 0; i < count; i++)
+            expected[i] = mix[i] + in[i] * 0.3f;
+        k.MixAdd(in, mix.data(), count, 0.3f);
+        if (!same_floats(expected, mix))
+        {
+            printf("ERROR:  %s mixing of %zu samples is wrong\n", k.m_name, count);
+            error_count++;
+        }
+
+        // FIR filter with a few lengths; it reads the samples before
+        // 'in', which the offset leaves room for.
+        static const float taps[4] = { 0.4f, -0.25f, 0.125f, 0.3f };
+        for (size_t numTaps = 1; numTaps <= 4; numTaps++)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                float sum = taps[0] * in[i];
+                for (size_t t = 1; t < numTaps; t++)
+                    sum += taps[t] * in[static_cast<ptrdiff_t>(i) - static_cast<ptrdiff_t>(t)];
+                expected[i] = sum;
+            }
+            k.FIR(in, actual.data(), count, taps, numTaps);
+            if (!same_floats(expected, actual))
+            {
+                printf("ERROR:  %s %zu-tap FIR filter of %zu samples is wrong\n", k.m_name, numTaps, count);
+                error_count++;
+            }
+        }
+
+        // Biquad filter, in two calls to check the history carries
+        // over, and in place.
+        const BiquadState initial = { 0.9f, -1.7f, 0.85f, -1.6f, 0.75f, 0.2f, -0.1f, 0.05f, 0.3f };
+        BiquadState reference = initial;
+        for (size_t i = 0; i < count; i++)
+        {
+            float x = in[i];
+            float y = reference.m_b0 * x + reference.m_b1 * reference.m_x1 + reference.m_b2 * reference.m_x2 -
+                reference.m_a1 * reference.m_y1 - reference.m_a2 * reference.m_y2;
+            reference.m_x2 = reference.m_x1;
+            reference.m_x1 = x;
+            reference.m_y2 = reference.m_y1;
+            reference.m_y1 = FlushDenormal(y);
+            expected[i] = y;
+        }
+        BiquadState state = initial;
+        size_t split = count / 3;
+        k.Biquad(state, in, actual.data(), split);
+        k.Biquad(state, in + split, actual.data() + split, count - split);
+        BiquadState inPlaceState = initial;
+        inPlace.assign(in, in + count);
+        k.Biquad(inPlaceState, inPlace.data(), inPlace.data(), count);
+        if (!same_floats(expected, actual) || !same_floats(expected, inPlace) ||
+            memcmp(&state, &reference, sizeof(state)) != 0 || memcmp(&inPlaceState, &reference, sizeof(state)) != 0)
+        {
+            printf("ERROR:  %s biquad filter of %zu samples is wrong\n", k.m_name, count);
+            error_count++;
+        }
+    }
+    return error_count;
+}
+
+// Run the kernel tests for each instruction set the processor
+// supports, and return true if successful.
+bool test_dsp_kernels()
+{
+    int error_count = 0;
+
+    printf("Starting DSP kernel tests (using %s).\n", DSPKernelsGet().m_name);
+
+    for (int isa = 0; isa < static_cast<int>(DSPInstructionSet::Count); isa++)
+    {
+        const DSPKernels *kernels = DSPKernelsGetFor(static_cast<DSPInstructionSet>(isa));
+        if (!kernels)
+            continue;
+        printf("Testing %s kernels.\n", kernels->m_name);
+        error_count += test_kernels(*kernels);
+    }
+
+    // Forcing an instruction set, then putting back the one in use.
+    const DSPKernels &active = DSPKernelsGet();
+    std::wstring activeName(active.m_name, active.m_name + strlen(active.m_name));
+    if (!DSPKernelsForceISA(L"SCALAR") || DSPKernelsGet().m_isa != DSPInstructionSet::Scalar)
+    {
+        printf("ERROR:  Forcing the scalar kernels failed\n");
+        error_count++;
+    }
+    if (DSPKernelsForceISA(L"mmx") || DSPKernelsGet().m_isa != DSPInstructionSet::Scalar)
+    {
+        printf("ERROR:  Forcing an unknown instruction set didn't fail\n");
+        error_count++;
+    }
+    if (!DSPKernelsForceISA(activeName.c_str()) || &DSPKernelsGet() != &active)
+    {
+        printf("ERROR:  Forcing the %s kernels failed\n", active.m_name);
+        error_count++;
+    }
+
+    if (error_count)
+    {
+        printf("Error count during DSP kernel tests:  %d\n", error_count);
+        return false;
+    }
+
+    printf("DSP kernel tests OK.\n");
+    return true;
+}
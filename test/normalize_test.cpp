@@ -44,6 +44,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <math.h>
 #include <vector>
 
 // From an attenuation level between 0 dB (loudest) and -infinity
@@ -101,6 +102,78 @@ static bool normalize_test_iter(size_t numSamples, size_t numChannels, float dbL
     return true;
 }
 
+// Checks the per-sample operations against simple loops, on a
+// waveform long enough that the operations split it into ranges
+// that run on several threads.
+static bool sample_ops_test(size_t numSamples, size_t numChannels)
+{
+    printf("Sample operations test numSamples = %zu, numChannels = %zu\n", numSamples, numChannels);
+
+    std::vector<float> original(numSamples * numChannels);
+    for (float &value : original)
+        value = static_cast<float>(rand() % 2000 - 1000) / 1000.0f;
+
+    // Put the highest and lowest values of channel 0 in two places
+    // each, so the earliest of each has to be the one found.
+    size_t highIndex = numSamples / 3;
+    size_t lowIndex = numSamples / 5;
+    original[highIndex * numChannels] = 2.0f;
+    original[(numSamples - 1) * numChannels] = 2.0f;
+    original[lowIndex * numChannels] = -2.0f;
+    original[(numSamples - 2) * numChannels] = -2.0f;
+
+    Waveform wav;
+    wav.SetRate(48000);
+    if (!wav.Populate(numSamples, numChannels, original.data()))
+    {
+        printf("Waveform::Populate failed.\n");
+        return false;
+    }
+
+    if (wav.FindHighestSample() != highIndex || wav.FindLowestSample() != lowIndex ||
+        wav.GetHighestSample() != 2.0f || wav.GetLowestSample() != -2.0f)
+    {
+        printf("Found highest %zu, lowest %zu; expected %zu, %zu\n",
+            wav.FindHighestSample(), wav.FindLowestSample(), highIndex, lowIndex);
+        return false;
+    }
+
+    wav.Multiply(0.5f);
+    wav.Add(0.25f);
+    wav.Clip(-0.5f, 0.5f);
+    for (size_t index = 0; index < original.size(); index++)
+    {
+        float expected = original[index] * 0.5f + 0.25f;
+        expected = (expected < -0.5f) ? -0.5f : (expected > 0.5f) ? 0.5f : expected;
+        if (wav.GetSamplesPtr()[index] != expected)
+        {
+            printf("Sample %zu is %f after Multiply, Add, and Clip; expected %f\n",
+                index, wav.GetSamplesPtr()[index], expected);
+            return false;
+        }
+    }
+
+    Waveform mono(wav);
+    if (!mono.ConvertToMono() || mono.GetNumSamples() != numSamples)
+    {
+        printf("Waveform::ConvertToMono failed.\n");
+        return false;
+    }
+    for (size_t index = 0; index < numSamples; index++)
+    {
+        float expected = 0.0f;
+        for (size_t channel = 0; channel < numChannels; channel++)
+            expected += wav.GetSample(index, channel) / numChannels;
+        if (mono.GetSample(index) != expected)
+        {
+            printf("Mono sample %zu is %f; expected %f\n", index, mono.GetSample(index), expected);
+            return false;
+        }
+    }
+
+    return true;
+}
+
 // Run the normalization tests and return true if successful.
 bool test_normalize()
 {
@@ -120,6 +193,12 @@ bool test_normalize()
             error_count++;
     }
 
+    for (size_t numChannels = 1; numChannels <= 3; numChannels++)
+    {
+        if (!sample_ops_test(300000 + rand() % 1000, numChannels))
+            error_count++;
+    }
+
     if (error_count)
     {
         printf("Error count during normalization tests:  %d\n", error_count);
@@ -0,0 +1,65 @@
+#!/bin/sh
+#
+# Runs the benchmarks 5 times and compares the results with the
+# baseline in perf_baseline*.json, failing if any benchmark has become
+# slower.  If there's no baseline yet, the results are saved as the
+# baseline.
+# This does the same as RunPerfGate.bat, for systems without CMD.
+#
+# The programs are looked for in ../x64/Release, or in the directory
+# given by the BINDIR environment variable.
+#
+
+BINDIR=${BINDIR:-../x64/Release}
+TLOG=perfgate.out
+RUNS="1 2 3 4 5"
+
+EXE=
+if [ -f "$BINDIR/bench.exe" ]; then
+    EXE=.exe
+fi
+TEXE="$BINDIR/bench$EXE"
+TCMP="$BINDIR/benchcompare$EXE"
+
+rm -f "$TLOG"
+for program in "$TEXE" "$TCMP"; do
+    if [ ! -x "$program" ]; then
+        echo "ERROR:  Program \"$program\" doesn't exist.  Has it been compiled yet?"
+        echo "ERROR:  Program \"$program\" doesn't exist.  Has it been compiled yet?" >> "$TLOG"
+        exit 1
+    fi
+done
+
+echo "Running benchmarks with \"$TEXE\" 5 times.  This takes a while..."
+echo "===================================" >> "$TLOG"
+TBASE=
+TCUR=
+for run in $RUNS; do
+    if ! "$TEXE" -Output=testout_bench$run.json >> "$TLOG"; then
+        echo "ERROR:  Benchmark failure.  See $TLOG for details."
+        exit 1
+    fi
+    echo "===================================" >> "$TLOG"
+    TBASE="$TBASE${TBASE:+,}perf_baseline$run.json"
+    TCUR="$TCUR${TCUR:+,}testout_bench$run.json"
+done
+
+if [ ! -f perf_baseline1.json ]; then
+    for run in $RUNS; do
+        cp testout_bench$run.json perf_baseline$run.json
+    done
+    echo "Saved the results as the baseline in perf_baseline*.json." >> "$TLOG"
+    echo "Saved the results as the baseline in perf_baseline*.json."
+    exit 0
+fi
+
+if ! "$TCMP" "$TBASE" "$TCUR" >> "$TLOG"; then
+    echo "ERROR:  Performance regression or benchmark failure." >> "$TLOG"
+    echo "ERROR:  Performance regression or benchmark failure.  See $TLOG for details."
+    exit 1
+fi
+echo "===================================" >> "$TLOG"
+
+echo "Done running benchmarks." >> "$TLOG"
+echo "Done running benchmarks.  See $TLOG for the comparison."
+exit 0
@@ -0,0 +1,191 @@
+//-------------------------------------------------------------------
+//
+// segmentedfilter_test.cpp
+// Unit tests for running the IIR filters in parallel segments.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+
+#include "lowpass.h"
+#include "highpass.h"
+#include "bandpassfilter.h"
+#include "notchfilter.h"
+#include "segmentedfilter.h"
+#include "denormals.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <vector>
+
+// Filters the same samples serially and in segments (in place, and
+// followed by more samples filtered serially, to check the filter is
+// left in the right state), and checks the results agree to within
+// 'maxError'.
+template <class Filter>
+static bool segment_test(const char *name, const Filter &prototype, const std::vector<float> &input, float maxError)
+{
+    Filter serial(prototype);
+    std::vector<float> expected(input.size());
+    for (size_t index = 0; index < input.size(); index++)
+        expected[index] = serial.FilterSample(input[index]);
+
+    Filter segmented(prototype);
+    std::vector<float> actual(input);
+    size_t numSegmented = input.size() * 3 / 4;
+    FilterSamplesInSegments(segmented, actual.data(), actual.data(), numSegmented, 8);
+    for (size_t index = numSegmented; index < input.size(); index++)
+        actual[index] = segmented.FilterSample(actual[index]);
+
+    float error = 0.0f;
+    for (size_t index = 0; index < input.size(); index++)
+        error = std::max(error, fabsf(actual[index] - expected[index]));
+
+    printf("Segmented %s filter, warm-up %zu samples, largest error %g\n",
+        name, prototype.GetSettlingSamples(kSegmentTolerance), error);
+    if (error > maxError)
+    {
+        printf("Segmented %s filter differs from serial by more than %g\n", name, maxError);
+        return false;
+    }
+    return true;
+}
+
+// Filters a burst of sound followed by a long silence with
+// denormals off, and checks that none of the output is denormal and
+// that the filter has settled by the end.  Rounding can keep a
+// resonant filter ringing forever, so it only has to settle to far
+// below anything audible, not to zero.
+template <class Filter>
+static bool silent_tail_test(const char *name, Filter filter)
+{
+    std::vector<float> samples(2000000, 0.0f);
+    for (size_t index = 0; index < 1000; index++)
+        samples[index] = 0.8f * sinf(static_cast<float>(index) * 0.05f);
+
+    ScopedDenormalsOff denormals;
+    filter.FilterSamples(samples.data(), samples.data(), samples.size());
+    for (size_t index = 0; index < samples.size(); index++)
+    {
+        if (fpclassify(samples[index]) == FP_SUBNORMAL)
+        {
+            printf("Silent tail of %s filter became denormal at sample %zu\n", name, index);
+            return false;
+        }
+    }
+    if (fabsf(samples.back()) > 1e-30f)
+    {
+        printf("Silent tail of %s filter ended at %g\n", name, samples.back());
+        return false;
+    }
+    return true;
+}
+
+// Checks that ScopedDenormalsOff flushes denormals to zero while it
+// exists, and only then, and that the filters' silent tails don't
+// become denormal.
+static bool denormals_test()
+{
+    int error_count = 0;
+
+#if DENORMALS_FLUSHED_BY_HARDWARE
+    volatile float tiny = FLT_MIN;
+    {
+        ScopedDenormalsOff denormals;
+        if (tiny * 0.5f != 0.0f)
+        {
+            printf("Denormal result wasn't flushed to zero\n");
+            error_count++;
+        }
+    }
+    if (tiny * 0.5f == 0.0f)
+    {
+        printf("Denormals stayed off after ScopedDenormalsOff was destroyed\n");
+        error_count++;
+    }
+#endif
+
+    if (!silent_tail_test("low pass", LowPassFilter(1000.0f, 44100.0f)) ||
+        !silent_tail_test("high pass", HighPassFilter(20.0f, 44100.0f)) ||
+        !silent_tail_test("bandpass", BandpassFilter(44100.0f, 100.0f, 2.0f)) ||
+        !silent_tail_test("notch", NotchFilter(44100.0f, 60.0f, 5.0f)))
+        error_count++;
+
+    return error_count == 0;
+}
+
+// Run the segmented filter tests and return true if successful.
+bool test_segmented_filters()
+{
+    int error_count = 0;
+
+    printf("Starting segmented filter tests.\n");
+
+    // A loud tone with noise on it, as two interleaved channels.
+    std::vector<float> input(2000000);
+    for (size_t index = 0; index < input.size(); index++)
+    {
+        float tone = 0.6f * sinf(static_cast<float>(index / 2) * 0.01f);
+        input[index] = tone + static_cast<float>(rand() % 2000 - 1000) / 2500.0f;
+    }
+
+    // The narrow and low-frequency bandpass and notch filters have
+    // much more rounding noise, serial or not (see segmentedfilter.h).
+    if (!segment_test("low pass", LowPassFilter(1000.0f, 44100.0f), input, 1e-6f) ||
+        !segment_test("low pass", LowPassFilter(40.0f, 44100.0f), input, 1e-6f))
+        error_count++;
+    if (!segment_test("high pass", HighPassFilter(5000.0f, 44100.0f), input, 1e-6f) ||
+        !segment_test("high pass", HighPassFilter(20.0f, 44100.0f), input, 1e-6f))
+        error_count++;
+    if (!segment_test("bandpass", BandpassFilter(44100.0f, 3000.0f, 10.0f), input, 1e-6f) ||
+        !segment_test("bandpass", BandpassFilter(44100.0f, 100.0f, 2.0f), input, 1e-3f))
+        error_count++;
+    if (!segment_test("notch", NotchFilter(44100.0f, 1000.0f, 30.0f), input, 1e-4f) ||
+        !segment_test("notch", NotchFilter(44100.0f, 60.0f, 5.0f), input, 1e-3f))
+        error_count++;
+    if (!denormals_test())
+        error_count++;
+
+    if (error_count)
+    {
+        printf("Error count during segmented filter tests:  %d\n", error_count);
+        return false;
+    }
+
+    printf("Segmented filter tests OK.\n");
+    return true;
+}
@@ -42,6 +42,8 @@
 //--------------------------------------------------------------------
 
 #include "waveform.h"
+#include "dspkernels.h"
+#include "platform.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -51,7 +53,18 @@
 // them from the testing code below.
 extern bool test_wavfile_read_write(wchar_t *filename);
 extern bool test_waveform_load(wchar_t *filename);
+extern bool test_waveform_read_info(wchar_t *filename);
+extern bool test_waveform_mp3_segments(wchar_t *filename);
+extern bool test_waveform_load_range(wchar_t *filename);
+extern bool test_waveform_raw_format(wchar_t *filename);
+extern bool test_waveform_progress(wchar_t *filename);
 extern bool test_normalize();
+extern bool test_waveform_save();
+extern bool test_waveform_graph();
+extern bool test_waveform_batch();
+extern bool test_segmented_filters();
+extern bool test_waveform_profile();
+extern bool test_dsp_kernels();
 
 static bool process_audio_file(wchar_t *filename)
 {
@@ -74,6 +87,39 @@ static bool process_audio_file(wchar_t *filename)
         ++error_count;
     }
 
+    if (wcsstr(filename, L".mp3") != nullptr || wcsstr(filename, L".MP3") != nullptr)
+    {
+        if (!test_waveform_mp3_segments(filename))
+        {
+            printf("ERROR:  Failed segmented decode of MP3 file '%S'\n", filename);
+            ++error_count;
+        }
+    }
+
+    if (!test_waveform_read_info(filename))
+    {
+        printf("ERROR:  Failed reading file info of '%S'.\n", filename);
+        ++error_count;
+    }
+
+    if (!test_waveform_load_range(filename))
+    {
+        printf("ERROR:  Failed loading ranges of '%S'.\n", filename);
+        ++error_count;
+    }
+
+    if (!test_waveform_raw_format(filename))
+    {
+        printf("ERROR:  Failed raw PCM format test with '%S'.\n", filename);
+        ++error_count;
+    }
+
+    if (!test_waveform_progress(filename))
+    {
+        printf("ERROR:  Failed progress test with '%S'.\n", filename);
+        ++error_count;
+    }
+
     // TODO: Perform additional tests on the file.
 
     printf("Done testing with '%S', error count: %u\n", filename, error_count);
@@ -86,22 +132,54 @@ int wmain(int argc, wchar_t **argv)
     // Make sure the user gave us at least one filename.
     if (argc < 2)
     {
-        printf("Usage:  unittest file1.wav [file2.wav ...]\n");
+        printf("Usage:  unittest [-ForceISA=x] file1.wav [file2.wav ...]\n");
         return EXIT_FAILURE;
     }
 
+    // Run everything with the kernels for the given instruction set,
+    // or report the test as skipped if the processor doesn't have it.
+    for (int iarg = 1; iarg < argc; iarg++)
+    {
+        if (_wcsnicmp(argv[iarg], L"-ForceISA=", 10) == 0 && !DSPKernelsForceISA(argv[iarg] + 10))
+        {
+            printf("Skipped:  this processor doesn't support '%S'.\n", argv[iarg] + 10);
+            return 77;
+        }
+    }
+
     unsigned error_count = 0;
     try
     {
         // Run tests.
         for (int iarg = 1; iarg < argc; iarg++)
         {
+            if (argv[iarg][0] == '-')
+                continue;
             if (!process_audio_file(argv[iarg]))
                 ++error_count;
         }
 
         if (!test_normalize())
             ++error_count;
+
+        if (!test_waveform_save())
+            ++error_count;
+
+        if (!test_waveform_graph())
+            ++error_count;
+
+        if (!test_waveform_batch())
+            ++error_count;
+
+        if (!test_segmented_filters())
+            ++error_count;
+
+        if (!test_dsp_kernels())
+            ++error_count;
+
+        // This one turns profiling on, so it runs last.
+        if (!test_waveform_profile())
+            ++error_count;
     }
     catch(...)
     {
@@ -0,0 +1,293 @@
+//-------------------------------------------------------------------
+//
+// waveformbatch_test.cpp
+// Unit tests for running operations over batches of audio files.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+
+#include "waveform.h"
+#include "waveformsave.h"
+#include "waveformbatch.h"
+#include "platform.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Checks the output names made from a few templates.
+static bool output_name_test()
+{
+    struct Case
+    {
+        const wchar_t *m_template;
+        const wchar_t *m_input;
+        const wchar_t *m_expected;
+    };
+    static const Case cases[] =
+    {
+        { L"{dir}{name}_eq.wav",    L"in\\song.flac",       L"in\\song_eq.wav" },
+        { L"out\\{name}.{ext}",     L"in\\song.flac",       L"out\\song.flac" },
+        { L"{name}-{name}.mp3",     L"c:song.wav",          L"song-song.mp3" },
+        { L"{dir}{name}.wav",       L"song",                L"song.wav" },
+        { L"{dir}x_{name}.{ext}",   L"a.b/c.d/song.raw",    L"a.b/c.d/x_song.raw" },
+        { L"out/",                  L"in/song.flac",        L"out/song.flac" },
+    };
+
+    for (const Case &test : cases)
+    {
+        std::wstring output = WaveformBatchOutputName(test.m_template, test.m_input);
+        if (output != test.m_expected)
+        {
+            printf("Template '%S' with '%S' gave '%S'; expected '%S'\n",
+                test.m_template, test.m_input, output.c_str(), test.m_expected);
+            return false;
+        }
+    }
+
+    // A directory without a separator gets the system's own.
+    std::wstring output = WaveformBatchOutputName(L"out", L"in\\song.flac");
+    if (output != std::wstring(L"out") + kPathSeparator + L"song.flac")
+    {
+        printf("Template 'out' gave '%S'\n", output.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Writes a short WAV file for the batch tests.
+static bool write_test_file(const wchar_t *filename, size_t numSamples)
+{
+    Waveform wav;
+    if (!wav.Populate(numSamples, 1))
+        return false;
+    return WaveformSaveToFile(filename, wav);
+}
+
+// Checks that wildcards and file lists expand to the right files,
+// and that a batch over them keeps to its memory budget.
+static bool expand_test()
+{
+    static const wchar_t *const filenames[] =
+    {
+        L"testout_batch_1.wav", L"testout_batch_2.wav", L"testout_batch_3.wav"
+    };
+    const wchar_t *listFilename = L"testout_batch.lst";
+
+    bool ok = true;
+    for (size_t i = 0; i < _countof(filenames); i++)
+    {
+        if (!write_test_file(filenames[i], 1000 * (i + 1)))
+        {
+            printf("Failed saving '%S'\n", filenames[i]);
+            ok = false;
+        }
+    }
+
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, listFilename, L"wt") == 0 && fp)
+    {
+        fprintf(fp, "# Batch test list\n\n  testout_batch_2.wav  \ntestout_batch_*.wav\n");
+        fclose(fp);
+    }
+    else
+    {
+        printf("Failed saving '%S'\n", listFilename);
+        ok = false;
+    }
+
+    std::vector<std::wstring> expanded;
+    if (ok && !WaveformBatchExpandInputs(std::vector<std::wstring>(1, L"testout_batch_*.wav"), expanded))
+    {
+        printf("Failed expanding wildcard\n");
+        ok = false;
+    }
+    if (ok && (expanded.size() != 3 || expanded[0] != filenames[0] ||
+               expanded[1] != filenames[1] || expanded[2] != filenames[2]))
+    {
+        printf("Wildcard gave %zu file(s); expected the 3 test files in order\n", expanded.size());
+        ok = false;
+    }
+
+    expanded.clear();
+    if (ok && !WaveformBatchExpandInputs(std::vector<std::wstring>(1, L"@testout_batch.lst"), expanded))
+    {
+        printf("Failed expanding file list\n");
+        ok = false;
+    }
+    if (ok && (expanded.size() != 4 || expanded[0] != filenames[1] || expanded[3] != filenames[2]))
+    {
+        printf("File list gave %zu file(s); expected 4\n", expanded.size());
+        ok = false;
+    }
+
+    // Standard input and a wildcard that matches nothing are errors.
+    std::vector<std::wstring> bad;
+    if (ok && (WaveformBatchExpandInputs(std::vector<std::wstring>(1, L"-"), bad) ||
+               WaveformBatchExpandInputs(std::vector<std::wstring>(1, L"testout_nomatch_*.wav"), bad)))
+    {
+        printf("Expanding bad inputs didn't fail\n");
+        ok = false;
+    }
+
+    // With a budget smaller than any file, only one file may be
+    // processed at a time, however many threads there are.
+    if (ok)
+    {
+        WaveformBatch batch;
+        batch.SetThreadCount(3);
+        batch.SetMemoryBudget(1);
+        for (const wchar_t *filename : filenames)
+            batch.AddFile(filename, nullptr);
+
+        std::atomic<int> running(0);
+        std::atomic<int> mostRunning(0);
+        bool result = batch.Run([&](const wchar_t *, const wchar_t *) {
+            int now = ++running;
+            if (now > mostRunning)
+                mostRunning = now;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            --running;
+            return true;
+        });
+
+        if (!result || mostRunning != 1)
+        {
+            printf("Batch with a memory budget ran %d file(s) at once\n", mostRunning.load());
+            ok = false;
+        }
+
+        // The largest file is estimated at twice its size in floats.
+        if (batch.GetFiles()[2].m_memoryNeeded != 3000 * sizeof(float) * 2)
+        {
+            printf("Memory estimate is %zu bytes\n", batch.GetFiles()[2].m_memoryNeeded);
+            ok = false;
+        }
+    }
+
+    for (const wchar_t *filename : filenames)
+        _wremove(filename);
+    _wremove(listFilename);
+    return ok;
+}
+
+// Runs a batch in which some files fail, and checks that every file
+// is processed exactly once and that the failures are recorded.
+static bool run_test()
+{
+    const size_t numFiles = 40;
+    std::vector<std::wstring> inputs;
+    for (size_t i = 0; i < numFiles; i++)
+        inputs.push_back(L"in\\file" + std::to_wstring(i) + L".wav");
+
+    WaveformBatch batch;
+    batch.SetThreadCount(4);
+    batch.AddFiles(inputs, L"out\\{name}.flac");
+    batch.AddFile(L"in\\other\\file3.wav", L"OUT\\File3.flac");
+    batch.AddFile(L"in\\same.wav", L"in\\same.wav");
+
+    std::vector<std::atomic<int>> calls(numFiles);
+    for (auto &count : calls)
+        count = 0;
+    bool result = batch.Run([&](const wchar_t *inFilename, const wchar_t *outFilename) {
+        size_t index = static_cast<size_t>(_wtoi(inFilename + 7));
+        if (index >= numFiles || wcsncmp(outFilename, L"out\\file", 8) != 0)
+            return false;
+        calls[index]++;
+        if (index % 10 == 9)
+            throw std::runtime_error("test");
+        return index % 10 != 7;
+    });
+
+    if (result)
+    {
+        printf("Batch with failures returned true\n");
+        return false;
+    }
+
+    const std::vector<WaveformBatch::File> &files = batch.GetFiles();
+    for (size_t i = 0; i < numFiles; i++)
+    {
+        WaveformBatch::Status expected = (i % 10 == 9) ? WaveformBatch::Status::Exception :
+            (i % 10 == 7) ? WaveformBatch::Status::Failed : WaveformBatch::Status::Succeeded;
+        if (calls[i] != 1 || files[i].m_status != expected)
+        {
+            printf("File %zu was processed %d time(s), and %s\n",
+                i, calls[i].load(), WaveformBatch::GetStatusText(files[i].m_status));
+            return false;
+        }
+    }
+
+    if (files[numFiles].m_status != WaveformBatch::Status::DuplicateOutput ||
+        files[numFiles + 1].m_status != WaveformBatch::Status::SameAsInput ||
+        batch.GetErrorCount() != numFiles / 10 * 2 + 2)
+    {
+        printf("Batch didn't catch conflicting output names\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Run the batch tests and return true if successful.
+bool test_waveform_batch()
+{
+    int error_count = 0;
+
+    printf("Starting waveform batch tests.\n");
+
+    if (!output_name_test())
+        error_count++;
+    if (!expand_test())
+        error_count++;
+    if (!run_test())
+        error_count++;
+
+    if (error_count)
+    {
+        printf("Error count during waveform batch tests:  %d\n", error_count);
+        return false;
+    }
+
+    printf("Waveform batch tests OK.\n");
+    return true;
+}
@@ -0,0 +1,447 @@
+//-------------------------------------------------------------------
+//
+// waveformgraph_test.cpp
+//
+// Tests of block processing with WaveformGraph:  fan-out and
+// fan-in, latency compensation, and streaming files through the
+// graph a chunk at a time.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#include "waveform.h"
+#include "waveformload.h"
+#include "waveformsave.h"
+#include "waveformgraph.h"
+#include "waveformprocessors.h"
+#include <math.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// A processor that delays its input by a fixed number of frames,
+// and reports that as its latency, to test the graph's latency
+// compensation.
+class DelayTestProcessor : public WaveformProcessor
+{
+public:
+    explicit DelayTestProcessor(size_t delay) : m_delay(delay) {}
+
+    bool Configure(const WaveformFormat *inputFormats, size_t numInputs, WaveformFormat &outputFormat) override
+    {
+        if (numInputs != 1)
+            return false;
+        outputFormat = inputFormats[0];
+        m_channels = outputFormat.m_numChannels;
+        m_pending.assign(m_delay * m_channels, 0.0f);
+        return true;
+    }
+
+    bool Process(const WaveformBlock *const *inputs, size_t, WaveformBlock &output) override
+    {
+        // Put out as many of the frames held back as there's room for,
+        // which is a full block unless the input has ended.
+        const WaveformBlock &input = *inputs[0];
+        m_pending.insert(m_pending.end(), input.GetSamplesPtr(),
+            input.GetSamplesPtr() + input.GetNumFrames() * m_channels);
+        size_t numFrames = m_pending.size() / m_channels;
+        if (numFrames > output.GetMaxFrames())
+            numFrames = output.GetMaxFrames();
+        if (input.GetNumFrames() == output.GetMaxFrames() && numFrames > input.GetNumFrames())
+            numFrames = input.GetNumFrames();
+
+        memcpy(output.GetSamplesPtr(), m_pending.data(), numFrames * m_channels * sizeof(float));
+        m_pending.erase(m_pending.begin(), m_pending.begin() + numFrames * m_channels);
+        output.SetNumFrames(numFrames);
+        return true;
+    }
+
+    size_t GetLatency() const override { return m_delay; }
+
+private:
+    size_t m_delay;
+    size_t m_channels = 1;
+    std::vector<float> m_pending;
+};
+
+// A source that fails after a few blocks of silence, to test how
+// errors are passed along.
+class FailingTestSource : public WaveformSource
+{
+public:
+    bool Open(WaveformFormat &format) override
+    {
+        format.m_rate = 8000;
+        format.m_numChannels = 1;
+        format.m_numSamples = 100000;
+        m_count = 0;
+        return true;
+    }
+
+    bool Read(WaveformBlock &block) override
+    {
+        block.Silence();
+        block.SetNumFrames(block.GetMaxFrames());
+        return ++m_count < 5;
+    }
+
+private:
+    int m_count = 0;
+};
+
+// A sink that gives up after a few blocks.
+class FailingTestSink : public WaveformSink
+{
+public:
+    bool Consume(const WaveformFormat &, WaveformPuller &input) override
+    {
+        for (int iblock = 0; iblock < 3; iblock++)
+        {
+            if (!input.Pull())
+                return false;
+        }
+        return false;
+    }
+};
+
+// Fills a waveform with a few tones.
+static void make_test_waveform(Waveform &wav, unsigned rate, size_t numSamples, size_t numChannels)
+{
+    wav.SetRate(rate);
+    wav.Populate(numSamples, numChannels);
+    float *sample = wav.GetSamplesPtr();
+    for (size_t index = 0; index < numSamples; index++)
+    {
+        for (size_t channel = 0; channel < numChannels; channel++)
+        {
+            float t = static_cast<float>(index) / static_cast<float>(rate);
+            *sample++ = 0.6f * sinf(t * 440.0f * (channel + 1) * 6.2831853f);
+        }
+    }
+}
+
+// Returns true if two waveforms have the same format and samples.
+static bool same_waveform(const Waveform &wav1, const Waveform &wav2, float tolerance = 0.0f)
+{
+    if (wav1.GetRate() != wav2.GetRate() ||
+        wav1.GetNumChannels() != wav2.GetNumChannels() ||
+        wav1.GetNumSamples() != wav2.GetNumSamples())
+    {
+        printf("Waveform formats differ:  %u/%u Hz, %zu/%zu channels, %zu/%zu samples\n",
+            wav1.GetRate(), wav2.GetRate(), wav1.GetNumChannels(), wav2.GetNumChannels(),
+            wav1.GetNumSamples(), wav2.GetNumSamples());
+        return false;
+    }
+
+    size_t count = wav1.GetNumSamples() * wav1.GetNumChannels();
+    for (size_t index = 0; index < count; index++)
+    {
+        if (fabsf(wav1.GetSamplesPtr()[index] - wav2.GetSamplesPtr()[index]) > tolerance)
+        {
+            printf("Waveforms differ at sample %zu:  %f vs %f\n", index,
+                wav1.GetSamplesPtr()[index], wav2.GetSamplesPtr()[index]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Runs a waveform through a single processor.
+static bool run_processor(const Waveform &wavIn, WaveformProcessor &processor, Waveform &wavOut, size_t blockFrames)
+{
+    WaveformGraph graph(blockFrames);
+    WaveformMemorySource source(wavIn);
+    WaveformMemorySink sink(wavOut);
+    size_t node = graph.AddProcessor(processor, graph.AddSource(source));
+    return graph.Run(node, sink);
+}
+
+// Checks that a processor gives the same result no matter how the
+// audio is divided into blocks.
+static bool block_size_test()
+{
+    printf("Graph block size test\n");
+
+    Waveform wav;
+    make_test_waveform(wav, 22050, 30000, 2);
+
+    Waveform whole, pieces;
+    EchoProcessor echo1(50.0f, 3, 0.6f, 0.8f), echo2(50.0f, 3, 0.6f, 0.8f);
+    if (!run_processor(wav, echo1, whole, 65536) ||
+        !run_processor(wav, echo2, pieces, 777))
+    {
+        printf("Failed running echo processor.\n");
+        return false;
+    }
+    return same_waveform(whole, pieces) && same_waveform(whole, wav, 2.0f);
+}
+
+// Checks fan-out and fan-in:  the source feeds both a dry path and
+// an echo "send", which are mixed back together.
+static bool fan_out_in_test()
+{
+    printf("Graph fan-out and fan-in test\n");
+
+    Waveform wav;
+    make_test_waveform(wav, 44100, 50000, 1);
+
+    WaveformGraph graph(1000);
+    WaveformMemorySource source(wav);
+    EchoProcessor echo(20.0f, 2);
+    VolumeProcessor volume(0.5f);
+    MixProcessor mix(std::vector<float>{ 1.0f, 0.25f });
+    size_t src = graph.AddSource(source);
+    size_t send = graph.AddProcessor(echo, src);
+    size_t dry = graph.AddProcessor(volume, src);
+    size_t out = graph.AddProcessor(mix, std::vector<size_t>{ dry, send });
+
+    Waveform mixed;
+    WaveformMemorySink sink(mixed);
+    if (!graph.Run(out, sink))
+    {
+        printf("Failed running graph.\n");
+        return false;
+    }
+
+    // Build the expected result one processor at a time.
+    Waveform echoed, quieter;
+    EchoProcessor echo2(20.0f, 2);
+    VolumeProcessor volume2(0.5f);
+    if (!run_processor(wav, echo2, echoed, 4096) ||
+        !run_processor(wav, volume2, quieter, 4096))
+    {
+        printf("Failed running processors.\n");
+        return false;
+    }
+    float *sample = quieter.GetSamplesPtr();
+    for (size_t index = 0; index < quieter.GetNumSamples(); index++)
+        sample[index] = Waveform::ClipValue(sample[index] + echoed.GetSamplesPtr()[index] * 0.25f);
+
+    return same_waveform(mixed, quieter);
+}
+
+// Checks that the latency of a path is reported and made up for,
+// and that a mix of inputs with different lengths, channel counts,
+// and start times comes out right.
+static bool latency_and_offset_test()
+{
+    printf("Graph latency and offset test\n");
+
+    Waveform wav1, wav2;
+    make_test_waveform(wav1, 8000, 9000, 2);
+    make_test_waveform(wav2, 8000, 4000, 1);
+
+    WaveformGraph graph(512);
+    WaveformMemorySource source1(wav1), source2(wav2);
+    WaveformOffsetSource offset2(source2, 0.5f);
+    DelayTestProcessor delay1(700), delay2(300), delay3(1234);
+    MixProcessor mix(std::vector<float>{ 0.5f, 0.5f });
+    size_t path1 = graph.AddProcessor(delay1, graph.AddSource(source1));
+    size_t path2 = graph.AddProcessor(delay2, graph.AddSource(offset2));
+    size_t out = graph.AddProcessor(delay3, graph.AddProcessor(mix, std::vector<size_t>{ path1, path2 }));
+    if (!graph.Prepare() || graph.GetLatency(out) != 700 + 1234)
+    {
+        printf("Wrong latency reported.\n");
+        return false;
+    }
+
+    // The delays aren't lined up with each other, so compare against
+    // a mix with the same misalignment:  the second input 400 frames
+    // early.
+    Waveform mixed;
+    WaveformMemorySink sink(mixed);
+    if (!graph.Run(out, sink))
+    {
+        printf("Failed running graph.\n");
+        return false;
+    }
+
+    size_t offset = offset2.GetOffset();
+    size_t length = offset + wav2.GetNumSamples();
+    if (offset != 4000 || mixed.GetNumSamples() != (length > 9000 ? length : 9000) || mixed.GetNumChannels() != 2)
+    {
+        printf("Wrong offset %zu or mix length %zu.\n", offset, mixed.GetNumSamples());
+        return false;
+    }
+
+    Waveform expected;
+    expected.SetRate(8000);
+    expected.Populate(mixed.GetNumSamples(), 2);
+    for (size_t index = 0; index < expected.GetNumSamples(); index++)
+    {
+        size_t index2 = index + 400 - offset;
+        for (size_t channel = 0; channel < 2; channel++)
+        {
+            float value = wav1.GetSample(index, channel) * 0.5f;
+            if (index + 400 >= offset && index2 < wav2.GetNumSamples())
+                value += wav2.GetSample(index2, 0) * 0.5f;
+            expected.SetSample(index, channel, Waveform::ClipValue(value));
+        }
+    }
+    return same_waveform(mixed, expected);
+}
+
+// Streams a file through the graph, a chunk at a time, and checks
+// the result against the file loaded whole, and that the speaker
+// positions of its channels come through.
+static bool file_stream_test()
+{
+    printf("Graph file streaming test\n");
+
+    const wchar_t *inFilename = L"testout_graphin.wav";
+    const wchar_t *outFilename = L"testout_graphout.wav";
+    Waveform wav;
+    make_test_waveform(wav, 48000, WaveformFileSource::kChunkFrames + 12345, 2);
+    wav.SetChannelMask(0x3);
+    if (!WaveformSaveToFile(inFilename, wav, nullptr, nullptr, true, 4))
+    {
+        printf("Failed saving '%S'.\n", inFilename);
+        return false;
+    }
+
+    WaveformGraph graph;
+    WaveformFileSource source(inFilename);
+    VolumeProcessor volume(1.5f);
+    WaveformFileSink sink(outFilename, true, 4);
+    if (!graph.Run(graph.AddProcessor(volume, graph.AddSource(source)), sink))
+    {
+        printf("Failed streaming '%S' to '%S'.\n", inFilename, outFilename);
+        return false;
+    }
+
+    Waveform streamed, expected;
+    VolumeProcessor volume2(1.5f);
+    if (!WaveformLoadFromFile(outFilename, streamed) ||
+        !run_processor(wav, volume2, expected, 4096))
+    {
+        printf("Failed loading '%S'.\n", outFilename);
+        return false;
+    }
+    if (streamed.GetChannelMask() != 0x3)
+    {
+        printf("Streamed channel mask is 0x%X; expected 0x3\n", streamed.GetChannelMask());
+        return false;
+    }
+    return same_waveform(streamed, expected);
+}
+
+// Checks that a pipelined run, with the sources and the sink on
+// threads of their own, gives the same result as an ordinary run,
+// and that a failure on any thread ends the run.
+static bool pipeline_test()
+{
+    printf("Graph pipeline test\n");
+
+    Waveform wav1, wav2;
+    make_test_waveform(wav1, 16000, 50000, 2);
+    make_test_waveform(wav2, 16000, 30000, 1);
+
+    Waveform results[2];
+    for (size_t irun = 0; irun < 2; irun++)
+    {
+        WaveformGraph graph(300);
+        graph.SetPipelineDepth(irun ? 2 : 0);
+        WaveformMemorySource source1(wav1), source2(wav2);
+        WaveformOffsetSource offset2(source2, 0.75f);
+        DelayTestProcessor delay(333);
+        EchoProcessor echo(30.0f, 2);
+        MixProcessor mix(std::vector<float>{ 0.5f, 0.5f });
+        size_t path1 = graph.AddProcessor(delay, graph.AddSource(source1));
+        size_t path2 = graph.AddProcessor(echo, graph.AddSource(offset2));
+        size_t out = graph.AddProcessor(mix, std::vector<size_t>{ path1, path2 });
+
+        WaveformMemorySink sink(results[irun]);
+        if (!graph.Run(out, sink))
+        {
+            printf("Failed running graph.\n");
+            return false;
+        }
+    }
+    if (!same_waveform(results[0], results[1]))
+        return false;
+
+    WaveformGraph graph1(256);
+    graph1.SetPipelineDepth(2);
+    FailingTestSource failingSource;
+    Waveform wav;
+    WaveformMemorySink sink(wav);
+    if (graph1.Run(graph1.AddSource(failingSource), sink))
+    {
+        printf("Failing source wasn't caught.\n");
+        return false;
+    }
+
+    WaveformGraph graph2(256);
+    graph2.SetPipelineDepth(2);
+    WaveformMemorySource source(wav1);
+    VolumeProcessor volume(0.5f);
+    FailingTestSink failingSink;
+    if (graph2.Run(graph2.AddProcessor(volume, graph2.AddSource(source)), failingSink))
+    {
+        printf("Failing sink wasn't caught.\n");
+        return false;
+    }
+    return true;
+}
+
+bool test_waveform_graph()
+{
+    int error_count = 0;
+
+    printf("Starting waveform graph tests.\n");
+
+    if (!block_size_test())
+        error_count++;
+    if (!fan_out_in_test())
+        error_count++;
+    if (!latency_and_offset_test())
+        error_count++;
+    if (!file_stream_test())
+        error_count++;
+    if (!pipeline_test())
+        error_count++;
+
+    if (error_count)
+    {
+        printf("Error count during waveform graph tests:  %d\n", error_count);
+        return false;
+    }
+
+    printf("Waveform graph tests OK.\n");
+    return true;
+}
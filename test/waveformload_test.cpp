@@ -44,10 +44,19 @@
 
 #include "waveform.h"
 #include "waveformload.h"
+#include "waveformsave.h"
+#include "platform.h"
+#include "mp3file.h"
+#include <math.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <string>
 #include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
 
 bool test_waveform_load(wchar_t *filename)
 {
@@ -76,3 +85,409 @@ bool test_waveform_load(wchar_t *filename)
     return true;
 }
 
+
+// Decodes an MP3 file serially and in parallel with short segments,
+// so there are many segment boundaries whatever the number of
+// threads, and checks that the warm-up frames before each segment
+// make the samples the same, bit for bit.
+bool test_waveform_mp3_segments(wchar_t *filename)
+{
+    printf("Starting MP3 segmented decode test with '%S'\n", filename);
+    fflush(stdout);
+
+    Waveform serial;
+    WaveformSetMP3Decode(true, 0);
+    bool ok = WaveformLoadFromFile(filename, serial);
+    for (size_t segmentFrames : { 128, 37 })
+    {
+        Waveform segmented;
+        WaveformSetMP3Decode(false, segmentFrames);
+        if (!ok || !WaveformLoadFromFile(filename, segmented))
+        {
+            printf("Failed loading '%S'\n", filename);
+            ok = false;
+            break;
+        }
+
+        if (segmented.GetNumSamples() != serial.GetNumSamples() ||
+            segmented.GetNumChannels() != serial.GetNumChannels() ||
+            memcmp(segmented.GetSamplesPtr(), serial.GetSamplesPtr(),
+                   serial.GetNumSamples() * serial.GetNumChannels() * sizeof(float)) != 0)
+        {
+            printf("Decoding '%S' in segments of %zu frames doesn't match a serial decode\n",
+                filename, segmentFrames);
+            ok = false;
+            break;
+        }
+    }
+    WaveformSetMP3Decode(false, 0);
+
+    if (ok)
+        printf("Segmented decode of '%S' matches a serial decode.\n", filename);
+    return ok;
+}
+
+bool test_waveform_read_info(wchar_t *filename)
+{
+    printf("Starting file info test with '%S'\n", filename);
+    fflush(stdout);
+
+    // Read the header information and statistics.
+    WaveformFileInfo info;
+    if (!WaveformReadFileInfo(filename, info, true))
+    {
+        printf("WaveformReadFileInfo failed reading '%S'\n", filename);
+        return false;
+    }
+
+    // Load the whole file for comparison.
+    Waveform wav;
+    if (!WaveformLoadFromFile(filename, wav))
+    {
+        printf("Failed loading '%S'\n", filename);
+        return false;
+    }
+
+    // The information from the headers should describe the
+    // same audio that loading the file produces.
+    if (info.m_rate != wav.GetRate() ||
+        info.m_numChannels != wav.GetNumChannels() ||
+        info.m_numSamples != wav.GetNumSamples())
+    {
+        printf("File info doesn't match loaded waveform!\n");
+        printf("  Info:    rate=%u channels=%zu samples=%zu\n",
+            info.m_rate, info.m_numChannels, info.m_numSamples);
+        printf("  Loaded:  rate=%u channels=%zu samples=%zu\n",
+            wav.GetRate(), wav.GetNumChannels(), wav.GetNumSamples());
+        return false;
+    }
+
+    if (!info.m_hasStats ||
+        info.m_highestSample != wav.GetHighestSample() ||
+        info.m_lowestSample != wav.GetLowestSample())
+    {
+        printf("File statistics don't match loaded waveform!\n");
+        printf("  Info:    lowest=%f highest=%f\n", info.m_lowestSample, info.m_highestSample);
+        printf("  Loaded:  lowest=%f highest=%f\n", wav.GetLowestSample(), wav.GetHighestSample());
+        return false;
+    }
+
+    printf("File info for '%S' matches loaded waveform.\n", filename);
+    return true;
+}
+
+
+// Loads the range of 'count' samples starting at 'start' from the
+// given file, and checks that it's identical to the same samples
+// of the whole waveform 'full'.
+static bool check_load_range(wchar_t *filename, const Waveform &full, size_t start, size_t count)
+{
+    Waveform part;
+    if (!WaveformLoadRange(filename, start, count, part))
+    {
+        printf("WaveformLoadRange failed for start=%zu count=%zu\n", start, count);
+        return false;
+    }
+
+    size_t expected = (count == 0 || start + count > full.GetNumSamples()) ? full.GetNumSamples() - start : count;
+    if (part.GetNumSamples() != expected ||
+        part.GetNumChannels() != full.GetNumChannels() ||
+        part.GetRate() != full.GetRate())
+    {
+        printf("Range start=%zu count=%zu has %zu samples, %zu channels at %u Hz; expected %zu\n",
+            start, count, part.GetNumSamples(), part.GetNumChannels(), part.GetRate(), expected);
+        return false;
+    }
+
+    const float *pfull = full.GetSamplesPtr() + start * full.GetNumChannels();
+    const float *ppart = part.GetSamplesPtr();
+    for (size_t i = 0; i < expected * full.GetNumChannels(); i++)
+    {
+        if (ppart[i] != pfull[i])
+        {
+            printf("Range start=%zu count=%zu differs at value %zu: %f vs %f\n",
+                start, count, i, ppart[i], pfull[i]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool test_waveform_load_range(wchar_t *filename)
+{
+    printf("Starting ranged load test with '%S'\n", filename);
+    fflush(stdout);
+
+    Waveform full;
+    if (!WaveformLoadFromFile(filename, full))
+    {
+        printf("Failed loading '%S'\n", filename);
+        return false;
+    }
+
+    size_t numSamples = full.GetNumSamples();
+    if (numSamples < 4)
+        return true;
+
+    // Try the start, the middle, the end, and a range that runs
+    // past the end.  The sidecar index cache is exercised on the
+    // second pass: the first load writes it and the second reads it.
+    bool ok = true;
+    for (int pass = 0; pass < 3 && ok; pass++)
+    {
+        WaveformSetIndexCache(pass > 0);
+        ok = check_load_range(filename, full, 0, numSamples / 4) &&
+             check_load_range(filename, full, numSamples / 2 + 777, numSamples / 8 + 1) &&
+             check_load_range(filename, full, numSamples - 3, 0) &&
+             check_load_range(filename, full, numSamples / 3, numSamples);
+    }
+    WaveformSetIndexCache(false);
+    _wremove((std::wstring(filename) + L".idx").c_str());
+
+    // Load the whole file in consecutive chunks, as a stream does.
+    // Without the sidecar, an MP3 file's frame headers should still
+    // only be scanned once for all of them.
+    uint64_t scans = MP3FileGetScanCount();
+    size_t chunk = numSamples / 20 + 1;
+    for (size_t start = 0; start < numSamples && ok; start += chunk)
+        ok = check_load_range(filename, full, start, chunk);
+    if (ok && MP3FileGetScanCount() - scans > 1)
+    {
+        printf("Loading in chunks scanned the file %llu times\n",
+            static_cast<unsigned long long>(MP3FileGetScanCount() - scans));
+        ok = false;
+    }
+
+    // The same chunks again with a WaveformRangeReader, which
+    // shouldn't go back to the file's index at all once it's open.
+    WaveformRangeReader reader;
+    if (ok && (!reader.Open(filename) ||
+               reader.GetNumSamples() != numSamples ||
+               reader.GetNumChannels() != full.GetNumChannels() ||
+               reader.GetRate() != full.GetRate()))
+    {
+        printf("WaveformRangeReader opened '%S' with the wrong format\n", filename);
+        ok = false;
+    }
+    scans = MP3FileGetScanCount();
+    for (size_t start = 0; start < numSamples && ok; start += chunk)
+    {
+        Waveform part;
+        if (!reader.Load(start, chunk, part) ||
+            part.GetNumSamples() != std::min(chunk, numSamples - start) ||
+            memcmp(part.GetSamplesPtr(), full.GetSamplesPtr() + start * full.GetNumChannels(),
+                   part.GetNumSamples() * part.GetNumChannels() * sizeof(float)) != 0)
+        {
+            printf("WaveformRangeReader chunk at %zu differs from the loaded waveform\n", start);
+            ok = false;
+        }
+    }
+    if (ok && MP3FileGetScanCount() != scans)
+    {
+        printf("WaveformRangeReader scanned the file again while loading\n");
+        ok = false;
+    }
+
+    // A range starting past the end should fail.
+    Waveform part;
+    if (ok && WaveformLoadRange(filename, numSamples, 1, part))
+    {
+        printf("WaveformLoadRange accepted a range past the end\n");
+        ok = false;
+    }
+
+    if (ok)
+        printf("Ranges of '%S' match the loaded waveform.\n", filename);
+    return ok;
+}
+
+// Saves the audio from the given file as raw PCM, and checks that
+// the .hdr file written with it describes the format well enough to
+// load it back, then that the same format is guessed from the audio
+// when there's no .hdr file.
+bool test_waveform_raw_format(wchar_t *filename)
+{
+    printf("Starting raw PCM format test with '%S'\n", filename);
+    fflush(stdout);
+
+    const wchar_t *rawname = L"testout_rawformat.raw";
+    const wchar_t *hdrname = L"testout_rawformat.raw.hdr";
+
+    Waveform wav;
+    if (!WaveformLoadFromFile(filename, wav) || !WaveformSaveToFile(rawname, wav))
+    {
+        printf("Failed saving '%S' as raw PCM\n", filename);
+        return false;
+    }
+
+    // Load it back with the .hdr file.
+    bool ok = true;
+    Waveform loaded;
+    if (!WaveformLoadFromFile(rawname, loaded) ||
+        loaded.GetRate() != wav.GetRate() ||
+        loaded.GetNumChannels() != wav.GetNumChannels() ||
+        loaded.GetNumSamples() != wav.GetNumSamples())
+    {
+        printf("Raw PCM file didn't load with the format in its .hdr file\n");
+        ok = false;
+    }
+    for (size_t i = 0; ok && i < wav.GetNumSamples() * wav.GetNumChannels(); i++)
+    {
+        if (fabsf(loaded.GetSamplesPtr()[i] - wav.GetSamplesPtr()[i]) > 1.0f / 32767.0f)
+        {
+            printf("Raw PCM sample %zu is %f; expected %f\n", i, loaded.GetSamplesPtr()[i], wav.GetSamplesPtr()[i]);
+            ok = false;
+        }
+    }
+
+    // The statistics, read a block at a time, should match the
+    // loaded audio.
+    WaveformFileInfo info;
+    if (ok && (!WaveformReadFileInfo(rawname, info, true) || !info.m_hasStats ||
+               info.m_highestSample != loaded.GetHighestSample() ||
+               info.m_lowestSample != loaded.GetLowestSample()))
+    {
+        printf("Raw PCM statistics %f to %f don't match the loaded %f to %f\n",
+            info.m_lowestSample, info.m_highestSample, loaded.GetLowestSample(), loaded.GetHighestSample());
+        ok = false;
+    }
+
+    // Without the .hdr file, the sample size and channel count
+    // should be guessed from the audio.
+    _wremove(hdrname);
+    WaveformSetRawAutoDetect(true);
+    if (ok && (!WaveformReadFileInfo(rawname, info) ||
+               info.m_numChannels != wav.GetNumChannels() ||
+               info.m_bitsPerSample != 16 || info.m_isFloat))
+    {
+        printf("Guessed %zu channel(s) of %u-bit samples; expected %zu of 16-bit\n",
+            info.m_numChannels, info.m_bitsPerSample, wav.GetNumChannels());
+        ok = false;
+    }
+    WaveformSetRawAutoDetect(false);
+    _wremove(rawname);
+
+    // Malformed -RawFormat values should be refused.
+    if (WaveformSetRawFormatFromString(L"44100") ||
+        WaveformSetRawFormatFromString(L"44100,2,5") ||
+        WaveformSetRawFormatFromString(L"44100,2,2,double") ||
+        WaveformSetRawFormatFromString(L"0,2,2"))
+    {
+        printf("WaveformSetRawFormatFromString accepted a bad format\n");
+        ok = false;
+    }
+
+    if (ok)
+        printf("Raw PCM format of '%S' round-trips OK.\n", filename);
+    return ok;
+}
+
+
+// Records the calls to a status callback.
+struct ProgressRecord
+{
+    std::vector<float> m_completions;
+    std::thread::id m_thread = std::this_thread::get_id();
+    bool m_otherThread = false;
+    size_t m_cancelAfter = SIZE_MAX;    // Returns false after this many calls.
+};
+
+// Status callback that records its calls in a ProgressRecord.
+static bool record_progress(void *context, float completion)
+{
+    ProgressRecord *record = reinterpret_cast<ProgressRecord *>(context);
+    record->m_completions.push_back(completion);
+    if (std::this_thread::get_id() != record->m_thread)
+        record->m_otherThread = true;
+    return record->m_completions.size() <= record->m_cancelAfter;
+}
+
+// Checks that the calls in a ProgressRecord came from the calling
+// thread, and went steadily from 0.0 to 1.0.
+static bool check_progress(const ProgressRecord &record, const char *operation)
+{
+    bool ok = !record.m_otherThread && !record.m_completions.empty() &&
+              record.m_completions.front() == 0.0f && record.m_completions.back() == 1.0f;
+    for (size_t i = 1; ok && i < record.m_completions.size(); i++)
+    {
+        if (record.m_completions[i] < record.m_completions[i - 1] || record.m_completions[i] > 1.0f)
+            ok = false;
+    }
+
+    if (!ok)
+    {
+        printf("Bad progress from %s (%zu calls%s):", operation,
+            record.m_completions.size(), record.m_otherThread ? ", some on another thread" : "");
+        for (float completion : record.m_completions)
+            printf(" %.3f", completion);
+        printf("\n");
+    }
+    return ok;
+}
+
+// Checks that loading and saving the given file report their
+// progress to the status callback, and stop when it says to.
+bool test_waveform_progress(wchar_t *filename)
+{
+    printf("Starting progress test with '%S'\n", filename);
+    fflush(stdout);
+
+    // WaveformProgress should only call the callback once
+    // kIntervalMs has passed, scaled into its part of the whole,
+    // and should remember being cancelled.
+    ProgressRecord direct;
+    direct.m_cancelAfter = 1;
+    WaveformProgress progress(&direct, record_progress, 0.5f, 1.0f);
+    bool ok = progress.Update(1, 2) && direct.m_completions.empty();
+    std::this_thread::sleep_for(std::chrono::milliseconds(WaveformProgress::kIntervalMs + 1));
+    ok = ok && progress.Update(1, 2) && direct.m_completions.size() == 1 && direct.m_completions[0] == 0.75f;
+    std::this_thread::sleep_for(std::chrono::milliseconds(WaveformProgress::kIntervalMs + 1));
+    ok = ok && !progress.Update(2, 2) && progress.IsCancelled();
+    ok = ok && !progress.Update(2, 2) && direct.m_completions.size() == 2;
+    if (!ok)
+        printf("WaveformProgress didn't throttle or cancel as expected\n");
+
+    // Loading should go steadily from start to finish on this thread.
+    ProgressRecord load;
+    Waveform wav;
+    if (!WaveformLoadFromFile(filename, wav, &load, record_progress) || !check_progress(load, "loading"))
+        return false;
+
+    // Saving as WAV and as raw PCM should too.
+    const wchar_t *outnames[] = { L"testout_progress.wav", L"testout_progress.raw" };
+    for (const wchar_t *outname : outnames)
+    {
+        ProgressRecord save;
+        if (!WaveformSaveToFile(outname, wav, &save, record_progress) || !check_progress(save, "saving"))
+            ok = false;
+    }
+
+    // A load or save that's cancelled should fail, leaving nothing
+    // loaded.
+    ProgressRecord cancelLoad;
+    cancelLoad.m_cancelAfter = 1;
+    Waveform cancelled;
+    if (WaveformLoadFromFile(filename, cancelled, &cancelLoad, record_progress) ||
+        cancelled.GetNumSamples() != 0)
+    {
+        printf("Cancelled load of '%S' didn't fail\n", filename);
+        ok = false;
+    }
+    for (const wchar_t *outname : outnames)
+    {
+        ProgressRecord cancelSave;
+        cancelSave.m_cancelAfter = 1;
+        if (WaveformSaveToFile(outname, wav, &cancelSave, record_progress))
+        {
+            printf("Cancelled save to '%S' didn't fail\n", outname);
+            ok = false;
+        }
+        _wremove(outname);
+    }
+    _wremove(L"testout_progress.raw.hdr");
+
+    if (ok)
+        printf("Progress of '%S' reported OK.\n", filename);
+    return ok;
+}
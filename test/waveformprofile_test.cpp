@@ -0,0 +1,264 @@
+//-------------------------------------------------------------------
+//
+// waveformprofile_test.cpp
+// Unit tests for the profiling timers.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+
+#include "waveform.h"
+#include "waveform.h"
+#include "waveformprofile.h"
+#include "threadpool.h"
+#include "platform.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+
+// Runs a few nested scopes, counting samples and bytes in them.
+static void run_scopes()
+{
+    for (int i = 0; i < 2; i++)
+    {
+        WaveformProfileScope outer("test outer", 100, 400);
+        WaveformProfileScope inner("test inner");
+        inner.AddCounts(10, 40);
+    }
+}
+
+// Returns the line of the JSON report that describes the named stage,
+// or an empty string if there isn't one.
+static std::string find_stage(const std::string &report, const char *name)
+{
+    std::string key = std::string("\"name\": \"") + name + "\"";
+    size_t start = report.find(key);
+    if (start == std::string::npos)
+        return std::string();
+    size_t end = report.find('\n', start);
+    return report.substr(start, end - start);
+}
+
+// Reads a whole text file into a string.  Returns true if successful.
+static bool read_report(const wchar_t *filename, std::string &report)
+{
+    FILE *fp = nullptr;
+    if (_wfopen_s(&fp, filename, L"rt") != 0 || fp == nullptr)
+    {
+        printf("Failed opening '%S'\n", filename);
+        return false;
+    }
+
+    report.clear();
+    char buffer[1024];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        report.append(buffer, length);
+    fclose(fp);
+    return true;
+}
+
+// Checks that the scopes run on two threads are added up together.
+static bool report_test()
+{
+    const wchar_t *jsonFilename = L"testout_profile.json";
+
+    WaveformProfileEnable(jsonFilename);
+    if (!WaveformProfileIsEnabled())
+    {
+        printf("Profiling didn't turn on\n");
+        return false;
+    }
+
+    run_scopes();
+    std::thread other(run_scopes);
+    other.join();
+    WaveformProfileReport();
+
+    std::string report;
+    if (!read_report(jsonFilename, report))
+        return false;
+
+    std::string outer = find_stage(report, "test outer");
+    std::string inner = find_stage(report, "test inner");
+    if (outer.empty() || inner.empty())
+    {
+        printf("Stages missing from the profile:\n%s\n", report.c_str());
+        return false;
+    }
+
+    if (outer.find("\"calls\": 4, \"threads\": 2,") == std::string::npos ||
+        outer.find("\"samples\": 400, \"bytes\": 1600,") == std::string::npos ||
+        inner.find("\"calls\": 4, \"threads\": 2,") == std::string::npos ||
+        inner.find("\"samples\": 40, \"bytes\": 160,") == std::string::npos)
+    {
+        printf("Wrong totals in the profile:\n%s\n%s\n", outer.c_str(), inner.c_str());
+        return false;
+    }
+
+    // The report clears the totals, so the next one starts over.
+    run_scopes();
+    WaveformProfileReport();
+    if (!read_report(jsonFilename, report))
+        return false;
+
+    if (find_stage(report, "test outer").find("\"calls\": 2, \"threads\": 1,") == std::string::npos)
+    {
+        printf("Profile totals weren't cleared:\n%s\n", report.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Checks that the memory of Waveform buffers is charged to the
+// stage that allocated it, and given back when they're freed.
+static bool memory_test()
+{
+    const wchar_t *jsonFilename = L"testout_memstats.json";
+    const size_t numSamples = 100000;
+
+    WaveformMemStatsEnable(jsonFilename);
+    size_t before = WaveformMemStatsGetCurrentBytes();
+    {
+        Waveform wav;
+        {
+            WaveformProfileScope scope("test buffers");
+            if (!wav.Populate(numSamples, 2))
+            {
+                printf("Failed allocating a waveform\n");
+                return false;
+            }
+        }
+
+        if (WaveformMemStatsGetCurrentBytes() != before + numSamples * 2 * sizeof(float) ||
+            WaveformMemStatsGetPeakBytes() < before + numSamples * 2 * sizeof(float))
+        {
+            printf("Waveform buffer wasn't counted (%zu bytes held, %zu at the peak)\n",
+                WaveformMemStatsGetCurrentBytes(), WaveformMemStatsGetPeakBytes());
+            return false;
+        }
+
+        if (wav.GetTotalBytes() != numSamples * 2 * sizeof(float))
+        {
+            printf("Waveform::GetTotalBytes returned %zu; expected %zu\n",
+                wav.GetTotalBytes(), numSamples * 2 * sizeof(float));
+            return false;
+        }
+    }
+
+    if (WaveformMemStatsGetCurrentBytes() != before)
+    {
+        printf("Freed waveform buffer is still counted (%zu bytes held)\n", WaveformMemStatsGetCurrentBytes());
+        return false;
+    }
+
+    WaveformMemStatsReport();
+    std::string report;
+    if (!read_report(jsonFilename, report))
+        return false;
+
+    std::string stage = find_stage(report, "test buffers");
+    char expected[100];
+    snprintf(expected, sizeof(expected), "\"buffers\": 1, \"allocated_bytes\": %zu, \"peak_bytes\": %zu,",
+        numSamples * 2 * sizeof(float), numSamples * 2 * sizeof(float));
+    if (stage.find(expected) == std::string::npos || stage.find("\"current_bytes\": 0 }") == std::string::npos)
+    {
+        printf("Wrong memory totals in the report:\n%s\n", report.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Checks that the trace holds the scopes, their details, and the
+// thread pool's tasks.
+static bool trace_test()
+{
+    const wchar_t *traceFilename = L"testout_trace.json";
+
+    WaveformTraceEnable(traceFilename);
+    {
+        WaveformProfileScope scope("test traced");
+        scope.SetDetail(L"some \"file\".wav");
+        ThreadPool::GetShared().RunTasks(4, [](size_t) {
+            WaveformProfileScope task("test task");
+        });
+    }
+    WaveformTraceWrite();
+
+    std::string trace;
+    if (!read_report(traceFilename, trace))
+        return false;
+
+    if (trace.find("\"traceEvents\"") == std::string::npos ||
+        trace.find("{ \"name\": \"thread_name\", \"ph\": \"M\"") == std::string::npos ||
+        trace.find("{ \"name\": \"test traced\", \"ph\": \"X\"") == std::string::npos ||
+        trace.find("\"detail\": \"some \\\"file\\\".wav\"") == std::string::npos ||
+        trace.find("{ \"name\": \"test task\", \"ph\": \"X\"") == std::string::npos ||
+        trace.find("{ \"name\": \"pool task\", \"ph\": \"X\"") == std::string::npos)
+    {
+        printf("Events missing from the trace:\n%s\n", trace.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Run the profiling tests and return true if successful.
+bool test_waveform_profile()
+{
+    int error_count = 0;
+
+    printf("Starting waveform profile tests.\n");
+
+    if (!report_test())
+        error_count++;
+    if (!memory_test())
+        error_count++;
+    if (!trace_test())
+        error_count++;
+
+    if (error_count)
+    {
+        printf("Error count during waveform profile tests:  %d\n", error_count);
+        return false;
+    }
+
+    printf("Waveform profile tests OK.\n");
+    return true;
+}
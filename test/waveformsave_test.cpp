@@ -0,0 +1,424 @@
+//-------------------------------------------------------------------
+//
+// waveformsave_test.cpp
+//
+// Tests of saving Waveform objects to audio files.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#include "waveform.h"
+#include "waveformload.h"
+#include "waveformsave.h"
+#include "platform.h"
+#include "wavfile.h"
+#include <math.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Saves a few seconds of tones to an MP3 file, loads it back, and
+// checks that the decoded audio matches the original closely.
+static bool mp3_save_test_iter(unsigned rate, size_t numChannels)
+{
+    const wchar_t *filename = L"testout_mp3save.mp3";
+    printf("MP3 save test, %u Hz, %zu channel(s)\n", rate, numChannels);
+
+    size_t numSamples = rate * 2 + rand() % rate;
+    Waveform wav;
+    wav.SetRate(rate);
+    if (!wav.Populate(numSamples, numChannels))
+    {
+        printf("Waveform::Populate failed.\n");
+        return false;
+    }
+    // Fade in and out over 10 ms, since an abrupt start or end has
+    // energy above the encoder's lowpass filter.
+    size_t fadeSamples = rate / 100;
+    float *sample = wav.GetSamplesPtr();
+    for (size_t index = 0; index < numSamples; index++)
+    {
+        float t = static_cast<float>(index) / static_cast<float>(rate);
+        size_t edge = std::min(index, numSamples - 1 - index);
+        float fade = (edge < fadeSamples) ?
+            0.5f - 0.5f * cosf(3.14159265f * static_cast<float>(edge) / static_cast<float>(fadeSamples)) : 1.0f;
+        for (size_t channel = 0; channel < numChannels; channel++)
+        {
+            float hz = 330.0f * static_cast<float>(channel + 1);
+            *sample++ = fade * (0.4f * sinf(2.0f * 3.14159265f * hz * t) +
+                                0.2f * sinf(2.0f * 3.14159265f * 2500.0f * t));
+        }
+    }
+
+    if (!WaveformSaveToFile(filename, wav))
+    {
+        printf("Failed saving '%S'\n", filename);
+        return false;
+    }
+
+    Waveform loaded;
+    bool result = WaveformLoadFromFile(filename, loaded);
+    _wremove(filename);
+    if (!result)
+    {
+        printf("Failed loading '%S'\n", filename);
+        return false;
+    }
+
+    // The file holds whole frames of 1152 samples, and the decoded
+    // audio is delayed by one frame.
+    const size_t frameSamples = 1152;
+    size_t expectSamples = ((numSamples + frameSamples - 1) / frameSamples + 1) * frameSamples;
+    if (loaded.GetRate() != rate ||
+        loaded.GetNumChannels() != numChannels ||
+        loaded.GetNumSamples() != expectSamples)
+    {
+        printf("Loaded %zu samples, %zu channel(s), %u Hz; expected %zu, %zu, %u\n",
+            loaded.GetNumSamples(), loaded.GetNumChannels(), loaded.GetRate(),
+            expectSamples, numChannels, rate);
+        return false;
+    }
+
+    double signal = 0.0;
+    double noise = 0.0;
+    const float *original = wav.GetSamplesPtr();
+    const float *decoded = loaded.GetSamplesPtr() + frameSamples * numChannels;
+    for (size_t index = 0; index < numSamples * numChannels; index++)
+    {
+        double error = static_cast<double>(decoded[index]) - original[index];
+        signal += static_cast<double>(original[index]) * original[index];
+        noise += error * error;
+    }
+    double snr = 10.0 * log10(signal / (noise + 1e-20));
+    printf("  Signal to noise ratio:  %.1f dB\n", snr);
+    if (snr < 30.0)
+    {
+        printf("Decoded MP3 audio doesn't match the original!\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Saves several seconds of 16-bit audio to a FLAC file, loads it
+// back, and checks that every sample matches the original exactly,
+// both for the whole file and for a range loaded on its own.
+static bool flac_save_test_iter(unsigned rate, size_t numChannels)
+{
+    const wchar_t *filename = L"testout_flacsave.flac";
+    printf("FLAC save test, %u Hz, %zu channel(s)\n", rate, numChannels);
+
+    // Tones plus a little noise, rounded to 16-bit values so that
+    // they survive the trip exactly.
+    size_t numSamples = rate * 5 + rand() % rate;
+    Waveform wav;
+    wav.SetRate(rate);
+    if (!wav.Populate(numSamples, numChannels))
+    {
+        printf("Waveform::Populate failed.\n");
+        return false;
+    }
+    float *sample = wav.GetSamplesPtr();
+    for (size_t index = 0; index < numSamples; index++)
+    {
+        float t = static_cast<float>(index) / static_cast<float>(rate);
+        for (size_t channel = 0; channel < numChannels; channel++)
+        {
+            float hz = 440.0f * static_cast<float>(channel + 1);
+            float value = 0.5f * sinf(2.0f * 3.14159265f * hz * t) +
+                          0.01f * (static_cast<float>(rand()) / RAND_MAX - 0.5f);
+            *sample++ = floorf(value * 32767.0f + 0.5f) / 32767.0f;
+        }
+    }
+
+    if (!WaveformSaveToFile(filename, wav))
+    {
+        printf("Failed saving '%S'\n", filename);
+        return false;
+    }
+
+    Waveform loaded;
+    Waveform range;
+    size_t startFrame = numSamples / 3;
+    size_t count = rate + rand() % rate;
+    bool result = WaveformLoadFromFile(filename, loaded) &&
+                  WaveformLoadRange(filename, startFrame, count, range);
+    _wremove(filename);
+    if (!result)
+    {
+        printf("Failed loading '%S'\n", filename);
+        return false;
+    }
+
+    if (loaded.GetRate() != rate ||
+        loaded.GetNumChannels() != numChannels ||
+        loaded.GetNumSamples() != numSamples ||
+        range.GetNumSamples() != count)
+    {
+        printf("Loaded %zu samples, %zu channel(s), %u Hz; expected %zu, %zu, %u\n",
+            loaded.GetNumSamples(), loaded.GetNumChannels(), loaded.GetRate(),
+            numSamples, numChannels, rate);
+        return false;
+    }
+
+    const float *original = wav.GetSamplesPtr();
+    if (memcmp(loaded.GetSamplesPtr(), original, numSamples * numChannels * sizeof(float)) != 0 ||
+        memcmp(range.GetSamplesPtr(), original + startFrame * numChannels, count * numChannels * sizeof(float)) != 0)
+    {
+        printf("Decoded FLAC audio doesn't match the original!\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Saves a second or two of audio to a 24-bit WAV file, loads it
+// back, and checks the format and samples.  Half of the samples are
+// exact 24-bit values, which must survive the trip exactly; the rest
+// are dithered, so they may be off by a step or so.  Surround audio
+// is given speaker positions, which must come back as they were.
+static bool wav24_save_test_iter(unsigned rate, size_t numChannels)
+{
+    const wchar_t *filename = L"testout_wav24save.wav";
+    printf("24-bit WAV save test, %u Hz, %zu channel(s)\n", rate, numChannels);
+
+    size_t numSamples = rate + rand() % rate;
+    Waveform wav;
+    wav.SetRate(rate);
+    if (!wav.Populate(numSamples, numChannels))
+    {
+        printf("Waveform::Populate failed.\n");
+        return false;
+    }
+    float *sample = wav.GetSamplesPtr();
+    for (size_t index = 0; index < numSamples * numChannels; index++)
+    {
+        float value = 1.9f * (static_cast<float>(rand()) / RAND_MAX - 0.5f);
+        if (index & 1)
+            value = floorf(value * 8388607.0f + 0.5f) / 8388607.0f;
+        *sample++ = value;
+    }
+    uint32_t channelMask = (numChannels == 6) ? 0x3F : ((numChannels == 8) ? 0x63F : 0);
+    wav.SetChannelMask(channelMask);
+
+    WaveformFileInfo info;
+    Waveform loaded;
+    Waveform range;
+    bool result = WaveformSaveToFile(filename, wav, nullptr, nullptr, false, 3) &&
+                  WaveformReadFileInfo(filename, info) &&
+                  WaveformLoadFromFile(filename, loaded) &&
+                  WaveformLoadRange(filename, 0, 100, range);
+    _wremove(filename);
+    if (!result)
+    {
+        printf("Failed saving or loading '%S'\n", filename);
+        return false;
+    }
+
+    if (info.m_bitsPerSample != 24 || info.m_isFloat ||
+        loaded.GetNumChannels() != numChannels ||
+        loaded.GetNumSamples() != numSamples)
+    {
+        printf("Loaded %zu samples, %zu channel(s), %u bits; expected %zu, %zu, 24\n",
+            loaded.GetNumSamples(), loaded.GetNumChannels(), info.m_bitsPerSample,
+            numSamples, numChannels);
+        return false;
+    }
+
+    if (info.m_channelMask != channelMask || loaded.GetChannelMask() != channelMask ||
+        range.GetChannelMask() != channelMask)
+    {
+        printf("Loaded channel masks 0x%X, 0x%X and 0x%X; expected 0x%X\n",
+            info.m_channelMask, loaded.GetChannelMask(), range.GetChannelMask(), channelMask);
+        return false;
+    }
+
+    const float *original = wav.GetSamplesPtr();
+    const float *result24 = loaded.GetSamplesPtr();
+    for (size_t index = 0; index < numSamples * numChannels; index++)
+    {
+        float tolerance = (index & 1) ? 0.0f : 1.5f / 8388607.0f;
+        if (fabsf(result24[index] - original[index]) > tolerance)
+        {
+            printf("Sample %zu is %.9f; expected %.9f\n", index, result24[index], original[index]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Adds up the bytes that WAVFileReadSamplesInBlocks hands over.
+static bool count_wav_block_bytes(void *context, const void *, size_t bytes)
+{
+    *static_cast<size_t *>(context) += bytes;
+    return true;
+}
+
+// Saves a WAV file, cuts a few bytes off its end so that the data
+// chunk ends partway through a sample frame (and its size no longer
+// matches the header), and checks that every way of reading it sees
+// the same whole frames, matching the start of the original.
+static bool wav_partial_frame_test_iter(size_t numChannels, unsigned bytesPerSample, size_t cut)
+{
+    const wchar_t *filename = L"testout_wavpartial.wav";
+    printf("Partial-frame WAV test, %zu channel(s), %u bytes, %zu byte(s) cut\n",
+        numChannels, bytesPerSample, cut);
+
+    const size_t numSamples = 1000;
+    Waveform wav;
+    wav.SetRate(48000);
+    if (!wav.Populate(numSamples, numChannels))
+    {
+        printf("Waveform::Populate failed.\n");
+        return false;
+    }
+    float *sample = wav.GetSamplesPtr();
+    for (size_t index = 0; index < numSamples * numChannels; index++)
+        *sample++ = 1.9f * (static_cast<float>(rand()) / RAND_MAX - 0.5f);
+
+    Waveform full;
+    std::vector<char> bytes;
+    bool result = WaveformSaveToFile(filename, wav, nullptr, nullptr, false, bytesPerSample) &&
+                  WaveformLoadFromFile(filename, full);
+    if (result)
+    {
+        FILE *fp = nullptr;
+        result = _wfopen_s(&fp, filename, L"rb") == 0;
+        if (result)
+        {
+            char buffer[4096];
+            size_t got;
+            while ((got = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+                bytes.insert(bytes.end(), buffer, buffer + got);
+            fclose(fp);
+        }
+    }
+    if (result)
+    {
+        FILE *fp = nullptr;
+        result = _wfopen_s(&fp, filename, L"wb") == 0 && bytes.size() > cut &&
+                 fwrite(bytes.data(), 1, bytes.size() - cut, fp) == bytes.size() - cut;
+        if (fp != nullptr && fclose(fp) != 0)
+            result = false;
+    }
+
+    size_t frameBytes = numChannels * bytesPerSample;
+    size_t expected = numSamples - (cut + frameBytes - 1) / frameBytes;
+    size_t blockBytes = 0;
+    WaveformFileInfo info;
+    Waveform loaded;
+    Waveform tail;
+    result = result &&
+             WaveformReadFileInfo(filename, info) &&
+             WaveformLoadFromFile(filename, loaded) &&
+             WaveformLoadRange(filename, expected - 10, numSamples, tail) &&
+             WAVFileReadSamplesInBlocks(filename, 4096, count_wav_block_bytes, &blockBytes);
+    _wremove(filename);
+    if (!result)
+    {
+        printf("Failed saving, cutting or loading '%S'\n", filename);
+        return false;
+    }
+
+    if (info.m_numSamples != expected || loaded.GetNumSamples() != expected ||
+        tail.GetNumSamples() != 10 || blockBytes != expected * frameBytes)
+    {
+        printf("Read %zu, %zu and %zu samples and %zu bytes; expected %zu, %zu, 10 and %zu\n",
+            info.m_numSamples, loaded.GetNumSamples(), tail.GetNumSamples(), blockBytes,
+            expected, expected, expected * frameBytes);
+        return false;
+    }
+
+    const float *original = full.GetSamplesPtr();
+    if (memcmp(loaded.GetSamplesPtr(), original, expected * numChannels * sizeof(float)) != 0 ||
+        memcmp(tail.GetSamplesPtr(), original + (expected - 10) * numChannels, 10 * numChannels * sizeof(float)) != 0)
+    {
+        printf("Cut WAV audio doesn't match the original!\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Run the waveform saving tests and return true if successful.
+bool test_waveform_save()
+{
+    int error_count = 0;
+
+    printf("Starting waveform save tests.\n");
+
+    static const unsigned rates[] = { 32000, 44100, 48000 };
+    for (unsigned rate : rates)
+    {
+        for (size_t numChannels = 1; numChannels <= 2; numChannels++)
+        {
+            if (!mp3_save_test_iter(rate, numChannels))
+                error_count++;
+            if (!flac_save_test_iter(rate, numChannels))
+                error_count++;
+        }
+    }
+
+    static const size_t wav24Channels[] = { 1, 2, 6, 8 };
+    for (size_t numChannels : wav24Channels)
+    {
+        if (!wav24_save_test_iter(48000, numChannels))
+            error_count++;
+    }
+
+    // Cut less than a frame, exactly a frame, and a frame and a bit.
+    static const size_t cuts[] = { 1, 2, 4, 5 };
+    for (size_t cut : cuts)
+    {
+        if (!wav_partial_frame_test_iter(2, 2, cut))
+            error_count++;
+        if (!wav_partial_frame_test_iter(6, 3, cut * 5))
+            error_count++;
+    }
+
+    if (error_count)
+    {
+        printf("Error count during waveform save tests:  %d\n", error_count);
+        return false;
+    }
+
+    printf("Waveform save tests OK.\n");
+    return true;
+}
@@ -44,11 +44,42 @@
 //--------------------------------------------------------------------
 
 #include "wavfile.h"
+#include "platform.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <vector>
 
+// Position in a sample buffer, for the stream callbacks below.
+struct StreamBuffer
+{
+    std::vector<char> *m_samples = nullptr;
+    size_t m_offset = 0;
+};
+
+// Block callback for WAVFileWriteStream that copies out the next
+// part of a sample buffer.
+static bool fill_stream_block(void *context, void *samples, size_t bytes, size_t &filled)
+{
+    StreamBuffer *buffer = reinterpret_cast<StreamBuffer *>(context);
+    size_t remaining = buffer->m_samples->size() - buffer->m_offset;
+    filled = (bytes < remaining) ? bytes : remaining;
+    memcpy(samples, buffer->m_samples->data() + buffer->m_offset, filled);
+    buffer->m_offset += filled;
+    return true;
+}
+
+// Block callback for WAVFileReadStream that appends to a sample
+// buffer.
+static bool append_stream_block(void *context, const void *samples, size_t bytes)
+{
+    StreamBuffer *buffer = reinterpret_cast<StreamBuffer *>(context);
+    const char *p = reinterpret_cast<const char *>(samples);
+    buffer->m_samples->insert(buffer->m_samples->end(), p, p + bytes);
+    return true;
+}
+
 bool test_wavfile_read_write(wchar_t *filename)
 {
     printf("Starting WAV read/write test with '%S'\n", filename);
@@ -110,8 +141,8 @@ bool test_wavfile_read_write(wchar_t *filename)
     if (info.m_sample_count != info2.m_sample_count)
     {
         printf("Sample count of re-written WAV doesn't match!\n");
-        printf("  Before:  %u\n", info.m_sample_count);
-        printf("  After:   %u\n", info2.m_sample_count);
+        printf("  Before:  %llu\n", static_cast<unsigned long long>(info.m_sample_count));
+        printf("  After:   %llu\n", static_cast<unsigned long long>(info2.m_sample_count));
         return false;
     }
     else
@@ -133,6 +164,86 @@ bool test_wavfile_read_write(wchar_t *filename)
         }
     }
 
+    // Write the samples again as an RF64 file, which is normally
+    // only used for files over 4 GB, and check that it reads back
+    // the same.
+    WAVInfo rf64_info = info;
+    rf64_info.m_is_rf64 = true;
+    WAVInfo info3;
+    std::vector<char> samples3;
+    bool rf64_ok = WAVFileWrite(new_filename, rf64_info, samples.data()) &&
+                   WAVFileReadHeader(new_filename, info3);
+    if (rf64_ok)
+    {
+        samples3.resize(info3.CalculateBufferSize());
+        rf64_ok = WAVFileReadSamples(new_filename, samples3.data(), samples3.size());
+    }
+    _wunlink(L"temp.wav");
+    if (!rf64_ok || !info3.m_is_rf64 ||
+        info3.m_sample_count != info.m_sample_count ||
+        samples3 != samples)
+    {
+        printf("RF64 copy of WAV doesn't match!\n");
+        return false;
+    }
+    printf("RF64 copy matches OK.\n");
+
+    // Write the samples to a stream, which gets its sizes patched in
+    // at the end since a file can seek, then read them back from a
+    // stream.
+    std::vector<char> samples4;
+    StreamBuffer out_buffer;
+    out_buffer.m_samples = &samples;
+    StreamBuffer in_buffer;
+    in_buffer.m_samples = &samples4;
+    WAVInfo info4;
+    WAVInfo info5;
+    FILE *fp = nullptr;
+    bool stream_ok = _wfopen_s(&fp, new_filename, L"w+b") == 0 && fp &&
+                     WAVFileWriteStream(fp, info, 4096 * info.m_channels * (info.m_bits / 8), fill_stream_block, &out_buffer);
+    if (fp)
+        fclose(fp);
+    fp = nullptr;
+    stream_ok = stream_ok && WAVFileReadHeader(new_filename, info4) &&
+                _wfopen_s(&fp, new_filename, L"rb") == 0 && fp &&
+                WAVFileReadStream(fp, info5, 10000, append_stream_block, &in_buffer);
+    if (fp)
+        fclose(fp);
+    fp = nullptr;
+
+    // Read them back again, pulling blocks of an odd size (which is
+    // rounded down to whole sample frames) until the data runs out.
+    std::vector<char> samples6;
+    WAVInfo info6;
+    uint64_t remaining = 0;
+    stream_ok = stream_ok && _wfopen_s(&fp, new_filename, L"rb") == 0 && fp &&
+                WAVFileReadStreamHeader(fp, info6, remaining);
+    if (stream_ok)
+    {
+        std::vector<char> block(3333);
+        size_t got;
+        while ((got = WAVFileReadStreamSamples(fp, info6, remaining, block.data(), block.size())) > 0)
+        {
+            if (got % (info6.m_channels * (info6.m_bits / 8)) != 0)
+                stream_ok = false;
+            samples6.insert(samples6.end(), block.begin(), block.begin() + got);
+        }
+        stream_ok = stream_ok && !ferror(fp) && remaining == 0;
+    }
+    if (fp)
+        fclose(fp);
+    _wunlink(L"temp.wav");
+    if (!stream_ok ||
+        info4.m_sample_count != info.m_sample_count ||
+        info5.m_sample_count != info.m_sample_count ||
+        info6.m_sample_count != info.m_sample_count ||
+        samples4 != samples || samples6 != samples)
+    {
+        printf("Streamed copy of WAV doesn't match!\n");
+        return false;
+    }
+    printf("Streamed copy matches OK.\n");
+
     return true;
 }
 
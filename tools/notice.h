@@ -3,13 +3,13 @@
 //
 #pragma once
 
-static char *g_notice_thisispartof =
+static const char *const g_notice_thisispartof =
     "This software is part of WaveTools.\n" ;
 
-static char *g_notice_copyright_short =
+static const char *const g_notice_copyright_short =
     "(C) Copyright 1994-2025 Ammon R. Campbell.\n" ;
 
-static char *g_notice_copyright_long =
+static const char *const g_notice_copyright_long =
     "------------------------------------------------------------------ \n"
     "\n"
     "This software is part of WaveTools. \n"
@@ -0,0 +1,1156 @@
+//-------------------------------------------------------------------
+//
+// wavechain.cpp
+// Program to apply a chain of effects to an audio file in one pass,
+// loading and saving the audio only once.
+//
+//-------------------------------------------------------------------
+//
+// (C) Copyright 1994-2025 Ammon R. Campbell.
+//
+// I wrote this code for use in my own educational and experimental
+// programs, but you may also freely use it in yours as long as you
+// abide by the following terms and conditions:
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//   * Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials
+//     provided with the distribution.
+//   * The name(s) of the author(s) and contributors (if any) may not
+//     be used to endorse or promote products derived from this
+//     software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+// INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.  IN OTHER WORDS, USE AT YOUR OWN RISK, NOT OURS.  
+//--------------------------------------------------------------------
+
+#include "notice.h"
+#include "waveform.h"
+#include "waveformload.h"
+#include "waveformsave.h"
+#include "waveformgraph.h"
+#include "waveformprocessors.h"
+#include "waveformbatch.h"
+#include "waveformprofile.h"
+#include "dspkernels.h"
+#include "cmdopt.h"
+#include "platform.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <wchar.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+struct StageType;
+
+// The settings for one stage of the effect chain.  Each kind of
+// stage takes the same parameters and options as the tool that
+// applies the same effect, and only uses the fields that apply.
+struct ChainStage
+{
+    // The kind of stage, from the table of stage types.
+    const StageType *m_type = nullptr;
+
+    // The stage's parameters, in the order the tool takes them.
+    std::vector<float> m_params;
+
+    // Options for the 'eq' stage.
+    float m_bandpassFreq = 0.0f;
+    float m_bandpassQ = 2.0f;
+    float m_notchFreq = 0.0f;
+    float m_notchQ = 5.0f;
+
+    // Options for the 'gate' stage.
+    float m_threshold = 0.1f;
+    bool m_trimStart = false;
+    bool m_trimEnd = false;
+
+    // Options for the 'echo' stage.
+    float m_wetLevel = 0.5f;
+    float m_dryLevel = 1.0f;
+
+    // Option for the 'tremolo' and 'extend' stages:  true if the
+    // parameters are given in seconds rather than samples.
+    bool m_useTime = false;
+};
+
+// Describes one kind of stage:  its name (the tool's name without
+// the "wave" prefix), how many parameters it takes, and the function
+// that parses its options.  Stages that need the whole waveform at
+// once have a function that applies them to it; the rest have a
+// function that makes a processor for them (or returns nullptr if
+// the stage's parameters are invalid), so they can be streamed.
+struct StageType
+{
+    const wchar_t *m_name;
+    size_t m_numParams;
+    bool (*m_parseOption)(const wchar_t *arg, ChainStage &stage);
+    bool (*m_apply)(Waveform &wav, const ChainStage &stage);
+    WaveformProcessor *(*m_makeProcessor)(const ChainStage &stage);
+};
+
+struct ProgramSettings
+{
+    // Names of the audio files to read and write.
+    std::wstring m_inFilename;
+    std::wstring m_outFilename;
+
+    // The effects to apply, in order.
+    std::vector<ChainStage> m_stages;
+
+    // For file formats that support both integer and
+    // floating-point samples, this indicates which to use
+    // when writing the output file.
+    bool m_useFloat = false;
+
+    // For file formats that support multiple sample sizes,
+    // this indicates which sample size to use when writing
+    // 'outfile', where 'x' is typically 1, 2, or 4 for
+    // integer samples, and 4 or 8 for floating-point
+    // samples.
+    unsigned m_useBytesPerSample = 2;
+
+    // For batch mode, the template for naming the output files,
+    // and the input files, wildcards, directories, and lists of
+    // files to process.  The template is empty if not in batch mode.
+    std::wstring m_batchTemplate;
+    std::vector<std::wstring> m_batchInputs;
+
+    // For batch mode, the most files to process at once (zero for
+    // one per CPU), and the limit on the memory they may use at
+    // once in bytes (zero for no limit).
+    unsigned m_batchThreads = 0;
+    size_t m_batchMemory = 0;
+};
+
+// Print the program name prefix to stdout.
+const wchar_t *program_name = L"WaveChain";
+static void printname() { printf("%S:  ", program_name); }
+
+//
+// Stage functions.  Each applies the same effect to the waveform,
+// or makes a processor that applies it, as the tool it's named
+// after, but leaves the samples in floating point for the next
+// stage.
+//
+
+// Makes the processor for low-pass, high-pass, bandpass, and notch
+// filters, as WaveEQ applies.  Parameters:  lowpass highpass.
+static WaveformProcessor *MakeEQ(const ChainStage &stage)
+{
+    float lowPassFreq = stage.m_params[0];
+    float highPassFreq = stage.m_params[1];
+
+    printname();
+    printf("Applying EQ:  low-pass %.2f Hz, high-pass %.2f Hz, bandpass %.2f Hz, notch %.2f Hz\n",
+        lowPassFreq, highPassFreq, stage.m_bandpassFreq, stage.m_notchFreq);
+    fflush(stdout);
+
+    return new EQProcessor(lowPassFreq, highPassFreq,
+        stage.m_bandpassFreq, stage.m_bandpassQ, stage.m_notchFreq, stage.m_notchQ);
+}
+
+// Parses the options of an 'eq' stage.
+static bool ParseEQOption(const wchar_t *arg, ChainStage &stage)
+{
+    if (OptionNameIs(arg, L"BandpassFreq"))
+    {
+        stage.m_bandpassFreq = static_cast<float>(_wtof(OptionValue(arg)));
+        return stage.m_bandpassFreq >= 1.0f && stage.m_bandpassFreq <= 100000.0f;
+    }
+    else if (OptionNameIs(arg, L"BandpassQ"))
+    {
+        stage.m_bandpassQ = static_cast<float>(_wtof(OptionValue(arg)));
+        return stage.m_bandpassQ > 0.0f && stage.m_bandpassQ <= 100.0f;
+    }
+    else if (OptionNameIs(arg, L"NotchFreq"))
+    {
+        stage.m_notchFreq = static_cast<float>(_wtof(OptionValue(arg)));
+        return stage.m_notchFreq >= 1.0f && stage.m_notchFreq <= 100000.0f;
+    }
+    else if (OptionNameIs(arg, L"NotchQ"))
+    {
+        stage.m_notchQ = static_cast<float>(_wtof(OptionValue(arg)));
+        return stage.m_notchQ > 0.0f && stage.m_notchQ <= 100.0f;
+    }
+    return false;
+}
+
+// Replaces stretches of quiet with silence, and optionally deletes
+// the silence at the start and end, as WaveGate does.  The
+// threshold is relative to the loudest sample.
+static bool ApplyGate(Waveform &wav, const ChainStage &stage)
+{
+    WaveformProfileScope profile("gate", wav.GetNumSamples() * wav.GetNumChannels(), wav.GetTotalBytes() * 2);
+    float hiSample = fabsf(wav.GetHighestSample());
+    float loSample = fabsf(wav.GetLowestSample());
+    float threshold = stage.m_threshold * (hiSample > loSample ? hiSample : loSample);
+
+    printname();
+    printf("Applying gate filter with threshold %G\n", threshold);
+    fflush(stdout);
+
+    const size_t numQuietSamplesForSilence = wav.GetRate() * wav.GetNumChannels() / 5;
+    size_t numChannels = wav.GetNumChannels();
+    size_t numSamples = wav.GetNumSamples() * numChannels;
+    float *samples = wav.GetSamplesPtr();
+    size_t firstSilentSample = 0;
+    size_t firstSilentCount = 0;
+    size_t lastSilentSample = 0;
+    size_t lastSilentCount = 0;
+    size_t isample = 0;
+    while (isample < numSamples)
+    {
+        if (fabsf(samples[isample]) < threshold)
+        {
+            // Count the quiet samples in a row, and silence them if
+            // there are enough.
+            size_t qcount = 1;
+            isample++;
+            while (isample + qcount < numSamples && fabsf(samples[isample + qcount]) < threshold)
+                qcount++;
+
+            if (qcount >= numQuietSamplesForSilence)
+            {
+                wav.Silence(isample / numChannels, qcount / numChannels, true);
+
+                lastSilentSample = isample;
+                lastSilentCount = qcount;
+                if (firstSilentCount == 0)
+                {
+                    firstSilentSample = lastSilentSample;
+                    firstSilentCount = lastSilentCount;
+                }
+            }
+
+            isample += qcount;
+        }
+        else
+        {
+            while (isample < numSamples && fabsf(samples[isample]) >= threshold)
+                isample++;
+        }
+    }
+
+    // Delete the silence at the end and start, allowing for a few
+    // samples of junk (like a click) at either end.
+    if (stage.m_trimEnd &&
+        firstSilentSample != lastSilentSample &&
+        lastSilentCount > 0 &&
+        lastSilentSample + lastSilentCount >= numSamples - 10)
+    {
+        printname();
+        printf("Deleting %zu samples of silence from end of waveform.\n", lastSilentCount / numChannels);
+        wav.Delete(lastSilentSample / numChannels, lastSilentCount / numChannels);
+    }
+    if (stage.m_trimStart &&
+        firstSilentCount > 0 &&
+        firstSilentSample < 10)
+    {
+        printname();
+        printf("Deleting %zu samples of silence from start of waveform.\n", firstSilentCount / numChannels);
+        wav.Delete(firstSilentSample / numChannels, firstSilentCount / numChannels);
+    }
+
+    return true;
+}
+
+// Parses the options of a 'gate' stage.
+static bool ParseGateOption(const wchar_t *arg, ChainStage &stage)
+{
+    if (OptionNameIs(arg, L"Threshold"))
+    {
+        stage.m_threshold = static_cast<float>(_wtof(OptionValue(arg)));
+        return stage.m_threshold >= 0.0000001f && stage.m_threshold <= 1.0f;
+    }
+    else if (OptionNameIs(arg, L"TrimStart"))
+    {
+        stage.m_trimStart = true;
+        return true;
+    }
+    else if (OptionNameIs(arg, L"TrimEnd"))
+    {
+        stage.m_trimEnd = true;
+        return true;
+    }
+    return false;
+}
+
+// Normalizes the waveform to a decibel level, as WaveNormalize
+// does.  Parameter:  dbLevel.
+static bool ApplyNormalize(Waveform &wav, const ChainStage &stage)
+{
+    float dbLevel = stage.m_params[0];
+    if (dbLevel <= -100.0f || dbLevel > 0.0f)
+    {
+        printname();
+        printf("Invalid normalize level %.2f dB\n", dbLevel);
+        return false;
+    }
+
+    printname();
+    printf("Normalizing samples to %.2f dB\n", dbLevel);
+    fflush(stdout);
+
+    wav.Normalize(dbLevel);
+    return true;
+}
+
+// Makes the processor that fades the audio in at the start and out
+// at the end, as WaveFade does.  Parameters:  fadein fadeout (in
+// seconds).
+static WaveformProcessor *MakeFade(const ChainStage &stage)
+{
+    float fadeInSeconds = stage.m_params[0];
+    float fadeOutSeconds = stage.m_params[1];
+    if (fadeInSeconds < 0.0f || fadeOutSeconds < 0.0f)
+    {
+        printname();
+        printf("Invalid fade duration\n");
+        return nullptr;
+    }
+
+    printname();
+    printf("Applying up to %.2f seconds of fade-in and %.2f seconds of fade-out.\n",
+        fadeInSeconds, fadeOutSeconds);
+    fflush(stdout);
+
+    return new FadeProcessor(fadeInSeconds, fadeOutSeconds);
+}
+
+// Makes the processor that multiplies the samples by a volume
+// level, as WaveVolume does.  Parameter:  volumeMultiplier.
+static WaveformProcessor *MakeVolume(const ChainStage &stage)
+{
+    float volume = stage.m_params[0];
+    if (volume <= 0.0f || volume > 100000.0f)
+    {
+        printname();
+        printf("Invalid volume multiplier %.2f\n", volume);
+        return nullptr;
+    }
+
+    printname();
+    printf("Applying volume multiplier of %.2f\n", volume);
+    fflush(stdout);
+
+    return new VolumeProcessor(volume);
+}
+
+// Makes the processor that adds echoes of the audio to itself, as
+// WaveEcho does.  Parameters:  delay (in milliseconds) repeat.
+static WaveformProcessor *MakeEcho(const ChainStage &stage)
+{
+    float delayMs = stage.m_params[0];
+    size_t repeat = static_cast<size_t>(stage.m_params[1]);
+    if (delayMs <= 0.0f || delayMs > 100000.0f || repeat < 1 || repeat > 100)
+    {
+        printname();
+        printf("Invalid echo delay or repeat count\n");
+        return nullptr;
+    }
+
+    printname();
+    printf("Applying %zu echo(s) delayed %.2f ms, wet:%.2f dry:%.2f\n",
+        repeat, delayMs, stage.m_wetLevel, stage.m_dryLevel);
+    fflush(stdout);
+
+    return new EchoProcessor(delayMs, repeat, stage.m_wetLevel, stage.m_dryLevel);
+}
+
+// Parses the options of an 'echo' stage.
+static bool ParseEchoOption(const wchar_t *arg, ChainStage &stage)
+{
+    if (OptionNameIs(arg, L"WetLevel"))
+    {
+        stage.m_wetLevel = static_cast<float>(_wtof(OptionValue(arg)));
+        return stage.m_wetLevel >= 0.0f && stage.m_wetLevel <= 1.0f;
+    }
+    else if (OptionNameIs(arg, L"DryLevel"))
+    {
+        stage.m_dryLevel = static_cast<float>(_wtof(OptionValue(arg)));
+        return stage.m_dryLevel >= 0.0f && stage.m_dryLevel <= 1.0f;
+    }
+    return false;
+}
+
+// Makes the processor for a tremolo effect, as WaveTremolo applies.
+// Parameters:  width (in samples, or seconds with -UseTime) depth.
+// A time that works out to less than two samples makes the graph
+// fail to set up.
+static WaveformProcessor *MakeTremolo(const ChainStage &stage)
+{
+    float depth = stage.m_params[1];
+    bool validWidth = stage.m_useTime ? stage.m_params[0] > 0.0f : stage.m_params[0] >= 2.0f;
+    if (!validWidth || depth <= 0.0f || depth > 1.0f)
+    {
+        printname();
+        printf("Invalid tremolo width or depth\n");
+        return nullptr;
+    }
+
+    printname();
+    printf("Applying tremolo effect, width %G %s, depth %G.\n",
+        stage.m_params[0], stage.m_useTime ? "seconds" : "samples", depth);
+    fflush(stdout);
+
+    return new TremoloProcessor(stage.m_params[0], depth, stage.m_useTime);
+}
+
+// Parses the -UseTime option of the 'tremolo' and 'extend' stages.
+static bool ParseUseTimeOption(const wchar_t *arg, ChainStage &stage)
+{
+    if (OptionNameIs(arg, L"UseTime"))
+    {
+        stage.m_useTime = true;
+        return true;
+    }
+    return false;
+}
+
+// Resamples the waveform to a new sample rate, as WaveRate does.
+// Parameter:  rate.
+static bool ApplyRate(Waveform &wav, const ChainStage &stage)
+{
+    unsigned rate = static_cast<unsigned>(stage.m_params[0]);
+    if (rate < 2 || rate > 1000000)
+    {
+        printname();
+        printf("Invalid sample rate %u\n", rate);
+        return false;
+    }
+
+    printname();
+    printf("Resampling to %u Hz\n", rate);
+    fflush(stdout);
+
+    return wav.Resample(rate);
+}
+
+// Stretches or shrinks the waveform, as WaveStretch does.
+// Parameter:  multiplier.
+static bool ApplyStretch(Waveform &wav, const ChainStage &stage)
+{
+    if (stage.m_params[0] <= 0.0f)
+    {
+        printname();
+        printf("Invalid stretch multiplier %G\n", stage.m_params[0]);
+        return false;
+    }
+    size_t newNumSamples = static_cast<size_t>(static_cast<float>(wav.GetNumSamples()) * stage.m_params[0]);
+
+    printname();
+    printf("Stretching %zu to %zu samples.\n", wav.GetNumSamples(), newNumSamples);
+    fflush(stdout);
+
+    return wav.Stretch(newNumSamples);
+}
+
+// Adds silence to the start and end of the waveform, as WaveExtend
+// does.  Parameters:  before after (in samples, or seconds with
+// -UseTime).
+static bool ApplyExtend(Waveform &wav, const ChainStage &stage)
+{
+    if (stage.m_params[0] < 0.0f || stage.m_params[1] < 0.0f)
+    {
+        printname();
+        printf("Invalid extend length\n");
+        return false;
+    }
+    size_t extendBegin = stage.m_useTime ?
+        wav.TimeToSampleIndex(stage.m_params[0]) : static_cast<size_t>(stage.m_params[0]);
+    size_t extendEnd = stage.m_useTime ?
+        wav.TimeToSampleIndex(stage.m_params[1]) : static_cast<size_t>(stage.m_params[1]);
+
+    printname();
+    printf("Inserting %zu samples at beginning and %zu samples at end of waveform.\n",
+        extendBegin, extendEnd);
+    fflush(stdout);
+
+    return (extendBegin == 0 || wav.Insert(0, extendBegin)) &&
+           (extendEnd == 0 || wav.Insert(wav.GetNumSamples(), extendEnd));
+}
+
+// Makes the processor that converts the audio to mono, as
+// WaveConvert -Mono does.
+static WaveformProcessor *MakeMono(const ChainStage &)
+{
+    printname();
+    printf("Converting to mono.\n");
+    fflush(stdout);
+
+    return new ChannelProcessor(1);
+}
+
+// Makes the processor that converts the audio to stereo, as
+// WaveConvert -Stereo does.
+static WaveformProcessor *MakeStereo(const ChainStage &)
+{
+    printname();
+    printf("Converting to stereo.\n");
+    fflush(stdout);
+
+    return new ChannelProcessor(2);
+}
+
+// The kinds of stages that can be chained.
+static const StageType g_stageTypes[] =
+{
+    { L"eq",        2, ParseEQOption,       nullptr,            MakeEQ },
+    { L"gate",      0, ParseGateOption,     ApplyGate,          nullptr },
+    { L"normalize", 1, nullptr,             ApplyNormalize,     nullptr },
+    { L"fade",      2, nullptr,             nullptr,            MakeFade },
+    { L"volume",    1, nullptr,             nullptr,            MakeVolume },
+    { L"echo",      2, ParseEchoOption,     nullptr,            MakeEcho },
+    { L"tremolo",   2, ParseUseTimeOption,  nullptr,            MakeTremolo },
+    { L"rate",      1, nullptr,             ApplyRate,          nullptr },
+    { L"stretch",   1, nullptr,             ApplyStretch,       nullptr },
+    { L"extend",    2, ParseUseTimeOption,  ApplyExtend,        nullptr },
+    { L"mono",      0, nullptr,             nullptr,            MakeMono },
+    { L"stereo",    0, nullptr,             nullptr,            MakeStereo },
+};
+
+// Returns the stage type with the given name (with or without the
+// "wave" prefix), or nullptr if there isn't one.
+static const StageType *FindStageType(const wchar_t *name)
+{
+    if (_wcsnicmp(name, L"wave", 4) == 0)
+        name += 4;
+
+    for (const StageType &type : g_stageTypes)
+    {
+        if (_wcsicmp(name, type.m_name) == 0)
+            return &type;
+    }
+    return nullptr;
+}
+
+// Adds the processors for a run of stages to a graph, after the
+// given node.  Returns the last node, or SIZE_MAX if a stage's
+// parameters are invalid.
+static size_t AddProcessorStages(
+        WaveformGraph &graph,
+        size_t node,
+        const ChainStage *stages,
+        size_t numStages,
+        std::vector<std::unique_ptr<WaveformProcessor>> &processors
+        )
+{
+    for (size_t istage = 0; istage < numStages; istage++)
+    {
+        processors.emplace_back(stages[istage].m_type->m_makeProcessor(stages[istage]));
+        if (!processors.back())
+        {
+            printname();
+            printf("Failed applying '%S' stage!\n", stages[istage].m_type->m_name);
+            return SIZE_MAX;
+        }
+        node = graph.AddProcessor(*processors.back(), node);
+    }
+    return node;
+}
+
+// Runs a waveform in memory through a run of stages that have
+// processors, all in one pass.
+static bool ApplyProcessorStages(Waveform &wav, const ChainStage *stages, size_t numStages)
+{
+    WaveformGraph graph;
+    WaveformMemorySource source(wav);
+    std::vector<std::unique_ptr<WaveformProcessor>> processors;
+    size_t output = AddProcessorStages(graph, graph.AddSource(source), stages, numStages, processors);
+    if (output == SIZE_MAX)
+        return false;
+
+    WaveformMemorySink sink(wav);
+    if (!graph.Run(output, sink))
+    {
+        printname();
+        printf("Failed applying the stage(s) from '%S' to '%S'!\n",
+            stages[0].m_type->m_name, stages[numStages - 1].m_type->m_name);
+        return false;
+    }
+    return true;
+}
+
+//
+// Streams an audio file through the processors of a chain whose
+// stages all have them, a block at a time, to the output file, so
+// the whole file never has to be held in memory.  The files are read
+// and written on threads of their own while the blocks are being
+// processed.
+//
+static bool StreamChainToAudioFile(
+        const wchar_t *inFilename,
+        const wchar_t *outFilename,
+        bool useFloat,
+        unsigned useBytesPerSample,
+        const std::vector<ChainStage> &stages
+        )
+{
+    WaveformGraph graph;
+    graph.SetPipelineDepth(WaveformGraph::kDefaultPipelineDepth);
+    WaveformFileSource source(inFilename);
+    std::vector<std::unique_ptr<WaveformProcessor>> processors;
+    size_t output = AddProcessorStages(graph, graph.AddSource(source), stages.data(), stages.size(), processors);
+    if (output == SIZE_MAX)
+        return false;
+
+    if (!graph.Prepare())
+    {
+        printname();
+        printf("Failed setting up the chain for \"%S\"!\n", inFilename);
+        return false;
+    }
+
+    const WaveformFormat &inFormat = graph.GetFormat(0);
+    printname();
+    printf("Reading %zu samples (%.2f seconds) from '%S' at %u Hz\n",
+        inFormat.m_numSamples, inFormat.GetDurationInSeconds(), inFilename, inFormat.m_rate);
+
+    const WaveformFormat &format = graph.GetFormat(output);
+    printname();
+    printf("Saving %zu samples (%.2f seconds) to '%S' at %u Hz\n",
+        format.m_numSamples, format.GetDurationInSeconds(), outFilename, format.m_rate);
+    fflush(stdout);
+
+    WaveformFileSink sink(outFilename, useFloat, useBytesPerSample);
+    if (!graph.Run(output, sink))
+    {
+        printname();
+        printf("Failed processing audio data from \"%S\" to \"%S\"!\n", inFilename, outFilename);
+        return false;
+    }
+
+    printname();
+    printf("Saved '%S'\n", outFilename);
+    fflush(stdout);
+
+    return true;
+}
+
+//
+// Loads an audio file, runs it through each stage of the chain in
+// turn, and saves the result.  The samples stay in floating point
+// from the load to the save, so they're only converted to the
+// output sample format once.  If every stage can be streamed, the
+// file is streamed through the chain instead of being loaded.
+//
+static bool ApplyChainToAudioFile(
+        const wchar_t *inFilename,
+        const wchar_t *outFilename,
+        bool useFloat,
+        unsigned useBytesPerSample,
+        const std::vector<ChainStage> &stages
+        )
+{
+    printname();
+    printf("Settings:\n");
+    printf("  Processing '%S' to '%S' through %zu stage(s):\n", inFilename, outFilename, stages.size());
+    bool streamable = true;
+    for (const ChainStage &stage : stages)
+    {
+        printf("    %S", stage.m_type->m_name);
+        for (float param : stage.m_params)
+            printf(" %G", param);
+        printf("\n");
+
+        if (!stage.m_type->m_makeProcessor)
+            streamable = false;
+    }
+    printf("  Preferred sample type:  %s\n", useFloat ? "float" : "integer");
+    printf("  Preferred sample size:  %u\n", useBytesPerSample);
+
+    if (streamable)
+        return StreamChainToAudioFile(inFilename, outFilename, useFloat, useBytesPerSample, stages);
+
+    //
+    // Load the input file.
+    //
+
+    Waveform wav;
+    if (!WaveformLoadFromFile(inFilename, wav, nullptr, nullptr))
+    {
+        printname();
+        printf("Failed loading audio data from \"%S\"!\n", inFilename);
+        return false;
+    }
+
+    printname();
+    printf("Loaded %zu samples (%.2f seconds) from '%S' at %u Hz\n",
+        wav.GetNumSamples(), wav.GetDurationInSeconds(), inFilename, wav.GetRate());
+    fflush(stdout);
+
+    //
+    // Run the waveform through each stage.  Each run of stages that
+    // have processors goes through them in one pass.
+    //
+
+    for (size_t istage = 0; istage < stages.size(); )
+    {
+        const ChainStage &stage = stages[istage];
+        if (stage.m_type->m_apply)
+        {
+            if (!stage.m_type->m_apply(wav, stage))
+            {
+                printname();
+                printf("Failed applying '%S' stage!\n", stage.m_type->m_name);
+                return false;
+            }
+            istage++;
+            continue;
+        }
+
+        size_t numStages = 1;
+        while (istage + numStages < stages.size() && !stages[istage + numStages].m_type->m_apply)
+            numStages++;
+        if (!ApplyProcessorStages(wav, &stages[istage], numStages))
+            return false;
+        istage += numStages;
+    }
+
+    //
+    // Save the altered waveform to the output file.
+    //
+
+    printname();
+    printf("Saving %zu samples (%.2f seconds) to '%S' at %u Hz\n",
+        wav.GetNumSamples(), wav.GetDurationInSeconds(), outFilename, wav.GetRate());
+    fflush(stdout);
+
+    if (!WaveformSaveToFile(outFilename, wav, nullptr, nullptr,
+                            useFloat, useBytesPerSample))
+    {
+        printname();
+        printf("Failed saving audio data to \"%S\"!\n", outFilename);
+        return false;
+    }
+
+    printname();
+    printf("Saved '%S'\n", outFilename);
+    fflush(stdout);
+
+    return true;
+}
+
+//
+// Runs each file of a batch through the chain, several files at a
+// time, and reports the files that failed.  Returns true if every
+// file was processed successfully.
+//
+static bool ApplyChainToBatch(const ProgramSettings &settings)
+{
+    std::vector<std::wstring> inFilenames;
+    if (!WaveformBatchExpandInputs(settings.m_batchInputs, inFilenames))
+        return false;
+
+    WaveformBatch batch;
+    batch.SetThreadCount(settings.m_batchThreads);
+    batch.SetMemoryBudget(settings.m_batchMemory);
+    batch.AddFiles(inFilenames, settings.m_batchTemplate.c_str());
+
+    printname();
+    printf("Processing a batch of %zu file(s)\n", inFilenames.size());
+    fflush(stdout);
+
+    batch.Run([&settings](const wchar_t *inFilename, const wchar_t *outFilename) {
+        return ApplyChainToAudioFile(inFilename, outFilename,
+            settings.m_useFloat, settings.m_useBytesPerSample, settings.m_stages);
+    });
+
+    size_t errorCount = batch.GetErrorCount();
+    printname();
+    printf("Processed %zu file(s), %zu with errors.\n", batch.GetFiles().size(), errorCount);
+    for (const WaveformBatch::File &file : batch.GetFiles())
+    {
+        if (file.m_status != WaveformBatch::Status::Succeeded)
+            printf("  '%S' -> '%S':  %s\n", file.m_inFilename.c_str(), file.m_outFilename.c_str(),
+                WaveformBatch::GetStatusText(file.m_status));
+    }
+    fflush(stdout);
+
+    return errorCount == 0;
+}
+
+static void PrintUsage()
+{
+    printf(g_notice_thisispartof);
+    printf(g_notice_copyright_short);
+    printf(
+        "\n"
+        "Description:  WaveChain reads an audio file, applies a chain of \n"
+        "  effects to it one after another, and writes the result to a \n"
+        "  new audio file.  This gives the same result as running each \n"
+        "  effect's tool in turn, but the audio is loaded and saved only \n"
+        "  once, and isn't rounded to the output sample size in between. \n"
+        "\n"
+        "Usage:  wavechain [options] infile outfile stage [stage ...]\n"
+        "        wavechain -Batch=template [options] input [input ...] \n"
+        "            stage [stage ...]\n"
+        "\n"
+        "Where each stage is the name of an effect, followed by the \n"
+        "  parameters and options the effect's tool takes (except the \n"
+        "  file names, -Float, and -BytesPerSample): \n"
+        "\n"
+        "  eq lowpass highpass [-BandpassFreq=x] [-BandpassQ=x] \n"
+        "       [-NotchFreq=x] [-NotchQ=x] \n"
+        "  gate [-Threshold=x] [-TrimStart] [-TrimEnd] \n"
+        "  normalize dbLevel \n"
+        "  fade fadein fadeout \n"
+        "  volume volumeMultiplier \n"
+        "  echo delay repeat [-WetLevel=x] [-DryLevel=x] \n"
+        "  tremolo width depth [-UseTime] \n"
+        "  rate rate \n"
+        "  stretch multiplier \n"
+        "  extend before after [-UseTime] \n"
+        "  mono \n"
+        "  stereo \n"
+        "\n"
+        "  For example: \n"
+        "    wavechain in.wav out.wav eq 0 8000 gate -TrimEnd normalize -1 fade 2 3 \n"
+        "    wavechain -Batch=out\\{name}_eq.wav music\\*.flac eq 0 8000 \n"
+        "\n"
+        "Options:\n"
+        "  -Float=x : For file formats that support both integer and \n"
+        "       floating-point samples, this indicates which to use \n"
+        "       when writing 'outfile', where 'x' may be 'yes' or 'no'. \n"
+        "\n"
+        "  -BytesPerSample=x : For file formats that support multiple \n"
+        "       sample sizes, this indicates which sample size to use \n"
+        "       when writing 'outfile', where 'x' is typically 1, 2, 3, \n"
+        "       or 4 for integer samples, and 4 or 8 for floating-point \n"
+        "       samples. \n"
+        "\n"
+        "  -RawFormat=x : Sets the sample format of raw PCM input files, \n"
+        "       overriding any .hdr file, where 'x' is 'rate,channels,bytes' \n"
+        "       with an optional ',float' (e.g. '44100,2,2'); or, if 'x' \n"
+        "       is 'auto', guesses the sample size and channel count of \n"
+        "       raw files that don't have a .hdr file. \n"
+        "\n"
+        "  -Batch=x : Processes a batch of files, several at a time.  Each \n"
+        "       input may be a file name, a wildcard such as 'in\\*.wav', \n"
+        "       a directory (for the audio files in it), or '@' and the \n"
+        "       name of a text file that lists inputs one per line.  The \n"
+        "       output file names are made from the template 'x', where \n"
+        "       {dir}, {name}, and {ext} are replaced with the input \n"
+        "       file's directory, name, and extension, e.g. \n"
+        "       'out\\{name}_fx.wav'; or, if 'x' has none of these, it's \n"
+        "       the directory to write the outputs to.  A file that fails \n"
+        "       doesn't stop the others, and the failures are listed at \n"
+        "       the end. \n"
+        "\n"
+        "  -Threads=x : For batch mode, the most files to process at \n"
+        "       once.  The default is the number of CPUs. \n"
+        "\n"
+        "  -BatchMemory=x : For batch mode, limits the files processed \n"
+        "       at once to those whose audio fits in about 'x' megabytes. \n"
+        "\n"
+        "  -Profile : Times each stage of loading, converting, \n"
+        "             processing, and saving the audio, and prints a \n"
+        "             table of the times when done.  With \n"
+        "             '-Profile=file', writes them to the given file \n"
+        "             as JSON instead. \n"
+        "\n"
+        "  -MemStats : Counts the memory held in audio buffers by each \n"
+        "             stage, and prints a table of the most each stage \n"
+        "             held when done.  With '-MemStats=file', writes \n"
+        "             them to the given file as JSON instead. \n"
+        "\n"
+        "  -Trace=file : Records a timeline of each stage on each \n"
+        "             thread, and writes it to the given file in the \n"
+        "             Chrome trace format, for viewing in Perfetto \n"
+        "             (ui.perfetto.dev). \n"
+        "\n"
+        "  -ForceISA=x : Uses the given vector instructions for the \n"
+        "             sample loops:  'scalar' (none), 'sse2', 'avx2', \n"
+        "             'avx512', or 'neon'.  Normally the fastest ones \n"
+        "             the processor has are used. \n"
+        "\n"
+        "  -Help : Print this usage information to the console.\n"
+        "\n"
+        "  -License : Print the copyright notice and software license \n"
+        "             information to the console.\n"
+        );
+}
+
+// Parses the program's command line arguments, placing the
+// selected options into the settings structure.  Returns
+// true if successful.
+static bool ParseCommandLineArguments(
+    int argc,
+    wchar_t **argv,
+    ProgramSettings &settings
+    )
+{
+    if (argc < 2)
+    {
+        PrintUsage();
+        return false;
+    }
+
+    for (int iarg = 1; iarg < argc; iarg++)
+    {
+        bool haveFiles = settings.m_batchTemplate.empty() ?
+            !settings.m_inFilename.empty() && !settings.m_outFilename.empty() :
+            !settings.m_inFilename.empty() || !settings.m_batchInputs.empty();
+        const StageType *type = haveFiles ? FindStageType(argv[iarg]) : nullptr;
+        ChainStage *stage = settings.m_stages.empty() ? nullptr : &settings.m_stages.back();
+
+        if (type)
+        {
+            // The start of the next stage.
+            if (stage && stage->m_params.size() < stage->m_type->m_numParams)
+            {
+                printname();
+                printf("Not enough parameters for '%S' stage!\n", stage->m_type->m_name);
+                return false;
+            }
+            settings.m_stages.push_back(ChainStage());
+            settings.m_stages.back().m_type = type;
+        }
+        else if (stage)
+        {
+            // An option or parameter of the current stage.
+            if (IsOption(argv[iarg]))
+            {
+                if (!stage->m_type->m_parseOption || !stage->m_type->m_parseOption(argv[iarg], *stage))
+                {
+                    printname();
+                    printf("Invalid option '%S' for '%S' stage\n", argv[iarg], stage->m_type->m_name);
+                    return false;
+                }
+            }
+            else if (stage->m_params.size() < stage->m_type->m_numParams)
+            {
+                stage->m_params.push_back(static_cast<float>(_wtof(argv[iarg])));
+            }
+            else
+            {
+                printname();
+                printf("Too many parameters for '%S' stage! (\"%S\")\n", stage->m_type->m_name, argv[iarg]);
+                return false;
+            }
+        }
+        else if (IsOption(argv[iarg]))
+        {
+            if (OptionNameIs(argv[iarg], L"Help") || OptionNameIs(argv[iarg], L"?"))
+            {
+                // The user wants command line help.
+                PrintUsage();
+                return false;
+            }
+            else if (OptionNameIs(argv[iarg], L"Profile"))
+            {
+                // The user wants to see where the time goes.
+                WaveformProfileEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"MemStats"))
+            {
+                // The user wants to see where the memory goes.
+                WaveformMemStatsEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"Trace"))
+            {
+                // The user wants a timeline of the threads.
+                const wchar_t *traceFilename = OptionValue(argv[iarg]);
+                WaveformTraceEnable(traceFilename[0] ? traceFilename : L"trace.json");
+            }
+            else if (OptionNameIs(argv[iarg], L"ForceISA"))
+            {
+                // The user wants particular vector instructions used.
+                if (!DSPKernelsForceISA(OptionValue(argv[iarg])))
+                {
+                    printname();
+                    printf("Unsupported instruction set '%S'.\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+            }
+            else if (OptionNameIs(argv[iarg], L"License"))
+            {
+                // The user wants the long form copyright and license terms.
+                printf(g_notice_copyright_long);
+                return false;
+            }
+            else if (OptionNameIs(argv[iarg], L"Float"))
+            {
+                wchar_t first = OptionValue(argv[iarg])[0];
+                settings.m_useFloat = (first == 'y' || first == 't' || first == '1');
+            }
+            else if (OptionNameIs(argv[iarg], L"BytesPerSample"))
+            {
+                settings.m_useBytesPerSample = static_cast<unsigned>(_wtoi(OptionValue(argv[iarg])));
+                if (settings.m_useBytesPerSample < 1 || settings.m_useBytesPerSample > 8)
+                {
+                    printname();
+                    printf("Invalid sample size %u.\n", settings.m_useBytesPerSample);
+                    return false;
+                }
+            }
+            else if (OptionNameIs(argv[iarg], L"RawFormat"))
+            {
+                if (!WaveformSetRawFormatFromString(OptionValue(argv[iarg])))
+                {
+                    printname();
+                    printf("Invalid raw PCM format '%S'\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+            }
+            else if (OptionNameIs(argv[iarg], L"Batch"))
+            {
+                settings.m_batchTemplate = OptionValue(argv[iarg]);
+                if (settings.m_batchTemplate.empty())
+                {
+                    printname();
+                    printf("Missing output name template for batch.\n");
+                    return false;
+                }
+            }
+            else if (OptionNameIs(argv[iarg], L"Threads"))
+            {
+                int threads = _wtoi(OptionValue(argv[iarg]));
+                if (threads < 1)
+                {
+                    printname();
+                    printf("Invalid thread count '%S'\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+                settings.m_batchThreads = static_cast<unsigned>(threads);
+            }
+            else if (OptionNameIs(argv[iarg], L"BatchMemory"))
+            {
+                long long megabytes = _wtoi64(OptionValue(argv[iarg]));
+                if (megabytes < 1)
+                {
+                    printname();
+                    printf("Invalid batch memory limit '%S'\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+                settings.m_batchMemory = static_cast<size_t>(megabytes) * 1024 * 1024;
+            }
+            else
+            {
+                printname();
+                printf("Unrecognized option '%S'\n", argv[iarg]);
+                return false;
+            }
+        }
+        else if (!settings.m_batchTemplate.empty())
+        {
+            settings.m_batchInputs.push_back(argv[iarg]);
+        }
+        else if (settings.m_inFilename.empty())
+        {
+            settings.m_inFilename = argv[iarg];
+        }
+        else if (settings.m_outFilename.empty())
+        {
+            settings.m_outFilename = argv[iarg];
+        }
+        else
+        {
+            printname();
+            printf("Unrecognized stage '%S'\n", argv[iarg]);
+            return false;
+        }
+    }
+
+    // In batch mode, any file names given before the -Batch option
+    // are inputs too.
+    if (!settings.m_batchTemplate.empty())
+    {
+        if (!settings.m_outFilename.empty())
+            settings.m_batchInputs.insert(settings.m_batchInputs.begin(), settings.m_outFilename);
+        if (!settings.m_inFilename.empty())
+            settings.m_batchInputs.insert(settings.m_batchInputs.begin(), settings.m_inFilename);
+        settings.m_inFilename.clear();
+        settings.m_outFilename.clear();
+        if (settings.m_batchInputs.empty() || settings.m_stages.empty())
+        {
+            printname();
+            printf("Not enough arguments!\n");
+            return false;
+        }
+    }
+    else if (settings.m_inFilename.empty() || settings.m_outFilename.empty() || settings.m_stages.empty())
+    {
+        printname();
+        printf("Not enough arguments!\n");
+        return false;
+    }
+
+    const ChainStage &last = settings.m_stages.back();
+    if (last.m_params.size() < last.m_type->m_numParams)
+    {
+        printname();
+        printf("Not enough parameters for '%S' stage!\n", last.m_type->m_name);
+        return false;
+    }
+
+    return true;
+}
+
+// Application entry point.
+int wmain(int argc, wchar_t **argv)
+{
+    ProgramSettings settings;
+    if (!ParseCommandLineArguments(argc, argv, settings))
+        return EXIT_FAILURE;
+
+    // Audio written to standard output has to have it to itself.
+    if (settings.m_outFilename == L"-")
+        WaveformReserveStdout();
+
+    try
+    {
+        if (!settings.m_batchTemplate.empty())
+        {
+            if (!ApplyChainToBatch(settings))
+            {
+                printname();
+                printf("One or more error(s)!\n");
+                return EXIT_FAILURE;
+            }
+        }
+        else if (!ApplyChainToAudioFile(
+                settings.m_inFilename.c_str(),
+                settings.m_outFilename.c_str(),
+                settings.m_useFloat,
+                settings.m_useBytesPerSample,
+                settings.m_stages))
+        {
+            printname();
+            printf("One or more error(s)!\n");
+            return EXIT_FAILURE;
+        }
+    }
+    catch(...)
+    {
+        printname();
+        printf("Unexpected program exception!\n");
+        return EXIT_FAILURE;
+    }
+
+    printname();
+    printf("Completed OK.\n");
+    return EXIT_SUCCESS;
+}
+
@@ -42,7 +42,10 @@
 #include "notice.h"
 #include "waveform.h"
 #include "waveformload.h"
+#include "waveformprofile.h"
+#include "dspkernels.h"
 #include "cmdopt.h"
+#include "platform.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -155,6 +158,7 @@ static bool CompareAudioFiles(
 
     // Compare the samples in the two waveforms, accumulating
     // the differences as we go.
+    WaveformProfileScope profile("compare", wav1.GetNumSamples() * wav1.GetNumChannels(), wav1.GetTotalBytes() * 2);
     float sumDifferences = 0.0f;
     size_t numSamples = wav1.GetNumSamples();
     size_t numChannels = wav1.GetNumChannels();
@@ -207,6 +211,27 @@ static void PrintUsage()
         "                 waveforms are considered to be different from \n"
         "                 each other.  0.001 is the default.\n"
         "\n"
+        "  -Profile : Times each stage of loading, converting, \n"
+        "             processing, and saving the audio, and prints a \n"
+        "             table of the times when done.  With \n"
+        "             '-Profile=file', writes them to the given file \n"
+        "             as JSON instead. \n"
+        "\n"
+        "  -MemStats : Counts the memory held in audio buffers by each \n"
+        "             stage, and prints a table of the most each stage \n"
+        "             held when done.  With '-MemStats=file', writes \n"
+        "             them to the given file as JSON instead. \n"
+        "\n"
+        "  -Trace=file : Records a timeline of each stage on each \n"
+        "             thread, and writes it to the given file in the \n"
+        "             Chrome trace format, for viewing in Perfetto \n"
+        "             (ui.perfetto.dev). \n"
+        "\n"
+        "  -ForceISA=x : Uses the given vector instructions for the \n"
+        "             sample loops:  'scalar' (none), 'sse2', 'avx2', \n"
+        "             'avx512', or 'neon'.  Normally the fastest ones \n"
+        "             the processor has are used. \n"
+        "\n"
         "  -Help : Print this usage information to the console.\n"
         "\n"
         "  -License : Print the copyright notice and software license \n"
@@ -231,7 +256,7 @@ static bool ParseCommandLineArguments(
 
     for (int iarg = 1; iarg < argc; iarg++)
     {
-        if (argv[iarg][0] == '-')
+        if (IsOption(argv[iarg]))
         {
             if (OptionNameIs(argv[iarg], L"Help") || OptionNameIs(argv[iarg], L"?"))
             {
@@ -239,6 +264,32 @@ static bool ParseCommandLineArguments(
                 PrintUsage();
                 return false;
             }
+            else if (OptionNameIs(argv[iarg], L"Profile"))
+            {
+                // The user wants to see where the time goes.
+                WaveformProfileEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"MemStats"))
+            {
+                // The user wants to see where the memory goes.
+                WaveformMemStatsEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"Trace"))
+            {
+                // The user wants a timeline of the threads.
+                const wchar_t *traceFilename = OptionValue(argv[iarg]);
+                WaveformTraceEnable(traceFilename[0] ? traceFilename : L"trace.json");
+            }
+            else if (OptionNameIs(argv[iarg], L"ForceISA"))
+            {
+                // The user wants particular vector instructions used.
+                if (!DSPKernelsForceISA(OptionValue(argv[iarg])))
+                {
+                    printname();
+                    printf("Unsupported instruction set '%S'.\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+            }
             else if (OptionNameIs(argv[iarg], L"License"))
             {
                 // The user wants the long form copyright and license terms.
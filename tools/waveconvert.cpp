@@ -44,7 +44,11 @@
 #include "waveform.h"
 #include "waveformload.h"
 #include "waveformsave.h"
+#include "waveformbatch.h"
+#include "waveformprofile.h"
+#include "dspkernels.h"
 #include "cmdopt.h"
+#include "platform.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -78,6 +82,18 @@ struct ProgramSettings
     // integer samples, and 4 or 8 for floating-point
     // samples.
     unsigned m_useBytesPerSample = 2;
+
+    // For batch mode, the template for naming the output files,
+    // and the input files, wildcards, directories, and lists of
+    // files to process.  The template is empty if not in batch mode.
+    std::wstring m_batchTemplate;
+    std::vector<std::wstring> m_batchInputs;
+
+    // For batch mode, the most files to process at once (zero for
+    // one per CPU), and the limit on the memory they may use at
+    // once in bytes (zero for no limit).
+    unsigned m_batchThreads = 0;
+    size_t m_batchMemory = 0;
 };
 
 // Print the program name prefix to stdout.
@@ -171,6 +187,45 @@ static bool ConvertAudioFile(
     return true;
 }
 
+//
+// Converts each file of a batch, several files at a time, and
+// reports the files that failed.  Returns true if every file was
+// converted successfully.
+//
+static bool ConvertBatch(const ProgramSettings &settings)
+{
+    std::vector<std::wstring> inFilenames;
+    if (!WaveformBatchExpandInputs(settings.m_batchInputs, inFilenames))
+        return false;
+
+    WaveformBatch batch;
+    batch.SetThreadCount(settings.m_batchThreads);
+    batch.SetMemoryBudget(settings.m_batchMemory);
+    batch.AddFiles(inFilenames, settings.m_batchTemplate.c_str());
+
+    printname();
+    printf("Converting a batch of %zu file(s)\n", inFilenames.size());
+    fflush(stdout);
+
+    batch.Run([&settings](const wchar_t *inFilename, const wchar_t *outFilename) {
+        return ConvertAudioFile(inFilename, outFilename,
+            settings.m_useFloat, settings.m_useBytesPerSample, settings.m_useChannels);
+    });
+
+    size_t errorCount = batch.GetErrorCount();
+    printname();
+    printf("Converted %zu file(s), %zu with errors.\n", batch.GetFiles().size(), errorCount);
+    for (const WaveformBatch::File &file : batch.GetFiles())
+    {
+        if (file.m_status != WaveformBatch::Status::Succeeded)
+            printf("  '%S' -> '%S':  %s\n", file.m_inFilename.c_str(), file.m_outFilename.c_str(),
+                WaveformBatch::GetStatusText(file.m_status));
+    }
+    fflush(stdout);
+
+    return errorCount == 0;
+}
+
 static void PrintUsage()
 {
     printf(g_notice_thisispartof);
@@ -182,6 +237,7 @@ static void PrintUsage()
         "  format or with a different sample encoding format. \n"
         "\n"
         "Usage:  waveconvert [options] infile outfile\n"
+        "        waveconvert -Batch=template [options] input [input ...]\n"
         "\n"
         "Options:\n"
         "  -Mono : Convert the audio to mono (one channel).\n"
@@ -194,9 +250,54 @@ static void PrintUsage()
         "\n"
         "  -BytesPerSample=x : For file formats that support multiple \n"
         "       sample sizes, this indicates which sample size to use, \n"
-        "       where 'x' is typically 1, 2, or 4 for integer samples, \n"
+        "       where 'x' is typically 1, 2, 3, or 4 for integer samples, \n"
         "       and 4 or 8 for floating-point samples. \n"
         "\n"
+        "  -RawFormat=x : Sets the sample format of raw PCM input files, \n"
+        "       overriding any .hdr file, where 'x' is 'rate,channels,bytes' \n"
+        "       with an optional ',float' (e.g. '44100,2,2'); or, if 'x' \n"
+        "       is 'auto', guesses the sample size and channel count of \n"
+        "       raw files that don't have a .hdr file. \n"
+        "\n"
+        "  -Batch=x : Converts a batch of files, several at a time.  Each \n"
+        "       input may be a file name, a wildcard such as 'in\\*.flac', \n"
+        "       a directory (for the audio files in it), or '@' and the \n"
+        "       name of a text file that lists inputs one per line.  The \n"
+        "       output file names are made from the template 'x', where \n"
+        "       {dir}, {name}, and {ext} are replaced with the input \n"
+        "       file's directory, name, and extension, e.g. \n"
+        "       'out\\{name}.wav'; or, if 'x' has none of these, it's \n"
+        "       the directory to write the outputs to.  A file that fails \n"
+        "       doesn't stop the others, and the failures are listed at \n"
+        "       the end. \n"
+        "\n"
+        "  -Threads=x : For batch mode, the most files to convert at \n"
+        "       once.  The default is the number of CPUs. \n"
+        "\n"
+        "  -BatchMemory=x : For batch mode, limits the files converted \n"
+        "       at once to those whose audio fits in about 'x' megabytes. \n"
+        "\n"
+        "  -Profile : Times each stage of loading, converting, \n"
+        "             processing, and saving the audio, and prints a \n"
+        "             table of the times when done.  With \n"
+        "             '-Profile=file', writes them to the given file \n"
+        "             as JSON instead. \n"
+        "\n"
+        "  -MemStats : Counts the memory held in audio buffers by each \n"
+        "             stage, and prints a table of the most each stage \n"
+        "             held when done.  With '-MemStats=file', writes \n"
+        "             them to the given file as JSON instead. \n"
+        "\n"
+        "  -Trace=file : Records a timeline of each stage on each \n"
+        "             thread, and writes it to the given file in the \n"
+        "             Chrome trace format, for viewing in Perfetto \n"
+        "             (ui.perfetto.dev). \n"
+        "\n"
+        "  -ForceISA=x : Uses the given vector instructions for the \n"
+        "             sample loops:  'scalar' (none), 'sse2', 'avx2', \n"
+        "             'avx512', or 'neon'.  Normally the fastest ones \n"
+        "             the processor has are used. \n"
+        "\n"
         "  -Help : Print this usage information to the console.\n"
         "\n"
         "  -License : Print the copyright notice and software license \n"
@@ -221,7 +322,7 @@ static bool ParseCommandLineArguments(
 
     for (int iarg = 1; iarg < argc; iarg++)
     {
-        if (argv[iarg][0] == '-')
+        if (IsOption(argv[iarg]))
         {
             if (OptionNameIs(argv[iarg], L"Help") || OptionNameIs(argv[iarg], L"?"))
             {
@@ -229,6 +330,32 @@ static bool ParseCommandLineArguments(
                 PrintUsage();
                 return false;
             }
+            else if (OptionNameIs(argv[iarg], L"Profile"))
+            {
+                // The user wants to see where the time goes.
+                WaveformProfileEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"MemStats"))
+            {
+                // The user wants to see where the memory goes.
+                WaveformMemStatsEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"Trace"))
+            {
+                // The user wants a timeline of the threads.
+                const wchar_t *traceFilename = OptionValue(argv[iarg]);
+                WaveformTraceEnable(traceFilename[0] ? traceFilename : L"trace.json");
+            }
+            else if (OptionNameIs(argv[iarg], L"ForceISA"))
+            {
+                // The user wants particular vector instructions used.
+                if (!DSPKernelsForceISA(OptionValue(argv[iarg])))
+                {
+                    printname();
+                    printf("Unsupported instruction set '%S'.\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+            }
             else if (OptionNameIs(argv[iarg], L"License"))
             {
                 // The user wants the long form copyright and license terms.
@@ -258,6 +385,47 @@ static bool ParseCommandLineArguments(
             {
                 settings.m_useChannels = 2;
             }
+            else if (OptionNameIs(argv[iarg], L"RawFormat"))
+            {
+                if (!WaveformSetRawFormatFromString(OptionValue(argv[iarg])))
+                {
+                    printname();
+                    printf("Invalid raw PCM format '%S'\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+            }
+            else if (OptionNameIs(argv[iarg], L"Batch"))
+            {
+                settings.m_batchTemplate = OptionValue(argv[iarg]);
+                if (settings.m_batchTemplate.empty())
+                {
+                    printname();
+                    printf("Missing output name template for batch.\n");
+                    return false;
+                }
+            }
+            else if (OptionNameIs(argv[iarg], L"Threads"))
+            {
+                int threads = _wtoi(OptionValue(argv[iarg]));
+                if (threads < 1)
+                {
+                    printname();
+                    printf("Invalid thread count '%S'\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+                settings.m_batchThreads = static_cast<unsigned>(threads);
+            }
+            else if (OptionNameIs(argv[iarg], L"BatchMemory"))
+            {
+                long long megabytes = _wtoi64(OptionValue(argv[iarg]));
+                if (megabytes < 1)
+                {
+                    printname();
+                    printf("Invalid batch memory limit '%S'\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+                settings.m_batchMemory = static_cast<size_t>(megabytes) * 1024 * 1024;
+            }
             else
             {
                 printname();
@@ -265,6 +433,10 @@ static bool ParseCommandLineArguments(
                 return false;
             }
         }
+        else if (!settings.m_batchTemplate.empty())
+        {
+            settings.m_batchInputs.push_back(argv[iarg]);
+        }
         else if (settings.m_inFilename.empty())
         {
             settings.m_inFilename = argv[iarg];
@@ -281,7 +453,24 @@ static bool ParseCommandLineArguments(
         }
     }
 
-    if (settings.m_inFilename.empty() || settings.m_outFilename.empty())
+    // In batch mode, any file names given before the -Batch option
+    // are inputs too.
+    if (!settings.m_batchTemplate.empty())
+    {
+        if (!settings.m_outFilename.empty())
+            settings.m_batchInputs.insert(settings.m_batchInputs.begin(), settings.m_outFilename);
+        if (!settings.m_inFilename.empty())
+            settings.m_batchInputs.insert(settings.m_batchInputs.begin(), settings.m_inFilename);
+        settings.m_inFilename.clear();
+        settings.m_outFilename.clear();
+        if (settings.m_batchInputs.empty())
+        {
+            printname();
+            printf("Not enough arguments!\n");
+            return false;
+        }
+    }
+    else if (settings.m_inFilename.empty() || settings.m_outFilename.empty())
     {
         printname();
         printf("Not enough arguments!\n");
@@ -299,9 +488,22 @@ int wmain(int argc, wchar_t **argv)
     if (!ParseCommandLineArguments(argc, argv, settings))
         return EXIT_FAILURE;
 
+    // Audio written to standard output has to have it to itself.
+    if (settings.m_outFilename == L"-")
+        WaveformReserveStdout();
+
     try
     {
-        if (!ConvertAudioFile(
+        if (!settings.m_batchTemplate.empty())
+        {
+            if (!ConvertBatch(settings))
+            {
+                printname();
+                printf("One or more error(s)!\n");
+                return EXIT_FAILURE;
+            }
+        }
+        else if (!ConvertAudioFile(
                 settings.m_inFilename.c_str(),
                 settings.m_outFilename.c_str(),
                 settings.m_useFloat,
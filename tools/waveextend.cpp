@@ -43,7 +43,10 @@
 #include "waveform.h"
 #include "waveformload.h"
 #include "waveformsave.h"
+#include "waveformprofile.h"
+#include "dspkernels.h"
 #include "cmdopt.h"
+#include "platform.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -237,6 +240,24 @@ static void PrintUsage()
         "       4 for integer samples, and 4 or 8 for floating-point \n"
         "       samples. \n"
         "\n"
+        "  -Profile : Times each stage of loading, converting, processing, \n"
+        "       and saving the audio, and prints a table of the times when \n"
+        "       done.  With '-Profile=file', writes them to the given file \n"
+        "       as JSON instead. \n"
+        "\n"
+        "  -MemStats : Counts the memory held in audio buffers by each \n"
+        "       stage, and prints a table of the most each stage held when \n"
+        "       done.  With '-MemStats=file', writes them to the given file \n"
+        "       as JSON instead. \n"
+        "\n"
+        "  -Trace=file : Records a timeline of each stage on each thread, \n"
+        "       and writes it to the given file in the Chrome trace format, \n"
+        "       for viewing in Perfetto (ui.perfetto.dev). \n"
+        "\n"
+        "  -ForceISA=x : Uses the given vector instructions for the sample \n"
+        "       loops:  'scalar' (none), 'sse2', 'avx2', 'avx512', or 'neon'. \n"
+        "       Normally the fastest ones the processor has are used. \n"
+        "\n"
         "  -Help : Print this usage information to the console.\n"
         "\n"
         "  -License : Print the copyright notice and software license \n"
@@ -261,7 +282,7 @@ static bool ParseCommandLineArguments(
 
     for (int iarg = 1; iarg < argc; iarg++)
     {
-        if (argv[iarg][0] == '-')
+        if (IsOption(argv[iarg]))
         {
             if (OptionNameIs(argv[iarg], L"Help") || OptionNameIs(argv[iarg], L"?"))
             {
@@ -269,6 +290,32 @@ static bool ParseCommandLineArguments(
                 PrintUsage();
                 return false;
             }
+            else if (OptionNameIs(argv[iarg], L"Profile"))
+            {
+                // The user wants to see where the time goes.
+                WaveformProfileEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"MemStats"))
+            {
+                // The user wants to see where the memory goes.
+                WaveformMemStatsEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"Trace"))
+            {
+                // The user wants a timeline of the threads.
+                const wchar_t *traceFilename = OptionValue(argv[iarg]);
+                WaveformTraceEnable(traceFilename[0] ? traceFilename : L"trace.json");
+            }
+            else if (OptionNameIs(argv[iarg], L"ForceISA"))
+            {
+                // The user wants particular vector instructions used.
+                if (!DSPKernelsForceISA(OptionValue(argv[iarg])))
+                {
+                    printname();
+                    printf("Unsupported instruction set '%S'.\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+            }
             else if (OptionNameIs(argv[iarg], L"License"))
             {
                 // The user wants the long form copyright and license terms.
@@ -365,6 +412,10 @@ int wmain(int argc, wchar_t **argv)
     if (!ParseCommandLineArguments(argc, argv, settings))
         return EXIT_FAILURE;
 
+    // Audio written to standard output has to have it to itself.
+    if (settings.m_outFilename == L"-")
+        WaveformReserveStdout();
+
     try
     {
         if (!ExtendAudioFile(
@@ -44,7 +44,12 @@
 #include "waveform.h"
 #include "waveformload.h"
 #include "waveformsave.h"
+#include "waveformgraph.h"
+#include "waveformprocessors.h"
+#include "waveformprofile.h"
+#include "dspkernels.h"
 #include "cmdopt.h"
+#include "platform.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -106,77 +111,50 @@ static bool AddFadeInOutToAudioFile(
     printf("  Preferred sample size:  %u\n", useBytesPerSample);
 
     //
-    // Load the input file.
+    // Set up a graph that streams the input file through the
+    // fade processor to the output file a block at a time, so
+    // the whole file never has to be held in memory.  The file is
+    // read and written on threads of their own while the blocks
+    // are being processed.
     //
 
-    Waveform wav;
-    if (!WaveformLoadFromFile(inFilename, wav, nullptr, nullptr))
+    WaveformGraph graph;
+    graph.SetPipelineDepth(WaveformGraph::kDefaultPipelineDepth);
+    WaveformFileSource source(inFilename);
+    FadeProcessor fadeProcessor(fadeInSeconds, fadeOutSeconds);
+    size_t output = graph.AddProcessor(fadeProcessor, graph.AddSource(source));
+    if (!graph.Prepare())
     {
         printname();
         printf("Failed loading audio data from \"%S\"!\n", inFilename);
         return false;
     }
-    size_t numSamples = wav.GetNumSamples();
-    size_t numChannels = wav.GetNumChannels();
 
+    const WaveformFormat &format = graph.GetFormat(output);
     printname();
-    printf("Loaded %zu samples (%.2f seconds) from '%S' at %u Hz\n",
-        wav.GetNumSamples(), wav.GetDurationInSeconds(), inFilename, wav.GetRate());
+    printf("Reading %zu samples (%.2f seconds) from '%S' at %u Hz\n",
+        format.m_numSamples, format.GetDurationInSeconds(), inFilename, format.m_rate);
     fflush(stdout);
 
-    if (fadeInSeconds > wav.GetDurationInSeconds())
-        fadeInSeconds = wav.GetDurationInSeconds();
-    if (fadeOutSeconds > wav.GetDurationInSeconds())
-        fadeOutSeconds = wav.GetDurationInSeconds();
-
-    // Calculate the duration of the fades in samples instead of seconds.
-    size_t numFadeInSamples = static_cast<unsigned>(wav.TimeToSampleIndex(fadeInSeconds) * numChannels);
-    size_t numFadeOutSamples = static_cast<unsigned>(wav.TimeToSampleIndex(fadeOutSeconds) * numChannels);
-
-    //
-    // Apply the fades to the waveform's samples.
-    //
-
     printname();
     printf("Applying %zu samples of fade-in and %zu samples of fade-out to waveform.\n",
-        numFadeInSamples / numChannels, numFadeOutSamples / numChannels);
+        fadeProcessor.GetFadeInSamples(), fadeProcessor.GetFadeOutSamples());
     fflush(stdout);
 
-    size_t fadeOutStart = (numSamples * numChannels) - numFadeOutSamples;
-    float *sample = wav.GetSamplesPtr();
-    for (size_t index = 0; index < numSamples * numChannels; index++)
-    {
-        float value = *sample;
-
-        if (index < numFadeInSamples)
-        {
-            float multiplier = (static_cast<float>(index) / (numFadeInSamples * numChannels));
-            value *= multiplier;
-        }
-        if (index >= fadeOutStart)
-        {
-            float multiplier = 1.0f - (static_cast<float>(index - fadeOutStart) / (numFadeOutSamples * numChannels));
-            value *= multiplier;
-        }
-
-        value = Waveform::ClipValue(value, -1, 1);
-        *sample++ = value;
-    }
-
     //
-    // Save the altered waveform to the output file.
+    // Run the audio through the graph into the output file.
     //
 
     printname();
     printf("Saving %zu samples (%.2f seconds) to '%S' at %u Hz\n",
-        wav.GetNumSamples(), wav.GetDurationInSeconds(), outFilename, wav.GetRate());
+        format.m_numSamples, format.GetDurationInSeconds(), outFilename, format.m_rate);
     fflush(stdout);
 
-    if (!WaveformSaveToFile(outFilename, wav, nullptr, nullptr,
-                            useFloat, useBytesPerSample))
+    WaveformFileSink sink(outFilename, useFloat, useBytesPerSample);
+    if (!graph.Run(output, sink))
     {
         printname();
-        printf("Failed saving audio data to \"%S\"!\n", outFilename);
+        printf("Failed processing audio data from \"%S\" to \"%S\"!\n", inFilename, outFilename);
         return false;
     }
 
@@ -219,6 +197,24 @@ static void PrintUsage()
         "       4 for integer samples, and 4 or 8 for floating-point \n"
         "       samples. \n"
         "\n"
+        "  -Profile : Times each stage of loading, converting, processing, \n"
+        "       and saving the audio, and prints a table of the times when \n"
+        "       done.  With '-Profile=file', writes them to the given file \n"
+        "       as JSON instead. \n"
+        "\n"
+        "  -MemStats : Counts the memory held in audio buffers by each \n"
+        "       stage, and prints a table of the most each stage held when \n"
+        "       done.  With '-MemStats=file', writes them to the given file \n"
+        "       as JSON instead. \n"
+        "\n"
+        "  -Trace=file : Records a timeline of each stage on each thread, \n"
+        "       and writes it to the given file in the Chrome trace format, \n"
+        "       for viewing in Perfetto (ui.perfetto.dev). \n"
+        "\n"
+        "  -ForceISA=x : Uses the given vector instructions for the sample \n"
+        "       loops:  'scalar' (none), 'sse2', 'avx2', 'avx512', or 'neon'. \n"
+        "       Normally the fastest ones the processor has are used. \n"
+        "\n"
         "  -Help : Print this usage information to the console.\n"
         "\n"
         "  -License : Print the copyright notice and software license \n"
@@ -244,7 +240,7 @@ static bool ParseCommandLineArguments(
     unsigned nonopts = 0;
     for (int iarg = 1; iarg < argc; iarg++)
     {
-        if (argv[iarg][0] == '-')
+        if (IsOption(argv[iarg]))
         {
             if (OptionNameIs(argv[iarg], L"Help") || OptionNameIs(argv[iarg], L"?"))
             {
@@ -252,6 +248,32 @@ static bool ParseCommandLineArguments(
                 PrintUsage();
                 return false;
             }
+            else if (OptionNameIs(argv[iarg], L"Profile"))
+            {
+                // The user wants to see where the time goes.
+                WaveformProfileEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"MemStats"))
+            {
+                // The user wants to see where the memory goes.
+                WaveformMemStatsEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"Trace"))
+            {
+                // The user wants a timeline of the threads.
+                const wchar_t *traceFilename = OptionValue(argv[iarg]);
+                WaveformTraceEnable(traceFilename[0] ? traceFilename : L"trace.json");
+            }
+            else if (OptionNameIs(argv[iarg], L"ForceISA"))
+            {
+                // The user wants particular vector instructions used.
+                if (!DSPKernelsForceISA(OptionValue(argv[iarg])))
+                {
+                    printname();
+                    printf("Unsupported instruction set '%S'.\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+            }
             else if (OptionNameIs(argv[iarg], L"License"))
             {
                 // The user wants the long form copyright and license terms.
@@ -335,6 +357,10 @@ int wmain(int argc, wchar_t **argv)
     if (!ParseCommandLineArguments(argc, argv, settings))
         return EXIT_FAILURE;
 
+    // Audio written to standard output has to have it to itself.
+    if (settings.m_outFilename == L"-")
+        WaveformReserveStdout();
+
     try
     {
         if (!AddFadeInOutToAudioFile(
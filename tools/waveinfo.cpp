@@ -42,12 +42,17 @@
 #include "notice.h"
 #include "waveform.h"
 #include "waveformload.h"
+#include "waveformbatch.h"
+#include "waveformprofile.h"
+#include "dspkernels.h"
+#include "platform.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <math.h>
 #include <wchar.h>
 #include <vector>
+#include <string>
 
 // Print the program name prefix to stdout.
 const wchar_t *program_name = L"WaveInfo";
@@ -72,33 +77,44 @@ void print_duration(float seconds)
 }
 
 // Prints information about the given audio file to stdout.
-bool process_audio_file(const wchar_t *filename)
+// The format and length come from the file's headers alone.
+// If 'showStats' is true, the audio data is also scanned to
+// find the highest and lowest sample values.
+bool process_audio_file(const wchar_t *filename, bool showStats)
 {
     printname();
     printf("Processing '%S'\n", filename);
 
-    Waveform wav;
-    if (!WaveformLoadFromFile(filename, wav, nullptr, nullptr))
+    WaveformFileInfo info;
+    if (!WaveformReadFileInfo(filename, info, showStats))
     {
         printname();
-        printf("Failed loading audio data from \"%S\"\n", filename);
+        printf("Failed reading audio information from \"%S\"\n", filename);
         return false;
     }
 
     printf("Waveform information:\n");
-    printf("  Samples:     %zu\n", wav.GetNumSamples());
-    printf("  Rate:        %u Hz\n", wav.GetRate());
-    printf("  Channels:    %zu\n", wav.GetNumChannels());
-    printf("  Duration:    %.2f seconds\n", wav.GetDurationInSeconds());
-    printf("  FPCM Bytes:  %zu\n", wav.GetTotalBytes());
+    if (info.m_bitsPerSample)
+        printf("  Format:      %s, %u-bit %s\n", info.m_format, info.m_bitsPerSample, info.m_isFloat ? "float" : "integer");
+    else if (info.m_bitrate)
+        printf("  Format:      %s, %u kbit/s\n", info.m_format, info.m_bitrate);
+    else
+        printf("  Format:      %s\n", info.m_format);
+    printf("  Samples:     %zu\n", info.m_numSamples);
+    printf("  Rate:        %u Hz\n", info.m_rate);
+    printf("  Channels:    %zu\n", info.m_numChannels);
+    if (info.m_channelMask)
+        printf("  Speakers:    0x%08X\n", info.m_channelMask);
+    printf("  Duration:    %.2f seconds\n", info.GetDurationInSeconds());
+    printf("  FPCM Bytes:  %zu\n", info.m_numSamples * info.m_numChannels * sizeof(float));
     fflush(stdout);
 
-    float high = wav.GetHighestSample();
-    float low = wav.GetLowestSample();
-
-    printf("  Highest sample:  %8.2f\n", high);
-    printf("  Lowest sample:   %8.2f\n", low);
-    fflush(stdout);
+    if (info.m_hasStats)
+    {
+        printf("  Highest sample:  %8.2f\n", info.m_highestSample);
+        printf("  Lowest sample:   %8.2f\n", info.m_lowestSample);
+        fflush(stdout);
+    }
 
     return true;
 }
@@ -114,7 +130,46 @@ static void PrintUsage()
         "\n"
         "Usage:  waveinfo [options] file1.wav [file2.wav ...]\n"
         "\n"
+        "Each file may also be a wildcard such as 'music\\*.mp3', a \n"
+        "  directory (for the audio files in it), or '@' and the name of \n"
+        "  a text file that lists files one per line. \n"
+        "\n"
         "Options:\n"
+        "  -Stats : Also read through the audio data and show the highest \n"
+        "           and lowest sample values.  Without this option only \n"
+        "           the file headers are read, which is much faster. \n"
+        "\n"
+        "  -IndexCache : For MP3 files, saves the index of where each \n"
+        "           frame starts in a file named 'file.mp3.idx', so \n"
+        "           later runs don't have to scan the frame headers. \n"
+        "\n"
+        "  -RawFormat=x : Sets the sample format of raw PCM input files, \n"
+        "       overriding any .hdr file, where 'x' is 'rate,channels,bytes' \n"
+        "       with an optional ',float' (e.g. '44100,2,2'); or, if 'x' \n"
+        "       is 'auto', guesses the sample size and channel count of \n"
+        "       raw files that don't have a .hdr file. \n"
+        "\n"
+        "  -Profile : Times each stage of loading, converting, \n"
+        "             processing, and saving the audio, and prints a \n"
+        "             table of the times when done.  With \n"
+        "             '-Profile=file', writes them to the given file \n"
+        "             as JSON instead. \n"
+        "\n"
+        "  -MemStats : Counts the memory held in audio buffers by each \n"
+        "             stage, and prints a table of the most each stage \n"
+        "             held when done.  With '-MemStats=file', writes \n"
+        "             them to the given file as JSON instead. \n"
+        "\n"
+        "  -Trace=file : Records a timeline of each stage on each \n"
+        "             thread, and writes it to the given file in the \n"
+        "             Chrome trace format, for viewing in Perfetto \n"
+        "             (ui.perfetto.dev). \n"
+        "\n"
+        "  -ForceISA=x : Uses the given vector instructions for the \n"
+        "             sample loops:  'scalar' (none), 'sse2', 'avx2', \n"
+        "             'avx512', or 'neon'.  Normally the fastest ones \n"
+        "             the processor has are used. \n"
+        "\n"
         "  -Help : Print this usage information to the console.\n"
         "\n"
         "  -License : Print the copyright notice and software license \n"
@@ -132,27 +187,102 @@ int wmain(int argc, wchar_t **argv)
         return EXIT_FAILURE;
     }
 
+    // Check for options first, since they apply to every file.
+    bool showStats = false;
+    for (int iarg = 1; iarg < argc; iarg++)
+    {
+        if (_wcsicmp(argv[iarg], L"-Help") == 0)
+        {
+            PrintUsage();
+            return EXIT_SUCCESS;
+        }
+        else if (_wcsicmp(argv[iarg], L"-License") == 0)
+        {
+            printf(g_notice_copyright_long);
+            return EXIT_SUCCESS;
+        }
+        else if (_wcsicmp(argv[iarg], L"-Profile") == 0 || _wcsnicmp(argv[iarg], L"-Profile=", 9) == 0)
+        {
+            // The user wants to see where the time goes.
+            WaveformProfileEnable(argv[iarg][8] == '=' ? argv[iarg] + 9 : nullptr);
+        }
+        else if (_wcsicmp(argv[iarg], L"-MemStats") == 0 || _wcsnicmp(argv[iarg], L"-MemStats=", 10) == 0)
+        {
+            // The user wants to see where the memory goes.
+            WaveformMemStatsEnable(argv[iarg][9] == '=' ? argv[iarg] + 10 : nullptr);
+        }
+        else if (_wcsicmp(argv[iarg], L"-Trace") == 0 || _wcsnicmp(argv[iarg], L"-Trace=", 7) == 0)
+        {
+            // The user wants a timeline of the threads.
+            WaveformTraceEnable(argv[iarg][6] == '=' && argv[iarg][7] ? argv[iarg] + 7 : L"trace.json");
+        }
+        else if (_wcsnicmp(argv[iarg], L"-ForceISA=", 10) == 0)
+        {
+            // The user wants particular vector instructions used.
+            if (!DSPKernelsForceISA(argv[iarg] + 10))
+            {
+                printname();
+                printf("Unsupported instruction set '%S'.\n", argv[iarg] + 10);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (_wcsicmp(argv[iarg], L"-Stats") == 0)
+        {
+            showStats = true;
+        }
+        else if (_wcsicmp(argv[iarg], L"-IndexCache") == 0)
+        {
+            WaveformSetIndexCache(true);
+        }
+        else if (_wcsnicmp(argv[iarg], L"-RawFormat=", 11) == 0)
+        {
+            if (!WaveformSetRawFormatFromString(argv[iarg] + 11))
+            {
+                printname();
+                printf("Invalid raw PCM format '%S'\n", argv[iarg] + 11);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (argv[iarg][0] == '-' && argv[iarg][1] != '\0')
+        {
+            printname();
+            printf("Unrecognized option '%S'\n", argv[iarg]);
+            return EXIT_FAILURE;
+        }
+    }
+
     unsigned error_count = 0;
     try
     {
-        // Process each WAV file that was given on the command line.
+        // Process each audio file that was given on the command line.
         for (int iarg = 1; iarg < argc; iarg++)
         {
-            if (_wcsicmp(argv[iarg], L"-Help") == 0)
-            {
-                PrintUsage();
-                return EXIT_SUCCESS;
-            }
-            else if (_wcsicmp(argv[iarg], L"-License") == 0)
+            if (argv[iarg][0] == '-' && argv[iarg][1] != '\0')
+                continue;
+
+            // Expand any wildcards, directories, and file lists.
+            // Standard input is passed through as it is.
+            std::vector<std::wstring> filenames;
+            if (wcscmp(argv[iarg], L"-") == 0)
             {
-                printf(g_notice_copyright_long);
-                return EXIT_SUCCESS;
+                filenames.push_back(argv[iarg]);
             }
-            else if (!process_audio_file(argv[iarg]))
+            else if (!WaveformBatchExpandInputs(std::vector<std::wstring>(1, argv[iarg]), filenames))
             {
                 printname();
                 printf("One or more error(s) processing %S!\n", argv[iarg]);
                 ++error_count;
+                continue;
+            }
+
+            for (const std::wstring &filename : filenames)
+            {
+                if (!process_audio_file(filename.c_str(), showStats))
+                {
+                    printname();
+                    printf("One or more error(s) processing %S!\n", filename.c_str());
+                    ++error_count;
+                }
             }
         }
     }
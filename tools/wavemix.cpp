@@ -44,7 +44,12 @@
 #include "waveform.h"
 #include "waveformload.h"
 #include "waveformsave.h"
+#include "waveformgraph.h"
+#include "waveformprocessors.h"
+#include "waveformprofile.h"
+#include "dspkernels.h"
 #include "cmdopt.h"
+#include "platform.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -53,6 +58,7 @@
 #include <ctype.h>
 #include <vector>
 #include <string>
+#include <memory>
 
 // Name and parameters for one of the audio files to be mixed.
 struct InFile
@@ -98,162 +104,105 @@ static bool MixToAudioFile(const ProgramSettings &settings)
     printf("  Preferred sample size:  %u\n", settings.m_useBytesPerSample);
 
     //
-    // Load the input files.
+    // Set up a graph that streams each input file, starting at its
+    // place in the mix, into the mix processor and on to the output
+    // file a block at a time, so no whole file ever has to be held
+    // in memory.  The files are read and written on threads of their
+    // own while the blocks are being mixed.
     //
 
-    std::vector<Waveform> wavs;
+    WaveformGraph graph;
+    graph.SetPipelineDepth(WaveformGraph::kDefaultPipelineDepth);
+    std::vector<std::unique_ptr<WaveformFileSource>> sources;
+    std::vector<std::unique_ptr<WaveformOffsetSource>> offsetSources;
+    std::vector<size_t> inputs;
+    std::vector<float> volumes;
     for (const auto &infile : settings.m_inFiles)
     {
-        Waveform wav;
-        if (!WaveformLoadFromFile(infile.m_filename.c_str(), wav, nullptr, nullptr))
+        sources.emplace_back(new WaveformFileSource(infile.m_filename.c_str()));
+        offsetSources.emplace_back(new WaveformOffsetSource(*sources.back(), infile.m_mixStartTimeSeconds));
+        inputs.push_back(graph.AddSource(*offsetSources.back()));
+        volumes.push_back(infile.m_mixVolume);
+    }
+
+    MixProcessor mixProcessor(volumes);
+    size_t output = graph.AddProcessor(mixProcessor, inputs);
+    if (!graph.Prepare())
+    {
+        // Find out which input file couldn't be opened.
+        for (size_t index = 0; index < sources.size(); index++)
         {
-            printname();
-            printf("Failed loading audio data from \"%S\"!\n", infile.m_filename.c_str());
-            return false;
+            WaveformFormat format;
+            if (!sources[index]->Open(format))
+            {
+                printname();
+                printf("Failed loading audio data from \"%S\"!\n", settings.m_inFiles[index].m_filename.c_str());
+                return false;
+            }
         }
 
-        wavs.push_back(wav);
+        printname();
+        printf("Failed setting up the mix!\n");
+        return false;
     }
 
     printname();
-    printf("Loaded %zu input file(s).\n", wavs.size());
+    printf("Opened %zu input file(s).\n", inputs.size());
     fflush(stdout);
 
-    // Determine the min and max number of channels used in
-    // all of the input sounds.
+    // Determine the min and max number of channels, and the min
+    // and max sampling rates, used in all of the input sounds.
     size_t minChannels = 99;
     size_t maxChannels = 0;
-    for (const auto &wav : wavs)
+    unsigned minRate = 999999;
+    unsigned maxRate = 0;
+    for (size_t input : inputs)
     {
-        size_t numChannels = wav.GetNumChannels();
-        if (numChannels > maxChannels)
-            maxChannels = numChannels;
-        if (numChannels < minChannels)
-            minChannels = numChannels;
+        const WaveformFormat &format = graph.GetFormat(input);
+        if (format.m_numChannels > maxChannels)
+            maxChannels = format.m_numChannels;
+        if (format.m_numChannels < minChannels)
+            minChannels = format.m_numChannels;
+        if (format.m_rate > maxRate)
+            maxRate = format.m_rate;
+        if (format.m_rate < minRate)
+            minRate = format.m_rate;
     }
 
-    // If the sounds don't have the same number of channels,
-    // convert them all to stereo.
+    // If the sounds don't have the same number of channels, the
+    // mix processor mixes them all in stereo.
     if (minChannels != maxChannels)
     {
         printname();
         printf("Input files have inconsistent number of audio channels.\n");
         printf("Converting all input audio to stereo (2-channel) format.\n");
-
-        for (auto &wav : wavs)
-        {
-            if (!wav.ConvertToStereo())
-            {
-                printname();
-                printf("Failed converting waveform to stereo!\n");
-                return false;
-            }
-        }
     }
 
-    // Determine the min and max sampling rates used in
-    // all of the input sounds.
-    unsigned minRate = 999999;
-    unsigned maxRate = 0;
-    for (const auto &wav : wavs)
-    {
-        unsigned rate = wav.GetRate();
-        if (rate > maxRate)
-            maxRate = rate;
-        if (rate < minRate)
-            minRate = rate;
-    }
-
-    // If the files don't have the same sample rate,
-    // convert them all to the highest sample rate.
+    // Sounds at other sampling rates are mixed in at the rate of
+    // the first one, without resampling them.
     if (minRate != maxRate)
     {
         printname();
         printf("Input files have inconsistent sampling rates.\n");
-        printf("Converting all input audio to %u Hz.\n", maxRate);
-
-        for (auto &wav : wavs)
-        {
-            if (wav.GetRate() != maxRate)
-                continue;
-
-            if (!wav.Resample(maxRate))
-            {
-                printname();
-                printf("Failed resampling waveform to %u Hz!\n", maxRate);
-                return false;
-            }
-        }
-    }
-
-    size_t rate = wavs[0].GetRate();
-    size_t numChannels = wavs[0].GetNumChannels();
-
-    // Determine the overall length of the mixed output file.
-    // Also determines the starting sample number for each
-    // of the input files int the output.
-    float totalSeconds = 0.0f;
-    std::vector<size_t>  startSampleIndexes(wavs.size(), 0);
-    std::vector<float *> samplePtrs(wavs.size(), nullptr);
-    for (size_t index = 0; index < wavs.size(); index++)
-    {
-        float thisSeconds = settings.m_inFiles[index].m_mixStartTimeSeconds;
-        thisSeconds += wavs[index].GetDurationInSeconds();
-        if (thisSeconds > totalSeconds)
-            totalSeconds = thisSeconds;
-
-        startSampleIndexes[index] =
-            wavs[index].TimeToSampleIndex(settings.m_inFiles[index].m_mixStartTimeSeconds) * numChannels;
-
-        samplePtrs[index] = wavs[index].GetSamplesPtr();
-    }
-
-    // Create the empty output waveform.
-    Waveform wavOut;
-    size_t outNumSamples = static_cast<size_t>(totalSeconds * wavs[0].GetRate());
-    wavOut.Populate(outNumSamples, wavs[0].GetNumChannels(), nullptr);
-    wavOut.SetRate(static_cast<unsigned>(rate));
-
-    //
-    // Mix the input waveforms into the output waveform.
-    //
-    float *sampleOut = wavOut.GetSamplesPtr();
-    for (size_t index = 0; index < outNumSamples * numChannels; index++)
-    {
-        float value = 0.0f;
-
-        for (size_t iwav = 0; iwav < wavs.size(); iwav++)
-        {
-            Waveform &wavin = wavs[iwav];
-            const InFile &filein = settings.m_inFiles[iwav];
-
-            if (index >= startSampleIndexes[iwav] &&
-                index < startSampleIndexes[iwav] + wavin.GetNumSamples() * numChannels)
-            {
-                float insample = samplePtrs[iwav][index - startSampleIndexes[iwav]];
-                value += insample * filein.m_mixVolume;
-            }
-        }
-
-        value = Waveform::ClipValue(value, -1, 1);
-        *sampleOut++ = value;
+        printf("Mixing all input audio at %u Hz.\n", graph.GetFormat(output).m_rate);
     }
 
     //
-    // Save the altered waveform to the output file.
+    // Run the mix through the graph into the output file.
     //
 
+    const WaveformFormat &format = graph.GetFormat(output);
     printname();
     printf("Saving %zu samples (%.2f seconds) to '%S' at %u Hz\n",
-        wavOut.GetNumSamples(), wavOut.GetDurationInSeconds(),
-            settings.m_outFilename.c_str(), wavOut.GetRate());
+        format.m_numSamples, format.GetDurationInSeconds(),
+            settings.m_outFilename.c_str(), format.m_rate);
     fflush(stdout);
 
-    if (!WaveformSaveToFile(settings.m_outFilename.c_str(), wavOut, nullptr, nullptr,
-                            settings.m_useFloat, settings.m_useBytesPerSample))
+    WaveformFileSink sink(settings.m_outFilename.c_str(), settings.m_useFloat, settings.m_useBytesPerSample);
+    if (!graph.Run(output, sink))
     {
         printname();
-        printf("Failed saving audio data to \"%S\"!\n", settings.m_outFilename.c_str());
+        printf("Failed mixing audio data to \"%S\"!\n", settings.m_outFilename.c_str());
         return false;
     }
 
@@ -299,6 +248,24 @@ static void PrintUsage()
         "       4 for integer samples, and 4 or 8 for floating-point \n"
         "       samples. \n"
         "\n"
+        "  -Profile : Times each stage of loading, converting, processing, \n"
+        "       and saving the audio, and prints a table of the times when \n"
+        "       done.  With '-Profile=file', writes them to the given file \n"
+        "       as JSON instead. \n"
+        "\n"
+        "  -MemStats : Counts the memory held in audio buffers by each \n"
+        "       stage, and prints a table of the most each stage held when \n"
+        "       done.  With '-MemStats=file', writes them to the given file \n"
+        "       as JSON instead. \n"
+        "\n"
+        "  -Trace=file : Records a timeline of each stage on each thread, \n"
+        "       and writes it to the given file in the Chrome trace format, \n"
+        "       for viewing in Perfetto (ui.perfetto.dev). \n"
+        "\n"
+        "  -ForceISA=x : Uses the given vector instructions for the sample \n"
+        "       loops:  'scalar' (none), 'sse2', 'avx2', 'avx512', or 'neon'. \n"
+        "       Normally the fastest ones the processor has are used. \n"
+        "\n"
         "  -Help : Print this usage information to the console.\n"
         "\n"
         "  -License : Print the copyright notice and software license \n"
@@ -323,7 +290,7 @@ static bool ParseCommandLineArguments(
 
     for (int iarg = 1; iarg < argc; iarg++)
     {
-        if (argv[iarg][0] == '-')
+        if (IsOption(argv[iarg]))
         {
             if (OptionNameIs(argv[iarg], L"Help") || OptionNameIs(argv[iarg], L"?"))
             {
@@ -331,6 +298,32 @@ static bool ParseCommandLineArguments(
                 PrintUsage();
                 return false;
             }
+            else if (OptionNameIs(argv[iarg], L"Profile"))
+            {
+                // The user wants to see where the time goes.
+                WaveformProfileEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"MemStats"))
+            {
+                // The user wants to see where the memory goes.
+                WaveformMemStatsEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"Trace"))
+            {
+                // The user wants a timeline of the threads.
+                const wchar_t *traceFilename = OptionValue(argv[iarg]);
+                WaveformTraceEnable(traceFilename[0] ? traceFilename : L"trace.json");
+            }
+            else if (OptionNameIs(argv[iarg], L"ForceISA"))
+            {
+                // The user wants particular vector instructions used.
+                if (!DSPKernelsForceISA(OptionValue(argv[iarg])))
+                {
+                    printname();
+                    printf("Unsupported instruction set '%S'.\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+            }
             else if (OptionNameIs(argv[iarg], L"License"))
             {
                 // The user wants the long form copyright and license terms.
@@ -438,6 +431,10 @@ int wmain(int argc, wchar_t **argv)
     if (!ParseCommandLineArguments(argc, argv, settings))
         return EXIT_FAILURE;
 
+    // Audio written to standard output has to have it to itself.
+    if (settings.m_outFilename == L"-")
+        WaveformReserveStdout();
+
     try
     {
         if (!MixToAudioFile(settings))
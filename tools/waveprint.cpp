@@ -43,11 +43,15 @@
 #include "notice.h"
 #include "waveform.h"
 #include "waveformload.h"
+#include "waveformprofile.h"
+#include "dspkernels.h"
 #include "cmdopt.h"
+#include "platform.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <math.h>
+#include <float.h>
 #include <wchar.h>
 #include <ctype.h>
 #include <vector>
@@ -86,6 +90,10 @@ struct ProgramSettings
 
     // Width of the printout in characters.
     unsigned m_width = 60;
+
+    // If this flag is true, the frame index of an MP3 file is
+    // saved in a sidecar file so later runs don't rescan it.
+    bool m_indexCache = false;
 };
 
 // Print the program name prefix to stdout.
@@ -174,33 +182,28 @@ static bool PrintAudioFile(
     printf("  Terminal width:     %u characters\n", width);
 
     //
-    // Load the input file.
+    // Find the length of the input file.
     //
 
-    Waveform wav;
-    if (!WaveformLoadFromFile(inFilename, wav, nullptr, nullptr))
+    WaveformFileInfo info;
+    if (!WaveformReadFileInfo(inFilename, info))
     {
-        printf("Failed loading audio data from \"%S\"\n", inFilename);
+        printf("Failed reading audio file information from \"%S\"\n", inFilename);
         return false;
     }
 
-    printname();
-    printf("Loaded %zu samples (%G seconds) from '%S' at %u Hz\n",
-        wav.GetNumSamples(), wav.GetDurationInSeconds(), inFilename, wav.GetRate());
-    fflush(stdout);
-
     //
     // Adjustments.
     //
 
     if (useTime)
     {
-        startSample    = wav.TimeToSampleIndex(static_cast<float>(startSample) / 1000.0f);
-        numSamples     = wav.TimeToSampleIndex(static_cast<float>(numSamples) / 1000.0f);
-        samplesPerLine = wav.TimeToSampleIndex(static_cast<float>(samplesPerLine) / 1000.0f);
+        startSample    = info.TimeToSampleIndex(static_cast<float>(startSample) / 1000.0f);
+        numSamples     = info.TimeToSampleIndex(static_cast<float>(numSamples) / 1000.0f);
+        samplesPerLine = info.TimeToSampleIndex(static_cast<float>(samplesPerLine) / 1000.0f);
     }
 
-    size_t numSamplesAll = wav.GetNumSamples();
+    size_t numSamplesAll = info.m_numSamples;
     if (startSample >= numSamplesAll)
     {
         printname();
@@ -218,6 +221,22 @@ static bool PrintAudioFile(
         numSamples = numSamplesAll - startSample;
     }
 
+    //
+    // Load the part of the input file that's to be printed.
+    //
+
+    Waveform wav;
+    if (!WaveformLoadRange(inFilename, startSample, numSamples, wav, nullptr, nullptr))
+    {
+        printf("Failed loading audio data from \"%S\"\n", inFilename);
+        return false;
+    }
+
+    printname();
+    printf("Loaded %zu of %zu samples (%G seconds) from '%S' at %u Hz\n",
+        wav.GetNumSamples(), numSamplesAll, wav.GetDurationInSeconds(), inFilename, wav.GetRate());
+    fflush(stdout);
+
     // Reduce the width to account for the space used by
     // the prefixes on each line of the printout.
     if (width > 11)
@@ -242,9 +261,11 @@ static bool PrintAudioFile(
     printf("+\n");
 
     // For each line in the printout...
+    WaveformProfileScope profile("print", numSamples * wav.GetNumChannels(), numSamples * wav.GetNumChannels() * sizeof(float));
     for (size_t isample = 0; isample < numSamples; isample += samplesPerLine)
     {
-        // Determine what chunk of samples is to be printed for this line.
+        // Determine what chunk of samples is to be printed for this
+        // line.  The loaded waveform begins at 'startSample'.
         size_t firstSampleThisLine = startSample + isample;
         size_t numSamplesThisLine = samplesPerLine;
         if (isample + numSamplesThisLine > numSamples)
@@ -253,7 +274,7 @@ static bool PrintAudioFile(
         // Find the lowest and highest samples in this chunk.
         float lowest = 0.0f;
         float highest = 0.0f;
-        FindLowestHighestSamplesInRange(wav, firstSampleThisLine,
+        FindLowestHighestSamplesInRange(wav, isample,
                             numSamplesThisLine, lowest, highest);
         if (lowest < yMin)
             lowest = yMin;
@@ -338,6 +359,35 @@ static void PrintUsage()
         "  -Max=x : Indicates the amplitude represented by the right edge \n"
         "       of the graph.  Default is 1.0.\n"
         "\n"
+        "  -IndexCache : For MP3 files, saves the index of where each \n"
+        "       frame starts in a file named 'filename.idx', so later \n"
+        "       runs can go straight to the part to be printed without \n"
+        "       scanning the whole file again. \n"
+        "\n"
+        "  -RawFormat=x : Sets the sample format of raw PCM input files, \n"
+        "       overriding any .hdr file, where 'x' is 'rate,channels,bytes' \n"
+        "       with an optional ',float' (e.g. '44100,2,2'); or, if 'x' \n"
+        "       is 'auto', guesses the sample size and channel count of \n"
+        "       raw files that don't have a .hdr file. \n"
+        "\n"
+        "  -Profile : Times each stage of loading, converting, processing, \n"
+        "       and saving the audio, and prints a table of the times when \n"
+        "       done.  With '-Profile=file', writes them to the given file \n"
+        "       as JSON instead. \n"
+        "\n"
+        "  -MemStats : Counts the memory held in audio buffers by each \n"
+        "       stage, and prints a table of the most each stage held when \n"
+        "       done.  With '-MemStats=file', writes them to the given file \n"
+        "       as JSON instead. \n"
+        "\n"
+        "  -Trace=file : Records a timeline of each stage on each thread, \n"
+        "       and writes it to the given file in the Chrome trace format, \n"
+        "       for viewing in Perfetto (ui.perfetto.dev). \n"
+        "\n"
+        "  -ForceISA=x : Uses the given vector instructions for the sample \n"
+        "       loops:  'scalar' (none), 'sse2', 'avx2', 'avx512', or 'neon'. \n"
+        "       Normally the fastest ones the processor has are used. \n"
+        "\n"
         "  -Help : Print this usage information to the console.\n"
         "\n"
         "  -License : Print the copyright notice and software license \n"
@@ -362,7 +412,7 @@ static bool ParseCommandLineArguments(
 
     for (int iarg = 1; iarg < argc; iarg++)
     {
-        if (argv[iarg][0] == '-')
+        if (IsOption(argv[iarg]))
         {
             if (OptionNameIs(argv[iarg], L"Help") || OptionNameIs(argv[iarg], L"?"))
             {
@@ -370,6 +420,32 @@ static bool ParseCommandLineArguments(
                 PrintUsage();
                 return false;
             }
+            else if (OptionNameIs(argv[iarg], L"Profile"))
+            {
+                // The user wants to see where the time goes.
+                WaveformProfileEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"MemStats"))
+            {
+                // The user wants to see where the memory goes.
+                WaveformMemStatsEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"Trace"))
+            {
+                // The user wants a timeline of the threads.
+                const wchar_t *traceFilename = OptionValue(argv[iarg]);
+                WaveformTraceEnable(traceFilename[0] ? traceFilename : L"trace.json");
+            }
+            else if (OptionNameIs(argv[iarg], L"ForceISA"))
+            {
+                // The user wants particular vector instructions used.
+                if (!DSPKernelsForceISA(OptionValue(argv[iarg])))
+                {
+                    printname();
+                    printf("Unsupported instruction set '%S'.\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+            }
             else if (OptionNameIs(argv[iarg], L"License"))
             {
                 // The user wants the long form copyright and license terms.
@@ -445,6 +521,19 @@ static bool ParseCommandLineArguments(
             {
                 settings.m_useTime = true;
             }
+            else if (OptionNameIs(argv[iarg], L"IndexCache"))
+            {
+                settings.m_indexCache = true;
+            }
+            else if (OptionNameIs(argv[iarg], L"RawFormat"))
+            {
+                if (!WaveformSetRawFormatFromString(OptionValue(argv[iarg])))
+                {
+                    printname();
+                    printf("Invalid raw PCM format '%S'\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+            }
             else
             {
                 printname();
@@ -491,6 +580,8 @@ int wmain(int argc, wchar_t **argv)
     if (!ParseCommandLineArguments(argc, argv, settings))
         return EXIT_FAILURE;
 
+    WaveformSetIndexCache(settings.m_indexCache);
+
     try
     {
         if (!PrintAudioFile(
@@ -43,11 +43,15 @@
 #include "waveform.h"
 #include "waveformload.h"
 #include "waveformsave.h"
+#include "waveformprofile.h"
+#include "dspkernels.h"
+#include "denormals.h"
 #include "cmdopt.h"
 #include "../subsys/highpass.h"
 #include "../subsys/lowpass.h"
 #include "../subsys/notchfilter.h"
 #include "../subsys/bandpassfilter.h"
+#include "platform.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -87,6 +91,7 @@ static void printname() { printf("%S:  ", program_name); }
 
 static bool ApplyHighPassFilter(Waveform &wav, float highPassFreq)
 {
+    WaveformProfileScope profile("highpass", wav.GetNumSamples() * wav.GetNumChannels(), wav.GetTotalBytes() * 2);
     printname();
     printf("  Applying high pass filter %.2f Hz\n", highPassFreq);
 
@@ -118,6 +123,7 @@ static bool ApplyHighPassFilter(Waveform &wav, float highPassFreq)
 
 static bool ApplyLowPassFilter(Waveform &wav, float lowPassFreq)
 {
+    WaveformProfileScope profile("lowpass", wav.GetNumSamples() * wav.GetNumChannels(), wav.GetTotalBytes() * 2);
     printname();
     printf("  Applying low pass filter %.2f Hz\n", lowPassFreq);
 
@@ -149,6 +155,7 @@ static bool ApplyLowPassFilter(Waveform &wav, float lowPassFreq)
 
 static bool ApplyNotchFilter(Waveform &wav, float notchFreq, float notchQ)
 {
+    WaveformProfileScope profile("notch", wav.GetNumSamples() * wav.GetNumChannels(), wav.GetTotalBytes() * 2);
     printname();
     printf("  Applying notch filter %.2f Hz @ %.2f Q-factor\n", notchFreq, notchQ);
 
@@ -170,6 +177,7 @@ static bool ApplyNotchFilter(Waveform &wav, float notchFreq, float notchQ)
 
 static bool ApplyBandpassFilter(Waveform &wav, float bandpassFreq, float bandpassQ)
 {
+    WaveformProfileScope profile("bandpass", wav.GetNumSamples() * wav.GetNumChannels(), wav.GetTotalBytes() * 2);
     printname();
     printf("  Applying bandpass filter %.2f Hz @ %.2f Q-factor\n", bandpassFreq, bandpassQ);
 
@@ -192,6 +200,7 @@ static bool ApplyBandpassFilter(Waveform &wav, float bandpassFreq, float bandpas
 // Fills wavOut with a delayed version of wavIn.
 static bool ApplyDelay(const Waveform &wavIn, Waveform &wavOut, float delayMs, float level = 1.0f)
 {
+    WaveformProfileScope profile("delay", wavIn.GetNumSamples() * wavIn.GetNumChannels(), wavIn.GetTotalBytes() * 2);
     // Make the output the same size as the input.
     wavOut.Populate(wavIn.GetNumSamples(), wavIn.GetNumChannels());
     wavOut.SetRate(wavIn.GetRate());
@@ -300,6 +309,9 @@ static bool ApplyFilteredDelay(
 //
 static bool AddReverbToAudioFile(const ProgramSettings &settings)
 {
+    // The filtered echoes fade out into long quiet tails.
+    ScopedDenormalsOff denormals;
+
     printname();
     printf("Settings:\n");
     printf("  Processing '%S' to '%S' with dwell %.2f\n",
@@ -370,20 +382,24 @@ static bool AddReverbToAudioFile(const ProgramSettings &settings)
     //
     // Apply reverb to the waveform's samples.
     //
-    Waveform wavOut = wavIn;
-    for (int iecho = 0; echoes[iecho].m_dwellMult > 0; iecho++)
+    Waveform wavOut;
     {
-        printname();
-        printf("Applying reverberation %d\n", iecho);
-        fflush(stdout);
-
-        ApplyFilteredDelay(wavIn, wavOut,
-            settings.m_dwell * echoes[iecho].m_dwellMult,
-            echoes[iecho].m_level,
-            echoes[iecho].m_highPassFreq,
-            echoes[iecho].m_lowPassFreq,
-            echoes[iecho].m_notchFreq, echoes[iecho].m_notchQ,
-            echoes[iecho].m_bandpassFreq, echoes[iecho].m_bandpassQ);
+        WaveformProfileScope profile("reverb");
+        wavOut = wavIn;
+        for (int iecho = 0; echoes[iecho].m_dwellMult > 0; iecho++)
+        {
+            printname();
+            printf("Applying reverberation %d\n", iecho);
+            fflush(stdout);
+
+            ApplyFilteredDelay(wavIn, wavOut,
+                settings.m_dwell * echoes[iecho].m_dwellMult,
+                echoes[iecho].m_level,
+                echoes[iecho].m_highPassFreq,
+                echoes[iecho].m_lowPassFreq,
+                echoes[iecho].m_notchFreq, echoes[iecho].m_notchQ,
+                echoes[iecho].m_bandpassFreq, echoes[iecho].m_bandpassQ);
+        }
     }
 
     //
@@ -447,6 +463,24 @@ static void PrintUsage()
         "       4 for integer samples, and 4 or 8 for floating-point \n"
         "       samples. \n"
         "\n"
+        "  -Profile : Times each stage of loading, converting, processing, \n"
+        "       and saving the audio, and prints a table of the times when \n"
+        "       done.  With '-Profile=file', writes them to the given file \n"
+        "       as JSON instead. \n"
+        "\n"
+        "  -MemStats : Counts the memory held in audio buffers by each \n"
+        "       stage, and prints a table of the most each stage held when \n"
+        "       done.  With '-MemStats=file', writes them to the given file \n"
+        "       as JSON instead. \n"
+        "\n"
+        "  -Trace=file : Records a timeline of each stage on each thread, \n"
+        "       and writes it to the given file in the Chrome trace format, \n"
+        "       for viewing in Perfetto (ui.perfetto.dev). \n"
+        "\n"
+        "  -ForceISA=x : Uses the given vector instructions for the sample \n"
+        "       loops:  'scalar' (none), 'sse2', 'avx2', 'avx512', or 'neon'. \n"
+        "       Normally the fastest ones the processor has are used. \n"
+        "\n"
         "  -Help : Print this usage information to the console.\n"
         "\n"
         "  -License : Print the copyright notice and software license \n"
@@ -472,7 +506,7 @@ static bool ParseCommandLineArguments(
     unsigned nonopts = 0;
     for (int iarg = 1; iarg < argc; iarg++)
     {
-        if (argv[iarg][0] == '-')
+        if (IsOption(argv[iarg]))
         {
             if (OptionNameIs(argv[iarg], L"Help") || OptionNameIs(argv[iarg], L"?"))
             {
@@ -480,6 +514,32 @@ static bool ParseCommandLineArguments(
                 PrintUsage();
                 return false;
             }
+            else if (OptionNameIs(argv[iarg], L"Profile"))
+            {
+                // The user wants to see where the time goes.
+                WaveformProfileEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"MemStats"))
+            {
+                // The user wants to see where the memory goes.
+                WaveformMemStatsEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"Trace"))
+            {
+                // The user wants a timeline of the threads.
+                const wchar_t *traceFilename = OptionValue(argv[iarg]);
+                WaveformTraceEnable(traceFilename[0] ? traceFilename : L"trace.json");
+            }
+            else if (OptionNameIs(argv[iarg], L"ForceISA"))
+            {
+                // The user wants particular vector instructions used.
+                if (!DSPKernelsForceISA(OptionValue(argv[iarg])))
+                {
+                    printname();
+                    printf("Unsupported instruction set '%S'.\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+            }
             else if (OptionNameIs(argv[iarg], L"License"))
             {
                 // The user wants the long form copyright and license terms.
@@ -574,6 +634,10 @@ int wmain(int argc, wchar_t **argv)
     if (!ParseCommandLineArguments(argc, argv, settings))
         return EXIT_FAILURE;
 
+    // Audio written to standard output has to have it to itself.
+    if (settings.m_outFilename == L"-")
+        WaveformReserveStdout();
+
     try
     {
         if (!AddReverbToAudioFile(settings))
@@ -44,7 +44,10 @@
 #include "waveform.h"
 #include "waveformload.h"
 #include "waveformsave.h"
+#include "waveformprofile.h"
+#include "dspkernels.h"
 #include "cmdopt.h"
+#include "platform.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -95,6 +98,10 @@ struct ProgramSettings
     // the indicated part of the waveform, we delete
     // everything *except* the indicated part.
     bool m_invert = false;
+
+    // If this flag is true, the frame index of an MP3 file is
+    // saved in a sidecar file so later runs don't rescan it.
+    bool m_indexCache = false;
 };
 
 // Print the program name prefix to stdout.
@@ -154,29 +161,26 @@ static bool TrimAudioFile(
     printf("---\n");
 
     //
-    // Load the input file.
+    // Find the length of the input file.
     //
 
-    Waveform wav;
-    if (!WaveformLoadFromFile(inFilename, wav, nullptr, nullptr))
+    WaveformFileInfo info;
+    if (!WaveformReadFileInfo(inFilename, info))
     {
-        printf("Failed loading audio data from \"%S\"\n", inFilename);
+        printf("Failed reading audio file information from \"%S\"\n", inFilename);
         return false;
     }
 
-    printf("Loaded %zu samples from '%S' at %u Hz\n", wav.GetNumSamples(), inFilename, wav.GetRate());
-    fflush(stdout);
-
     //
     // Make any necessary adjustments to starting position and count.
     //
 
     if (useTime && startSample != START_AT_END)
-        startSample = wav.TimeToSampleIndex(static_cast<float>(startSample) / 1000.0f);
+        startSample = info.TimeToSampleIndex(static_cast<float>(startSample) / 1000.0f);
     if (useTime && numSamples > 0)
-        numSamples = wav.TimeToSampleIndex(static_cast<float>(numSamples) / 1000.0f);
+        numSamples = info.TimeToSampleIndex(static_cast<float>(numSamples) / 1000.0f);
 
-    size_t numSamplesInFile = wav.GetNumSamples();
+    size_t numSamplesInFile = info.m_numSamples;
     if (startSample == START_AT_END)
         startSample = numSamplesInFile - numSamples;
     if (startSample >= numSamplesInFile)
@@ -185,51 +189,50 @@ static bool TrimAudioFile(
         return false;
     }
     if (numSamples == 0)
-        numSamples = wav.GetNumSamples() - startSample;
+        numSamples = numSamplesInFile - startSample;
 
     //
-    // Delete the specified section of the waveform.
+    // Load the input file.  If only the trimmed portion is to be
+    // kept, there's no need to load the rest of it.
     //
 
-    if (!invert)
+    Waveform wav;
+    if (invert)
     {
-        printf("Deleting %zu samples starting at %zu.\n", numSamples, startSample);
+        printf("Keeping %zu samples starting at %zu.\n", numSamples, startSample);
         fflush(stdout);
-    
-        if (!wav.Delete(startSample, numSamples))
+
+        if (!WaveformLoadRange(inFilename, startSample, numSamples, wav, nullptr, nullptr))
         {
-            printf("Failed deleting samples from waveform.\n");
+            printf("Failed loading audio data from \"%S\"\n", inFilename);
             return false;
         }
+
+        printf("Loaded %zu samples from '%S' at %u Hz\n", wav.GetNumSamples(), inFilename, wav.GetRate());
+        fflush(stdout);
     }
     else
     {
-        // Delete the portion before the trim area.
-        if (startSample > 0)
+        if (!WaveformLoadFromFile(inFilename, wav, nullptr, nullptr))
         {
-            printf("Deleting %zu samples from beginning of waveform.\n", startSample);
-            fflush(stdout);
-
-            if (!wav.Delete(0, startSample))
-            {
-                printf("Failed deleting samples from beginning of waveform.\n");
-                return false;
-            }
+            printf("Failed loading audio data from \"%S\"\n", inFilename);
+            return false;
         }
 
-        // Delete the portion after the trim area.
-        if (wav.GetNumSamples() > numSamples)
-        {
-            size_t numToDelete = wav.GetNumSamples() - numSamples;
+        printf("Loaded %zu samples from '%S' at %u Hz\n", wav.GetNumSamples(), inFilename, wav.GetRate());
+        fflush(stdout);
 
-            printf("Deleting %zu samples from end of waveform.\n", numToDelete);
-            fflush(stdout);
+        //
+        // Delete the specified section of the waveform.
+        //
 
-            if (!wav.Delete(numSamples, numToDelete))
-            {
-                printf("Failed deleting samples from end of waveform.\n");
-                return false;
-            }
+        printf("Deleting %zu samples starting at %zu.\n", numSamples, startSample);
+        fflush(stdout);
+
+        if (!wav.Delete(startSample, numSamples))
+        {
+            printf("Failed deleting samples from waveform.\n");
+            return false;
         }
     }
 
@@ -280,7 +283,13 @@ static void PrintUsage()
         "       trim backward from the end of the waveform. \n"
         "\n"
         "  -Invert : Instead of deleting the indicated part of the waveform, \n"
-        "       deletes everything except the indicated part. \n"
+        "       deletes everything except the indicated part.  Only that \n"
+        "       part of 'infile' is read. \n"
+        "\n"
+        "  -IndexCache : For MP3 files, saves the index of where each \n"
+        "       frame starts in a file named 'infile.idx', so later \n"
+        "       runs with -Invert can go straight to the part to keep \n"
+        "       without scanning the whole file again. \n"
         "\n"
         "  -Float=x : For file formats that support both integer and \n"
         "       floating-point samples, this indicates which to use \n"
@@ -292,6 +301,30 @@ static void PrintUsage()
         "       4 for integer samples, and 4 or 8 for floating-point \n"
         "       samples. \n"
         "\n"
+        "  -RawFormat=x : Sets the sample format of raw PCM input files, \n"
+        "       overriding any .hdr file, where 'x' is 'rate,channels,bytes' \n"
+        "       with an optional ',float' (e.g. '44100,2,2'); or, if 'x' \n"
+        "       is 'auto', guesses the sample size and channel count of \n"
+        "       raw files that don't have a .hdr file. \n"
+        "\n"
+        "  -Profile : Times each stage of loading, converting, processing, \n"
+        "       and saving the audio, and prints a table of the times when \n"
+        "       done.  With '-Profile=file', writes them to the given file \n"
+        "       as JSON instead. \n"
+        "\n"
+        "  -MemStats : Counts the memory held in audio buffers by each \n"
+        "       stage, and prints a table of the most each stage held when \n"
+        "       done.  With '-MemStats=file', writes them to the given file \n"
+        "       as JSON instead. \n"
+        "\n"
+        "  -Trace=file : Records a timeline of each stage on each thread, \n"
+        "       and writes it to the given file in the Chrome trace format, \n"
+        "       for viewing in Perfetto (ui.perfetto.dev). \n"
+        "\n"
+        "  -ForceISA=x : Uses the given vector instructions for the sample \n"
+        "       loops:  'scalar' (none), 'sse2', 'avx2', 'avx512', or 'neon'. \n"
+        "       Normally the fastest ones the processor has are used. \n"
+        "\n"
         "  -Help : Print this usage information to the console.\n"
         "\n"
         "  -License : Print the copyright notice and software license \n"
@@ -316,7 +349,7 @@ static bool ParseCommandLineArguments(
 
     for (int iarg = 1; iarg < argc; iarg++)
     {
-        if (argv[iarg][0] == '-')
+        if (IsOption(argv[iarg]))
         {
             if (OptionNameIs(argv[iarg], L"Help") || OptionNameIs(argv[iarg], L"?"))
             {
@@ -324,6 +357,32 @@ static bool ParseCommandLineArguments(
                 PrintUsage();
                 return false;
             }
+            else if (OptionNameIs(argv[iarg], L"Profile"))
+            {
+                // The user wants to see where the time goes.
+                WaveformProfileEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"MemStats"))
+            {
+                // The user wants to see where the memory goes.
+                WaveformMemStatsEnable(OptionValue(argv[iarg]));
+            }
+            else if (OptionNameIs(argv[iarg], L"Trace"))
+            {
+                // The user wants a timeline of the threads.
+                const wchar_t *traceFilename = OptionValue(argv[iarg]);
+                WaveformTraceEnable(traceFilename[0] ? traceFilename : L"trace.json");
+            }
+            else if (OptionNameIs(argv[iarg], L"ForceISA"))
+            {
+                // The user wants particular vector instructions used.
+                if (!DSPKernelsForceISA(OptionValue(argv[iarg])))
+                {
+                    printname();
+                    printf("Unsupported instruction set '%S'.\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+            }
             else if (OptionNameIs(argv[iarg], L"License"))
             {
                 // The user wants the long form copyright and license terms.
@@ -380,6 +439,19 @@ static bool ParseCommandLineArguments(
             {
                 settings.m_invert = true;
             }
+            else if (OptionNameIs(argv[iarg], L"IndexCache"))
+            {
+                settings.m_indexCache = true;
+            }
+            else if (OptionNameIs(argv[iarg], L"RawFormat"))
+            {
+                if (!WaveformSetRawFormatFromString(OptionValue(argv[iarg])))
+                {
+                    printname();
+                    printf("Invalid raw PCM format '%S'\n", OptionValue(argv[iarg]));
+                    return false;
+                }
+            }
             else
             {
                 printname();
@@ -428,6 +500,12 @@ int wmain(int argc, wchar_t **argv)
     if (!ParseCommandLineArguments(argc, argv, settings))
         return EXIT_FAILURE;
 
+    // Audio written to standard output has to have it to itself.
+    if (settings.m_outFilename == L"-")
+        WaveformReserveStdout();
+
+    WaveformSetIndexCache(settings.m_indexCache);
+
     try
     {
         if (!TrimAudioFile(